@@ -0,0 +1,130 @@
+#ifndef __FS_ASYNC_H__
+#define __FS_ASYNC_H__
+
+#include "fs_def.h"
+#include "fs_driver.h"
+
+/*
+ * Размер очереди запросов и очереди завершений (степень двойки):
+ * одновременно не больше FS_ASYNC_QUEUE_SIZE незабранных запросов
+ */
+#define FS_ASYNC_QUEUE_SIZE 16U
+
+/*
+ * ОПЕРАЦИЯ ЗАПРОСА:
+ *   FS_ASYNC_OP_READ: FS_FILE_READ (id, length, buffer)
+ *   FS_ASYNC_OP_WRITE: FS_FILE_WRITE (id, length, buffer)
+ *   FS_ASYNC_OP_SYNC: FS_FILE_SYNC (id)
+ *   FS_ASYNC_OP_GC_STEP: FTL_GARBAGE_COLLECT_STEP (не больше одного стирания)
+ */
+typedef enum
+{
+  FS_ASYNC_OP_READ,
+  FS_ASYNC_OP_WRITE,
+  FS_ASYNC_OP_SYNC,
+  FS_ASYNC_OP_GC_STEP
+} FS_ASYNC_OP;
+
+/*
+ * ЗАПРОС:
+ *   op: Операция
+ *   id: Дескриптор файла
+ *   length: Количество байт
+ *   buffer: Данные (буфер не должен меняться до завершения запроса)
+ *   user_data: Значение вызывающего, возвращается в завершении
+ */
+typedef struct
+{
+  FS_ASYNC_OP op;
+  FILE_ID id;
+  SIZE32 length;
+  VOID_PTR buffer;
+  VOID_PTR user_data;
+} FS_ASYNC_REQUEST_TYPE;
+
+/*
+ * ЗАВЕРШЕНИЕ:
+ *   user_data: Значение из запроса
+ *   length: Прочитано или записано байт (FS_ASYNC_OP_GC_STEP: 1 - цикл
+ *           сборки мусора завершен)
+ *   return_code: Статус операции
+ *   file_error: Ошибка ФС (0 - нет ошибки)
+ */
+typedef struct
+{
+  VOID_PTR user_data;
+  SIZE32 length;
+  RETURN_CODE return_code;
+  FILE_ERROR file_error;
+} FS_ASYNC_COMPLETION_TYPE;
+
+/*
+ * ИНИЦИАЛИЗАЦИЯ ОЧЕРЕДЕЙ (после FS_INIT):
+ *   return_code: Статус операции
+ *     NO_ERROR: Очереди пусты, рабочий поток запущен (FS_ASYNC_THREAD)
+ *     OPERATION_FAILED: Невозможно запустить рабочий поток
+ *
+ * Без FS_THREAD_SAFE, пока очереди работают с рабочим потоком, ФС и FTL
+ * вызываются только через запросы. У каждого тома свои очереди и рабочий
+ * поток: вызовы FS_ASYNC_* работают с очередями тома, выбранного вызывающим
+ * потоком (FS_VOLUME_SELECT), запрос с дескриптором другого тома
+ * завершается с INVALID_PARAM. Без FS_THREAD_SAFE выбор тома общий для
+ * всех потоков: рабочий поток одновременно запущен не больше чем у одного
+ * тома
+ */
+void FS_ASYNC_INIT(
+/* OUT */ RETURN_CODE * return_code);
+
+/*
+ * ВЫКЛЮЧЕНИЕ ОЧЕРЕДЕЙ (до FS_FREE, отправленные запросы выполняются):
+ *   return_code: Статус операции
+ */
+void FS_ASYNC_FREE(
+/* OUT */ RETURN_CODE * return_code);
+
+/*
+ * ОТПРАВКА ЗАПРОСА:
+ *   REQUEST: Запрос (копируется в очередь)
+ *   return_code: Статус операции
+ *     NO_ERROR: Запрос в очереди
+ *     NO_ACTION: Очередь заполнена (нужно забрать завершения)
+ *     INVALID_PARAM: Неизвестная операция
+ */
+void FS_ASYNC_SUBMIT(
+/* IN  */ const FS_ASYNC_REQUEST_TYPE * REQUEST,
+/* OUT */ RETURN_CODE * return_code);
+
+/*
+ * ВЫПОЛНЕНИЕ ЗАПРОСОВ (только главный цикл целевой платформы):
+ *   LIMIT: Наибольшее количество выполняемых запросов
+ *   processed: Выполнено запросов
+ *   return_code: Статус операции
+ *     NO_ERROR: Запросы выполнены (результаты - в очереди завершений)
+ *     ACCESS_DENIED: Запросы выполняет рабочий поток, или вызов
+ *                    из обработчика прерывания (Cortex-M)
+ *     DEVICE_BUSY: Запросы уже выполняются (повторный вход)
+ *
+ * ФС и FTL не реентерабельны: прерывание может только отметить, что
+ * главному циклу пора вызвать FS_ASYNC_PROCESS. Отправка и получение
+ * завершений - из одного контекста (у каждого кольца один писатель)
+ */
+void FS_ASYNC_PROCESS(
+/* IN  */ const SIZE32 LIMIT,
+/* OUT */ SIZE32 * processed,
+/* OUT */ RETURN_CODE * return_code);
+
+/*
+ * ПОЛУЧЕНИЕ ЗАВЕРШЕНИЯ (в порядке выполнения запросов):
+ *   WAIT: 1 - ждать завершения (без рабочего потока запросы выполняются
+ *         в вызывающем контексте, кроме прерывания и повторного входа)
+ *   completion: Завершение
+ *   return_code: Статус операции
+ *     NO_ERROR: Завершение получено
+ *     NO_ACTION: Завершений нет (при WAIT - нет отправленных запросов)
+ */
+void FS_ASYNC_REAP(
+/* IN  */ const U8 WAIT,
+/* OUT */ FS_ASYNC_COMPLETION_TYPE * completion,
+/* OUT */ RETURN_CODE * return_code);
+
+#endif /* __FS_ASYNC_H__ */
@@ -3,6 +3,77 @@
 
 #include "fs_def.h"
 
+/*
+ * Размер ключа и блока AES-128
+ */
+#define CRYPT_KEY_SIZE 16U
+#define CRYPT_BLOCK_SIZE 16U
+
+/*
+ * НАПРАВЛЕНИЕ ШИФРОВАНИЯ (CRC32 всегда считается по открытым данным):
+ *   CRYPT_ENCRYPT: Зашифровать (CRC32 входных данных)
+ *   CRYPT_DECRYPT: Расшифровать (CRC32 выходных данных)
+ */
+typedef enum
+{
+  CRYPT_ENCRYPT,
+  CRYPT_DECRYPT
+} CRYPT_DIRECTION;
+
+/*
+ * УСТАНОВКА КЛЮЧА AES-128 (до установки действует ключ по умолчанию):
+ *   KEY: Ключ (16 байт)
+ */
+void CRYPT_KEY_SET(
+/* IN  */ const U8 * KEY);
+
+/*
+ * ШИФРОВАНИЕ AES-128-CTR СОВМЕСТНО С ХЕШИРОВАНИЕМ CRC32 (один проход):
+ *   data: Шифруемые данные
+ *   SIZE: Размер данных
+ *   TWEAK: Номер потока ключей (например, номер логического блока)
+ *   DOMAIN: Область номеров TWEAK (разные области не пересекаются)
+ *   DIRECTION: Направление
+ *   crc: Хеш-номер открытых данных
+ *
+ * Счетчик: TWEAK (4 байта) | DOMAIN (4 байта) | 0 (4 байта) | номер блока
+ * Пара TWEAK/DOMAIN не должна повторяться для разных данных: повтор потока
+ * ключей раскрывает XOR открытых данных (для перезаписываемых секторов -
+ * CRYPT_XTS)
+ * На x86 с AES-NI блоки шифруются инструкциями процессора, иначе -
+ * программно за постоянное время (без таблиц, зависящих от данных)
+ */
+void CRYPT_CTR(
+/* INOUT */ VOID_PTR data,
+/* IN    */ const SIZE32 SIZE,
+/* IN    */ const U32 TWEAK,
+/* IN    */ const U32 DOMAIN,
+/* IN    */ const CRYPT_DIRECTION DIRECTION,
+/* OUT   */ U32 * crc);
+
+/*
+ * ШИФРОВАНИЕ AES-128-XTS СОВМЕСТНО С ХЕШИРОВАНИЕМ CRC32 (один проход):
+ *   data: Шифруемые данные (не меньше CRYPT_BLOCK_SIZE байт)
+ *   SIZE: Размер данных
+ *   TWEAK: Номер сектора (например, номер логического блока)
+ *   DOMAIN: Область номеров TWEAK (разные области не пересекаются)
+ *   DIRECTION: Направление
+ *   crc: Хеш-номер открытых данных
+ *
+ * IEEE 1619: маска сектора - TWEAK (4 байта) | DOMAIN (4 байта) | 0 (8 байт),
+ * зашифрованные ключом маски (выводится из основного ключа). Перезапись
+ * сектора другими данными не раскрывает их XOR; неполный последний блок
+ * шифруется переносом шифротекста, длина данных не меняется. Реализация
+ * блока - как у CRYPT_CTR
+ */
+void CRYPT_XTS(
+/* INOUT */ VOID_PTR data,
+/* IN    */ const SIZE32 SIZE,
+/* IN    */ const U32 TWEAK,
+/* IN    */ const U32 DOMAIN,
+/* IN    */ const CRYPT_DIRECTION DIRECTION,
+/* OUT   */ U32 * crc);
+
 /*
  * ШИФРОВАНИЕ XOR:
  *   data: Шифруемые данные
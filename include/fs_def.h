@@ -6,6 +6,13 @@
  */
 #define UN_SET 0xFFFFFFFFU
 
+/*
+ * Упакованная структура (в armcc ключевое слово, для gcc - атрибут)
+ */
+#ifndef __packed
+#define __packed __attribute__((packed))
+#endif
+
 typedef char               CHAR;
 typedef signed char        I8;
 typedef unsigned char      U8;
@@ -20,6 +27,23 @@ typedef I32 SSIZE32;
 
 typedef void * VOID_PTR;
 
+/*
+ * Количество томов (независимых экземпляров эмулятора, flash, FTL и ФС;
+ * на хосте тома работают одновременно в разных потоках)
+ */
+#ifndef FS_VOLUMES_COUNT
+#ifdef __linux__
+#define FS_VOLUMES_COUNT 4U
+#else
+#define FS_VOLUMES_COUNT 1U
+#endif
+#endif
+
+/*
+ * Номер тома (0 - том по умолчанию)
+ */
+typedef U8 VOLUME_ID;
+
 typedef enum {
   NO_ERROR,
   NO_ACTION,
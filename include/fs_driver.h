@@ -18,6 +18,17 @@
  */
 #define FS_TAGS_COUNT 52U
 
+/*
+ * Наибольшая длина ключа и значения хранилища ключ-значение
+ */
+#define FS_KV_KEY_SIZE 32U
+#define FS_KV_VALUE_SIZE 200U
+
+/*
+ * Наибольший размер записи временного ряда
+ */
+#define FS_SERIES_RECORD_SIZE 200U
+
 
 
 /*
@@ -30,6 +41,11 @@ typedef U16 FILE_ID;
  */
 typedef CHAR FILE_NAME[FILE_NAME_SIZE];
 
+/*
+ * Номер снимка ФС
+ */
+typedef U32 SNAPSHOT_ID;
+
 /*
  * Позиция в файле
  */
@@ -69,6 +85,19 @@ typedef enum
   FILE_SEEK_END = 0x03
 } FILE_SEEK;
 
+/*
+ * КОДИРОВАНИЕ ЗАПИСЕЙ ВРЕМЕННОГО РЯДА:
+ *   FS_SERIES_RAW: Данные без изменений
+ *   FS_SERIES_DELTA: Побайтовая разность с первой записью блока (только
+ *                    записи постоянного размера; медленно меняющиеся
+ *                    значения дают нулевые байты, которые сжимает FTL)
+ */
+typedef enum
+{
+  FS_SERIES_RAW   = 0x00,
+  FS_SERIES_DELTA = 0x01
+} FS_SERIES_ENCODING;
+
 /*
  * ОШИБКИ ФС:
  *   FILE_ERROR_PERMISSION: Операция не разрешена
@@ -98,22 +127,121 @@ typedef enum
   FILE_ERROR_NO_SPACE      = 0x0B
 } FILE_ERROR;
 
+/*
+ * ОПЕРАЦИИ ЗАПРОСА ПО ТЕГАМ (обратная польская запись):
+ *   TAG_QUERY_TAG: Поместить в стек множество файлов с тегом
+ *   TAG_QUERY_AND: Пересечение двух верхних множеств
+ *   TAG_QUERY_OR: Объединение двух верхних множеств
+ *   TAG_QUERY_NOT: Дополнение верхнего множества (среди существующих файлов)
+ */
+typedef enum
+{
+  TAG_QUERY_TAG = 0x01,
+  TAG_QUERY_AND = 0x02,
+  TAG_QUERY_OR  = 0x03,
+  TAG_QUERY_NOT = 0x04
+} TAG_QUERY_OP;
+
+/*
+ * ЭЛЕМЕНТ ЗАПРОСА ПО ТЕГАМ:
+ *   op: Операция
+ *   tag: Название тега (только для TAG_QUERY_TAG)
+ *   (19 байт + enum = 24 байта)
+ */
+typedef struct
+{
+  TAG_QUERY_OP  op;
+  TAG_NAME      tag;
+} TAG_QUERY_TYPE;
+
+/*
+ * СТАТИСТИКА УПРЕЖДАЮЩЕГО ЧТЕНИЯ:
+ *   window: Текущий размер окна (блоков, 0 - чтение без упреждения)
+ *   hits: Блоки, полученные из окна
+ *   misses: Блоки, прочитанные из flash по запросу
+ *   (12 байт)
+ */
+typedef struct
+{
+  SIZE32 window;
+  SIZE32 hits;
+  SIZE32 misses;
+} FILE_READAHEAD_TYPE;
+
 /*
  * СТАТУС ОТКРЫТОГО ФАЙЛА:
  *   size: Общий размер файла
  *   position: Позиция в файле (в байтах)
  *   mode: Режим открытия
  *   tags: Битовая карта тэгов
- *   (16 байт + enum = 20 байт)
+ *   readahead: Статистика упреждающего чтения
+ *   (28 байт + enum = 32 байт)
  */
 typedef struct
 {
-  SIZE32         size;
-  FILE_POSITION  position;
-  FILE_MODE      mode;
-  TAG_BITMAP     tags;
+  SIZE32               size;
+  FILE_POSITION        position;
+  FILE_MODE            mode;
+  TAG_BITMAP           tags;
+  FILE_READAHEAD_TYPE  readahead;
 } FILE_STATUS_TYPE;
 
+/*
+ * ЭЛЕМЕНТ СПИСКА ФАЙЛОВ:
+ *   name: Имя файла
+ *   size: Размер файла
+ *   tags: Битовая карта тэгов
+ *   (61 байт + выравнивание = 64 байта)
+ */
+typedef struct
+{
+  FILE_NAME   name;
+  SIZE32      size;
+  TAG_BITMAP  tags;
+} FILE_ENTRY_TYPE;
+
+/*
+ * КУРСОР ОБХОДА ФАЙЛОВ:
+ *   next: Системный номер, с которого продолжается обход
+ *   prefix: Префикс имени (хранится у вызывающего)
+ *   prefix_length: Длина префикса
+ *   query: Фильтр по тегам (хранится у вызывающего)
+ *   query_length: Количество элементов фильтра (0 - без фильтра)
+ */
+typedef struct
+{
+  FILE_ID                 next;
+  const CHAR *            prefix;
+  SIZE32                  prefix_length;
+  const TAG_QUERY_TYPE *  query;
+  SIZE32                  query_length;
+} FILE_CURSOR_TYPE;
+
+/*
+ * ЧАСТЬ ДАННЫХ ВЕКТОРНОГО ВВОДА/ВЫВОДА:
+ *   length: Размер части
+ *   data: Данные части
+ */
+typedef struct
+{
+  SIZE32    length;
+  VOID_PTR  data;
+} FILE_IOVEC_TYPE;
+
+/*
+ * ЧАСТЬ ОТОБРАЖЕНИЯ ФАЙЛА:
+ *   length: Размер части
+ *   data: Данные части (только чтение)
+ *   pinned: 1 - данные во flash (блок закреплен до FS_FILE_UNMAP),
+ *           0 - копия в буфере вызывающего
+ */
+typedef struct
+{
+  SIZE32      length;
+  const U8 *  data;
+  U8          pinned;
+} FILE_SEGMENT_TYPE;
+
 /*
  * СОЗДАНИЕ ФАЙЛА:
  *   NAME: Имя файла
@@ -129,7 +257,8 @@ void FS_FILE_CREATE(
  * ОТКРЫТИЕ ФАЙЛА:
  *   NAME: Имя файла
  *   MODE: Режим открытия
- *   id: Дескриптор файла
+ *   id: Дескриптор файла (после закрытия отклоняется, даже если ячейка
+ *       таблицы занята новым открытием)
  *   return_code: Статус операции
  *   file_error: Ошибка ФС
  */
@@ -141,7 +270,8 @@ void FS_FILE_OPEN(
 /* OUT */ FILE_ERROR * file_error);
 
 /*
- * ЗАКРЫТИЕ ФАЙЛА:
+ * ЗАКРЫТИЕ ФАЙЛА (операции других потоков с дескриптором должны быть
+ * завершены):
  *   ID: Дескриптор файла
  *   return_code: Статус операции
  *   file_error: Ошибка ФС
@@ -151,6 +281,17 @@ void FS_FILE_CLOSE(
 /* OUT */ RETURN_CODE * return_code,
 /* OUT */ FILE_ERROR * file_error);
 
+/*
+ * СИНХРОНИЗАЦИЯ ФАЙЛА (буфер и заголовок записываются во flash):
+ *   ID: Дескриптор файла
+ *   return_code: Статус операции
+ *   file_error: Ошибка ФС
+ */
+void FS_FILE_SYNC(
+/* IN  */ const FILE_ID ID,
+/* OUT */ RETURN_CODE * return_code,
+/* OUT */ FILE_ERROR * file_error);
+
 /*
  * ЧТЕНИЕ ИЗ ФАЙЛА:
  *   ID: Дескриптор файла
@@ -183,6 +324,83 @@ void FS_FILE_WRITE(
 /* OUT */ RETURN_CODE * return_code,
 /* OUT */ FILE_ERROR * file_error);
 
+/*
+ * ВЕКТОРНОЕ ЧТЕНИЕ ИЗ ФАЙЛА (части заполняются по порядку):
+ *   ID: Дескриптор файла
+ *   COUNT: Количество частей
+ *   VECTOR: Части
+ *   out_length: Прочитанное количество байт (всего)
+ *   return_code: Статус операции
+ *   file_error: Ошибка ФС
+ */
+void FS_FILE_READV(
+/* IN  */ const FILE_ID ID,
+/* IN  */ const SIZE32 COUNT,
+/* IN  */ const FILE_IOVEC_TYPE * VECTOR,
+/* OUT */ SIZE32 * out_length,
+/* OUT */ RETURN_CODE * return_code,
+/* OUT */ FILE_ERROR * file_error);
+
+/*
+ * ВЕКТОРНАЯ ЗАПИСЬ В ФАЙЛ (части копируются сразу в буфер блока):
+ *   ID: Дескриптор файла
+ *   COUNT: Количество частей
+ *   VECTOR: Части
+ *   APPEND: 1 - атомарное добавление в конец файла (при ошибке файл
+ *           усекается до прежнего размера, позиция восстанавливается)
+ *   return_code: Статус операции
+ *   file_error: Ошибка ФС
+ */
+void FS_FILE_WRITEV(
+/* IN  */ const FILE_ID ID,
+/* IN  */ const SIZE32 COUNT,
+/* IN  */ const FILE_IOVEC_TYPE * VECTOR,
+/* IN  */ const U8 APPEND,
+/* OUT */ RETURN_CODE * return_code,
+/* OUT */ FILE_ERROR * file_error);
+
+/*
+ * ОТОБРАЖЕНИЕ ФАЙЛА В ПАМЯТЬ (только чтение, данные проверяются один раз):
+ *   ID: Дескриптор файла (буфер и заголовок записываются во flash)
+ *   CAPACITY: Количество элементов segments
+ *   segments: Части, по порядку покрывающие данные файла
+ *   count: Количество частей (0 - при ошибке)
+ *   SCRATCH_SIZE: Размер scratch
+ *   scratch: Буфер для блоков, хранимых во flash не на месте
+ *            (шифрование, сжатие, исправимая ошибка ECC)
+ *   return_code: Статус операции
+ *   file_error: Ошибка ФС
+ *     FILE_ERROR_NO_SPACE: Не хватает частей или буфера, или закрепление
+ *                          блока оставит сборщик мусора без резерва
+ *
+ * Блок на месте дает часть до 248 байт, соседние копии в буфере
+ * объединяются. Сектора закрепленных блоков не стираются сборщиком мусора
+ * до FS_FILE_UNMAP: запись в файл или его удаление не меняют отображение.
+ * Отображение снимается до FS_FREE
+ */
+void FS_FILE_MAP(
+/* IN  */ const FILE_ID ID,
+/* IN  */ const SIZE32 CAPACITY,
+/* OUT */ FILE_SEGMENT_TYPE * segments,
+/* OUT */ SIZE32 * count,
+/* IN  */ const SIZE32 SCRATCH_SIZE,
+/* OUT */ VOID_PTR scratch,
+/* OUT */ RETURN_CODE * return_code,
+/* OUT */ FILE_ERROR * file_error);
+
+/*
+ * СНЯТИЕ ОТОБРАЖЕНИЯ ФАЙЛА:
+ *   COUNT: Количество частей
+ *   SEGMENTS: Части из FS_FILE_MAP
+ *   return_code: Статус операции
+ *   file_error: Ошибка ФС
+ */
+void FS_FILE_UNMAP(
+/* IN  */ const SIZE32 COUNT,
+/* IN  */ const FILE_SEGMENT_TYPE * SEGMENTS,
+/* OUT */ RETURN_CODE * return_code,
+/* OUT */ FILE_ERROR * file_error);
+
 /*
  * УСТАНОВКА ПОЗИЦИИ В ФАЙЛЕ:
  *   ID: Дескриптор файла
@@ -201,7 +419,20 @@ void FS_FILE_SEEK(
 /* OUT */ FILE_ERROR * file_error);
 
 /*
- * УДАЛЕНИЕ ФАЙЛА:
+ * УСЕЧЕНИЕ ФАЙЛА (освободившиеся блоки сообщаются FTL через FTL_DISCARD):
+ *   ID: Дескриптор файла (открыт на запись)
+ *   SIZE: Новый размер (не больше текущего)
+ *   return_code: Статус операции
+ *   file_error: Ошибка ФС
+ */
+void FS_FILE_TRUNCATE(
+/* IN  */ const FILE_ID ID,
+/* IN  */ const SIZE32 SIZE,
+/* OUT */ RETURN_CODE * return_code,
+/* OUT */ FILE_ERROR * file_error);
+
+/*
+ * УДАЛЕНИЕ ФАЙЛА (файл не должен быть открыт, блоки освобождаются в FTL):
  *   NAME: Имя файла
  *   return_code: Статус операции
  *   file_error: Ошибка ФС
@@ -224,6 +455,181 @@ void FS_FILE_RENAME(
 /* OUT */ RETURN_CODE * return_code,
 /* OUT */ FILE_ERROR * file_error);
 
+/*
+ * КОПИРОВАНИЕ ФАЙЛА (общие блоки данных, копирование при записи):
+ *   SOURCE_NAME: Имя исходного файла
+ *   NEW_NAME: Имя копии
+ *   return_code: Статус операции
+ *   file_error: Ошибка ФС
+ */
+void FS_FILE_CLONE(
+/* IN  */ const FILE_NAME SOURCE_NAME,
+/* IN  */ const FILE_NAME NEW_NAME,
+/* OUT */ RETURN_CODE * return_code,
+/* OUT */ FILE_ERROR * file_error);
+
+/*
+ * СОЗДАНИЕ ЖУРНАЛА ЗАПИСЕЙ:
+ *   NAME: Имя файла
+ *   return_code: Статус операции
+ *   file_error: Ошибка ФС
+ *
+ * Журнал - файл, данные которого добавляются только в конец записями
+ * (длина, CRC32 и данные) и отбрасываются только с начала. Блоки
+ * заполняются подряд, добавление не обходит цепочку. Позиции журнала
+ * отсчитываются от начала первого блока: после открытия позиция - первая
+ * запись, FILE_SEEK_SET отсчитывается от нее. Журнал не копируется
+ * (FS_FILE_CLONE)
+ */
+void FS_LOG_CREATE(
+/* IN  */ const FILE_NAME NAME,
+/* OUT */ RETURN_CODE * return_code,
+/* OUT */ FILE_ERROR * file_error);
+
+/*
+ * ДОБАВЛЕНИЕ ЗАПИСИ В ЖУРНАЛ (позиция чтения не меняется):
+ *   ID: Дескриптор журнала (чтение и запись)
+ *   LENGTH: Размер данных (не больше 65535 байт)
+ *   DATA: Данные
+ *   return_code: Статус операции
+ *     NO_ERROR: Запись и новый размер журнала зафиксированы
+ *     INVALID_PARAM: Файл не журнал (или ряд) или запись слишком большая
+ *   file_error: Ошибка ФС
+ */
+void FS_LOG_APPEND(
+/* IN  */ const FILE_ID ID,
+/* IN  */ const SIZE32 LENGTH,
+/* IN  */ const VOID_PTR DATA,
+/* OUT */ RETURN_CODE * return_code,
+/* OUT */ FILE_ERROR * file_error);
+
+/*
+ * ЧТЕНИЕ ЗАПИСИ ЖУРНАЛА С ТЕКУЩЕЙ ПОЗИЦИИ:
+ *   ID: Дескриптор журнала
+ *   CAPACITY: Размер data
+ *   data: Данные записи
+ *   out_length: Размер записи
+ *   return_code: Статус операции
+ *     NO_ERROR: Запись прочитана, позиция - следующая запись
+ *     NO_ACTION: Записей больше нет
+ *     INVALID_PARAM: Запись больше CAPACITY (позиция не меняется,
+ *                    out_length - нужный размер)
+ *     OPERATION_FAILED: Ошибка чтения или CRC (позиция - следующая запись)
+ *   file_error: Ошибка ФС
+ */
+void FS_LOG_READ(
+/* IN  */ const FILE_ID ID,
+/* IN  */ const SIZE32 CAPACITY,
+/* OUT */ VOID_PTR data,
+/* OUT */ SIZE32 * out_length,
+/* OUT */ RETURN_CODE * return_code,
+/* OUT */ FILE_ERROR * file_error);
+
+/*
+ * ОТБРАСЫВАНИЕ ЗАПИСЕЙ ДО ТЕКУЩЕЙ ПОЗИЦИИ:
+ *   ID: Дескриптор журнала (чтение и запись)
+ *   return_code: Статус операции
+ *   file_error: Ошибка ФС
+ *
+ * Заголовок журнала получает новое начало одной записью журнала ФС,
+ * затем прочитанные блоки освобождаются в ФС и в FTL (сбой между этими
+ * шагами - только утечка блоков). Данные не копируются
+ */
+void FS_LOG_TRIM(
+/* IN  */ const FILE_ID ID,
+/* OUT */ RETURN_CODE * return_code,
+/* OUT */ FILE_ERROR * file_error);
+
+/*
+ * СОЗДАНИЕ ВРЕМЕННОГО РЯДА:
+ *   NAME: Имя файла
+ *   RECORD_SIZE: Размер записи (0 - переменный, не больше
+ *                FS_SERIES_RECORD_SIZE)
+ *   ENCODING: Кодирование данных записей
+ *   return_code: Статус операции
+ *   file_error: Ошибка ФС
+ *
+ * Временной ряд - журнал записей с меткой времени, не убывающей от
+ * записи к записи. Каждый блок начинается заголовком: время первой и
+ * последней записи и ссылки на предыдущие блоки с номерами, кратными
+ * 4^j (разреженный индекс). Запись не переходит границу блока, время
+ * хранится смещением от первой записи блока. Начало ряда отбрасывается
+ * FS_LOG_TRIM, записи ряда не читаются FS_LOG_READ
+ */
+void FS_SERIES_CREATE(
+/* IN  */ const FILE_NAME NAME,
+/* IN  */ const SIZE32 RECORD_SIZE,
+/* IN  */ const FS_SERIES_ENCODING ENCODING,
+/* OUT */ RETURN_CODE * return_code,
+/* OUT */ FILE_ERROR * file_error);
+
+/*
+ * ДОБАВЛЕНИЕ ЗАПИСИ ВО ВРЕМЕННОЙ РЯД (позиция чтения не меняется):
+ *   ID: Дескриптор ряда (чтение и запись)
+ *   TIME: Метка времени (не меньше, чем у последней записи)
+ *   LENGTH: Размер данных (RECORD_SIZE ряда или не больше
+ *           FS_SERIES_RECORD_SIZE)
+ *   DATA: Данные
+ *   return_code: Статус операции
+ *     NO_ERROR: Запись добавлена в буфер (фиксируется FS_FILE_SYNC или
+ *               закрытием, заполненный блок уходит во flash сразу)
+ *     INVALID_PARAM: Файл не ряд, время меньше последнего или неверный
+ *                    размер записи
+ *   file_error: Ошибка ФС
+ */
+void FS_SERIES_APPEND(
+/* IN  */ const FILE_ID ID,
+/* IN  */ const U32 TIME,
+/* IN  */ const SIZE32 LENGTH,
+/* IN  */ const VOID_PTR DATA,
+/* OUT */ RETURN_CODE * return_code,
+/* OUT */ FILE_ERROR * file_error);
+
+/*
+ * ПОИСК ПЕРВОЙ ЗАПИСИ НЕ РАНЬШЕ FROM:
+ *   ID: Дескриптор ряда
+ *   FROM: Начало диапазона времени
+ *   return_code: Статус операции
+ *     NO_ERROR: Позиция - первая запись со временем не меньше FROM
+ *               (или конец ряда)
+ *   file_error: Ошибка ФС
+ *
+ * Поиск спускается по ссылкам заголовков от последнего блока: читаются
+ * только заголовки O(log) блоков, затем записи одного блока
+ */
+void FS_SERIES_SEEK(
+/* IN  */ const FILE_ID ID,
+/* IN  */ const U32 FROM,
+/* OUT */ RETURN_CODE * return_code,
+/* OUT */ FILE_ERROR * file_error);
+
+/*
+ * ЧТЕНИЕ ЗАПИСИ ВРЕМЕННОГО РЯДА С ТЕКУЩЕЙ ПОЗИЦИИ:
+ *   ID: Дескриптор ряда
+ *   TO: Конец диапазона времени (включительно)
+ *   CAPACITY: Размер data
+ *   time: Метка времени записи
+ *   data: Данные записи
+ *   out_length: Размер записи
+ *   return_code: Статус операции
+ *     NO_ERROR: Запись прочитана, позиция - следующая запись
+ *     NO_ACTION: Записей больше нет или следующая запись позже TO
+ *                (позиция не меняется)
+ *     INVALID_PARAM: Запись больше CAPACITY (позиция не меняется,
+ *                    out_length - нужный размер)
+ *     OPERATION_FAILED: Ошибка чтения или поврежденный блок
+ *   file_error: Ошибка ФС
+ */
+void FS_SERIES_READ(
+/* IN  */ const FILE_ID ID,
+/* IN  */ const U32 TO,
+/* IN  */ const SIZE32 CAPACITY,
+/* OUT */ U32 * time,
+/* OUT */ VOID_PTR data,
+/* OUT */ SIZE32 * out_length,
+/* OUT */ RETURN_CODE * return_code,
+/* OUT */ FILE_ERROR * file_error);
+
 /*
  * ПОЛУЧЕНИЕ СТАТУСА ФАЙЛА:
  *   ID: Дескриптор файла
@@ -272,8 +678,189 @@ void FS_TAG_RENAME(
 /* IN  */ const TAG_NAME NEW_NAME,
 /* OUT */ RETURN_CODE * return_code);
 
+/*
+ * ПОИСК ФАЙЛОВ ПО ТЕГАМ:
+ *   QUERY: Выражение в обратной польской записи
+ *          ("a" AND ("b" OR NOT "c") = a b c NOT OR AND)
+ *   QUERY_LENGTH: Количество элементов выражения (0 - все файлы)
+ *   IDS_SIZE: Размер массива ids
+ *   ids: Номера найденных файлов (первые IDS_SIZE по возрастанию)
+ *   count: Количество найденных файлов (может быть больше IDS_SIZE)
+ *   return_code: Статус операции
+ *     NO_ERROR: Поиск выполнен (неизвестный тег - пустое множество)
+ *     INVALID_PARAM: Выражение некорректно или слишком глубокое
+ */
+void FS_TAG_SEARCH(
+/* IN  */ const TAG_QUERY_TYPE * QUERY,
+/* IN  */ const SIZE32 QUERY_LENGTH,
+/* IN  */ const SIZE32 IDS_SIZE,
+/* OUT */ FILE_ID * ids,
+/* OUT */ SIZE32 * count,
+/* OUT */ RETURN_CODE * return_code);
+
+
+
+/*
+ * НАЧАЛО ОБХОДА ФАЙЛОВ:
+ *   PREFIX: Префикс имени ("" - все имена)
+ *   QUERY: Фильтр по тегам в обратной польской записи (как FS_TAG_SEARCH)
+ *   QUERY_LENGTH: Количество элементов фильтра (0 - все файлы)
+ *   cursor: Курсор обхода
+ *   return_code: Статус операции
+ *     NO_ERROR: Курсор готов
+ *     INVALID_PARAM: Префикс длиннее имени или фильтр некорректен
+ */
+void FS_FILE_ITERATE_BEGIN(
+/* IN  */ const CHAR * PREFIX,
+/* IN  */ const TAG_QUERY_TYPE * QUERY,
+/* IN  */ const SIZE32 QUERY_LENGTH,
+/* OUT */ FILE_CURSOR_TYPE * cursor,
+/* OUT */ RETURN_CODE * return_code);
+
+/*
+ * СЛЕДУЮЩАЯ ПАРТИЯ ФАЙЛОВ:
+ *   cursor: Курсор обхода
+ *   ENTRIES_SIZE: Размер массива entries
+ *   entries: Имена, размеры и теги найденных файлов
+ *   count: Количество заполненных элементов
+ *   return_code: Статус операции
+ *     NO_ERROR: Партия получена
+ *     NO_ACTION: Обход завершен
+ *     OPERATION_FAILED: Ошибка чтения
+ */
+void FS_FILE_ITERATE(
+/* INOUT */ FILE_CURSOR_TYPE * cursor,
+/* IN    */ const SIZE32 ENTRIES_SIZE,
+/* OUT   */ FILE_ENTRY_TYPE * entries,
+/* OUT   */ SIZE32 * count,
+/* OUT   */ RETURN_CODE * return_code);
+
+
+
+/*
+ * СОЗДАНИЕ СНИМКА ФС (данные не копируются; снимок сохраняется после
+ * FS_FREE и сбоя питания до FS_SNAPSHOT_DELETE):
+ *   id: Номер снимка
+ *   return_code: Статус операции
+ *     NO_ERROR: Снимок создан
+ *     NO_ACTION: Достигнуто максимальное количество снимков
+ *     OPERATION_FAILED: Ошибка записи открытых файлов или снимка
+ */
+void FS_SNAPSHOT_CREATE(
+/* OUT */ SNAPSHOT_ID * id,
+/* OUT */ RETURN_CODE * return_code);
+
+/*
+ * ОТКАТ ФС К СНИМКУ (снимок сохраняется; откат, прерванный сбоем
+ * питания после записи отката, завершается при FS_INIT):
+ *   ID: Номер снимка
+ *   return_code: Статус операции
+ *     NO_ERROR: ФС возвращена к состоянию снимка
+ *     INVALID_PARAM: Снимка не существует
+ *     DEVICE_BUSY: Есть открытые файлы
+ *     NO_ACTION: Слишком много откатов без переподключения или нет места
+ *     OPERATION_FAILED: Ошибка записи отката или чтения таблиц
+ */
+void FS_SNAPSHOT_ROLLBACK(
+/* IN  */ const SNAPSHOT_ID ID,
+/* OUT */ RETURN_CODE * return_code);
+
+/*
+ * УДАЛЕНИЕ СНИМКА ФС:
+ *   ID: Номер снимка
+ *   return_code: Статус операции
+ *     NO_ERROR: Снимок удален
+ *     INVALID_PARAM: Снимка не существует
+ *     NO_ACTION: Нет места для записи удаления
+ *     OPERATION_FAILED: Ошибка записи
+ */
+void FS_SNAPSHOT_DELETE(
+/* IN  */ const SNAPSHOT_ID ID,
+/* OUT */ RETURN_CODE * return_code);
+
+/*
+ * ЗАПИСЬ ЗНАЧЕНИЯ КЛЮЧА (без файлов: одно программирование части блока):
+ *   KEY: Ключ
+ *   KEY_LENGTH: Длина ключа (1 - FS_KV_KEY_SIZE)
+ *   VALUE: Значение
+ *   VALUE_LENGTH: Длина значения (не больше FS_KV_VALUE_SIZE)
+ *   return_code: Статус операции
+ *     NO_ERROR: Значение записано
+ *     INVALID_PARAM: Длина ключа или значения выходит за границы
+ *     NO_ACTION: Достигнуто максимальное количество ключей или нет места
+ *     OPERATION_FAILED: Ошибка записи
+ *
+ * Хранилище ключ-значение не входит в снимки ФС
+ */
+void FS_KV_PUT(
+/* IN  */ const VOID_PTR KEY,
+/* IN  */ const SIZE32 KEY_LENGTH,
+/* IN  */ const VOID_PTR VALUE,
+/* IN  */ const SIZE32 VALUE_LENGTH,
+/* OUT */ RETURN_CODE * return_code);
+
+/*
+ * ЧТЕНИЕ ЗНАЧЕНИЯ КЛЮЧА (одно чтение flash):
+ *   KEY: Ключ
+ *   KEY_LENGTH: Длина ключа (1 - FS_KV_KEY_SIZE)
+ *   CAPACITY: Размер value
+ *   value: Значение
+ *   value_length: Длина значения
+ *   return_code: Статус операции
+ *     NO_ERROR: Значение прочитано
+ *     NO_ACTION: Ключа нет
+ *     INVALID_PARAM: Неверная длина ключа или значение больше CAPACITY
+ *                    (value_length - нужный размер)
+ *     OPERATION_FAILED: Запись повреждена
+ */
+void FS_KV_GET(
+/* IN  */ const VOID_PTR KEY,
+/* IN  */ const SIZE32 KEY_LENGTH,
+/* IN  */ const SIZE32 CAPACITY,
+/* OUT */ VOID_PTR value,
+/* OUT */ SIZE32 * value_length,
+/* OUT */ RETURN_CODE * return_code);
+
+/*
+ * УДАЛЕНИЕ КЛЮЧА:
+ *   KEY: Ключ
+ *   KEY_LENGTH: Длина ключа (1 - FS_KV_KEY_SIZE)
+ *   return_code: Статус операции
+ *     NO_ERROR: Ключ удален
+ *     NO_ACTION: Ключа нет или нет места
+ *     INVALID_PARAM: Неверная длина ключа
+ *     OPERATION_FAILED: Ошибка записи
+ */
+void FS_KV_DELETE(
+/* IN  */ const VOID_PTR KEY,
+/* IN  */ const SIZE32 KEY_LENGTH,
+/* OUT */ RETURN_CODE * return_code);
+
 
 
+/*
+ * ВЫБОР ТОМА ВЫЗЫВАЮЩЕГО ПОТОКА (вместе с FTL, flash и эмулируемым
+ * устройством; до первого выбора поток работает с томом 0):
+ *   ID: Номер тома
+ *   return_code: Статус операции
+ *     NO_ERROR: Том выбран
+ *     INVALID_PARAM: Номер тома не меньше FS_VOLUMES_COUNT
+ *
+ * Тома независимы: у каждого свой образ (EMULATOR_INIT), таблицы
+ * и блокировки. Дескриптор файла содержит номер тома и в другом томе
+ * отклоняется (INVALID_PARAM)
+ */
+void FS_VOLUME_SELECT(
+/* IN  */ const VOLUME_ID ID,
+/* OUT */ RETURN_CODE * return_code);
+
+/*
+ * ТОМ ВЫЗЫВАЮЩЕГО ПОТОКА:
+ *   id: Номер тома
+ */
+void FS_VOLUME_CURRENT(
+/* OUT */ VOLUME_ID * id);
+
 /*
  * ИНИЦИАЛИЗАЦИЯ ФС
  */
@@ -284,6 +871,4 @@ void FS_INIT(RETURN_CODE* return_code);
  */
 void FS_FREE(RETURN_CODE * return_code);
 
-/* TODO: search by tags */
-
 #endif
@@ -2,14 +2,84 @@
 #define __FS_EMULATOR_H__
 
 #include "fs_def.h"
+#include "fs_lock.h"
 
 /*
  * Размер flash памяти 1мб
  */
 #define FLASH_SIZE (1024 * 1024)
 
-extern I16  g_flash_fd;
-extern U8 * g_flash_mem;
+/*
+ * Режим эмуляции NAND: за основной памятью следует запасная область,
+ * по одному байту на слово (хранение ECC)
+ */
+#ifndef EMULATOR_NAND
+#define EMULATOR_NAND 0U
+#endif
+
+/*
+ * Размер запасной области (следует сразу за FLASH_SIZE)
+ */
+#if EMULATOR_NAND
+#define EMULATOR_SPARE_SIZE (FLASH_SIZE / 4)
+#else
+#define EMULATOR_SPARE_SIZE 0
+#endif
+
+/*
+ * Количество одновременно эмулируемых залипших битов
+ */
+#define EMULATOR_FAULTS_COUNT 16U
+
+/*
+ * ЗАЛИПШИЙ БИТ:
+ *   offset: Смещение байта
+ *   mask: Маска бита
+ *   value: Значение бита (0 или mask)
+ */
+typedef struct
+{
+  SIZE32 offset;
+  U8 mask;
+  U8 value;
+} EMULATOR_FAULT_TYPE;
+
+/*
+ * ЭМУЛИРУЕМОЕ УСТРОЙСТВО ТОМА:
+ *   fd: Файл образа (-1 - не открыт)
+ *   mem: Отображение файла в память
+ *   faults: Таблица залипших битов (только в RAM)
+ *   faults_count: Количество залипших битов
+ *   power_budget: Операций программирования и стирания до отключения
+ *     питания (0 - питание не отключается)
+ *   power_off: Питание отключено: программирование и стирание
+ *     не выполняются
+ */
+typedef struct
+{
+  I16 fd;
+  U8 * mem;
+  EMULATOR_FAULT_TYPE faults[EMULATOR_FAULTS_COUNT];
+  SIZE32 faults_count;
+  SIZE32 power_budget;
+  U8 power_off;
+} EMULATOR_VOLUME_TYPE;
+
+/*
+ * Устройство тома, выбранного потоком
+ */
+extern FS_THREAD_LOCAL EMULATOR_VOLUME_TYPE * g_emulator;
+
+/*
+ * ВЫБОР ТОМА ВЫЗЫВАЮЩЕГО ПОТОКА:
+ *   ID: Номер тома
+ *   return_code: Статус операции
+ *     NO_ERROR: Том выбран
+ *     INVALID_PARAM: Номер тома не меньше FS_VOLUMES_COUNT
+ */
+void EMULATOR_VOLUME_SELECT(
+/* IN  */ const VOLUME_ID ID,
+/* OUT */ RETURN_CODE * return_code);
 
 void EMULATOR_INIT(
 /* IN  */ const CHAR * FLASH_NAME,
@@ -17,4 +87,65 @@ void EMULATOR_INIT(
 
 void EMULATOR_FREE(void);
 
+/*
+ * ПРОГРАММИРОВАНИЕ (биты только сбрасываются 1 -> 0, как в NOR/NAND):
+ *   OFFSET: Смещение от начала памяти (включая запасную область)
+ *   SIZE: Размер DATA
+ *   DATA: Записываемые данные
+ */
+void EMULATOR_PROGRAM(
+/* IN  */ const SIZE32 OFFSET,
+/* IN  */ const SIZE32 SIZE,
+/* IN  */ const VOID_PTR DATA);
+
+/*
+ * СТИРАНИЕ (все биты в 1):
+ *   OFFSET: Смещение от начала памяти (включая запасную область)
+ *   SIZE: Размер стираемой области
+ */
+void EMULATOR_ERASE(
+/* IN  */ const SIZE32 OFFSET,
+/* IN  */ const SIZE32 SIZE);
+
+/*
+ * ЗАЛИПШИЙ БИТ (изношенная ячейка не меняет значение при записи и стирании):
+ *   OFFSET: Смещение байта от начала памяти
+ *   BIT: Номер бита в байте
+ *   VALUE: Значение, которое сохраняет бит
+ *   return_code: Статус операции
+ *     NO_ERROR: Неисправность добавлена
+ *     INVALID_PARAM: Неверное смещение или номер бита
+ *     NO_ACTION: Таблица неисправностей заполнена
+ */
+void EMULATOR_FAULT(
+/* IN  */ const SIZE32 OFFSET,
+/* IN  */ const U8 BIT,
+/* IN  */ const U8 VALUE,
+/* OUT */ RETURN_CODE * return_code);
+
+/*
+ * ОТКЛЮЧЕНИЕ ПИТАНИЯ:
+ *   COUNT: Номер операции программирования или стирания, во время которой
+ *          отключается питание (0 - питание включено, отключение отменено)
+ *
+ * Прерванная операция выполняется наполовину (первая половина диапазона
+ * записана или стерта), последующие не выполняются: образ остается
+ * в состоянии на момент отключения
+ */
+void EMULATOR_POWER_CUT(
+/* IN  */ const SIZE32 COUNT);
+
+/*
+ * ИНВЕРСИЯ БИТА (потеря заряда ячейкой после записи):
+ *   OFFSET: Смещение байта от начала памяти
+ *   BIT: Номер бита в байте
+ *   return_code: Статус операции
+ *     NO_ERROR: Бит инвертирован
+ *     INVALID_PARAM: Неверное смещение или номер бита
+ */
+void EMULATOR_BITFLIP(
+/* IN  */ const SIZE32 OFFSET,
+/* IN  */ const U8 BIT,
+/* OUT */ RETURN_CODE * return_code);
+
 #endif
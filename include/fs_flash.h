@@ -8,6 +8,16 @@
  */
 #define FLASH_SECTORS_COUNT 12U
 
+/*
+ * Размер страницы (единица изъятия из работы)
+ */
+#define FLASH_PAGE_SIZE 256U
+
+/*
+ * Количество страниц flash памяти (1мб)
+ */
+#define FLASH_PAGES_COUNT 4096U
+
 /*
  * Адрес flash-памяти
  */
@@ -60,8 +70,34 @@ typedef struct {
   U32 crc32;
 } FLASH_SECTOR_TYPE;
 
+/* СТАТИСТИКА НАДЕЖНОСТИ (только в RAM, с момента FLASH_INIT):
+ *   bad_pages: Страниц в таблице изъятых
+ *   program_failures: Записей, не прошедших проверку чтением
+ *   erase_failures: Страниц, не стертых при стирании сектора
+ *   ecc_corrected: Слов с исправленной однобитовой ошибкой
+ *   ecc_failed: Слов с неисправимой ошибкой
+ */
+typedef struct {
+  SIZE32 bad_pages;
+  SIZE32 program_failures;
+  SIZE32 erase_failures;
+  SIZE32 ecc_corrected;
+  SIZE32 ecc_failed;
+} FLASH_STATS_TYPE;
+
 
 
+/*
+ * ВЫБОР ТОМА ВЫЗЫВАЮЩЕГО ПОТОКА (вместе с эмулируемым устройством):
+ *   ID: Номер тома
+ *   return_code: Статус операции
+ *     NO_ERROR: Том выбран
+ *     INVALID_PARAM: Номер тома не меньше FS_VOLUMES_COUNT
+ */
+void FLASH_VOLUME_SELECT(
+/* IN  */ const VOLUME_ID ID,
+/* OUT */ RETURN_CODE * return_code);
+
 /*
  * ИНИЦИАЛИЗАЦИЯ FLASH-ДРАЙВЕРА:
  *   return_code: Статус операции
@@ -135,7 +171,8 @@ void FLASH_SECTOR_SELECT(
  * СТИРАНИЕ СЕКТОРА:
  *   SECTOR_ID: Номер сектора для стирания
  *   return_code: Код возврата
- *     NO_ERROR: Сектор стерт
+ *     NO_ERROR: Сектор стерт (страницы, не прошедшие проверку стирания,
+ *               изъяты - см. FLASH_BADBLOCK_CHECK)
  *     INVALID_PARAM: Нокоректный номер сектора
  *     ACCESS_DENIED: Данный сектор невозможно стереть с текущем уровнем доступа
  *     OPERATION_FAILED: Ошибка стирания
@@ -152,6 +189,11 @@ void FLASH_SECTOR_ERASE(
  *   SIZE: Размер DATA
  *   DATA: Данные для записи (выровнивание по слову)
  *   return_code: Код возврата
+ *     NO_ERROR: Данные записаны и проверены чтением
+ *     INVALID_PARAM: Неверные параметры (данные не выровнены, выход за сектор)
+ *     ACCESS_DENIED: Запись в сектор запрещена
+ *     OPERATION_FAILED: Область не стерта
+ *     OPERATION_FAILED: Проверка чтением не пройдена (страница изъята)
  */
 void FLASH_WRITE(
 /* IN  */ const FLASH_ADDRESS PBA,
@@ -169,6 +211,7 @@ void FLASH_WRITE(
  *     NO_ERROR: Данные успешно прочтены
  *     INVALID_PARAM: Неверные параметры (данные не выровнены)
  *     OPERATION_FAILED: Выход за границы адресов
+ *     OPERATION_FAILED: Неисправимая ошибка ECC (data содержит прочитанное)
  */
 void FLASH_READ(
 /* IN  */ const FLASH_ADDRESS PBA,
@@ -176,4 +219,56 @@ void FLASH_READ(
 /* OUT */ VOID_PTR data,
 /* OUT */ RETURN_CODE * return_code);
 
+
+
+/* АДРЕС ДАННЫХ В АДРЕСНОМ ПРОСТРАНСТВЕ (flash отображена в память,
+ * чтение по адресу идет без коррекции ECC):
+ *   PBA: Физический адрес
+ *   data: Данные по адресу (действителен до FLASH_FREE)
+ *   return_code: Статус операции
+ *     NO_ERROR: Адрес получен
+ *     OPERATION_FAILED: Адрес выходит за границы памяти
+ */
+void FLASH_POINTER(
+/* IN  */ const FLASH_ADDRESS PBA,
+/* OUT */ const U8 ** data,
+/* OUT */ RETURN_CODE * return_code);
+
+
+
+/*
+ * ИЗЪЯТИЕ СТРАНИЦЫ ИЗ РАБОТЫ (сохраняется в заголовке при FLASH_FREE):
+ *   PBA: Физический адрес в странице
+ *   return_code: Статус операции
+ *     NO_ERROR: Страница изъята
+ *     NO_ACTION: Страница уже изъята
+ *     INVALID_PARAM: Адрес выходит за границы памяти
+ */
+void FLASH_BADBLOCK_MARK(
+/* IN  */ const FLASH_ADDRESS PBA,
+/* OUT */ RETURN_CODE * return_code);
+
+/*
+ * ПРОВЕРКА СТРАНИЦЫ ПО ТАБЛИЦЕ ИЗЪЯТЫХ:
+ *   PBA: Физический адрес в странице
+ *   bad: 1 - страница изъята, 0 - исправна
+ *   return_code: Статус операции
+ *     NO_ERROR: Состояние получено
+ *     INVALID_PARAM: Адрес выходит за границы памяти
+ */
+void FLASH_BADBLOCK_CHECK(
+/* IN  */ const FLASH_ADDRESS PBA,
+/* OUT */ U8 * bad,
+/* OUT */ RETURN_CODE * return_code);
+
+/*
+ * СТАТИСТИКА НАДЕЖНОСТИ:
+ *   stats: Счетчики отказов и коррекций
+ *   return_code: Статус операции
+ *     NO_ERROR: Статистика получена
+ */
+void FLASH_STATS(
+/* OUT */ FLASH_STATS_TYPE * stats,
+/* OUT */ RETURN_CODE * return_code);
+
 #endif /* __FS_FLASH_H__ */
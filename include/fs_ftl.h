@@ -8,6 +8,146 @@
  */
 typedef U32 FTL_INDEX;
 
+/*
+ * Номер снимка
+ */
+typedef U32 FTL_SNAPSHOT_ID;
+
+/*
+ * СТАТИСТИКА СЖАТИЯ:
+ *   raw_blocks: Блоков записано без сжатия
+ *   packed_blocks: Блоков записано в ячейки сжатых блоков
+ *   bytes_in: Объем сжатых блоков до сжатия
+ *   bytes_out: Объем сжатых блоков после сжатия
+ *   dedup_blocks: Сжатых блоков записано ссылкой на одинаковые данные
+ *                 (входят в packed_blocks, данные не программировались)
+ */
+typedef struct
+{
+  SIZE32 raw_blocks;
+  SIZE32 packed_blocks;
+  SIZE32 bytes_in;
+  SIZE32 bytes_out;
+  SIZE32 dedup_blocks;
+} FTL_COMPRESS_STATS_TYPE;
+
+/*
+ * Количество секторов flash под FTL (сектора 2-11)
+ */
+#define FTL_WEAR_SECTORS 10U
+
+/*
+ * СТАТИСТИКА ИЗНОСА:
+ *   erases: Гистограмма износа - счетчики стираний секторов FTL
+ *           (erases[0] - сектор 2, за все время работы flash)
+ *   min: Наименьший счетчик стираний
+ *   max: Наибольший счетчик стираний
+ *   migrations: Блоков перенесено выравниванием износа
+ */
+typedef struct
+{
+  SIZE32 erases[FTL_WEAR_SECTORS];
+  SIZE32 min;
+  SIZE32 max;
+  SIZE32 migrations;
+} FTL_WEAR_STATS_TYPE;
+
+/*
+ * СТАТИСТИКА СБОРКИ МУСОРА И РАЗДЕЛЕНИЯ ДАННЫХ:
+ *   runs: Запусков сборщика мусора
+ *   erases: Секторов стерто сборщиком мусора
+ *   relocations: Актуальных блоков перенесено при освобождении секторов
+ *   hot_blocks: Блоков записано на горячий фронт
+ *   cold_blocks: Блоков записано на холодный фронт
+ *   discards: Логических блоков освобождено FTL_DISCARD
+ *   free_blocks: Свободных физических блоков (включая резерв)
+ *   reserve: Резерв свободных блоков сборщика мусора (не выдается
+ *            для записи данных)
+ */
+typedef struct
+{
+  SIZE32 runs;
+  SIZE32 erases;
+  SIZE32 relocations;
+  SIZE32 hot_blocks;
+  SIZE32 cold_blocks;
+  SIZE32 discards;
+  SIZE32 free_blocks;
+  SIZE32 reserve;
+} FTL_GC_STATS_TYPE;
+
+/*
+ * СТАТИСТИКА НАДЕЖНОСТИ:
+ *   bad_blocks: Физических блоков изъято из работы (по таблице FTL)
+ *   retired: Блоков изъято после ошибки записи
+ *   retries: Повторов записи в другой блок
+ *   ecc_corrected: Слов исправлено ECC (flash-драйвер)
+ *   ecc_failed: Слов с неисправимой ошибкой (flash-драйвер)
+ */
+typedef struct
+{
+  SIZE32 bad_blocks;
+  SIZE32 retired;
+  SIZE32 retries;
+  SIZE32 ecc_corrected;
+  SIZE32 ecc_failed;
+} FTL_HEALTH_STATS_TYPE;
+
+/*
+ * СТАТИСТИКА ХРАНИЛИЩА КЛЮЧ-ЗНАЧЕНИЕ:
+ *   keys: Ключей в индексе (включая удаленные, запись удаления которых
+ *         еще хранится)
+ *   puts: Значений записано
+ *   deletes: Ключей удалено
+ *   relocated: Записей перенесено сборщиком мусора
+ *   dropped: Записей удаления отброшено сборщиком мусора
+ */
+typedef struct
+{
+  SIZE32 keys;
+  SIZE32 puts;
+  SIZE32 deletes;
+  SIZE32 relocated;
+  SIZE32 dropped;
+} FTL_KV_STATS_TYPE;
+
+/*
+ * СТАТИСТИКА FTL (с момента включения):
+ *   compress: Статистика сжатия
+ *   wear: Статистика износа
+ *   gc: Статистика сборки мусора
+ *   health: Статистика надежности
+ *   kv: Статистика хранилища ключ-значение
+ */
+typedef struct
+{
+  FTL_COMPRESS_STATS_TYPE compress;
+  FTL_WEAR_STATS_TYPE wear;
+  FTL_GC_STATS_TYPE gc;
+  FTL_HEALTH_STATS_TYPE health;
+  FTL_KV_STATS_TYPE kv;
+} FTL_STATS_TYPE;
+
+/*
+ * Наибольшая длина ключа и значения хранилища ключ-значение
+ * (запись целиком помещается в физический блок)
+ */
+#define FTL_KV_KEY_SIZE 32U
+#define FTL_KV_VALUE_SIZE 200U
+
+/*
+ * ТЕМПЕРАТУРА ДАННЫХ:
+ *   FTL_TEMPERATURE_AUTO: Оценивается по частоте перезаписи
+ *   FTL_TEMPERATURE_HOT: Часто перезаписываемые данные (метаданные)
+ *   FTL_TEMPERATURE_COLD: Редко перезаписываемые данные (образы, архивы)
+ */
+typedef enum
+{
+  FTL_TEMPERATURE_AUTO,
+  FTL_TEMPERATURE_HOT,
+  FTL_TEMPERATURE_COLD
+} FTL_TEMPERATURE;
+
 /*
  * РЕЖИМ РАБОТЫ:
  *   FTL_MODE_SUPERVISOR: Привелигерованный режим
@@ -21,12 +161,26 @@ typedef enum
 
 
 /*
- * ИНИЦИАЛИЗАЦИЯ FTL-драйвера:
+ * ВЫБОР ТОМА ВЫЗЫВАЮЩЕГО ПОТОКА (вместе с flash и эмулируемым устройством;
+ * до первого выбора поток работает с томом 0):
+ *   ID: Номер тома
+ *   return_code: Статус операции
+ *     NO_ERROR: Том выбран
+ *     INVALID_PARAM: Номер тома не меньше FS_VOLUMES_COUNT
+ */
+void FTL_VOLUME_SELECT(
+/* IN  */ const VOLUME_ID ID,
+/* OUT */ RETURN_CODE * return_code);
+
+/*
+ * ИНИЦИАЛИЗАЦИЯ FTL-драйвера (на хосте сектора читаются параллельно,
+ * не больше FTL_MOUNT_THREADS потоков):
  *   return_code: Статус операции
  *     NO_ERROR: Успешная инициализация
  *     ACCESS_DENIED: Требуется режим работы суперпользователя
  *     NO_ACTION: Нет доступа к flash-памяти
  *     OPERATION_FAILED: Ошибка чтения блоков
+ *                       (блок с неисправимой ошибкой ECC изымается из работы)
  */
 void FTL_INIT(
 /* OUT */ RETURN_CODE * return_code);
@@ -46,6 +200,8 @@ void FTL_FREE(
  *   return_code: Статус операции
  *     NO_ERROR: Успешная запись
  *     INVALID_PARAM: Параметры выходят за границу памяти
+ *     NO_ACTION: Нет места: свободные блоки исчерпаны до резерва сборщика
+ *                мусора (блоки до сбойного записаны)
  *     OPERATION_FAILED: Ошибка запиши
  */
 void FTL_WRITE(
@@ -72,6 +228,73 @@ void FTL_READ(
 /* OUT */ VOID_PTR data,
 /* OUT */ RETURN_CODE * return_code);
 
+/*
+ * ПОДСКАЗКА ТЕМПЕРАТУРЫ ЛОГИЧЕСКИХ БЛОКОВ (хранится в ОЗУ до FTL_INIT):
+ *   LBI: Начальный логический номер блока
+ *   COUNT: Количество блоков
+ *   TEMPERATURE: Температура (горячие и холодные данные пишутся
+ *                в разные сектора)
+ *   return_code: Статус операции
+ *     NO_ERROR: Подсказка установлена
+ *     INVALID_PARAM: Параметры выходят за границу памяти
+ */
+void FTL_HINT(
+/* IN  */ const FTL_INDEX LBI,
+/* IN  */ const SIZE32 COUNT,
+/* IN  */ const FTL_TEMPERATURE TEMPERATURE,
+/* OUT */ RETURN_CODE * return_code);
+
+/*
+ * ОСВОБОЖДЕНИЕ ЛОГИЧЕСКИХ БЛОКОВ (данные больше не нужны файловой системе):
+ *   LBI: Начальный логический номер блока
+ *   COUNT: Количество блоков
+ *   return_code: Статус операции
+ *     NO_ERROR: Отображение снято, физические блоки устарели
+ *     INVALID_PARAM: Параметры выходят за границу памяти
+ *
+ * Сборщик мусора больше не переносит освобожденные блоки. Отметка
+ * хранится в ОЗУ: FTL_FREE стирает их до выключения, после сбоя питания
+ * блоки снова отображаются до следующей записи или освобождения.
+ */
+void FTL_DISCARD(
+/* IN  */ const FTL_INDEX LBI,
+/* IN  */ const SIZE32 COUNT,
+/* OUT */ RETURN_CODE * return_code);
+
+/*
+ * ОТОБРАЖЕНИЕ ЛОГИЧЕСКОГО БЛОКА В ПАМЯТЬ (только чтение):
+ *   LBI: Номер логического блока
+ *   data: Данные блока во flash (250 байт, действительны до FTL_VIEW_CLOSE)
+ *   return_code: Статус операции
+ *     NO_ERROR: CRC32 данных проверен, сектор блока не стирается
+ *               до FTL_VIEW_CLOSE
+ *     NO_ACTION: Данные хранятся не на месте (шифрование, сжатие, ошибка
+ *                ECC) или блока не существует - блок читается FTL_READ
+ *     INVALID_PARAM: Номер блока выходит за границу памяти
+ *     OPERATION_FAILED: Адрес блока вне flash
+ *     DEVICE_BUSY: Закрепление сектора блока оставит сборщику мусора
+ *                  меньше резерва и порога сборки
+ *
+ * Запись и освобождение блока не меняют отображенные данные: устаревший
+ * блок остается во flash, пока его сектор не сотрет сборщик мусора
+ * после FTL_VIEW_CLOSE. Отображения закрываются до FTL_FREE
+ */
+void FTL_VIEW_OPEN(
+/* IN  */ const FTL_INDEX LBI,
+/* OUT */ const U8 ** data,
+/* OUT */ RETURN_CODE * return_code);
+
+/*
+ * ЗАКРЫТИЕ ОТОБРАЖЕНИЯ БЛОКА:
+ *   DATA: Адрес внутри отображенного блока
+ *   return_code: Статус операции
+ *     NO_ERROR: Отображение закрыто
+ *     INVALID_PARAM: Адрес не принадлежит отображенному блоку
+ */
+void FTL_VIEW_CLOSE(
+/* IN  */ const U8 * DATA,
+/* OUT */ RETURN_CODE * return_code);
+
 
 /*
  * ЗАПУСК СБОРЩИКА МУСОРА (необходимо вызвать перед завершением):
@@ -80,4 +303,135 @@ void FTL_READ(
 void FTL_GARBAGE_COLLECT(
 /* OUT */ RETURN_CODE * return_code);
 
+/*
+ * ШАГ СБОРКИ МУСОРА (не более одного стирания сектора за вызов):
+ *   done: 1 - цикл сборки (все сектора и выравнивание износа) завершен,
+ *         0 - остались сектора для следующих шагов
+ *   return_code: Статус операции
+ *     NO_ERROR: Шаг выполнен
+ *     OPERATION_FAILED: Ошибка переноса или стирания
+ */
+void FTL_GARBAGE_COLLECT_STEP(
+/* OUT */ U8 * done,
+/* OUT */ RETURN_CODE * return_code);
+
+/*
+ * СОЗДАНИЕ СНИМКА (копия отображения в ОЗУ, данные не копируются):
+ *   id: Номер снимка
+ *   return_code: Статус операции
+ *     NO_ERROR: Снимок создан
+ *     NO_ACTION: Нет свободного места для снимка
+ *     OPERATION_FAILED: Ошибка записи
+ *
+ * Во flash записывается только порядковый номер записи на момент
+ * создания (служебная запись ключ-значение): FTL_INIT собирает
+ * отображение снимка из копий с меньшими номерами, поэтому снимок
+ * сохраняется после FTL_FREE и сбоя питания
+ */
+void FTL_SNAPSHOT_CREATE(
+/* OUT */ FTL_SNAPSHOT_ID * id,
+/* OUT */ RETURN_CODE * return_code);
+
+/*
+ * УДАЛЕНИЕ СНИМКА:
+ *   ID: Номер снимка
+ *   return_code: Статус операции
+ *     NO_ERROR: Снимок удален
+ *     INVALID_PARAM: Снимка не существует
+ *     NO_ACTION: Нет места для записи удаления
+ *     OPERATION_FAILED: Ошибка записи
+ */
+void FTL_SNAPSHOT_DELETE(
+/* IN  */ const FTL_SNAPSHOT_ID ID,
+/* OUT */ RETURN_CODE * return_code);
+
+/*
+ * ОТКАТ К СНИМКУ (снимок сохраняется):
+ *   ID: Номер снимка
+ *   return_code: Статус операции
+ *     NO_ERROR: Отображение заменено отображением снимка
+ *     INVALID_PARAM: Снимка не существует
+ *     NO_ACTION: Хранится FTL_ROLLBACKS_COUNT откатов (ненужные записи
+ *                откатов удаляет FTL_INIT) или нет места
+ *     OPERATION_FAILED: Ошибка записи
+ *
+ * Запись отката (номера копий, записанных после снимка) - точка
+ * фиксации: после сбоя питания FTL_INIT повторяет откат, до нее откат
+ * не выполнен
+ */
+void FTL_SNAPSHOT_ROLLBACK(
+/* IN  */ const FTL_SNAPSHOT_ID ID,
+/* OUT */ RETURN_CODE * return_code);
+
+/*
+ * ЗАПИСЬ ЗНАЧЕНИЯ КЛЮЧА:
+ *   KEY: Ключ
+ *   KEY_LENGTH: Длина ключа (1 - FTL_KV_KEY_SIZE)
+ *   VALUE: Значение
+ *   VALUE_LENGTH: Длина значения (не больше FTL_KV_VALUE_SIZE)
+ *   return_code: Статус операции
+ *     NO_ERROR: Значение записано
+ *     INVALID_PARAM: Длина ключа или значения выходит за границы
+ *     NO_ACTION: Индекс ключей заполнен или нет места
+ *     OPERATION_FAILED: Ошибка записи
+ *
+ * Записи ключ-значение дописываются в блоки, не отображаемые на
+ * логические блоки, одним программированием части блока. Индекс ключей
+ * хранится в ОЗУ и восстанавливается при FTL_INIT, устаревшие записи
+ * отбрасывает сборщик мусора. Снимки не включают хранилище (служебные
+ * записи снимков хранятся в своем пространстве ключей)
+ */
+void FTL_KV_PUT(
+/* IN  */ const VOID_PTR KEY,
+/* IN  */ const SIZE32 KEY_LENGTH,
+/* IN  */ const VOID_PTR VALUE,
+/* IN  */ const SIZE32 VALUE_LENGTH,
+/* OUT */ RETURN_CODE * return_code);
+
+/*
+ * ЧТЕНИЕ ЗНАЧЕНИЯ КЛЮЧА (одно чтение flash):
+ *   KEY: Ключ
+ *   KEY_LENGTH: Длина ключа (1 - FTL_KV_KEY_SIZE)
+ *   CAPACITY: Размер value
+ *   value: Значение
+ *   value_length: Длина значения
+ *   return_code: Статус операции
+ *     NO_ERROR: Значение прочитано
+ *     NO_ACTION: Ключа нет
+ *     INVALID_PARAM: Неверная длина ключа или значение больше CAPACITY
+ *                    (value_length - нужный размер)
+ *     OPERATION_FAILED: Запись повреждена
+ */
+void FTL_KV_GET(
+/* IN  */ const VOID_PTR KEY,
+/* IN  */ const SIZE32 KEY_LENGTH,
+/* IN  */ const SIZE32 CAPACITY,
+/* OUT */ VOID_PTR value,
+/* OUT */ SIZE32 * value_length,
+/* OUT */ RETURN_CODE * return_code);
+
+/*
+ * УДАЛЕНИЕ КЛЮЧА (дописывается запись удаления):
+ *   KEY: Ключ
+ *   KEY_LENGTH: Длина ключа (1 - FTL_KV_KEY_SIZE)
+ *   return_code: Статус операции
+ *     NO_ERROR: Ключ удален
+ *     NO_ACTION: Ключа нет или нет места
+ *     INVALID_PARAM: Неверная длина ключа
+ *     OPERATION_FAILED: Ошибка записи
+ */
+void FTL_KV_DELETE(
+/* IN  */ const VOID_PTR KEY,
+/* IN  */ const SIZE32 KEY_LENGTH,
+/* OUT */ RETURN_CODE * return_code);
+
+/*
+ * ПОЛУЧЕНИЕ СТАТИСТИКИ:
+ *   stats: Статистика
+ *   return_code: Статус операции
+ */
+void FTL_STATS(
+/* OUT */ FTL_STATS_TYPE * stats,
+/* OUT */ RETURN_CODE * return_code);
+
 #endif /* __FS_FTL_H__ */
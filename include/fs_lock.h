@@ -0,0 +1,146 @@
+#ifndef __FS_LOCK_H__
+#define __FS_LOCK_H__
+
+#include "fs_def.h"
+
+/*
+ * Потокобезопасность ФС и FTL (сборка для хоста). В однопоточной сборке
+ * для контроллера блокировки не компилируются
+ */
+#ifndef FS_THREAD_SAFE
+#ifdef __linux__
+#define FS_THREAD_SAFE 1U
+#else
+#define FS_THREAD_SAFE 0U
+#endif
+#endif
+
+/*
+ * ПОРЯДОК ЗАХВАТА (обратный порядок запрещен):
+ *   1. Том ФС (операции с одним дескриптором - совместно, операции,
+ *      меняющие чужие дескрипторы, - монопольно)
+ *   2. Дескриптор
+ *   3. Метаданные ФС
+ *   4. Отображение FTL (чтение - совместно, изменение - монопольно)
+ *
+ * Блокировки дескрипторов и метаданных рекурсивны: внутренние вызовы
+ * повторно захватывают уже захваченную блокировку. Том повторно
+ * не захватывается (учитывается глубина захвата потоком)
+ */
+#if FS_THREAD_SAFE
+
+#include <pthread.h>
+#include <unistd.h>
+
+typedef pthread_mutex_t FS_LOCK_TYPE;
+typedef pthread_rwlock_t FS_RWLOCK_TYPE;
+
+/*
+ * ИНИЦИАЛИЗАЦИЯ РЕКУРСИВНОЙ БЛОКИРОВКИ:
+ *   lock: Блокировка
+ */
+void FS_LOCK_INIT(
+/* OUT */ FS_LOCK_TYPE * lock);
+
+/*
+ * ИНИЦИАЛИЗАЦИЯ БЛОКИРОВКИ ЧТЕНИЯ/ЗАПИСИ (запись имеет приоритет):
+ *   lock: Блокировка
+ */
+void FS_RWLOCK_INIT(
+/* OUT */ FS_RWLOCK_TYPE * lock);
+
+/*
+ * ОСВОБОЖДЕНИЕ БЛОКИРОВКИ ПРИ ВЫХОДЕ ИЗ ОБЛАСТИ ВИДИМОСТИ:
+ *   lock: Переменная области с адресом блокировки
+ */
+void FS_LOCK_SCOPE_EXIT(
+/* IN  */ FS_LOCK_TYPE ** lock);
+
+/*
+ * ОСВОБОЖДЕНИЕ БЛОКИРОВКИ ЧТЕНИЯ/ЗАПИСИ ПРИ ВЫХОДЕ ИЗ ОБЛАСТИ ВИДИМОСТИ:
+ *   lock: Переменная области с адресом блокировки
+ */
+void FS_RWLOCK_SCOPE_EXIT(
+/* IN  */ FS_RWLOCK_TYPE ** lock);
+
+#define FS_LOCK_JOIN(a, b) a##b
+#define FS_LOCK_NAME(line) FS_LOCK_JOIN(m_scope_lock_, line)
+
+/*
+ * Захват до конца блока (освобождается при любом выходе, включая return)
+ */
+#define FS_LOCK_SCOPE(lock)                                                  \
+  FS_LOCK_TYPE * FS_LOCK_NAME(__LINE__)                                      \
+    __attribute__((cleanup(FS_LOCK_SCOPE_EXIT))) = (lock);                   \
+  pthread_mutex_lock(FS_LOCK_NAME(__LINE__))
+
+#define FS_RWLOCK_SCOPE_READ(lock)                                           \
+  FS_RWLOCK_TYPE * FS_LOCK_NAME(__LINE__)                                    \
+    __attribute__((cleanup(FS_RWLOCK_SCOPE_EXIT))) = (lock);                 \
+  pthread_rwlock_rdlock(FS_LOCK_NAME(__LINE__))
+
+#define FS_RWLOCK_SCOPE_WRITE(lock)                                          \
+  FS_RWLOCK_TYPE * FS_LOCK_NAME(__LINE__)                                    \
+    __attribute__((cleanup(FS_RWLOCK_SCOPE_EXIT))) = (lock);                 \
+  pthread_rwlock_wrlock(FS_LOCK_NAME(__LINE__))
+
+/*
+ * Явный захват (когда область не совпадает с блоком)
+ */
+#define FS_LOCK_ACQUIRE(lock) pthread_mutex_lock(lock)
+#define FS_LOCK_RELEASE(lock) pthread_mutex_unlock(lock)
+#define FS_RWLOCK_ACQUIRE_READ(lock) pthread_rwlock_rdlock(lock)
+#define FS_RWLOCK_ACQUIRE_WRITE(lock) pthread_rwlock_wrlock(lock)
+#define FS_RWLOCK_RELEASE(lock) pthread_rwlock_unlock(lock)
+
+/*
+ * Счетчик, изменяемый при совместном захвате
+ */
+#define FS_ATOMIC_INCREMENT(value) __sync_fetch_and_add(&(value), 1U)
+
+/*
+ * Сравнение с обменом (1 - значение было OLD и заменено на NEW)
+ */
+#define FS_ATOMIC_CAS(value, old, new)                                       \
+  __sync_bool_compare_and_swap(&(value), (old), (new))
+
+/*
+ * Чтение и запись значения, изменяемого через FS_ATOMIC_CAS
+ */
+#define FS_ATOMIC_LOAD(value) __atomic_load_n(&(value), __ATOMIC_ACQUIRE)
+#define FS_ATOMIC_STORE(value, new)                                          \
+  __atomic_store_n(&(value), (new), __ATOMIC_RELEASE)
+
+/*
+ * КОЛИЧЕСТВО ДОСТУПНЫХ ЯДЕР (по маске привязки вызывающего потока;
+ * потоки монтирования не запускаются на одном):
+ *   return: Количество ядер (не меньше 1)
+ */
+SIZE32 FS_CPU_COUNT(void);
+
+/*
+ * Переменная потока (выбранный потоком том)
+ */
+#define FS_THREAD_LOCAL __thread
+
+#else
+
+#define FS_LOCK_SCOPE(lock) ((void)0)
+#define FS_RWLOCK_SCOPE_READ(lock) ((void)0)
+#define FS_RWLOCK_SCOPE_WRITE(lock) ((void)0)
+#define FS_LOCK_ACQUIRE(lock) ((void)0)
+#define FS_LOCK_RELEASE(lock) ((void)0)
+#define FS_RWLOCK_ACQUIRE_READ(lock) ((void)0)
+#define FS_RWLOCK_ACQUIRE_WRITE(lock) ((void)0)
+#define FS_RWLOCK_RELEASE(lock) ((void)0)
+#define FS_ATOMIC_INCREMENT(value) ((value)++)
+#define FS_ATOMIC_CAS(value, old, new)                                       \
+  (((value) == (old)) ? ((value) = (new), 1U) : 0U)
+#define FS_ATOMIC_LOAD(value) (value)
+#define FS_ATOMIC_STORE(value, new) ((value) = (new))
+#define FS_CPU_COUNT() (1U)
+#define FS_THREAD_LOCAL
+
+#endif /* FS_THREAD_SAFE */
+
+#endif /* __FS_LOCK_H__ */
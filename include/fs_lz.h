@@ -0,0 +1,49 @@
+#ifndef __FS_LZ_H__
+#define __FS_LZ_H__
+
+#include "fs_def.h"
+
+/*
+ * Максимальное смещение совпадения (смещение хранится в одном байте)
+ */
+#define LZ_WINDOW_SIZE 255U
+
+/*
+ * СЖАТИЕ LZ (последовательности в стиле LZ4):
+ *   SRC: Исходные данные
+ *   SIZE: Размер исходных данных
+ *   CAPACITY: Размер буфера dest
+ *   dest: Сжатые данные
+ *   out_size: Размер сжатых данных
+ *   return_code: Статус операции
+ *     NO_ERROR: Данные сжаты
+ *     NO_ACTION: Сжатые данные не помещаются в CAPACITY байт
+ */
+void LZ_COMPRESS(
+/* IN  */ const VOID_PTR SRC,
+/* IN  */ const SIZE32 SIZE,
+/* IN  */ const SIZE32 CAPACITY,
+/* OUT */ VOID_PTR dest,
+/* OUT */ SIZE32 * out_size,
+/* OUT */ RETURN_CODE * return_code);
+
+/*
+ * РАСПАКОВКА LZ:
+ *   SRC: Сжатые данные
+ *   SIZE: Размер сжатых данных
+ *   CAPACITY: Размер буфера dest
+ *   dest: Распакованные данные
+ *   out_size: Размер распакованных данных
+ *   return_code: Статус операции
+ *     NO_ERROR: Данные распакованы
+ *     OPERATION_FAILED: Данные повреждены или не помещаются в CAPACITY байт
+ */
+void LZ_DECOMPRESS(
+/* IN  */ const VOID_PTR SRC,
+/* IN  */ const SIZE32 SIZE,
+/* IN  */ const SIZE32 CAPACITY,
+/* OUT */ VOID_PTR dest,
+/* OUT */ SIZE32 * out_size,
+/* OUT */ RETURN_CODE * return_code);
+
+#endif /* __FS_LZ_H__ */
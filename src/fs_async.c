@@ -0,0 +1,424 @@
+#include "fs_def.h"
+#include "fs_lock.h"
+#include "fs_ftl.h"
+#include "fs_driver.h"
+#include "fs_async.h"
+
+/*
+ * Рабочий поток выполнения запросов (сборка для хоста)
+ */
+#ifndef FS_ASYNC_THREAD
+#ifdef __linux__
+#define FS_ASYNC_THREAD 1U
+#else
+#define FS_ASYNC_THREAD 0U
+#endif
+#endif
+
+#if FS_ASYNC_THREAD
+#include <pthread.h>
+#endif
+
+/*
+ * Вызов из обработчика прерывания (Cortex-M: номер исключения в IPSR
+ * не 0). ФС и FTL не реентерабельны, поэтому запросы из прерывания
+ * не выполняются
+ */
+#if defined(__arm__) && defined(__ARM_ARCH_PROFILE) \
+  && (__ARM_ARCH_PROFILE == 'M')
+static inline U32 FS_ASYNC_IN_INTERRUPT(void)
+{
+  U32 m_ipsr;
+  __asm__ volatile("mrs %0, ipsr" : "=r"(m_ipsr));
+  return m_ipsr & 0x1FFU;
+}
+#else
+#define FS_ASYNC_IN_INTERRUPT() (0U)
+#endif
+
+/*
+ * Маска индекса кольца
+ */
+#define FS_ASYNC_MASK (FS_ASYNC_QUEUE_SIZE - 1U)
+
+/*
+ * Барьер памяти: элемент кольца записан до публикации индекса
+ */
+#define FS_ASYNC_BARRIER() __sync_synchronize()
+
+/*
+ * КОЛЬЦА ЗАПРОСОВ И ЗАВЕРШЕНИЙ (один писатель и один читатель у каждого):
+ *   requests: Очередь запросов
+ *   completions: Очередь завершений
+ *   request_head: Следующий выполняемый запрос (пишет исполнитель)
+ *   request_tail: Следующий свободный запрос (пишет приложение)
+ *   completion_head: Следующее забираемое завершение (пишет приложение)
+ *   completion_tail: Следующее свободное завершение (пишет исполнитель)
+ *   executing: Исполнитель выполняет запросы (повторный вход отклоняется)
+ *
+ * Запрос принимается, только если незабранных запросов меньше размера
+ * кольца, поэтому очередь завершений не переполняется
+ */
+typedef struct
+{
+  FS_ASYNC_REQUEST_TYPE requests[FS_ASYNC_QUEUE_SIZE];
+  FS_ASYNC_COMPLETION_TYPE completions[FS_ASYNC_QUEUE_SIZE];
+  volatile U32 request_head;
+  volatile U32 request_tail;
+  volatile U32 completion_head;
+  volatile U32 completion_tail;
+  volatile U32 executing;
+} FS_ASYNC_RINGS_TYPE;
+
+#if FS_ASYNC_THREAD
+/*
+ * РАБОЧИЙ ПОТОК:
+ *   thread: Поток
+ *   lock: Защищает ожидание (кольца от блокировки не зависят)
+ *   submitted: Появился запрос
+ *   completed: Появилось завершение
+ *   running: Поток запущен (0 - выполнить оставшиеся запросы и выйти)
+ */
+typedef struct
+{
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t submitted;
+  pthread_cond_t completed;
+  volatile U8 running;
+  U8 started;
+} FS_ASYNC_WORKER_TYPE;
+#endif
+
+/*
+ * ОЧЕРЕДИ ТОМА:
+ *   rings: Кольца запросов и завершений
+ *   worker: Рабочий поток (FS_ASYNC_THREAD)
+ */
+typedef struct
+{
+  FS_ASYNC_RINGS_TYPE rings;
+#if FS_ASYNC_THREAD
+  FS_ASYNC_WORKER_TYPE worker;
+#endif
+} FS_ASYNC_VOLUME_TYPE;
+
+/*
+ * Очереди асинхронного ввода/вывода томов (запросы выполняются в томе
+ * очереди, дескриптор другого тома отклоняется)
+ */
+static FS_ASYNC_VOLUME_TYPE g_fs_async_volumes[FS_VOLUMES_COUNT] =
+{
+#if FS_ASYNC_THREAD
+  [0U ... FS_VOLUMES_COUNT - 1U] =
+  {
+    .worker =
+    {
+      .lock = PTHREAD_MUTEX_INITIALIZER,
+      .submitted = PTHREAD_COND_INITIALIZER,
+      .completed = PTHREAD_COND_INITIALIZER
+    }
+  }
+#endif
+};
+
+/*
+ * ОЧЕРЕДИ ТОМА ВЫЗЫВАЮЩЕГО ПОТОКА:
+ *   return: Очереди тома
+ */
+static FS_ASYNC_VOLUME_TYPE * FS_ASYNC_CURRENT(void)
+{
+  VOLUME_ID m_volume;
+  FS_VOLUME_CURRENT(&m_volume);
+  return &g_fs_async_volumes[m_volume];
+}
+
+
+
+/*
+ * ВЫПОЛНЕНИЕ ЗАПРОСА:
+ *   REQUEST: Запрос
+ *   completion: Завершение
+ */
+static void FS_ASYNC_EXECUTE(
+/* IN  */ const FS_ASYNC_REQUEST_TYPE * REQUEST,
+/* OUT */ FS_ASYNC_COMPLETION_TYPE * completion)
+{
+  completion->user_data = REQUEST->user_data;
+  completion->length = 0U;
+  completion->return_code = NO_ERROR;
+  completion->file_error = (FILE_ERROR)0;
+
+  switch(REQUEST->op)
+  {
+    case FS_ASYNC_OP_READ:
+      FS_FILE_READ(
+        REQUEST->id, REQUEST->length, &completion->length, REQUEST->buffer,
+        &completion->return_code, &completion->file_error
+      );
+      break;
+    case FS_ASYNC_OP_WRITE:
+      FS_FILE_WRITE(
+        REQUEST->id, REQUEST->length, REQUEST->buffer,
+        &completion->return_code, &completion->file_error
+      );
+      if(NO_ERROR == completion->return_code)
+      {
+        completion->length = REQUEST->length;
+      }
+      break;
+    case FS_ASYNC_OP_SYNC:
+      FS_FILE_SYNC(
+        REQUEST->id, &completion->return_code, &completion->file_error
+      );
+      break;
+    case FS_ASYNC_OP_GC_STEP:
+    {
+      U8 m_done = 0U;
+      FTL_GARBAGE_COLLECT_STEP(&m_done, &completion->return_code);
+      completion->length = m_done;
+      break;
+    }
+  }
+}
+
+/*
+ * ВЫПОЛНЕНИЕ ЗАПРОСОВ ИСПОЛНИТЕЛЕМ:
+ *   async: Очереди тома (запросы выполняются в выбранном томе)
+ *   LIMIT: Наибольшее количество выполняемых запросов
+ *   return: Выполнено запросов (UN_SET - исполнитель уже работает)
+ */
+static SIZE32 FS_ASYNC_DRAIN(
+/* INOUT */ FS_ASYNC_VOLUME_TYPE * async,
+/* IN    */ const SIZE32 LIMIT)
+{
+  FS_ASYNC_RINGS_TYPE * m_rings = &(async->rings);
+
+  /* Прерывание, вошедшее во время выполнения, запросы не выполняет */
+  if(!FS_ATOMIC_CAS(m_rings->executing, 0U, 1U))
+  {
+    return UN_SET;
+  }
+
+  SIZE32 m_processed = 0U;
+  while((m_processed < LIMIT)
+  && (m_rings->request_head != m_rings->request_tail))
+  {
+    const U32 M_HEAD = m_rings->request_head;
+    const U32 M_TAIL = m_rings->completion_tail;
+    FS_ASYNC_EXECUTE(
+      &m_rings->requests[M_HEAD & FS_ASYNC_MASK],
+      &m_rings->completions[M_TAIL & FS_ASYNC_MASK]
+    );
+
+    FS_ASYNC_BARRIER();
+    m_rings->completion_tail = M_TAIL + 1U;
+    m_rings->request_head = M_HEAD + 1U;
+    m_processed++;
+
+#if FS_ASYNC_THREAD
+    pthread_mutex_lock(&(async->worker.lock));
+    pthread_cond_broadcast(&(async->worker.completed));
+    pthread_mutex_unlock(&(async->worker.lock));
+#endif
+  }
+
+  FS_ATOMIC_STORE(m_rings->executing, 0U);
+  return m_processed;
+}
+
+#if FS_ASYNC_THREAD
+/*
+ * ЦИКЛ РАБОЧЕГО ПОТОКА:
+ *   async: Очереди тома (FS_ASYNC_VOLUME_TYPE)
+ */
+static VOID_PTR FS_ASYNC_WORKER(
+/* INOUT */ VOID_PTR async)
+{
+  FS_ASYNC_VOLUME_TYPE * m_async = (FS_ASYNC_VOLUME_TYPE *)async;
+  FS_ASYNC_RINGS_TYPE * m_rings = &(m_async->rings);
+  FS_ASYNC_WORKER_TYPE * m_worker = &(m_async->worker);
+  RETURN_CODE m_select_error = NO_ERROR;
+  FS_VOLUME_SELECT(
+    (VOLUME_ID)(m_async - g_fs_async_volumes), &m_select_error
+  );
+  for(;;)
+  {
+    pthread_mutex_lock(&(m_worker->lock));
+    while(m_worker->running
+    && (m_rings->request_head == m_rings->request_tail))
+    {
+      pthread_cond_wait(&(m_worker->submitted), &(m_worker->lock));
+    }
+    const U8 M_EMPTY = (m_rings->request_head == m_rings->request_tail);
+    pthread_mutex_unlock(&(m_worker->lock));
+
+    if(M_EMPTY)
+    {
+      break;
+    }
+    FS_ASYNC_DRAIN(m_async, FS_ASYNC_QUEUE_SIZE);
+  }
+  return (VOID_PTR)(0);
+}
+#endif
+
+
+
+void FS_ASYNC_INIT(
+/* OUT */ RETURN_CODE * return_code)
+{
+  FS_ASYNC_VOLUME_TYPE * m_async = FS_ASYNC_CURRENT();
+  FS_ASYNC_RINGS_TYPE * m_rings = &(m_async->rings);
+  m_rings->request_head = 0U;
+  m_rings->request_tail = 0U;
+  m_rings->completion_head = 0U;
+  m_rings->completion_tail = 0U;
+  m_rings->executing = 0U;
+
+#if FS_ASYNC_THREAD
+  m_async->worker.running = 1U;
+  if(0 != pthread_create(
+    &(m_async->worker.thread), (VOID_PTR)(0), FS_ASYNC_WORKER, m_async))
+  {
+    m_async->worker.running = 0U;
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+  m_async->worker.started = 1U;
+#endif
+
+  *return_code = NO_ERROR;
+}
+
+void FS_ASYNC_FREE(
+/* OUT */ RETURN_CODE * return_code)
+{
+  FS_ASYNC_VOLUME_TYPE * m_async = FS_ASYNC_CURRENT();
+#if FS_ASYNC_THREAD
+  if(m_async->worker.started)
+  {
+    pthread_mutex_lock(&(m_async->worker.lock));
+    m_async->worker.running = 0U;
+    pthread_cond_signal(&(m_async->worker.submitted));
+    pthread_mutex_unlock(&(m_async->worker.lock));
+
+    pthread_join(m_async->worker.thread, (VOID_PTR *)(0));
+    m_async->worker.started = 0U;
+
+    *return_code = NO_ERROR;
+    return;
+  }
+#endif
+
+  FS_ASYNC_DRAIN(m_async, (SIZE32)UN_SET);
+  *return_code = NO_ERROR;
+}
+
+void FS_ASYNC_SUBMIT(
+/* IN  */ const FS_ASYNC_REQUEST_TYPE * REQUEST,
+/* OUT */ RETURN_CODE * return_code)
+{
+  FS_ASYNC_VOLUME_TYPE * m_async = FS_ASYNC_CURRENT();
+  FS_ASYNC_RINGS_TYPE * m_rings = &(m_async->rings);
+  if(REQUEST->op > FS_ASYNC_OP_GC_STEP)
+  {
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  /* Незабранные завершения занимают место в очереди */
+  const U32 M_TAIL = m_rings->request_tail;
+  if(M_TAIL - m_rings->completion_head >= FS_ASYNC_QUEUE_SIZE)
+  {
+    *return_code = NO_ACTION;
+    return;
+  }
+
+  m_rings->requests[M_TAIL & FS_ASYNC_MASK] = *REQUEST;
+  FS_ASYNC_BARRIER();
+  m_rings->request_tail = M_TAIL + 1U;
+
+#if FS_ASYNC_THREAD
+  pthread_mutex_lock(&(m_async->worker.lock));
+  pthread_cond_signal(&(m_async->worker.submitted));
+  pthread_mutex_unlock(&(m_async->worker.lock));
+#endif
+
+  *return_code = NO_ERROR;
+}
+
+void FS_ASYNC_PROCESS(
+/* IN  */ const SIZE32 LIMIT,
+/* OUT */ SIZE32 * processed,
+/* OUT */ RETURN_CODE * return_code)
+{
+  FS_ASYNC_VOLUME_TYPE * m_async = FS_ASYNC_CURRENT();
+  *processed = 0U;
+
+  if(FS_ASYNC_IN_INTERRUPT())
+  {
+    *return_code = ACCESS_DENIED;
+    return;
+  }
+#if FS_ASYNC_THREAD
+  if(m_async->worker.started)
+  {
+    *return_code = ACCESS_DENIED;
+    return;
+  }
+#endif
+
+  const SIZE32 M_PROCESSED = FS_ASYNC_DRAIN(m_async, LIMIT);
+  if(UN_SET == M_PROCESSED)
+  {
+    *return_code = DEVICE_BUSY;
+    return;
+  }
+  *processed = M_PROCESSED;
+  *return_code = NO_ERROR;
+}
+
+void FS_ASYNC_REAP(
+/* IN  */ const U8 WAIT,
+/* OUT */ FS_ASYNC_COMPLETION_TYPE * completion,
+/* OUT */ RETURN_CODE * return_code)
+{
+  FS_ASYNC_VOLUME_TYPE * m_async = FS_ASYNC_CURRENT();
+  FS_ASYNC_RINGS_TYPE * m_rings = &(m_async->rings);
+  const U32 M_HEAD = m_rings->completion_head;
+  if(WAIT && (M_HEAD != m_rings->request_tail))
+  {
+#if FS_ASYNC_THREAD
+    if(m_async->worker.started)
+    {
+      pthread_mutex_lock(&(m_async->worker.lock));
+      while(M_HEAD == m_rings->completion_tail)
+      {
+        pthread_cond_wait(
+          &(m_async->worker.completed), &(m_async->worker.lock)
+        );
+      }
+      pthread_mutex_unlock(&(m_async->worker.lock));
+    }
+#endif
+    /* Без рабочего потока запрос выполняется в вызывающем контексте
+     * (не в прерывании) */
+    if((M_HEAD == m_rings->completion_tail) && !FS_ASYNC_IN_INTERRUPT())
+    {
+      FS_ASYNC_DRAIN(m_async, 1U);
+    }
+  }
+
+  if(M_HEAD == m_rings->completion_tail)
+  {
+    *return_code = NO_ACTION;
+    return;
+  }
+
+  FS_ASYNC_BARRIER();
+  *completion = m_rings->completions[M_HEAD & FS_ASYNC_MASK];
+  m_rings->completion_head = M_HEAD + 1U;
+
+  *return_code = NO_ERROR;
+}
@@ -1,6 +1,871 @@
 #include "fs_def.h"
+#include "fs_lock.h"
 #include "fs_crypt.h"
 
+/*
+ * Инструкции AES-NI (x86, наличие проверяется при первом шифровании)
+ */
+#ifndef CRYPT_AES_NI
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CRYPT_AES_NI 1U
+#else
+#define CRYPT_AES_NI 0U
+#endif
+#endif
+
+#if CRYPT_AES_NI
+#include <wmmintrin.h>
+#endif
+
+/*
+ * Количество раундов AES-128
+ */
+#define CRYPT_ROUNDS 10U
+
+/*
+ * Ключи раундов AES-128 (11 x 16 байт)
+ */
+#define CRYPT_ROUND_KEYS_SIZE ((CRYPT_ROUNDS + 1U) * CRYPT_BLOCK_SIZE)
+
+/*
+ * Ключ по умолчанию (пример ключа FIPS-197)
+ */
+static const U8 g_crypt_default_key[CRYPT_KEY_SIZE] = {
+  0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6,
+  0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C
+};
+
+/*
+ * Метка ключа маски XTS (ключ маски - шифр метки основным ключом)
+ */
+static const U8 g_crypt_tweak_label[CRYPT_BLOCK_SIZE] = {
+  'F', 'S', ' ', 'X', 'T', 'S', ' ', 'T',
+  'W', 'E', 'A', 'K', ' ', 'K', 'E', 'Y'
+};
+
+/*
+ * Ключи раундов и признак их вычисления:
+ *   g_crypt_round_keys: Основной ключ (CTR, данные XTS)
+ *   g_crypt_tweak_keys: Ключ маски XTS
+ *   g_crypt_decrypt_keys: Основной ключ для AES-NI расшифровки (обратный
+ *                         порядок, InvMixColumns раундов 1-9)
+ */
+static U8 g_crypt_round_keys[CRYPT_ROUND_KEYS_SIZE];
+static U8 g_crypt_tweak_keys[CRYPT_ROUND_KEYS_SIZE];
+static U8 g_crypt_decrypt_keys[CRYPT_ROUND_KEYS_SIZE];
+static U8 g_crypt_key_ready = 0U;
+
+#if CRYPT_AES_NI
+/*
+ * Поддержка AES-NI процессором (UN_SET - не проверена)
+ */
+static U32 g_crypt_aes_ni = UN_SET;
+#endif
+
+#if FS_THREAD_SAFE
+/*
+ * Ключ по умолчанию устанавливается один раз (тома шифруют одновременно)
+ */
+static pthread_once_t g_crypt_once = PTHREAD_ONCE_INIT;
+#endif
+
+
+
+/*
+ * ОБНОВЛЕНИЕ CRC32 ОДНИМ БАЙТОМ:
+ *   CRC: Текущее значение
+ *   BYTE: Байт данных
+ *   return: Новое значение
+ */
+static U32 CRC_UPDATE(
+/* IN  */ U32 CRC,
+/* IN  */ const U8 BYTE);
+
+/*
+ * УМНОЖЕНИЕ НА x В GF(2^8):
+ *   VALUE: Множитель
+ *   return: Произведение
+ */
+static U8 AES_XTIME(
+/* IN  */ const U8 VALUE);
+
+/*
+ * ЗАМЕНА БАЙТОВ В БИТОВЫХ ПЛОСКОСТЯХ (схема Boyar-Peralta, 113 операций):
+ *   planes: Плоскости 16 байт (planes[b], бит i - бит b байта i)
+ *
+ * Таблица замен вычисляется логическими операциями над всеми байтами
+ * сразу: время и обращения к памяти не зависят от данных и ключа
+ */
+static void AES_SBOX_PLANES(
+/* INOUT */ U16 * planes);
+
+/*
+ * ОБРАТНОЕ АФФИННОЕ ПРЕОБРАЗОВАНИЕ AES В БИТОВЫХ ПЛОСКОСТЯХ
+ * (InvSubBytes = обратное аффинное, SubBytes, обратное аффинное):
+ *   planes: Плоскости 16 байт
+ */
+static void AES_INV_AFFINE_PLANES(
+/* INOUT */ U16 * planes);
+
+/*
+ * ЗАМЕНА БАЙТОВ (SubBytes / InvSubBytes, без таблиц):
+ *   state: Блок (16 байт)
+ *   DIRECTION: CRYPT_ENCRYPT - SubBytes, CRYPT_DECRYPT - InvSubBytes
+ */
+static void AES_SUB_BYTES(
+/* INOUT */ U8 * state,
+/* IN    */ const CRYPT_DIRECTION DIRECTION);
+
+/*
+ * ПЕРЕМЕШИВАНИЕ СТОЛБЦОВ (MixColumns / InvMixColumns):
+ *   state: Блок (16 байт, 4 столбца)
+ *   DIRECTION: CRYPT_ENCRYPT - MixColumns, CRYPT_DECRYPT - InvMixColumns
+ */
+static void AES_MIX_COLUMNS(
+/* INOUT */ U8 * state,
+/* IN    */ const CRYPT_DIRECTION DIRECTION);
+
+/*
+ * РАСШИРЕНИЕ КЛЮЧА AES-128 (FIPS-197):
+ *   KEY: Ключ (16 байт)
+ *   round_keys: Ключи раундов
+ */
+static void AES_KEY_EXPAND(
+/* IN  */ const U8 * KEY,
+/* OUT */ U8 * round_keys);
+
+/*
+ * ШИФРОВАНИЕ БЛОКА AES-128 (программно, постоянное время):
+ *   KEYS: Ключи раундов
+ *   block: Шифруемый блок (16 байт)
+ */
+static void AES_ENCRYPT_BLOCK(
+/* IN    */ const U8 * KEYS,
+/* INOUT */ U8 * block);
+
+/*
+ * РАСШИФРОВКА БЛОКА AES-128 (программно, обратный шифр FIPS-197,
+ * постоянное время):
+ *   block: Расшифровываемый блок (16 байт, основной ключ)
+ */
+static void AES_DECRYPT_BLOCK(
+/* INOUT */ U8 * block);
+
+#if CRYPT_AES_NI
+/*
+ * ШИФРОВАНИЕ БЛОКА AES-128 ИНСТРУКЦИЯМИ AES-NI:
+ *   KEYS: Ключи раундов
+ *   block: Шифруемый блок (16 байт)
+ */
+static void AES_NI_ENCRYPT_BLOCK(
+/* IN    */ const U8 * KEYS,
+/* INOUT */ U8 * block);
+
+/*
+ * РАСШИФРОВКА БЛОКА AES-128 ИНСТРУКЦИЯМИ AES-NI:
+ *   block: Расшифровываемый блок (16 байт, основной ключ)
+ */
+static void AES_NI_DECRYPT_BLOCK(
+/* INOUT */ U8 * block);
+#endif
+
+/*
+ * ШИФРОВАНИЕ ИЛИ РАСШИФРОВКА БЛОКА (AES-NI, если доступен):
+ *   KEYS: Ключи раундов шифрования (расшифровка - только основным ключом)
+ *   block: Блок (16 байт)
+ *   DIRECTION: Направление
+ */
+static void CRYPT_BLOCK(
+/* IN    */ const U8 * KEYS,
+/* INOUT */ U8 * block,
+/* IN    */ const CRYPT_DIRECTION DIRECTION);
+
+/*
+ * БЛОК XTS: маска, AES, маска:
+ *   block: Блок (16 байт)
+ *   MASK: Маска блока
+ *   DIRECTION: Направление
+ */
+static void XTS_BLOCK(
+/* INOUT */ U8 * block,
+/* IN    */ const U8 * MASK,
+/* IN    */ const CRYPT_DIRECTION DIRECTION);
+
+/*
+ * МАСКА СЛЕДУЮЩЕГО БЛОКА XTS (умножение на x в GF(2^128)):
+ *   mask: Маска
+ */
+static void XTS_MASK_NEXT(
+/* INOUT */ U8 * mask);
+
+/*
+ * КЛЮЧ ПО УМОЛЧАНИЮ И ПРОВЕРКА AES-NI (перед первым шифрованием)
+ */
+static void CRYPT_PREPARE(void);
+
+
+
+static U32 CRC_UPDATE(
+/* IN  */ U32 CRC,
+/* IN  */ const U8 BYTE)
+{
+  const U32 CRC32_POLYNOMIAL = 0x04C11DB7;
+
+  CRC ^= BYTE;
+
+  // Развернутый цикл
+  CRC = (CRC & 1) ? ((CRC >> 1) ^ CRC32_POLYNOMIAL) : (CRC >> 1);
+  CRC = (CRC & 1) ? ((CRC >> 1) ^ CRC32_POLYNOMIAL) : (CRC >> 1);
+  CRC = (CRC & 1) ? ((CRC >> 1) ^ CRC32_POLYNOMIAL) : (CRC >> 1);
+  CRC = (CRC & 1) ? ((CRC >> 1) ^ CRC32_POLYNOMIAL) : (CRC >> 1);
+  CRC = (CRC & 1) ? ((CRC >> 1) ^ CRC32_POLYNOMIAL) : (CRC >> 1);
+  CRC = (CRC & 1) ? ((CRC >> 1) ^ CRC32_POLYNOMIAL) : (CRC >> 1);
+  CRC = (CRC & 1) ? ((CRC >> 1) ^ CRC32_POLYNOMIAL) : (CRC >> 1);
+  CRC = (CRC & 1) ? ((CRC >> 1) ^ CRC32_POLYNOMIAL) : (CRC >> 1);
+
+  return CRC;
+}
+
+static U8 AES_XTIME(
+/* IN  */ const U8 VALUE)
+{
+  /* Без ветвления по старшему биту */
+  return (U8)((VALUE << 1U) ^ ((0U - (VALUE >> 7U)) & 0x1BU));
+}
+
+static void AES_SBOX_PLANES(
+/* INOUT */ U16 * planes)
+{
+  /* 1. Верхнее линейное преобразование (x0 - старший бит) */
+  const U16 X0 = planes[7];
+  const U16 X1 = planes[6];
+  const U16 X2 = planes[5];
+  const U16 X3 = planes[4];
+  const U16 X4 = planes[3];
+  const U16 X5 = planes[2];
+  const U16 X6 = planes[1];
+  const U16 X7 = planes[0];
+  const U16 Y14 = X3 ^ X5;
+  const U16 Y13 = X0 ^ X6;
+  const U16 Y9 = X0 ^ X3;
+  const U16 Y8 = X0 ^ X5;
+  const U16 T0 = X1 ^ X2;
+  const U16 Y1 = T0 ^ X7;
+  const U16 Y4 = Y1 ^ X3;
+  const U16 Y12 = Y13 ^ Y14;
+  const U16 Y2 = Y1 ^ X0;
+  const U16 Y5 = Y1 ^ X6;
+  const U16 Y3 = Y5 ^ Y8;
+  const U16 T1 = X4 ^ Y12;
+  const U16 Y15 = T1 ^ X5;
+  const U16 Y20 = T1 ^ X1;
+  const U16 Y6 = Y15 ^ X7;
+  const U16 Y10 = Y15 ^ T0;
+  const U16 Y11 = Y20 ^ Y9;
+  const U16 Y7 = X7 ^ Y11;
+  const U16 Y17 = Y10 ^ Y11;
+  const U16 Y19 = Y10 ^ Y8;
+  const U16 Y16 = T0 ^ Y11;
+  const U16 Y21 = Y13 ^ Y16;
+  const U16 Y18 = X0 ^ Y16;
+
+  /* 2. Нелинейная часть (обращение в GF(2^8) через GF(2^4)) */
+  const U16 T2 = Y12 & Y15;
+  const U16 T3 = Y3 & Y6;
+  const U16 T4 = T3 ^ T2;
+  const U16 T5 = Y4 & X7;
+  const U16 T6 = T5 ^ T2;
+  const U16 T7 = Y13 & Y16;
+  const U16 T8 = Y5 & Y1;
+  const U16 T9 = T8 ^ T7;
+  const U16 T10 = Y2 & Y7;
+  const U16 T11 = T10 ^ T7;
+  const U16 T12 = Y9 & Y11;
+  const U16 T13 = Y14 & Y17;
+  const U16 T14 = T13 ^ T12;
+  const U16 T15 = Y8 & Y10;
+  const U16 T16 = T15 ^ T12;
+  const U16 T17 = T4 ^ T14;
+  const U16 T18 = T6 ^ T16;
+  const U16 T19 = T9 ^ T14;
+  const U16 T20 = T11 ^ T16;
+  const U16 T21 = T17 ^ Y20;
+  const U16 T22 = T18 ^ Y19;
+  const U16 T23 = T19 ^ Y21;
+  const U16 T24 = T20 ^ Y18;
+  const U16 T25 = T21 ^ T22;
+  const U16 T26 = T21 & T23;
+  const U16 T27 = T24 ^ T26;
+  const U16 T28 = T25 & T27;
+  const U16 T29 = T28 ^ T22;
+  const U16 T30 = T23 ^ T24;
+  const U16 T31 = T22 ^ T26;
+  const U16 T32 = T31 & T30;
+  const U16 T33 = T32 ^ T24;
+  const U16 T34 = T23 ^ T33;
+  const U16 T35 = T27 ^ T33;
+  const U16 T36 = T24 & T35;
+  const U16 T37 = T36 ^ T34;
+  const U16 T38 = T27 ^ T36;
+  const U16 T39 = T29 & T38;
+  const U16 T40 = T25 ^ T39;
+  const U16 T41 = T40 ^ T37;
+  const U16 T42 = T29 ^ T33;
+  const U16 T43 = T29 ^ T40;
+  const U16 T44 = T33 ^ T37;
+  const U16 T45 = T42 ^ T41;
+  const U16 Z0 = T44 & Y15;
+  const U16 Z1 = T37 & Y6;
+  const U16 Z2 = T33 & X7;
+  const U16 Z3 = T43 & Y16;
+  const U16 Z4 = T40 & Y1;
+  const U16 Z5 = T29 & Y7;
+  const U16 Z6 = T42 & Y11;
+  const U16 Z7 = T45 & Y17;
+  const U16 Z8 = T41 & Y10;
+  const U16 Z9 = T44 & Y12;
+  const U16 Z10 = T37 & Y3;
+  const U16 Z11 = T33 & Y4;
+  const U16 Z12 = T43 & Y13;
+  const U16 Z13 = T40 & Y5;
+  const U16 Z14 = T29 & Y2;
+  const U16 Z15 = T42 & Y9;
+  const U16 Z16 = T45 & Y14;
+  const U16 Z17 = T41 & Y8;
+
+  /* 3. Нижнее линейное преобразование (с константой 0x63) */
+  const U16 T46 = Z15 ^ Z16;
+  const U16 T47 = Z10 ^ Z11;
+  const U16 T48 = Z5 ^ Z13;
+  const U16 T49 = Z9 ^ Z10;
+  const U16 T50 = Z2 ^ Z12;
+  const U16 T51 = Z2 ^ Z5;
+  const U16 T52 = Z7 ^ Z8;
+  const U16 T53 = Z0 ^ Z3;
+  const U16 T54 = Z6 ^ Z7;
+  const U16 T55 = Z16 ^ Z17;
+  const U16 T56 = Z12 ^ T48;
+  const U16 T57 = T50 ^ T53;
+  const U16 T58 = Z4 ^ T46;
+  const U16 T59 = Z3 ^ T54;
+  const U16 T60 = T46 ^ T57;
+  const U16 T61 = Z14 ^ T57;
+  const U16 T62 = T52 ^ T58;
+  const U16 T63 = T49 ^ T58;
+  const U16 T64 = Z4 ^ T59;
+  const U16 T65 = T61 ^ T62;
+  const U16 T66 = Z1 ^ T63;
+  const U16 T67 = T64 ^ T65;
+  const U16 S3 = T53 ^ T66;
+  planes[7] = T59 ^ T63;
+  planes[6] = (U16)(T64 ^ ~S3);
+  planes[5] = (U16)(T55 ^ ~T67);
+  planes[4] = S3;
+  planes[3] = T51 ^ T66;
+  planes[2] = T47 ^ T65;
+  planes[1] = (U16)(T56 ^ ~T62);
+  planes[0] = (U16)(T48 ^ ~T60);
+}
+
+static void AES_INV_AFFINE_PLANES(
+/* INOUT */ U16 * planes)
+{
+  /* Сложение с 0x63 и умножение на обратную матрицу аффинного
+   * преобразования */
+  const U16 Q0 = (U16)~planes[0];
+  const U16 Q1 = (U16)~planes[1];
+  const U16 Q2 = planes[2];
+  const U16 Q3 = planes[3];
+  const U16 Q4 = planes[4];
+  const U16 Q5 = (U16)~planes[5];
+  const U16 Q6 = (U16)~planes[6];
+  const U16 Q7 = planes[7];
+  planes[7] = Q1 ^ Q4 ^ Q6;
+  planes[6] = Q0 ^ Q3 ^ Q5;
+  planes[5] = Q7 ^ Q2 ^ Q4;
+  planes[4] = Q6 ^ Q1 ^ Q3;
+  planes[3] = Q5 ^ Q0 ^ Q2;
+  planes[2] = Q4 ^ Q7 ^ Q1;
+  planes[1] = Q3 ^ Q6 ^ Q0;
+  planes[0] = Q2 ^ Q5 ^ Q7;
+}
+
+static void AES_SUB_BYTES(
+/* INOUT */ U8 * state,
+/* IN    */ const CRYPT_DIRECTION DIRECTION)
+{
+  /* 1. Байты - в битовые плоскости */
+  U16 m_planes[8] = { 0U, 0U, 0U, 0U, 0U, 0U, 0U, 0U };
+  for(register U8 i = 0U; i < CRYPT_BLOCK_SIZE; i++)
+  {
+    for(register U8 b = 0U; b < 8U; b++)
+    {
+      m_planes[b] |= (U16)(((state[i] >> b) & 1U) << i);
+    }
+  }
+
+  /* 2. InvSubBytes(y) = A'(SubBytes(A'(y))), A' - обратное аффинное */
+  if(CRYPT_DECRYPT == DIRECTION)
+  {
+    AES_INV_AFFINE_PLANES(m_planes);
+  }
+  AES_SBOX_PLANES(m_planes);
+  if(CRYPT_DECRYPT == DIRECTION)
+  {
+    AES_INV_AFFINE_PLANES(m_planes);
+  }
+
+  /* 3. Битовые плоскости - в байты */
+  for(register U8 i = 0U; i < CRYPT_BLOCK_SIZE; i++)
+  {
+    U8 m_byte = 0U;
+    for(register U8 b = 0U; b < 8U; b++)
+    {
+      m_byte |= (U8)(((m_planes[b] >> i) & 1U) << b);
+    }
+    state[i] = m_byte;
+  }
+}
+
+static void AES_MIX_COLUMNS(
+/* INOUT */ U8 * state,
+/* IN    */ const CRYPT_DIRECTION DIRECTION)
+{
+  for(register U8 c = 0U; c < 4U; c++)
+  {
+    U8 * m_column = state + 4U * c;
+
+    /* InvMixColumns = MixColumns после умножения на {04}x^2 + {05} */
+    if(CRYPT_DECRYPT == DIRECTION)
+    {
+      const U8 M_EVEN = AES_XTIME(AES_XTIME(m_column[0] ^ m_column[2]));
+      const U8 M_ODD = AES_XTIME(AES_XTIME(m_column[1] ^ m_column[3]));
+      m_column[0] ^= M_EVEN;
+      m_column[1] ^= M_ODD;
+      m_column[2] ^= M_EVEN;
+      m_column[3] ^= M_ODD;
+    }
+
+    const U8 M_A0 = m_column[0];
+    const U8 M_A1 = m_column[1];
+    const U8 M_A2 = m_column[2];
+    const U8 M_A3 = m_column[3];
+    const U8 M_ALL = M_A0 ^ M_A1 ^ M_A2 ^ M_A3;
+    m_column[0] = M_A0 ^ M_ALL ^ AES_XTIME(M_A0 ^ M_A1);
+    m_column[1] = M_A1 ^ M_ALL ^ AES_XTIME(M_A1 ^ M_A2);
+    m_column[2] = M_A2 ^ M_ALL ^ AES_XTIME(M_A2 ^ M_A3);
+    m_column[3] = M_A3 ^ M_ALL ^ AES_XTIME(M_A3 ^ M_A0);
+  }
+}
+
+static void AES_KEY_EXPAND(
+/* IN  */ const U8 * KEY,
+/* OUT */ U8 * round_keys)
+{
+  for(register U8 i = 0U; i < CRYPT_KEY_SIZE; i++)
+  {
+    round_keys[i] = KEY[i];
+  }
+
+  /* Слово = 4 байта */
+  U8 m_rcon = 0x01U;
+  for(register U8 i = CRYPT_KEY_SIZE; i < CRYPT_ROUND_KEYS_SIZE; i += 4U)
+  {
+    U8 m_word[4];
+    for(register U8 j = 0U; j < 4U; j++)
+    {
+      m_word[j] = round_keys[i - 4U + j];
+    }
+    if(0U == (i % CRYPT_KEY_SIZE))
+    {
+      /* RotWord + SubWord (замена - в первых 4 байтах блока) */
+      U8 m_rotated[CRYPT_BLOCK_SIZE];
+      for(register U8 j = 0U; j < CRYPT_BLOCK_SIZE; j++)
+      {
+        m_rotated[j] = (j < 4U) ? m_word[(j + 1U) % 4U] : 0U;
+      }
+      AES_SUB_BYTES(m_rotated, CRYPT_ENCRYPT);
+      m_word[0] = m_rotated[0] ^ m_rcon;
+      m_word[1] = m_rotated[1];
+      m_word[2] = m_rotated[2];
+      m_word[3] = m_rotated[3];
+      m_rcon = AES_XTIME(m_rcon);
+    }
+    for(register U8 j = 0U; j < 4U; j++)
+    {
+      round_keys[i + j] = round_keys[i - CRYPT_KEY_SIZE + j] ^ m_word[j];
+    }
+  }
+}
+
+static void AES_ENCRYPT_BLOCK(
+/* IN    */ const U8 * KEYS,
+/* INOUT */ U8 * block)
+{
+  for(register U8 i = 0U; i < CRYPT_BLOCK_SIZE; i++)
+  {
+    block[i] ^= KEYS[i];
+  }
+
+  for(register U8 round = 1U; round <= CRYPT_ROUNDS; round++)
+  {
+    /* 1. ShiftRows (строка r сдвигается влево на r) + SubBytes */
+    U8 m_state[CRYPT_BLOCK_SIZE];
+    for(register U8 i = 0U; i < CRYPT_BLOCK_SIZE; i++)
+    {
+      const U8 M_ROW = i % 4U;
+      const U8 M_COLUMN = i / 4U;
+      m_state[i] = block[M_ROW + 4U * ((M_COLUMN + M_ROW) % 4U)];
+    }
+    AES_SUB_BYTES(m_state, CRYPT_ENCRYPT);
+
+    /* 2. MixColumns (кроме последнего раунда) */
+    if(CRYPT_ROUNDS != round)
+    {
+      AES_MIX_COLUMNS(m_state, CRYPT_ENCRYPT);
+    }
+
+    /* 3. AddRoundKey */
+    for(register U8 i = 0U; i < CRYPT_BLOCK_SIZE; i++)
+    {
+      block[i] = m_state[i] ^ KEYS[round * CRYPT_BLOCK_SIZE + i];
+    }
+  }
+}
+
+static void AES_DECRYPT_BLOCK(
+/* INOUT */ U8 * block)
+{
+  for(register U8 i = 0U; i < CRYPT_BLOCK_SIZE; i++)
+  {
+    block[i] ^= g_crypt_round_keys[CRYPT_ROUNDS * CRYPT_BLOCK_SIZE + i];
+  }
+
+  for(register U8 round = CRYPT_ROUNDS; round > 0U; round--)
+  {
+    /* 1. InvShiftRows + InvSubBytes (строка r сдвигается вправо на r) */
+    U8 m_state[CRYPT_BLOCK_SIZE];
+    for(register U8 i = 0U; i < CRYPT_BLOCK_SIZE; i++)
+    {
+      const U8 M_ROW = i % 4U;
+      const U8 M_COLUMN = i / 4U;
+      m_state[i] = block[M_ROW + 4U * ((M_COLUMN + 4U - M_ROW) % 4U)];
+    }
+    AES_SUB_BYTES(m_state, CRYPT_DECRYPT);
+
+    /* 2. AddRoundKey */
+    for(register U8 i = 0U; i < CRYPT_BLOCK_SIZE; i++)
+    {
+      m_state[i] ^= g_crypt_round_keys[(round - 1U) * CRYPT_BLOCK_SIZE + i];
+    }
+
+    /* 3. InvMixColumns (кроме последнего раунда) */
+    if(1U != round)
+    {
+      AES_MIX_COLUMNS(m_state, CRYPT_DECRYPT);
+    }
+    for(register U8 i = 0U; i < CRYPT_BLOCK_SIZE; i++)
+    {
+      block[i] = m_state[i];
+    }
+  }
+}
+
+#if CRYPT_AES_NI
+__attribute__((target("aes,sse2")))
+static void AES_NI_ENCRYPT_BLOCK(
+/* IN    */ const U8 * KEYS,
+/* INOUT */ U8 * block)
+{
+  const __m128i * M_KEYS = (const __m128i *)KEYS;
+  __m128i m_state = _mm_loadu_si128((const __m128i *)block);
+  m_state = _mm_xor_si128(m_state, _mm_loadu_si128(M_KEYS));
+  for(register U8 round = 1U; round < CRYPT_ROUNDS; round++)
+  {
+    m_state = _mm_aesenc_si128(m_state, _mm_loadu_si128(M_KEYS + round));
+  }
+  m_state = _mm_aesenclast_si128(
+    m_state, _mm_loadu_si128(M_KEYS + CRYPT_ROUNDS)
+  );
+  _mm_storeu_si128((__m128i *)block, m_state);
+}
+
+__attribute__((target("aes,sse2")))
+static void AES_NI_DECRYPT_BLOCK(
+/* INOUT */ U8 * block)
+{
+  const __m128i * M_KEYS = (const __m128i *)g_crypt_decrypt_keys;
+  __m128i m_state = _mm_loadu_si128((const __m128i *)block);
+  m_state = _mm_xor_si128(m_state, _mm_loadu_si128(M_KEYS));
+  for(register U8 round = 1U; round < CRYPT_ROUNDS; round++)
+  {
+    m_state = _mm_aesdec_si128(m_state, _mm_loadu_si128(M_KEYS + round));
+  }
+  m_state = _mm_aesdeclast_si128(
+    m_state, _mm_loadu_si128(M_KEYS + CRYPT_ROUNDS)
+  );
+  _mm_storeu_si128((__m128i *)block, m_state);
+}
+#endif
+
+static void CRYPT_BLOCK(
+/* IN    */ const U8 * KEYS,
+/* INOUT */ U8 * block,
+/* IN    */ const CRYPT_DIRECTION DIRECTION)
+{
+#if CRYPT_AES_NI
+  if(g_crypt_aes_ni)
+  {
+    if(CRYPT_ENCRYPT == DIRECTION)
+    {
+      AES_NI_ENCRYPT_BLOCK(KEYS, block);
+    }
+    else
+    {
+      AES_NI_DECRYPT_BLOCK(block);
+    }
+    return;
+  }
+#endif
+  if(CRYPT_ENCRYPT == DIRECTION)
+  {
+    AES_ENCRYPT_BLOCK(KEYS, block);
+  }
+  else
+  {
+    AES_DECRYPT_BLOCK(block);
+  }
+}
+
+static void XTS_BLOCK(
+/* INOUT */ U8 * block,
+/* IN    */ const U8 * MASK,
+/* IN    */ const CRYPT_DIRECTION DIRECTION)
+{
+  for(register U8 i = 0U; i < CRYPT_BLOCK_SIZE; i++)
+  {
+    block[i] ^= MASK[i];
+  }
+  CRYPT_BLOCK(g_crypt_round_keys, block, DIRECTION);
+  for(register U8 i = 0U; i < CRYPT_BLOCK_SIZE; i++)
+  {
+    block[i] ^= MASK[i];
+  }
+}
+
+static void XTS_MASK_NEXT(
+/* INOUT */ U8 * mask)
+{
+  /* Байт 0 - младший, перенос из старшего бита: x^128 = x^7 + x^2 + x + 1 */
+  const U8 M_CARRY = mask[CRYPT_BLOCK_SIZE - 1U] >> 7U;
+  for(register U8 i = CRYPT_BLOCK_SIZE - 1U; i > 0U; i--)
+  {
+    mask[i] = (U8)((mask[i] << 1U) | (mask[i - 1U] >> 7U));
+  }
+  mask[0] = (U8)((mask[0] << 1U) ^ ((0U - M_CARRY) & 0x87U));
+}
+
+static void CRYPT_PREPARE(void)
+{
+  if(!g_crypt_key_ready)
+  {
+    CRYPT_KEY_SET(g_crypt_default_key);
+  }
+#if CRYPT_AES_NI
+  if(UN_SET == g_crypt_aes_ni)
+  {
+    g_crypt_aes_ni = __builtin_cpu_supports("aes") ? 1U : 0U;
+  }
+#endif
+}
+
+
+void CRYPT_KEY_SET(
+/* IN  */ const U8 * KEY)
+{
+  AES_KEY_EXPAND(KEY, g_crypt_round_keys);
+
+  /* Ключ маски XTS выводится из основного ключа */
+  U8 m_tweak_key[CRYPT_KEY_SIZE];
+  for(register U8 i = 0U; i < CRYPT_KEY_SIZE; i++)
+  {
+    m_tweak_key[i] = g_crypt_tweak_label[i];
+  }
+  AES_ENCRYPT_BLOCK(g_crypt_round_keys, m_tweak_key);
+  AES_KEY_EXPAND(m_tweak_key, g_crypt_tweak_keys);
+
+  /* Ключи расшифровки AES-NI: обратный порядок, InvMixColumns раундов 1-9 */
+  for(register U8 round = 0U; round <= CRYPT_ROUNDS; round++)
+  {
+    U8 * m_key = g_crypt_decrypt_keys + round * CRYPT_BLOCK_SIZE;
+    for(register U8 i = 0U; i < CRYPT_BLOCK_SIZE; i++)
+    {
+      m_key[i]
+        = g_crypt_round_keys[(CRYPT_ROUNDS - round) * CRYPT_BLOCK_SIZE + i];
+    }
+    if((0U != round) && (CRYPT_ROUNDS != round))
+    {
+      AES_MIX_COLUMNS(m_key, CRYPT_DECRYPT);
+    }
+  }
+
+  g_crypt_key_ready = 1U;
+}
+
+void CRYPT_CTR(
+/* INOUT */ VOID_PTR data,
+/* IN    */ const SIZE32 SIZE,
+/* IN    */ const U32 TWEAK,
+/* IN    */ const U32 DOMAIN,
+/* IN    */ const CRYPT_DIRECTION DIRECTION,
+/* OUT   */ U32 * crc)
+{
+  const U32 CRC32_INITIAL    = 0xFFFFFFFF;
+  const U32 CRC32_FINAL_XOR  = 0xFFFFFFFF;
+
+#if FS_THREAD_SAFE
+  pthread_once(&g_crypt_once, CRYPT_PREPARE);
+#else
+  CRYPT_PREPARE();
+#endif
+
+  U8 * m_data = (U8 *)data;
+  U32 m_crc = CRC32_INITIAL;
+  for(register SIZE32 offset = 0U; offset < SIZE; offset += CRYPT_BLOCK_SIZE)
+  {
+    /* 1. Блок потока ключей */
+    const U32 M_COUNTER = offset / CRYPT_BLOCK_SIZE;
+    U8 m_stream[CRYPT_BLOCK_SIZE] = {
+      (U8)(TWEAK >> 24U), (U8)(TWEAK >> 16U), (U8)(TWEAK >> 8U), (U8)TWEAK,
+      (U8)(DOMAIN >> 24U), (U8)(DOMAIN >> 16U), (U8)(DOMAIN >> 8U), (U8)DOMAIN,
+      0U, 0U, 0U, 0U,
+      (U8)(M_COUNTER >> 24U), (U8)(M_COUNTER >> 16U),
+      (U8)(M_COUNTER >> 8U), (U8)M_COUNTER
+    };
+    CRYPT_BLOCK(g_crypt_round_keys, m_stream, CRYPT_ENCRYPT);
+
+    /* 2. Наложение и CRC32 открытых данных в том же проходе */
+    const SIZE32 M_COUNT
+      = (SIZE - offset < CRYPT_BLOCK_SIZE) ? SIZE - offset : CRYPT_BLOCK_SIZE;
+    U8 * m_chunk = m_data + offset;
+    for(register SIZE32 i = 0U; i < M_COUNT; i++)
+    {
+      if(CRYPT_ENCRYPT == DIRECTION)
+      {
+        m_crc = CRC_UPDATE(m_crc, m_chunk[i]);
+        m_chunk[i] ^= m_stream[i];
+      }
+      else
+      {
+        m_chunk[i] ^= m_stream[i];
+        m_crc = CRC_UPDATE(m_crc, m_chunk[i]);
+      }
+    }
+  }
+
+  *crc = m_crc ^ CRC32_FINAL_XOR;
+}
+
+void CRYPT_XTS(
+/* INOUT */ VOID_PTR data,
+/* IN    */ const SIZE32 SIZE,
+/* IN    */ const U32 TWEAK,
+/* IN    */ const U32 DOMAIN,
+/* IN    */ const CRYPT_DIRECTION DIRECTION,
+/* OUT   */ U32 * crc)
+{
+  const U32 CRC32_INITIAL    = 0xFFFFFFFF;
+  const U32 CRC32_FINAL_XOR  = 0xFFFFFFFF;
+
+#if FS_THREAD_SAFE
+  pthread_once(&g_crypt_once, CRYPT_PREPARE);
+#else
+  CRYPT_PREPARE();
+#endif
+
+  /* 1. Маска первого блока - номер сектора, зашифрованный ключом маски */
+  U8 m_mask[CRYPT_BLOCK_SIZE] = {
+    (U8)(TWEAK >> 24U), (U8)(TWEAK >> 16U), (U8)(TWEAK >> 8U), (U8)TWEAK,
+    (U8)(DOMAIN >> 24U), (U8)(DOMAIN >> 16U), (U8)(DOMAIN >> 8U), (U8)DOMAIN,
+    0U, 0U, 0U, 0U, 0U, 0U, 0U, 0U
+  };
+  CRYPT_BLOCK(g_crypt_tweak_keys, m_mask, CRYPT_ENCRYPT);
+
+  /* 2. Полные блоки (при неполном хвосте - кроме последнего полного) и
+   * CRC32 открытых данных в том же проходе */
+  U8 * m_data = (U8 *)data;
+  U32 m_crc = CRC32_INITIAL;
+  const SIZE32 M_TAIL = SIZE % CRYPT_BLOCK_SIZE;
+  const SIZE32 M_BLOCKS = SIZE / CRYPT_BLOCK_SIZE - ((0U != M_TAIL) ? 1U : 0U);
+  for(register SIZE32 b = 0U; b < M_BLOCKS; b++)
+  {
+    U8 * m_block = m_data + b * CRYPT_BLOCK_SIZE;
+    for(register U8 i = 0U;
+      (CRYPT_ENCRYPT == DIRECTION) && (i < CRYPT_BLOCK_SIZE); i++)
+    {
+      m_crc = CRC_UPDATE(m_crc, m_block[i]);
+    }
+    XTS_BLOCK(m_block, m_mask, DIRECTION);
+    for(register U8 i = 0U;
+      (CRYPT_DECRYPT == DIRECTION) && (i < CRYPT_BLOCK_SIZE); i++)
+    {
+      m_crc = CRC_UPDATE(m_crc, m_block[i]);
+    }
+    XTS_MASK_NEXT(m_mask);
+  }
+
+  /* 3. Перенос шифротекста (ciphertext stealing): последний полный блок
+   * и хвост меняются местами, длина данных сохраняется */
+  if(0U != M_TAIL)
+  {
+    U8 * m_last = m_data + M_BLOCKS * CRYPT_BLOCK_SIZE;
+    U8 * m_tail = m_last + CRYPT_BLOCK_SIZE;
+    U8 m_next_mask[CRYPT_BLOCK_SIZE];
+    for(register U8 i = 0U; i < CRYPT_BLOCK_SIZE; i++)
+    {
+      m_next_mask[i] = m_mask[i];
+    }
+    XTS_MASK_NEXT(m_next_mask);
+
+    for(register SIZE32 i = 0U; (CRYPT_ENCRYPT == DIRECTION)
+      && (i < CRYPT_BLOCK_SIZE + M_TAIL); i++)
+    {
+      m_crc = CRC_UPDATE(m_crc, m_last[i]);
+    }
+    U8 m_block[CRYPT_BLOCK_SIZE];
+    for(register U8 i = 0U; i < CRYPT_BLOCK_SIZE; i++)
+    {
+      m_block[i] = m_last[i];
+    }
+    XTS_BLOCK(
+      m_block, (CRYPT_ENCRYPT == DIRECTION) ? m_mask : m_next_mask, DIRECTION
+    );
+    U8 m_stolen[CRYPT_BLOCK_SIZE];
+    for(register U8 i = 0U; i < CRYPT_BLOCK_SIZE; i++)
+    {
+      m_stolen[i] = (i < M_TAIL) ? m_tail[i] : m_block[i];
+    }
+    for(register U8 i = 0U; i < M_TAIL; i++)
+    {
+      m_tail[i] = m_block[i];
+    }
+    XTS_BLOCK(
+      m_stolen, (CRYPT_ENCRYPT == DIRECTION) ? m_next_mask : m_mask, DIRECTION
+    );
+    for(register U8 i = 0U; i < CRYPT_BLOCK_SIZE; i++)
+    {
+      m_last[i] = m_stolen[i];
+    }
+    for(register SIZE32 i = 0U; (CRYPT_DECRYPT == DIRECTION)
+      && (i < CRYPT_BLOCK_SIZE + M_TAIL); i++)
+    {
+      m_crc = CRC_UPDATE(m_crc, m_last[i]);
+    }
+  }
+
+  *crc = m_crc ^ CRC32_FINAL_XOR;
+}
+
 void CRYPT_XOR(
 /* INOUT */ VOID_PTR data,
 /* IN    */ const SIZE32 SIZE,
@@ -30,7 +895,7 @@ void CRYPT_XOR(
   }
 
   // Циклическое шифрование
-  for(register U8 i = 0U; i < SIZE; i++)
+  for(register SIZE32 i = 0U; i < SIZE; i++)
   {
     if(((U8 *)data)[i] == 0xFF)
     {
@@ -47,24 +912,13 @@ void HASH_CRC(
 /* IN  */ const SIZE32 SIZE,
 /* OUT */ U32 * crc)
 {
-  const U32 CRC32_POLYNOMIAL = 0x04C11DB7;
   const U32 CRC32_INITIAL    = 0xFFFFFFFF;
   const U32 CRC32_FINAL_XOR  = 0xFFFFFFFF;
 
   U32 m_crc = CRC32_INITIAL;
   for(register SIZE32 i = 0UL; i < SIZE; i++)
   {
-    m_crc ^= ((U8 *)DATA)[i];
-
-    // Развернутый цикл
-    m_crc = (m_crc & 1) ? ((m_crc >> 1) ^ CRC32_POLYNOMIAL) : (m_crc >> 1);
-    m_crc = (m_crc & 1) ? ((m_crc >> 1) ^ CRC32_POLYNOMIAL) : (m_crc >> 1);
-    m_crc = (m_crc & 1) ? ((m_crc >> 1) ^ CRC32_POLYNOMIAL) : (m_crc >> 1);
-    m_crc = (m_crc & 1) ? ((m_crc >> 1) ^ CRC32_POLYNOMIAL) : (m_crc >> 1);
-    m_crc = (m_crc & 1) ? ((m_crc >> 1) ^ CRC32_POLYNOMIAL) : (m_crc >> 1);
-    m_crc = (m_crc & 1) ? ((m_crc >> 1) ^ CRC32_POLYNOMIAL) : (m_crc >> 1);
-    m_crc = (m_crc & 1) ? ((m_crc >> 1) ^ CRC32_POLYNOMIAL) : (m_crc >> 1);
-    m_crc = (m_crc & 1) ? ((m_crc >> 1) ^ CRC32_POLYNOMIAL) : (m_crc >> 1);
+    m_crc = CRC_UPDATE(m_crc, ((U8 *)DATA)[i]);
   }
 
   *crc = m_crc ^ CRC32_FINAL_XOR;
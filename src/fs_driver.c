@@ -2,6 +2,7 @@
 #include "fs_std.h"
 #include "fs_crypt.h"
 #include "fs_ftl.h"
+#include "fs_lock.h"
 #include "fs_driver.h"
 
 /*
@@ -25,20 +26,186 @@
 #define FS_FILES_COUNT 2000U
 
 /*
- * Количество файловых дескрипторов (открытые файлы)
+ * Количество файловых дескрипторов (открытые файлы; дескриптор занимает
+ * около 400 байт ОЗУ)
  */
+#ifndef FS_DESCRIPTORS_COUNT
+#ifdef __linux__
 #define FS_DESCRIPTORS_COUNT 128U
+#else
+#define FS_DESCRIPTORS_COUNT 32U
+#endif
+#endif
+
+/*
+ * Дескриптор файла: младшие биты - ячейка таблицы, средние - том,
+ * старшие - поколение ячейки (меняется при закрытии, устаревший
+ * дескриптор отклоняется; дескриптор другого тома тоже отклоняется)
+ */
+#define FS_DESCRIPTOR_SLOT_BITS 7U
+#define FS_DESCRIPTOR_SLOT_MASK ((1U << FS_DESCRIPTOR_SLOT_BITS) - 1U)
+#if FS_DESCRIPTORS_COUNT > (1U << FS_DESCRIPTOR_SLOT_BITS)
+#error "FS_DESCRIPTORS_COUNT does not fit FS_DESCRIPTOR_SLOT_BITS"
+#endif
+#if FS_VOLUMES_COUNT <= 1U
+#define FS_DESCRIPTOR_VOLUME_BITS 0U
+#elif FS_VOLUMES_COUNT <= 2U
+#define FS_DESCRIPTOR_VOLUME_BITS 1U
+#elif FS_VOLUMES_COUNT <= 4U
+#define FS_DESCRIPTOR_VOLUME_BITS 2U
+#elif FS_VOLUMES_COUNT <= 8U
+#define FS_DESCRIPTOR_VOLUME_BITS 3U
+#else
+#error "FS_VOLUMES_COUNT does not fit FS_DESCRIPTOR_VOLUME_BITS"
+#endif
+#define FS_DESCRIPTOR_VOLUME_MASK ((1U << FS_DESCRIPTOR_VOLUME_BITS) - 1U)
+#define FS_DESCRIPTOR_GENERATION_SHIFT                                       \
+  (FS_DESCRIPTOR_SLOT_BITS + FS_DESCRIPTOR_VOLUME_BITS)
+
+/*
+ * Количество поколений ячейки (последнее поколение последней ячейки
+ * совпало бы с UN_SET)
+ */
+#define FS_DESCRIPTOR_GENERATIONS (0xFFFFU >> FS_DESCRIPTOR_GENERATION_SHIFT)
+
+/*
+ * Файл открыт дескриптором записи (иначе - количество дескрипторов чтения)
+ */
+#define FS_OPEN_WRITER 0xFFU
+
+/*
+ * Максимальный размер окна упреждающего чтения (блоков)
+ */
+#define FS_READAHEAD_SIZE 4U
+
+/*
+ * Количество окон упреждающего чтения (выдаются дескрипторам по запросу,
+ * окно занимает 1250 байт ОЗУ)
+ */
+#ifndef FS_READAHEAD_COUNT
+#ifdef __linux__
+#define FS_READAHEAD_COUNT 8U
+#else
+#define FS_READAHEAD_COUNT 2U
+#endif
+#endif
 
 /*
  * Магическое число суперблока
  */
 #define FS_MAGIC 0x46534653U
 
+/*
+ * Версия разметки flash (при несовпадении ФС форматируется)
+ */
+#define FS_VERSION 6U
+
+/*
+ * LBI карты занятых номеров файлов
+ */
+#define FS_FILEMAP_LBI 5U
+
+/*
+ * LBI индекса тегов (по блоку на тег)
+ */
+#define FS_TAGINDEX_LBI 610U
+
+/*
+ * LBI журнала метаданных и количество блоков в нем
+ */
+#define FS_JOURNAL_LBI 662U
+#define FS_JOURNAL_COUNT 8U
+
+/*
+ * Служебные записи журнала (LBI вне тома, у записи освобождения в данных
+ * LBI первого блока цепочки и количество блоков, у обрыва - LBI блока,
+ * по 2 байта)
+ */
+#define FS_JOURNAL_MARK_COMMIT 0xFFFFU
+#define FS_JOURNAL_MARK_ABORT 0xFFFEU
+#define FS_JOURNAL_MARK_FREE 0xFFFDU
+#define FS_JOURNAL_MARK_CUT 0xFFFCU
+
+/*
+ * Размер журнала отмены открытой транзакции (прежние значения измененных
+ * байтов; изменение, не помещающееся в него, отклоняется)
+ */
+#ifndef FS_JOURNAL_UNDO_SIZE
+#ifdef __linux__
+#define FS_JOURNAL_UNDO_SIZE 1024U
+#else
+#define FS_JOURNAL_UNDO_SIZE 640U
+#endif
+#endif
+
+/*
+ * LBI таблицы счетчиков ссылок на блоки (3968 байт)
+ */
+#define FS_REFS_LBI 670U
+#define FS_REFS_COUNT ((FS_BLOCKS_COUNT + FS_BLOCK_SIZE - 1U) / FS_BLOCK_SIZE)
+
+/*
+ * LBI первого блока данных
+ */
+#define FS_DATA_LBI 686U
+
+/*
+ * Количество блоков имен и заголовков в кэше метаданных
+ */
+#define FS_META_CACHE_COUNT 8U
+
+/*
+ * Количество слов в битовой карте файлов (2000 бит)
+ */
+#define FS_FILES_WORDS ((FS_FILES_COUNT + 31U) / 32U)
+
+/*
+ * Глубина стека запроса по тегам
+ */
+#define FS_TAG_STACK_SIZE 4U
+
+/*
+ * Конец цепочки блоков (адрес следующего блока не задан)
+ */
+#define FS_BLOCK_NONE 0xFFFFU
+
+/*
+ * Максимальный размер файла, хранимого в ячейке общего блока
+ */
+#define FS_INLINE_SIZE 62U
+
+/*
+ * Заголовок записи журнала: длина (2 байта) и CRC32 данных (4 байта)
+ */
+#define FS_LOG_RECORD_HEADER 6U
+
+/*
+ * Количество уровней индекса временного ряда (уровень j ссылается на
+ * блоки с номерами, кратными 4^j; 4^6 больше количества блоков)
+ */
+#define FS_SERIES_LEVELS 7U
+
+/*
+ * Наибольший размер закодированной записи ряда: время (LEB128, до 5 байт),
+ * длина (LEB128, до 2 байт) и данные
+ */
+#define FS_SERIES_RECORD_MAX (7U + FS_SERIES_RECORD_SIZE)
+
+/*
+ * Количество ячеек в общем блоке (байт занятости + резерв + 4 * 62 байта)
+ */
+#define FS_INLINE_SLOTS 4U
+
 /*
  * Номер тега
  */
 typedef U8 TAG_ID;
 
+/*
+ * Битовая карта номеров файлов (1 бит на файл)
+ */
+typedef U32 FILE_BITMAP[FS_FILES_WORDS];
+
 /*
  * Битовая карта блоков (2 бита на блок)
  */
@@ -46,12 +213,14 @@ typedef U8 BLOCK_FLAG_BITMAP[FS_BLOCKS_COUNT / 4U];
 
 /*
  * ФЛАГИ БЛОКОВ:
+ *   BLOCK_FLAG_INLINE: Общий блок маленьких файлов
  *   BLOCK_FLAG_SYSTEM: Системный блок (метаданные)
  *   BLOCK_FLAG_FREE: Блок свободен
  *   BLOCK_FLAG_USED: Блок занят
  */
 typedef enum
 {
+  BLOCK_FLAG_INLINE = 0x00,
   BLOCK_FLAG_SYSTEM = 0x01,
   BLOCK_FLAG_FREE   = 0x02,
   BLOCK_FLAG_USED   = 0x03
@@ -60,68 +229,336 @@ typedef enum
 /*
  * СУПЕРБЛОК:
  *   magic: Идентификатор блока
- *   (4 байт)
+ *   version: Версия разметки
+ *   checkpoint: Последняя транзакция журнала, перенесенная в таблицы
+ *   (12 байт)
  */
 typedef struct
 {
   U32 magic;
+  U32 version;
+  U32 checkpoint;
 } FS_SUPERBLOCK_TYPE;
 
+/*
+ * БЛОК ЖУРНАЛА МЕТАДАННЫХ (транзакция действует с отметки фиксации и может
+ * начинаться в предыдущих блоках):
+ *   crc32: Контрольная сумма остальных полей блока
+ *   sequence: Номер блока (с 1, блок журнала = sequence % 8)
+ *   length: Длина записей в байтах
+ *   records: Записи {LBI (2 байта), смещение, длина, данные}
+ *            (LBI FS_JOURNAL_MARK_* - служебная запись)
+ *   (250 байт + выравнивание = 252 байта)
+ */
+typedef struct
+{
+  U32 crc32;
+  U32 sequence;
+  U16 length;
+  U8  records[FS_BLOCK_SIZE - 10U];
+} FS_JOURNAL_BLOCK_TYPE;
+
+/*
+ * БЛОК ИМЕН ИЛИ ЗАГОЛОВКОВ В КЭШЕ МЕТАДАННЫХ:
+ *   lbi: LBI блока (UN_SET - ячейка пуста)
+ *   pending: Блок изменен транзакцией, не записанной в журнал
+ *            (FS_META_PENDING; не вытесняется)
+ *   data: Данные блока
+ *   (254 байта)
+ */
+typedef struct
+{
+  FTL_INDEX lbi;
+  U8        pending;
+  U8        data[FS_BLOCK_SIZE];
+} FS_META_CACHE_TYPE;
+
+/*
+ * ИЗМЕНЕНИЯ БЛОКА В КЭШЕ МЕТАДАННЫХ:
+ *   FS_META_PENDING_NONE: Изменения записаны в журнал
+ *   FS_META_PENDING_CLOSED: Закрытая транзакция в блоке журнала в ОЗУ
+ *   FS_META_PENDING_OPEN: Открытая транзакция (до фиксации или отмены)
+ */
+typedef enum
+{
+  FS_META_PENDING_NONE   = 0x00,
+  FS_META_PENDING_CLOSED = 0x01,
+  FS_META_PENDING_OPEN   = 0x02
+} FS_META_PENDING;
+
+/*
+ * ФЛАГИ ФАЙЛА:
+ *   FILE_FLAG_INLINE: Данные в ячейке общего блока lbi_start
+ *                     (номер ячейки в старших 4 битах flags)
+ *   FILE_FLAG_SHARED: Цепочка могла быть разделена с копией файла
+ *                     (перед записью блока проверяются счетчики ссылок)
+ *   FILE_FLAG_LOG: Журнал записей (не хранится в ячейке и не копируется):
+ *                  новый блок создается вместе с LBI следующего, поэтому
+ *                  записанный блок не переписывается ради ссылки
+ *   FILE_FLAG_SERIES: Временной ряд (вместе с FILE_FLAG_LOG): каждый блок
+ *                     начинается заголовком FS_SERIES_FRAME_TYPE
+ */
+typedef enum
+{
+  FILE_FLAG_INLINE = 0x01,
+  FILE_FLAG_SHARED = 0x02,
+  FILE_FLAG_LOG    = 0x04,
+  FILE_FLAG_SERIES = 0x08
+} FILE_FLAG;
+
 /*
  * МЕТАДАННЫЕ ФАЙЛА:
  *   id: Уникальный номер
  *   lbi_start: LBI первого блока
  *   tags: Тэги
- *   size: Размер
+ *   flags: Флаги файла (FILE_FLAG)
+ *   lbi_tail: LBI последнего блока журнала (FS_BLOCK_NONE - блоков нет)
+ *   head: Смещение первой записи журнала в первом блоке
+ *   size: Размер (у журнала - от начала первого блока)
  *   crc32: Контрольная сумма
- *   (23 байта)
+ *   (24 байта)
  */
 typedef struct
 {
   FILE_ID     id;
-  FTL_INDEX   lbi_start;
+  U16         lbi_start;
   TAG_BITMAP  tags;
+  U8          flags;
+  U16         lbi_tail;
+  U16         head;
   SIZE32      size;
   U32         crc32;
 } FILE_HEADER_TYPE;
 
+/*
+ * ЗАГОЛОВОК БЛОКА ВРЕМЕННОГО РЯДА (начало данных блока):
+ *   sequence: Номер блока от создания ряда (отбрасывание не меняет)
+ *   first: Время первой записи блока
+ *   last: Время последней записи блока
+ *   back: LBI последнего предыдущего блока с номером, кратным 4^j
+ *   end: Конец записей в данных блока
+ *   record_size: Размер записи (0 - переменный)
+ *   encoding: Кодирование данных (FS_SERIES_ENCODING)
+ *   reserved: Резерв
+ *   (30 байт)
+ */
+typedef struct __packed
+{
+  U32 sequence;
+  U32 first;
+  U32 last;
+  U16 back[FS_SERIES_LEVELS];
+  U8  end;
+  U8  record_size;
+  U8  encoding;
+  U8  reserved;
+} FS_SERIES_FRAME_TYPE;
+
+/*
+ * БУФЕР ДЕСКРИПТОРА (один блок файла):
+ *   lbi: LBI блока в буфере (UN_SET - буфер пуст, FS_BLOCK_NONE - первый
+ *        блок без своего LBI: файл в ячейке общего блока или еще не записан)
+ *   index: Порядковый номер блока в файле
+ *   dirty: Буфер изменен и не записан во flash
+ *   data: Данные блока (адрес следующего блока + данные)
+ *   (260 байт)
+ */
+typedef struct
+{
+  FTL_INDEX lbi;
+  SIZE32    index;
+  U8        dirty;
+  U8        data[FS_BLOCK_SIZE];
+} FS_BUFFER_TYPE;
+
+/*
+ * ОКНО УПРЕЖДАЮЩЕГО ЧТЕНИЯ ДЕСКРИПТОРА:
+ *   slot: Номер окна в пуле (UN_SET - окно не выдано)
+ *   first: Порядковый номер в файле первого блока окна
+ *   count: Количество блоков в окне
+ *   (12 байт)
+ */
+typedef struct
+{
+  SIZE32 slot;
+  SIZE32 first;
+  SIZE32 count;
+} FS_READAHEAD_TYPE;
+
+/*
+ * ПРОВЕРЕННАЯ ЧАСТЬ ЦЕПОЧКИ РАЗДЕЛЯЕМОГО ФАЙЛА:
+ *   index: Количество начальных блоков, принадлежащих только файлу
+ *   lbi: LBI блока index
+ *   prev: LBI блока index - 1 (FS_BLOCK_NONE - ссылка из заголовка)
+ *   (12 байт)
+ */
+typedef struct
+{
+  SIZE32    index;
+  FTL_INDEX lbi;
+  FTL_INDEX prev;
+} FS_COW_TYPE;
+
 /*
  * СТРУКТУРА ДЕСКРИПТОРА ФАЙЛА:
  *   id: Системный номер
  *   status: Статус
  *   name: Имя
  *   header: Метаданные
- *   (95 байт)
+ *   modified: Заголовок изменен (записывается при закрытии)
+ *   buffer: Буфер текущего блока
+ *   readahead: Окно упреждающего чтения
+ *   cow: Проверенная часть цепочки (копирование при записи)
+ *   generation: Поколение ячейки (входит в дескриптор файла)
+ *   lock: Блокировка операций с дескриптором (FS_THREAD_SAFE)
+ *   (400 байт без блокировки)
  */
 typedef struct
 {
   FILE_ID id;
+  U16 generation;
   FILE_STATUS_TYPE status;
   FILE_NAME name;
   FILE_HEADER_TYPE header;
+  U8 modified;
+  FS_BUFFER_TYPE buffer;
+  FS_READAHEAD_TYPE readahead;
+  FS_COW_TYPE cow;
+#if FS_THREAD_SAFE
+  FS_LOCK_TYPE lock;
+#endif
 } FS_DESCRIPTOR_TYPE;
 
 /*
- * СУПЕРБЛОК (ОЗУ + FLASH, 30 байт (0,03 КБ))
+ * ТОМ ФС:
+ *   superblock: Суперблок (ОЗУ + FLASH, 30 байт (0,03 КБ))
+ *   block_flags: Битовая карта блоков (ОЗУ + FLASH, 1024 байт (1 КБ))
+ *   tag_names: Массив названий тегов
+ *     (ОЗУ + FLASH, 19 байт * 52 = 988 байт (0,96 КБ))
+ *   file_map: Карта занятых номеров файлов (ОЗУ + FLASH, 252 байта)
+ *   tag_index[tag]: Битовая карта файлов с тегом
+ *     (ОЗУ + FLASH, 252 байта * 52 = 13104 байт (12,8 КБ))
+ *   tag_stack: Стек запроса по тегам (ОЗУ, 252 байта * 4 = 1008 байт)
+ *   block_refs[lbi]: Количество дополнительных входящих ссылок на блок
+ *     (из заголовков или блоков других цепочек), 0 - у блока один владелец
+ *     (ОЗУ + FLASH, 3968 байт (3,9 КБ))
+ *   descriptor_table[slot]: Данные дескриптора
+ *     (ОЗУ, 400 байт * FS_DESCRIPTORS_COUNT: 50 КБ на хосте, 12,5 КБ
+ *     на целевой платформе)
+ *   descriptor_free: Свободные ячейки дескрипторов (стек без блокировки):
+ *     старшие 16 бит - метка (меняется при каждом изменении стека),
+ *     младшие - верхняя ячейка (FS_DESCRIPTORS_COUNT - пуст)
+ *   descriptor_next[slot]: Следующая свободная ячейка
+ *   file_opens[id]: Количество дескрипторов чтения файла
+ *     (FS_OPEN_WRITER - файл открыт на запись) (ОЗУ, 2000 байт)
+ *   readahead_pool[slot]: Окно упреждающего чтения - запрошенный блок
+ *     + до 4 следующих (ОЗУ, 1250 байт * FS_READAHEAD_COUNT)
+ *   readahead_owner[slot]: Дескриптор-владелец окна (UN_SET - свободно)
+ *   journal: Журнал метаданных (ОЗУ, 276 байт + журнал отмены):
+ *     sequence: Номер следующего блока журнала
+ *     block: Накапливаемые транзакции (закрытые и открытая)
+ *     depth: Глубина вложения транзакций (0 - транзакция не открыта)
+ *     start: Начало открытой транзакции в block
+ *     undo_length: Занятая часть журнала отмены
+ *     spilled: Часть открытой транзакции записана в блоки журнала
+ *     cancel: Перед следующей записью нужна отметка отмены (отменена
+ *       транзакция, начатая в записанных блоках)
+ *     keep: Открытая транзакция не отменяется, а закрывается
+ *     frees: Зафиксированы намерения (освобождение или обрыв цепочки),
+ *       контрольная точка не выполнена
+ *     undo: Журнал отмены {прежние данные, LBI, смещение, длина}
+ *       (1024 байта на хосте, 640 на целевой платформе)
+ *   meta_cache[index]: Блок имен или заголовков
+ *     (ОЗУ, 254 байта * 8 = 2032 байта (2 КБ))
+ *   meta_cache_next: Следующая ячейка кэша - кандидат на вытеснение
+ *   meta_dirty: Битовая карта LBI метаданных, не записанных на место
+ *   inline_block: Общий блок маленьких файлов (ОЗУ, 254 байта):
+ *     lbi: LBI блока в ОЗУ (UN_SET - не загружен)
+ *     data: Байт занятости ячеек, резерв, 4 ячейки по 62 байта
+ *   volume_lock: Блокировка тома: операции с одним дескриптором захватывают
+ *     ее совместно, операции, меняющие чужие дескрипторы, - монопольно
+ *   lock: Блокировка метаданных: таблицы, кэш, журнал, общий блок
+ *     маленьких файлов, занятие ячеек окон упреждения (данные открытого
+ *     файла защищает блокировка его дескриптора)
+ *   lock_ready: Блокировки тома инициализированы
+ */
+typedef struct
+{
+  FS_SUPERBLOCK_TYPE superblock;
+  BLOCK_FLAG_BITMAP block_flags;
+  TAG_NAME tag_names[FS_TAGS_COUNT];
+  FILE_BITMAP file_map;
+  FILE_BITMAP tag_index[FS_TAGS_COUNT];
+  FILE_BITMAP tag_stack[FS_TAG_STACK_SIZE];
+  U8 block_refs[FS_BLOCKS_COUNT];
+  FS_DESCRIPTOR_TYPE descriptor_table[FS_DESCRIPTORS_COUNT];
+  volatile U32 descriptor_free;
+  volatile U8 descriptor_next[FS_DESCRIPTORS_COUNT];
+  volatile U8 file_opens[FS_FILES_COUNT];
+  U8 readahead_pool
+    [FS_READAHEAD_COUNT][(FS_READAHEAD_SIZE + 1U) * FS_BLOCK_SIZE];
+  SIZE32 readahead_owner[FS_READAHEAD_COUNT];
+  struct
+  {
+    U32 sequence;
+    FS_JOURNAL_BLOCK_TYPE block;
+    SIZE32 depth;
+    SIZE32 start;
+    SIZE32 undo_length;
+    U8 spilled;
+    U8 cancel;
+    U8 keep;
+    U8 frees;
+    U8 undo[FS_JOURNAL_UNDO_SIZE];
+  } journal;
+  FS_META_CACHE_TYPE meta_cache[FS_META_CACHE_COUNT];
+  SIZE32 meta_cache_next;
+  U32 meta_dirty[(FS_DATA_LBI + 31U) / 32U];
+  struct
+  {
+    FTL_INDEX lbi;
+    U8 data[FS_BLOCK_SIZE];
+  } inline_block;
+#if FS_THREAD_SAFE
+  FS_RWLOCK_TYPE volume_lock;
+  FS_LOCK_TYPE lock;
+  U8 lock_ready;
+#endif
+} FS_VOLUME_TYPE;
+
+/*
+ * Тома ФС
  */
-static FS_SUPERBLOCK_TYPE g_fs_superblock;
+static FS_VOLUME_TYPE g_fs_volumes[FS_VOLUMES_COUNT];
 
 /*
- * БИТОВАЯ КАРТА БЛОКОВ (ОЗУ + FLASH, 1024 байт (1 КБ))
+ * Том ФС, выбранный потоком
  */
-static BLOCK_FLAG_BITMAP g_fs_block_flags;
+static FS_THREAD_LOCAL FS_VOLUME_TYPE * g_fs = &g_fs_volumes[0U];
 
+#if FS_THREAD_SAFE
 /*
- * МАССИВ НАЗВАНИЙ ТЕГОВ (ОЗУ + FLASH, 19 байт * 52 = 988 байт (0,96 КБ))
+ * Глубина захвата тома потоком (вложенные вызовы API не захватывают
+ * том повторно)
  */
-static TAG_NAME g_fs_tag_names[FS_TAGS_COUNT];
+static FS_THREAD_LOCAL SIZE32 g_fs_volume_depth = 0U;
 
 /*
- * ТАБЛИЦА ДЕСКРИПТОРОВ (ОЗУ, 95 байт * 128 = 12160 байт (11,875 КБ)):
- *   index: Дескриптор файла
- *   g_fs_descriptor_table[index]: Данные дескриптора
+ * Захват тома до конца блока: совместно - перед блокировкой дескриптора
+ * (операции с одним файлом), монопольно - операции, меняющие чужие
+ * дескрипторы (вместо захвата всех дескрипторов); блокировка метаданных
+ * захватывается после
  */
-static FS_DESCRIPTOR_TYPE g_fs_descriptor_table[FS_DESCRIPTORS_COUNT];
+#define FS_VOLUME_SCOPE(WRITE)                                               \
+  U8 FS_LOCK_NAME(__LINE__)                                                  \
+    __attribute__((cleanup(FS_VOLUME_UNLOCK))) = (WRITE);                    \
+  FS_VOLUME_LOCK(&FS_LOCK_NAME(__LINE__))
+#define FS_VOLUME_SCOPE_READ() FS_VOLUME_SCOPE(0U)
+#define FS_DESCRIPTORS_SCOPE() FS_VOLUME_SCOPE(1U)
+#else
+#define FS_VOLUME_SCOPE_READ() ((void)0)
+#define FS_DESCRIPTORS_SCOPE() ((void)0)
+#endif
 
 /*
  * ============ FLASH ============
@@ -130,10 +567,14 @@ static FS_DESCRIPTOR_TYPE g_fs_descriptor_table[FS_DESCRIPTORS_COUNT];
  * |                             |
  * | SUPER_BLOCK                 |
  * |                             |
- * +-----------------------------+ BLOCK 1-5 (5 count)
+ * +-----------------------------+ BLOCK 1-4 (4 count)
  * |                             |
  * | BLOCK_FLAGS_BITMAP          |
  * |                             |
+ * +-----------------------------+ BLOCK 5 (1 count)
+ * |                             |
+ * | FILE_MAP (2000 bits)        |
+ * |                             |
  * +-----------------------------+ BLOCK 6-9 (4 count)
  * |                             |
  * | TAG_NAMES (13 per block)    |
@@ -146,160 +587,635 @@ static FS_DESCRIPTOR_TYPE g_fs_descriptor_table[FS_DESCRIPTORS_COUNT];
  * |                             |
  * | FILE_HEADERS (10 per block) |
  * |                             |
- * +-----------------------------+ BLOCK 610+
+ * +-----------------------------+ BLOCK 610-661 (52 count)
+ * |                             |
+ * | TAG_INDEX (2000 bits/tag)   |
+ * |                             |
+ * +-----------------------------+ BLOCK 662-669 (8 count)
+ * |                             |
+ * | JOURNAL (transactions)      |
+ * |                             |
+ * +-----------------------------+ BLOCK 670-685 (16 count)
+ * |                             |
+ * | BLOCK_REFS (1 byte/block)   |
+ * |                             |
+ * +-----------------------------+ BLOCK 686+
  * |                             |
  * | DATA                        |
+ * | (+ INLINE: 4 files <= 62 B) |
  * |                             |
  * +-----------------------------+
  */
 
 
-/* ======== BLOCKNEXT ======== */
+/* ======== META ======== */
 /*
- * ПОЛУЧИТЬ СЛЕДУЮЩИЙ БЛОК В ЦЕПОЧКЕ:
- *   LBI: Номер блока (в котором хранится значение следующего)
- *   next_lbi: Номер следующего блока
+ * ОБРАЗ БЛОКА МЕТАДАННЫХ В ОЗУ (таблица в ОЗУ или кэш имен/заголовков):
+ *   LBI: Номер блока метаданных
+ *   image: Начало образа блока
+ *   size: Размер образа (не больше размера блока)
  *   return_code: Статус операции
- *     NO_ERROR: Номер успешно получен
+ *     NO_ERROR: Образ получен
+ *     INVALID_PARAM: LBI не относится к метаданным
  *     NO_ACTION: Блока не существует
- *     OPERATION_FAILED: Ошибка связи
+ *     OPERATION_FAILED: Ошибка чтения или вытеснения из кэша
  */
-static void FS_BLOCKNEXT_READ(
+static void FS_META_IMAGE(
 /* IN  */ const FTL_INDEX LBI,
-/* OUT */ FTL_INDEX * next_lbi,
+/* OUT */ U8 ** image,
+/* OUT */ SIZE32 * size,
 /* OUT */ RETURN_CODE * return_code);
 
 /*
- * УСТАНОВИТЬ СЛЕДУЮЩИЙ БЛОК В ЦЕПОЧКУ:
- *   LBI: Номер блока (в который устанавливается значение следующего)
- *   NEXT_LBI: Номер следующего блока
+ * ИЗМЕНЕНИЕ ОБРАЗА БЛОКА МЕТАДАННЫХ (без записи в журнал):
+ *   LBI: Номер блока метаданных
+ *   OFFSET: Смещение в блоке
+ *   LENGTH: Длина изменения
+ *   DATA: Новые данные
  *   return_code: Статус операции
- *     NO_ERROR: Номер успешно установлен
- *     NO_ACTION: Блока не существует
- *     OPERATION_FAILED: Ошибка связи
+ *     NO_ERROR: Образ изменен (запись на место - при контрольной точке)
+ *     INVALID_PARAM: Изменение выходит за образ блока
+ *     OPERATION_FAILED: Ошибка чтения
  */
-static void FS_BLOCKNEXT_WRITE(
+static void FS_META_APPLY(
 /* IN  */ const FTL_INDEX LBI,
-/* IN  */ const FTL_INDEX NEXT_LBI,
+/* IN  */ const SIZE32 OFFSET,
+/* IN  */ const SIZE32 LENGTH,
+/* IN  */ const VOID_PTR DATA,
 /* OUT */ RETURN_CODE * return_code);
-/* ======== BLOCKNEXT ======== */
+
+/*
+ * ИЗМЕНЕНИЕ МЕТАДАННЫХ В ОТКРЫТОЙ ТРАНЗАКЦИИ:
+ *   LBI: Номер блока метаданных
+ *   OFFSET: Смещение в блоке
+ *   LENGTH: Длина изменения
+ *   DATA: Новые данные
+ *   return_code: Статус операции
+ *     NO_ERROR: Изменение добавлено в транзакцию
+ *     INVALID_PARAM: Изменение выходит за образ блока или транзакция
+ *                    не открыта
+ *     OPERATION_FAILED: Ошибка чтения/записи, журнал отмены или журнал
+ *                       заполнен (транзакция слишком велика)
+ */
+static void FS_META_WRITE(
+/* IN  */ const FTL_INDEX LBI,
+/* IN  */ const SIZE32 OFFSET,
+/* IN  */ const SIZE32 LENGTH,
+/* IN  */ const VOID_PTR DATA,
+/* OUT */ RETURN_CODE * return_code);
+/* ======== META ======== */
 
 
 
-/* ======== BLOCKFLAG ======== */
-static void FS_BLOCKFLAG_READ(
+/* ======== JOURNAL ======== */
+/*
+ * ОТКРЫТИЕ ТРАНЗАКЦИИ (вызывается под блокировкой метаданных):
+ *   KEEP: 1 - изменения не отменяются, а закрываются при выходе без фиксации
+ *   return: Состояние для FS_JOURNAL_END
+ */
+static U32 FS_JOURNAL_BEGIN(
+/* IN  */ const U8 KEEP);
+
+/*
+ * ВЫХОД ИЗ ТРАНЗАКЦИИ (вложенная транзакция входит во внешнюю; внешняя,
+ * не зафиксированная FS_JOURNAL_COMMIT, отменяется или закрывается):
+ *   scope: Состояние FS_JOURNAL_BEGIN
+ */
+static void FS_JOURNAL_END(
+/* IN  */ U32 * scope);
+
+/*
+ * Транзакция метаданных до конца блока (захватывает блокировку метаданных):
+ * FS_JOURNAL_SCOPE отменяет изменения при выходе без фиксации (возврат
+ * с ошибкой), FS_JOURNAL_SCOPE_KEEP закрывает их для следующей записи
+ * журнала (на выделенные блоки уже ссылаются буфер и заголовок дескриптора)
+ */
+#define FS_JOURNAL_SCOPE_MODE(KEEP)                                          \
+  FS_LOCK_SCOPE(&g_fs->lock);                                                \
+  U32 m_scope_journal __attribute__((cleanup(FS_JOURNAL_END)))              \
+    = FS_JOURNAL_BEGIN(KEEP)
+#define FS_JOURNAL_SCOPE() FS_JOURNAL_SCOPE_MODE(0U)
+#define FS_JOURNAL_SCOPE_KEEP() FS_JOURNAL_SCOPE_MODE(1U)
+
+/*
+ * ДОБАВЛЕНИЕ ЗАПИСИ В БЛОК ЖУРНАЛА (заполненный блок записывается, открытая
+ * транзакция продолжается в следующем):
+ *   LBI: Номер блока метаданных или FS_JOURNAL_MARK_*
+ *   OFFSET: Смещение в блоке
+ *   LENGTH: Длина данных
+ *   DATA: Данные
+ *   return_code: Статус операции
+ *     NO_ERROR: Запись добавлена
+ *     OPERATION_FAILED: Ошибка записи или все блоки журнала заняты
+ */
+static void FS_JOURNAL_APPEND(
 /* IN  */ const FTL_INDEX LBI,
-/* OUT */ BLOCK_FLAG * flag,
+/* IN  */ const SIZE32 OFFSET,
+/* IN  */ const SIZE32 LENGTH,
+/* IN  */ const U8 * DATA,
 /* OUT */ RETURN_CODE * return_code);
 
-static void FS_BLOCKFLAG_WRITE(
+/*
+ * СОХРАНЕНИЕ ПРЕЖНИХ ДАННЫХ В ЖУРНАЛ ОТМЕНЫ:
+ *   LBI: Номер блока метаданных или FS_JOURNAL_MARK_FREE
+ *   OFFSET: Смещение в блоке
+ *   LENGTH: Длина данных
+ *   DATA: Прежние данные
+ *   return_code: Статус операции
+ *     NO_ERROR: Данные сохранены
+ *     OPERATION_FAILED: Журнал отмены заполнен
+ */
+static void FS_JOURNAL_UNDO(
 /* IN  */ const FTL_INDEX LBI,
-/* IN  */ const BLOCK_FLAG FLAG,
+/* IN  */ const SIZE32 OFFSET,
+/* IN  */ const SIZE32 LENGTH,
+/* IN  */ const U8 * DATA,
 /* OUT */ RETURN_CODE * return_code);
-/* ======== BLOCKFLAG ======== */
-
 
+/*
+ * ЗАПИСЬ БЛОКА ЖУРНАЛА С CRC (закрытые транзакции становятся постоянными):
+ *   return_code: Статус операции
+ *     NO_ERROR: Блок записан
+ *     OPERATION_FAILED: Ошибка записи или все блоки журнала заняты
+ *                       транзакциями после контрольной точки
+ */
+static void FS_JOURNAL_WRITE(
+/* OUT */ RETURN_CODE * return_code);
 
-/* ======== TAGNAME ======== */
 /*
- * ЧТЕНИЕ ТЕГА:
- *   ID: Номер тега в системе
- *   name: Название тега
+ * ЗАКРЫТИЕ ОТКРЫТОЙ ТРАНЗАКЦИИ ОТМЕТКОЙ ФИКСАЦИИ:
+ *   DURABLE: 1 - записать блок журнала сразу
  *   return_code: Статус операции
- *     NO_ERROR: Название тега получено
- *     INVALID_PARAM: Номер тега не существует
- *     NO_ACTION: Тег пустой
- *     OPERATION_FAULT: Ошибка чтения
+ *     NO_ERROR: Транзакция закрыта (или пуста)
+ *     OPERATION_FAILED: Ошибка записи (транзакция отменена)
+ *
+ * Блок журнала записывается и при освобождении цепочек, и когда занята
+ * половина блоков журнала; после записи выполняется контрольная точка
  */
-static void FS_TAGNAME_READ(
-/* IN  */ const TAG_ID ID,
-/* OUT */ TAG_NAME name,
+static void FS_JOURNAL_CLOSE(
+/* IN  */ const U8 DURABLE,
 /* OUT */ RETURN_CODE * return_code);
 
 /*
- * ЗАПИСЬ ТЕГА:
- *   ID: Номер тега в системе
- *   NAME: Название тега
+ * ФИКСАЦИЯ ТРАНЗАКЦИИ (во вложенной транзакции ничего не делает):
  *   return_code: Статус операции
- *     NO_ERROR: Название тега записано
- *     INVALID_PARAM: Номер тега не существует
- *     OPERATION_FAULT: Ошибка записи
+ *     NO_ERROR: Транзакция зафиксирована (или пуста)
+ *     OPERATION_FAILED: Ошибка записи
  */
-static void FS_TAGNAME_WRITE(
-/* IN  */ const TAG_ID ID,
-/* IN  */ const TAG_NAME NAME,
+static void FS_JOURNAL_COMMIT(
 /* OUT */ RETURN_CODE * return_code);
-/* ======== TAGNAME ======== */
 
+/*
+ * ОТМЕНА ОТКРЫТОЙ ТРАНЗАКЦИИ (образы восстанавливаются из журнала отмены,
+ * записи удаляются из блока или отменяются отметкой):
+ *   return_code: Статус операции
+ *     NO_ERROR: Транзакция отменена
+ *     OPERATION_FAILED: Ошибка чтения цепочки
+ */
+static void FS_JOURNAL_ABORT(
+/* OUT */ RETURN_CODE * return_code);
 
+/*
+ * НАМЕРЕНИЕ В ОТКРЫТОЙ ТРАНЗАКЦИИ (выполняется после записи блока журнала,
+ * повторяется при воспроизведении):
+ *   MARK: FS_JOURNAL_MARK_FREE или FS_JOURNAL_MARK_CUT
+ *   LENGTH: Длина данных
+ *   DATA: Данные намерения
+ *   return_code: Статус операции
+ *     NO_ERROR: Намерение добавлено
+ *     INVALID_PARAM: Транзакция не открыта
+ *     OPERATION_FAILED: Ошибка записи журнала или журнал отмены заполнен
+ */
+static void FS_JOURNAL_INTENT(
+/* IN  */ const FTL_INDEX MARK,
+/* IN  */ const SIZE32 LENGTH,
+/* IN  */ const U8 * DATA,
+/* OUT */ RETURN_CODE * return_code);
 
-/* ======== FILENAME ======== */
 /*
- * ЧТЕНИЕ ИМЕНИ ФАЙЛА:
- *   ID: Номер файла в системе
- *   name: Имя файла
+ * ВЫПОЛНЕНИЕ НАМЕРЕНИЙ ЗАКРЫТОЙ ТРАНЗАКЦИИ:
+ *   MARK: FS_JOURNAL_MARK_CUT (после записи блока журнала) или
+ *         FS_JOURNAL_MARK_FREE (после контрольной точки)
  *   return_code: Статус операции
- *     NO_ERROR: Имя файла получено
- *     INVALID_PARAM: Номер выходит за границы
- *     NO_ACTION: Файла не существует
- *     OPERATION_FAULT: Ошибка чтения
+ *     NO_ERROR: Намерения выполнены
+ *     OPERATION_FAILED: Ошибка записи блока цепочки
  */
-static void FS_FILENAME_READ(
-/* IN  */ const FILE_ID ID,
-/* OUT */ FILE_NAME name,
+static void FS_JOURNAL_DEFER(
+/* IN  */ const FTL_INDEX MARK,
 /* OUT */ RETURN_CODE * return_code);
 
 /*
- * ЗАПИСЬ ИМЕНИ ФАЙЛА
- *   ID: Номер файла в системе
- *   NAME: Имя файла
+ * ФЛАГ БЛОКОВ ЦЕПОЧКИ В ОЗУ (освобождение при воспроизведении, возврат
+ * при отмене):
+ *   LBI: Первый блок цепочки
+ *   COUNT: Количество блоков
+ *   FLAG: Флаг блоков
  *   return_code: Статус операции
- *     NO_ERROR: Имя файла записано
- *     INVALID_PARAM: Номер выходит за границы
- *     OPERATION_FAULT: Ошибка записи
+ *     NO_ERROR: Флаги изменены
+ *     OPERATION_FAILED: Ошибка чтения
  */
-static void FS_FILENAME_WRITE(
-/* IN  */ const FILE_ID ID,
-/* IN  */ const FILE_NAME NAME,
+static void FS_JOURNAL_CHAIN(
+/* IN  */ const FTL_INDEX LBI,
+/* IN  */ const SIZE32 COUNT,
+/* IN  */ const BLOCK_FLAG FLAG,
 /* OUT */ RETURN_CODE * return_code);
-/* ======== FILENAME ======== */
 
+/*
+ * КОНТРОЛЬНАЯ ТОЧКА (запись измененных таблиц на место, очистка журнала):
+ *   return_code: Статус операции
+ *     NO_ERROR: Таблицы записаны
+ *     OPERATION_FAILED: Ошибка записи
+ */
+static void FS_JOURNAL_CHECKPOINT(
+/* OUT */ RETURN_CODE * return_code);
 
+/*
+ * ЧТЕНИЕ БЛОКА ЖУРНАЛА (в g_fs->journal.block):
+ *   SLOT: Номер блока журнала
+ *   return_code: Статус операции
+ *     NO_ERROR: Блок прочитан, CRC и длина записей верны
+ *     NO_ACTION: Блок не записан или запись прервана
+ *     OPERATION_FAILED: Ошибка чтения
+ */
+static void FS_JOURNAL_LOAD(
+/* IN  */ const SIZE32 SLOT,
+/* OUT */ RETURN_CODE * return_code);
 
-/* ======== FILEHEADER ======== */
 /*
- * ЧТЕНИЕ ЗАГОЛОВКА ФАЙЛА:
- *   ID: Номер файла в системе
- *   header: Заголовок файла (метаданные)
+ * ВОСПРОИЗВЕДЕНИЕ ЗАПИСЕЙ ЗАФИКСИРОВАННОЙ ТРАНЗАКЦИИ (в g_fs->journal.block
+ * загружен блок TO_SEQUENCE и остается загруженным):
+ *   FROM_SEQUENCE, FROM_OFFSET: Начало транзакции
+ *   TO_SEQUENCE, TO_OFFSET: Отметка фиксации
  *   return_code: Статус операции
- *     NO_ERROR: Заголовок файла получен
- *     INVALID_PARAM: Номер выходит за границы
- *     NO_ACTION: Файла не существует
- *     OPERATION_FAULT: Ошибка чтения
+ *     NO_ERROR: Записи воспроизведены
+ *     OPERATION_FAILED: Ошибка чтения или блок журнала перезаписан
  */
-static void FS_FILEHEADER_READ(
-/* IN  */ const FILE_ID ID,
-/* OUT */ FILE_HEADER_TYPE * header,
+static void FS_JOURNAL_APPLY(
+/* IN  */ const U32 FROM_SEQUENCE,
+/* IN  */ const SIZE32 FROM_OFFSET,
+/* IN  */ const U32 TO_SEQUENCE,
+/* IN  */ const SIZE32 TO_OFFSET,
 /* OUT */ RETURN_CODE * return_code);
 
 /*
- * ЗАПИСЬ ЗАГОЛОВКА ФАЙЛА
- *   ID: Номер файла в системе
- *   HEADER: Заголовок файла
+ * ВОСПРОИЗВЕДЕНИЕ ЖУРНАЛА ПОСЛЕ КОНТРОЛЬНОЙ ТОЧКИ:
  *   return_code: Статус операции
- *     NO_ERROR: Заголовок файла записан
- *     INVALID_PARAM: Номер выходит за границы
- *     OPERATION_FAULT: Ошибка записи
+ *     NO_ERROR: Журнал воспроизведен
+ *     OPERATION_FAILED: Ошибка чтения/записи
+ *
+ * Порядок транзакций задают номера блоков журнала, а не номер блока
+ * и не копии таблиц во flash: записи - новые значения байтов таблиц,
+ * поэтому зафиксированные транзакции воспроизводятся всегда, даже если
+ * таблица уже записана на место (вытеснение из кэша, контрольная точка
+ * без записи суперблока). Записи без отметки фиксации (прерванная
+ * или отмененная транзакция) пропускаются
  */
-static void FS_FILEHEADER_WRITE(
-/* IN  */ const FILE_ID ID,
-/* IN  */ const FILE_HEADER_TYPE HEADER,
+static void FS_JOURNAL_REPLAY(
 /* OUT */ RETURN_CODE * return_code);
-/* ======== FILEHEADER ======== */
+/* ======== JOURNAL ======== */
 
 
 
-/* ======== FILE ======== */
+/* ======== BLOCKNEXT ======== */
+/*
+ * ПОЛУЧИТЬ СЛЕДУЮЩИЙ БЛОК В ЦЕПОЧКЕ:
+ *   LBI: Номер блока (в котором хранится значение следующего)
+ *   next_lbi: Номер следующего блока
+ *   return_code: Статус операции
+ *     NO_ERROR: Номер успешно получен
+ *     NO_ACTION: Блока не существует
+ *     OPERATION_FAILED: Ошибка связи
+ */
+static void FS_BLOCKNEXT_READ(
+/* IN  */ const FTL_INDEX LBI,
+/* OUT */ FTL_INDEX * next_lbi,
+/* OUT */ RETURN_CODE * return_code);
+
+/*
+ * УСТАНОВИТЬ СЛЕДУЮЩИЙ БЛОК В ЦЕПОЧКУ:
+ *   LBI: Номер блока (в который устанавливается значение следующего)
+ *   NEXT_LBI: Номер следующего блока
+ *   return_code: Статус операции
+ *     NO_ERROR: Номер успешно установлен
+ *     NO_ACTION: Блока не существует
+ *     OPERATION_FAILED: Ошибка связи
+ */
+static void FS_BLOCKNEXT_WRITE(
+/* IN  */ const FTL_INDEX LBI,
+/* IN  */ const FTL_INDEX NEXT_LBI,
+/* OUT */ RETURN_CODE * return_code);
+/* ======== BLOCKNEXT ======== */
+
+
+
+/* ======== BLOCKFLAG ======== */
+/*
+ * ЧТЕНИЕ ФЛАГА БЛОКА (из ОЗУ):
+ *   LBI: Номер блока
+ *   flag: Флаг блока
+ *   return_code: Статус операции
+ *     NO_ERROR: Флаг получен
+ *     INVALID_PARAM: Номер блока выходит за границы
+ */
+static void FS_BLOCKFLAG_READ(
+/* IN  */ const FTL_INDEX LBI,
+/* OUT */ BLOCK_FLAG * flag,
+/* OUT */ RETURN_CODE * return_code);
+
+/*
+ * ЗАПИСЬ ФЛАГА БЛОКА (записывается только блок карты с этим флагом):
+ *   LBI: Номер блока
+ *   FLAG: Флаг блока
+ *   return_code: Статус операции
+ *     NO_ERROR: Флаг записан
+ *     INVALID_PARAM: Номер блока выходит за границы
+ *     OPERATION_FAILED: Ошибка записи
+ */
+static void FS_BLOCKFLAG_WRITE(
+/* IN  */ const FTL_INDEX LBI,
+/* IN  */ const BLOCK_FLAG FLAG,
+/* OUT */ RETURN_CODE * return_code);
+
+/*
+ * ИЗМЕНЕНИЕ ФЛАГА БЛОКА В ОЗУ (без записи в журнал - освобождение цепочки
+ * записывается одной записью намерения):
+ *   LBI: Номер блока
+ *   FLAG: Флаг блока
+ *   return_code: Статус операции
+ *     NO_ERROR: Флаг изменен
+ *     INVALID_PARAM: Номер блока выходит за границы
+ */
+static void FS_BLOCKFLAG_APPLY(
+/* IN  */ const FTL_INDEX LBI,
+/* IN  */ const BLOCK_FLAG FLAG,
+/* OUT */ RETURN_CODE * return_code);
+
+/*
+ * ЗАПИСЬ БЛОКА БИТОВОЙ КАРТЫ:
+ *   INDEX: Номер блока карты (0-3)
+ *   return_code: Статус операции
+ *     NO_ERROR: Блок карты записан
+ *     OPERATION_FAILED: Ошибка записи
+ */
+static void FS_BLOCKFLAG_FLUSH(
+/* IN  */ const SIZE32 INDEX,
+/* OUT */ RETURN_CODE * return_code);
+/* ======== BLOCKFLAG ======== */
+
+
+
+/* ======== BLOCK ======== */
+/*
+ * ВЫДЕЛЕНИЕ БЛОКА:
+ *   lbi: Индекс логического блока
+ *   return_code: Состояние операции
+ *     NO_ERROR: Блок выделен
+ *     NO_ACTION: Свободных блоков нет
+ *     OPERATION_FAILED: Ошибка записи битовой карты
+ */
+static void FS_BLOCK_ALLOCATE(
+/* OUT */ FTL_INDEX * lbi,
+/* OUT */ RETURN_CODE * return_code);
+
+/*
+ * ИЗМЕНЕНИЕ СЧЕТЧИКА ССЫЛОК НА БЛОК:
+ *   LBI: Номер блока
+ *   DELTA: +1 или -1
+ *   return_code: Статус операции
+ *     NO_ERROR: Счетчик изменен
+ *     NO_ACTION: Счетчик достиг предела (255 ссылок)
+ *     OPERATION_FAILED: Ошибка записи
+ */
+static void FS_BLOCKREF_ADD(
+/* IN  */ const FTL_INDEX LBI,
+/* IN  */ const I32 DELTA,
+/* OUT */ RETURN_CODE * return_code);
+
+/*
+ * ОСВОБОЖДЕНИЕ ЦЕПОЧКИ БЛОКОВ В ОТКРЫТОЙ ТРАНЗАКЦИИ (снята ссылка на первый
+ * блок):
+ *   LBI: Первый блок цепочки (FS_BLOCK_NONE - цепочка пуста)
+ *   COUNT: Наибольшее количество блоков (UN_SET - до конца цепочки;
+ *          ссылка последнего блока не читается - у журнала это
+ *          выделенный, но не записанный блок)
+ *   return_code: Статус операции
+ *     NO_ERROR: Блоки освобождены в ОЗУ, намерение добавлено в транзакцию
+ *     OPERATION_FAILED: Ошибка чтения или записи
+ *
+ * Обход останавливается на первом блоке с другими ссылками: остаток
+ * цепочки принадлежит копии файла, у блока снимается одна ссылка.
+ * Транзакция записывает намерение {первый блок, количество}, которое
+ * повторяется при воспроизведении журнала; FTL сообщается об освобождении
+ * после контрольной точки, пока блоки цепочки нельзя выделить заново
+ */
+static void FS_BLOCK_FREE(
+/* IN  */ const FTL_INDEX LBI,
+/* IN  */ const SIZE32 COUNT,
+/* OUT */ RETURN_CODE * return_code);
+
+/*
+ * ОСВОБОЖДЕНИЕ БЛОКОВ ЦЕПОЧКИ В FTL (соседние блоки - одним вызовом):
+ *   LBI: Первый блок цепочки
+ *   COUNT: Количество блоков
+ */
+static void FS_BLOCK_DISCARD(
+/* IN  */ const FTL_INDEX LBI,
+/* IN  */ const SIZE32 COUNT);
+/* ======== BLOCK ======== */
+
+
+
+/* ======== TAGNAME ======== */
+/*
+ * ЧТЕНИЕ ТЕГА:
+ *   ID: Номер тега в системе
+ *   name: Название тега
+ *   return_code: Статус операции
+ *     NO_ERROR: Название тега получено
+ *     INVALID_PARAM: Номер тега не существует
+ *     NO_ACTION: Тег пустой
+ *     OPERATION_FAULT: Ошибка чтения
+ */
+static void FS_TAGNAME_READ(
+/* IN  */ const TAG_ID ID,
+/* OUT */ TAG_NAME name,
+/* OUT */ RETURN_CODE * return_code);
+
+/*
+ * ЗАПИСЬ ТЕГА:
+ *   ID: Номер тега в системе
+ *   NAME: Название тега
+ *   return_code: Статус операции
+ *     NO_ERROR: Название тега записано
+ *     INVALID_PARAM: Номер тега не существует
+ *     OPERATION_FAULT: Ошибка записи
+ */
+static void FS_TAGNAME_WRITE(
+/* IN  */ const TAG_ID ID,
+/* IN  */ const TAG_NAME NAME,
+/* OUT */ RETURN_CODE * return_code);
+/* ======== TAGNAME ======== */
+
+
+
+/* ======== TAGINDEX ======== */
+/*
+ * ПОИСК ТЕГА ПО НАЗВАНИЮ (в ОЗУ):
+ *   NAME: Название тега
+ *   id: Номер тега
+ *   return_code: Статус операции
+ *     NO_ERROR: Тег найден
+ *     INVALID_PARAM: Название пустое или не помещается в TAG_NAME
+ *     NO_ACTION: Тега не существует
+ */
+static void FS_TAG_FIND(
+/* IN  */ const TAG_NAME NAME,
+/* OUT */ TAG_ID * id,
+/* OUT */ RETURN_CODE * return_code);
+
+/*
+ * ИЗМЕНЕНИЕ БИТА ФАЙЛА В ИНДЕКСЕ ТЕГА:
+ *   TAG: Номер тега
+ *   ID: Номер файла
+ *   VALUE: 1 - файл с тегом, 0 - без тега
+ *   return_code: Статус операции
+ *     NO_ERROR: Блок индекса записан
+ *     OPERATION_FAILED: Ошибка записи
+ */
+static void FS_TAGINDEX_WRITE(
+/* IN  */ const TAG_ID TAG,
+/* IN  */ const FILE_ID ID,
+/* IN  */ const U8 VALUE,
+/* OUT */ RETURN_CODE * return_code);
+
+/*
+ * ИЗМЕНЕНИЕ ТЕГА У ФАЙЛА (заголовок, индекс и открытые дескрипторы):
+ *   NAME: Имя файла
+ *   TAG: Название тега
+ *   VALUE: 1 - добавить, 0 - удалить
+ *   return_code: Статус операции
+ *     NO_ERROR: Тег изменен
+ *     INVALID_PARAM: Некорректное имя файла или тега
+ *     NO_ACTION: Файла или тега (при удалении) не существует
+ *     OPERATION_FAILED: Ошибка чтения/записи или нет места для тега
+ */
+static void FS_TAG_SET(
+/* IN  */ const FILE_NAME NAME,
+/* IN  */ const TAG_NAME TAG,
+/* IN  */ const U8 VALUE,
+/* OUT */ RETURN_CODE * return_code);
+
+/*
+ * ВЫЧИСЛЕНИЕ ЗАПРОСА ПО ТЕГАМ (результат в g_fs->tag_stack[0]):
+ *   QUERY: Выражение в обратной польской записи
+ *   QUERY_LENGTH: Количество элементов (0 - все существующие файлы)
+ *   return_code: Статус операции
+ *     NO_ERROR: Выражение вычислено
+ *     INVALID_PARAM: Выражение некорректно или слишком глубокое
+ */
+static void FS_TAG_EVALUATE(
+/* IN  */ const TAG_QUERY_TYPE * QUERY,
+/* IN  */ const SIZE32 QUERY_LENGTH,
+/* OUT */ RETURN_CODE * return_code);
+/* ======== TAGINDEX ======== */
+
+
+
+/* ======== FILEMAP ======== */
+/*
+ * ИЗМЕНЕНИЕ БИТА В КАРТЕ ЗАНЯТЫХ НОМЕРОВ ФАЙЛОВ:
+ *   ID: Номер файла
+ *   VALUE: 1 - номер занят, 0 - свободен
+ *   return_code: Статус операции
+ *     NO_ERROR: Карта записана
+ *     OPERATION_FAILED: Ошибка записи
+ */
+static void FS_FILEMAP_WRITE(
+/* IN  */ const FILE_ID ID,
+/* IN  */ const U8 VALUE,
+/* OUT */ RETURN_CODE * return_code);
+/* ======== FILEMAP ======== */
+
+
+
+/* ======== FILENAME ======== */
+/*
+ * ЧТЕНИЕ ИМЕНИ ФАЙЛА:
+ *   ID: Номер файла в системе
+ *   name: Имя файла
+ *   return_code: Статус операции
+ *     NO_ERROR: Имя файла получено
+ *     INVALID_PARAM: Номер выходит за границы
+ *     NO_ACTION: Файла не существует
+ *     OPERATION_FAULT: Ошибка чтения
+ */
+static void FS_FILENAME_READ(
+/* IN  */ const FILE_ID ID,
+/* OUT */ FILE_NAME name,
+/* OUT */ RETURN_CODE * return_code);
+
+/*
+ * ЗАПИСЬ ИМЕНИ ФАЙЛА
+ *   ID: Номер файла в системе
+ *   NAME: Имя файла
+ *   return_code: Статус операции
+ *     NO_ERROR: Имя файла записано
+ *     INVALID_PARAM: Номер выходит за границы
+ *     OPERATION_FAULT: Ошибка записи
+ */
+static void FS_FILENAME_WRITE(
+/* IN  */ const FILE_ID ID,
+/* IN  */ const FILE_NAME NAME,
+/* OUT */ RETURN_CODE * return_code);
+
+/*
+ * ПРОВЕРКА ИМЕНИ ФАЙЛА:
+ *   NAME: Имя файла
+ *   return_code: Статус операции
+ *     NO_ERROR: Имя корректно
+ *     INVALID_PARAM: Имя пустое или не помещается в FILE_NAME
+ */
+static void FS_FILENAME_VALIDATE(
+/* IN  */ const FILE_NAME NAME,
+/* OUT */ RETURN_CODE * return_code);
+/* ======== FILENAME ======== */
+
+
+
+/* ======== FILEHEADER ======== */
+/*
+ * ЧТЕНИЕ ЗАГОЛОВКА ФАЙЛА:
+ *   ID: Номер файла в системе
+ *   header: Заголовок файла (метаданные)
+ *   return_code: Статус операции
+ *     NO_ERROR: Заголовок файла получен
+ *     INVALID_PARAM: Номер выходит за границы
+ *     NO_ACTION: Файла не существует
+ *     OPERATION_FAULT: Ошибка чтения
+ */
+static void FS_FILEHEADER_READ(
+/* IN  */ const FILE_ID ID,
+/* OUT */ FILE_HEADER_TYPE * header,
+/* OUT */ RETURN_CODE * return_code);
+
+/*
+ * ЗАПИСЬ ЗАГОЛОВКА ФАЙЛА
+ *   ID: Номер файла в системе
+ *   HEADER: Заголовок файла
+ *   return_code: Статус операции
+ *     NO_ERROR: Заголовок файла записан
+ *     INVALID_PARAM: Номер выходит за границы
+ *     OPERATION_FAULT: Ошибка записи
+ */
+static void FS_FILEHEADER_WRITE(
+/* IN  */ const FILE_ID ID,
+/* IN  */ const FILE_HEADER_TYPE HEADER,
+/* OUT */ RETURN_CODE * return_code);
+/* ======== FILEHEADER ======== */
+
+
+
+/* ======== FILE ======== */
 /*
  * ПОИСК ФАЙЛА ПО ИМЕНИ
  *   NAME: Имя файла
@@ -317,540 +1233,6260 @@ static void FS_FILE_FIND(
 
 
 
+/* ======== DESCRIPTOR ======== */
+/*
+ * ПОЛУЧИТЬ ОТКРЫТЫЙ ДЕСКРИПТОР:
+ *   ID: Дескриптор файла
+ *   descriptor: Данные дескриптора
+ *   return_code: Статус операции
+ *     NO_ERROR: Дескриптор получен
+ *     INVALID_PARAM: Дескриптор не существует или закрыт
+ */
+static void FS_DESCRIPTOR_GET(
+/* IN  */ const FILE_ID ID,
+/* OUT */ FS_DESCRIPTOR_TYPE ** descriptor,
+/* OUT */ RETURN_CODE * return_code);
+
+/*
+ * СИНХРОНИЗАЦИЯ ДЕСКРИПТОРА (буфер и заголовок записываются во flash):
+ *   descriptor: Данные дескриптора
+ *   return_code: Статус операции
+ *     NO_ERROR: Данные записаны
+ *     NO_ACTION: Нет места для буфера (см. FS_BUFFER_FLUSH)
+ *     OPERATION_FAILED: Ошибка записи
+ */
+static void FS_DESCRIPTOR_SYNC(
+/* INOUT */ FS_DESCRIPTOR_TYPE * descriptor,
+/* OUT   */ RETURN_CODE * return_code);
+
+/*
+ * ЧТЕНИЕ С ПОЗИЦИИ ДЕСКРИПТОРА (не дальше конца файла):
+ *   descriptor: Данные дескриптора
+ *   LENGTH: Заданное количество байт на чтение
+ *   out_length: Прочитанное количество байт
+ *   data: Данные
+ *   return_code: Статус операции
+ *     NO_ERROR: Данные прочитаны
+ *     OPERATION_FAILED: Ошибка чтения
+ */
+static void FS_DESCRIPTOR_READ(
+/* INOUT */ FS_DESCRIPTOR_TYPE * descriptor,
+/* IN    */ const SIZE32 LENGTH,
+/* OUT   */ SIZE32 * out_length,
+/* OUT   */ VOID_PTR data,
+/* OUT   */ RETURN_CODE * return_code);
+
+/*
+ * ЗАПИСЬ С ПОЗИЦИИ ДЕСКРИПТОРА (через буфер блока):
+ *   descriptor: Данные дескриптора (открыт на запись)
+ *   LENGTH: Количество байт на запись
+ *   DATA: Данные
+ *   return_code: Статус операции
+ *     NO_ERROR: Данные записаны
+ *     NO_ACTION: Нет свободных блоков
+ *     OPERATION_FAILED: Ошибка чтения или записи
+ */
+static void FS_DESCRIPTOR_WRITE(
+/* INOUT */ FS_DESCRIPTOR_TYPE * descriptor,
+/* IN    */ const SIZE32 LENGTH,
+/* IN    */ const VOID_PTR DATA,
+/* OUT   */ RETURN_CODE * return_code);
+
+/*
+ * ВЗЯТЬ СВОБОДНУЮ ЯЧЕЙКУ ДЕСКРИПТОРА (без блокировки):
+ *   slot: Ячейка таблицы
+ *   return_code: Статус операции
+ *     NO_ERROR: Ячейка получена
+ *     NO_ACTION: Свободных ячеек нет
+ */
+static void FS_DESCRIPTOR_POP(
+/* OUT */ SIZE32 * slot,
+/* OUT */ RETURN_CODE * return_code);
+
+/*
+ * ВЕРНУТЬ ЯЧЕЙКУ ДЕСКРИПТОРА В СТЕК СВОБОДНЫХ (без блокировки):
+ *   SLOT: Ячейка таблицы
+ */
+static void FS_DESCRIPTOR_PUSH(
+/* IN  */ const SIZE32 SLOT);
+
+/*
+ * ЗАКРЫТИЕ ДЕСКРИПТОРА (поколение ячейки меняется, ячейка освобождается):
+ *   descriptor: Данные дескриптора (буфер уже записан)
+ */
+static void FS_DESCRIPTOR_RELEASE(
+/* INOUT */ FS_DESCRIPTOR_TYPE * descriptor);
+
+/*
+ * ОТМЕТКА ОТКРЫТИЯ ФАЙЛА (без блокировки):
+ *   ID: Системный номер файла
+ *   MODE: Режим открытия
+ *   return_code: Статус операции
+ *     NO_ERROR: Открытие отмечено
+ *     DEVICE_BUSY: Файл открыт на запись или открывается на запись
+ *                  при открытых дескрипторах
+ */
+static void FS_OPENS_ACQUIRE(
+/* IN  */ const FILE_ID ID,
+/* IN  */ const FILE_MODE MODE,
+/* OUT */ RETURN_CODE * return_code);
+
+/*
+ * СНЯТИЕ ОТМЕТКИ ОТКРЫТИЯ ФАЙЛА (без блокировки):
+ *   ID: Системный номер файла
+ *   MODE: Режим открытия
+ */
+static void FS_OPENS_RELEASE(
+/* IN  */ const FILE_ID ID,
+/* IN  */ const FILE_MODE MODE);
+
+#if FS_THREAD_SAFE
+/*
+ * ЗАХВАТ ТОМА (первый захват потоком):
+ *   scope: Переменная области FS_VOLUME_SCOPE (1 - монопольно)
+ *
+ * Монопольный захват внутри совместного запрещен (не повышается)
+ */
+static void FS_VOLUME_LOCK(
+/* INOUT */ U8 * scope);
+
+/*
+ * ОСВОБОЖДЕНИЕ ТОМА (при выходе из области последнего захвата):
+ *   scope: Переменная области FS_VOLUME_SCOPE
+ */
+static void FS_VOLUME_UNLOCK(
+/* INOUT */ U8 * scope);
+#endif
+/* ======== DESCRIPTOR ======== */
+
+
+
+/* ======== BUFFER ======== */
+/*
+ * ЗАПИСЬ БУФЕРА ВО FLASH (если буфер изменен):
+ *   descriptor: Данные дескриптора
+ *   return_code: Статус операции
+ *     NO_ERROR: Буфер записан или не требует записи
+ *     NO_ACTION: Нет места во flash или свободных блоков
+ *     OPERATION_FAILED: Ошибка записи
+ */
+static void FS_BUFFER_FLUSH(
+/* INOUT */ FS_DESCRIPTOR_TYPE * descriptor,
+/* OUT   */ RETURN_CODE * return_code);
+
+/*
+ * ЗАГРУЗКА БЛОКА ФАЙЛА В БУФЕР:
+ *   descriptor: Данные дескриптора
+ *   INDEX: Порядковый номер блока в файле
+ *   return_code: Статус операции
+ *     NO_ERROR: Блок в буфере
+ *     NO_ACTION: Цепочка блоков короче INDEX или нет места для записи
+ *                прежнего буфера
+ *     OPERATION_FAILED: Ошибка чтения или записи
+ *
+ * Переход к следующему блоку берет адрес из буфера (без чтения цепочки),
+ * переход назад начинает обход цепочки с lbi_start.
+ */
+static void FS_BUFFER_LOAD(
+/* INOUT */ FS_DESCRIPTOR_TYPE * descriptor,
+/* IN    */ const SIZE32 INDEX,
+/* OUT   */ RETURN_CODE * return_code);
+
+/*
+ * ДОБАВЛЕНИЕ НОВОГО БЛОКА В КОНЕЦ ФАЙЛА (блок остается в буфере):
+ *   descriptor: Данные дескриптора
+ *   return_code: Статус операции
+ *     NO_ERROR: Блок добавлен
+ *     NO_ACTION: Нет свободных блоков
+ *     OPERATION_FAILED: Ошибка чтения или записи
+ */
+static void FS_BUFFER_APPEND(
+/* INOUT */ FS_DESCRIPTOR_TYPE * descriptor,
+/* OUT   */ RETURN_CODE * return_code);
+
+/*
+ * ДОБАВЛЕНИЕ НОВОГО БЛОКА В КОНЕЦ ЖУРНАЛА (блок остается в буфере):
+ *   descriptor: Данные дескриптора
+ *   COUNT: Количество блоков журнала
+ *   return_code: Статус операции
+ *     NO_ERROR: Блок добавлен
+ *     NO_ACTION: Нет свободных блоков
+ *     OPERATION_FAILED: Ошибка чтения или записи
+ *
+ * Новый блок занимает LBI, заранее записанный в последнем блоке, и сам
+ * получает LBI следующего: заполненный блок не переписывается ради ссылки.
+ */
+static void FS_BUFFER_APPEND_LOG(
+/* INOUT */ FS_DESCRIPTOR_TYPE * descriptor,
+/* IN    */ const SIZE32 COUNT,
+/* OUT   */ RETURN_CODE * return_code);
+
+/*
+ * ПОМЕЩЕНИЕ ПРОЧИТАННОГО БЛОКА В БУФЕР (переход без обхода цепочки):
+ *   descriptor: Данные дескриптора
+ *   LBI: Номер блока
+ *   INDEX: Порядковый номер блока в файле
+ *   DATA: Данные блока (адрес следующего блока + данные)
+ *   return_code: Статус операции
+ *     NO_ERROR: Блок в буфере
+ *     NO_ACTION: Нет места для записи прежнего буфера
+ *     OPERATION_FAILED: Ошибка записи прежнего буфера
+ */
+static void FS_BUFFER_PLACE(
+/* INOUT */ FS_DESCRIPTOR_TYPE * descriptor,
+/* IN    */ const FTL_INDEX LBI,
+/* IN    */ const SIZE32 INDEX,
+/* IN    */ const VOID_PTR DATA,
+/* OUT   */ RETURN_CODE * return_code);
+
+/*
+ * КОПИРОВАНИЕ ПРИ ЗАПИСИ (перед записью блока буфера):
+ *   descriptor: Данные дескриптора
+ *   return_code: Статус операции
+ *     NO_ERROR: Блок буфера и путь к нему принадлежат только файлу
+ *     NO_ACTION: Нет свободных блоков
+ *     OPERATION_FAILED: Ошибка чтения или записи
+ *
+ * Адрес следующего блока хранится в самом блоке, поэтому разделяемый
+ * участок копируется от первого блока с несколькими ссылками до блока
+ * буфера; копия блока буфера ссылается на прежний следующий блок.
+ */
+static void FS_BUFFER_UNSHARE(
+/* INOUT */ FS_DESCRIPTOR_TYPE * descriptor,
+/* OUT   */ RETURN_CODE * return_code);
+/* ======== BUFFER ======== */
+
+
+
+/* ======== READAHEAD ======== */
+/*
+ * ЗАГРУЗКА СЛЕДУЮЩЕГО БЛОКА ЧЕРЕЗ ОКНО УПРЕЖДАЮЩЕГО ЧТЕНИЯ:
+ *   descriptor: Данные дескриптора
+ *   INDEX: Порядковый номер блока в файле (следующий за буфером)
+ *   LBI: Номер блока (из адреса следующего блока в буфере)
+ *   return_code: Статус операции
+ *     NO_ERROR: Блок в буфере (из окна или пакетным чтением)
+ *     NO_ACTION: Упреждение не применяется (блок читается обычно)
+ *
+ * Окно растет вдвое, когда все упрежденные блоки прочитаны, и
+ * уменьшается вдвое, когда часть их пропала. Упреждение только для
+ * FILE_MODE_READ_ONLY: запись разрешена одному дескриптору, поэтому
+ * данные окна не устаревают.
+ */
+static void FS_READAHEAD_LOAD(
+/* INOUT */ FS_DESCRIPTOR_TYPE * descriptor,
+/* IN    */ const SIZE32 INDEX,
+/* IN    */ const FTL_INDEX LBI,
+/* OUT   */ RETURN_CODE * return_code);
+
+/*
+ * СБРОС ОКНА УПРЕЖДАЮЩЕГО ЧТЕНИЯ (произвольный доступ или закрытие):
+ *   descriptor: Данные дескриптора
+ */
+static void FS_READAHEAD_RESET(
+/* INOUT */ FS_DESCRIPTOR_TYPE * descriptor);
+/* ======== READAHEAD ======== */
+
+
+
+/* ======== INLINE ======== */
+/*
+ * ЗАГРУЗКА ОБЩЕГО БЛОКА В ОЗУ (повторное обращение без чтения flash):
+ *   LBI: Номер общего блока
+ *   return_code: Статус операции
+ *     NO_ERROR: Блок загружен
+ *     OPERATION_FAILED: Ошибка чтения
+ */
+static void FS_INLINE_LOAD(
+/* IN  */ const FTL_INDEX LBI,
+/* OUT */ RETURN_CODE * return_code);
+
+/*
+ * ЧТЕНИЕ ФАЙЛА ИЗ ЯЧЕЙКИ В БУФЕР (как первого блока файла):
+ *   descriptor: Данные дескриптора
+ *   return_code: Статус операции
+ *     NO_ERROR: Данные в буфере
+ *     OPERATION_FAILED: Ошибка чтения
+ */
+static void FS_INLINE_READ(
+/* INOUT */ FS_DESCRIPTOR_TYPE * descriptor,
+/* OUT   */ RETURN_CODE * return_code);
+
+/*
+ * ЗАПИСЬ БУФЕРА В ЯЧЕЙКУ (ячейка выделяется при первой записи):
+ *   descriptor: Данные дескриптора
+ *   return_code: Статус операции
+ *     NO_ERROR: Данные записаны
+ *     NO_ACTION: Нет свободных блоков
+ *     OPERATION_FAILED: Ошибка чтения или записи
+ */
+static void FS_INLINE_WRITE(
+/* INOUT */ FS_DESCRIPTOR_TYPE * descriptor,
+/* OUT   */ RETURN_CODE * return_code);
+
+/*
+ * ОСВОБОЖДЕНИЕ ЯЧЕЙКИ (пустой общий блок освобождается):
+ *   LBI: Номер общего блока
+ *   SLOT: Номер ячейки
+ *   return_code: Статус операции
+ *     NO_ERROR: Ячейка освобождена
+ *     OPERATION_FAILED: Ошибка чтения или записи
+ */
+static void FS_INLINE_FREE(
+/* IN  */ const FTL_INDEX LBI,
+/* IN  */ const U8 SLOT,
+/* OUT */ RETURN_CODE * return_code);
+
+/*
+ * ПЕРЕНОС ПЕРВОГО БЛОКА ФАЙЛА В СОБСТВЕННЫЙ LBI (файл вырос):
+ *   descriptor: Данные дескриптора
+ *   return_code: Статус операции
+ *     NO_ERROR: Блоку буфера выделен LBI, ячейка освобождена
+ *     NO_ACTION: Нет свободных блоков
+ *     OPERATION_FAILED: Ошибка чтения или записи
+ */
+static void FS_INLINE_EXTRACT(
+/* INOUT */ FS_DESCRIPTOR_TYPE * descriptor,
+/* OUT   */ RETURN_CODE * return_code);
+/* ======== INLINE ======== */
+
+
+
+/* ======== SERIES ======== */
+/*
+ * КОДИРОВАНИЕ ЗАПИСИ ВРЕМЕННОГО РЯДА:
+ *   FRAME: Заголовок блока, в конец которого добавляется запись
+ *   BLOCK: Данные блока (первая запись - основа разности)
+ *   TIME: Метка времени
+ *   LENGTH: Размер данных
+ *   DATA: Данные
+ *   record: Закодированная запись (FS_SERIES_RECORD_MAX байт)
+ *   record_length: Размер закодированной записи
+ *   return_code: Статус операции
+ *     NO_ERROR: Запись закодирована
+ *     OPERATION_FAILED: Первая запись блока повреждена
+ *
+ * Запись: смещение времени от первой записи блока (LEB128), длина
+ * (LEB128, только у записей переменного размера) и данные. В пустом
+ * блоке запись становится первой: смещение 0, данные без разности.
+ */
+static void FS_SERIES_ENCODE(
+/* IN  */ const FS_SERIES_FRAME_TYPE * FRAME,
+/* IN  */ const U8 * BLOCK,
+/* IN  */ const U32 TIME,
+/* IN  */ const SIZE32 LENGTH,
+/* IN  */ const VOID_PTR DATA,
+/* OUT */ U8 * record,
+/* OUT */ SIZE32 * record_length,
+/* OUT */ RETURN_CODE * return_code);
+
+/*
+ * РАЗБОР ЗАПИСИ ВРЕМЕННОГО РЯДА:
+ *   FRAME: Заголовок блока
+ *   BLOCK: Данные блока
+ *   OFFSET: Смещение записи в данных блока
+ *   LIMIT: Конец записей блока
+ *   time: Метка времени
+ *   length: Размер данных
+ *   payload: Смещение данных в блоке
+ *   next: Смещение следующей записи
+ *   return_code: Статус операции
+ *     NO_ERROR: Запись разобрана
+ *     OPERATION_FAILED: Запись выходит за LIMIT или повреждена
+ */
+static void FS_SERIES_DECODE(
+/* IN  */ const FS_SERIES_FRAME_TYPE * FRAME,
+/* IN  */ const U8 * BLOCK,
+/* IN  */ const SIZE32 OFFSET,
+/* IN  */ const SIZE32 LIMIT,
+/* OUT */ U32 * time,
+/* OUT */ SIZE32 * length,
+/* OUT */ SIZE32 * payload,
+/* OUT */ SIZE32 * next,
+/* OUT */ RETURN_CODE * return_code);
+/* ======== SERIES ======== */
+
+
+
+
+
+
+/* ======== META ======== */
+static void FS_META_IMAGE(
+/* IN  */ const FTL_INDEX LBI,
+/* OUT */ U8 ** image,
+/* OUT */ SIZE32 * size,
+/* OUT */ RETURN_CODE * return_code)
+{
+  /* Таблицы, целиком находящиеся в ОЗУ */
+  if((LBI >= 1U) && (LBI < FS_FILEMAP_LBI))
+  {
+    const SIZE32 M_OFFSET = (LBI - 1U) * FS_BLOCK_SIZE;
+    *image = g_fs->block_flags + M_OFFSET;
+    *size = sizeof(BLOCK_FLAG_BITMAP) - M_OFFSET;
+    if(*size > FS_BLOCK_SIZE)
+    {
+      *size = FS_BLOCK_SIZE;
+    }
+    *return_code = NO_ERROR;
+    return;
+  }
+  if(FS_FILEMAP_LBI == LBI)
+  {
+    *image = (U8 *)g_fs->file_map;
+    *size = FS_BLOCK_SIZE;
+    *return_code = NO_ERROR;
+    return;
+  }
+  if((LBI >= 6U) && (LBI < 10U))
+  {
+    *image = (U8 *)g_fs->tag_names + (LBI - 6U) * 13U * TAG_NAME_SIZE;
+    *size = 13U * TAG_NAME_SIZE;
+    *return_code = NO_ERROR;
+    return;
+  }
+  if((LBI >= FS_TAGINDEX_LBI) && (LBI < FS_TAGINDEX_LBI + FS_TAGS_COUNT))
+  {
+    *image = (U8 *)g_fs->tag_index[LBI - FS_TAGINDEX_LBI];
+    *size = FS_BLOCK_SIZE;
+    *return_code = NO_ERROR;
+    return;
+  }
+  if((LBI >= FS_REFS_LBI) && (LBI < FS_REFS_LBI + FS_REFS_COUNT))
+  {
+    const SIZE32 M_OFFSET = (LBI - FS_REFS_LBI) * FS_BLOCK_SIZE;
+    *image = g_fs->block_refs + M_OFFSET;
+    *size = sizeof(g_fs->block_refs) - M_OFFSET;
+    if(*size > FS_BLOCK_SIZE)
+    {
+      *size = FS_BLOCK_SIZE;
+    }
+    *return_code = NO_ERROR;
+    return;
+  }
+  if((LBI < 10U) || (LBI >= FS_TAGINDEX_LBI))
+  {
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  /* Имена и заголовки - через кэш */
+  *size = FS_BLOCK_SIZE;
+  for(register SIZE32 i = 0U; i < FS_META_CACHE_COUNT; i++)
+  {
+    if(LBI == g_fs->meta_cache[i].lbi)
+    {
+      *image = g_fs->meta_cache[i].data;
+      *return_code = NO_ERROR;
+      return;
+    }
+  }
+
+  /*
+   * Блоки открытой транзакции не вытесняются, блоки закрытых - после
+   * записи блока журнала
+   */
+  SIZE32 m_victim = FS_META_CACHE_COUNT;
+  for(register SIZE32 m_pass = 0U;
+      (m_pass < 2U) && (FS_META_CACHE_COUNT == m_victim); m_pass++)
+  {
+    if((0U != m_pass) && (0U != g_fs->journal.block.length))
+    {
+      RETURN_CODE m_write_error = NO_ERROR;
+      FS_JOURNAL_WRITE(&m_write_error);
+      if(NO_ERROR != m_write_error)
+      {
+        *return_code = OPERATION_FAILED;
+        return;
+      }
+    }
+    for(register SIZE32 i = 0U; i < FS_META_CACHE_COUNT; i++)
+    {
+      const SIZE32 M_INDEX = (g_fs->meta_cache_next + i) % FS_META_CACHE_COUNT;
+      if(FS_META_PENDING_NONE == g_fs->meta_cache[M_INDEX].pending)
+      {
+        m_victim = M_INDEX;
+        break;
+      }
+    }
+  }
+  if(FS_META_CACHE_COUNT == m_victim)
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+  FS_META_CACHE_TYPE * m_entry = &(g_fs->meta_cache[m_victim]);
+
+  /* Зафиксированные изменения можно записать на место в любой момент */
+  const FTL_INDEX M_OLD_LBI = m_entry->lbi;
+  if(((FTL_INDEX)UN_SET != M_OLD_LBI)
+  && (0U != (g_fs->meta_dirty[M_OLD_LBI / 32U] & (1UL << (M_OLD_LBI % 32U)))))
+  {
+    RETURN_CODE m_write_error = NO_ERROR;
+    FTL_WRITE(M_OLD_LBI, 1U, m_entry->data, &m_write_error);
+    if(NO_ERROR != m_write_error)
+    {
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+    g_fs->meta_dirty[M_OLD_LBI / 32U] &= ~(1UL << (M_OLD_LBI % 32U));
+  }
+
+  m_entry->lbi = (FTL_INDEX)UN_SET;
+  RETURN_CODE m_read_error = NO_ERROR;
+  FTL_READ(LBI, 1U, m_entry->data, &m_read_error);
+  if(NO_ERROR != m_read_error)
+  {
+    *return_code = (NO_ACTION == m_read_error) ? NO_ACTION : OPERATION_FAILED;
+    return;
+  }
+
+  m_entry->lbi = LBI;
+  m_entry->pending = FS_META_PENDING_NONE;
+  g_fs->meta_cache_next = (m_victim + 1U) % FS_META_CACHE_COUNT;
+
+  *image = m_entry->data;
+  *return_code = NO_ERROR;
+}
+
+static void FS_META_APPLY(
+/* IN  */ const FTL_INDEX LBI,
+/* IN  */ const SIZE32 OFFSET,
+/* IN  */ const SIZE32 LENGTH,
+/* IN  */ const VOID_PTR DATA,
+/* OUT */ RETURN_CODE * return_code)
+{
+  U8 * m_image;
+  SIZE32 m_size;
+  RETURN_CODE m_image_error = NO_ERROR;
+  FS_META_IMAGE(LBI, &m_image, &m_size, &m_image_error);
+  if(NO_ERROR != m_image_error)
+  {
+    *return_code = (INVALID_PARAM == m_image_error) ? INVALID_PARAM : OPERATION_FAILED;
+    return;
+  }
+  if((OFFSET > m_size) || (LENGTH > m_size - OFFSET))
+  {
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  STD_MEMCPY(LENGTH, DATA, m_image + OFFSET);
+  g_fs->meta_dirty[LBI / 32U] |= (1UL << (LBI % 32U));
+
+  *return_code = NO_ERROR;
+}
+
+static void FS_META_WRITE(
+/* IN  */ const FTL_INDEX LBI,
+/* IN  */ const SIZE32 OFFSET,
+/* IN  */ const SIZE32 LENGTH,
+/* IN  */ const VOID_PTR DATA,
+/* OUT */ RETURN_CODE * return_code)
+{
+  /* Запись должна поместиться в блок журнала вместе с отметкой отмены */
+  const SIZE32 M_RECORD_SIZE = 4U + LENGTH;
+  if((0U == g_fs->journal.depth)
+  || (M_RECORD_SIZE + 4U > sizeof(g_fs->journal.block.records)))
+  {
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  /* 1. Образ блока (вытеснение из кэша может записать блок журнала) */
+  U8 * m_image;
+  SIZE32 m_size;
+  RETURN_CODE m_image_error = NO_ERROR;
+  FS_META_IMAGE(LBI, &m_image, &m_size, &m_image_error);
+  if(NO_ERROR != m_image_error)
+  {
+    *return_code = (INVALID_PARAM == m_image_error) ? INVALID_PARAM : OPERATION_FAILED;
+    return;
+  }
+  if((OFFSET > m_size) || (LENGTH > m_size - OFFSET))
+  {
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  /* 2. Новые данные - в блок журнала, прежние - в журнал отмены */
+  RETURN_CODE m_append_error = NO_ERROR;
+  FS_JOURNAL_APPEND(LBI, OFFSET, LENGTH, (const U8 *)DATA, &m_append_error);
+  if(NO_ERROR != m_append_error)
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+  RETURN_CODE m_undo_error = NO_ERROR;
+  FS_JOURNAL_UNDO(LBI, OFFSET, LENGTH, m_image + OFFSET, &m_undo_error);
+  if(NO_ERROR != m_undo_error)
+  {
+    g_fs->journal.block.length -= M_RECORD_SIZE;
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  /* 3. Изменение образа */
+  STD_MEMCPY(LENGTH, DATA, m_image + OFFSET);
+  g_fs->meta_dirty[LBI / 32U] |= (1UL << (LBI % 32U));
+  for(register SIZE32 i = 0U; i < FS_META_CACHE_COUNT; i++)
+  {
+    if(LBI == g_fs->meta_cache[i].lbi)
+    {
+      g_fs->meta_cache[i].pending = FS_META_PENDING_OPEN;
+    }
+  }
+
+  *return_code = NO_ERROR;
+}
+/* ======== META ======== */
+
+
+
+/* ======== JOURNAL ======== */
+static U32 FS_JOURNAL_BEGIN(
+/* IN  */ const U8 KEEP)
+{
+  if(0U == g_fs->journal.depth)
+  {
+    g_fs->journal.start = g_fs->journal.block.length;
+    g_fs->journal.spilled = 0U;
+  }
+  g_fs->journal.depth++;
+
+  /* Начало изменений этой транзакции в журнале отмены */
+  return ((U32)KEEP << 31U) | g_fs->journal.undo_length;
+}
+
+static void FS_JOURNAL_END(
+/* IN  */ U32 * scope)
+{
+  /* Транзакция с сохраняемыми изменениями не отменяется и внешней */
+  if((0U != (*scope >> 31U))
+  && (g_fs->journal.undo_length > (*scope & 0x7FFFFFFFU)))
+  {
+    g_fs->journal.keep = 1U;
+  }
+
+  g_fs->journal.depth--;
+  if(0U != g_fs->journal.depth)
+  {
+    return;
+  }
+
+  RETURN_CODE m_end_error = NO_ERROR;
+  if(g_fs->journal.keep)
+  {
+    FS_JOURNAL_CLOSE(0U, &m_end_error);
+  }
+  else
+  {
+    FS_JOURNAL_ABORT(&m_end_error);
+  }
+}
+
+static void FS_JOURNAL_APPEND(
+/* IN  */ const FTL_INDEX LBI,
+/* IN  */ const SIZE32 OFFSET,
+/* IN  */ const SIZE32 LENGTH,
+/* IN  */ const U8 * DATA,
+/* OUT */ RETURN_CODE * return_code)
+{
+  /* Отметка отмены предшествует любой следующей записи */
+  const SIZE32 M_CANCEL = g_fs->journal.cancel ? 4U : 0U;
+  if(g_fs->journal.block.length + M_CANCEL + 4U + LENGTH
+     > sizeof(g_fs->journal.block.records))
+  {
+    RETURN_CODE m_write_error = NO_ERROR;
+    FS_JOURNAL_WRITE(&m_write_error);
+    if(NO_ERROR != m_write_error)
+    {
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+  }
+
+  U8 * m_record = g_fs->journal.block.records + g_fs->journal.block.length;
+  if(g_fs->journal.cancel)
+  {
+    m_record[0U] = (U8)(FS_JOURNAL_MARK_ABORT >> 8U);
+    m_record[1U] = (U8)(FS_JOURNAL_MARK_ABORT);
+    m_record[2U] = 0U;
+    m_record[3U] = 0U;
+    m_record += 4U;
+    g_fs->journal.block.length += 4U;
+    g_fs->journal.cancel = 0U;
+  }
+  m_record[0U] = (U8)(LBI >> 8U);
+  m_record[1U] = (U8)(LBI);
+  m_record[2U] = (U8)(OFFSET);
+  m_record[3U] = (U8)(LENGTH);
+  STD_MEMCPY(LENGTH, (VOID_PTR)DATA, m_record + 4U);
+  g_fs->journal.block.length += 4U + LENGTH;
+
+  *return_code = NO_ERROR;
+}
+
+static void FS_JOURNAL_UNDO(
+/* IN  */ const FTL_INDEX LBI,
+/* IN  */ const SIZE32 OFFSET,
+/* IN  */ const SIZE32 LENGTH,
+/* IN  */ const U8 * DATA,
+/* OUT */ RETURN_CODE * return_code)
+{
+  if(g_fs->journal.undo_length + LENGTH + 4U > FS_JOURNAL_UNDO_SIZE)
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  /* Заголовок после данных: отмена идет от последней записи к первой */
+  U8 * m_entry = g_fs->journal.undo + g_fs->journal.undo_length;
+  STD_MEMCPY(LENGTH, (VOID_PTR)DATA, m_entry);
+  m_entry[LENGTH + 0U] = (U8)(LBI >> 8U);
+  m_entry[LENGTH + 1U] = (U8)(LBI);
+  m_entry[LENGTH + 2U] = (U8)(OFFSET);
+  m_entry[LENGTH + 3U] = (U8)(LENGTH);
+  g_fs->journal.undo_length += LENGTH + 4U;
+
+  *return_code = NO_ERROR;
+}
+
+static void FS_JOURNAL_WRITE(
+/* OUT */ RETURN_CODE * return_code)
+{
+  /* Блок с транзакцией после контрольной точки не перезаписывается */
+  if(g_fs->journal.sequence - 1U - g_fs->superblock.checkpoint
+     >= FS_JOURNAL_COUNT)
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  g_fs->journal.block.sequence = g_fs->journal.sequence;
+  HASH_CRC(
+    &(g_fs->journal.block.sequence), FS_BLOCK_SIZE - sizeof(U32),
+    &(g_fs->journal.block.crc32)
+  );
+
+  RETURN_CODE m_write_error = NO_ERROR;
+  FTL_WRITE(
+    FS_JOURNAL_LBI + g_fs->journal.sequence % FS_JOURNAL_COUNT, 1U,
+    &(g_fs->journal.block), &m_write_error
+  );
+  if(NO_ERROR != m_write_error)
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  g_fs->journal.sequence++;
+  g_fs->journal.block.length = 0U;
+  g_fs->journal.start = 0U;
+  if(0U != g_fs->journal.undo_length)
+  {
+    g_fs->journal.spilled = 1U;
+  }
+  for(register SIZE32 i = 0U; i < FS_META_CACHE_COUNT; i++)
+  {
+    if(FS_META_PENDING_CLOSED == g_fs->meta_cache[i].pending)
+    {
+      g_fs->meta_cache[i].pending = FS_META_PENDING_NONE;
+    }
+  }
+
+  *return_code = NO_ERROR;
+}
+
+static void FS_JOURNAL_CLOSE(
+/* IN  */ const U8 DURABLE,
+/* OUT */ RETURN_CODE * return_code)
+{
+  /* 1. Отметка фиксации закрывает транзакцию в блоке журнала */
+  SIZE32 m_mark = g_fs->journal.block.length;
+  if(0U != g_fs->journal.undo_length)
+  {
+    RETURN_CODE m_mark_error = NO_ERROR;
+    FS_JOURNAL_APPEND(FS_JOURNAL_MARK_COMMIT, 0U, 0U, (const U8 *)0, &m_mark_error);
+    if(NO_ERROR != m_mark_error)
+    {
+      FS_JOURNAL_ABORT(&m_mark_error);
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+    m_mark = g_fs->journal.block.length - 4U;
+    for(register SIZE32 i = 0U; i < FS_META_CACHE_COUNT; i++)
+    {
+      if(FS_META_PENDING_OPEN == g_fs->meta_cache[i].pending)
+      {
+        g_fs->meta_cache[i].pending = FS_META_PENDING_CLOSED;
+      }
+    }
+  }
+
+  /*
+   * 2. Запись блока: по запросу, при освобождении цепочек (до контрольной
+   * точки их блоки не выделяются) и когда занята половина журнала (следующей
+   * транзакции остается не меньше половины блоков)
+   */
+  const U8 M_HALF = (g_fs->journal.sequence - 1U - g_fs->superblock.checkpoint
+                     >= FS_JOURNAL_COUNT / 2U);
+  if((DURABLE || g_fs->journal.frees || M_HALF)
+  && (0U != g_fs->journal.block.length))
+  {
+    RETURN_CODE m_write_error = NO_ERROR;
+    FS_JOURNAL_WRITE(&m_write_error);
+    if(NO_ERROR != m_write_error)
+    {
+      /* Сохраняемая транзакция остается закрытой до следующей записи */
+      if((0U != g_fs->journal.undo_length) && !g_fs->journal.keep)
+      {
+        g_fs->journal.block.length = m_mark;
+        FS_JOURNAL_ABORT(&m_write_error);
+      }
+      else
+      {
+        g_fs->journal.start = g_fs->journal.block.length;
+        g_fs->journal.spilled = 0U;
+        g_fs->journal.undo_length = 0U;
+        g_fs->journal.keep = 0U;
+      }
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+  }
+
+  /*
+   * 3. Обрывы цепочек - после записи блока журнала (при сбое повторяются),
+   * контрольная точка - после обрывов
+   */
+  RETURN_CODE m_checkpoint_error = NO_ERROR;
+  if(0U == g_fs->journal.block.length)
+  {
+    FS_JOURNAL_DEFER(FS_JOURNAL_MARK_CUT, &m_checkpoint_error);
+  }
+  if((NO_ERROR == m_checkpoint_error) && (0U == g_fs->journal.block.length)
+  && (g_fs->journal.frees || M_HALF))
+  {
+    FS_JOURNAL_CHECKPOINT(&m_checkpoint_error);
+  }
+
+  /* 4. Освобожденные цепочки сообщаются FTL после контрольной точки */
+  if((NO_ERROR == m_checkpoint_error) && !g_fs->journal.frees)
+  {
+    FS_JOURNAL_DEFER(FS_JOURNAL_MARK_FREE, &m_checkpoint_error);
+  }
+
+  g_fs->journal.start = g_fs->journal.block.length;
+  g_fs->journal.spilled = 0U;
+  g_fs->journal.undo_length = 0U;
+  g_fs->journal.keep = 0U;
+
+  *return_code
+    = (NO_ERROR == m_checkpoint_error) ? NO_ERROR : OPERATION_FAILED;
+}
+
+static void FS_JOURNAL_COMMIT(
+/* OUT */ RETURN_CODE * return_code)
+{
+  /* Вложенную транзакцию фиксирует внешняя */
+  if(g_fs->journal.depth > 1U)
+  {
+    *return_code = NO_ERROR;
+    return;
+  }
+
+  FS_JOURNAL_CLOSE(1U, return_code);
+}
+
+static void FS_JOURNAL_ABORT(
+/* OUT */ RETURN_CODE * return_code)
+{
+  /* 1. Прежние данные - от последнего изменения к первому */
+  RETURN_CODE m_restore_error = NO_ERROR;
+  for(SIZE32 m_end = g_fs->journal.undo_length; m_end >= 4U;)
+  {
+    const U8 * M_HEADER = g_fs->journal.undo + m_end - 4U;
+    const FTL_INDEX M_LBI = (FTL_INDEX)((M_HEADER[0U] << 8U) | M_HEADER[1U]);
+    const SIZE32 M_LENGTH = M_HEADER[3U];
+    const U8 * M_DATA = M_HEADER - M_LENGTH;
+    RETURN_CODE m_entry_error = NO_ERROR;
+    if(FS_JOURNAL_MARK_FREE == M_LBI)
+    {
+      FS_JOURNAL_CHAIN(
+        (FTL_INDEX)((M_DATA[0U] << 8U) | M_DATA[1U]),
+        (SIZE32)((M_DATA[2U] << 8U) | M_DATA[3U]), BLOCK_FLAG_USED,
+        &m_entry_error
+      );
+    }
+    else if(FS_JOURNAL_MARK_CUT == M_LBI)
+    {
+      /* Блок цепочки еще не изменен */
+    }
+    else
+    {
+      FS_META_APPLY(M_LBI, M_HEADER[2U], M_LENGTH, (VOID_PTR)M_DATA, &m_entry_error);
+    }
+    if(NO_ERROR != m_entry_error)
+    {
+      m_restore_error = OPERATION_FAILED;
+    }
+    m_end -= 4U + M_LENGTH;
+  }
+
+  /* 2. Записи удаляются из блока или, если часть уже записана в журнал,
+   *    отменяются отметкой перед следующей записью */
+  if(g_fs->journal.spilled)
+  {
+    g_fs->journal.cancel = 1U;
+  }
+  else
+  {
+    g_fs->journal.block.length = g_fs->journal.start;
+  }
+  for(register SIZE32 i = 0U; i < FS_META_CACHE_COUNT; i++)
+  {
+    if(FS_META_PENDING_OPEN == g_fs->meta_cache[i].pending)
+    {
+      g_fs->meta_cache[i].pending = FS_META_PENDING_CLOSED;
+    }
+  }
+
+  /* Выделение общего блока маленьких файлов могло быть отменено */
+  if(0U != g_fs->journal.undo_length)
+  {
+    g_fs->inline_block.lbi = (FTL_INDEX)UN_SET;
+  }
+
+  g_fs->journal.start = g_fs->journal.block.length;
+  g_fs->journal.spilled = 0U;
+  g_fs->journal.undo_length = 0U;
+  g_fs->journal.keep = 0U;
+
+  *return_code = m_restore_error;
+}
+
+static void FS_JOURNAL_INTENT(
+/* IN  */ const FTL_INDEX MARK,
+/* IN  */ const SIZE32 LENGTH,
+/* IN  */ const U8 * DATA,
+/* OUT */ RETURN_CODE * return_code)
+{
+  if(0U == g_fs->journal.depth)
+  {
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  RETURN_CODE m_intent_error = NO_ERROR;
+  FS_JOURNAL_APPEND(MARK, 0U, LENGTH, DATA, &m_intent_error);
+  if(NO_ERROR != m_intent_error)
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+  FS_JOURNAL_UNDO(MARK, 0U, LENGTH, DATA, &m_intent_error);
+  if(NO_ERROR != m_intent_error)
+  {
+    g_fs->journal.block.length -= 4U + LENGTH;
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  /* Блок журнала записывается при закрытии, контрольная точка - после
+   * выполнения намерений */
+  g_fs->journal.frees = 1U;
+  *return_code = NO_ERROR;
+}
+
+static void FS_JOURNAL_DEFER(
+/* IN  */ const FTL_INDEX MARK,
+/* OUT */ RETURN_CODE * return_code)
+{
+  RETURN_CODE m_defer_error = NO_ERROR;
+  for(SIZE32 m_end = g_fs->journal.undo_length; m_end >= 4U;)
+  {
+    const U8 * M_HEADER = g_fs->journal.undo + m_end - 4U;
+    const FTL_INDEX M_LBI = (FTL_INDEX)((M_HEADER[0U] << 8U) | M_HEADER[1U]);
+    const SIZE32 M_LENGTH = M_HEADER[3U];
+    const U8 * M_DATA = M_HEADER - M_LENGTH;
+    const FTL_INDEX M_BLOCK = (FTL_INDEX)((M_DATA[0U] << 8U) | M_DATA[1U]);
+    if((MARK == M_LBI) && (FS_JOURNAL_MARK_FREE == M_LBI))
+    {
+      FS_BLOCK_DISCARD(M_BLOCK, (SIZE32)((M_DATA[2U] << 8U) | M_DATA[3U]));
+    }
+    if((MARK == M_LBI) && (FS_JOURNAL_MARK_CUT == M_LBI))
+    {
+      RETURN_CODE m_cut_error = NO_ERROR;
+      FS_BLOCKNEXT_WRITE(M_BLOCK, FS_BLOCK_NONE, &m_cut_error);
+      if(NO_ERROR != m_cut_error)
+      {
+        m_defer_error = OPERATION_FAILED;
+      }
+    }
+    m_end -= 4U + M_LENGTH;
+  }
+
+  *return_code = m_defer_error;
+}
+
+static void FS_JOURNAL_CHAIN(
+/* IN  */ const FTL_INDEX LBI,
+/* IN  */ const SIZE32 COUNT,
+/* IN  */ const BLOCK_FLAG FLAG,
+/* OUT */ RETURN_CODE * return_code)
+{
+  FTL_INDEX m_lbi = LBI;
+  for(SIZE32 i = 0U; (i < COUNT) && (FS_BLOCK_NONE != m_lbi); i++)
+  {
+    FTL_INDEX m_next = FS_BLOCK_NONE;
+    RETURN_CODE m_next_error = NO_ERROR;
+    if(i + 1U < COUNT)
+    {
+      FS_BLOCKNEXT_READ(m_lbi, &m_next, &m_next_error);
+    }
+    RETURN_CODE m_flag_error = NO_ERROR;
+    FS_BLOCKFLAG_APPLY(m_lbi, FLAG, &m_flag_error);
+    if((NO_ERROR != m_next_error) || (NO_ERROR != m_flag_error))
+    {
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+    m_lbi = m_next;
+  }
+
+  *return_code = NO_ERROR;
+}
+
+static void FS_JOURNAL_CHECKPOINT(
+/* OUT */ RETURN_CODE * return_code)
+{
+  for(register FTL_INDEX m_lbi = 1U; m_lbi < FS_DATA_LBI; m_lbi++)
+  {
+    if(0U == (g_fs->meta_dirty[m_lbi / 32U] & (1UL << (m_lbi % 32U))))
+    {
+      continue;
+    }
+
+    U8 * m_image;
+    SIZE32 m_size;
+    RETURN_CODE m_image_error = NO_ERROR;
+    FS_META_IMAGE(m_lbi, &m_image, &m_size, &m_image_error);
+    if(NO_ERROR != m_image_error)
+    {
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+
+    /* Образ может быть короче блока (имена тегов, конец карты блоков) */
+    U8 m_data[FS_BLOCK_SIZE] = {0};
+    STD_MEMCPY(m_size, m_image, m_data);
+    RETURN_CODE m_write_error = NO_ERROR;
+    FTL_WRITE(m_lbi, 1U, m_data, &m_write_error);
+    if(NO_ERROR != m_write_error)
+    {
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+    g_fs->meta_dirty[m_lbi / 32U] &= ~(1UL << (m_lbi % 32U));
+  }
+
+  /* Блоки журнала до sequence - 1 перенесены в таблицы */
+  g_fs->superblock.checkpoint = g_fs->journal.sequence - 1U;
+  U8 m_superblock[FS_BLOCK_SIZE] = {0};
+  STD_MEMCPY(sizeof(FS_SUPERBLOCK_TYPE), &g_fs->superblock, m_superblock);
+  RETURN_CODE m_superblock_error = NO_ERROR;
+  FTL_WRITE(0U, 1U, m_superblock, &m_superblock_error);
+  if(NO_ERROR != m_superblock_error)
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  /* Намерения освобождения больше не воспроизводятся */
+  g_fs->journal.frees = 0U;
+  *return_code = NO_ERROR;
+}
+
+static void FS_JOURNAL_LOAD(
+/* IN  */ const SIZE32 SLOT,
+/* OUT */ RETURN_CODE * return_code)
+{
+  FS_JOURNAL_BLOCK_TYPE * m_block = &(g_fs->journal.block);
+  RETURN_CODE m_read_error = NO_ERROR;
+  FTL_READ(FS_JOURNAL_LBI + SLOT, 1U, m_block, &m_read_error);
+  if(OPERATION_FAILED == m_read_error)
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  U32 m_crc;
+  HASH_CRC(&(m_block->sequence), FS_BLOCK_SIZE - sizeof(U32), &m_crc);
+  if((NO_ERROR != m_read_error) || (0U == m_block->sequence)
+  || (m_crc != m_block->crc32) || (m_block->length > sizeof(m_block->records)))
+  {
+    *return_code = NO_ACTION;
+    return;
+  }
+
+  *return_code = NO_ERROR;
+}
+
+static void FS_JOURNAL_APPLY(
+/* IN  */ const U32 FROM_SEQUENCE,
+/* IN  */ const SIZE32 FROM_OFFSET,
+/* IN  */ const U32 TO_SEQUENCE,
+/* IN  */ const SIZE32 TO_OFFSET,
+/* OUT */ RETURN_CODE * return_code)
+{
+  FS_JOURNAL_BLOCK_TYPE * m_block = &(g_fs->journal.block);
+  for(U32 m_sequence = FROM_SEQUENCE; m_sequence <= TO_SEQUENCE; m_sequence++)
+  {
+    /* Начало транзакции в предыдущих блоках - блоки читаются заново */
+    if(FROM_SEQUENCE != TO_SEQUENCE)
+    {
+      RETURN_CODE m_load_error = NO_ERROR;
+      FS_JOURNAL_LOAD(m_sequence % FS_JOURNAL_COUNT, &m_load_error);
+      if((NO_ERROR != m_load_error) || (m_sequence != m_block->sequence))
+      {
+        *return_code = OPERATION_FAILED;
+        return;
+      }
+    }
+
+    const SIZE32 M_END
+      = (m_sequence == TO_SEQUENCE) ? TO_OFFSET : m_block->length;
+    SIZE32 m_offset = (m_sequence == FROM_SEQUENCE) ? FROM_OFFSET : 0U;
+    while(m_offset + 4U <= M_END)
+    {
+      const U8 * M_RECORD = m_block->records + m_offset;
+      const FTL_INDEX M_LBI = (FTL_INDEX)((M_RECORD[0U] << 8U) | M_RECORD[1U]);
+      const SIZE32 M_LENGTH = M_RECORD[3U];
+      RETURN_CODE m_apply_error = NO_ERROR;
+      if(FS_JOURNAL_MARK_FREE == M_LBI)
+      {
+        FS_JOURNAL_CHAIN(
+          (FTL_INDEX)((M_RECORD[4U] << 8U) | M_RECORD[5U]),
+          (SIZE32)((M_RECORD[6U] << 8U) | M_RECORD[7U]), BLOCK_FLAG_FREE,
+          &m_apply_error
+        );
+      }
+      else if(FS_JOURNAL_MARK_CUT == M_LBI)
+      {
+        FS_BLOCKNEXT_WRITE(
+          (FTL_INDEX)((M_RECORD[4U] << 8U) | M_RECORD[5U]), FS_BLOCK_NONE,
+          &m_apply_error
+        );
+      }
+      else
+      {
+        FS_META_APPLY(
+          M_LBI, M_RECORD[2U], M_LENGTH, (VOID_PTR)(M_RECORD + 4U),
+          &m_apply_error
+        );
+      }
+      if(OPERATION_FAILED == m_apply_error)
+      {
+        *return_code = OPERATION_FAILED;
+        return;
+      }
+      m_offset += 4U + M_LENGTH;
+    }
+  }
+
+  *return_code = NO_ERROR;
+}
+
+static void FS_JOURNAL_REPLAY(
+/* OUT */ RETURN_CODE * return_code)
+{
+  FS_JOURNAL_BLOCK_TYPE * m_block = &(g_fs->journal.block);
+  const U32 M_CHECKPOINT = g_fs->superblock.checkpoint;
+
+  /* 1. Номера во всех блоках журнала (0 - блок не прочитан) */
+  U32 m_sequences[FS_JOURNAL_COUNT];
+  U32 m_first = UN_SET;
+  U32 m_last = M_CHECKPOINT;
+  for(register SIZE32 n = 0U; n < FS_JOURNAL_COUNT; n++)
+  {
+    RETURN_CODE m_load_error = NO_ERROR;
+    FS_JOURNAL_LOAD(n, &m_load_error);
+    if(OPERATION_FAILED == m_load_error)
+    {
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+    m_sequences[n] = (NO_ERROR == m_load_error) ? m_block->sequence : 0U;
+    if(m_sequences[n] > M_CHECKPOINT)
+    {
+      m_first = (m_sequences[n] < m_first) ? m_sequences[n] : m_first;
+      m_last = (m_sequences[n] > m_last) ? m_sequences[n] : m_last;
+    }
+  }
+
+  /* 2. Блоки после контрольной точки - по возрастанию номера до первого
+   * отсутствующего; транзакция применяется на своей отметке фиксации.
+   * Первым может оказаться не checkpoint + 1, если суперблок контрольной
+   * точки не записан: таблицы уже содержат ее изменения, а повтор более
+   * ранних транзакций журнала их не портит */
+  U32 m_start_sequence = m_first;
+  SIZE32 m_start_offset = 0U;
+  for(U32 m_sequence = m_first; UN_SET != m_sequence; m_sequence++)
+  {
+    SIZE32 m_slot = 0U;
+    while((m_slot < FS_JOURNAL_COUNT) && (m_sequence != m_sequences[m_slot]))
+    {
+      m_slot++;
+    }
+    if(FS_JOURNAL_COUNT == m_slot)
+    {
+      break;
+    }
+
+    RETURN_CODE m_load_error = NO_ERROR;
+    FS_JOURNAL_LOAD(m_slot, &m_load_error);
+    if(NO_ERROR != m_load_error)
+    {
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+
+    for(register SIZE32 m_offset = 0U; m_offset + 4U <= m_block->length;)
+    {
+      const U8 * M_RECORD = m_block->records + m_offset;
+      const FTL_INDEX M_LBI = (FTL_INDEX)((M_RECORD[0U] << 8U) | M_RECORD[1U]);
+      const SIZE32 M_LENGTH = M_RECORD[3U];
+      if(m_offset + 4U + M_LENGTH > m_block->length)
+      {
+        break;
+      }
+
+      if(FS_JOURNAL_MARK_COMMIT == M_LBI)
+      {
+        RETURN_CODE m_apply_error = NO_ERROR;
+        FS_JOURNAL_APPLY(
+          m_start_sequence, m_start_offset, m_sequence, m_offset,
+          &m_apply_error
+        );
+        if(NO_ERROR != m_apply_error)
+        {
+          *return_code = OPERATION_FAILED;
+          return;
+        }
+      }
+      m_offset += 4U + M_LENGTH;
+      if((FS_JOURNAL_MARK_COMMIT == M_LBI) || (FS_JOURNAL_MARK_ABORT == M_LBI))
+      {
+        m_start_sequence = m_sequence;
+        m_start_offset = m_offset;
+      }
+    }
+  }
+
+  /* 3. Новые блоки нумеруются после всех прочитанных: блок, оставшийся
+   * за неполным, не станет продолжением журнала */
+  g_fs->journal.sequence = m_last + 1U;
+  m_block->length = 0U;
+
+  /* Воспроизведенные изменения сразу переносятся в таблицы */
+  if(m_last != M_CHECKPOINT)
+  {
+    FS_JOURNAL_CHECKPOINT(return_code);
+    return;
+  }
+
+  *return_code = NO_ERROR;
+}
+/* ======== JOURNAL ======== */
+
+
+
+/* ======== BLOCKNEXT ======== */
+static void FS_BLOCKNEXT_READ(
+/* IN  */ const FTL_INDEX LBI,
+/* OUT */ FTL_INDEX * next_lbi,
+/* OUT */ RETURN_CODE * return_code)
+{
+  U8 m_data[FS_BLOCK_SIZE];
+  RETURN_CODE m_read_error = NO_ERROR;
+  FTL_READ(LBI, 1U, m_data, &m_read_error);
+  if(NO_ACTION == m_read_error)
+  {
+    *return_code = NO_ACTION;
+    return;
+  }
+  if(OPERATION_FAILED == m_read_error)
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  *next_lbi = (FTL_INDEX)((m_data[0] << 8U) | m_data[1]);
+
+  *return_code = NO_ERROR;
+}
+
+static void FS_BLOCKNEXT_WRITE(
+/* IN  */ const FTL_INDEX LBI,
+/* IN  */ const FTL_INDEX NEXT_LBI,
+/* OUT */ RETURN_CODE * return_code)
+{
+  U8 m_data[FS_BLOCK_SIZE];
+  RETURN_CODE m_read_error = NO_ERROR;
+  FTL_READ(LBI, 1U, m_data, &m_read_error);
+  if(NO_ACTION == m_read_error)
+  {
+    *return_code = NO_ACTION;
+    return;
+  }
+  if(OPERATION_FAILED == m_read_error)
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  m_data[0U] = (U8)(NEXT_LBI >> 8U);
+  m_data[1U] = (U8)(NEXT_LBI);
+  RETURN_CODE m_write_error = NO_ERROR;
+  FTL_WRITE(LBI, 1U, m_data, &m_write_error);
+  if(NO_ERROR != m_write_error)
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  *return_code = NO_ERROR;
+}
+/* ======== BLOCKNEXT ======== */
+
+
+
+/* ======== BLOCKFLAG ======== */
+static void FS_BLOCKFLAG_READ(
+/* IN  */ const FTL_INDEX LBI,
+/* OUT */ BLOCK_FLAG * flag,
+/* OUT */ RETURN_CODE * return_code)
+{
+  if(LBI >= FS_BLOCKS_COUNT)
+  {
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  SIZE32 m_index = LBI / 4U;
+  U8 m_shift = (LBI % 4U) * 2U;
+
+  *flag = (BLOCK_FLAG)((g_fs->block_flags[m_index] >> m_shift) & 0x03U);
+
+  *return_code = NO_ERROR;
+}
+
+static void FS_BLOCKFLAG_WRITE(
+/* IN  */ const FTL_INDEX LBI,
+/* IN  */ const BLOCK_FLAG FLAG,
+/* OUT */ RETURN_CODE * return_code)
+{
+  if(LBI >= FS_BLOCKS_COUNT)
+  {
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  SIZE32 m_index = LBI / 4U;
+  U8 m_shift = (LBI % 4U) * 2U;
+  U8 m_mask = 0x03U << m_shift;
+
+  U8 m_byte = (U8)((g_fs->block_flags[m_index] & ~m_mask) | (FLAG << m_shift));
+  FS_META_WRITE(
+    1U + m_index / FS_BLOCK_SIZE, m_index % FS_BLOCK_SIZE, 1U, &m_byte,
+    return_code
+  );
+}
+
+static void FS_BLOCKFLAG_APPLY(
+/* IN  */ const FTL_INDEX LBI,
+/* IN  */ const BLOCK_FLAG FLAG,
+/* OUT */ RETURN_CODE * return_code)
+{
+  if(LBI >= FS_BLOCKS_COUNT)
+  {
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  SIZE32 m_index = LBI / 4U;
+  U8 m_shift = (LBI % 4U) * 2U;
+  U8 m_mask = 0x03U << m_shift;
+
+  U8 m_byte = (U8)((g_fs->block_flags[m_index] & ~m_mask) | (FLAG << m_shift));
+  FS_META_APPLY(
+    1U + m_index / FS_BLOCK_SIZE, m_index % FS_BLOCK_SIZE, 1U, &m_byte,
+    return_code
+  );
+}
+
+static void FS_BLOCKFLAG_FLUSH(
+/* IN  */ const SIZE32 INDEX,
+/* OUT */ RETURN_CODE * return_code)
+{
+  const SIZE32 M_OFFSET = INDEX * FS_BLOCK_SIZE;
+  if(M_OFFSET >= sizeof(BLOCK_FLAG_BITMAP))
+  {
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  /* Последний блок карты заполнен не полностью */
+  SIZE32 m_size = sizeof(BLOCK_FLAG_BITMAP) - M_OFFSET;
+  if(m_size > FS_BLOCK_SIZE)
+  {
+    m_size = FS_BLOCK_SIZE;
+  }
+
+  U8 m_data[FS_BLOCK_SIZE] = {0};
+  STD_MEMCPY(m_size, g_fs->block_flags + M_OFFSET, m_data);
+
+  RETURN_CODE m_write_error = NO_ERROR;
+  FTL_WRITE(1U + INDEX, 1U, m_data, &m_write_error);
+  if(NO_ERROR != m_write_error)
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  *return_code = NO_ERROR;
+}
+/* ======== BLOCKFLAG ======== */
+
+
+
+/* ======== BLOCK ======== */
+static void FS_BLOCK_ALLOCATE(
+/* OUT */ FTL_INDEX * lbi,
+/* OUT */ RETURN_CODE * return_code)
+{
+  for(FTL_INDEX m_index = FS_DATA_LBI; m_index < FS_BLOCKS_COUNT; m_index++)
+  {
+    BLOCK_FLAG m_flag;
+    RETURN_CODE m_read_error = NO_ERROR;
+    FS_BLOCKFLAG_READ(m_index, &m_flag, &m_read_error);
+
+    if(m_flag == BLOCK_FLAG_FREE)
+    {
+      *lbi = m_index;
+      RETURN_CODE m_write_error = NO_ERROR;
+      FS_BLOCKFLAG_WRITE(m_index, BLOCK_FLAG_USED, &m_write_error);
+      if(NO_ERROR != m_write_error)
+      {
+        *return_code = OPERATION_FAILED;
+      }
+      else
+      {
+        *return_code = NO_ERROR;
+      }
+      return;
+    }
+  }
+
+  *return_code = NO_ACTION;
+}
+
+static void FS_BLOCKREF_ADD(
+/* IN  */ const FTL_INDEX LBI,
+/* IN  */ const I32 DELTA,
+/* OUT */ RETURN_CODE * return_code)
+{
+  const I32 M_REFS = (I32)g_fs->block_refs[LBI] + DELTA;
+  if((M_REFS < 0) || (M_REFS > 0xFF))
+  {
+    *return_code = NO_ACTION;
+    return;
+  }
+
+  U8 m_refs = (U8)M_REFS;
+  RETURN_CODE m_write_error = NO_ERROR;
+  FS_META_WRITE(
+    FS_REFS_LBI + LBI / FS_BLOCK_SIZE, LBI % FS_BLOCK_SIZE, 1U, &m_refs,
+    &m_write_error
+  );
+  if(NO_ERROR != m_write_error)
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  *return_code = NO_ERROR;
+}
+
+static void FS_BLOCK_FREE(
+/* IN  */ const FTL_INDEX LBI,
+/* IN  */ const SIZE32 COUNT,
+/* OUT */ RETURN_CODE * return_code)
+{
+  /* 1. Флаги блоков без других ссылок - в ОЗУ */
+  FTL_INDEX m_lbi = LBI;
+  SIZE32 m_freed = 0U;
+  for(; (FS_BLOCK_NONE != m_lbi) && (m_freed < COUNT); m_freed++)
+  {
+    if(0U != g_fs->block_refs[m_lbi])
+    {
+      break;
+    }
+
+    FTL_INDEX m_next = FS_BLOCK_NONE;
+    RETURN_CODE m_next_error = NO_ERROR;
+    if(m_freed + 1U < COUNT)
+    {
+      FS_BLOCKNEXT_READ(m_lbi, &m_next, &m_next_error);
+    }
+    RETURN_CODE m_flag_error = NO_ERROR;
+    if(NO_ERROR == m_next_error)
+    {
+      FS_BLOCKFLAG_APPLY(m_lbi, BLOCK_FLAG_FREE, &m_flag_error);
+    }
+    if((NO_ERROR != m_next_error) || (NO_ERROR != m_flag_error))
+    {
+      RETURN_CODE m_revert_error = NO_ERROR;
+      FS_JOURNAL_CHAIN(LBI, m_freed, BLOCK_FLAG_USED, &m_revert_error);
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+    m_lbi = m_next;
+  }
+
+  /* 2. Намерение освобождения - одна запись транзакции */
+  if(0U != m_freed)
+  {
+    const U8 M_INTENT[4U] = {
+      (U8)(LBI >> 8U), (U8)(LBI), (U8)(m_freed >> 8U), (U8)(m_freed)
+    };
+    RETURN_CODE m_intent_error = NO_ERROR;
+    FS_JOURNAL_INTENT(
+      FS_JOURNAL_MARK_FREE, sizeof(M_INTENT), M_INTENT, &m_intent_error
+    );
+    if(NO_ERROR != m_intent_error)
+    {
+      RETURN_CODE m_revert_error = NO_ERROR;
+      FS_JOURNAL_CHAIN(LBI, m_freed, BLOCK_FLAG_USED, &m_revert_error);
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+  }
+
+  /* 3. Остаток цепочки принадлежит копии файла */
+  if((FS_BLOCK_NONE != m_lbi) && (m_freed < COUNT))
+  {
+    RETURN_CODE m_ref_error = NO_ERROR;
+    FS_BLOCKREF_ADD(m_lbi, -1, &m_ref_error);
+    if(NO_ERROR != m_ref_error)
+    {
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+  }
+
+  *return_code = NO_ERROR;
+}
+
+static void FS_BLOCK_DISCARD(
+/* IN  */ const FTL_INDEX LBI,
+/* IN  */ const SIZE32 COUNT)
+{
+  /* Соседние блоки цепочки освобождаются в FTL одним вызовом */
+  FTL_INDEX m_run = FS_BLOCK_NONE;
+  SIZE32 m_run_count = 0U;
+
+  FTL_INDEX m_lbi = LBI;
+  for(SIZE32 i = 0U; (FS_BLOCK_NONE != m_lbi) && (i < COUNT); i++)
+  {
+    FTL_INDEX m_next = FS_BLOCK_NONE;
+    RETURN_CODE m_next_error = NO_ERROR;
+    if(i + 1U < COUNT)
+    {
+      FS_BLOCKNEXT_READ(m_lbi, &m_next, &m_next_error);
+    }
+
+    if((0U != m_run_count) && (m_run + m_run_count != m_lbi))
+    {
+      RETURN_CODE m_discard_error = NO_ERROR;
+      FTL_DISCARD(m_run, m_run_count, &m_discard_error);
+      m_run_count = 0U;
+    }
+    if(0U == m_run_count)
+    {
+      m_run = m_lbi;
+    }
+    m_run_count++;
+    m_lbi = (NO_ERROR == m_next_error) ? m_next : FS_BLOCK_NONE;
+  }
+
+  if(0U != m_run_count)
+  {
+    RETURN_CODE m_discard_error = NO_ERROR;
+    FTL_DISCARD(m_run, m_run_count, &m_discard_error);
+  }
+}
+/* ======== BLOCK ======== */
+
+
+
+/* ======== TAGNAME ======== */
+static void FS_TAGNAME_READ(
+/* IN  */ const TAG_ID ID,
+/* OUT */ TAG_NAME name,
+/* OUT */ RETURN_CODE * return_code)
+{
+  if(ID >= FS_TAGS_COUNT)
+  {
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  SIZE32 m_block_id = 6U + ID / 13U;
+  SIZE32 m_offset = (ID % 13U) * TAG_NAME_SIZE;
+
+  U8 m_data[FS_BLOCK_SIZE];
+  RETURN_CODE m_read_error = NO_ERROR;
+  FTL_READ(m_block_id, 1U, m_data, &m_read_error);
+  if(OPERATION_FAILED == m_read_error)
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+  if(NO_ACTION == m_read_error)
+  {
+    *return_code = NO_ACTION;
+    return;
+  }
+
+  STD_MEMCPY(TAG_NAME_SIZE, m_data + m_offset, name);
+  if('\0' == name[0U])
+  {
+    *return_code = NO_ACTION;
+    return;
+  }
+
+  *return_code = NO_ERROR;
+}
+
+static void FS_TAGNAME_WRITE(
+/* IN  */ const TAG_ID ID,
+/* IN  */ const TAG_NAME NAME,
+/* OUT */ RETURN_CODE * return_code)
+{
+  if(ID >= FS_TAGS_COUNT)
+  {
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  /* Образ блока в ОЗУ - g_fs->tag_names */
+  RETURN_CODE m_write_error = NO_ERROR;
+  FS_META_WRITE(
+    6U + ID / 13U, (ID % 13U) * TAG_NAME_SIZE, TAG_NAME_SIZE, (VOID_PTR)NAME,
+    &m_write_error
+  );
+  if(NO_ERROR != m_write_error)
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  *return_code = NO_ERROR;
+}
+/* ======== TAGNAME ======== */
+
+
+
+/* ======== TAGINDEX ======== */
+static void FS_TAG_FIND(
+/* IN  */ const TAG_NAME NAME,
+/* OUT */ TAG_ID * id,
+/* OUT */ RETURN_CODE * return_code)
+{
+  if('\0' == NAME[0U])
+  {
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  SIZE32 m_length = 1U;
+  while((m_length < TAG_NAME_SIZE) && ('\0' != NAME[m_length]))
+  {
+    m_length++;
+  }
+  if(TAG_NAME_SIZE == m_length)
+  {
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  for(register TAG_ID i = 0U; i < FS_TAGS_COUNT; i++)
+  {
+    I32 m_cmp_result;
+    STD_STRCMP(g_fs->tag_names[i], NAME, &m_cmp_result);
+    if(0L == m_cmp_result)
+    {
+      *id = i;
+      *return_code = NO_ERROR;
+      return;
+    }
+  }
+
+  *return_code = NO_ACTION;
+}
+
+static void FS_TAGINDEX_WRITE(
+/* IN  */ const TAG_ID TAG,
+/* IN  */ const FILE_ID ID,
+/* IN  */ const U8 VALUE,
+/* OUT */ RETURN_CODE * return_code)
+{
+  U32 m_word = g_fs->tag_index[TAG][ID / 32U];
+  if(VALUE)
+  {
+    m_word |= (1UL << (ID % 32U));
+  }
+  else
+  {
+    m_word &= ~(1UL << (ID % 32U));
+  }
+
+  RETURN_CODE m_write_error = NO_ERROR;
+  FS_META_WRITE(
+    FS_TAGINDEX_LBI + TAG, (ID / 32U) * sizeof(U32), sizeof(U32), &m_word,
+    &m_write_error
+  );
+  if(NO_ERROR != m_write_error)
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  *return_code = NO_ERROR;
+}
+
+static void FS_TAG_SET(
+/* IN  */ const FILE_NAME NAME,
+/* IN  */ const TAG_NAME TAG,
+/* IN  */ const U8 VALUE,
+/* OUT */ RETURN_CODE * return_code)
+{
+  FS_JOURNAL_SCOPE();
+
+  /* 1. Поиск тега (при добавлении - создание в пустой ячейке) */
+  TAG_ID m_tag;
+  RETURN_CODE m_tag_error = NO_ERROR;
+  FS_TAG_FIND(TAG, &m_tag, &m_tag_error);
+  if(INVALID_PARAM == m_tag_error)
+  {
+    *return_code = INVALID_PARAM;
+    return;
+  }
+  if((NO_ACTION == m_tag_error) && (0U == VALUE))
+  {
+    *return_code = NO_ACTION;
+    return;
+  }
+
+  /* 2. Поиск файла */
+  RETURN_CODE m_name_error = NO_ERROR;
+  FS_FILENAME_VALIDATE(NAME, &m_name_error);
+  if(NO_ERROR != m_name_error)
+  {
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  FILE_ID m_id;
+  RETURN_CODE m_find_error = NO_ERROR;
+  FS_FILE_FIND(NAME, &m_id, &m_find_error);
+  if(NO_ERROR != m_find_error)
+  {
+    *return_code = m_find_error;
+    return;
+  }
+
+  if(NO_ACTION == m_tag_error)
+  {
+    for(m_tag = 0U; m_tag < FS_TAGS_COUNT; m_tag++)
+    {
+      if('\0' == g_fs->tag_names[m_tag][0U])
+      {
+        break;
+      }
+    }
+    if(m_tag >= FS_TAGS_COUNT)
+    {
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+
+    FS_TAGNAME_WRITE(m_tag, TAG, &m_tag_error);
+    if(NO_ERROR != m_tag_error)
+    {
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+  }
+
+  /* 3. Заголовок файла */
+  FILE_HEADER_TYPE m_header;
+  RETURN_CODE m_header_error = NO_ERROR;
+  FS_FILEHEADER_READ(m_id, &m_header, &m_header_error);
+  if(NO_ERROR != m_header_error)
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  if(VALUE)
+  {
+    m_header.tags[m_tag / 8U] |= (U8)(1U << (m_tag % 8U));
+  }
+  else
+  {
+    m_header.tags[m_tag / 8U] &= (U8)~(1U << (m_tag % 8U));
+  }
+  HASH_CRC(
+    &m_header, sizeof(FILE_HEADER_TYPE) - sizeof(U32), &(m_header.crc32)
+  );
+  FS_FILEHEADER_WRITE(m_id, m_header, &m_header_error);
+  if(NO_ERROR != m_header_error)
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  /* 4. Индекс тега */
+  RETURN_CODE m_index_error = NO_ERROR;
+  FS_TAGINDEX_WRITE(m_tag, m_id, VALUE, &m_index_error);
+  if(NO_ERROR != m_index_error)
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  /* 5. Имя тега, заголовок и индекс фиксируются одной транзакцией */
+  RETURN_CODE m_commit_error = NO_ERROR;
+  FS_JOURNAL_COMMIT(&m_commit_error);
+  if(NO_ERROR != m_commit_error)
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  /* 6. Открытые дескрипторы не должны затереть теги при закрытии */
+  for(register SIZE32 i = 0U; i < FS_DESCRIPTORS_COUNT; i++)
+  {
+    if(m_id != g_fs->descriptor_table[i].id)
+    {
+      continue;
+    }
+    STD_MEMCPY(
+      sizeof(TAG_BITMAP), m_header.tags, g_fs->descriptor_table[i].header.tags
+    );
+    STD_MEMCPY(
+      sizeof(TAG_BITMAP), m_header.tags, g_fs->descriptor_table[i].status.tags
+    );
+  }
+
+  *return_code = NO_ERROR;
+}
+
+static void FS_TAG_EVALUATE(
+/* IN  */ const TAG_QUERY_TYPE * QUERY,
+/* IN  */ const SIZE32 QUERY_LENGTH,
+/* OUT */ RETURN_CODE * return_code)
+{
+  /* Пустое выражение - все существующие файлы */
+  if(0U == QUERY_LENGTH)
+  {
+    STD_MEMCPY(sizeof(FILE_BITMAP), g_fs->file_map, g_fs->tag_stack[0U]);
+    *return_code = NO_ERROR;
+    return;
+  }
+
+  /* Вычисление выражения над битовыми картами (по словам) */
+  SIZE32 m_depth = 0U;
+  for(register SIZE32 i = 0U; i < QUERY_LENGTH; i++)
+  {
+    switch(QUERY[i].op)
+    {
+      case TAG_QUERY_TAG:
+      {
+        if(FS_TAG_STACK_SIZE == m_depth)
+        {
+          *return_code = INVALID_PARAM;
+          return;
+        }
+
+        TAG_ID m_tag;
+        RETURN_CODE m_find_error = NO_ERROR;
+        FS_TAG_FIND(QUERY[i].tag, &m_tag, &m_find_error);
+        if(INVALID_PARAM == m_find_error)
+        {
+          *return_code = INVALID_PARAM;
+          return;
+        }
+
+        U32 * m_top = g_fs->tag_stack[m_depth];
+        for(register SIZE32 w = 0U; w < FS_FILES_WORDS; w++)
+        {
+          m_top[w]
+            = (NO_ERROR == m_find_error) ? g_fs->tag_index[m_tag][w] : 0U;
+        }
+        m_depth++;
+        break;
+      }
+      case TAG_QUERY_AND:
+      case TAG_QUERY_OR:
+      {
+        if(m_depth < 2U)
+        {
+          *return_code = INVALID_PARAM;
+          return;
+        }
+
+        U32 * m_left = g_fs->tag_stack[m_depth - 2U];
+        const U32 * M_RIGHT = g_fs->tag_stack[m_depth - 1U];
+        if(TAG_QUERY_AND == QUERY[i].op)
+        {
+          for(register SIZE32 w = 0U; w < FS_FILES_WORDS; w++)
+          {
+            m_left[w] &= M_RIGHT[w];
+          }
+        }
+        else
+        {
+          for(register SIZE32 w = 0U; w < FS_FILES_WORDS; w++)
+          {
+            m_left[w] |= M_RIGHT[w];
+          }
+        }
+        m_depth--;
+        break;
+      }
+      case TAG_QUERY_NOT:
+      {
+        if(m_depth < 1U)
+        {
+          *return_code = INVALID_PARAM;
+          return;
+        }
+
+        U32 * m_top = g_fs->tag_stack[m_depth - 1U];
+        for(register SIZE32 w = 0U; w < FS_FILES_WORDS; w++)
+        {
+          m_top[w] = ~m_top[w] & g_fs->file_map[w];
+        }
+        break;
+      }
+      default:
+        *return_code = INVALID_PARAM;
+        return;
+    }
+  }
+  if(1U != m_depth)
+  {
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  *return_code = NO_ERROR;
+}
+/* ======== TAGINDEX ======== */
+
+
+
+/* ======== FILEMAP ======== */
+static void FS_FILEMAP_WRITE(
+/* IN  */ const FILE_ID ID,
+/* IN  */ const U8 VALUE,
+/* OUT */ RETURN_CODE * return_code)
+{
+  U32 m_word = g_fs->file_map[ID / 32U];
+  if(VALUE)
+  {
+    m_word |= (1UL << (ID % 32U));
+  }
+  else
+  {
+    m_word &= ~(1UL << (ID % 32U));
+  }
+
+  RETURN_CODE m_write_error = NO_ERROR;
+  FS_META_WRITE(
+    FS_FILEMAP_LBI, (ID / 32U) * sizeof(U32), sizeof(U32), &m_word,
+    &m_write_error
+  );
+  if(NO_ERROR != m_write_error)
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  *return_code = NO_ERROR;
+}
+/* ======== FILEMAP ======== */
+
+
+
+/* ======== FILENAME ======== */
+static void FS_FILENAME_READ(
+/* IN  */ const FILE_ID ID,
+/* OUT */ FILE_NAME name,
+/* OUT */ RETURN_CODE * return_code)
+{
+  if(ID >= FS_FILES_COUNT)
+  {
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  SIZE32 m_block_id = 10U + ID / 5U;
+  SIZE32 m_offset = (ID % 5U) * FILE_NAME_SIZE;
+
+  U8 * m_data;
+  SIZE32 m_size;
+  RETURN_CODE m_read_error = NO_ERROR;
+  FS_META_IMAGE(m_block_id, &m_data, &m_size, &m_read_error);
+  if(NO_ACTION == m_read_error)
+  {
+    *return_code = NO_ACTION;
+    return;
+  }
+  if(NO_ERROR != m_read_error)
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  STD_MEMCPY(FILE_NAME_SIZE, m_data + m_offset, name);
+
+  *return_code = NO_ERROR;
+}
+
+static void FS_FILENAME_WRITE(
+/* IN  */ const FILE_ID ID,
+/* IN  */ const FILE_NAME NAME,
+/* OUT */ RETURN_CODE * return_code)
+{
+  if(ID >= FS_FILES_COUNT)
+  {
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  SIZE32 m_block_id = 10U + ID / 5U;
+  SIZE32 m_offset = (ID % 5U) * FILE_NAME_SIZE;
+
+  RETURN_CODE m_write_error = NO_ERROR;
+  FS_META_WRITE(
+    m_block_id, m_offset, FILE_NAME_SIZE, (VOID_PTR)NAME, &m_write_error
+  );
+  if(NO_ERROR != m_write_error)
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  *return_code = NO_ERROR;
+}
+
+static void FS_FILENAME_VALIDATE(
+/* IN  */ const FILE_NAME NAME,
+/* OUT */ RETURN_CODE * return_code)
+{
+  if('\0' == NAME[0U])
+  {
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  for(register SIZE32 i = 1U; i < FILE_NAME_SIZE; i++)
+  {
+    if('\0' == NAME[i])
+    {
+      *return_code = NO_ERROR;
+      return;
+    }
+  }
+
+  *return_code = INVALID_PARAM;
+}
+/* ======== FILENAME ======== */
+
+
+
+/* ======== FILEHEADER ======== */
+static void FS_FILEHEADER_READ(
+/* IN  */ const FILE_ID ID,
+/* OUT */ FILE_HEADER_TYPE * header,
+/* OUT */ RETURN_CODE * return_code)
+{
+  if(ID >= FS_FILES_COUNT)
+  {
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  SIZE32 m_block_id = 410U + ID / 10U;
+  SIZE32 m_offset = (ID % 10U) * sizeof(FILE_HEADER_TYPE);
+
+  U8 * m_data;
+  SIZE32 m_size;
+  RETURN_CODE m_read_error = NO_ERROR;
+  FS_META_IMAGE(m_block_id, &m_data, &m_size, &m_read_error);
+  if(NO_ACTION == m_read_error)
+  {
+    *return_code = NO_ACTION;
+    return;
+  }
+  if(NO_ERROR != m_read_error)
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  STD_MEMCPY(sizeof(FILE_HEADER_TYPE), m_data + m_offset, header);
+
+  *return_code = NO_ERROR;
+}
+
+static void FS_FILEHEADER_WRITE(
+/* IN  */ const FILE_ID ID,
+/* IN  */ const FILE_HEADER_TYPE HEADER,
+/* OUT */ RETURN_CODE * return_code)
+{
+  if(ID >= FS_FILES_COUNT)
+  {
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  SIZE32 m_block_id = 410U + ID / 10U;
+  SIZE32 m_offset = (ID % 10U) * sizeof(FILE_HEADER_TYPE);
+
+  RETURN_CODE m_write_error = NO_ERROR;
+  FS_META_WRITE(
+    m_block_id, m_offset, sizeof(FILE_HEADER_TYPE), (VOID_PTR)&HEADER,
+    &m_write_error
+  );
+  if(NO_ERROR != m_write_error)
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  *return_code = NO_ERROR;
+}
+/* ======== FILEHEADER ======== */
+
+
+
+/* ======== FILE ======== */
+static void FS_FILE_FIND(
+/* IN  */ const FILE_NAME NAME,
+/* OUT */ FILE_ID * id,
+/* OUT */ RETURN_CODE * return_code)
+{
+  FILE_NAME m_current_name;
+
+  for(register FILE_ID i = 0U; i < FS_FILES_COUNT; i++)
+  {
+    /* Свободные номера пропускаются без чтения flash */
+    if(0U == (g_fs->file_map[i / 32U] & (1UL << (i % 32U))))
+    {
+      continue;
+    }
+
+    RETURN_CODE m_read_error = NO_ERROR;
+    FS_FILENAME_READ(i, m_current_name, &m_read_error);
+    if(OPERATION_FAILED == m_read_error)
+    {
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+    if(NO_ACTION == m_read_error)
+    {
+      continue;
+    }
+
+    I32 m_cmp_result;
+    STD_STRCMP(m_current_name, NAME, &m_cmp_result);
+    if(m_cmp_result == 0L)
+    {
+      *id = i;
+      *return_code = NO_ERROR;
+      return;
+    }
+  }
+
+  *id = (FILE_ID)UN_SET;
+  *return_code = NO_ACTION;
+}
+/* ======== FILE ======== */
+
+
+
+/* ======== DESCRIPTOR ======== */
+static void FS_DESCRIPTOR_GET(
+/* IN  */ const FILE_ID ID,
+/* OUT */ FS_DESCRIPTOR_TYPE ** descriptor,
+/* OUT */ RETURN_CODE * return_code)
+{
+  /* Дескриптор прежнего открытия ячейки отклоняется по поколению,
+   * дескриптор другого тома - по номеру тома */
+  const SIZE32 M_SLOT = ID & FS_DESCRIPTOR_SLOT_MASK;
+  if((M_SLOT >= FS_DESCRIPTORS_COUNT)
+  || (((ID >> FS_DESCRIPTOR_SLOT_BITS) & FS_DESCRIPTOR_VOLUME_MASK)
+      != (SIZE32)(g_fs - g_fs_volumes))
+  || ((FILE_ID)UN_SET == g_fs->descriptor_table[M_SLOT].id)
+  || ((ID >> FS_DESCRIPTOR_GENERATION_SHIFT)
+      != g_fs->descriptor_table[M_SLOT].generation))
+  {
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  *descriptor = &(g_fs->descriptor_table[M_SLOT]);
+  *return_code = NO_ERROR;
+}
+
+static void FS_DESCRIPTOR_SYNC(
+/* INOUT */ FS_DESCRIPTOR_TYPE * descriptor,
+/* OUT   */ RETURN_CODE * return_code)
+{
+  RETURN_CODE m_flush_error = NO_ERROR;
+  FS_BUFFER_FLUSH(descriptor, &m_flush_error);
+  if(NO_ERROR != m_flush_error)
+  {
+    *return_code
+      = (NO_ACTION == m_flush_error) ? NO_ACTION : OPERATION_FAILED;
+    return;
+  }
+
+  if(0U == descriptor->modified)
+  {
+    *return_code = NO_ERROR;
+    return;
+  }
+
+  FS_JOURNAL_SCOPE();
+  descriptor->header.size = descriptor->status.size;
+  HASH_CRC(
+    &(descriptor->header), sizeof(FILE_HEADER_TYPE) - sizeof(U32),
+    &(descriptor->header.crc32)
+  );
+
+  RETURN_CODE m_write_error = NO_ERROR;
+  FS_FILEHEADER_WRITE(descriptor->id, descriptor->header, &m_write_error);
+  if(NO_ERROR != m_write_error)
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  /* Заголовок фиксируется вместе с закрытыми транзакциями выделения блоков */
+  RETURN_CODE m_commit_error = NO_ERROR;
+  FS_JOURNAL_COMMIT(&m_commit_error);
+  if(NO_ERROR != m_commit_error)
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  descriptor->modified = 0U;
+  *return_code = NO_ERROR;
+}
+
+static void FS_DESCRIPTOR_READ(
+/* INOUT */ FS_DESCRIPTOR_TYPE * descriptor,
+/* IN    */ const SIZE32 LENGTH,
+/* OUT   */ SIZE32 * out_length,
+/* OUT   */ VOID_PTR data,
+/* OUT   */ RETURN_CODE * return_code)
+{
+  /* Чтение ограничено концом файла */
+  SIZE32 m_length
+    = descriptor->status.size - (SIZE32)descriptor->status.position;
+  if(LENGTH < m_length)
+  {
+    m_length = LENGTH;
+  }
+
+  SIZE32 m_done = 0U;
+  while(m_done < m_length)
+  {
+    const SIZE32 M_POSITION = (SIZE32)descriptor->status.position;
+    const SIZE32 M_OFFSET = M_POSITION % FS_DATA_SIZE;
+
+    /* Блок берется из буфера, flash читается только при смене блока */
+    RETURN_CODE m_load_error = NO_ERROR;
+    FS_BUFFER_LOAD(descriptor, M_POSITION / FS_DATA_SIZE, &m_load_error);
+    if(NO_ERROR != m_load_error)
+    {
+      *out_length = m_done;
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+
+    SIZE32 m_chunk = FS_DATA_SIZE - M_OFFSET;
+    if(m_chunk > m_length - m_done)
+    {
+      m_chunk = m_length - m_done;
+    }
+    STD_MEMCPY(
+      m_chunk, descriptor->buffer.data + 2U + M_OFFSET, (U8 *)data + m_done
+    );
+
+    m_done += m_chunk;
+    descriptor->status.position += (FILE_POSITION)m_chunk;
+  }
+
+  *out_length = m_done;
+  *return_code = NO_ERROR;
+}
+
+static void FS_DESCRIPTOR_WRITE(
+/* INOUT */ FS_DESCRIPTOR_TYPE * descriptor,
+/* IN    */ const SIZE32 LENGTH,
+/* IN    */ const VOID_PTR DATA,
+/* OUT   */ RETURN_CODE * return_code)
+{
+  SIZE32 m_done = 0U;
+  while(m_done < LENGTH)
+  {
+    const SIZE32 M_POSITION = (SIZE32)descriptor->status.position;
+    const SIZE32 M_OFFSET = M_POSITION % FS_DATA_SIZE;
+    const SIZE32 M_INDEX = M_POSITION / FS_DATA_SIZE;
+
+    /* 1. Блок в буфер: существующий или новый в конце файла */
+    RETURN_CODE m_block_error = NO_ERROR;
+    if((M_POSITION == descriptor->status.size) && (0U == M_OFFSET))
+    {
+      FS_BUFFER_APPEND(descriptor, &m_block_error);
+    }
+    else
+    {
+      FS_BUFFER_LOAD(descriptor, M_INDEX, &m_block_error);
+    }
+    if(NO_ERROR != m_block_error)
+    {
+      *return_code = (NO_ACTION == m_block_error) ? NO_ACTION : OPERATION_FAILED;
+      return;
+    }
+
+    /* 2. Запись в буфер (во flash уходит при вытеснении полного блока) */
+    SIZE32 m_chunk = FS_DATA_SIZE - M_OFFSET;
+    if(m_chunk > LENGTH - m_done)
+    {
+      m_chunk = LENGTH - m_done;
+    }
+    STD_MEMCPY(
+      m_chunk, (U8 *)DATA + m_done, descriptor->buffer.data + 2U + M_OFFSET
+    );
+    descriptor->buffer.dirty = 1U;
+
+    m_done += m_chunk;
+    descriptor->status.position += (FILE_POSITION)m_chunk;
+    if((SIZE32)descriptor->status.position > descriptor->status.size)
+    {
+      descriptor->status.size = (SIZE32)descriptor->status.position;
+      descriptor->modified = 1U;
+    }
+  }
+
+  *return_code = NO_ERROR;
+}
+
+static void FS_DESCRIPTOR_POP(
+/* OUT */ SIZE32 * slot,
+/* OUT */ RETURN_CODE * return_code)
+{
+  for(;;)
+  {
+    const U32 M_HEAD = FS_ATOMIC_LOAD(g_fs->descriptor_free);
+    const SIZE32 M_SLOT = M_HEAD & 0xFFFFU;
+    if(FS_DESCRIPTORS_COUNT == M_SLOT)
+    {
+      *return_code = NO_ACTION;
+      return;
+    }
+
+    /* Метка не дает принять стек, измененный между чтением и заменой */
+    const U32 M_NEW = (M_HEAD & 0xFFFF0000U) + 0x10000U
+                    + FS_ATOMIC_LOAD(g_fs->descriptor_next[M_SLOT]);
+    if(FS_ATOMIC_CAS(g_fs->descriptor_free, M_HEAD, M_NEW))
+    {
+      *slot = M_SLOT;
+      *return_code = NO_ERROR;
+      return;
+    }
+  }
+}
+
+static void FS_DESCRIPTOR_PUSH(
+/* IN  */ const SIZE32 SLOT)
+{
+  for(;;)
+  {
+    const U32 M_HEAD = FS_ATOMIC_LOAD(g_fs->descriptor_free);
+    FS_ATOMIC_STORE(g_fs->descriptor_next[SLOT], (U8)(M_HEAD & 0xFFFFU));
+    const U32 M_NEW = (M_HEAD & 0xFFFF0000U) + 0x10000U + SLOT;
+    if(FS_ATOMIC_CAS(g_fs->descriptor_free, M_HEAD, M_NEW))
+    {
+      return;
+    }
+  }
+}
+
+static void FS_DESCRIPTOR_RELEASE(
+/* INOUT */ FS_DESCRIPTOR_TYPE * descriptor)
+{
+  FS_READAHEAD_RESET(descriptor);
+  FS_OPENS_RELEASE(descriptor->id, descriptor->status.mode);
+  descriptor->id = (FILE_ID)UN_SET;
+  descriptor->generation
+    = (U16)((descriptor->generation + 1U) % FS_DESCRIPTOR_GENERATIONS);
+  FS_DESCRIPTOR_PUSH((SIZE32)(descriptor - g_fs->descriptor_table));
+}
+
+static void FS_OPENS_ACQUIRE(
+/* IN  */ const FILE_ID ID,
+/* IN  */ const FILE_MODE MODE,
+/* OUT */ RETURN_CODE * return_code)
+{
+  for(;;)
+  {
+    const U8 M_OPENS = FS_ATOMIC_LOAD(g_fs->file_opens[ID]);
+    if((FS_OPEN_WRITER == M_OPENS)
+    || ((FILE_MODE_READ_WRITE == MODE) && (0U != M_OPENS)))
+    {
+      *return_code = DEVICE_BUSY;
+      return;
+    }
+
+    const U8 M_NEW
+      = (FILE_MODE_READ_WRITE == MODE) ? FS_OPEN_WRITER : (U8)(M_OPENS + 1U);
+    if(FS_ATOMIC_CAS(g_fs->file_opens[ID], M_OPENS, M_NEW))
+    {
+      *return_code = NO_ERROR;
+      return;
+    }
+  }
+}
+
+static void FS_OPENS_RELEASE(
+/* IN  */ const FILE_ID ID,
+/* IN  */ const FILE_MODE MODE)
+{
+  for(;;)
+  {
+    const U8 M_OPENS = FS_ATOMIC_LOAD(g_fs->file_opens[ID]);
+    const U8 M_NEW = (FILE_MODE_READ_WRITE == MODE) ? 0U : (U8)(M_OPENS - 1U);
+    if(FS_ATOMIC_CAS(g_fs->file_opens[ID], M_OPENS, M_NEW))
+    {
+      return;
+    }
+  }
+}
+
+#if FS_THREAD_SAFE
+static void FS_VOLUME_LOCK(
+/* INOUT */ U8 * scope)
+{
+  if(0U != g_fs_volume_depth++)
+  {
+    return;
+  }
+  if(0U != *scope)
+  {
+    FS_RWLOCK_ACQUIRE_WRITE(&g_fs->volume_lock);
+  }
+  else
+  {
+    FS_RWLOCK_ACQUIRE_READ(&g_fs->volume_lock);
+  }
+}
+
+static void FS_VOLUME_UNLOCK(
+/* INOUT */ U8 * scope)
+{
+  (void)scope;
+  if(0U == --g_fs_volume_depth)
+  {
+    FS_RWLOCK_RELEASE(&g_fs->volume_lock);
+  }
+}
+#endif
+/* ======== DESCRIPTOR ======== */
+
+
+
+/* ======== BUFFER ======== */
+static void FS_BUFFER_FLUSH(
+/* INOUT */ FS_DESCRIPTOR_TYPE * descriptor,
+/* OUT   */ RETURN_CODE * return_code)
+{
+  FS_BUFFER_TYPE * m_buffer = &(descriptor->buffer);
+  if(((FTL_INDEX)UN_SET == m_buffer->lbi) || (0U == m_buffer->dirty))
+  {
+    *return_code = NO_ERROR;
+    return;
+  }
+
+  /* Запись блока может выделять блоки и менять общий блок маленьких файлов */
+  FS_JOURNAL_SCOPE_KEEP();
+
+  /* Первый блок без своего LBI: маленький файл уходит в ячейку */
+  if(FS_BLOCK_NONE == m_buffer->lbi)
+  {
+    if(descriptor->status.size <= FS_INLINE_SIZE)
+    {
+      RETURN_CODE m_inline_error = NO_ERROR;
+      FS_INLINE_WRITE(descriptor, &m_inline_error);
+      if(NO_ERROR != m_inline_error)
+      {
+        *return_code
+          = (NO_ACTION == m_inline_error) ? NO_ACTION : OPERATION_FAILED;
+        return;
+      }
+      m_buffer->dirty = 0U;
+      *return_code = NO_ERROR;
+      return;
+    }
+
+    RETURN_CODE m_extract_error = NO_ERROR;
+    FS_INLINE_EXTRACT(descriptor, &m_extract_error);
+    if(NO_ERROR != m_extract_error)
+    {
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+  }
+
+  RETURN_CODE m_unshare_error = NO_ERROR;
+  FS_BUFFER_UNSHARE(descriptor, &m_unshare_error);
+  if(NO_ERROR != m_unshare_error)
+  {
+    *return_code = m_unshare_error;
+    return;
+  }
+
+  /* FTL без места для записи возвращает NO_ACTION */
+  RETURN_CODE m_write_error = NO_ERROR;
+  FTL_WRITE(m_buffer->lbi, 1U, m_buffer->data, &m_write_error);
+  if(NO_ERROR != m_write_error)
+  {
+    *return_code
+      = (NO_ACTION == m_write_error) ? NO_ACTION : OPERATION_FAILED;
+    return;
+  }
+
+  m_buffer->dirty = 0U;
+  *return_code = NO_ERROR;
+}
+
+static void FS_BUFFER_LOAD(
+/* INOUT */ FS_DESCRIPTOR_TYPE * descriptor,
+/* IN    */ const SIZE32 INDEX,
+/* OUT   */ RETURN_CODE * return_code)
+{
+  FS_BUFFER_TYPE * m_buffer = &(descriptor->buffer);
+  if(((FTL_INDEX)UN_SET != m_buffer->lbi) && (INDEX == m_buffer->index))
+  {
+    *return_code = NO_ERROR;
+    return;
+  }
+
+  /* 1. Начало обхода: следующий за буфером блок или начало цепочки */
+  FTL_INDEX m_lbi = descriptor->header.lbi_start;
+  SIZE32 m_index = 0U;
+  if(((FTL_INDEX)UN_SET != m_buffer->lbi) && (INDEX > m_buffer->index))
+  {
+    m_lbi = (FTL_INDEX)((m_buffer->data[0U] << 8U) | m_buffer->data[1U]);
+    m_index = m_buffer->index + 1U;
+  }
+
+  /* Последний блок журнала (добавление) читается без обхода цепочки */
+  if((FILE_FLAG_LOG & descriptor->header.flags)
+  && (FS_BLOCK_NONE != descriptor->header.lbi_tail)
+  && (INDEX + 1U
+      == (descriptor->status.size + FS_DATA_SIZE - 1U) / FS_DATA_SIZE))
+  {
+    m_lbi = descriptor->header.lbi_tail;
+    m_index = INDEX;
+  }
+
+  /* Последовательное чтение идет через окно, иначе окно сбрасывается */
+  if((m_index == INDEX) && (0U != m_index) && (FS_BLOCK_NONE != m_lbi))
+  {
+    RETURN_CODE m_readahead_error = NO_ERROR;
+    FS_READAHEAD_LOAD(descriptor, INDEX, m_lbi, &m_readahead_error);
+    if(NO_ERROR == m_readahead_error)
+    {
+      *return_code = NO_ERROR;
+      return;
+    }
+  }
+  else
+  {
+    FS_READAHEAD_RESET(descriptor);
+  }
+
+  /* 2. Освобождение буфера */
+  RETURN_CODE m_flush_error = NO_ERROR;
+  FS_BUFFER_FLUSH(descriptor, &m_flush_error);
+  if(NO_ERROR != m_flush_error)
+  {
+    *return_code
+      = (NO_ACTION == m_flush_error) ? NO_ACTION : OPERATION_FAILED;
+    return;
+  }
+  m_buffer->lbi = (FTL_INDEX)UN_SET;
+
+  /* 3. Файл в ячейке общего блока состоит из одного блока */
+  if(FILE_FLAG_INLINE & descriptor->header.flags)
+  {
+    if(0U != INDEX)
+    {
+      *return_code = NO_ACTION;
+      return;
+    }
+
+    FS_LOCK_SCOPE(&g_fs->lock);
+    RETURN_CODE m_inline_error = NO_ERROR;
+    FS_INLINE_READ(descriptor, &m_inline_error);
+    if(NO_ERROR != m_inline_error)
+    {
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+    descriptor->status.readahead.misses++;
+    *return_code = NO_ERROR;
+    return;
+  }
+
+  /* 4. Обход цепочки (каждый блок читается сразу в буфер) */
+  for(;;)
+  {
+    if(FS_BLOCK_NONE == m_lbi)
+    {
+      *return_code = NO_ACTION;
+      return;
+    }
+
+    RETURN_CODE m_read_error = NO_ERROR;
+    FTL_READ(m_lbi, 1U, m_buffer->data, &m_read_error);
+    if(NO_ERROR != m_read_error)
+    {
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+
+    if(m_index == INDEX)
+    {
+      break;
+    }
+    m_lbi = (FTL_INDEX)((m_buffer->data[0U] << 8U) | m_buffer->data[1U]);
+    m_index++;
+  }
+
+  m_buffer->lbi = m_lbi;
+  m_buffer->index = INDEX;
+  m_buffer->dirty = 0U;
+  descriptor->status.readahead.misses++;
+
+  *return_code = NO_ERROR;
+}
+
+static void FS_BUFFER_APPEND(
+/* INOUT */ FS_DESCRIPTOR_TYPE * descriptor,
+/* OUT   */ RETURN_CODE * return_code)
+{
+  FS_JOURNAL_SCOPE_KEEP();
+  FS_BUFFER_TYPE * m_buffer = &(descriptor->buffer);
+  const SIZE32 M_COUNT
+    = (descriptor->status.size + FS_DATA_SIZE - 1U) / FS_DATA_SIZE;
+
+  if(FILE_FLAG_LOG & descriptor->header.flags)
+  {
+    FS_BUFFER_APPEND_LOG(descriptor, M_COUNT, return_code);
+    return;
+  }
+
+  /* 1. Первый блок получает LBI только при записи во flash */
+  FTL_INDEX m_lbi = FS_BLOCK_NONE;
+  if(0U != M_COUNT)
+  {
+    /* 2. Последний блок в буфер (первый блок - в собственный LBI) */
+    RETURN_CODE m_load_error = NO_ERROR;
+    FS_BUFFER_LOAD(descriptor, M_COUNT - 1U, &m_load_error);
+    if(NO_ERROR == m_load_error && (FS_BLOCK_NONE == m_buffer->lbi))
+    {
+      FS_INLINE_EXTRACT(descriptor, &m_load_error);
+    }
+    if(NO_ERROR != m_load_error)
+    {
+      *return_code = m_load_error;
+      return;
+    }
+
+    /* 3. Выделение и связывание нового блока */
+    RETURN_CODE m_alloc_error = NO_ERROR;
+    FS_BLOCK_ALLOCATE(&m_lbi, &m_alloc_error);
+    if(NO_ERROR != m_alloc_error)
+    {
+      *return_code = m_alloc_error;
+      return;
+    }
+    m_buffer->data[0U] = (U8)(m_lbi >> 8U);
+    m_buffer->data[1U] = (U8)(m_lbi);
+    m_buffer->dirty = 1U;
+  }
+
+  RETURN_CODE m_flush_error = NO_ERROR;
+  FS_BUFFER_FLUSH(descriptor, &m_flush_error);
+  if(NO_ERROR != m_flush_error)
+  {
+    *return_code
+      = (NO_ACTION == m_flush_error) ? NO_ACTION : OPERATION_FAILED;
+    return;
+  }
+
+  /* 4. Новый блок создается в буфере и записывается при вытеснении */
+  STD_MEMSET(FS_BLOCK_SIZE, 0x00U, m_buffer->data);
+  m_buffer->data[0U] = (U8)(FS_BLOCK_NONE >> 8U);
+  m_buffer->data[1U] = (U8)(FS_BLOCK_NONE);
+  m_buffer->lbi = m_lbi;
+  m_buffer->index = M_COUNT;
+  m_buffer->dirty = 1U;
+
+  *return_code = NO_ERROR;
+}
+
+static void FS_BUFFER_APPEND_LOG(
+/* INOUT */ FS_DESCRIPTOR_TYPE * descriptor,
+/* IN    */ const SIZE32 COUNT,
+/* OUT   */ RETURN_CODE * return_code)
+{
+  FS_BUFFER_TYPE * m_buffer = &(descriptor->buffer);
+
+  /* 1. LBI нового блока: записанный в последнем блоке или новый */
+  FTL_INDEX m_lbi = FS_BLOCK_NONE;
+  if(0U != COUNT)
+  {
+    RETURN_CODE m_load_error = NO_ERROR;
+    FS_BUFFER_LOAD(descriptor, COUNT - 1U, &m_load_error);
+    if(NO_ERROR != m_load_error)
+    {
+      *return_code = m_load_error;
+      return;
+    }
+    m_lbi = (FTL_INDEX)((m_buffer->data[0U] << 8U) | m_buffer->data[1U]);
+  }
+  if(FS_BLOCK_NONE == m_lbi)
+  {
+    RETURN_CODE m_alloc_error = NO_ERROR;
+    FS_BLOCK_ALLOCATE(&m_lbi, &m_alloc_error);
+    if(NO_ERROR != m_alloc_error)
+    {
+      *return_code = m_alloc_error;
+      return;
+    }
+    if(0U == COUNT)
+    {
+      descriptor->header.lbi_start = (U16)m_lbi;
+    }
+    else
+    {
+      m_buffer->data[0U] = (U8)(m_lbi >> 8U);
+      m_buffer->data[1U] = (U8)(m_lbi);
+      m_buffer->dirty = 1U;
+    }
+  }
+
+  /* 2. LBI следующего блока фиксируется вместе с размером журнала */
+  FTL_INDEX m_next;
+  RETURN_CODE m_alloc_error = NO_ERROR;
+  FS_BLOCK_ALLOCATE(&m_next, &m_alloc_error);
+  if(NO_ERROR != m_alloc_error)
+  {
+    *return_code = m_alloc_error;
+    return;
+  }
+
+  RETURN_CODE m_flush_error = NO_ERROR;
+  FS_BUFFER_FLUSH(descriptor, &m_flush_error);
+  if(NO_ERROR != m_flush_error)
+  {
+    *return_code
+      = (NO_ACTION == m_flush_error) ? NO_ACTION : OPERATION_FAILED;
+    return;
+  }
+
+  STD_MEMSET(FS_BLOCK_SIZE, 0x00U, m_buffer->data);
+  m_buffer->data[0U] = (U8)(m_next >> 8U);
+  m_buffer->data[1U] = (U8)(m_next);
+  m_buffer->lbi = m_lbi;
+  m_buffer->index = COUNT;
+  m_buffer->dirty = 1U;
+
+  descriptor->header.lbi_tail = (U16)m_lbi;
+  descriptor->modified = 1U;
+  *return_code = NO_ERROR;
+}
+
+static void FS_BUFFER_PLACE(
+/* INOUT */ FS_DESCRIPTOR_TYPE * descriptor,
+/* IN    */ const FTL_INDEX LBI,
+/* IN    */ const SIZE32 INDEX,
+/* IN    */ const VOID_PTR DATA,
+/* OUT   */ RETURN_CODE * return_code)
+{
+  FS_BUFFER_TYPE * m_buffer = &(descriptor->buffer);
+  RETURN_CODE m_flush_error = NO_ERROR;
+  FS_BUFFER_FLUSH(descriptor, &m_flush_error);
+  FS_READAHEAD_RESET(descriptor);
+  if(NO_ERROR != m_flush_error)
+  {
+    *return_code
+      = (NO_ACTION == m_flush_error) ? NO_ACTION : OPERATION_FAILED;
+    return;
+  }
+
+  STD_MEMCPY(FS_BLOCK_SIZE, DATA, m_buffer->data);
+  m_buffer->lbi = LBI;
+  m_buffer->index = INDEX;
+  m_buffer->dirty = 0U;
+
+  *return_code = NO_ERROR;
+}
+static void FS_BUFFER_UNSHARE(
+/* INOUT */ FS_DESCRIPTOR_TYPE * descriptor,
+/* OUT   */ RETURN_CODE * return_code)
+{
+  FS_BUFFER_TYPE * m_buffer = &(descriptor->buffer);
+  FS_COW_TYPE * m_cow = &(descriptor->cow);
+  if((0U == (FILE_FLAG_SHARED & descriptor->header.flags))
+  || (m_buffer->index < m_cow->index))
+  {
+    *return_code = NO_ERROR;
+    return;
+  }
+
+  /* Копия предыдущего блока ждет адреса следующей копии */
+  U8 m_copy[FS_BLOCK_SIZE];
+  U8 m_copying = 0U;
+  FTL_INDEX m_prev = m_cow->prev;
+  FTL_INDEX m_lbi
+    = (0U == m_cow->index) ? descriptor->header.lbi_start : m_cow->lbi;
+
+  for(SIZE32 m_index = m_cow->index; ; m_index++)
+  {
+    const U8 M_IS_BUFFER = (m_index == m_buffer->index);
+    if(M_IS_BUFFER)
+    {
+      m_lbi = m_buffer->lbi;
+    }
+    if(FS_BLOCK_NONE == m_lbi)
+    {
+      break;
+    }
+    if(!m_copying && (0U == g_fs->block_refs[m_lbi]) && M_IS_BUFFER)
+    {
+      break;
+    }
+
+    /* 1. Блок во flash (адрес следующего блока до изменений) */
+    U8 m_data[FS_BLOCK_SIZE];
+    RETURN_CODE m_read_error = NO_ERROR;
+    FTL_READ(m_lbi, 1U, m_data, &m_read_error);
+    if(NO_ERROR != m_read_error)
+    {
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+    const FTL_INDEX M_NEXT = (FTL_INDEX)((m_data[0U] << 8U) | m_data[1U]);
+
+    if(!m_copying && (0U == g_fs->block_refs[m_lbi]))
+    {
+      m_prev = m_lbi;
+      m_lbi = M_NEXT;
+      continue;
+    }
+
+    /* 2. Первый разделяемый блок теряет ссылку этого файла */
+    RETURN_CODE m_ref_error = NO_ERROR;
+    if(!m_copying)
+    {
+      FS_BLOCKREF_ADD(m_lbi, -1, &m_ref_error);
+      if(NO_ERROR != m_ref_error)
+      {
+        *return_code = OPERATION_FAILED;
+        return;
+      }
+    }
+
+    FTL_INDEX m_new;
+    RETURN_CODE m_alloc_error = NO_ERROR;
+    FS_BLOCK_ALLOCATE(&m_new, &m_alloc_error);
+    if(NO_ERROR != m_alloc_error)
+    {
+      *return_code = m_alloc_error;
+      return;
+    }
+
+    /* 3. Предыдущий блок (или заголовок) ссылается на копию */
+    RETURN_CODE m_link_error = NO_ERROR;
+    if(m_copying)
+    {
+      m_copy[0U] = (U8)(m_new >> 8U);
+      m_copy[1U] = (U8)(m_new);
+      FTL_WRITE(m_prev, 1U, m_copy, &m_link_error);
+    }
+    else if(FS_BLOCK_NONE == m_prev)
+    {
+      descriptor->header.lbi_start = m_new;
+      descriptor->modified = 1U;
+    }
+    else
+    {
+      FTL_READ(m_prev, 1U, m_copy, &m_link_error);
+      m_copy[0U] = (U8)(m_new >> 8U);
+      m_copy[1U] = (U8)(m_new);
+      if(NO_ERROR == m_link_error)
+      {
+        FTL_WRITE(m_prev, 1U, m_copy, &m_link_error);
+      }
+    }
+    if(NO_ERROR != m_link_error)
+    {
+      *return_code
+        = (NO_ACTION == m_link_error) ? NO_ACTION : OPERATION_FAILED;
+      return;
+    }
+
+    /* 4. Копия блока буфера ссылается на прежний следующий блок */
+    if(M_IS_BUFFER)
+    {
+      if(FS_BLOCK_NONE != M_NEXT)
+      {
+        FS_BLOCKREF_ADD(M_NEXT, 1, &m_ref_error);
+        if(NO_ERROR != m_ref_error)
+        {
+          *return_code = OPERATION_FAILED;
+          return;
+        }
+      }
+      m_buffer->lbi = m_new;
+      break;
+    }
+
+    STD_MEMCPY(FS_BLOCK_SIZE, m_data, m_copy);
+    m_copying = 1U;
+    m_prev = m_new;
+    m_lbi = M_NEXT;
+  }
+
+  m_cow->index = m_buffer->index + 1U;
+  m_cow->prev = m_buffer->lbi;
+  m_cow->lbi = (FTL_INDEX)((m_buffer->data[0U] << 8U) | m_buffer->data[1U]);
+
+  *return_code = NO_ERROR;
+}
+/* ======== BUFFER ======== */
+
+
+
+/* ======== READAHEAD ======== */
+static void FS_READAHEAD_LOAD(
+/* INOUT */ FS_DESCRIPTOR_TYPE * descriptor,
+/* IN    */ const SIZE32 INDEX,
+/* IN    */ const FTL_INDEX LBI,
+/* OUT   */ RETURN_CODE * return_code)
+{
+  FS_READAHEAD_TYPE * m_readahead = &(descriptor->readahead);
+  FILE_READAHEAD_TYPE * m_stats = &(descriptor->status.readahead);
+  FS_BUFFER_TYPE * m_buffer = &(descriptor->buffer);
+
+  if(FILE_MODE_READ_ONLY != descriptor->status.mode)
+  {
+    *return_code = NO_ACTION;
+    return;
+  }
+
+  /* 1. Попадание в окно */
+  if(((SIZE32)UN_SET != m_readahead->slot)
+  && (INDEX >= m_readahead->first)
+  && (INDEX < m_readahead->first + m_readahead->count))
+  {
+    STD_MEMCPY(
+      FS_BLOCK_SIZE,
+      g_fs->readahead_pool[m_readahead->slot]
+        + (1U + INDEX - m_readahead->first) * FS_BLOCK_SIZE,
+      m_buffer->data
+    );
+    m_buffer->lbi = LBI;
+    m_buffer->index = INDEX;
+    m_buffer->dirty = 0U;
+    m_stats->hits++;
+
+    /* Окно прочитано полностью - упреждение оправдано */
+    if(INDEX + 1U == m_readahead->first + m_readahead->count)
+    {
+      m_readahead->count = 0U;
+      m_stats->window *= 2U;
+      if(m_stats->window > FS_READAHEAD_SIZE)
+      {
+        m_stats->window = FS_READAHEAD_SIZE;
+      }
+    }
+
+    *return_code = NO_ERROR;
+    return;
+  }
+
+  /* 2. Промах: часть окна пропала - окно уменьшается */
+  if(0U != m_readahead->count)
+  {
+    m_readahead->count = 0U;
+    m_stats->window /= 2U;
+  }
+  else if(0U == m_stats->window)
+  {
+    m_stats->window = 1U;
+  }
+  if(0U == m_stats->window)
+  {
+    *return_code = NO_ACTION;
+    return;
+  }
+
+  /* 3. Окно из пула */
+  if((SIZE32)UN_SET == m_readahead->slot)
+  {
+    FS_LOCK_SCOPE(&g_fs->lock);
+    const SIZE32 M_OWNER = (SIZE32)(descriptor - g_fs->descriptor_table);
+    for(register SIZE32 i = 0U; i < FS_READAHEAD_COUNT; i++)
+    {
+      if((SIZE32)UN_SET == g_fs->readahead_owner[i])
+      {
+        g_fs->readahead_owner[i] = M_OWNER;
+        m_readahead->slot = i;
+        break;
+      }
+    }
+    if((SIZE32)UN_SET == m_readahead->slot)
+    {
+      *return_code = NO_ACTION;
+      return;
+    }
+  }
+
+  /* 4. Пакетное чтение: запрошенный блок и до window следующих LBI */
+  const SIZE32 M_BLOCKS
+    = (descriptor->status.size + FS_DATA_SIZE - 1U) / FS_DATA_SIZE;
+  SIZE32 m_count = m_stats->window;
+  if(INDEX + 1U + m_count > M_BLOCKS)
+  {
+    m_count = M_BLOCKS - INDEX - 1U;
+  }
+  if(LBI + 1U + m_count > FS_BLOCKS_COUNT)
+  {
+    m_count = FS_BLOCKS_COUNT - LBI - 1U;
+  }
+
+  U8 * m_window = g_fs->readahead_pool[m_readahead->slot];
+  RETURN_CODE m_read_error = NO_ERROR;
+  FTL_READ(LBI, 1U + m_count, m_window, &m_read_error);
+  if(NO_ERROR != m_read_error)
+  {
+    *return_code = NO_ACTION;
+    return;
+  }
+
+  STD_MEMCPY(FS_BLOCK_SIZE, m_window, m_buffer->data);
+  m_buffer->lbi = LBI;
+  m_buffer->index = INDEX;
+  m_buffer->dirty = 0U;
+  m_stats->misses++;
+
+  /* 5. В окне остаются только блоки, продолжающие цепочку файла */
+  m_readahead->first = INDEX + 1U;
+  m_readahead->count = 0U;
+  for(register SIZE32 i = 1U; i <= m_count; i++)
+  {
+    const U8 * M_PREV = m_window + (i - 1U) * FS_BLOCK_SIZE;
+    if((FTL_INDEX)((M_PREV[0U] << 8U) | M_PREV[1U]) != LBI + i)
+    {
+      break;
+    }
+    m_readahead->count++;
+  }
+
+  *return_code = NO_ERROR;
+}
+
+static void FS_READAHEAD_RESET(
+/* INOUT */ FS_DESCRIPTOR_TYPE * descriptor)
+{
+  FS_READAHEAD_TYPE * m_readahead = &(descriptor->readahead);
+  if((SIZE32)UN_SET != m_readahead->slot)
+  {
+    FS_LOCK_SCOPE(&g_fs->lock);
+    g_fs->readahead_owner[m_readahead->slot] = (SIZE32)UN_SET;
+  }
+
+  m_readahead->slot = (SIZE32)UN_SET;
+  m_readahead->first = 0U;
+  m_readahead->count = 0U;
+  descriptor->status.readahead.window = 0U;
+}
+/* ======== READAHEAD ======== */
+
+
+
+/* ======== INLINE ======== */
+static void FS_INLINE_LOAD(
+/* IN  */ const FTL_INDEX LBI,
+/* OUT */ RETURN_CODE * return_code)
+{
+  if(LBI == g_fs->inline_block.lbi)
+  {
+    *return_code = NO_ERROR;
+    return;
+  }
+
+  g_fs->inline_block.lbi = (FTL_INDEX)UN_SET;
+  RETURN_CODE m_read_error = NO_ERROR;
+  FTL_READ(LBI, 1U, g_fs->inline_block.data, &m_read_error);
+  if(NO_ERROR != m_read_error)
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+  g_fs->inline_block.lbi = LBI;
+
+  *return_code = NO_ERROR;
+}
+
+static void FS_INLINE_READ(
+/* INOUT */ FS_DESCRIPTOR_TYPE * descriptor,
+/* OUT   */ RETURN_CODE * return_code)
+{
+  FS_BUFFER_TYPE * m_buffer = &(descriptor->buffer);
+  const U8 M_SLOT = descriptor->header.flags >> 4U;
+
+  RETURN_CODE m_load_error = NO_ERROR;
+  FS_INLINE_LOAD(descriptor->header.lbi_start, &m_load_error);
+  if(NO_ERROR != m_load_error)
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  STD_MEMSET(FS_BLOCK_SIZE, 0x00U, m_buffer->data);
+  m_buffer->data[0U] = (U8)(FS_BLOCK_NONE >> 8U);
+  m_buffer->data[1U] = (U8)(FS_BLOCK_NONE);
+  STD_MEMCPY(
+    FS_INLINE_SIZE, g_fs->inline_block.data + 2U + M_SLOT * FS_INLINE_SIZE,
+    m_buffer->data + 2U
+  );
+  m_buffer->lbi = FS_BLOCK_NONE;
+  m_buffer->index = 0U;
+  m_buffer->dirty = 0U;
+
+  *return_code = NO_ERROR;
+}
+
+static void FS_INLINE_WRITE(
+/* INOUT */ FS_DESCRIPTOR_TYPE * descriptor,
+/* OUT   */ RETURN_CODE * return_code)
+{
+  FILE_HEADER_TYPE * m_header = &(descriptor->header);
+
+  /* 1. Выделение ячейки: блок в ОЗУ, другие общие блоки или новый блок */
+  if(0U == (FILE_FLAG_INLINE & m_header->flags))
+  {
+    FTL_INDEX m_lbi = (FTL_INDEX)UN_SET;
+    if(((FTL_INDEX)UN_SET != g_fs->inline_block.lbi)
+    && (((1U << FS_INLINE_SLOTS) - 1U) != g_fs->inline_block.data[0U]))
+    {
+      m_lbi = g_fs->inline_block.lbi;
+    }
+
+    for(FTL_INDEX i = FS_DATA_LBI; ((FTL_INDEX)UN_SET == m_lbi)
+     && (i < FS_BLOCKS_COUNT); i++)
+    {
+      BLOCK_FLAG m_flag;
+      RETURN_CODE m_flag_error = NO_ERROR;
+      FS_BLOCKFLAG_READ(i, &m_flag, &m_flag_error);
+      if(BLOCK_FLAG_INLINE != m_flag)
+      {
+        continue;
+      }
+
+      RETURN_CODE m_load_error = NO_ERROR;
+      FS_INLINE_LOAD(i, &m_load_error);
+      if(NO_ERROR != m_load_error)
+      {
+        *return_code = OPERATION_FAILED;
+        return;
+      }
+      if(((1U << FS_INLINE_SLOTS) - 1U) != g_fs->inline_block.data[0U])
+      {
+        m_lbi = i;
+      }
+    }
+
+    if((FTL_INDEX)UN_SET == m_lbi)
+    {
+      RETURN_CODE m_alloc_error = NO_ERROR;
+      FS_BLOCK_ALLOCATE(&m_lbi, &m_alloc_error);
+      if(NO_ERROR == m_alloc_error)
+      {
+        FS_BLOCKFLAG_WRITE(m_lbi, BLOCK_FLAG_INLINE, &m_alloc_error);
+      }
+      if(NO_ERROR != m_alloc_error)
+      {
+        *return_code = m_alloc_error;
+        return;
+      }
+      STD_MEMSET(FS_BLOCK_SIZE, 0x00U, g_fs->inline_block.data);
+      g_fs->inline_block.lbi = m_lbi;
+    }
+
+    U8 m_slot = 0U;
+    while(g_fs->inline_block.data[0U] & (1U << m_slot))
+    {
+      m_slot++;
+    }
+
+    m_header->lbi_start = m_lbi;
+    m_header->flags = FILE_FLAG_INLINE | (m_slot << 4U);
+    descriptor->modified = 1U;
+  }
+
+  /* 2. Запись ячейки (байт занятости обновляется той же записью) */
+  const U8 M_SLOT = m_header->flags >> 4U;
+  RETURN_CODE m_load_error = NO_ERROR;
+  FS_INLINE_LOAD(m_header->lbi_start, &m_load_error);
+  if(NO_ERROR != m_load_error)
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  g_fs->inline_block.data[0U] |= (1U << M_SLOT);
+  STD_MEMCPY(
+    FS_INLINE_SIZE, descriptor->buffer.data + 2U,
+    g_fs->inline_block.data + 2U + M_SLOT * FS_INLINE_SIZE
+  );
+
+  RETURN_CODE m_write_error = NO_ERROR;
+  FTL_WRITE(m_header->lbi_start, 1U, g_fs->inline_block.data, &m_write_error);
+  if(NO_ERROR != m_write_error)
+  {
+    g_fs->inline_block.lbi = (FTL_INDEX)UN_SET;
+    *return_code
+      = (NO_ACTION == m_write_error) ? NO_ACTION : OPERATION_FAILED;
+    return;
+  }
+
+  *return_code = NO_ERROR;
+}
+
+static void FS_INLINE_FREE(
+/* IN  */ const FTL_INDEX LBI,
+/* IN  */ const U8 SLOT,
+/* OUT */ RETURN_CODE * return_code)
+{
+  RETURN_CODE m_load_error = NO_ERROR;
+  FS_INLINE_LOAD(LBI, &m_load_error);
+  if(NO_ERROR != m_load_error)
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  g_fs->inline_block.data[0U] &= ~(1U << SLOT);
+  STD_MEMSET(
+    FS_INLINE_SIZE, 0x00U, g_fs->inline_block.data + 2U + SLOT * FS_INLINE_SIZE
+  );
+
+  /* Пустой общий блок возвращается в свободные (и освобождается в FTL) */
+  RETURN_CODE m_write_error = NO_ERROR;
+  if(0U == g_fs->inline_block.data[0U])
+  {
+    g_fs->inline_block.lbi = (FTL_INDEX)UN_SET;
+    FS_BLOCKFLAG_WRITE(LBI, BLOCK_FLAG_FREE, &m_write_error);
+    if(NO_ERROR == m_write_error)
+    {
+      /* Ошибка освобождения в FTL не отменяет транзакцию */
+      RETURN_CODE m_discard_error = NO_ERROR;
+      FTL_DISCARD(LBI, 1U, &m_discard_error);
+    }
+  }
+  else
+  {
+    FTL_WRITE(LBI, 1U, g_fs->inline_block.data, &m_write_error);
+  }
+  if(NO_ERROR != m_write_error)
+  {
+    g_fs->inline_block.lbi = (FTL_INDEX)UN_SET;
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  *return_code = NO_ERROR;
+}
+
+static void FS_INLINE_EXTRACT(
+/* INOUT */ FS_DESCRIPTOR_TYPE * descriptor,
+/* OUT   */ RETURN_CODE * return_code)
+{
+  FTL_INDEX m_lbi;
+  RETURN_CODE m_alloc_error = NO_ERROR;
+  FS_BLOCK_ALLOCATE(&m_lbi, &m_alloc_error);
+  if(NO_ERROR != m_alloc_error)
+  {
+    *return_code = m_alloc_error;
+    return;
+  }
+
+  if(FILE_FLAG_INLINE & descriptor->header.flags)
+  {
+    RETURN_CODE m_free_error = NO_ERROR;
+    FS_INLINE_FREE(
+      descriptor->header.lbi_start, descriptor->header.flags >> 4U,
+      &m_free_error
+    );
+    if(NO_ERROR != m_free_error)
+    {
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+  }
+
+  descriptor->header.lbi_start = m_lbi;
+  descriptor->header.flags = 0U;
+  descriptor->modified = 1U;
+  descriptor->buffer.lbi = m_lbi;
+  descriptor->buffer.dirty = 1U;
+
+  *return_code = NO_ERROR;
+}
+/* ======== INLINE ======== */
+
+
+
+/* ======== SERIES ======== */
+static void FS_SERIES_ENCODE(
+/* IN  */ const FS_SERIES_FRAME_TYPE * FRAME,
+/* IN  */ const U8 * BLOCK,
+/* IN  */ const U32 TIME,
+/* IN  */ const SIZE32 LENGTH,
+/* IN  */ const VOID_PTR DATA,
+/* OUT */ U8 * record,
+/* OUT */ SIZE32 * record_length,
+/* OUT */ RETURN_CODE * return_code)
+{
+  const U8 M_EMPTY = (sizeof(FS_SERIES_FRAME_TYPE) == FRAME->end);
+
+  /* 1. Смещение времени и длина (LEB128: 7 бит в байте, старший бит -
+   *    продолжение) */
+  const U32 M_FIELDS[2U] = { M_EMPTY ? 0U : TIME - FRAME->first, LENGTH };
+  const SIZE32 M_COUNT = (0U == FRAME->record_size) ? 2U : 1U;
+  SIZE32 m_length = 0U;
+  for(register SIZE32 i = 0U; i < M_COUNT; i++)
+  {
+    U32 m_value = M_FIELDS[i];
+    do
+    {
+      record[m_length] = (U8)(m_value & 0x7FU);
+      m_value >>= 7U;
+      if(0U != m_value)
+      {
+        record[m_length] |= 0x80U;
+      }
+      m_length++;
+    } while(0U != m_value);
+  }
+
+  /* 2. Данные: без изменений или разность с первой записью блока */
+  const U8 * M_DATA = (const U8 *)DATA;
+  if((FS_SERIES_DELTA == FRAME->encoding) && (0U == M_EMPTY))
+  {
+    U32 m_time;
+    SIZE32 m_size;
+    SIZE32 m_payload;
+    SIZE32 m_next;
+    RETURN_CODE m_decode_error = NO_ERROR;
+    FS_SERIES_DECODE(
+      FRAME, BLOCK, sizeof(FS_SERIES_FRAME_TYPE), FRAME->end,
+      &m_time, &m_size, &m_payload, &m_next, &m_decode_error
+    );
+    if((NO_ERROR != m_decode_error) || (LENGTH != m_size))
+    {
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+    for(register SIZE32 i = 0U; i < LENGTH; i++)
+    {
+      record[m_length + i] = (U8)(M_DATA[i] - BLOCK[m_payload + i]);
+    }
+  }
+  else
+  {
+    STD_MEMCPY(LENGTH, DATA, record + m_length);
+  }
+
+  *record_length = m_length + LENGTH;
+  *return_code = NO_ERROR;
+}
+
+static void FS_SERIES_DECODE(
+/* IN  */ const FS_SERIES_FRAME_TYPE * FRAME,
+/* IN  */ const U8 * BLOCK,
+/* IN  */ const SIZE32 OFFSET,
+/* IN  */ const SIZE32 LIMIT,
+/* OUT */ U32 * time,
+/* OUT */ SIZE32 * length,
+/* OUT */ SIZE32 * payload,
+/* OUT */ SIZE32 * next,
+/* OUT */ RETURN_CODE * return_code)
+{
+  /* 1. Смещение времени и длина (у записей постоянного размера - из
+   *    заголовка блока) */
+  U32 m_fields[2U] = { 0U, FRAME->record_size };
+  const SIZE32 M_COUNT = (0U == FRAME->record_size) ? 2U : 1U;
+  SIZE32 m_offset = OFFSET;
+  for(register SIZE32 i = 0U; i < M_COUNT; i++)
+  {
+    U32 m_value = 0U;
+    SIZE32 m_shift = 0U;
+    U8 m_byte;
+    do
+    {
+      if((m_offset >= LIMIT) || (m_shift > 28U))
+      {
+        *return_code = OPERATION_FAILED;
+        return;
+      }
+      m_byte = BLOCK[m_offset];
+      m_value |= (U32)(m_byte & 0x7FU) << m_shift;
+      m_shift += 7U;
+      m_offset++;
+    } while(0U != (m_byte & 0x80U));
+    m_fields[i] = m_value;
+  }
+
+  /* 2. Данные не выходят за конец записей блока */
+  if((m_fields[1U] > FS_SERIES_RECORD_SIZE)
+  || (m_offset + m_fields[1U] > LIMIT))
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  *time = FRAME->first + m_fields[0U];
+  *length = m_fields[1U];
+  *payload = m_offset;
+  *next = m_offset + m_fields[1U];
+  *return_code = NO_ERROR;
+}
+/* ======== SERIES ======== */
+
+
+
+
+
+/*
+ * ФОРМАТИРОВАНИЕ ФС
+ */
+static void FS_FORMAT(
+/* OUT */ RETURN_CODE * return_code)
+{
+  /* Инициализация битовой карты блоков */
+  for(register FTL_INDEX m_lbi = 0U; m_lbi < FS_BLOCKS_COUNT; m_lbi++)
+  {
+    SIZE32 m_index = m_lbi / 4U;
+    U8 m_shift = (m_lbi % 4U) * 2U;
+    BLOCK_FLAG m_flag
+      = (m_lbi < FS_DATA_LBI) ? BLOCK_FLAG_SYSTEM : BLOCK_FLAG_FREE;
+
+    g_fs->block_flags[m_index] &= ~(0x03U << m_shift);
+    g_fs->block_flags[m_index] |= (m_flag << m_shift);
+  }
+  for(register SIZE32 i = 0U; i < 4U; i++)
+  {
+    RETURN_CODE m_blockflag_error = NO_ERROR;
+    FS_BLOCKFLAG_FLUSH(i, &m_blockflag_error);
+    if(NO_ERROR != m_blockflag_error)
+    {
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+  }
+
+  /* Очистка таблиц и журнала (записываются напрямую, без журнала) */
+  STD_MEMSET(sizeof(g_fs->file_map), 0x00U, g_fs->file_map);
+  STD_MEMSET(sizeof(g_fs->tag_names), 0x00U, g_fs->tag_names);
+  STD_MEMSET(sizeof(g_fs->tag_index), 0x00U, g_fs->tag_index);
+  STD_MEMSET(sizeof(g_fs->block_refs), 0x00U, g_fs->block_refs);
+  U8 m_empty_block[FS_BLOCK_SIZE] = {0};
+  for(register FTL_INDEX m_lbi = FS_FILEMAP_LBI; m_lbi < FS_DATA_LBI; m_lbi++)
+  {
+    RETURN_CODE m_write_error = NO_ERROR;
+    FTL_WRITE(m_lbi, 1U, m_empty_block, &m_write_error);
+    if(NO_ERROR != m_write_error)
+    {
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+  }
+
+  /* Суперблок записывается последним (ФС отформатирована) */
+  g_fs->superblock.magic = FS_MAGIC;
+  g_fs->superblock.version = FS_VERSION;
+  g_fs->superblock.checkpoint = 0U;
+  g_fs->journal.sequence = 1U;
+  g_fs->journal.block.length = 0U;
+  g_fs->journal.depth = 0U;
+  g_fs->journal.undo_length = 0U;
+  g_fs->journal.cancel = 0U;
+  g_fs->journal.frees = 0U;
+  U8 m_superblock[FS_BLOCK_SIZE] = {0};
+  STD_MEMCPY(sizeof(FS_SUPERBLOCK_TYPE), &g_fs->superblock, m_superblock);
+  RETURN_CODE m_superblock_error = NO_ERROR;
+  FTL_WRITE(0U, 1U, m_superblock, &m_superblock_error);
+  if(NO_ERROR != m_superblock_error)
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  *return_code = NO_ERROR;
+}
+
+
+
+/*
+ * ЗАГРУЗКА БИТОВОЙ КАРТЫ БЛОКОВ:
+ *   return_code: Статус операции
+ */
+static void FS_MOUNT_BLOCKFLAGS(
+/* OUT */ RETURN_CODE * return_code)
+{
+  U8 m_data[FS_BLOCK_SIZE];
+  for(register SIZE32 i = 0U; i < 4U; i++)
+  {
+    RETURN_CODE m_blockflag_error = NO_ERROR;
+    FTL_READ(1U + i, 1U, m_data, &m_blockflag_error);
+    if(NO_ERROR != m_blockflag_error)
+    {
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+
+    SIZE32 m_size = sizeof(BLOCK_FLAG_BITMAP) - i * FS_BLOCK_SIZE;
+    if(m_size > FS_BLOCK_SIZE)
+    {
+      m_size = FS_BLOCK_SIZE;
+    }
+    STD_MEMCPY(m_size, m_data, g_fs->block_flags + i * FS_BLOCK_SIZE);
+  }
+
+  *return_code = NO_ERROR;
+}
+
+/*
+ * ЗАГРУЗКА ИМЕН ТЕГОВ:
+ *   return_code: Статус операции
+ */
+static void FS_MOUNT_TAGNAMES(
+/* OUT */ RETURN_CODE * return_code)
+{
+  for(register TAG_ID m_tag_id = 0U; m_tag_id < FS_TAGS_COUNT; m_tag_id++)
+  {
+    RETURN_CODE m_tag_error = NO_ERROR;
+    FS_TAGNAME_READ(m_tag_id, g_fs->tag_names[m_tag_id], &m_tag_error);
+    if(OPERATION_FAILED == m_tag_error)
+    {
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+  }
+
+  *return_code = NO_ERROR;
+}
+
+/*
+ * ЗАГРУЗКА КАРТЫ ФАЙЛОВ И ИНДЕКСА ТЕГОВ:
+ *   return_code: Статус операции
+ */
+static void FS_MOUNT_TAGINDEX(
+/* OUT */ RETURN_CODE * return_code)
+{
+  U8 m_data[FS_BLOCK_SIZE];
+  RETURN_CODE m_map_error = NO_ERROR;
+  FTL_READ(FS_FILEMAP_LBI, 1U, m_data, &m_map_error);
+  if(NO_ERROR != m_map_error)
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+  STD_MEMCPY(FS_BLOCK_SIZE, m_data, g_fs->file_map);
+
+  for(register TAG_ID m_tag_id = 0U; m_tag_id < FS_TAGS_COUNT; m_tag_id++)
+  {
+    RETURN_CODE m_index_error = NO_ERROR;
+    FTL_READ(FS_TAGINDEX_LBI + m_tag_id, 1U, m_data, &m_index_error);
+    if(NO_ERROR != m_index_error)
+    {
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+    STD_MEMCPY(FS_BLOCK_SIZE, m_data, g_fs->tag_index[m_tag_id]);
+  }
+
+  *return_code = NO_ERROR;
+}
+
+/*
+ * ЗАГРУЗКА СЧЕТЧИКОВ ССЫЛОК НА БЛОКИ:
+ *   return_code: Статус операции
+ */
+static void FS_MOUNT_REFS(
+/* OUT */ RETURN_CODE * return_code)
+{
+  U8 m_data[FS_BLOCK_SIZE];
+  for(register SIZE32 i = 0U; i < FS_REFS_COUNT; i++)
+  {
+    RETURN_CODE m_refs_error = NO_ERROR;
+    FTL_READ(FS_REFS_LBI + i, 1U, m_data, &m_refs_error);
+    if(NO_ERROR != m_refs_error)
+    {
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+
+    SIZE32 m_size = sizeof(g_fs->block_refs) - i * FS_BLOCK_SIZE;
+    if(m_size > FS_BLOCK_SIZE)
+    {
+      m_size = FS_BLOCK_SIZE;
+    }
+    STD_MEMCPY(m_size, m_data, g_fs->block_refs + i * FS_BLOCK_SIZE);
+  }
+
+  *return_code = NO_ERROR;
+}
+
+/*
+ * ШАГ ЗАГРУЗКИ ТАБЛИЦ ПРИ МОНТИРОВАНИИ:
+ *   load: Загрузка таблицы
+ *   volume: Монтируемый том
+ *   return_code: Статус загрузки
+ *   thread: Поток загрузки (FS_THREAD_SAFE)
+ *   started: Поток запущен
+ */
+typedef struct
+{
+  void (*load)(RETURN_CODE *);
+  VOLUME_ID volume;
+  RETURN_CODE return_code;
+#if FS_THREAD_SAFE
+  pthread_t thread;
+  U8 started;
+#endif
+} FS_MOUNT_STEP_TYPE;
+
+/*
+ * ВЫПОЛНЕНИЕ ШАГА ЗАГРУЗКИ (FTL_READ читает совместно с другими шагами):
+ *   step: Шаг загрузки
+ */
+static VOID_PTR FS_MOUNT_WORKER(
+/* INOUT */ VOID_PTR step)
+{
+  FS_MOUNT_STEP_TYPE * m_step = (FS_MOUNT_STEP_TYPE *)step;
+  FS_VOLUME_SELECT(m_step->volume, &(m_step->return_code));
+  m_step->load(&(m_step->return_code));
+  return (VOID_PTR)(0);
+}
+
+/*
+ * МОНТИРОВАНИЕ ФС (сброс состояния в ОЗУ и загрузка таблиц из flash)
+ */
+static void FS_MOUNT(
+/* OUT */ RETURN_CODE * return_code)
+{
+  /* Инициализация таблицы дескрипторов (поколения сохраняются) */
+  g_fs->descriptor_free = FS_DESCRIPTORS_COUNT;
+  for(register SIZE32 i = FS_DESCRIPTORS_COUNT; i > 0U; i--)
+  {
+    g_fs->descriptor_table[i - 1U].id = (FILE_ID)UN_SET;
+    FS_DESCRIPTOR_PUSH(i - 1U);
+  }
+  STD_MEMSET(sizeof(g_fs->file_opens), 0x00U, (VOID_PTR)g_fs->file_opens);
+  for(register SIZE32 i = 0U; i < FS_READAHEAD_COUNT; i++)
+  {
+    g_fs->readahead_owner[i] = (SIZE32)UN_SET;
+  }
+  g_fs->inline_block.lbi = (FTL_INDEX)UN_SET;
+  for(register SIZE32 i = 0U; i < FS_META_CACHE_COUNT; i++)
+  {
+    g_fs->meta_cache[i].lbi = (FTL_INDEX)UN_SET;
+    g_fs->meta_cache[i].pending = 0U;
+  }
+  g_fs->meta_cache_next = 0U;
+  STD_MEMSET(sizeof(g_fs->meta_dirty), 0x00U, g_fs->meta_dirty);
+  g_fs->journal.block.length = 0U;
+  g_fs->journal.depth = 0U;
+  g_fs->journal.start = 0U;
+  g_fs->journal.undo_length = 0U;
+  g_fs->journal.spilled = 0U;
+  g_fs->journal.cancel = 0U;
+  g_fs->journal.keep = 0U;
+  g_fs->journal.frees = 0U;
+
+  /* Чтение суперблока */
+  U8 m_data[FS_BLOCK_SIZE];
+  RETURN_CODE m_superblock_error = NO_ERROR;
+  FTL_READ(0U, 1U, m_data, &m_superblock_error);
+  if(OPERATION_FAILED == m_superblock_error)
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+  STD_MEMCPY(sizeof(FS_SUPERBLOCK_TYPE), m_data, &g_fs->superblock);
+  if((NO_ACTION == m_superblock_error)
+  || (g_fs->superblock.magic != FS_MAGIC)
+  || (g_fs->superblock.version != FS_VERSION))
+  {
+    RETURN_CODE m_format_error = NO_ERROR;
+    FS_FORMAT(&m_format_error);
+    *return_code = m_format_error;
+    return;
+  }
+
+  /* Таблицы не пересекаются во flash и в ОЗУ: загружаются независимо */
+  VOLUME_ID m_volume;
+  FS_VOLUME_CURRENT(&m_volume);
+  FS_MOUNT_STEP_TYPE m_steps[] =
+  {
+    { .load = FS_MOUNT_BLOCKFLAGS, .volume = m_volume },
+    { .load = FS_MOUNT_TAGNAMES, .volume = m_volume },
+    { .load = FS_MOUNT_TAGINDEX, .volume = m_volume },
+    { .load = FS_MOUNT_REFS, .volume = m_volume }
+  };
+  const SIZE32 M_STEPS = sizeof(m_steps) / sizeof(m_steps[0U]);
+#if FS_THREAD_SAFE
+  /* На одном ядре шаги выполняются по порядку в вызывающем потоке */
+  const SIZE32 M_CPUS = FS_CPU_COUNT();
+  for(register SIZE32 i = 1U; (i < M_STEPS) && (M_CPUS > 1U); i++)
+  {
+    m_steps[i].started = (0 == pthread_create(
+      &(m_steps[i].thread), (VOID_PTR)(0), FS_MOUNT_WORKER, &(m_steps[i])));
+  }
+#endif
+  for(register SIZE32 i = 0U; i < M_STEPS; i++)
+  {
+#if FS_THREAD_SAFE
+    if(m_steps[i].started)
+    {
+      pthread_join(m_steps[i].thread, (VOID_PTR *)(0));
+      continue;
+    }
+#endif
+    FS_MOUNT_WORKER(&(m_steps[i]));
+  }
+  for(register SIZE32 i = 0U; i < M_STEPS; i++)
+  {
+    if(NO_ERROR != m_steps[i].return_code)
+    {
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+  }
+
+  /* Изменения, зафиксированные в журнале после контрольной точки */
+  FS_JOURNAL_REPLAY(return_code);
+}
+
+/*
+ * СОЗДАНИЕ ФАЙЛА С ФЛАГАМИ:
+ *   NAME: Имя файла
+ *   FLAGS: Флаги файла (FILE_FLAG)
+ *   return_code: Статус операции (как у FS_FILE_CREATE)
+ *   file_error: Ошибка ФС
+ */
+static void FS_FILE_NEW(
+/* IN  */ const FILE_NAME NAME,
+/* IN  */ const U8 FLAGS,
+/* OUT */ RETURN_CODE * return_code,
+/* OUT */ FILE_ERROR * file_error)
+{
+  FS_JOURNAL_SCOPE();
+  RETURN_CODE m_name_error = NO_ERROR;
+  FS_FILENAME_VALIDATE(NAME, &m_name_error);
+  if(NO_ERROR != m_name_error)
+  {
+    *file_error = FILE_ERROR_NAME_SIZE;
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  /* 1. Имя должно быть уникальным */
+  FILE_ID m_id;
+  RETURN_CODE m_find_error = NO_ERROR;
+  FS_FILE_FIND(NAME, &m_id, &m_find_error);
+  if(NO_ERROR == m_find_error)
+  {
+    *file_error = FILE_ERROR_EXIST;
+    *return_code = NO_ACTION;
+    return;
+  }
+  if(OPERATION_FAILED == m_find_error)
+  {
+    *file_error = FILE_ERROR_IO;
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  /* 2. Поиск свободного номера файла */
+  for(m_id = 0U; m_id < FS_FILES_COUNT; m_id++)
+  {
+    if(0U == (g_fs->file_map[m_id / 32U] & (1UL << (m_id % 32U))))
+    {
+      break;
+    }
+  }
+  if(m_id >= FS_FILES_COUNT)
+  {
+    *file_error = FILE_ERROR_NO_SPACE;
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  /* 3. Запись заголовка и имени */
+  FILE_HEADER_TYPE m_header =
+  (FILE_HEADER_TYPE){
+    .id = m_id,
+    .lbi_start = FS_BLOCK_NONE,
+    .tags = {0},
+    .flags = FLAGS,
+    .lbi_tail = FS_BLOCK_NONE,
+    .head = 0U,
+    .size = 0U
+  };
+  HASH_CRC(
+    &m_header, sizeof(FILE_HEADER_TYPE) - sizeof(U32), &(m_header.crc32)
+  );
+
+  RETURN_CODE m_header_error = NO_ERROR;
+  FS_FILEHEADER_WRITE(m_id, m_header, &m_header_error);
+  RETURN_CODE m_write_error = NO_ERROR;
+  FS_FILENAME_WRITE(m_id, NAME, &m_write_error);
+  RETURN_CODE m_map_error = NO_ERROR;
+  FS_FILEMAP_WRITE(m_id, 1U, &m_map_error);
+  if((NO_ERROR != m_header_error) || (NO_ERROR != m_write_error)
+  || (NO_ERROR != m_map_error))
+  {
+    *file_error = FILE_ERROR_IO;
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  /* 4. Имя, заголовок и карта фиксируются одной записью журнала */
+  RETURN_CODE m_commit_error = NO_ERROR;
+  FS_JOURNAL_COMMIT(&m_commit_error);
+  if(NO_ERROR != m_commit_error)
+  {
+    *file_error = FILE_ERROR_IO;
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  *return_code = NO_ERROR;
+}
+
+
+
+/*
+ * ВЫБОР ТОМА ВЫЗЫВАЮЩЕГО ПОТОКА
+ */
+void FS_VOLUME_SELECT(
+/* IN  */ const VOLUME_ID ID,
+/* OUT */ RETURN_CODE * return_code)
+{
+  if(ID >= FS_VOLUMES_COUNT)
+  {
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  RETURN_CODE m_select_error = NO_ERROR;
+  FTL_VOLUME_SELECT(ID, &m_select_error);
+  g_fs = &g_fs_volumes[ID];
+  *return_code = m_select_error;
+}
+
+
+
+/*
+ * ТОМ ВЫЗЫВАЮЩЕГО ПОТОКА
+ */
+void FS_VOLUME_CURRENT(
+/* OUT */ VOLUME_ID * id)
+{
+  *id = (VOLUME_ID)(g_fs - g_fs_volumes);
+}
+
+
+
+/*
+ * ИНИЦИАЛИЗАЦИЯ ФС
+ */
+void FS_INIT(RETURN_CODE* return_code)
+{
+#if FS_THREAD_SAFE
+  if(0U == g_fs->lock_ready)
+  {
+    FS_RWLOCK_INIT(&g_fs->volume_lock);
+    FS_LOCK_INIT(&g_fs->lock);
+    for(register SIZE32 i = 0U; i < FS_DESCRIPTORS_COUNT; i++)
+    {
+      FS_LOCK_INIT(&(g_fs->descriptor_table[i].lock));
+    }
+    g_fs->lock_ready = 1U;
+  }
+#endif
+
+  RETURN_CODE m_ftl_init_error = NO_ERROR;
+  FTL_INIT(&m_ftl_init_error);
+  if(NO_ERROR != m_ftl_init_error)
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  /* Метаданные перезаписываются чаще данных файлов */
+  RETURN_CODE m_hint_error = NO_ERROR;
+  FTL_HINT(0U, FS_DATA_LBI, FTL_TEMPERATURE_HOT, &m_hint_error);
+
+  FS_MOUNT(return_code);
+}
+
+
+
+/*
+ * ОТКЛЮЧЕНИЕ ФС
+ */
+void FS_FREE(RETURN_CODE * return_code)
+{
+  FS_DESCRIPTORS_SCOPE();
+  FS_LOCK_SCOPE(&g_fs->lock);
+
+  /* Запись незакрытых файлов */
+  RETURN_CODE m_sync_result = NO_ERROR;
+  for(register SIZE32 i = 0U; i < FS_DESCRIPTORS_COUNT; i++)
+  {
+    if((FILE_ID)UN_SET == g_fs->descriptor_table[i].id)
+    {
+      continue;
+    }
+
+    RETURN_CODE m_sync_error = NO_ERROR;
+    FS_DESCRIPTOR_SYNC(&(g_fs->descriptor_table[i]), &m_sync_error);
+    if(NO_ERROR != m_sync_error)
+    {
+      m_sync_result = OPERATION_FAILED;
+    }
+    FS_DESCRIPTOR_RELEASE(&(g_fs->descriptor_table[i]));
+  }
+
+  /* Перенос журнала в таблицы */
+  RETURN_CODE m_journal_error = NO_ERROR;
+  FS_JOURNAL_COMMIT(&m_journal_error);
+  if(NO_ERROR == m_journal_error)
+  {
+    FS_JOURNAL_CHECKPOINT(&m_journal_error);
+  }
+  if(NO_ERROR != m_journal_error)
+  {
+    m_sync_result = OPERATION_FAILED;
+  }
+
+  FTL_FREE(return_code);
+  if(NO_ERROR != m_sync_result)
+  {
+    *return_code = OPERATION_FAILED;
+  }
+}
+
+
+
+void FS_FILE_CREATE(
+/* IN  */ const FILE_NAME NAME,
+/* OUT */ RETURN_CODE * return_code,
+/* OUT */ FILE_ERROR * file_error)
+{
+  FS_FILE_NEW(NAME, 0U, return_code, file_error);
+}
+
+void FS_FILE_OPEN(
+/* IN  */ const FILE_NAME NAME,
+/* IN  */ const FILE_MODE MODE,
+/* OUT */ FILE_ID * id,
+/* OUT */ RETURN_CODE * return_code,
+/* OUT */ FILE_ERROR * file_error)
+{
+  if((FILE_MODE_READ_ONLY != MODE) && (FILE_MODE_READ_WRITE != MODE))
+  {
+    *file_error = FILE_ERROR_INVALID_PARAM;
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  RETURN_CODE m_name_error = NO_ERROR;
+  FS_FILENAME_VALIDATE(NAME, &m_name_error);
+  if(NO_ERROR != m_name_error)
+  {
+    *file_error = FILE_ERROR_NAME_SIZE;
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  /* 1. Поиск файла и заголовок (метаданные) */
+  FILE_ID m_file_id;
+  FILE_HEADER_TYPE m_header;
+  {
+    FS_LOCK_SCOPE(&g_fs->lock);
+    RETURN_CODE m_find_error = NO_ERROR;
+    FS_FILE_FIND(NAME, &m_file_id, &m_find_error);
+    if(NO_ACTION == m_find_error)
+    {
+      *file_error = FILE_ERROR_NO_FILE;
+      *return_code = NO_ACTION;
+      return;
+    }
+    if(NO_ERROR != m_find_error)
+    {
+      *file_error = FILE_ERROR_IO;
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+
+    /* 2. Запись разрешена только одному дескриптору (у каждого свой буфер) */
+    RETURN_CODE m_opens_error = NO_ERROR;
+    FS_OPENS_ACQUIRE(m_file_id, MODE, &m_opens_error);
+    if(NO_ERROR != m_opens_error)
+    {
+      *file_error = FILE_ERROR_BUSY;
+      *return_code = DEVICE_BUSY;
+      return;
+    }
+
+    RETURN_CODE m_header_error = NO_ERROR;
+    FS_FILEHEADER_READ(m_file_id, &m_header, &m_header_error);
+    if(NO_ERROR != m_header_error)
+    {
+      FS_OPENS_RELEASE(m_file_id, MODE);
+      *file_error = FILE_ERROR_IO;
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+  }
+
+  /* 3. Свободная ячейка из стека (без просмотра таблицы) */
+  SIZE32 m_slot;
+  RETURN_CODE m_pop_error = NO_ERROR;
+  FS_DESCRIPTOR_POP(&m_slot, &m_pop_error);
+  if(NO_ERROR != m_pop_error)
+  {
+    FS_OPENS_RELEASE(m_file_id, MODE);
+    *file_error = FILE_ERROR_DESCRIPTOR;
+    *return_code = DEVICE_BUSY;
+    return;
+  }
+
+  /* 4. Заполнение дескриптора (номер файла - последним) */
+  FS_DESCRIPTOR_TYPE * m_descriptor = &(g_fs->descriptor_table[m_slot]);
+  FS_VOLUME_SCOPE_READ();
+  FS_LOCK_SCOPE(&(m_descriptor->lock));
+  m_descriptor->header = m_header;
+  m_descriptor->status.size = m_descriptor->header.size;
+  m_descriptor->status.position = (FILE_POSITION)m_header.head;
+  m_descriptor->status.mode = MODE;
+  STD_MEMCPY(
+    sizeof(TAG_BITMAP), m_descriptor->header.tags, m_descriptor->status.tags
+  );
+  STD_STRNCPY(FILE_NAME_SIZE, NAME, m_descriptor->name);
+  m_descriptor->modified = 0U;
+  m_descriptor->buffer.lbi = (FTL_INDEX)UN_SET;
+  m_descriptor->buffer.dirty = 0U;
+  m_descriptor->readahead.slot = (SIZE32)UN_SET;
+  m_descriptor->status.readahead = (FILE_READAHEAD_TYPE){0};
+  FS_READAHEAD_RESET(m_descriptor);
+  m_descriptor->cow = (FS_COW_TYPE){
+    .index = 0U,
+    .lbi = (FTL_INDEX)UN_SET,
+    .prev = FS_BLOCK_NONE
+  };
+  m_descriptor->id = m_file_id;
+
+  *id = (FILE_ID)((m_descriptor->generation << FS_DESCRIPTOR_GENERATION_SHIFT)
+                  | ((SIZE32)(g_fs - g_fs_volumes) << FS_DESCRIPTOR_SLOT_BITS)
+                  | m_slot);
+  *return_code = NO_ERROR;
+}
+
+void FS_FILE_CLOSE(
+/* IN  */ const FILE_ID ID,
+/* OUT */ RETURN_CODE * return_code,
+/* OUT */ FILE_ERROR * file_error)
+{
+  FS_DESCRIPTOR_TYPE * m_descriptor;
+  RETURN_CODE m_get_error = NO_ERROR;
+  FS_DESCRIPTOR_GET(ID, &m_descriptor, &m_get_error);
+  if(NO_ERROR != m_get_error)
+  {
+    *file_error = FILE_ERROR_DESCRIPTOR;
+    *return_code = INVALID_PARAM;
+    return;
+  }
+  FS_VOLUME_SCOPE_READ();
+  FS_LOCK_SCOPE(&(m_descriptor->lock));
+
+  RETURN_CODE m_sync_error = NO_ERROR;
+  FS_DESCRIPTOR_SYNC(m_descriptor, &m_sync_error);
+  FS_DESCRIPTOR_RELEASE(m_descriptor);
+  if(NO_ERROR != m_sync_error)
+  {
+    *file_error
+      = (NO_ACTION == m_sync_error) ? FILE_ERROR_NO_SPACE : FILE_ERROR_IO;
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  *return_code = NO_ERROR;
+}
+
+void FS_FILE_SYNC(
+/* IN  */ const FILE_ID ID,
+/* OUT */ RETURN_CODE * return_code,
+/* OUT */ FILE_ERROR * file_error)
+{
+  FS_DESCRIPTOR_TYPE * m_descriptor;
+  RETURN_CODE m_get_error = NO_ERROR;
+  FS_DESCRIPTOR_GET(ID, &m_descriptor, &m_get_error);
+  if(NO_ERROR != m_get_error)
+  {
+    *file_error = FILE_ERROR_DESCRIPTOR;
+    *return_code = INVALID_PARAM;
+    return;
+  }
+  FS_VOLUME_SCOPE_READ();
+  FS_LOCK_SCOPE(&(m_descriptor->lock));
+
+  RETURN_CODE m_sync_error = NO_ERROR;
+  FS_DESCRIPTOR_SYNC(m_descriptor, &m_sync_error);
+  if(NO_ERROR != m_sync_error)
+  {
+    *file_error
+      = (NO_ACTION == m_sync_error) ? FILE_ERROR_NO_SPACE : FILE_ERROR_IO;
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  *return_code = NO_ERROR;
+}
+
+void FS_FILE_READ(
+/* IN  */ const FILE_ID ID,
+/* IN  */ const SIZE32 IN_LENGTH,
+/* OUT */ SIZE32 * out_length,
+/* OUT */ VOID_PTR data,
+/* OUT */ RETURN_CODE * return_code,
+/* OUT */ FILE_ERROR * file_error)
+{
+  *out_length = 0U;
+
+  FS_DESCRIPTOR_TYPE * m_descriptor;
+  RETURN_CODE m_get_error = NO_ERROR;
+  FS_DESCRIPTOR_GET(ID, &m_descriptor, &m_get_error);
+  if(NO_ERROR != m_get_error)
+  {
+    *file_error = FILE_ERROR_DESCRIPTOR;
+    *return_code = INVALID_PARAM;
+    return;
+  }
+  FS_VOLUME_SCOPE_READ();
+  FS_LOCK_SCOPE(&(m_descriptor->lock));
+
+  RETURN_CODE m_read_error = NO_ERROR;
+  FS_DESCRIPTOR_READ(
+    m_descriptor, IN_LENGTH, out_length, data, &m_read_error
+  );
+  if(NO_ERROR != m_read_error)
+  {
+    *file_error = FILE_ERROR_IO;
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  *return_code = NO_ERROR;
+}
+
+void FS_FILE_READV(
+/* IN  */ const FILE_ID ID,
+/* IN  */ const SIZE32 COUNT,
+/* IN  */ const FILE_IOVEC_TYPE * VECTOR,
+/* OUT */ SIZE32 * out_length,
+/* OUT */ RETURN_CODE * return_code,
+/* OUT */ FILE_ERROR * file_error)
+{
+  *out_length = 0U;
+
+  FS_DESCRIPTOR_TYPE * m_descriptor;
+  RETURN_CODE m_get_error = NO_ERROR;
+  FS_DESCRIPTOR_GET(ID, &m_descriptor, &m_get_error);
+  if(NO_ERROR != m_get_error)
+  {
+    *file_error = FILE_ERROR_DESCRIPTOR;
+    *return_code = INVALID_PARAM;
+    return;
+  }
+  FS_VOLUME_SCOPE_READ();
+  FS_LOCK_SCOPE(&(m_descriptor->lock));
+
+  /* Части заполняются из буфера блока, короткая часть - конец файла */
+  for(register SIZE32 i = 0U; i < COUNT; i++)
+  {
+    SIZE32 m_length = 0U;
+    RETURN_CODE m_read_error = NO_ERROR;
+    FS_DESCRIPTOR_READ(
+      m_descriptor, VECTOR[i].length, &m_length, VECTOR[i].data,
+      &m_read_error
+    );
+    *out_length += m_length;
+    if(NO_ERROR != m_read_error)
+    {
+      *file_error = FILE_ERROR_IO;
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+    if(m_length < VECTOR[i].length)
+    {
+      break;
+    }
+  }
+
+  *return_code = NO_ERROR;
+}
+
+void FS_FILE_WRITE(
+/* IN  */ const FILE_ID ID,
+/* IN  */ const SIZE32 LENGTH,
+/* IN  */ const VOID_PTR DATA,
+/* OUT */ RETURN_CODE * return_code,
+/* OUT */ FILE_ERROR * file_error)
+{
+  FS_DESCRIPTOR_TYPE * m_descriptor;
+  RETURN_CODE m_get_error = NO_ERROR;
+  FS_DESCRIPTOR_GET(ID, &m_descriptor, &m_get_error);
+  if(NO_ERROR != m_get_error)
+  {
+    *file_error = FILE_ERROR_DESCRIPTOR;
+    *return_code = INVALID_PARAM;
+    return;
+  }
+  FS_VOLUME_SCOPE_READ();
+  FS_LOCK_SCOPE(&(m_descriptor->lock));
+
+  if(FILE_MODE_READ_WRITE != m_descriptor->status.mode)
+  {
+    *file_error = FILE_ERROR_PERMISSION;
+    *return_code = ACCESS_DENIED;
+    return;
+  }
+
+  if(LENGTH > 0x7FFFFFFFU - (SIZE32)m_descriptor->status.position)
+  {
+    *file_error = FILE_ERROR_FILE_SIZE;
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  RETURN_CODE m_write_error = NO_ERROR;
+  FS_DESCRIPTOR_WRITE(m_descriptor, LENGTH, DATA, &m_write_error);
+  if(NO_ERROR != m_write_error)
+  {
+    *file_error
+      = (NO_ACTION == m_write_error) ? FILE_ERROR_NO_SPACE : FILE_ERROR_IO;
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  *return_code = NO_ERROR;
+}
+
+void FS_FILE_WRITEV(
+/* IN  */ const FILE_ID ID,
+/* IN  */ const SIZE32 COUNT,
+/* IN  */ const FILE_IOVEC_TYPE * VECTOR,
+/* IN  */ const U8 APPEND,
+/* OUT */ RETURN_CODE * return_code,
+/* OUT */ FILE_ERROR * file_error)
+{
+  FS_DESCRIPTOR_TYPE * m_descriptor;
+  RETURN_CODE m_get_error = NO_ERROR;
+  FS_DESCRIPTOR_GET(ID, &m_descriptor, &m_get_error);
+  if(NO_ERROR != m_get_error)
+  {
+    *file_error = FILE_ERROR_DESCRIPTOR;
+    *return_code = INVALID_PARAM;
+    return;
+  }
+  FS_VOLUME_SCOPE_READ();
+  FS_LOCK_SCOPE(&(m_descriptor->lock));
+
+  if(FILE_MODE_READ_WRITE != m_descriptor->status.mode)
+  {
+    *file_error = FILE_ERROR_PERMISSION;
+    *return_code = ACCESS_DENIED;
+    return;
+  }
+
+  /* 1. Добавление начинается с конца файла */
+  const FILE_POSITION M_POSITION = m_descriptor->status.position;
+  const SIZE32 M_SIZE = m_descriptor->status.size;
+  if(APPEND)
+  {
+    m_descriptor->status.position = (FILE_POSITION)M_SIZE;
+  }
+
+  /* 2. Размер проверяется для всего вектора до записи */
+  SIZE32 m_total = 0U;
+  for(register SIZE32 i = 0U; i < COUNT; i++)
+  {
+    if(VECTOR[i].length > 0x7FFFFFFFU - m_total)
+    {
+      m_total = (SIZE32)UN_SET;
+      break;
+    }
+    m_total += VECTOR[i].length;
+  }
+  if(m_total > 0x7FFFFFFFU - (SIZE32)m_descriptor->status.position)
+  {
+    m_descriptor->status.position = M_POSITION;
+    *file_error = FILE_ERROR_FILE_SIZE;
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  /* 3. Части копируются в буфер блока без промежуточной сборки */
+  RETURN_CODE m_write_error = NO_ERROR;
+  for(register SIZE32 i = 0U; i < COUNT; i++)
+  {
+    FS_DESCRIPTOR_WRITE(
+      m_descriptor, VECTOR[i].length, VECTOR[i].data, &m_write_error
+    );
+    if(NO_ERROR != m_write_error)
+    {
+      break;
+    }
+  }
+  if(NO_ERROR == m_write_error)
+  {
+    *return_code = NO_ERROR;
+    return;
+  }
+
+  /* 4. Неполное добавление отбрасывается вместе с выделенными блоками */
+  if(APPEND)
+  {
+    RETURN_CODE m_truncate_error = NO_ERROR;
+    FILE_ERROR m_truncate_file_error;
+    FS_FILE_TRUNCATE(ID, M_SIZE, &m_truncate_error, &m_truncate_file_error);
+    m_descriptor->status.position = M_POSITION;
+  }
+  *file_error
+    = (NO_ACTION == m_write_error) ? FILE_ERROR_NO_SPACE : FILE_ERROR_IO;
+  *return_code = OPERATION_FAILED;
+}
+
+void FS_FILE_MAP(
+/* IN  */ const FILE_ID ID,
+/* IN  */ const SIZE32 CAPACITY,
+/* OUT */ FILE_SEGMENT_TYPE * segments,
+/* OUT */ SIZE32 * count,
+/* IN  */ const SIZE32 SCRATCH_SIZE,
+/* OUT */ VOID_PTR scratch,
+/* OUT */ RETURN_CODE * return_code,
+/* OUT */ FILE_ERROR * file_error)
+{
+  *count = 0U;
+
+  FS_DESCRIPTOR_TYPE * m_descriptor;
+  RETURN_CODE m_get_error = NO_ERROR;
+  FS_DESCRIPTOR_GET(ID, &m_descriptor, &m_get_error);
+  if(NO_ERROR != m_get_error)
+  {
+    *file_error = FILE_ERROR_DESCRIPTOR;
+    *return_code = INVALID_PARAM;
+    return;
+  }
+  FS_VOLUME_SCOPE_READ();
+  FS_LOCK_SCOPE(&(m_descriptor->lock));
+
+  /* 1. Отображаются данные во flash */
+  RETURN_CODE m_sync_error = NO_ERROR;
+  FS_DESCRIPTOR_SYNC(m_descriptor, &m_sync_error);
+  if(NO_ERROR != m_sync_error)
+  {
+    *file_error
+      = (NO_ACTION == m_sync_error) ? FILE_ERROR_NO_SPACE : FILE_ERROR_IO;
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  /* 2. Обход цепочки (файл в ячейке общего блока - одна часть) */
+  const SIZE32 M_SIZE = m_descriptor->status.size;
+  FTL_INDEX m_lbi = m_descriptor->header.lbi_start;
+  SIZE32 m_offset = 2U;
+  if(FILE_FLAG_INLINE & m_descriptor->header.flags)
+  {
+    m_offset = 2U + (m_descriptor->header.flags >> 4U) * FS_INLINE_SIZE;
+  }
+
+  SIZE32 m_mapped = 0U;
+  SIZE32 m_used = 0U;
+  RETURN_CODE m_map_error = NO_ERROR;
+  FILE_ERROR m_map_file_error = FILE_ERROR_IO;
+  while((NO_ERROR == m_map_error) && (m_mapped < M_SIZE))
+  {
+    SIZE32 m_length = M_SIZE - m_mapped;
+    if(m_length > FS_DATA_SIZE)
+    {
+      m_length = FS_DATA_SIZE;
+    }
+    if(FS_BLOCK_NONE == m_lbi)
+    {
+      m_map_error = OPERATION_FAILED;
+      break;
+    }
+
+    /* Блок на месте закрепляется, иначе копируется в буфер */
+    const U8 * m_block;
+    U8 m_copy[FS_BLOCK_SIZE];
+    FILE_SEGMENT_TYPE m_segment;
+    RETURN_CODE m_view_error = NO_ERROR;
+    FTL_VIEW_OPEN(m_lbi, &m_block, &m_view_error);
+    if(NO_ERROR == m_view_error)
+    {
+      m_segment.pinned = 1U;
+    }
+    else if(NO_ACTION == m_view_error)
+    {
+      if(m_length > SCRATCH_SIZE - m_used)
+      {
+        m_map_error = INVALID_PARAM;
+        m_map_file_error = FILE_ERROR_NO_SPACE;
+        break;
+      }
+      RETURN_CODE m_read_error = NO_ERROR;
+      FTL_READ(m_lbi, 1U, m_copy, &m_read_error);
+      if(NO_ERROR != m_read_error)
+      {
+        m_map_error = OPERATION_FAILED;
+        break;
+      }
+      STD_MEMCPY(m_length, m_copy + m_offset, (U8 *)scratch + m_used);
+      m_block = m_copy;
+      m_segment.pinned = 0U;
+    }
+    else
+    {
+      m_map_error = OPERATION_FAILED;
+      m_map_file_error = (DEVICE_BUSY == m_view_error)
+        ? FILE_ERROR_NO_SPACE : FILE_ERROR_IO;
+      break;
+    }
+    m_segment.length = m_length;
+    m_segment.data = m_segment.pinned
+      ? (m_block + m_offset) : ((U8 *)scratch + m_used);
+
+    /* Соседние копии в буфере - одна часть */
+    FILE_SEGMENT_TYPE * m_last = (0U != *count)
+      ? &segments[*count - 1U] : (FILE_SEGMENT_TYPE *)(0);
+    if(!m_segment.pinned && ((FILE_SEGMENT_TYPE *)(0) != m_last)
+    && !m_last->pinned && (m_last->data + m_last->length == m_segment.data))
+    {
+      m_last->length += m_length;
+    }
+    else if(*count < CAPACITY)
+    {
+      segments[(*count)++] = m_segment;
+    }
+    else
+    {
+      if(m_segment.pinned)
+      {
+        RETURN_CODE m_close_error = NO_ERROR;
+        FTL_VIEW_CLOSE(m_segment.data, &m_close_error);
+      }
+      m_map_error = INVALID_PARAM;
+      m_map_file_error = FILE_ERROR_NO_SPACE;
+      break;
+    }
+    if(!m_segment.pinned)
+    {
+      m_used += m_length;
+    }
+
+    m_mapped += m_length;
+    m_lbi = (FTL_INDEX)((m_block[0U] << 8U) | m_block[1U]);
+    m_offset = 2U;
+  }
+
+  /* 3. Неполное отображение снимается */
+  if(NO_ERROR != m_map_error)
+  {
+    RETURN_CODE m_unmap_error = NO_ERROR;
+    FILE_ERROR m_unmap_file_error;
+    FS_FILE_UNMAP(*count, segments, &m_unmap_error, &m_unmap_file_error);
+    *count = 0U;
+    *file_error = m_map_file_error;
+    *return_code = m_map_error;
+    return;
+  }
+
+  *return_code = NO_ERROR;
+}
+
+void FS_FILE_UNMAP(
+/* IN  */ const SIZE32 COUNT,
+/* IN  */ const FILE_SEGMENT_TYPE * SEGMENTS,
+/* OUT */ RETURN_CODE * return_code,
+/* OUT */ FILE_ERROR * file_error)
+{
+  RETURN_CODE m_result = NO_ERROR;
+  for(register SIZE32 i = 0U; i < COUNT; i++)
+  {
+    if(!SEGMENTS[i].pinned)
+    {
+      continue;
+    }
+    RETURN_CODE m_close_error = NO_ERROR;
+    FTL_VIEW_CLOSE(SEGMENTS[i].data, &m_close_error);
+    if(NO_ERROR != m_close_error)
+    {
+      m_result = INVALID_PARAM;
+    }
+  }
+
+  if(NO_ERROR != m_result)
+  {
+    *file_error = FILE_ERROR_INVALID_PARAM;
+  }
+  *return_code = m_result;
+}
+
+void FS_FILE_SEEK(
+/* IN  */ const FILE_ID ID,
+/* IN  */ const FILE_POSITION OFFSET,
+/* IN  */ const FILE_SEEK WHENCE,
+/* OUT */ FILE_POSITION * position,
+/* OUT */ RETURN_CODE * return_code,
+/* OUT */ FILE_ERROR * file_error)
+{
+  FS_DESCRIPTOR_TYPE * m_descriptor;
+  RETURN_CODE m_get_error = NO_ERROR;
+  FS_DESCRIPTOR_GET(ID, &m_descriptor, &m_get_error);
+  if(NO_ERROR != m_get_error)
+  {
+    *file_error = FILE_ERROR_DESCRIPTOR;
+    *return_code = INVALID_PARAM;
+    return;
+  }
+  FS_VOLUME_SCOPE_READ();
+  FS_LOCK_SCOPE(&(m_descriptor->lock));
+
+  /* Начало журнала - первая неотброшенная запись */
+  const FILE_POSITION M_HEAD = (FILE_POSITION)m_descriptor->header.head;
+  FILE_POSITION m_base;
+  switch(WHENCE)
+  {
+    case FILE_SEEK_SET:
+      m_base = M_HEAD;
+      break;
+    case FILE_SEEK_CUR:
+      m_base = m_descriptor->status.position;
+      break;
+    case FILE_SEEK_END:
+      m_base = (FILE_POSITION)m_descriptor->status.size;
+      break;
+    default:
+      *file_error = FILE_ERROR_INVALID_PARAM;
+      *return_code = INVALID_PARAM;
+      return;
+  }
+
+  /* Буфер не сбрасывается: он остается верным для своего блока */
+  const FILE_POSITION M_POSITION = m_base + OFFSET;
+  if((M_POSITION < M_HEAD)
+  || (M_POSITION > (FILE_POSITION)m_descriptor->status.size))
+  {
+    *file_error = FILE_ERROR_OVERFLOW;
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  m_descriptor->status.position = M_POSITION;
+  *position = M_POSITION;
+  *return_code = NO_ERROR;
+}
+
+void FS_FILE_TRUNCATE(
+/* IN  */ const FILE_ID ID,
+/* IN  */ const SIZE32 SIZE,
+/* OUT */ RETURN_CODE * return_code,
+/* OUT */ FILE_ERROR * file_error)
+{
+  FS_DESCRIPTOR_TYPE * m_descriptor;
+  RETURN_CODE m_get_error = NO_ERROR;
+  FS_DESCRIPTOR_GET(ID, &m_descriptor, &m_get_error);
+  if(NO_ERROR != m_get_error)
+  {
+    *file_error = FILE_ERROR_DESCRIPTOR;
+    *return_code = INVALID_PARAM;
+    return;
+  }
+  FS_VOLUME_SCOPE_READ();
+  FS_LOCK_SCOPE(&(m_descriptor->lock));
+  FS_JOURNAL_SCOPE_KEEP();
+
+  if(FILE_MODE_READ_WRITE != m_descriptor->status.mode)
+  {
+    *file_error = FILE_ERROR_PERMISSION;
+    *return_code = ACCESS_DENIED;
+    return;
+  }
+
+  if(SIZE > m_descriptor->status.size)
+  {
+    *file_error = FILE_ERROR_OVERFLOW;
+    *return_code = INVALID_PARAM;
+    return;
+  }
+  if(SIZE == m_descriptor->status.size)
+  {
+    *return_code = NO_ERROR;
+    return;
+  }
+
+  /* 1. Буфер во flash: дальше цепочка меняется только через заголовок */
+  RETURN_CODE m_flush_error = NO_ERROR;
+  FS_BUFFER_FLUSH(m_descriptor, &m_flush_error);
+  FS_READAHEAD_RESET(m_descriptor);
+  if(NO_ERROR != m_flush_error)
+  {
+    *file_error = FILE_ERROR_IO;
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  /* 2. Отделение хвоста: последний оставшийся блок завершает цепочку */
+  FILE_HEADER_TYPE * m_header = &(m_descriptor->header);
+  const SIZE32 M_KEEP = (SIZE + FS_DATA_SIZE - 1U) / FS_DATA_SIZE;
+  FTL_INDEX m_tail = FS_BLOCK_NONE;
+  U8 m_cut = 0U;
+  SIZE32 m_free_count = (SIZE32)UN_SET;
+  if(FILE_FLAG_LOG & m_header->flags)
+  {
+    /* Хвост журнала заканчивается выделенным незаписанным блоком */
+    m_free_count = (m_descriptor->status.size + FS_DATA_SIZE - 1U)
+      / FS_DATA_SIZE - M_KEEP + 1U;
+  }
+  RETURN_CODE m_cut_error = NO_ERROR;
+  if(FILE_FLAG_INLINE & m_header->flags)
+  {
+    /* Ячейка освобождается только у пустого файла */
+    if(0U == M_KEEP)
+    {
+      FS_INLINE_FREE(
+        m_header->lbi_start, m_header->flags >> 4U, &m_cut_error
+      );
+      m_header->lbi_start = FS_BLOCK_NONE;
+      m_header->flags = 0U;
+    }
+    m_descriptor->buffer.lbi = (FTL_INDEX)UN_SET;
+  }
+  else if(0U == M_KEEP)
+  {
+    m_tail = m_header->lbi_start;
+    m_header->lbi_start = FS_BLOCK_NONE;
+    m_descriptor->buffer.lbi = (FTL_INDEX)UN_SET;
+  }
+  else
+  {
+    /*
+     * Разделяемый блок копируется при записи, его копия получает ссылку
+     * на хвост, которую снимет освобождение хвоста. Свой блок обрывается
+     * намерением транзакции: до фиксации заголовка цепочка не меняется
+     */
+    FS_BUFFER_LOAD(m_descriptor, M_KEEP - 1U, &m_cut_error);
+    if(NO_ERROR == m_cut_error)
+    {
+      FS_BUFFER_TYPE * m_buffer = &(m_descriptor->buffer);
+      m_tail = (FTL_INDEX)((m_buffer->data[0U] << 8U) | m_buffer->data[1U]);
+      m_buffer->data[0U] = (U8)(FS_BLOCK_NONE >> 8U);
+      m_buffer->data[1U] = (U8)(FS_BLOCK_NONE);
+      if(FS_BLOCK_NONE == m_tail)
+      {
+        /* Блок уже последний */
+      }
+      else if(FILE_FLAG_SHARED & m_header->flags)
+      {
+        m_buffer->dirty = 1U;
+        FS_BUFFER_FLUSH(m_descriptor, &m_cut_error);
+      }
+      else
+      {
+        const U8 M_INTENT[2U] = {
+          (U8)(m_buffer->lbi >> 8U), (U8)(m_buffer->lbi)
+        };
+        FS_JOURNAL_INTENT(
+          FS_JOURNAL_MARK_CUT, sizeof(M_INTENT), M_INTENT, &m_cut_error
+        );
+        if(NO_ERROR != m_cut_error)
+        {
+          m_buffer->data[0U] = (U8)(m_tail >> 8U);
+          m_buffer->data[1U] = (U8)(m_tail);
+        }
+        m_cut = 1U;
+      }
+      m_header->lbi_tail = (U16)m_buffer->lbi;
+    }
+  }
+  if(NO_ERROR != m_cut_error)
+  {
+    *file_error = FILE_ERROR_IO;
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  /* 3. Новый заголовок и освобождение хвоста - одна транзакция */
+  m_descriptor->cow.index = 0U;
+  m_descriptor->cow.prev = FS_BLOCK_NONE;
+  m_descriptor->status.size = SIZE;
+  if((SIZE32)m_descriptor->status.position > SIZE)
+  {
+    m_descriptor->status.position = (FILE_POSITION)SIZE;
+  }
+  if(0U == M_KEEP)
+  {
+    m_header->lbi_tail = FS_BLOCK_NONE;
+  }
+  if(m_header->head > SIZE)
+  {
+    m_header->head = (U16)SIZE;
+  }
+  m_descriptor->modified = 1U;
+
+  RETURN_CODE m_sync_error = NO_ERROR;
+  FS_DESCRIPTOR_SYNC(m_descriptor, &m_sync_error);
+  if(NO_ERROR != m_sync_error)
+  {
+    *file_error
+      = (NO_ACTION == m_sync_error) ? FILE_ERROR_NO_SPACE : FILE_ERROR_IO;
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  /* 4. Намерение освобождения хвоста (FTL - после контрольной точки) */
+  RETURN_CODE m_free_error = NO_ERROR;
+  FS_BLOCK_FREE(m_tail, m_free_count, &m_free_error);
+  if(NO_ERROR == m_free_error)
+  {
+    FS_JOURNAL_COMMIT(&m_free_error);
+  }
+  if(NO_ERROR != m_free_error)
+  {
+    /* Сохраненную транзакцию без выполненного обрыва завершит буфер */
+    m_descriptor->buffer.dirty |= m_cut;
+    *file_error = FILE_ERROR_IO;
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  *return_code = NO_ERROR;
+}
+
+void FS_FILE_REMOVE(
+/* IN  */ const FILE_NAME NAME,
+/* OUT */ RETURN_CODE * return_code,
+/* OUT */ FILE_ERROR * file_error)
+{
+  FS_JOURNAL_SCOPE();
+  RETURN_CODE m_name_error = NO_ERROR;
+  FS_FILENAME_VALIDATE(NAME, &m_name_error);
+  if(NO_ERROR != m_name_error)
+  {
+    *file_error = FILE_ERROR_NAME_SIZE;
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  FILE_ID m_id;
+  RETURN_CODE m_find_error = NO_ERROR;
+  FS_FILE_FIND(NAME, &m_id, &m_find_error);
+  if(NO_ACTION == m_find_error)
+  {
+    *file_error = FILE_ERROR_NO_FILE;
+    *return_code = NO_ACTION;
+    return;
+  }
+  if(NO_ERROR != m_find_error)
+  {
+    *file_error = FILE_ERROR_IO;
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  /* 1. Открытый файл не удаляется (буферы дескрипторов ссылаются на блоки) */
+  if(0U != g_fs->file_opens[m_id])
+  {
+    *file_error = FILE_ERROR_BUSY;
+    *return_code = DEVICE_BUSY;
+    return;
+  }
+
+  FILE_HEADER_TYPE m_header;
+  RETURN_CODE m_header_error = NO_ERROR;
+  FS_FILEHEADER_READ(m_id, &m_header, &m_header_error);
+  if(NO_ERROR != m_header_error)
+  {
+    *file_error = FILE_ERROR_IO;
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  /* 2. Имя, заголовок, теги, номер файла и цепочка блоков - одна транзакция */
+  FILE_NAME m_empty_name = {0};
+  FILE_HEADER_TYPE m_empty_header = {0};
+  RETURN_CODE m_write_error = NO_ERROR;
+  FS_FILENAME_WRITE(m_id, m_empty_name, &m_write_error);
+  RETURN_CODE m_clear_error = NO_ERROR;
+  FS_FILEHEADER_WRITE(m_id, m_empty_header, &m_clear_error);
+  RETURN_CODE m_map_error = NO_ERROR;
+  FS_FILEMAP_WRITE(m_id, 0U, &m_map_error);
+  RETURN_CODE m_tag_error = NO_ERROR;
+  for(register TAG_ID t = 0U; (NO_ERROR == m_tag_error)
+      && (t < FS_TAGS_COUNT); t++)
+  {
+    if(m_header.tags[t / 8U] & (1U << (t % 8U)))
+    {
+      FS_TAGINDEX_WRITE(t, m_id, 0U, &m_tag_error);
+    }
+  }
+  RETURN_CODE m_free_error = NO_ERROR;
+  if(FILE_FLAG_INLINE & m_header.flags)
+  {
+    /* Ячейка общего блока освобождается после фиксации */
+  }
+  else if(FILE_FLAG_LOG & m_header.flags)
+  {
+    /* За последним блоком журнала - выделенный незаписанный блок */
+    FS_BLOCK_FREE(
+      m_header.lbi_start,
+      (m_header.size + FS_DATA_SIZE - 1U) / FS_DATA_SIZE + 1U, &m_free_error
+    );
+  }
+  else
+  {
+    FS_BLOCK_FREE(m_header.lbi_start, (SIZE32)UN_SET, &m_free_error);
+  }
+  RETURN_CODE m_commit_error = NO_ERROR;
+  if((NO_ERROR == m_write_error) && (NO_ERROR == m_clear_error)
+  && (NO_ERROR == m_map_error) && (NO_ERROR == m_tag_error)
+  && (NO_ERROR == m_free_error))
+  {
+    FS_JOURNAL_COMMIT(&m_commit_error);
+  }
+  if((NO_ERROR != m_write_error) || (NO_ERROR != m_clear_error)
+  || (NO_ERROR != m_map_error) || (NO_ERROR != m_tag_error)
+  || (NO_ERROR != m_free_error) || (NO_ERROR != m_commit_error))
+  {
+    *file_error = FILE_ERROR_IO;
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  /* 3. Ячейка маленького файла (сбой после фиксации - утечка ячейки) */
+  if(FILE_FLAG_INLINE & m_header.flags)
+  {
+    FS_INLINE_FREE(m_header.lbi_start, m_header.flags >> 4U, &m_free_error);
+    if(NO_ERROR == m_free_error)
+    {
+      FS_JOURNAL_COMMIT(&m_free_error);
+    }
+    if(NO_ERROR != m_free_error)
+    {
+      *file_error = FILE_ERROR_IO;
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+  }
+
+  *return_code = NO_ERROR;
+}
+
+void FS_FILE_CLONE(
+/* IN  */ const FILE_NAME SOURCE_NAME,
+/* IN  */ const FILE_NAME NEW_NAME,
+/* OUT */ RETURN_CODE * return_code,
+/* OUT */ FILE_ERROR * file_error)
+{
+  FS_DESCRIPTORS_SCOPE();
+  FS_LOCK_SCOPE(&g_fs->lock);
+  RETURN_CODE m_name_error = NO_ERROR;
+  FS_FILENAME_VALIDATE(NEW_NAME, &m_name_error);
+  if(NO_ERROR != m_name_error)
+  {
+    *file_error = FILE_ERROR_NAME_SIZE;
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  /* 1. Исходный файл должен существовать, новое имя - нет */
+  FILE_ID m_source_id;
+  RETURN_CODE m_find_error = NO_ERROR;
+  FS_FILE_FIND(SOURCE_NAME, &m_source_id, &m_find_error);
+  if(OPERATION_FAILED == m_find_error)
+  {
+    *file_error = FILE_ERROR_IO;
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+  if(NO_ERROR != m_find_error)
+  {
+    *file_error = FILE_ERROR_NO_FILE;
+    *return_code = NO_ACTION;
+    return;
+  }
+
+  FILE_ID m_id;
+  FS_FILE_FIND(NEW_NAME, &m_id, &m_find_error);
+  if(NO_ERROR == m_find_error)
+  {
+    *file_error = FILE_ERROR_EXIST;
+    *return_code = NO_ACTION;
+    return;
+  }
+  if(OPERATION_FAILED == m_find_error)
+  {
+    *file_error = FILE_ERROR_IO;
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  for(m_id = 0U; m_id < FS_FILES_COUNT; m_id++)
+  {
+    if(0U == (g_fs->file_map[m_id / 32U] & (1UL << (m_id % 32U))))
+    {
+      break;
+    }
+  }
+  if(m_id >= FS_FILES_COUNT)
+  {
+    *file_error = FILE_ERROR_NO_SPACE;
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  /* 2. Несохраненные данные исходного файла записываются во flash */
+  for(register SIZE32 i = 0U; i < FS_DESCRIPTORS_COUNT; i++)
+  {
+    FS_DESCRIPTOR_TYPE * m_descriptor = &(g_fs->descriptor_table[i]);
+    if((m_source_id != m_descriptor->id)
+    || (FILE_MODE_READ_WRITE != m_descriptor->status.mode))
+    {
+      continue;
+    }
+
+    RETURN_CODE m_sync_error = NO_ERROR;
+    FS_DESCRIPTOR_SYNC(m_descriptor, &m_sync_error);
+    if(NO_ERROR != m_sync_error)
+    {
+      *file_error
+        = (NO_ACTION == m_sync_error) ? FILE_ERROR_NO_SPACE : FILE_ERROR_IO;
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+  }
+
+  /* Дескрипторы сохранены отдельными транзакциями, копия - одной
+   * (при ошибке отменяется) */
+  FS_JOURNAL_SCOPE();
+  FILE_HEADER_TYPE m_source;
+  RETURN_CODE m_header_error = NO_ERROR;
+  FS_FILEHEADER_READ(m_source_id, &m_source, &m_header_error);
+  if(NO_ERROR != m_header_error)
+  {
+    *file_error = FILE_ERROR_IO;
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  /* Блоки журнала освобождаются с начала цепочки: копия невозможна */
+  if(FILE_FLAG_LOG & m_source.flags)
+  {
+    *file_error = FILE_ERROR_INVALID_PARAM;
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  /* 3. Заголовок копии: та же цепочка блоков, теги не копируются */
+  FILE_HEADER_TYPE m_header = m_source;
+  U8 m_inline_copy = 0U;
+  m_header.id = m_id;
+  STD_MEMSET(sizeof(TAG_BITMAP), 0x00U, m_header.tags);
+
+  if(FILE_FLAG_INLINE & m_source.flags)
+  {
+    /* Ячейка меньше заголовка цепочки: данные копируются в новую ячейку */
+    FS_DESCRIPTOR_TYPE m_copy;
+    m_copy.header = m_source;
+    RETURN_CODE m_inline_error = NO_ERROR;
+    FS_INLINE_READ(&m_copy, &m_inline_error);
+    m_copy.header.flags = 0U;
+    m_copy.header.lbi_start = FS_BLOCK_NONE;
+    if(NO_ERROR == m_inline_error)
+    {
+      FS_INLINE_WRITE(&m_copy, &m_inline_error);
+    }
+    if(NO_ERROR != m_inline_error)
+    {
+      *file_error = FILE_ERROR_IO;
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+    m_header.lbi_start = m_copy.header.lbi_start;
+    m_header.flags = m_copy.header.flags;
+    m_inline_copy = 1U;
+  }
+  else if(FS_BLOCK_NONE != m_source.lbi_start)
+  {
+    /* Первый блок получает ссылку из второго заголовка */
+    RETURN_CODE m_ref_error = NO_ERROR;
+    FS_BLOCKREF_ADD(m_source.lbi_start, 1, &m_ref_error);
+    if(NO_ACTION == m_ref_error)
+    {
+      *file_error = FILE_ERROR_NO_SPACE;
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+    if(NO_ERROR != m_ref_error)
+    {
+      *file_error = FILE_ERROR_IO;
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+
+    m_header.flags |= FILE_FLAG_SHARED;
+    if(0U == (FILE_FLAG_SHARED & m_source.flags))
+    {
+      m_source.flags |= FILE_FLAG_SHARED;
+      HASH_CRC(
+        &m_source, sizeof(FILE_HEADER_TYPE) - sizeof(U32), &(m_source.crc32)
+      );
+      FS_FILEHEADER_WRITE(m_source_id, m_source, &m_header_error);
+    }
+  }
+  HASH_CRC(
+    &m_header, sizeof(FILE_HEADER_TYPE) - sizeof(U32), &(m_header.crc32)
+  );
+
+  /* 4. Имя, заголовки, счетчик и карта фиксируются одной транзакцией */
+  RETURN_CODE m_write_error = NO_ERROR;
+  FS_FILENAME_WRITE(m_id, NEW_NAME, &m_write_error);
+  RETURN_CODE m_new_header_error = NO_ERROR;
+  FS_FILEHEADER_WRITE(m_id, m_header, &m_new_header_error);
+  RETURN_CODE m_map_error = NO_ERROR;
+  FS_FILEMAP_WRITE(m_id, 1U, &m_map_error);
+  RETURN_CODE m_commit_error = NO_ERROR;
+  if((NO_ERROR == m_header_error) && (NO_ERROR == m_new_header_error)
+  && (NO_ERROR == m_write_error) && (NO_ERROR == m_map_error))
+  {
+    FS_JOURNAL_COMMIT(&m_commit_error);
+  }
+  if((NO_ERROR != m_header_error) || (NO_ERROR != m_new_header_error)
+  || (NO_ERROR != m_write_error) || (NO_ERROR != m_map_error)
+  || (NO_ERROR != m_commit_error))
+  {
+    /* Ячейка копии записана во flash мимо журнала */
+    if(m_inline_copy)
+    {
+      RETURN_CODE m_free_error = NO_ERROR;
+      FS_INLINE_FREE(m_header.lbi_start, m_header.flags >> 4U, &m_free_error);
+    }
+    *file_error = FILE_ERROR_IO;
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  /* 5. Открытые дескрипторы исходного файла заново проверяют цепочку */
+  if(FILE_FLAG_SHARED & m_header.flags)
+  {
+    for(register SIZE32 i = 0U; i < FS_DESCRIPTORS_COUNT; i++)
+    {
+      FS_DESCRIPTOR_TYPE * m_descriptor = &(g_fs->descriptor_table[i]);
+      if(m_source_id != m_descriptor->id)
+      {
+        continue;
+      }
+      m_descriptor->header.flags |= FILE_FLAG_SHARED;
+      m_descriptor->cow.index = 0U;
+      m_descriptor->cow.prev = FS_BLOCK_NONE;
+    }
+  }
+
+  *return_code = NO_ERROR;
+}
+
+void FS_LOG_CREATE(
+/* IN  */ const FILE_NAME NAME,
+/* OUT */ RETURN_CODE * return_code,
+/* OUT */ FILE_ERROR * file_error)
+{
+  FS_FILE_NEW(NAME, FILE_FLAG_LOG, return_code, file_error);
+}
+
+void FS_LOG_APPEND(
+/* IN  */ const FILE_ID ID,
+/* IN  */ const SIZE32 LENGTH,
+/* IN  */ const VOID_PTR DATA,
+/* OUT */ RETURN_CODE * return_code,
+/* OUT */ FILE_ERROR * file_error)
+{
+  FS_DESCRIPTOR_TYPE * m_descriptor;
+  RETURN_CODE m_get_error = NO_ERROR;
+  FS_DESCRIPTOR_GET(ID, &m_descriptor, &m_get_error);
+  if(NO_ERROR != m_get_error)
+  {
+    *file_error = FILE_ERROR_DESCRIPTOR;
+    *return_code = INVALID_PARAM;
+    return;
+  }
+  FS_VOLUME_SCOPE_READ();
+  FS_LOCK_SCOPE(&(m_descriptor->lock));
+
+  if((0U == (FILE_FLAG_LOG & m_descriptor->header.flags))
+  || (FILE_FLAG_SERIES & m_descriptor->header.flags)
+  || (LENGTH > 0xFFFFU))
+  {
+    *file_error = FILE_ERROR_INVALID_PARAM;
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  /* 1. Заголовок записи: длина и CRC32 данных (big-endian) */
+  U32 m_crc;
+  HASH_CRC(DATA, LENGTH, &m_crc);
+  U8 m_record[FS_LOG_RECORD_HEADER] = {
+    (U8)(LENGTH >> 8U), (U8)(LENGTH),
+    (U8)(m_crc >> 24U), (U8)(m_crc >> 16U), (U8)(m_crc >> 8U), (U8)(m_crc)
+  };
+  const FILE_IOVEC_TYPE M_VECTOR[2U] = {
+    { .length = FS_LOG_RECORD_HEADER, .data = m_record },
+    { .length = LENGTH, .data = DATA }
+  };
+
+  /* 2. Запись в конец и фиксация размера (неполная запись отбрасывается) */
+  const FILE_POSITION M_POSITION = m_descriptor->status.position;
+  FS_FILE_WRITEV(ID, 2U, M_VECTOR, 1U, return_code, file_error);
+  if(NO_ERROR == *return_code)
+  {
+    FS_FILE_SYNC(ID, return_code, file_error);
+  }
+  m_descriptor->status.position = M_POSITION;
+}
+
+void FS_LOG_READ(
+/* IN  */ const FILE_ID ID,
+/* IN  */ const SIZE32 CAPACITY,
+/* OUT */ VOID_PTR data,
+/* OUT */ SIZE32 * out_length,
+/* OUT */ RETURN_CODE * return_code,
+/* OUT */ FILE_ERROR * file_error)
+{
+  *out_length = 0U;
+
+  FS_DESCRIPTOR_TYPE * m_descriptor;
+  RETURN_CODE m_get_error = NO_ERROR;
+  FS_DESCRIPTOR_GET(ID, &m_descriptor, &m_get_error);
+  if(NO_ERROR != m_get_error)
+  {
+    *file_error = FILE_ERROR_DESCRIPTOR;
+    *return_code = INVALID_PARAM;
+    return;
+  }
+  FS_VOLUME_SCOPE_READ();
+  FS_LOCK_SCOPE(&(m_descriptor->lock));
+
+  if((0U == (FILE_FLAG_LOG & m_descriptor->header.flags))
+  || (FILE_FLAG_SERIES & m_descriptor->header.flags))
+  {
+    *file_error = FILE_ERROR_INVALID_PARAM;
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  /* 1. Заголовок записи */
+  const FILE_POSITION M_POSITION = m_descriptor->status.position;
+  U8 m_record[FS_LOG_RECORD_HEADER];
+  SIZE32 m_length = 0U;
+  RETURN_CODE m_read_error = NO_ERROR;
+  FS_DESCRIPTOR_READ(
+    m_descriptor, FS_LOG_RECORD_HEADER, &m_length, m_record, &m_read_error
+  );
+  if((NO_ERROR == m_read_error) && (0U == m_length))
+  {
+    *return_code = NO_ACTION;
+    return;
+  }
+  if((NO_ERROR != m_read_error) || (FS_LOG_RECORD_HEADER != m_length))
+  {
+    *file_error = FILE_ERROR_IO;
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  const SIZE32 M_LENGTH = ((SIZE32)m_record[0U] << 8U) | m_record[1U];
+  const U32 M_CRC = ((U32)m_record[2U] << 24U) | ((U32)m_record[3U] << 16U)
+    | ((U32)m_record[4U] << 8U) | m_record[5U];
+  if(M_LENGTH > CAPACITY)
+  {
+    m_descriptor->status.position = M_POSITION;
+    *out_length = M_LENGTH;
+    *file_error = FILE_ERROR_NO_SPACE;
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  /* 2. Данные записи проверяются по CRC32 */
+  FS_DESCRIPTOR_READ(m_descriptor, M_LENGTH, &m_length, data, &m_read_error);
+  U32 m_crc = 0U;
+  if((NO_ERROR == m_read_error) && (M_LENGTH == m_length))
+  {
+    HASH_CRC(data, M_LENGTH, &m_crc);
+  }
+  if((NO_ERROR != m_read_error) || (M_LENGTH != m_length) || (M_CRC != m_crc))
+  {
+    *file_error = FILE_ERROR_IO;
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  *out_length = M_LENGTH;
+  *return_code = NO_ERROR;
+}
+
+void FS_LOG_TRIM(
+/* IN  */ const FILE_ID ID,
+/* OUT */ RETURN_CODE * return_code,
+/* OUT */ FILE_ERROR * file_error)
+{
+  FS_DESCRIPTOR_TYPE * m_descriptor;
+  RETURN_CODE m_get_error = NO_ERROR;
+  FS_DESCRIPTOR_GET(ID, &m_descriptor, &m_get_error);
+  if(NO_ERROR != m_get_error)
+  {
+    *file_error = FILE_ERROR_DESCRIPTOR;
+    *return_code = INVALID_PARAM;
+    return;
+  }
+  FS_VOLUME_SCOPE_READ();
+  FS_LOCK_SCOPE(&(m_descriptor->lock));
+  FS_JOURNAL_SCOPE_KEEP();
+
+  if(FILE_MODE_READ_WRITE != m_descriptor->status.mode)
+  {
+    *file_error = FILE_ERROR_PERMISSION;
+    *return_code = ACCESS_DENIED;
+    return;
+  }
+  if(0U == (FILE_FLAG_LOG & m_descriptor->header.flags))
+  {
+    *file_error = FILE_ERROR_INVALID_PARAM;
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  /* 1. Буфер во flash, отбрасываются блоки до блока позиции (последний
+   *    блок остается: он хранит LBI следующего) */
+  RETURN_CODE m_flush_error = NO_ERROR;
+  FS_BUFFER_FLUSH(m_descriptor, &m_flush_error);
+  FS_READAHEAD_RESET(m_descriptor);
+  if(NO_ERROR != m_flush_error)
+  {
+    *file_error = FILE_ERROR_IO;
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  const SIZE32 M_POSITION = (SIZE32)m_descriptor->status.position;
+  const SIZE32 M_SIZE = m_descriptor->status.size;
+  SIZE32 m_drop = M_POSITION / FS_DATA_SIZE;
+  if((0U != M_SIZE) && (m_drop > (M_SIZE - 1U) / FS_DATA_SIZE))
+  {
+    m_drop = (M_SIZE - 1U) / FS_DATA_SIZE;
+  }
+
+  /* 2. Новое начало цепочки - блок позиции */
+  FILE_HEADER_TYPE * m_header = &(m_descriptor->header);
+  const FTL_INDEX M_OLD_START = m_header->lbi_start;
+  if(0U != m_drop)
+  {
+    RETURN_CODE m_load_error = NO_ERROR;
+    FS_BUFFER_LOAD(m_descriptor, m_drop, &m_load_error);
+    if(NO_ERROR != m_load_error)
+    {
+      *file_error = FILE_ERROR_IO;
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+    m_header->lbi_start = (U16)m_descriptor->buffer.lbi;
+    m_descriptor->buffer.index = 0U;
+  }
+
+  /* 3. Новый заголовок и освобождение блоков - одна транзакция */
+  const SIZE32 M_SHIFT = m_drop * FS_DATA_SIZE;
+  m_header->head = (U16)(M_POSITION - M_SHIFT);
+  m_descriptor->status.size = M_SIZE - M_SHIFT;
+  m_descriptor->status.position = (FILE_POSITION)(M_POSITION - M_SHIFT);
+  m_descriptor->modified = 1U;
+
+  RETURN_CODE m_sync_error = NO_ERROR;
+  FS_DESCRIPTOR_SYNC(m_descriptor, &m_sync_error);
+  if(NO_ERROR != m_sync_error)
+  {
+    *file_error
+      = (NO_ACTION == m_sync_error) ? FILE_ERROR_NO_SPACE : FILE_ERROR_IO;
+    *return_code = OPERATION_FAILED;
+    return;
+  }
 
+  /* 4. Намерение освобождения отброшенных блоков (FTL - после контрольной
+   *    точки) */
+  RETURN_CODE m_free_error = NO_ERROR;
+  if(0U != m_drop)
+  {
+    FS_BLOCK_FREE(M_OLD_START, m_drop, &m_free_error);
+  }
+  if(NO_ERROR == m_free_error)
+  {
+    FS_JOURNAL_COMMIT(&m_free_error);
+  }
+  if(NO_ERROR != m_free_error)
+  {
+    *file_error = FILE_ERROR_IO;
+    *return_code = OPERATION_FAILED;
+    return;
+  }
 
+  *return_code = NO_ERROR;
+}
 
-/* ======== BLOCKNEXT ======== */
-static void FS_BLOCKNEXT_READ(
-/* IN  */ const FTL_INDEX LBI,
-/* OUT */ FTL_INDEX * next_lbi,
-/* OUT */ RETURN_CODE * return_code)
+void FS_SERIES_CREATE(
+/* IN  */ const FILE_NAME NAME,
+/* IN  */ const SIZE32 RECORD_SIZE,
+/* IN  */ const FS_SERIES_ENCODING ENCODING,
+/* OUT */ RETURN_CODE * return_code,
+/* OUT */ FILE_ERROR * file_error)
 {
-  U8 m_data[FS_BLOCK_SIZE];
-  RETURN_CODE m_read_error = NO_ERROR;
-  FTL_READ(LBI, 1U, m_data, &m_read_error);
-  if(NO_ACTION == m_read_error)
+  if((RECORD_SIZE > FS_SERIES_RECORD_SIZE)
+  || ((FS_SERIES_RAW != ENCODING) && (FS_SERIES_DELTA != ENCODING))
+  || ((FS_SERIES_DELTA == ENCODING) && (0U == RECORD_SIZE)))
   {
-    *return_code = NO_ACTION;
+    *file_error = FILE_ERROR_INVALID_PARAM;
+    *return_code = INVALID_PARAM;
     return;
   }
-  if(OPERATION_FAILED == m_read_error)
+
+  FS_FILE_NEW(
+    NAME, FILE_FLAG_LOG | FILE_FLAG_SERIES, return_code, file_error
+  );
+  if(NO_ERROR != *return_code)
   {
-    *return_code = OPERATION_FAILED;
     return;
   }
 
-  *next_lbi = (FTL_INDEX)((m_data[0] << 8U) | m_data[1]);
+  /* Первый блок - пустой заголовок с размером и кодированием записей */
+  FS_SERIES_FRAME_TYPE m_frame =
+  (FS_SERIES_FRAME_TYPE){
+    .sequence = 0U,
+    .first = 0U,
+    .last = 0U,
+    .end = (U8)sizeof(FS_SERIES_FRAME_TYPE),
+    .record_size = (U8)RECORD_SIZE,
+    .encoding = (U8)ENCODING,
+    .reserved = 0U
+  };
+  for(register SIZE32 i = 0U; i < FS_SERIES_LEVELS; i++)
+  {
+    m_frame.back[i] = FS_BLOCK_NONE;
+  }
 
-  *return_code = NO_ERROR;
+  FILE_ID m_id;
+  FS_FILE_OPEN(NAME, FILE_MODE_READ_WRITE, &m_id, return_code, file_error);
+  if(NO_ERROR != *return_code)
+  {
+    return;
+  }
+  FS_FILE_WRITE(
+    m_id, sizeof(FS_SERIES_FRAME_TYPE), &m_frame, return_code, file_error
+  );
+
+  RETURN_CODE m_close_error = NO_ERROR;
+  FILE_ERROR m_close_file_error = (FILE_ERROR)0;
+  FS_FILE_CLOSE(m_id, &m_close_error, &m_close_file_error);
+  if((NO_ERROR == *return_code) && (NO_ERROR != m_close_error))
+  {
+    *file_error = m_close_file_error;
+    *return_code = m_close_error;
+  }
 }
 
-static void FS_BLOCKNEXT_WRITE(
-/* IN  */ const FTL_INDEX LBI,
-/* IN  */ const FTL_INDEX NEXT_LBI,
-/* OUT */ RETURN_CODE * return_code)
+void FS_SERIES_APPEND(
+/* IN  */ const FILE_ID ID,
+/* IN  */ const U32 TIME,
+/* IN  */ const SIZE32 LENGTH,
+/* IN  */ const VOID_PTR DATA,
+/* OUT */ RETURN_CODE * return_code,
+/* OUT */ FILE_ERROR * file_error)
 {
-  U8 m_data[FS_BLOCK_SIZE];
-  RETURN_CODE m_read_error = NO_ERROR;
-  FTL_READ(LBI, 1U, m_data, &m_read_error);
-  if(NO_ACTION == m_read_error)
+  FS_DESCRIPTOR_TYPE * m_descriptor;
+  RETURN_CODE m_get_error = NO_ERROR;
+  FS_DESCRIPTOR_GET(ID, &m_descriptor, &m_get_error);
+  if(NO_ERROR != m_get_error)
   {
-    *return_code = NO_ACTION;
+    *file_error = FILE_ERROR_DESCRIPTOR;
+    *return_code = INVALID_PARAM;
     return;
   }
-  if(OPERATION_FAILED == m_read_error)
+  FS_VOLUME_SCOPE_READ();
+  FS_LOCK_SCOPE(&(m_descriptor->lock));
+
+  if(FILE_MODE_READ_WRITE != m_descriptor->status.mode)
+  {
+    *file_error = FILE_ERROR_PERMISSION;
+    *return_code = ACCESS_DENIED;
+    return;
+  }
+  if(0U == (FILE_FLAG_SERIES & m_descriptor->header.flags))
+  {
+    *file_error = FILE_ERROR_INVALID_PARAM;
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  /* 1. Заголовок последнего блока (записи после последней фиксации
+   *    размера отброшены) */
+  FS_BUFFER_TYPE * m_buffer = &(m_descriptor->buffer);
+  const SIZE32 M_SIZE = m_descriptor->status.size;
+  const SIZE32 M_COUNT = (M_SIZE + FS_DATA_SIZE - 1U) / FS_DATA_SIZE;
+  const SIZE32 M_START = (0U == M_COUNT) ? 0U : (M_COUNT - 1U) * FS_DATA_SIZE;
+  RETURN_CODE m_load_error = NO_ERROR;
+  if(M_SIZE - M_START < sizeof(FS_SERIES_FRAME_TYPE))
+  {
+    m_load_error = OPERATION_FAILED;
+  }
+  else
+  {
+    FS_BUFFER_LOAD(m_descriptor, M_COUNT - 1U, &m_load_error);
+  }
+  if(NO_ERROR != m_load_error)
   {
+    *file_error = FILE_ERROR_IO;
     *return_code = OPERATION_FAILED;
     return;
   }
 
-  m_data[0U] = (U8)(NEXT_LBI >> 8U);
-  m_data[1U] = (U8)(NEXT_LBI);
-  RETURN_CODE m_write_error = NO_ERROR;
-  FTL_WRITE(LBI, 1U, m_data, &m_write_error);
+  FS_SERIES_FRAME_TYPE m_frame;
+  STD_MEMCPY(sizeof(FS_SERIES_FRAME_TYPE), m_buffer->data + 2U, &m_frame);
+  m_frame.end = (U8)(M_SIZE - M_START);
+  if((TIME < m_frame.last)
+  || ((0U != m_frame.record_size) && (LENGTH != m_frame.record_size))
+  || (LENGTH > FS_SERIES_RECORD_SIZE))
+  {
+    *file_error = FILE_ERROR_INVALID_PARAM;
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  U8 m_record[FS_SERIES_RECORD_MAX];
+  SIZE32 m_length = 0U;
+  RETURN_CODE m_encode_error = NO_ERROR;
+  FS_SERIES_ENCODE(
+    &m_frame, m_buffer->data + 2U, TIME, LENGTH, DATA,
+    m_record, &m_length, &m_encode_error
+  );
+
+  /* 2. Запись не помещается: остаток блока пропускается, новый блок
+   *    начинается заголовком. Ссылка уровня j переходит на последний блок,
+   *    если его номер кратен 4^j */
+  const FILE_POSITION M_POSITION = m_descriptor->status.position;
+  RETURN_CODE m_write_error = m_encode_error;
+  if((NO_ERROR == m_write_error) && (m_frame.end + m_length > FS_DATA_SIZE))
+  {
+    const U32 M_PREVIOUS = m_frame.sequence;
+    U32 m_step = 1U;
+    for(register SIZE32 i = 0U; i < FS_SERIES_LEVELS; i++)
+    {
+      if(0U == M_PREVIOUS % m_step)
+      {
+        m_frame.back[i] = (U16)m_buffer->lbi;
+      }
+      m_step *= 4U;
+    }
+    m_frame.sequence = M_PREVIOUS + 1U;
+    m_frame.first = TIME;
+    m_frame.end = (U8)sizeof(FS_SERIES_FRAME_TYPE);
+
+    m_descriptor->status.size = M_COUNT * FS_DATA_SIZE;
+    m_descriptor->status.position = (FILE_POSITION)(M_COUNT * FS_DATA_SIZE);
+    m_descriptor->modified = 1U;
+    FS_DESCRIPTOR_WRITE(
+      m_descriptor, sizeof(FS_SERIES_FRAME_TYPE), &m_frame, &m_write_error
+    );
+    if(NO_ERROR == m_write_error)
+    {
+      FS_SERIES_ENCODE(
+        &m_frame, m_buffer->data + 2U, TIME, LENGTH, DATA,
+        m_record, &m_length, &m_write_error
+      );
+    }
+  }
+
+  /* 3. Запись и обновленный заголовок - в буфер последнего блока */
+  if(NO_ERROR == m_write_error)
+  {
+    if(sizeof(FS_SERIES_FRAME_TYPE) == m_frame.end)
+    {
+      m_frame.first = TIME;
+    }
+    m_frame.last = TIME;
+    m_descriptor->status.position
+      = (FILE_POSITION)m_descriptor->status.size;
+    FS_DESCRIPTOR_WRITE(m_descriptor, m_length, m_record, &m_write_error);
+  }
+  if(NO_ERROR == m_write_error)
+  {
+    m_frame.end = (U8)(m_frame.end + m_length);
+    STD_MEMCPY(sizeof(FS_SERIES_FRAME_TYPE), &m_frame, m_buffer->data + 2U);
+    m_buffer->dirty = 1U;
+  }
+  m_descriptor->status.position = M_POSITION;
   if(NO_ERROR != m_write_error)
   {
+    *file_error = FILE_ERROR_IO;
     *return_code = OPERATION_FAILED;
     return;
   }
 
   *return_code = NO_ERROR;
 }
-/* ======== BLOCKNEXT ======== */
 
+void FS_SERIES_SEEK(
+/* IN  */ const FILE_ID ID,
+/* IN  */ const U32 FROM,
+/* OUT */ RETURN_CODE * return_code,
+/* OUT */ FILE_ERROR * file_error)
+{
+  FS_DESCRIPTOR_TYPE * m_descriptor;
+  RETURN_CODE m_get_error = NO_ERROR;
+  FS_DESCRIPTOR_GET(ID, &m_descriptor, &m_get_error);
+  if(NO_ERROR != m_get_error)
+  {
+    *file_error = FILE_ERROR_DESCRIPTOR;
+    *return_code = INVALID_PARAM;
+    return;
+  }
+  FS_VOLUME_SCOPE_READ();
+  FS_LOCK_SCOPE(&(m_descriptor->lock));
 
+  if(0U == (FILE_FLAG_SERIES & m_descriptor->header.flags))
+  {
+    *file_error = FILE_ERROR_INVALID_PARAM;
+    *return_code = INVALID_PARAM;
+    return;
+  }
 
-/* ======== BLOCKFLAG ======== */
-static void FS_BLOCKFLAG_READ(
-/* IN  */ const FTL_INDEX LBI,
-/* OUT */ BLOCK_FLAG * flag,
-/* OUT */ RETURN_CODE * return_code)
-{
-  /* TODO */
-}
+  const SIZE32 M_SIZE = m_descriptor->status.size;
+  const SIZE32 M_COUNT = (M_SIZE + FS_DATA_SIZE - 1U) / FS_DATA_SIZE;
+  if(0U == M_COUNT)
+  {
+    *return_code = NO_ERROR;
+    return;
+  }
 
-static void FS_BLOCKFLAG_WRITE(
-/* IN  */ const FTL_INDEX LBI,
-/* IN  */ const BLOCK_FLAG FLAG,
-/* OUT */ RETURN_CODE * return_code)
-{
-  SIZE32 m_index = LBI / 4U;
-  U8 m_shift = (LBI % 4U) * 2U;
-  U8 m_mask = 0x03U << m_shift;
+  /* 1. Поиск начинается с последнего блока (в буфере или по lbi_tail) */
+  FS_BUFFER_TYPE * m_buffer = &(m_descriptor->buffer);
+  RETURN_CODE m_read_error = NO_ERROR;
+  FS_BUFFER_LOAD(m_descriptor, M_COUNT - 1U, &m_read_error);
+  if(NO_ERROR != m_read_error)
+  {
+    *file_error = FILE_ERROR_IO;
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+  FS_SERIES_FRAME_TYPE m_frame;
+  STD_MEMCPY(sizeof(FS_SERIES_FRAME_TYPE), m_buffer->data + 2U, &m_frame);
+  FTL_INDEX m_lbi = m_buffer->lbi;
+  const U32 M_FIRST = m_frame.sequence - (M_COUNT - 1U);
+
+  /* 2. Спуск по уровням индекса: текущий блок начинается не раньше FROM
+   *    (записи со временем FROM могут быть и в конце предыдущего блока),
+   *    переход на блок уровня выполняется, пока он тоже не раньше FROM.
+   *    На нижнем уровне - переход на предыдущий блок, начатый раньше FROM */
+  U8 m_block[FS_BLOCK_SIZE];
+  FTL_INDEX m_block_lbi = (FTL_INDEX)UN_SET;
+  for(register SIZE32 i = FS_SERIES_LEVELS;
+      (i > 0U) && (m_frame.first >= FROM); i--)
+  {
+    const U32 M_STEP = 1UL << (2U * (i - 1U));
+    while(m_frame.sequence > M_FIRST)
+    {
+      /* Блоки до начала ряда отброшены, их LBI могли быть переданы */
+      const U32 M_TARGET = ((m_frame.sequence - 1U) / M_STEP) * M_STEP;
+      if(M_TARGET < M_FIRST)
+      {
+        break;
+      }
+
+      const FTL_INDEX M_LBI = m_frame.back[i - 1U];
+      FS_SERIES_FRAME_TYPE m_target;
+      FTL_READ(M_LBI, 1U, m_block, &m_read_error);
+      m_block_lbi = M_LBI;
+      STD_MEMCPY(sizeof(FS_SERIES_FRAME_TYPE), m_block + 2U, &m_target);
+      if((NO_ERROR != m_read_error) || (M_TARGET != m_target.sequence))
+      {
+        *file_error = FILE_ERROR_IO;
+        *return_code = OPERATION_FAILED;
+        return;
+      }
 
-  g_fs_block_flags[m_index] &= ~m_mask;
-  g_fs_block_flags[m_index] |= (FLAG << m_shift);
+      const U8 M_BEFORE = (m_target.first < FROM);
+      if(M_BEFORE && (1U != i))
+      {
+        break;
+      }
+      m_frame = m_target;
+      m_lbi = M_LBI;
+      if(M_BEFORE)
+      {
+        break;
+      }
+    }
+  }
 
-  RETURN_CODE m_bitmap_error = NO_ERROR;
-  for(register U8 i = 0U; i < 4U; i++)
+  /* 3. Найденный блок - в буфер дескриптора */
+  const SIZE32 M_INDEX = m_frame.sequence - M_FIRST;
+  if((m_lbi != m_buffer->lbi) || (M_INDEX != m_buffer->index))
   {
-    FTL_WRITE(1U + i, 1U, g_fs_block_flags + i * FS_BLOCK_SIZE, return_code);
-    if(*return_code != NO_ERROR)
+    if(m_lbi != m_block_lbi)
+    {
+      FTL_READ(m_lbi, 1U, m_block, &m_read_error);
+    }
+    if(NO_ERROR == m_read_error)
+    {
+      FS_BUFFER_PLACE(m_descriptor, m_lbi, M_INDEX, m_block, &m_read_error);
+    }
+    if(NO_ERROR != m_read_error)
     {
+      *file_error = FILE_ERROR_IO;
       *return_code = OPERATION_FAILED;
       return;
     }
   }
 
-  *return_code = NO_ERROR;
-}
-/* ======== BLOCKFLAG ======== */
-
-
-
-/* ======== TAGNAME ======== */
-static void FS_TAGNAME_READ(
-/* IN  */ const TAG_ID ID,
-/* OUT */ TAG_NAME name,
-/* OUT */ RETURN_CODE * return_code)
-{
-
-}
-
-static void FS_TAGNAME_WRITE(
-/* IN  */ const TAG_ID ID,
-/* IN  */ const TAG_NAME NAME,
-/* OUT */ RETURN_CODE * return_code)
-{
-  for(register SIZE32 i = 0U; i < 4U; i++)
+  /* 4. Пропуск записей блока раньше FROM */
+  const U8 * M_DATA = m_buffer->data + 2U;
+  SIZE32 m_limit = M_SIZE - M_INDEX * FS_DATA_SIZE;
+  if(m_limit > m_frame.end)
   {
-    RETURN_CODE m_write_error = NO_ERROR;
-    FTL_WRITE(6U + i, 1U, g_fs_tag_names + i * FS_BLOCK_SIZE, &m_write_error);
-    if(NO_ERROR != m_write_error)
+    m_limit = m_frame.end;
+  }
+  SIZE32 m_offset = sizeof(FS_SERIES_FRAME_TYPE);
+  while(m_offset < m_limit)
+  {
+    U32 m_time;
+    SIZE32 m_length;
+    SIZE32 m_payload;
+    SIZE32 m_next;
+    RETURN_CODE m_decode_error = NO_ERROR;
+    FS_SERIES_DECODE(
+      &m_frame, M_DATA, m_offset, m_limit,
+      &m_time, &m_length, &m_payload, &m_next, &m_decode_error
+    );
+    if(NO_ERROR != m_decode_error)
     {
+      *file_error = FILE_ERROR_IO;
       *return_code = OPERATION_FAILED;
       return;
     }
+    if(m_time >= FROM)
+    {
+      break;
+    }
+    m_offset = m_next;
   }
-}
-/* ======== TAGNAME ======== */
-
 
+  /* Отброшенные записи первого блока не возвращаются */
+  FILE_POSITION m_position
+    = (FILE_POSITION)(M_INDEX * FS_DATA_SIZE + m_offset);
+  if(m_position < (FILE_POSITION)m_descriptor->header.head)
+  {
+    m_position = (FILE_POSITION)m_descriptor->header.head;
+  }
+  m_descriptor->status.position = m_position;
+  *return_code = NO_ERROR;
+}
 
-/* ======== FILENAME ======== */
-static void FS_FILENAME_READ(
+void FS_SERIES_READ(
 /* IN  */ const FILE_ID ID,
-/* OUT */ FILE_NAME name,
-/* OUT */ RETURN_CODE * return_code)
+/* IN  */ const U32 TO,
+/* IN  */ const SIZE32 CAPACITY,
+/* OUT */ U32 * time,
+/* OUT */ VOID_PTR data,
+/* OUT */ SIZE32 * out_length,
+/* OUT */ RETURN_CODE * return_code,
+/* OUT */ FILE_ERROR * file_error)
 {
-  if(ID >= FS_FILES_COUNT)
+  *out_length = 0U;
+
+  FS_DESCRIPTOR_TYPE * m_descriptor;
+  RETURN_CODE m_get_error = NO_ERROR;
+  FS_DESCRIPTOR_GET(ID, &m_descriptor, &m_get_error);
+  if(NO_ERROR != m_get_error)
   {
+    *file_error = FILE_ERROR_DESCRIPTOR;
     *return_code = INVALID_PARAM;
     return;
   }
+  FS_VOLUME_SCOPE_READ();
+  FS_LOCK_SCOPE(&(m_descriptor->lock));
 
-  SIZE32 m_block_id = 10U + ID / 5U;
-  SIZE32 m_offset = (ID % 5U) * FILE_NAME_SIZE;
+  if(0U == (FILE_FLAG_SERIES & m_descriptor->header.flags))
+  {
+    *file_error = FILE_ERROR_INVALID_PARAM;
+    *return_code = INVALID_PARAM;
+    return;
+  }
 
-  U8 m_data[FS_BLOCK_SIZE];
-  RETURN_CODE m_read_error = NO_ERROR;
-  FTL_READ(m_block_id, 1U, m_data, &m_read_error);
-  if(OPERATION_FAILED == m_read_error)
+  /* 1. Блок позиции: за концом записей блока - следующий блок */
+  FS_BUFFER_TYPE * m_buffer = &(m_descriptor->buffer);
+  const SIZE32 M_SIZE = m_descriptor->status.size;
+  FS_SERIES_FRAME_TYPE m_frame;
+  SIZE32 m_index;
+  SIZE32 m_offset;
+  SIZE32 m_limit;
+  for(;;)
+  {
+    const SIZE32 M_POSITION = (SIZE32)m_descriptor->status.position;
+    if(M_POSITION >= M_SIZE)
+    {
+      *return_code = NO_ACTION;
+      return;
+    }
+    m_index = M_POSITION / FS_DATA_SIZE;
+    m_offset = M_POSITION % FS_DATA_SIZE;
+
+    RETURN_CODE m_load_error = NO_ERROR;
+    FS_BUFFER_LOAD(m_descriptor, m_index, &m_load_error);
+    if(NO_ERROR != m_load_error)
+    {
+      *file_error = FILE_ERROR_IO;
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+    STD_MEMCPY(sizeof(FS_SERIES_FRAME_TYPE), m_buffer->data + 2U, &m_frame);
+
+    m_limit = M_SIZE - m_index * FS_DATA_SIZE;
+    if(m_limit > m_frame.end)
+    {
+      m_limit = m_frame.end;
+    }
+    if(m_offset < sizeof(FS_SERIES_FRAME_TYPE))
+    {
+      m_offset = sizeof(FS_SERIES_FRAME_TYPE);
+    }
+    if(m_offset < m_limit)
+    {
+      break;
+    }
+
+    SIZE32 m_next = (m_index + 1U) * FS_DATA_SIZE;
+    if(m_next > M_SIZE)
+    {
+      m_next = M_SIZE;
+    }
+    m_descriptor->status.position = (FILE_POSITION)m_next;
+  }
+
+  /* 2. Запись позже TO остается следующей */
+  const U8 * M_DATA = m_buffer->data + 2U;
+  U32 m_time;
+  SIZE32 m_length;
+  SIZE32 m_payload;
+  SIZE32 m_next;
+  RETURN_CODE m_decode_error = NO_ERROR;
+  FS_SERIES_DECODE(
+    &m_frame, M_DATA, m_offset, m_limit,
+    &m_time, &m_length, &m_payload, &m_next, &m_decode_error
+  );
+  if(NO_ERROR != m_decode_error)
   {
+    *file_error = FILE_ERROR_IO;
     *return_code = OPERATION_FAILED;
     return;
   }
-  if(NO_ACTION == m_read_error)
+  if(m_time > TO)
   {
+    m_descriptor->status.position
+      = (FILE_POSITION)(m_index * FS_DATA_SIZE + m_offset);
     *return_code = NO_ACTION;
     return;
   }
+  if(m_length > CAPACITY)
+  {
+    *out_length = m_length;
+    *file_error = FILE_ERROR_NO_SPACE;
+    *return_code = INVALID_PARAM;
+    return;
+  }
 
-  STD_MEMCPY(FILE_NAME_SIZE, m_data + m_offset, name);
+  /* 3. Данные (разность восстанавливается по первой записи блока) */
+  U8 * m_data = (U8 *)data;
+  if((FS_SERIES_DELTA == m_frame.encoding)
+  && (sizeof(FS_SERIES_FRAME_TYPE) != m_offset))
+  {
+    U32 m_base_time;
+    SIZE32 m_base_length;
+    SIZE32 m_base;
+    SIZE32 m_base_next;
+    FS_SERIES_DECODE(
+      &m_frame, M_DATA, sizeof(FS_SERIES_FRAME_TYPE), m_limit,
+      &m_base_time, &m_base_length, &m_base, &m_base_next, &m_decode_error
+    );
+    if((NO_ERROR != m_decode_error) || (m_base_length != m_length))
+    {
+      *file_error = FILE_ERROR_IO;
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+    for(register SIZE32 i = 0U; i < m_length; i++)
+    {
+      m_data[i] = (U8)(M_DATA[m_payload + i] + M_DATA[m_base + i]);
+    }
+  }
+  else
+  {
+    STD_MEMCPY(m_length, m_buffer->data + 2U + m_payload, m_data);
+  }
 
+  m_descriptor->status.position
+    = (FILE_POSITION)(m_index * FS_DATA_SIZE + m_next);
+  *time = m_time;
+  *out_length = m_length;
   *return_code = NO_ERROR;
 }
 
-static void FS_FILENAME_WRITE(
+void FS_FILE_STATUS(
 /* IN  */ const FILE_ID ID,
+/* OUT */ FILE_STATUS_TYPE * status,
+/* OUT */ RETURN_CODE * return_code,
+/* OUT */ FILE_ERROR * file_error)
+{
+  FS_DESCRIPTOR_TYPE * m_descriptor;
+  RETURN_CODE m_get_error = NO_ERROR;
+  FS_DESCRIPTOR_GET(ID, &m_descriptor, &m_get_error);
+  if(NO_ERROR != m_get_error)
+  {
+    *file_error = FILE_ERROR_DESCRIPTOR;
+    *return_code = INVALID_PARAM;
+    return;
+  }
+  FS_VOLUME_SCOPE_READ();
+  FS_LOCK_SCOPE(&(m_descriptor->lock));
+
+  *status = m_descriptor->status;
+  *return_code = NO_ERROR;
+}
+
+
+
+void FS_TAG_ADD(
+/* IN  */ const FILE_NAME NAME,
+/* IN  */ const TAG_NAME TAG,
+/* IN  */ RETURN_CODE * return_code)
+{
+  FS_DESCRIPTORS_SCOPE();
+  FS_LOCK_SCOPE(&g_fs->lock);
+  FS_TAG_SET(NAME, TAG, 1U, return_code);
+}
+
+void FS_TAG_REMOVE(
 /* IN  */ const FILE_NAME NAME,
+/* IN  */ const TAG_NAME TAG,
 /* OUT */ RETURN_CODE * return_code)
 {
-  if(ID >= FS_FILES_COUNT)
+  FS_DESCRIPTORS_SCOPE();
+  FS_LOCK_SCOPE(&g_fs->lock);
+  FS_TAG_SET(NAME, TAG, 0U, return_code);
+}
+
+void FS_TAG_RENAME(
+/* IN  */ const TAG_NAME OLD_NAME,
+/* IN  */ const TAG_NAME NEW_NAME,
+/* OUT */ RETURN_CODE * return_code)
+{
+  FS_JOURNAL_SCOPE();
+  TAG_ID m_tag;
+  RETURN_CODE m_find_error = NO_ERROR;
+  FS_TAG_FIND(OLD_NAME, &m_tag, &m_find_error);
+  if(NO_ERROR != m_find_error)
   {
-    *return_code = INVALID_PARAM;
+    *return_code = m_find_error;
     return;
   }
 
-  SIZE32 m_block_id = 10U + ID / 5U;
-  SIZE32 m_offset = (ID % 5U) * FILE_NAME_SIZE;
-
-  U8 m_data[FS_BLOCK_SIZE];
-  RETURN_CODE m_read_error = NO_ERROR;
-  FTL_READ(m_block_id, 1U, m_data, &m_read_error);
-  if(OPERATION_FAILED == m_read_error)
+  TAG_ID m_existing;
+  FS_TAG_FIND(NEW_NAME, &m_existing, &m_find_error);
+  if(NO_ACTION != m_find_error)
   {
-    *return_code = OPERATION_FAILED;
+    *return_code = (NO_ERROR == m_find_error) ? NO_ACTION : m_find_error;
     return;
   }
 
-  STD_MEMCPY(FILE_NAME_SIZE, (CHAR *)NAME, m_data + m_offset);
   RETURN_CODE m_write_error = NO_ERROR;
-  FTL_WRITE(m_block_id, 1U, m_data, &m_write_error);
+  FS_TAGNAME_WRITE(m_tag, NEW_NAME, &m_write_error);
   if(NO_ERROR != m_write_error)
   {
     *return_code = OPERATION_FAILED;
     return;
   }
 
-  *return_code = NO_ERROR;
+  FS_JOURNAL_COMMIT(return_code);
 }
-/* ======== FILENAME ======== */
-
-
 
-/* ======== FILEHEADER ======== */
-static void FS_FILEHEADER_READ(
-/* IN  */ const FILE_ID ID,
-/* OUT */ FILE_HEADER_TYPE * header,
+void FS_TAG_SEARCH(
+/* IN  */ const TAG_QUERY_TYPE * QUERY,
+/* IN  */ const SIZE32 QUERY_LENGTH,
+/* IN  */ const SIZE32 IDS_SIZE,
+/* OUT */ FILE_ID * ids,
+/* OUT */ SIZE32 * count,
 /* OUT */ RETURN_CODE * return_code)
 {
-  if(ID >= FS_FILES_COUNT)
-  {
-    *return_code = INVALID_PARAM;
-    return;
-  }
-
-  SIZE32 m_block_id = 410U + ID / 10U;
-  SIZE32 m_offset = (ID % 10U) * sizeof(FILE_HEADER_TYPE);
+  FS_LOCK_SCOPE(&g_fs->lock);
+  *count = 0U;
 
-  U8 m_data[FS_BLOCK_SIZE];
-  RETURN_CODE m_read_error = NO_ERROR;
-  FTL_READ(m_block_id, 1U, m_data, &m_read_error);
-  if(OPERATION_FAILED == m_read_error)
+  RETURN_CODE m_eval_error = NO_ERROR;
+  FS_TAG_EVALUATE(QUERY, QUERY_LENGTH, &m_eval_error);
+  if(NO_ERROR != m_eval_error)
   {
-    *return_code = OPERATION_FAILED;
+    *return_code = m_eval_error;
     return;
   }
-  if(NO_ACTION == m_read_error)
+
+  /* Перечисление установленных битов */
+  const U32 * M_RESULT = g_fs->tag_stack[0U];
+  for(register SIZE32 w = 0U; w < FS_FILES_WORDS; w++)
   {
-    *return_code = NO_ACTION;
-    return;
+    U32 m_word = M_RESULT[w];
+    for(register SIZE32 b = 0U; 0U != m_word; b++, m_word >>= 1U)
+    {
+      if(0U == (m_word & 1U))
+      {
+        continue;
+      }
+      if(*count < IDS_SIZE)
+      {
+        ids[*count] = (FILE_ID)(w * 32U + b);
+      }
+      (*count)++;
+    }
   }
 
-  STD_MEMCPY(sizeof(FILE_HEADER_TYPE), m_data + m_offset, header);
+  *return_code = NO_ERROR;
 }
 
-static void FS_FILEHEADER_WRITE(
-/* IN  */ const FILE_ID ID,
-/* IN  */ const FILE_HEADER_TYPE HEADER,
+
+void FS_FILE_ITERATE_BEGIN(
+/* IN  */ const CHAR * PREFIX,
+/* IN  */ const TAG_QUERY_TYPE * QUERY,
+/* IN  */ const SIZE32 QUERY_LENGTH,
+/* OUT */ FILE_CURSOR_TYPE * cursor,
 /* OUT */ RETURN_CODE * return_code)
 {
-  if(ID >= FS_FILES_COUNT)
+  FS_LOCK_SCOPE(&g_fs->lock);
+  SIZE32 m_prefix_length = 0U;
+  while((m_prefix_length < FILE_NAME_SIZE) && ('\0' != PREFIX[m_prefix_length]))
   {
-    *return_code = INVALID_PARAM;
-    return;
+    m_prefix_length++;
   }
-
-  SIZE32 m_block_id = 410U + ID / 10U;
-  SIZE32 m_offset = (ID % 10U) * sizeof(FILE_HEADER_TYPE);
-
-  U8 m_data[FS_BLOCK_SIZE];
-  RETURN_CODE m_read_error = NO_ERROR;
-  FTL_READ(m_block_id, 1U, m_data, &m_read_error);
-  if(OPERATION_FAILED == m_read_error)
+  if(FILE_NAME_SIZE == m_prefix_length)
   {
-    *return_code = OPERATION_FAILED;
+    *return_code = INVALID_PARAM;
     return;
   }
 
-  STD_MEMCPY(sizeof(FILE_HEADER_TYPE), (VOID_PTR)&HEADER, m_data + m_offset);
-  RETURN_CODE m_write_error = NO_ERROR;
-  FTL_WRITE(m_block_id, 1U, m_data, &m_write_error);
-  if(NO_ERROR != m_write_error)
+  /* Проверка выражения (результат не сохраняется) */
+  RETURN_CODE m_eval_error = NO_ERROR;
+  FS_TAG_EVALUATE(QUERY, QUERY_LENGTH, &m_eval_error);
+  if(NO_ERROR != m_eval_error)
   {
-    *return_code = OPERATION_FAILED;
+    *return_code = m_eval_error;
     return;
   }
 
+  cursor->next = 0U;
+  cursor->prefix = PREFIX;
+  cursor->prefix_length = m_prefix_length;
+  cursor->query = QUERY;
+  cursor->query_length = QUERY_LENGTH;
+
   *return_code = NO_ERROR;
 }
-/* ======== FILEHEADER ======== */
-
 
-
-/* ======== FILE ======== */
-static void FS_FILE_FIND(
-/* IN  */ const FILE_NAME NAME,
-/* OUT */ FILE_ID * id,
-/* OUT */ RETURN_CODE * return_code)
+void FS_FILE_ITERATE(
+/* INOUT */ FILE_CURSOR_TYPE * cursor,
+/* IN    */ const SIZE32 ENTRIES_SIZE,
+/* OUT   */ FILE_ENTRY_TYPE * entries,
+/* OUT   */ SIZE32 * count,
+/* OUT   */ RETURN_CODE * return_code)
 {
-  FILE_NAME m_current_name;
+  FS_DESCRIPTORS_SCOPE();
+  FS_LOCK_SCOPE(&g_fs->lock);
+  *count = 0U;
+
+  /* 1. Кандидаты по тегам (выражение проверено в FS_FILE_ITERATE_BEGIN) */
+  RETURN_CODE m_eval_error = NO_ERROR;
+  FS_TAG_EVALUATE(cursor->query, cursor->query_length, &m_eval_error);
+  if(NO_ERROR != m_eval_error)
+  {
+    *return_code = m_eval_error;
+    return;
+  }
+  const U32 * M_CANDIDATES = g_fs->tag_stack[0U];
 
-  for(register FILE_ID i = 0U; i < FS_FILES_COUNT; i++)
+  /* 2. Обход кандидатов; каждый блок имен и заголовков читается один раз */
+  U8 m_names[FS_BLOCK_SIZE];
+  U8 m_headers[FS_BLOCK_SIZE];
+  FTL_INDEX m_names_lbi = (FTL_INDEX)UN_SET;
+  FTL_INDEX m_headers_lbi = (FTL_INDEX)UN_SET;
+
+  SIZE32 m_id = cursor->next;
+  while((m_id < FS_FILES_COUNT) && (*count < ENTRIES_SIZE))
   {
-    RETURN_CODE m_read_error = NO_ERROR;
-    FS_FILENAME_READ(i, m_current_name, &m_read_error);
-    if(OPERATION_FAILED == m_read_error)
+    const U32 M_WORD = M_CANDIDATES[m_id / 32U] & g_fs->file_map[m_id / 32U];
+    if(0U == (M_WORD >> (m_id % 32U)))
     {
-      *return_code = OPERATION_FAILED;
-      return;
+      /* В оставшейся части слова кандидатов нет */
+      m_id = (m_id / 32U + 1U) * 32U;
+      continue;
     }
-    if(NO_ACTION == m_read_error)
+    if(0U == (M_WORD & (1UL << (m_id % 32U))))
     {
+      m_id++;
       continue;
     }
 
-    I32 m_cmp_result;
-    STD_STRCMP(m_current_name, NAME, &m_cmp_result);
-    if(m_cmp_result == 0L)
+    U8 * m_image;
+    SIZE32 m_size;
+    RETURN_CODE m_read_error = NO_ERROR;
+    if(m_names_lbi != 10U + m_id / 5U)
     {
-      *id = i;
-      *return_code = NO_ERROR;
-      return;
+      m_names_lbi = 10U + m_id / 5U;
+      FS_META_IMAGE(m_names_lbi, &m_image, &m_size, &m_read_error);
+      if(NO_ERROR != m_read_error)
+      {
+        *return_code = OPERATION_FAILED;
+        return;
+      }
+      STD_MEMCPY(FS_BLOCK_SIZE, m_image, m_names);
     }
-  }
-
-  *id = (FILE_ID)UN_SET;
-  *return_code = NO_ACTION;
-}
-/* ======== FILE ======== */
-
-
-
-
-
-/*
- * ФОРМАТИРОВАНИЕ ФС
- */
-static void FS_FORMAT(
-/* OUT */ RETURN_CODE * return_code)
-{
-  g_fs_superblock.magic = FS_MAGIC;
 
-  /* Инициализация битовой карты блоков */
-  for(register FTL_INDEX m_lbi = 0U; m_lbi < 610U; m_lbi++)
-  {
-    RETURN_CODE m_blockflag_error = NO_ERROR;
-    FS_BLOCKFLAG_WRITE(m_lbi, BLOCK_FLAG_SYSTEM, &m_blockflag_error);
-    if(NO_ERROR != m_blockflag_error)
+    const CHAR * M_NAME = (const CHAR *)(m_names + (m_id % 5U) * FILE_NAME_SIZE);
+    SIZE32 m_matched = 0U;
+    while((m_matched < cursor->prefix_length)
+    && (M_NAME[m_matched] == cursor->prefix[m_matched]))
     {
-      *return_code = OPERATION_FAILED;
-      return;
+      m_matched++;
     }
-  }
-  for(register FTL_INDEX m_lbi = 610U; m_lbi < FS_BLOCKS_COUNT; m_lbi++)
-  {
-    RETURN_CODE m_blockflag_error = NO_ERROR;
-    FS_BLOCKFLAG_WRITE(m_lbi, BLOCK_FLAG_FREE, &m_blockflag_error);
-    if(NO_ERROR != m_blockflag_error)
+    if(m_matched != cursor->prefix_length)
     {
-      *return_code = OPERATION_FAILED;
-      return;
+      m_id++;
+      continue;
     }
-  }
 
-  /* Инициализация имен тегов */
-  TAG_NAME m_tag_empty = {0};
-  for(register TAG_ID m_tag_id = 0U; m_tag_id < FS_TAGS_COUNT; m_tag_id++)
-  {
-    RETURN_CODE m_tag_error = NO_ERROR;
-    FS_TAGNAME_WRITE(m_tag_id, m_tag_empty, &m_tag_error);
-    if(NO_ERROR != m_tag_error)
+    if(m_headers_lbi != 410U + m_id / 10U)
     {
-      *return_code = OPERATION_FAILED;
-      return;
+      m_headers_lbi = 410U + m_id / 10U;
+      FS_META_IMAGE(m_headers_lbi, &m_image, &m_size, &m_read_error);
+      if(NO_ERROR != m_read_error)
+      {
+        *return_code = OPERATION_FAILED;
+        return;
+      }
+      STD_MEMCPY(FS_BLOCK_SIZE, m_image, m_headers);
     }
-  }
 
-  /* Очистка имен файлов */
-  FILE_NAME m_empty_name = {0};
-  for(register FILE_ID i = 0U; i < FS_FILES_COUNT; i++)
-  {
-    RETURN_CODE m_filename_error = NO_ERROR;
-    FS_FILENAME_WRITE(i, m_empty_name, &m_filename_error);
-    if(NO_ERROR != m_filename_error)
+    FILE_HEADER_TYPE m_header;
+    STD_MEMCPY(
+      sizeof(FILE_HEADER_TYPE),
+      m_headers + (m_id % 10U) * sizeof(FILE_HEADER_TYPE),
+      &m_header
+    );
+
+    FILE_ENTRY_TYPE * m_entry = &(entries[*count]);
+    STD_MEMCPY(FILE_NAME_SIZE, (VOID_PTR)M_NAME, m_entry->name);
+    m_entry->size = m_header.size;
+    STD_MEMCPY(sizeof(TAG_BITMAP), m_header.tags, m_entry->tags);
+
+    /* Размер открытого на запись файла еще не сохранен во flash */
+    for(register SIZE32 i = 0U;
+        (FS_OPEN_WRITER == g_fs->file_opens[m_id])
+        && (i < FS_DESCRIPTORS_COUNT);
+        i++)
     {
-      *return_code = OPERATION_FAILED;
-      return;
+      if((m_id == g_fs->descriptor_table[i].id)
+      && (FILE_MODE_READ_WRITE == g_fs->descriptor_table[i].status.mode))
+      {
+        m_entry->size = g_fs->descriptor_table[i].status.size;
+      }
     }
-  }
-  RETURN_CODE m_gb_error = NO_ERROR;
-  FTL_GARBAGE_COLLECT(&m_gb_error);
-  /* TODO */
 
-  /* Очистка заголовков файлов */
-  FILE_HEADER_TYPE m_empty_header = {0};
-  for(register FILE_ID i = 0U; i < FS_FILES_COUNT; i++)
-  {
-    RETURN_CODE m_write_error = NO_ERROR;
-    FS_FILEHEADER_WRITE(i, m_empty_header, &m_write_error);
-    if(NO_ERROR != m_write_error)
-    {
-      *return_code = OPERATION_FAILED;
-      return;
-    }
+    (*count)++;
+    m_id++;
   }
-  FTL_GARBAGE_COLLECT(&m_gb_error);
-  /* TODO */
 
-  *return_code = NO_ERROR;
+  cursor->next = (FILE_ID)((m_id < FS_FILES_COUNT) ? m_id : FS_FILES_COUNT);
+  *return_code = (0U == *count) ? NO_ACTION : NO_ERROR;
 }
 
 
-
-/*
- * ИНИЦИАЛИЗАЦИЯ ФС
- */
-void FS_INIT(RETURN_CODE* return_code)
+void FS_SNAPSHOT_CREATE(
+/* OUT */ SNAPSHOT_ID * id,
+/* OUT */ RETURN_CODE * return_code)
 {
-  RETURN_CODE m_ftl_init_error = NO_ERROR;
-  FTL_INIT(&m_ftl_init_error);
-  if(NO_ERROR != m_ftl_init_error)
+  FS_DESCRIPTORS_SCOPE();
+  FS_LOCK_SCOPE(&g_fs->lock);
+  /* 1. Данные открытых файлов и журнал должны попасть во flash */
+  for(register SIZE32 i = 0U; i < FS_DESCRIPTORS_COUNT; i++)
   {
-    *return_code = OPERATION_FAILED;
-    return;
-  }
-
-  U8 m_data[6] = {'B', 'M', 'S', 'T', 'U', '\0'};
-
-  RETURN_CODE m_name_error = NO_ERROR;
-  FILE_NAME m_name = {'B', 'M', 'S', 'T', 'U', '\0'};
-  FS_FILENAME_WRITE(10, m_name, &m_name_error);
-
-  RETURN_CODE m_write_error = NO_ERROR;
-  FILE_HEADER_TYPE m_header =
-  (FILE_HEADER_TYPE){
-    .id = 0,
-    .lbi_start = 610,
-    .tags = {0},
-    .size = 6
-  };
-  HASH_CRC(m_data, 6, &(m_header.crc32));
-  FS_FILEHEADER_WRITE(0, m_header, &m_write_error);
-
-  U8 m_pack[250] = {0};
-  STD_MEMCPY(6, m_data, m_pack);
-  FTL_WRITE(610, 1, m_pack, &m_write_error);
+    if((FILE_ID)UN_SET == g_fs->descriptor_table[i].id)
+    {
+      continue;
+    }
 
-  return;
+    RETURN_CODE m_sync_error = NO_ERROR;
+    FS_DESCRIPTOR_SYNC(&(g_fs->descriptor_table[i]), &m_sync_error);
+    if(NO_ERROR != m_sync_error)
+    {
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+  }
 
-  /* Чтение суперблока */
-  RETURN_CODE m_superblock_error = NO_ERROR;
-  FTL_READ(0U, 1U, &g_fs_superblock, &m_superblock_error);
-  if(OPERATION_FAILED == m_superblock_error)
+  RETURN_CODE m_commit_error = NO_ERROR;
+  FS_JOURNAL_COMMIT(&m_commit_error);
+  if(NO_ERROR != m_commit_error)
   {
     *return_code = OPERATION_FAILED;
     return;
   }
-  if((NO_ACTION == m_superblock_error)
-  || (g_fs_superblock.magic != FS_MAGIC))
+
+  /* 2. Снимок отображения FTL */
+  FTL_SNAPSHOT_ID m_id;
+  RETURN_CODE m_snapshot_error = NO_ERROR;
+  FTL_SNAPSHOT_CREATE(&m_id, &m_snapshot_error);
+  if(NO_ERROR != m_snapshot_error)
   {
-    RETURN_CODE m_format_error = NO_ERROR;
-    FS_FORMAT(&m_format_error);
-    /* TODO */
+    *return_code = m_snapshot_error;
     return;
   }
 
-  /* Чтение битовой карты блоков */
-  for(register FTL_INDEX m_lbi = 0U; m_lbi < FS_BLOCKS_COUNT; m_lbi++)
-  {
-    BLOCK_FLAG m_tmp_flag;
-    RETURN_CODE m_blockflag_error = NO_ERROR;
-    FS_BLOCKFLAG_READ(m_lbi, &m_tmp_flag, &m_blockflag_error);
-    if(NO_ERROR != m_blockflag_error)
-    {
-      *return_code = OPERATION_FAILED;
-      return;
-    }
-  }
+  *id = (SNAPSHOT_ID)m_id;
+  *return_code = NO_ERROR;
+}
 
-  /* Чтение имен тегов */
-  for(register TAG_ID m_tag_id = 0U; m_tag_id < FS_TAGS_COUNT; m_tag_id++)
+void FS_SNAPSHOT_ROLLBACK(
+/* IN  */ const SNAPSHOT_ID ID,
+/* OUT */ RETURN_CODE * return_code)
+{
+  /* Открытие отмечается под блокировкой метаданных до выдачи ячейки */
+  FS_LOCK_SCOPE(&g_fs->lock);
+  for(register SIZE32 i = 0U; i < FS_FILES_COUNT; i++)
   {
-    RETURN_CODE m_tag_error = NO_ERROR;
-    FS_TAGNAME_READ(m_tag_id, g_fs_tag_names[m_tag_id], &m_tag_error);
-    if(OPERATION_FAILED == m_tag_error)
+    if(0U != g_fs->file_opens[i])
     {
-      *return_code = OPERATION_FAILED;
+      *return_code = DEVICE_BUSY;
       return;
     }
   }
 
-  /* Инициализация таблицы дескрипторов */
-  for(register SIZE32 i = 0U; i < FS_DESCRIPTORS_COUNT; i++)
+  RETURN_CODE m_rollback_error = NO_ERROR;
+  FTL_SNAPSHOT_ROLLBACK((FTL_SNAPSHOT_ID)ID, &m_rollback_error);
+  if(NO_ERROR != m_rollback_error)
   {
-    g_fs_descriptor_table[i].id = (FILE_ID)UN_SET;
+    *return_code = m_rollback_error;
+    return;
   }
 
-  *return_code = NO_ERROR;
+  /* Таблицы, кэш и журнал в ОЗУ относятся к отброшенному состоянию */
+  FS_MOUNT(return_code);
 }
 
-
-
-/*
- * ОТКЛЮЧЕНИЕ ФС
- */
-void FS_FREE(RETURN_CODE * return_code)
+void FS_SNAPSHOT_DELETE(
+/* IN  */ const SNAPSHOT_ID ID,
+/* OUT */ RETURN_CODE * return_code)
 {
-  /* TODO: запись в память (если что-то осталось) */
-  FTL_FREE(return_code);
+  FTL_SNAPSHOT_DELETE((FTL_SNAPSHOT_ID)ID, return_code);
 }
 
-
-
-
-
-
-
-/*
- * ВЫДЕЛЕНИЕ БЛОКА:
- *   lbi: Индекс логического блока
- *   return_code: Состояние операции
- */
-void FS_BLOCK_ALLOCATE(
-/* OUT */ FTL_INDEX * lbi,
+void FS_KV_PUT(
+/* IN  */ const VOID_PTR KEY,
+/* IN  */ const SIZE32 KEY_LENGTH,
+/* IN  */ const VOID_PTR VALUE,
+/* IN  */ const SIZE32 VALUE_LENGTH,
 /* OUT */ RETURN_CODE * return_code)
 {
-  SIZE32 m_byte_idx;
-  U8 m_byte;
-  U8 m_shift;
-  BLOCK_FLAG m_flag;
-
-  for(FTL_INDEX m_index = 610U; m_index < FS_BLOCKS_COUNT; m_index++)
-  {
-    m_byte_idx = m_index / 4U;
-    m_shift = (m_index % 4U) * 2U;
-    m_byte = g_fs_block_flags[m_byte_idx];
-    m_flag = (BLOCK_FLAG)((m_byte >> m_shift) & 0x03U);
-
-    if(m_flag == BLOCK_FLAG_FREE)
-    {
-      *lbi = m_index;
-      RETURN_CODE m_write_error = NO_ERROR;
-      FS_BLOCKFLAG_WRITE(m_index, BLOCK_FLAG_USED, &m_write_error);
-      if(NO_ERROR != m_write_error)
-      {
-        *return_code = OPERATION_FAILED;
-      }
-      else
-      {
-        *return_code = NO_ERROR;
-      }
-      return;
-    }
-  }
+  FTL_KV_PUT(KEY, KEY_LENGTH, VALUE, VALUE_LENGTH, return_code);
+}
 
-  *return_code = NO_ACTION;
+void FS_KV_GET(
+/* IN  */ const VOID_PTR KEY,
+/* IN  */ const SIZE32 KEY_LENGTH,
+/* IN  */ const SIZE32 CAPACITY,
+/* OUT */ VOID_PTR value,
+/* OUT */ SIZE32 * value_length,
+/* OUT */ RETURN_CODE * return_code)
+{
+  FTL_KV_GET(KEY, KEY_LENGTH, CAPACITY, value, value_length, return_code);
 }
 
+void FS_KV_DELETE(
+/* IN  */ const VOID_PTR KEY,
+/* IN  */ const SIZE32 KEY_LENGTH,
+/* OUT */ RETURN_CODE * return_code)
+{
+  FTL_KV_DELETE(KEY, KEY_LENGTH, return_code);
+}
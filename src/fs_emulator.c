@@ -1,59 +1,231 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "fs_def.h"
 #include "fs_std.h"
 #include "fs_emulator.h"
 
-I16  g_flash_fd = -1;
-U8 * g_flash_mem = (VOID_PTR)(0);
+/*
+ * Полный размер отображаемого файла
+ */
+#define EMULATOR_MEMORY_SIZE (FLASH_SIZE + EMULATOR_SPARE_SIZE)
+
+/*
+ * Устройства томов
+ */
+static EMULATOR_VOLUME_TYPE g_emulator_volumes[FS_VOLUMES_COUNT] =
+{
+  [0U ... FS_VOLUMES_COUNT - 1U] = { .fd = -1 }
+};
+
+FS_THREAD_LOCAL EMULATOR_VOLUME_TYPE * g_emulator = &g_emulator_volumes[0U];
+
+/*
+ * ПРИМЕНЕНИЕ ЗАЛИПШИХ БИТОВ К ДИАПАЗОНУ:
+ *   OFFSET: Смещение начала диапазона
+ *   SIZE: Размер диапазона
+ */
+static void EMULATOR_FAULTS_APPLY(
+/* IN  */ const SIZE32 OFFSET,
+/* IN  */ const SIZE32 SIZE)
+{
+  for(register SIZE32 i = 0U; i < g_emulator->faults_count; i++)
+  {
+    const EMULATOR_FAULT_TYPE * M_FAULT = &g_emulator->faults[i];
+    if((M_FAULT->offset < OFFSET) || (M_FAULT->offset >= OFFSET + SIZE))
+    {
+      continue;
+    }
+    U8 * m_byte = &(g_emulator->mem[M_FAULT->offset]);
+    *m_byte = (U8)((*m_byte & ~M_FAULT->mask) | M_FAULT->value);
+  }
+}
+
+/*
+ * РАСХОД ОПЕРАЦИИ ДО ОТКЛЮЧЕНИЯ ПИТАНИЯ:
+ *   size: Размер операции (после отключения - выполняемая часть)
+ */
+static void EMULATOR_POWER_SPEND(
+/* INOUT */ SIZE32 * size)
+{
+  if(g_emulator->power_off)
+  {
+    *size = 0U;
+    return;
+  }
+  if(0U == g_emulator->power_budget)
+  {
+    return;
+  }
+  if(0U == --g_emulator->power_budget)
+  {
+    g_emulator->power_off = 1U;
+    *size /= 2U;
+  }
+}
+
+void EMULATOR_VOLUME_SELECT(
+/* IN  */ const VOLUME_ID ID,
+/* OUT */ RETURN_CODE * return_code)
+{
+  if(ID >= FS_VOLUMES_COUNT)
+  {
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  g_emulator = &g_emulator_volumes[ID];
+  *return_code = NO_ERROR;
+}
 
 void EMULATOR_INIT(
 /* IN  */ const CHAR * FLASH_NAME,
 /* OUT */ RETURN_CODE * return_code)
 {
-  g_flash_fd = open(FLASH_NAME, O_RDWR | O_CREAT, 0644);
-  if(g_flash_fd < 0)
+  g_emulator->fd = open(FLASH_NAME, O_RDWR | O_CREAT, 0644);
+  if(g_emulator->fd < 0)
   {
     *return_code = OPERATION_FAILED;
     return;
   }
 
+  // Запоминаем прежний размер (новая часть запасной области должна быть стерта)
+  struct stat m_stat;
+  if(fstat(g_emulator->fd, &m_stat) < 0)
+  {
+    close(g_emulator->fd);
+
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
   // Устанавливаем размер файла
-  if(ftruncate(g_flash_fd, FLASH_SIZE) < 0)
+  if(ftruncate(g_emulator->fd, EMULATOR_MEMORY_SIZE) < 0)
   {
-    close(g_flash_fd);
+    close(g_emulator->fd);
 
     *return_code = OPERATION_FAILED;
     return;
   }
 
   // Отображаем файл в память
-  g_flash_mem
-    = mmap((VOID_PTR)(0), FLASH_SIZE,
-      PROT_READ | PROT_WRITE, MAP_SHARED, g_flash_fd, 0);
-  if(g_flash_mem == MAP_FAILED)
+  g_emulator->mem
+    = mmap((VOID_PTR)(0), EMULATOR_MEMORY_SIZE,
+      PROT_READ | PROT_WRITE, MAP_SHARED, g_emulator->fd, 0);
+  if(g_emulator->mem == MAP_FAILED)
   {
-    close(g_flash_fd);
+    close(g_emulator->fd);
 
     *return_code = OPERATION_FAILED;
     return;
   }
 
+  SIZE32 m_spare_start = FLASH_SIZE;
+  if((SIZE32)m_stat.st_size > m_spare_start)
+  {
+    m_spare_start = (SIZE32)m_stat.st_size;
+  }
+  if(m_spare_start < EMULATOR_MEMORY_SIZE)
+  {
+    STD_MEMSET(
+      EMULATOR_MEMORY_SIZE - m_spare_start, 0xFF,
+      g_emulator->mem + m_spare_start
+    );
+  }
+
   *return_code = NO_ERROR;
 }
 
 void EMULATOR_FREE(void)
 {
-  if(g_flash_mem)
+  if(g_emulator->mem)
+  {
+    munmap(g_emulator->mem, EMULATOR_MEMORY_SIZE);
+    g_emulator->mem = (VOID_PTR)(0);
+  }
+  if(g_emulator->fd >= 0)
   {
-    munmap(g_flash_mem, FLASH_SIZE);
-    g_flash_mem = (VOID_PTR)(0);
+    close(g_emulator->fd);
+    g_emulator->fd = -1;
   }
-  if(g_flash_fd >= 0)
+}
+
+void EMULATOR_PROGRAM(
+/* IN  */ const SIZE32 OFFSET,
+/* IN  */ const SIZE32 SIZE,
+/* IN  */ const VOID_PTR DATA)
+{
+  SIZE32 m_size = SIZE;
+  EMULATOR_POWER_SPEND(&m_size);
+
+  const U8 * M_DATA = (const U8 *)DATA;
+  for(register SIZE32 i = 0U; i < m_size; i++)
   {
-    close(g_flash_fd);
-    g_flash_fd = -1;
+    g_emulator->mem[OFFSET + i] &= M_DATA[i];
   }
+  EMULATOR_FAULTS_APPLY(OFFSET, m_size);
+}
+
+void EMULATOR_ERASE(
+/* IN  */ const SIZE32 OFFSET,
+/* IN  */ const SIZE32 SIZE)
+{
+  SIZE32 m_size = SIZE;
+  EMULATOR_POWER_SPEND(&m_size);
+
+  STD_MEMSET(m_size, 0xFF, g_emulator->mem + OFFSET);
+  EMULATOR_FAULTS_APPLY(OFFSET, m_size);
+}
+
+void EMULATOR_POWER_CUT(
+/* IN  */ const SIZE32 COUNT)
+{
+  g_emulator->power_budget = COUNT;
+  g_emulator->power_off = 0U;
+}
+
+void EMULATOR_FAULT(
+/* IN  */ const SIZE32 OFFSET,
+/* IN  */ const U8 BIT,
+/* IN  */ const U8 VALUE,
+/* OUT */ RETURN_CODE * return_code)
+{
+  if((OFFSET >= EMULATOR_MEMORY_SIZE) || (BIT >= 8U))
+  {
+    *return_code = INVALID_PARAM;
+    return;
+  }
+  if(g_emulator->faults_count >= EMULATOR_FAULTS_COUNT)
+  {
+    *return_code = NO_ACTION;
+    return;
+  }
+
+  const U8 M_MASK = (U8)(1U << BIT);
+  g_emulator->faults[g_emulator->faults_count++] = (EMULATOR_FAULT_TYPE){
+    .offset = OFFSET,
+    .mask = M_MASK,
+    .value = VALUE ? M_MASK : 0U
+  };
+  EMULATOR_FAULTS_APPLY(OFFSET, 1U);
+
+  *return_code = NO_ERROR;
+}
+
+void EMULATOR_BITFLIP(
+/* IN  */ const SIZE32 OFFSET,
+/* IN  */ const U8 BIT,
+/* OUT */ RETURN_CODE * return_code)
+{
+  if((OFFSET >= EMULATOR_MEMORY_SIZE) || (BIT >= 8U))
+  {
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  g_emulator->mem[OFFSET] ^= (U8)(1U << BIT);
+
+  *return_code = NO_ERROR;
 }
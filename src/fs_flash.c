@@ -2,6 +2,7 @@
 #include "fs_std.h"
 #include "fs_emulator.h"
 #include "fs_crypt.h"
+#include "fs_lock.h"
 #include "fs_flash.h"
 
 /*
@@ -9,16 +10,30 @@
  */
 #define FLASH_HEADER_MAGIC 0x666C6472
 
+/*
+ * Программная коррекция ошибок (Hamming SEC-DED на слово, байт ECC хранится
+ * в запасной области эмулятора NAND)
+ */
+#ifndef FLASH_ECC
+#define FLASH_ECC EMULATOR_NAND
+#endif
+
+#if FLASH_ECC && !EMULATOR_NAND
+#error "FLASH_ECC requires EMULATOR_NAND (spare area for ECC bytes)"
+#endif
+
 /*
  * magic: Идентификатор (0x666C6472)
  * sectors: Массив секторов
  * (148 + 12 * enum)
+ * bad: Таблица изъятых страниц (бит 0 - изъята, стертое значение - исправна)
  * mode: Режим работы
  */
 typedef struct
 {
   U32 magic;
   FLASH_SECTOR_TYPE sectors[FLASH_SECTORS_COUNT];
+  U8 bad[FLASH_PAGES_COUNT / 8U];
   FLASH_MODE mode;
   U32 crc32;
 } FLASH_HEADER_TYPE;
@@ -54,13 +69,150 @@ const FLASH_ACCESS G_SECTORS_ACCESS[FLASH_SECTORS_COUNT] =
 
 
 /*
- * Служебные данные флеш секторов
+ * FLASH ТОМА:
+ *   header: Служебные данные флеш секторов
+ *   stats: Счетчики отказов и коррекций (bad_pages считается по таблице)
+ */
+typedef struct
+{
+  FLASH_HEADER_TYPE header;
+  FLASH_STATS_TYPE stats;
+} FLASH_VOLUME_TYPE;
+
+/*
+ * Flash томов
  */
-static FLASH_HEADER_TYPE g_flash_header =
-(FLASH_HEADER_TYPE){
-  .mode = FLASH_MODE_SUPERVISOR
+static FLASH_VOLUME_TYPE g_flash_volumes[FS_VOLUMES_COUNT] =
+{
+  [0U ... FS_VOLUMES_COUNT - 1U] =
+  {
+    .header = { .mode = FLASH_MODE_SUPERVISOR }
+  }
 };
 
+/*
+ * Flash тома, выбранного потоком
+ */
+static FS_THREAD_LOCAL FLASH_VOLUME_TYPE * g_flash = &g_flash_volumes[0U];
+
+/*
+ * Размер суперблока: sizeof(magic) + sizeof(sectors) + sizeof(bad)
+ */
+#define FLASH_SUPERBLOCK_SIZE \
+  (sizeof(U32) + sizeof(FLASH_SECTOR_TYPE) * FLASH_SECTORS_COUNT \
+  + FLASH_PAGES_COUNT / 8U)
+
+#if FLASH_ECC
+/*
+ * Позиции битов данных в коде Хэмминга (позиции 1, 2, 4, 8, 16, 32 -
+ * контрольные биты)
+ */
+static const U8 G_ECC_POSITIONS[32U] =
+{
+   3U,  5U,  6U,  7U,  9U, 10U, 11U, 12U, 13U, 14U, 15U, 17U, 18U, 19U, 20U, 21U,
+  22U, 23U, 24U, 25U, 26U, 27U, 28U, 29U, 30U, 31U, 33U, 34U, 35U, 36U, 37U, 38U
+};
+
+/*
+ * СИНДРОМ СЛОВА (XOR позиций единичных битов данных):
+ *   WORD: Слово данных
+ *   return: Контрольные биты (6 бит)
+ */
+static U8 FLASH_ECC_SYNDROME(
+/* IN  */ const FLASH_WORD WORD)
+{
+  U8 m_syndrome = 0U;
+  for(register U8 i = 0U; i < 32U; i++)
+  {
+    if((WORD >> i) & 1U)
+    {
+      m_syndrome ^= G_ECC_POSITIONS[i];
+    }
+  }
+  return m_syndrome;
+}
+
+/*
+ * ЧЕТНОСТЬ:
+ *   VALUE: Значение
+ *   return: Четность количества единичных битов
+ */
+static U8 FLASH_ECC_PARITY(
+/* IN  */ U32 VALUE)
+{
+  VALUE ^= VALUE >> 16U;
+  VALUE ^= VALUE >> 8U;
+  VALUE ^= VALUE >> 4U;
+  VALUE ^= VALUE >> 2U;
+  VALUE ^= VALUE >> 1U;
+  return (U8)(VALUE & 1U);
+}
+
+/*
+ * КОДИРОВАНИЕ СЛОВА:
+ *   WORD: Слово данных
+ *   return: Байт ECC (биты 0-5 - контрольные, бит 6 - общая четность,
+ *           бит 7 = 0 - признак записанного ECC)
+ */
+static U8 FLASH_ECC_ENCODE(
+/* IN  */ const FLASH_WORD WORD)
+{
+  const U8 M_CHECK = FLASH_ECC_SYNDROME(WORD);
+  const U8 M_PARITY = FLASH_ECC_PARITY(WORD) ^ FLASH_ECC_PARITY(M_CHECK);
+  return (U8)(M_CHECK | (M_PARITY << 6U));
+}
+
+/*
+ * ПРОВЕРКА И ИСПРАВЛЕНИЕ СЛОВА:
+ *   ECC: Байт ECC (0xFF - слово записано без ECC)
+ *   word: Прочитанное слово
+ *   return_code: Статус операции
+ *     NO_ERROR: Ошибок нет
+ *     NO_ACTION: Однобитовая ошибка исправлена
+ *     OPERATION_FAILED: Неисправимая ошибка
+ */
+static void FLASH_ECC_CORRECT(
+/* IN    */ const U8 ECC,
+/* INOUT */ FLASH_WORD * word,
+/* OUT   */ RETURN_CODE * return_code)
+{
+  if(0xFFU == ECC)
+  {
+    *return_code = NO_ERROR;
+    return;
+  }
+
+  const U8 M_CHECK = ECC & 0x3FU;
+  const U8 M_SYNDROME = FLASH_ECC_SYNDROME(*word) ^ M_CHECK;
+  const U8 M_PARITY = FLASH_ECC_PARITY(*word) ^ FLASH_ECC_PARITY(M_CHECK)
+                    ^ ((ECC >> 6U) & 1U);
+  if(0U == M_PARITY)
+  {
+    *return_code = (0U == M_SYNDROME) ? NO_ERROR : OPERATION_FAILED;
+    return;
+  }
+
+  /* Ошибка в контрольном бите или бите четности - данные целы */
+  if(0U == (M_SYNDROME & (M_SYNDROME - 1U)))
+  {
+    *return_code = NO_ACTION;
+    return;
+  }
+
+  for(register U8 i = 0U; i < 32U; i++)
+  {
+    if(G_ECC_POSITIONS[i] == M_SYNDROME)
+    {
+      *word ^= (1UL << i);
+      *return_code = NO_ACTION;
+      return;
+    }
+  }
+
+  *return_code = OPERATION_FAILED;
+}
+#endif
+
 
 /*
  * ДОСТУП К СЕКТОРУ: (!!! ОПТИМИЗИРОВАТЬ !!!)
@@ -82,20 +234,20 @@ void FLASH_SECTOR_VERIFY(
     return;
   }
 
-  if(FLASH_MODE_SUPERVISOR == g_flash_header.mode)
+  if(FLASH_MODE_SUPERVISOR == g_flash->header.mode)
   {
     *return_code = NO_ERROR;
     return;
   }
 
-  if(REQUIRED_ACCESS > g_flash_header.sectors[SECTOR_ID].permission)
+  if(REQUIRED_ACCESS > g_flash->header.sectors[SECTOR_ID].permission)
   {
     *return_code = ACCESS_DENIED;
     return;
   }
 
   if((FLASH_ACCESS_SUPERVISOR == REQUIRED_ACCESS)
-  && (FLASH_MODE_USER == g_flash_header.mode))
+  && (FLASH_MODE_USER == g_flash->header.mode))
   {
     *return_code = ACCESS_DENIED;
     return;
@@ -124,15 +276,16 @@ void FLASH_SECTOR_ADMIT(
     return;
   }
 
-  if(FLASH_MODE_SUPERVISOR != g_flash_header.mode)
+  if(FLASH_MODE_SUPERVISOR != g_flash->header.mode)
   {
     *return_code = ACCESS_DENIED;
     return;
   }
 
   HASH_CRC(
-    &(g_flash_header.sectors[SECTOR_ID]), sizeof(FLASH_SECTOR_TYPE) - sizeof(U32),
-    &(g_flash_header.sectors[SECTOR_ID].crc32)
+    &(g_flash->header.sectors[SECTOR_ID]),
+    sizeof(FLASH_SECTOR_TYPE) - sizeof(U32),
+    &(g_flash->header.sectors[SECTOR_ID].crc32)
   );
 
   *return_code = NO_ERROR;
@@ -158,10 +311,11 @@ void FLASH_SECTOR_VALIDATE(
 
   U32 m_sector_crc32_calc = 0UL;
   HASH_CRC(
-    &(g_flash_header.sectors[SECTOR_ID]), sizeof(FLASH_SECTOR_TYPE) - sizeof(U32),
+    &(g_flash->header.sectors[SECTOR_ID]),
+    sizeof(FLASH_SECTOR_TYPE) - sizeof(U32),
     &m_sector_crc32_calc
   );
-  if(m_sector_crc32_calc != g_flash_header.sectors[SECTOR_ID].crc32)
+  if(m_sector_crc32_calc != g_flash->header.sectors[SECTOR_ID].crc32)
   {
     *return_code = OPERATION_FAILED;
   }
@@ -181,7 +335,7 @@ void FLASH_SECTOR_VALIDATE(
 void FLASH_ADMIT(
 /* OUT */ RETURN_CODE * return_code)
 {
-  if(FLASH_MODE_SUPERVISOR != g_flash_header.mode)
+  if(FLASH_MODE_SUPERVISOR != g_flash->header.mode)
   {
     *return_code = ACCESS_DENIED;
     return;
@@ -199,8 +353,8 @@ void FLASH_ADMIT(
   }
 
   HASH_CRC(
-    &(g_flash_header), sizeof(FLASH_HEADER_TYPE) - sizeof(U32),
-    &(g_flash_header.crc32)
+    &(g_flash->header), sizeof(FLASH_HEADER_TYPE) - sizeof(U32),
+    &(g_flash->header.crc32)
   );
 
   *return_code = NO_ERROR;
@@ -217,10 +371,10 @@ void FLASH_VALIDATE(
 {
   U32 m_flash_crc32_calc = 0Ul;
   HASH_CRC(
-    &(g_flash_header), sizeof(FLASH_HEADER_TYPE) - sizeof(U32),
+    &(g_flash->header), sizeof(FLASH_HEADER_TYPE) - sizeof(U32),
     &m_flash_crc32_calc
   );
-  if(m_flash_crc32_calc != g_flash_header.crc32)
+  if(m_flash_crc32_calc != g_flash->header.crc32)
   {
     *return_code = OPERATION_FAILED;
   }
@@ -242,7 +396,7 @@ inline static void FLASH_MODE_SET(
 /* IN  */ const FLASH_MODE MODE,
 /* OUT */ RETURN_CODE * return_code)
 {
-  g_flash_header.mode = MODE;
+  g_flash->header.mode = MODE;
   RETURN_CODE m_validate_error = NO_ERROR;
   for(register U8 i = 0U; i < FLASH_SECTORS_COUNT; i++)
   {
@@ -255,8 +409,8 @@ inline static void FLASH_MODE_SET(
   }
 
   HASH_CRC(
-    &(g_flash_header), sizeof(FLASH_HEADER_TYPE) - sizeof(U32),
-    &(g_flash_header.crc32)
+    &(g_flash->header), sizeof(FLASH_HEADER_TYPE) - sizeof(U32),
+    &(g_flash->header.crc32)
   );
 
   *return_code = NO_ERROR;
@@ -265,18 +419,33 @@ inline static void FLASH_MODE_SET(
 
 
 
+void FLASH_VOLUME_SELECT(
+/* IN  */ const VOLUME_ID ID,
+/* OUT */ RETURN_CODE * return_code)
+{
+  if(ID >= FS_VOLUMES_COUNT)
+  {
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  RETURN_CODE m_select_error = NO_ERROR;
+  EMULATOR_VOLUME_SELECT(ID, &m_select_error);
+  g_flash = &g_flash_volumes[ID];
+  *return_code = m_select_error;
+}
+
 void FLASH_INIT(
 /* OUT */ RETURN_CODE * return_code)
 {
   /* 1. Функцию может вызывать только SUPERVISOR */
-  if(FLASH_MODE_SUPERVISOR != g_flash_header.mode)
+  if(FLASH_MODE_SUPERVISOR != g_flash->header.mode)
   {
     *return_code = ACCESS_DENIED;
     return;
   }
 
-  const SIZE32 M_SUPERBLOCK_SIZE =
-    sizeof(U32) + sizeof(FLASH_SECTOR_TYPE) * FLASH_SECTORS_COUNT;
+  const SIZE32 M_SUPERBLOCK_SIZE = FLASH_SUPERBLOCK_SIZE;
 
   /*
   FLASH_ADDRESS m_address
@@ -294,7 +463,7 @@ void FLASH_INIT(
 
     RETURN_CODE m_read_error = NO_ERROR;
     FLASH_READ(
-      m_address, M_SUPERBLOCK_SIZE, &g_flash_header, &m_read_error
+      m_address, M_SUPERBLOCK_SIZE, &g_flash->header, &m_read_error
     );
     if(NO_ERROR != m_read_error)
     {
@@ -302,17 +471,17 @@ void FLASH_INIT(
       return;
     }
 
-    if(((U8 *)&g_flash_header)[0U] != 0xFF)
+    if(((U8 *)&g_flash->header)[0U] != 0xFF)
     {
       m_is_find = 1;
     }
   }
   */
   /* 2. Чтение суперблока flash драйвера */
-  /* sizeof(magic) + sizeof(sectors) */
+  /* sizeof(magic) + sizeof(sectors) + sizeof(bad) */
   RETURN_CODE m_read_error = NO_ERROR;
   FLASH_READ(
-    G_SECTORS_ADDRESS[1U], M_SUPERBLOCK_SIZE, &g_flash_header, &m_read_error
+    G_SECTORS_ADDRESS[1U], M_SUPERBLOCK_SIZE, &g_flash->header, &m_read_error
   );
   if(NO_ERROR != m_read_error)
   {
@@ -323,14 +492,15 @@ void FLASH_INIT(
   RETURN_CODE m_admit_error = NO_ERROR;
 
   // 3. Проверка магического числа
-  if(g_flash_header.magic != FLASH_HEADER_MAGIC)
+  if(g_flash->header.magic != FLASH_HEADER_MAGIC)
   {
     /* 3.1. Инициализация при первом запуске */
-    g_flash_header.magic = FLASH_HEADER_MAGIC;
+    g_flash->header.magic = FLASH_HEADER_MAGIC;
+    STD_MEMSET(sizeof(g_flash->header.bad), 0xFF, g_flash->header.bad);
 
     for(register U8 i = 0U; i < FLASH_SECTORS_COUNT; i++)
     {
-      g_flash_header.sectors[i] =
+      g_flash->header.sectors[i] =
       (FLASH_SECTOR_TYPE){
         .pba = G_SECTORS_ADDRESS[i],
         .permission = G_SECTORS_ACCESS[i],
@@ -372,17 +542,16 @@ void FLASH_INIT(
 void FLASH_FREE(
 /* OUT */ RETURN_CODE * return_code)
 {
-  g_flash_header.mode = FLASH_MODE_SUPERVISOR;
+  g_flash->header.mode = FLASH_MODE_SUPERVISOR;
 
   RETURN_CODE m_erase_error = NO_ERROR;
   FLASH_SECTOR_ERASE(1U, &m_erase_error);
   /* TODO: m_erase_error */
 
-  const SIZE32 M_SUPERBLOCK_SIZE =
-    sizeof(U32) + sizeof(FLASH_SECTOR_TYPE) * FLASH_SECTORS_COUNT;
+  const SIZE32 M_SUPERBLOCK_SIZE = FLASH_SUPERBLOCK_SIZE;
   RETURN_CODE m_write_error = NO_ERROR;
   FLASH_WRITE(
-    G_SECTORS_ADDRESS[1U], M_SUPERBLOCK_SIZE, &g_flash_header, &m_write_error
+    G_SECTORS_ADDRESS[1U], M_SUPERBLOCK_SIZE, &g_flash->header, &m_write_error
   );
   if(NO_ERROR != m_write_error)
   {
@@ -463,7 +632,7 @@ void FLASH_SECTOR_SELECT(
     return;
   }
 
-  *sector = g_flash_header.sectors[SECTOR_ID];
+  *sector = g_flash->header.sectors[SECTOR_ID];
 
   *return_code = NO_ERROR;
 }
@@ -492,14 +661,54 @@ void FLASH_SECTOR_ERASE(
     = G_SECTORS_ADDRESS[SECTOR_ID + 1] - G_SECTORS_ADDRESS[SECTOR_ID];
   const FLASH_ADDRESS M_SECTOR_OFFSET
     = G_SECTORS_ADDRESS[SECTOR_ID] - G_SECTORS_ADDRESS[0U];
-  STD_MEMSET(M_SECTOR_SIZE, 0xFF, g_flash_mem + M_SECTOR_OFFSET);
+  EMULATOR_ERASE(M_SECTOR_OFFSET, M_SECTOR_SIZE);
+#if FLASH_ECC
+  EMULATOR_ERASE(FLASH_SIZE + M_SECTOR_OFFSET / 4U, M_SECTOR_SIZE / 4U);
+#endif
+
+  // Проверка стирания: не стертые страницы изымаются
+  for(SIZE32 m_page = 0U; m_page < M_SECTOR_SIZE; m_page += FLASH_PAGE_SIZE)
+  {
+    U8 m_blank = 1U;
+    for(register SIZE32 i = 0U; i < FLASH_PAGE_SIZE; i++)
+    {
+      if(0xFFU != g_emulator->mem[M_SECTOR_OFFSET + m_page + i])
+      {
+        m_blank = 0U;
+        break;
+      }
+    }
+#if FLASH_ECC
+    for(register SIZE32 i = 0U; m_blank && (i < FLASH_PAGE_SIZE / 4U); i++)
+    {
+      if(0xFFU
+      != g_emulator->mem[FLASH_SIZE + (M_SECTOR_OFFSET + m_page) / 4U + i])
+      {
+        m_blank = 0U;
+      }
+    }
+#endif
+    if(m_blank)
+    {
+      continue;
+    }
+
+    RETURN_CODE m_mark_error = NO_ERROR;
+    FLASH_BADBLOCK_MARK(
+      G_SECTORS_ADDRESS[SECTOR_ID] + m_page, &m_mark_error
+    );
+    if(NO_ERROR == m_mark_error)
+    {
+      g_flash->stats.erase_failures++;
+    }
+  }
 
   // Увеличиваем счетчик стираний
-  g_flash_header.sectors[SECTOR_ID].wear++;
+  g_flash->header.sectors[SECTOR_ID].wear++;
 
   // Временное повышение прав для обновления метаданных
-  FLASH_MODE m_mode_tmp = g_flash_header.mode;
-  g_flash_header.mode = FLASH_MODE_SUPERVISOR;
+  FLASH_MODE m_mode_tmp = g_flash->header.mode;
+  g_flash->header.mode = FLASH_MODE_SUPERVISOR;
 
   RETURN_CODE m_sector_admit_error = NO_ERROR;
   FLASH_SECTOR_ADMIT(SECTOR_ID, &m_sector_admit_error);
@@ -547,7 +756,7 @@ void FLASH_WRITE(
 
   // 3. Проверка доступа
   FLASH_ACCESS required_access = FLASH_ACCESS_READ_WRITE;
-  if(FLASH_MODE_SUPERVISOR == g_flash_header.mode)
+  if(FLASH_MODE_SUPERVISOR == g_flash->header.mode)
   {
     required_access = FLASH_ACCESS_SUPERVISOR;
   }
@@ -569,17 +778,71 @@ void FLASH_WRITE(
     return;
   }
 
-  // 5. Низкоуровневая запись
+  // 5. Проверка стертости (вместе с байтами ECC)
   const FLASH_ADDRESS M_OFFSET = PBA - G_SECTORS_ADDRESS[0U];
   for(SIZE32 i = M_OFFSET; i < M_OFFSET + SIZE; i++)
   {
-    if(*(U8 *)(g_flash_mem + i) != 0xFF)
+    if(*(U8 *)(g_emulator->mem + i) != 0xFF)
+    {
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+  }
+#if FLASH_ECC
+  for(SIZE32 i = M_OFFSET / 4U; i < (M_OFFSET + SIZE) / 4U; i++)
+  {
+    if(g_emulator->mem[FLASH_SIZE + i] != 0xFF)
     {
       *return_code = OPERATION_FAILED;
       return;
     }
   }
-  STD_MEMCPY(SIZE, DATA, g_flash_mem + M_OFFSET);
+#endif
+
+  // 6. Низкоуровневая запись
+  EMULATOR_PROGRAM(M_OFFSET, SIZE, DATA);
+#if FLASH_ECC
+  const FLASH_WORD * M_WORDS = (const FLASH_WORD *)DATA;
+  for(SIZE32 i = 0U; i < SIZE / 4U; i++)
+  {
+    U8 m_ecc = FLASH_ECC_ENCODE(M_WORDS[i]);
+    EMULATOR_PROGRAM(FLASH_SIZE + M_OFFSET / 4U + i, 1U, &m_ecc);
+  }
+#endif
+
+  // 7. Проверка чтением: страница с неисправными ячейками изымается
+  U8 m_verified = 1U;
+  for(SIZE32 i = 0U; i < SIZE; i++)
+  {
+    if(g_emulator->mem[M_OFFSET + i] != ((const U8 *)DATA)[i])
+    {
+      m_verified = 0U;
+      break;
+    }
+  }
+#if FLASH_ECC
+  for(SIZE32 i = 0U; m_verified && (i < SIZE / 4U); i++)
+  {
+    if(g_emulator->mem[FLASH_SIZE + M_OFFSET / 4U + i]
+    != FLASH_ECC_ENCODE(M_WORDS[i]))
+    {
+      m_verified = 0U;
+    }
+  }
+#endif
+  if(!m_verified)
+  {
+    g_flash->stats.program_failures++;
+    for(FLASH_ADDRESS m_page = PBA & ~(FLASH_PAGE_SIZE - 1U); m_page < PBA + SIZE;
+      m_page += FLASH_PAGE_SIZE)
+    {
+      RETURN_CODE m_mark_error = NO_ERROR;
+      FLASH_BADBLOCK_MARK(m_page, &m_mark_error);
+    }
+
+    *return_code = OPERATION_FAILED;
+    return;
+  }
 
   *return_code = NO_ERROR;
 }
@@ -599,7 +862,7 @@ void FLASH_READ(
 
   // 2. Проверка границ памяти
   if((PBA < G_SECTORS_ADDRESS[0U])
-  || (PBA + SIZE >= G_SECTORS_ADDRESS[FLASH_SECTORS_COUNT]))
+  || (PBA + SIZE > G_SECTORS_ADDRESS[FLASH_SECTORS_COUNT]))
   {
     *return_code = OPERATION_FAILED;
     return;
@@ -607,7 +870,114 @@ void FLASH_READ(
 
   // 3. Низкоуровневое чтение
   const FLASH_ADDRESS M_OFFSET = PBA - G_SECTORS_ADDRESS[0U];
-  STD_MEMCPY(SIZE, g_flash_mem + M_OFFSET, data);
+  STD_MEMCPY(SIZE, g_emulator->mem + M_OFFSET, data);
+
+#if FLASH_ECC
+  // 4. Коррекция ошибок
+  FLASH_WORD * m_words = (FLASH_WORD *)data;
+  RETURN_CODE m_result = NO_ERROR;
+  for(SIZE32 i = 0U; i < SIZE / 4U; i++)
+  {
+    RETURN_CODE m_correct_error = NO_ERROR;
+    FLASH_ECC_CORRECT(
+      g_emulator->mem[FLASH_SIZE + M_OFFSET / 4U + i], &m_words[i],
+      &m_correct_error
+    );
+    if(NO_ACTION == m_correct_error)
+    {
+      FS_ATOMIC_INCREMENT(g_flash->stats.ecc_corrected);
+    }
+    else if(NO_ERROR != m_correct_error)
+    {
+      FS_ATOMIC_INCREMENT(g_flash->stats.ecc_failed);
+      m_result = OPERATION_FAILED;
+    }
+  }
+  *return_code = m_result;
+#else
+  *return_code = NO_ERROR;
+#endif
+}
+
+
+
+void FLASH_POINTER(
+/* IN  */ const FLASH_ADDRESS PBA,
+/* OUT */ const U8 ** data,
+/* OUT */ RETURN_CODE * return_code)
+{
+  if((PBA < G_SECTORS_ADDRESS[0U])
+  || (PBA >= G_SECTORS_ADDRESS[FLASH_SECTORS_COUNT]))
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  *data = g_emulator->mem + (PBA - G_SECTORS_ADDRESS[0U]);
+  *return_code = NO_ERROR;
+}
+
+
+
+void FLASH_BADBLOCK_MARK(
+/* IN  */ const FLASH_ADDRESS PBA,
+/* OUT */ RETURN_CODE * return_code)
+{
+  if((PBA < G_SECTORS_ADDRESS[0U])
+  || (PBA >= G_SECTORS_ADDRESS[FLASH_SECTORS_COUNT]))
+  {
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  const SIZE32 M_PAGE = (PBA - G_SECTORS_ADDRESS[0U]) / FLASH_PAGE_SIZE;
+  const U8 M_MASK = (U8)(1U << (M_PAGE % 8U));
+  if(0U == (g_flash->header.bad[M_PAGE / 8U] & M_MASK))
+  {
+    *return_code = NO_ACTION;
+    return;
+  }
+
+  g_flash->header.bad[M_PAGE / 8U] &= (U8)~M_MASK;
+  HASH_CRC(
+    &(g_flash->header), sizeof(FLASH_HEADER_TYPE) - sizeof(U32),
+    &(g_flash->header.crc32)
+  );
+
+  *return_code = NO_ERROR;
+}
+
+void FLASH_BADBLOCK_CHECK(
+/* IN  */ const FLASH_ADDRESS PBA,
+/* OUT */ U8 * bad,
+/* OUT */ RETURN_CODE * return_code)
+{
+  if((PBA < G_SECTORS_ADDRESS[0U])
+  || (PBA >= G_SECTORS_ADDRESS[FLASH_SECTORS_COUNT]))
+  {
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  const SIZE32 M_PAGE = (PBA - G_SECTORS_ADDRESS[0U]) / FLASH_PAGE_SIZE;
+  *bad = (g_flash->header.bad[M_PAGE / 8U] >> (M_PAGE % 8U)) & 1U ? 0U : 1U;
+
+  *return_code = NO_ERROR;
+}
+
+void FLASH_STATS(
+/* OUT */ FLASH_STATS_TYPE * stats,
+/* OUT */ RETURN_CODE * return_code)
+{
+  *stats = g_flash->stats;
+  stats->bad_pages = 0U;
+  for(register SIZE32 i = 0U; i < FLASH_PAGES_COUNT / 8U; i++)
+  {
+    for(U8 m_bits = (U8)~g_flash->header.bad[i]; m_bits; m_bits &= m_bits - 1U)
+    {
+      stats->bad_pages++;
+    }
+  }
 
   *return_code = NO_ERROR;
 }
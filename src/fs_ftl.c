@@ -1,7 +1,9 @@
 #include "fs_def.h"
 #include "fs_std.h"
 #include "fs_crypt.h"
+#include "fs_lz.h"
 #include "fs_flash.h"
+#include "fs_lock.h"
 #include "fs_ftl.h"
 
 /*
@@ -14,34 +16,395 @@
  */
 #define FTL_BLOCKS_COUNT 3968U
 
+/*
+ * Первый сектор flash, отданный FTL (сектора 0 и 1 - код и метаданные flash)
+ */
+#define FTL_SECTOR_FIRST 2U
+
+/*
+ * Разброс счетчиков стираний секторов, после которого холодный сектор
+ * освобождается переносом данных в изношенные сектора
+ */
+#ifndef FTL_WEAR_THRESHOLD
+#define FTL_WEAR_THRESHOLD 16U
+#endif
+
+/*
+ * Фронты записи: горячие (часто перезаписываемые) и холодные данные
+ */
+#define FTL_FRONTIER_HOT 0U
+#define FTL_FRONTIER_COLD 1U
+#define FTL_FRONTIERS_COUNT 2U
+
+/*
+ * Блок без подсказки горячий, если записан столько раз между сборками мусора
+ */
+#ifndef FTL_HOT_WRITES
+#define FTL_HOT_WRITES 2U
+#endif
+
+/*
+ * Нагрев логического блока (FTL_HEAT_TYPE):
+ *   биты 0-5: Счетчик записей (делится пополам при сборке мусора)
+ *   биты 6-7: Подсказка FTL_TEMPERATURE
+ */
+#define FTL_HEAT_COUNT 0x3FU
+#define FTL_HEAT_HINT_SHIFT 6U
+
+/*
+ * Количество одновременно существующих снимков (отображение снимка
+ * занимает 7937 байт ОЗУ: на целевой платформе - один снимок)
+ */
+#ifndef FTL_SNAPSHOTS_COUNT
+#ifdef __linux__
+#define FTL_SNAPSHOTS_COUNT 2U
+#else
+#define FTL_SNAPSHOTS_COUNT 1U
+#endif
+#endif
+
+/*
+ * Количество хранимых откатов к снимку (запись отката нужна, пока во flash
+ * остаются отмененные им копии: удаляется при FTL_INIT)
+ */
+#ifndef FTL_ROLLBACKS_COUNT
+#define FTL_ROLLBACKS_COUNT 4U
+#endif
+
+/*
+ * Логический блок не отображен на физический
+ */
+#define FTL_PBI_NONE 0xFFFFU
+
+/*
+ * Сжатие блоков при записи (блоки, записанные сжатыми, читаются всегда)
+ */
+#ifndef FTL_COMPRESS
+#define FTL_COMPRESS 1U
+#endif
+
+/*
+ * Шифрование данных блоков AES-128-XTS (CRC32 хранится по открытым данным)
+ */
+#ifndef FTL_ENCRYPT
+#define FTL_ENCRYPT 1U
+#endif
+
+/*
+ * Области номеров шифрования: блок без сжатия - номер логического блока
+ * (XTS), данные сжатого блока (общие для повторов) - их CRC32 (XTS),
+ * запись ключ-значение - ее порядковый номер (CTR, номер не повторяется)
+ */
+#define FTL_CRYPT_RAW 0U
+#define FTL_CRYPT_PACKED 1U
+#define FTL_CRYPT_KV 2U
 
 /*
+ * Поиск одинаковых сжатых блоков (повтор записывается ссылкой на данные)
+ */
+#ifndef FTL_DEDUP
+#define FTL_DEDUP 1U
+#endif
+
+/*
+ * Количество ячеек сжатых блоков в одном физическом блоке
+ * (номер ячейки занимает 4 бита элемента отображения)
+ */
+#define FTL_PACK_SLOTS 15U
+
+/*
+ * Количество записей индекса одинаковых блоков
+ */
+#define FTL_DEDUP_SIZE 256U
+
+/*
+ * Количество повторов записи в другой блок после ошибки проверки записи
+ */
+#ifndef FTL_WRITE_RETRIES
+#define FTL_WRITE_RETRIES 3U
+#endif
+
+/*
+ * Запас свободных блоков сверх резерва сборщика мусора: при меньшем
+ * запасе запись данных начинается со сборки мусора
+ */
+#ifndef FTL_GC_THRESHOLD
+#define FTL_GC_THRESHOLD 64U
+#endif
+
+/*
+ * Потоки чтения таблицы блоков при инициализации (сборка для хоста,
+ * 1 - сектора читаются по порядку в вызывающем потоке)
+ */
+#ifndef FTL_MOUNT_THREADS
+#if FS_THREAD_SAFE
+#define FTL_MOUNT_THREADS 4U
+#else
+#define FTL_MOUNT_THREADS 1U
+#endif
+#endif
+
+/*
+ * Элемент отображения: номер физического блока и ячейка сжатого блока
+ */
+#define FTL_MAP_ENTRY(PBI, SLOT) ((U16)(((SLOT) << 12U) | (PBI)))
+#define FTL_MAP_PBI(ENTRY) ((FTL_INDEX)((ENTRY) & 0x0FFFU))
+#define FTL_MAP_SLOT(ENTRY) ((U8)((ENTRY) >> 12U))
+
+
+/*
+ * FTL_FLAG_BAD: Блок изъят из работы (только в ОЗУ, во flash - таблица
+ *               изъятых страниц flash-драйвера)
  * FTL_FLAG_VALID: Блок содержит актуальные данные
  * FTL_FLAG_DIRTY: Блок устарел (данные должны перенестись в новый блок)
  * FTL_FLAG_FREE: Блок свободен для записи
  */
 typedef enum
 {
+  FTL_FLAG_BAD   = 0x0,
   FTL_FLAG_VALID = 0x1,
   FTL_FLAG_DIRTY = 0x2,
   FTL_FLAG_FREE  = 0x3
 } FTL_FLAG;
 
+/*
+ * FTL_FORMAT_RAW: Один логический блок без сжатия
+ * FTL_FORMAT_PACKED: Ячейки сжатых логических блоков
+ * FTL_FORMAT_KV: Записи ключ-значение (не отображается на логический блок)
+ */
+typedef enum
+{
+  FTL_FORMAT_RAW    = 0x0,
+  FTL_FORMAT_PACKED = 0x1,
+  FTL_FORMAT_KV     = 0x2
+} FTL_FORMAT;
+
 /*
  * ФИЗИЧЕСКИЙ БЛОК:
  *   flag : Статус состояния
  *   permission: Права доступа к блоку
  *   lbi: Логический адрес (4096 блоков * 256 байт = 1МБ)
+ *   format: Формат данных (у сжатых блоков lbi и crc32 не используются)
  *   crc32: CRC32 хеш (32 бита)
  */
 typedef struct __packed
 {
-  FTL_FLAG flag  : 2;  // 3 флага состояния
-  U16 lbi        : 12; // 4096 блоков по 256 байт = 1МБ
-  U8 reserved    : 2;  // 2 бита резерв
-  U32 crc32      : 32; // 32 бита хеш
+  FTL_FLAG flag     : 2;  // 3 флага состояния
+  U16 lbi           : 12; // 4096 блоков по 256 байт = 1МБ
+  FTL_FORMAT format : 2;  // формат данных
+  U32 crc32         : 32; // 32 бита хеш
 } FTL_BLOCK_TYPE;
 
+/*
+ * Размер данных в логическом блоке (250 байт)
+ */
+#define FTL_DATA_SIZE (FTL_BLOCK_SIZE - sizeof(FTL_BLOCK_TYPE))
+
+/*
+ * ЯЧЕЙКА СЖАТОГО БЛОКА:
+ *   lbi: Логический адрес (0xFFFF - ячейка не записана)
+ *   offset: Смещение данных от начала физического блока
+ *   length: Длина сжатых данных
+ *   (4 байта, несколько ячеек могут ссылаться на одни данные)
+ */
+typedef struct __packed
+{
+  U16 lbi;
+  U8 offset;
+  U8 length;
+} FTL_PACK_ENTRY_TYPE;
+
+/*
+ * ЗАГОЛОВОК ДАННЫХ ЯЧЕЙКИ (перед сжатыми данными):
+ *   crc32: CRC32 сжатых данных
+ *   sequence: Порядковый номер записи (см. FTL_SEQUENCE_TYPE)
+ *   (8 байт)
+ */
+typedef struct __packed
+{
+  U32 crc32;
+  U32 sequence;
+} FTL_PACK_CELL_TYPE;
+
+/*
+ * ФИЗИЧЕСКИЙ БЛОК СО СЖАТЫМИ ДАННЫМИ (дописывается по словам):
+ *   0-7: FTL_BLOCK_TYPE (format = FTL_FORMAT_PACKED) + 2 байта выравнивания
+ *   8-67: Ячейки FTL_PACK_ENTRY_TYPE (ячейка пишется после своих данных)
+ *   68-255: Данные: FTL_PACK_CELL_TYPE + сжатые данные (с границы слова)
+ */
+#define FTL_PACK_ENTRIES_OFFSET 8U
+#define FTL_PACK_DATA_OFFSET \
+  (FTL_PACK_ENTRIES_OFFSET + FTL_PACK_SLOTS * sizeof(FTL_PACK_ENTRY_TYPE))
+
+/*
+ * Сжатый блок длиннее половины области данных записывается без сжатия
+ */
+#define FTL_PACK_LIMIT \
+  ((FTL_BLOCK_SIZE - FTL_PACK_DATA_OFFSET) / 2U - sizeof(FTL_PACK_CELL_TYPE))
+
+/*
+ * Длина шифруемых данных ячейки (XTS шифрует не меньше одного блока AES,
+ * короткие сжатые данные дополняются 0xFF)
+ */
+#if FTL_ENCRYPT
+#define FTL_PACK_CIPHER_LENGTH(LENGTH) \
+  (((LENGTH) < CRYPT_BLOCK_SIZE) ? CRYPT_BLOCK_SIZE : (LENGTH))
+#else
+#define FTL_PACK_CIPHER_LENGTH(LENGTH) (LENGTH)
+#endif
+
+/*
+ * Размер данных ячейки во flash (заголовок + сжатые данные, кратно слову)
+ */
+#define FTL_PACK_ALIGNED(LENGTH) \
+  ((sizeof(FTL_PACK_CELL_TYPE) + FTL_PACK_CIPHER_LENGTH(LENGTH) + 3U) & ~3U)
+
+/*
+ * ПОРЯДКОВЫЙ НОМЕР ЗАПИСИ БЛОКА БЕЗ СЖАТИЯ:
+ *   sequence: Порядковый номер записи (общий счетчик блоков без сжатия
+ *             и ячеек сжатых блоков): из копий логического блока при
+ *             FTL_INIT актуальна копия с большим номером
+ *   check: ~sequence (несовпадение - номер не записан или запись прервана)
+ *   (8 байт)
+ *
+ * Номера хранятся в таблице в последних блоках сектора (по номеру на блок
+ * данных сектора) и стираются вместе с сектором. Номер пишется после
+ * блока: блок без номера - прерванная запись
+ */
+typedef struct
+{
+  U32 sequence;
+  U32 check;
+} FTL_SEQUENCE_TYPE;
+
+/*
+ * Первый порядковый номер (у номера 0 проверочное слово совпадает
+ * со стертым)
+ */
+#define FTL_SEQUENCE_FIRST 1U
+
+/*
+ * Блоков таблицы порядковых номеров в секторе из BLOCKS блоков
+ */
+#define FTL_SEQUENCE_BLOCKS(BLOCKS) \
+  (((BLOCKS) * sizeof(FTL_SEQUENCE_TYPE) + FTL_BLOCK_SIZE \
+    + sizeof(FTL_SEQUENCE_TYPE) - 1U) \
+   / (FTL_BLOCK_SIZE + sizeof(FTL_SEQUENCE_TYPE)))
+
+/*
+ * Ячейки сжатого блока и записи блока ключ-значение
+ * (FTL_HEADER_TYPE.slots):
+ *   биты 0-4: Количество отображенных ячеек или актуальных записей
+ *             (0 - блок устарел)
+ *   бит 7: Есть устаревшие ячейки или записи (блок уплотняется
+ *          при сборке мусора)
+ */
+#define FTL_SLOTS_LIVE 0x1FU
+#define FTL_SLOTS_STALE 0x80U
+
+/*
+ * ЗАПИСЬ КЛЮЧ-ЗНАЧЕНИЕ (за заголовком - ключ и значение):
+ *   sequence: Порядковый номер (0xFFFFFFFF - запись не записана): из
+ *             записей одного ключа актуальна запись с большим номером
+ *   crc32: CRC32 открытых ключа и значения
+ *   key_length: Длина ключа
+ *   value_length: Длина значения
+ *   tombstone: 1 - запись удаления ключа
+ *   space: Пространство ключей (FTL_KV_SPACE_USER - ключи FTL_KV_PUT)
+ *   (12 байт)
+ */
+typedef struct __packed
+{
+  U32 sequence;
+  U32 crc32;
+  U8 key_length;
+  U8 value_length;
+  U8 tombstone;
+  U8 space;
+} FTL_KV_RECORD_TYPE;
+
+/*
+ * Пространства ключей (одинаковые ключи разных пространств не совпадают):
+ *   FTL_KV_SPACE_USER: Ключи пользователя (стертый байт: записи без
+ *                      пространства относятся к пользователю)
+ *   FTL_KV_SPACE_SNAPSHOT: Снимки: номер снимка -> FTL_SNAPSHOT_TYPE.sequence
+ *   FTL_KV_SPACE_ROLLBACK: Откаты: номер отката -> start, end
+ *                          (FTL_ROLLBACK_TYPE)
+ */
+#define FTL_KV_SPACE_USER 0xFFU
+#define FTL_KV_SPACE_SNAPSHOT 0x00U
+#define FTL_KV_SPACE_ROLLBACK 0x01U
+
+/*
+ * ФИЗИЧЕСКИЙ БЛОК ЗАПИСЕЙ КЛЮЧ-ЗНАЧЕНИЕ (дописывается по словам):
+ *   0-7: FTL_BLOCK_TYPE (format = FTL_FORMAT_KV) + 2 байта выравнивания
+ *   8-255: Записи по возрастанию порядковых номеров (с границы слова)
+ */
+#define FTL_KV_DATA_OFFSET 8U
+
+/*
+ * Размер записи во flash (заголовок + ключ + значение, кратно слову)
+ */
+#define FTL_KV_ALIGNED(KEY_LENGTH, VALUE_LENGTH) \
+  ((sizeof(FTL_KV_RECORD_TYPE) + (KEY_LENGTH) + (VALUE_LENGTH) + 3U) & ~3U)
+
+/*
+ * Наибольшее количество записей в физическом блоке
+ */
+#define FTL_KV_RECORDS \
+  ((FTL_BLOCK_SIZE - FTL_KV_DATA_OFFSET) / FTL_KV_ALIGNED(1U, 0U))
+
+/*
+ * Количество элементов индекса ключей (степень двойки) и наибольшее
+ * количество ключей в индексе (удаленный ключ занимает элемент, пока
+ * хранится его запись удаления)
+ */
+#define FTL_KV_INDEX_SIZE 256U
+#define FTL_KV_KEYS_COUNT 192U
+
+/*
+ * Отображение логических блоков на физические (FTL_PBI_NONE - не записан):
+ *   биты 0-11: Номер физического блока
+ *   биты 12-15: Ячейка (для FTL_FORMAT_PACKED)
+ */
+typedef U16 FTL_MAP[FTL_BLOCKS_COUNT];
+
+/*
+ * СНИМОК:
+ *   active: Снимок существует
+ *   sequence: Порядковый номер записи на момент создания: во flash
+ *     хранится только он (FTL_KV_SPACE_SNAPSHOT), отображение снимка
+ *     при FTL_INIT собирается из копий с меньшими номерами
+ *   map: Отображение на момент создания снимка
+ *   (7941 байт)
+ */
+typedef struct
+{
+  U8 active;
+  U32 sequence;
+  FTL_MAP map;
+} FTL_SNAPSHOT_TYPE;
+
+/*
+ * ОТКАТ К СНИМКУ (во flash - FTL_KV_SPACE_ROLLBACK):
+ *   active: Запись отката существует
+ *   start: Номер создания снимка, к которому выполнен откат
+ *   end: Номер следующей записи на момент отката
+ *
+ * Копии с номерами start - end-1 отменены для текущего отображения
+ * и снимков, созданных после отката (их номера больше end). Отображение
+ * с границей LIMIT (номер создания снимка, UN_SET - текущее) состоит из
+ * новейших копий с номерами меньше LIMIT, кроме отмененных последним
+ * откатом с end < LIMIT; копии до его start отбираются так же с границей
+ * start (см. FTL_SNAPSHOT_VISIBLE)
+ */
+typedef struct
+{
+  U8 active;
+  U32 start;
+  U32 end;
+} FTL_ROLLBACK_TYPE;
+
 /*
  * table: Массив физических блоков
  *   0-63: SECTOR 2 (16 кб) (64 blocks)
@@ -49,444 +412,4049 @@ typedef struct __packed
  *   128-383: SECTOR 4 (64 кб) (256 blocks)
  *   384-895: SECTOR 5 (128 кб) (512 blocks)
  * (flash: 23812 байт (94 blocks))
+ * map: Отображение логических блоков на физические
+ * slots: Ячейки сжатых блоков (FTL_SLOTS_LIVE, FTL_SLOTS_STALE)
  * mode: Режим работы
  * pba: Физический адрес начала доступной памяти
  */
 typedef struct
 {
   FTL_BLOCK_TYPE table[FTL_BLOCKS_COUNT];
+  FTL_MAP map;
+  U8 slots[FTL_BLOCKS_COUNT];
   FTL_MODE mode;
   FLASH_ADDRESS pba;
 } FTL_HEADER_TYPE;
 
 /*
- * Служебные данные FTL
+ * ОТКРЫТЫЙ БЛОК ДЛЯ СЖАТЫХ ДАННЫХ:
+ *   pbi: Номер физического блока (UN_SET - не открыт)
+ *   count: Количество записанных ячеек
+ *   end: Смещение свободного места для сжатых данных
  */
-static FTL_HEADER_TYPE g_ftl_header =
-(FTL_HEADER_TYPE){
-  .mode = FTL_MODE_SUPERVISOR
-};
+typedef struct
+{
+  FTL_INDEX pbi;
+  SIZE32 count;
+  SIZE32 end;
+} FTL_PACK_TYPE;
 
+/*
+ * ФРОНТ ЗАПИСИ (сектор, заполняемый по порядку):
+ *   sector: Номер сектора (FLASH_SECTORS_COUNT - не выбран)
+ *   next: Следующий проверяемый физический блок
+ *   end: Первый физический блок за концом сектора
+ */
+typedef struct
+{
+  FLASH_SECTOR_ID sector;
+  FTL_INDEX next;
+  FTL_INDEX end;
+} FTL_FRONTIER_TYPE;
 
+/*
+ * ЭЛЕМЕНТ ИНДЕКСА КЛЮЧЕЙ:
+ *   hash: CRC32 ключа
+ *   sequence: Порядковый номер актуальной записи ключа
+ *   pbi: Физический блок записи (FTL_PBI_NONE - элемент свободен)
+ *   offset: Смещение записи от начала физического блока
+ *   tombstone: Актуальная запись - запись удаления
+ */
+typedef struct
+{
+  U32 hash;
+  U32 sequence;
+  U16 pbi;
+  U8 offset;
+  U8 tombstone;
+} FTL_KV_ENTRY_TYPE;
 
 /*
- * ВЫДЕЛИТЬ БЛОК:
- *   pbi: Номер физического блока
+ * ХРАНИЛИЩЕ КЛЮЧ-ЗНАЧЕНИЕ (ОЗУ, 3 КБ):
+ *   block: Открытый блок записей (count не используется)
+ *   sequence: Номер следующей записи
+ *   count: Занятых элементов индекса
+ *   index: Индекс ключей с открытой адресацией:
+ *     CRC32 ключа % FTL_KV_INDEX_SIZE -> запись
+ *     (совпадение проверяется сравнением ключа записи во flash)
+ */
+typedef struct
+{
+  FTL_PACK_TYPE block;
+  U32 sequence;
+  SIZE32 count;
+  FTL_KV_ENTRY_TYPE index[FTL_KV_INDEX_SIZE];
+} FTL_KV_TYPE;
+
+#if FTL_MOUNT_THREADS > 1U
+/*
+ * ПАРАЛЛЕЛЬНОЕ ЧТЕНИЕ ТАБЛИЦЫ (ОЗУ, 79400 байт, используется в FTL_INIT):
+ *   maps[sector]: Отображение, восстановленное из блоков сектора
+ *   sequences[sector]: Номер, следующий за номерами копий сектора
+ *   errors[sector]: Статус чтения сектора
+ *   next: Следующий нечитанный сектор (от FTL_SECTOR_FIRST)
+ */
+typedef struct
+{
+  FTL_MAP maps[FTL_WEAR_SECTORS];
+  U32 sequences[FTL_WEAR_SECTORS];
+  RETURN_CODE errors[FTL_WEAR_SECTORS];
+  volatile U32 next;
+} FTL_SCAN_TYPE;
+#endif
+
+/*
+ * FTL ТОМА:
+ *   header: Служебные данные FTL
+ *   snapshots: Снимки (ОЗУ, 7941 байт * FTL_SNAPSHOTS_COUNT):
+ *     устаревшие блоки, на которые ссылается снимок, сборщик мусора
+ *     переносит
+ *   rollbacks: Откаты к снимкам (отмененные номера записи)
+ *   barrier: Наименьший номер данных, на которые может ссылаться повтор
+ *     (FTL_PACK_DEDUP): ссылка получает номер данных и не должна попасть
+ *     в снимок или в отмененные номера
+ *   pinned: Битовая карта закрепленных снимками физических блоков
+ *     (ОЗУ, 496 байт)
+ *   views: Количество отображений физического блока в память
+ *     (FTL_VIEW_OPEN): сектор с отображенным блоком не стирается
+ *     (ОЗУ, 3968 байт)
+ *   pack: Открытые блоки сжатых данных (по одному на фронт записи)
+ *   heat: Нагрев логических блоков (ОЗУ, 3968 байт)
+ *   dedup: Индекс одинаковых блоков (ОЗУ, 512 байт):
+ *     CRC32 сжатых данных % FTL_DEDUP_SIZE -> элемент отображения ячейки
+ *     (подсказка: совпадение проверяется сравнением данных во flash)
+ *   frontiers: Фронты записи новых данных (горячие и холодные данные
+ *     в разных секторах)
+ *   kv: Хранилище ключ-значение
+ *   stats: Статистика FTL
+ *   gc_cursor: Следующий сектор пошаговой сборки мусора
+ *     (FLASH_SECTORS_COUNT - цикл не начат)
+ *   free_count: Количество свободных блоков
+ *   reserve: Резерв свободных блоков сборщика мусора - блоков в наибольшем
+ *     секторе: при таком запасе любой сектор можно освободить переносом.
+ *     Запись данных резерв не получает
+ *   gc_trigger: Количество свободных блоков, при котором запись данных
+ *     запускает сборку мусора
+ *   sequence: Порядковый номер следующей записи блока или ячейки
+ *     (восстанавливается при FTL_INIT)
+ *   lock: Блокировка отображения и таблиц FTL: чтение блоков идет
+ *     совместно, запись, сборка мусора и снимки - монопольно
+ *   lock_ready: Блокировка инициализирована (первым FTL_INIT тома)
+ *   scan: Частичные отображения параллельного чтения таблицы
+ */
+typedef struct
+{
+  FTL_HEADER_TYPE header;
+  FTL_SNAPSHOT_TYPE snapshots[FTL_SNAPSHOTS_COUNT];
+  FTL_ROLLBACK_TYPE rollbacks[FTL_ROLLBACKS_COUNT];
+  U32 barrier;
+  U32 pinned[(FTL_BLOCKS_COUNT + 31U) / 32U];
+  U8 views[FTL_BLOCKS_COUNT];
+  FTL_PACK_TYPE pack[FTL_FRONTIERS_COUNT];
+  U8 heat[FTL_BLOCKS_COUNT];
+  U16 dedup[FTL_DEDUP_SIZE];
+  FTL_FRONTIER_TYPE frontiers[FTL_FRONTIERS_COUNT];
+  FTL_KV_TYPE kv;
+  FTL_STATS_TYPE stats;
+  FLASH_SECTOR_ID gc_cursor;
+  SIZE32 free_count;
+  SIZE32 reserve;
+  SIZE32 gc_trigger;
+  U32 sequence;
+#if FS_THREAD_SAFE
+  FS_RWLOCK_TYPE lock;
+  U8 lock_ready;
+#endif
+#if FTL_MOUNT_THREADS > 1U
+  FTL_SCAN_TYPE scan;
+#endif
+} FTL_VOLUME_TYPE;
+
+/*
+ * FTL томов (нулевое состояние - режим FTL_MODE_SUPERVISOR; остальные поля
+ * задает FTL_INIT, поэтому тома размещаются в .bss)
+ */
+static FTL_VOLUME_TYPE g_ftl_volumes[FS_VOLUMES_COUNT];
+
+/*
+ * FTL тома, выбранного потоком
+ */
+static FS_THREAD_LOCAL FTL_VOLUME_TYPE * g_ftl = &g_ftl_volumes[0U];
+
+
+
+/*
+ * ФИЗИЧЕСКИЕ БЛОКИ ДАННЫХ СЕКТОРА:
+ *   SECTOR_ID: Номер сектора FTL
+ *   start_pbi: Первый физический блок
+ *   end_pbi: Первый физический блок за концом данных (за ним - таблица
+ *            порядковых номеров сектора, ее блоки не выдаются и в таблице
+ *            FTL остаются изъятыми)
+ */
+void FTL_SECTOR_RANGE(
+/* IN  */ const FLASH_SECTOR_ID SECTOR_ID,
+/* OUT */ FTL_INDEX * start_pbi,
+/* OUT */ FTL_INDEX * end_pbi)
+{
+  FLASH_ADDRESS m_start_pba = 0x0;
+  FLASH_ADDRESS m_end_pba = 0x0;
+
+  /* no need to check m_select_error */
+  RETURN_CODE m_borders_error = NO_ERROR;
+  FLASH_SECTOR_BORDERS(SECTOR_ID, &m_start_pba, &m_end_pba, &m_borders_error);
+
+  *start_pbi = (m_start_pba - g_ftl->header.pba) / FTL_BLOCK_SIZE;
+  *end_pbi = (m_end_pba + 1U - g_ftl->header.pba) / FTL_BLOCK_SIZE;
+  *end_pbi -= FTL_SEQUENCE_BLOCKS(*end_pbi - *start_pbi);
+}
+
+/*
+ * АДРЕС ПОРЯДКОВОГО НОМЕРА БЛОКА БЕЗ СЖАТИЯ:
+ *   PBI: Номер физического блока
+ *   pba: Адрес элемента FTL_SEQUENCE_TYPE в таблице сектора блока
  *   return_code: Статус операции
- *     NO_ERROR: Блок выделен
- *     OPERATION_FAILED: Не найден свободный блок
+ *     NO_ERROR: Адрес вычислен
+ *     INVALID_PARAM: Блок вне области данных FTL
  */
-void FTL_BLOCK_ALLOCATE(
-/* OUT */ FTL_INDEX * pbi,
+void FTL_SEQUENCE_ADDRESS(
+/* IN  */ const FTL_INDEX PBI,
+/* OUT */ FLASH_ADDRESS * pba,
 /* OUT */ RETURN_CODE * return_code)
 {
-  for(register FTL_INDEX i = 0U; i < FTL_BLOCKS_COUNT; i++)
+  FLASH_SECTOR_ID m_id;
+  RETURN_CODE m_find_error = NO_ERROR;
+  FLASH_SECTOR_FIND(
+    PBI * FTL_BLOCK_SIZE + g_ftl->header.pba, &m_id, &m_find_error
+  );
+  if((NO_ERROR != m_find_error) || (m_id < FTL_SECTOR_FIRST))
+  {
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  FTL_INDEX m_start_pbi;
+  FTL_INDEX m_end_pbi;
+  FTL_SECTOR_RANGE(m_id, &m_start_pbi, &m_end_pbi);
+  if(PBI >= m_end_pbi)
+  {
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  *pba = m_end_pbi * FTL_BLOCK_SIZE + g_ftl->header.pba
+    + (PBI - m_start_pbi) * sizeof(FTL_SEQUENCE_TYPE);
+  *return_code = NO_ERROR;
+}
+
+/*
+ * ПРОЧИТАТЬ ЭЛЕМЕНТ ТАБЛИЦЫ ПОРЯДКОВЫХ НОМЕРОВ:
+ *   PBI: Номер физического блока
+ *   entry: Элемент таблицы (как записан во flash)
+ *   return_code: Статус операции
+ *     NO_ERROR: Элемент прочитан
+ *     INVALID_PARAM: Блок вне области данных FTL
+ *     OPERATION_FAILED: Ошибка чтения
+ */
+void FTL_SEQUENCE_LOAD(
+/* IN  */ const FTL_INDEX PBI,
+/* OUT */ FTL_SEQUENCE_TYPE * entry,
+/* OUT */ RETURN_CODE * return_code)
+{
+  FLASH_ADDRESS m_pba;
+  FTL_SEQUENCE_ADDRESS(PBI, &m_pba, return_code);
+  if(NO_ERROR != *return_code)
+  {
+    return;
+  }
+
+  RETURN_CODE m_read_error = NO_ERROR;
+  FLASH_READ(m_pba, sizeof(FTL_SEQUENCE_TYPE), entry, &m_read_error);
+  *return_code = (NO_ERROR == m_read_error) ? NO_ERROR : OPERATION_FAILED;
+}
+
+/*
+ * ЗАПИСАТЬ ПОРЯДКОВЫЙ НОМЕР БЛОКА БЕЗ СЖАТИЯ (после данных блока):
+ *   PBI: Номер физического блока
+ *   SEQUENCE: Порядковый номер записи
+ *   return_code: Статус операции
+ *     NO_ERROR: Номер записан
+ *     OPERATION_FAILED: Ошибка записи (блок изымается вызывающим)
+ */
+void FTL_SEQUENCE_WRITE(
+/* IN  */ const FTL_INDEX PBI,
+/* IN  */ const U32 SEQUENCE,
+/* OUT */ RETURN_CODE * return_code)
+{
+  FLASH_ADDRESS m_pba;
+  RETURN_CODE m_address_error = NO_ERROR;
+  FTL_SEQUENCE_ADDRESS(PBI, &m_pba, &m_address_error);
+  if(NO_ERROR != m_address_error)
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  FTL_SEQUENCE_TYPE m_entry =
+  (FTL_SEQUENCE_TYPE){
+    .sequence = SEQUENCE,
+    .check = ~SEQUENCE
+  };
+  RETURN_CODE m_write_error = NO_ERROR;
+  FLASH_WRITE(m_pba, sizeof(FTL_SEQUENCE_TYPE), &m_entry, &m_write_error);
+  *return_code = (NO_ERROR == m_write_error) ? NO_ERROR : OPERATION_FAILED;
+}
+
+/*
+ * ПРОВЕРКА ИЗЪЯТИЯ ФИЗИЧЕСКОГО БЛОКА:
+ *   PBI: Номер физического блока
+ *   bad: 1 - изъята страница блока или страница таблицы с его порядковым
+ *        номером (блок не выдается для записи)
+ *   return_code: Статус операции
+ *     NO_ERROR: Проверка выполнена
+ *     INVALID_PARAM: Блок вне области данных FTL
+ */
+void FTL_BLOCK_CHECK(
+/* IN  */ const FTL_INDEX PBI,
+/* OUT */ U8 * bad,
+/* OUT */ RETURN_CODE * return_code)
+{
+  FLASH_ADDRESS m_pba;
+  FTL_SEQUENCE_ADDRESS(PBI, &m_pba, return_code);
+  if(NO_ERROR != *return_code)
+  {
+    return;
+  }
+
+  U8 m_table_bad = 0U;
+  FLASH_BADBLOCK_CHECK(
+    PBI * FTL_BLOCK_SIZE + g_ftl->header.pba, bad, return_code
+  );
+  FLASH_BADBLOCK_CHECK(m_pba, &m_table_bad, return_code);
+  *bad = *bad || m_table_bad;
+}
+
+/*
+ * ПРОЧИТАТЬ ПОРЯДКОВЫЙ НОМЕР КОПИИ ЛОГИЧЕСКОГО БЛОКА:
+ *   ENTRY: Элемент отображения (блок без сжатия или ячейка сжатого блока)
+ *   sequence: Порядковый номер записи
+ *   return_code: Статус операции
+ *     NO_ERROR: Номер прочитан
+ *     NO_ACTION: Номер не записан или запись прервана
+ *     OPERATION_FAILED: Ошибка чтения или ячейка повреждена
+ */
+void FTL_SEQUENCE_READ(
+/* IN  */ const U16 ENTRY,
+/* OUT */ U32 * sequence,
+/* OUT */ RETURN_CODE * return_code)
+{
+  const FTL_INDEX M_PBI = FTL_MAP_PBI(ENTRY);
+  const FLASH_ADDRESS M_PBA = M_PBI * FTL_BLOCK_SIZE + g_ftl->header.pba;
+
+  /* 1. Блок без сжатия: номер в таблице сектора */
+  if(FTL_FORMAT_PACKED != g_ftl->header.table[M_PBI].format)
   {
-    if(g_ftl_header.table[i].flag == FTL_FLAG_FREE)
+    FTL_SEQUENCE_TYPE m_entry;
+    RETURN_CODE m_load_error = NO_ERROR;
+    FTL_SEQUENCE_LOAD(M_PBI, &m_entry, &m_load_error);
+    if(NO_ERROR != m_load_error)
     {
-      *pbi = i;
-      *return_code = NO_ERROR;
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+    if(m_entry.check != ~m_entry.sequence)
+    {
+      *return_code = NO_ACTION;
       return;
     }
+    *sequence = m_entry.sequence;
+    *return_code = NO_ERROR;
+    return;
   }
-  *return_code = OPERATION_FAILED;
+
+  /* 2. Ячейка сжатого блока: номер в заголовке ее данных */
+  U32 m_words[sizeof(FTL_PACK_CELL_TYPE) / sizeof(U32)];
+  RETURN_CODE m_read_error = NO_ERROR;
+  FLASH_READ(
+    M_PBA + FTL_PACK_ENTRIES_OFFSET
+      + FTL_MAP_SLOT(ENTRY) * sizeof(FTL_PACK_ENTRY_TYPE),
+    sizeof(FTL_PACK_ENTRY_TYPE), m_words, &m_read_error
+  );
+  FTL_PACK_ENTRY_TYPE m_entry;
+  STD_MEMCPY(sizeof(FTL_PACK_ENTRY_TYPE), m_words, &m_entry);
+  if((NO_ERROR != m_read_error)
+  || (m_entry.offset < FTL_PACK_DATA_OFFSET)
+  || (m_entry.offset + FTL_PACK_ALIGNED(m_entry.length) > FTL_BLOCK_SIZE))
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  FLASH_READ(
+    M_PBA + m_entry.offset, sizeof(FTL_PACK_CELL_TYPE), m_words,
+    &m_read_error
+  );
+  if(NO_ERROR != m_read_error)
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  FTL_PACK_CELL_TYPE m_cell;
+  STD_MEMCPY(sizeof(FTL_PACK_CELL_TYPE), m_words, &m_cell);
+  if((U32)UN_SET == m_cell.sequence)
+  {
+    *return_code = NO_ACTION;
+    return;
+  }
+  *sequence = m_cell.sequence;
+  *return_code = NO_ERROR;
+}
+
+/*
+ * ПЕРЕСЧЕТ СВОБОДНЫХ БЛОКОВ (после чтения таблицы и стирания сектора)
+ */
+void FTL_FREE_RECOUNT(void)
+{
+  g_ftl->free_count = 0U;
+  for(register FTL_INDEX i = 0U; i < FTL_BLOCKS_COUNT; i++)
+  {
+    if(g_ftl->header.table[i].flag == FTL_FLAG_FREE)
+    {
+      g_ftl->free_count++;
+    }
+  }
+
+  /* Запас восстановлен: следующая сборка - на обычном пороге */
+  if(g_ftl->free_count >= g_ftl->reserve + FTL_GC_THRESHOLD)
+  {
+    g_ftl->gc_trigger = g_ftl->reserve + FTL_GC_THRESHOLD;
+  }
+}
+
+/*
+ * ВЫБРАТЬ СЕКТОР СО СВОБОДНЫМИ БЛОКАМИ ПО ИЗНОСУ:
+ *   EXCLUDE: Исключаемый сектор (FLASH_SECTORS_COUNT - без исключений)
+ *   MOST_WORN: 0 - наименее изношенный сектор, 1 - наиболее изношенный
+ *   sector_id: Номер сектора (при равном износе - меньший номер)
+ *   return_code: Статус операции
+ *     NO_ERROR: Сектор выбран
+ *     OPERATION_FAILED: Свободных блоков нет
+ */
+void FTL_WEAR_SECTOR(
+/* IN  */ const FLASH_SECTOR_ID EXCLUDE,
+/* IN  */ const U8 MOST_WORN,
+/* OUT */ FLASH_SECTOR_ID * sector_id,
+/* OUT */ RETURN_CODE * return_code)
+{
+  *return_code = OPERATION_FAILED;
+
+  SIZE32 m_best_wear = 0U;
+  for(FLASH_SECTOR_ID m_id = FTL_SECTOR_FIRST; m_id < FLASH_SECTORS_COUNT;
+      m_id++)
+  {
+    if(EXCLUDE == m_id)
+    {
+      continue;
+    }
+
+    FLASH_SECTOR_TYPE m_sector;
+    RETURN_CODE m_select_error = NO_ERROR;
+    FLASH_SECTOR_SELECT(m_id, &m_sector, &m_select_error);
+    if((NO_ERROR == *return_code)
+    && (MOST_WORN ? (m_sector.wear <= m_best_wear)
+                  : (m_sector.wear >= m_best_wear)))
+    {
+      continue;
+    }
+
+    FTL_INDEX m_start_pbi;
+    FTL_INDEX m_end_pbi;
+    FTL_SECTOR_RANGE(m_id, &m_start_pbi, &m_end_pbi);
+    for(register FTL_INDEX i = m_start_pbi; i < m_end_pbi; i++)
+    {
+      if(g_ftl->header.table[i].flag == FTL_FLAG_FREE)
+      {
+        *sector_id = m_id;
+        m_best_wear = m_sector.wear;
+        *return_code = NO_ERROR;
+        break;
+      }
+    }
+  }
+}
+
+/*
+ * ВЫДЕЛИТЬ БЛОК НА ФРОНТЕ ЗАПИСИ:
+ *   EXCLUDE: Исключаемый сектор (FLASH_SECTORS_COUNT - без исключений)
+ *   MOST_WORN: Выбор нового сектора (см. FTL_WEAR_SECTOR)
+ *   frontier: Фронт записи
+ *   pbi: Номер физического блока
+ *   return_code: Статус операции
+ *     NO_ERROR: Блок выделен
+ *     OPERATION_FAILED: Не найден свободный блок
+ */
+void FTL_FRONTIER_ALLOCATE(
+/* IN    */ const FLASH_SECTOR_ID EXCLUDE,
+/* IN    */ const U8 MOST_WORN,
+/* INOUT */ FTL_FRONTIER_TYPE * frontier,
+/* OUT   */ FTL_INDEX * pbi,
+/* OUT   */ RETURN_CODE * return_code)
+{
+  for(;;)
+  {
+    /* 1. Следующий свободный блок текущего сектора */
+    if((FLASH_SECTORS_COUNT != frontier->sector)
+    && (EXCLUDE != frontier->sector))
+    {
+      for(; frontier->next < frontier->end; frontier->next++)
+      {
+        if(g_ftl->header.table[frontier->next].flag == FTL_FLAG_FREE)
+        {
+          *pbi = frontier->next++;
+          g_ftl->free_count--;
+          *return_code = NO_ERROR;
+          return;
+        }
+      }
+    }
+
+    /* 2. Сектор исчерпан: новый сектор по износу */
+    RETURN_CODE m_wear_error = NO_ERROR;
+    FTL_WEAR_SECTOR(EXCLUDE, MOST_WORN, &frontier->sector, &m_wear_error);
+    if(NO_ERROR != m_wear_error)
+    {
+      frontier->sector = FLASH_SECTORS_COUNT;
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+    FTL_SECTOR_RANGE(frontier->sector, &frontier->next, &frontier->end);
+  }
+}
+
+/*
+ * ПОЛНЫЙ ЦИКЛ СБОРКИ МУСОРА (вызывающий уже владеет FTL монопольно):
+ *   return_code: Статус операции
+ *     NO_ERROR: Сборка выполнена
+ *     OPERATION_FAILED: Ошибка переноса или стирания
+ */
+void FTL_GC_RUN(
+/* OUT */ RETURN_CODE * return_code);
+
+/*
+ * ВЫДЕЛИТЬ БЛОК НА ФРОНТЕ ЗАПИСИ ДАННЫХ:
+ *   FRONTIER: Фронт записи (FTL_FRONTIER_HOT или FTL_FRONTIER_COLD)
+ *   pbi: Номер физического блока
+ *   return_code: Статус операции
+ *     NO_ERROR: Блок выделен
+ *     NO_ACTION: Нет места - свободные блоки исчерпаны до резерва
+ *     OPERATION_FAILED: Ошибка сборки мусора
+ *
+ * Горячие данные пишутся в наименее изношенный сектор, холодные -
+ * в наиболее изношенный. Сектор другого фронта занимается, только
+ * когда свободных блоков больше нигде нет. При запасе свободных блоков
+ * не больше g_ftl->gc_trigger сначала выполняется сборка мусора:
+ * открытые сжатые блоки и блок ключ-значение закрываются.
+ */
+void FTL_BLOCK_ALLOCATE(
+/* IN  */ const FTL_INDEX FRONTIER,
+/* OUT */ FTL_INDEX * pbi,
+/* OUT */ RETURN_CODE * return_code)
+{
+  /* 1. Сборка мусора до исчерпания свободных блоков */
+  RETURN_CODE m_gc_error = NO_ERROR;
+  if(g_ftl->free_count <= g_ftl->gc_trigger)
+  {
+    FTL_GC_RUN(&m_gc_error);
+  }
+
+  /* 2. Резерв остается сборщику мусора для переноса */
+  if(g_ftl->free_count <= g_ftl->reserve)
+  {
+    *return_code
+      = (OPERATION_FAILED == m_gc_error) ? OPERATION_FAILED : NO_ACTION;
+    return;
+  }
+
+  const U8 M_MOST_WORN = (FTL_FRONTIER_COLD == FRONTIER);
+  FTL_FRONTIER_ALLOCATE(
+    g_ftl->frontiers[FTL_FRONTIERS_COUNT - 1U - FRONTIER].sector, M_MOST_WORN,
+    &g_ftl->frontiers[FRONTIER], pbi, return_code
+  );
+  if(NO_ERROR != *return_code)
+  {
+    FTL_FRONTIER_ALLOCATE(
+      FLASH_SECTORS_COUNT, M_MOST_WORN, &g_ftl->frontiers[FRONTIER], pbi,
+      return_code
+    );
+  }
+}
+
+/*
+ * ПОЛУЧИТЬ ФИЗ. БЛОК ПО ЛОГИЧЕСКОМУ НОМЕРУ:
+ *   LBI: Номер логического блока
+ *   pbi: Номер физического блока
+ *   return_code: Статус операции
+ *     NO_ERROR: Найден физический блок с присвоенным логическим номером
+ *     INVALID_PARAM: Номер логического блока выходит за границы
+ *     OPERATION_FAILED: Блок не записан
+ */
+void FTL_BLOCK_GET(
+/* IN  */ const FTL_INDEX LBI,
+/* OUT */ FTL_INDEX * pbi,
+/* OUT */ RETURN_CODE * return_code)
+{
+  if(LBI >= FTL_BLOCKS_COUNT)
+  {
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  if(FTL_PBI_NONE == g_ftl->header.map[LBI])
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  *pbi = FTL_MAP_PBI(g_ftl->header.map[LBI]);
+  *return_code = NO_ERROR;
+}
+
+/*
+ * ОСВОБОДИТЬ ПРЕЖНЕЕ ОТОБРАЖЕНИЕ ЛОГИЧЕСКОГО БЛОКА:
+ *   ENTRY: Элемент отображения (FTL_PBI_NONE - блок не был записан)
+ *
+ * Физический блок со сжатыми данными устаревает вместе с последней ячейкой,
+ * блок ключ-значение (ENTRY с ячейкой 0) - с последней актуальной записью
+ */
+void FTL_MAP_RELEASE(
+/* IN  */ const U16 ENTRY)
+{
+  if(FTL_PBI_NONE == ENTRY)
+  {
+    return;
+  }
+
+  const FTL_INDEX M_PBI = FTL_MAP_PBI(ENTRY);
+  if(FTL_FORMAT_RAW != g_ftl->header.table[M_PBI].format)
+  {
+    g_ftl->header.slots[M_PBI]--;
+    g_ftl->header.slots[M_PBI] |= FTL_SLOTS_STALE;
+    if(0U != (g_ftl->header.slots[M_PBI] & FTL_SLOTS_LIVE))
+    {
+      return;
+    }
+    for(register SIZE32 f = 0U; f < FTL_FRONTIERS_COUNT; f++)
+    {
+      if(M_PBI == g_ftl->pack[f].pbi)
+      {
+        g_ftl->pack[f].pbi = (FTL_INDEX)UN_SET;
+      }
+    }
+    if(M_PBI == g_ftl->kv.block.pbi)
+    {
+      g_ftl->kv.block.pbi = (FTL_INDEX)UN_SET;
+    }
+  }
+  g_ftl->header.table[M_PBI].flag = FTL_FLAG_DIRTY;
+}
+
+/*
+ * ИЗЪЯТЬ ФИЗИЧЕСКИЙ БЛОК ПОСЛЕ ОШИБКИ ЗАПИСИ:
+ *   PBI: Номер физического блока
+ *
+ * Блок без актуальных данных изымается сразу. Ранее записанные ячейки
+ * сжатого блока и записи ключ-значение остаются читаемыми: блок
+ * закрывается для записи и уплотняется сборщиком мусора, после стирания
+ * сектора он остается изъятым по таблице flash-драйвера
+ */
+void FTL_BLOCK_RETIRE(
+/* IN  */ const FTL_INDEX PBI)
+{
+  g_ftl->stats.health.retired++;
+
+  for(register SIZE32 f = 0U; f < FTL_FRONTIERS_COUNT; f++)
+  {
+    if(PBI == g_ftl->pack[f].pbi)
+    {
+      g_ftl->pack[f].pbi = (FTL_INDEX)UN_SET;
+    }
+  }
+  if(PBI == g_ftl->kv.block.pbi)
+  {
+    g_ftl->kv.block.pbi = (FTL_INDEX)UN_SET;
+  }
+  for(register SIZE32 i = 0U; i < FTL_DEDUP_SIZE; i++)
+  {
+    if((FTL_PBI_NONE != g_ftl->dedup[i])
+    && (PBI == FTL_MAP_PBI(g_ftl->dedup[i])))
+    {
+      g_ftl->dedup[i] = FTL_PBI_NONE;
+    }
+  }
+
+  if((FTL_FLAG_VALID == g_ftl->header.table[PBI].flag)
+  && (FTL_FORMAT_RAW != g_ftl->header.table[PBI].format)
+  && (0U != (g_ftl->header.slots[PBI] & FTL_SLOTS_LIVE)))
+  {
+    g_ftl->header.slots[PBI] |= FTL_SLOTS_STALE;
+    return;
+  }
+  g_ftl->header.table[PBI].flag = FTL_FLAG_BAD;
+}
+
+/*
+ * ОТОБРАЗИТЬ ЛОГИЧЕСКИЙ БЛОК НА ЯЧЕЙКУ СЖАТОГО БЛОКА:
+ *   LBI: Номер логического блока
+ *   PBI: Номер физического блока
+ *   SLOT: Номер ячейки
+ *   ENTRY: Записываемая ячейка (во flash только незаписанная ячейка)
+ *   return_code: Статус операции
+ *     NO_ERROR: Ячейка записана, отображение обновлено
+ *     OPERATION_FAILED: Ошибка записи
+ */
+void FTL_PACK_LINK(
+/* IN  */ const FTL_INDEX LBI,
+/* IN  */ const FTL_INDEX PBI,
+/* IN  */ const U8 SLOT,
+/* IN  */ const FTL_PACK_ENTRY_TYPE ENTRY,
+/* OUT */ RETURN_CODE * return_code)
+{
+  U32 m_word;
+  STD_MEMCPY(sizeof(FTL_PACK_ENTRY_TYPE), (VOID_PTR)&ENTRY, &m_word);
+  RETURN_CODE m_write_error = NO_ERROR;
+  FLASH_WRITE(
+    PBI * FTL_BLOCK_SIZE + g_ftl->header.pba + FTL_PACK_ENTRIES_OFFSET
+      + SLOT * sizeof(FTL_PACK_ENTRY_TYPE),
+    sizeof(FTL_PACK_ENTRY_TYPE), &m_word, &m_write_error
+  );
+  if(NO_ERROR != m_write_error)
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  /* Новая ячейка учитывается до освобождения прежней */
+  const U16 M_OLD = g_ftl->header.map[LBI];
+  g_ftl->header.map[LBI] = FTL_MAP_ENTRY(PBI, SLOT);
+  g_ftl->header.slots[PBI]++;
+  FTL_MAP_RELEASE(M_OLD);
+
+  *return_code = NO_ERROR;
+}
+
+/*
+ * ЗАПИСАТЬ ПОВТОР СЖАТОГО БЛОКА ССЫЛКОЙ НА ИМЕЮЩИЕСЯ ДАННЫЕ:
+ *   LBI: Номер логического блока
+ *   DATA: Сжатые данные в виде для записи во flash (после шифрования)
+ *   LENGTH: Длина сжатых данных
+ *   CRC: CRC32 сжатых данных
+ *   return_code: Статус операции
+ *     NO_ERROR: Добавлена ячейка, ссылающаяся на те же данные
+ *     NO_ACTION: Одинаковых данных нет, в их блоке нет свободной ячейки,
+ *                данные записаны раньше текущей копии блока, снимка
+ *                или отката, или запись ячейки не прошла проверку
+ *                (блок изъят)
+ *     OPERATION_FAILED: Ошибка чтения
+ *
+ * Ссылка получает порядковый номер данных: она допустима, только если
+ * данные новее текущей копии логического блока (иначе при FTL_INIT
+ * актуальной осталась бы текущая копия) и не старше g_ftl->barrier
+ * (иначе при FTL_INIT ссылка попала бы в снимок или была бы отменена)
+ */
+void FTL_PACK_DEDUP(
+/* IN  */ const FTL_INDEX LBI,
+/* IN  */ const U8 * DATA,
+/* IN  */ const SIZE32 LENGTH,
+/* IN  */ const U32 CRC,
+/* OUT */ RETURN_CODE * return_code)
+{
+  /* 1. Подсказка индекса: блок должен быть актуальным сжатым блоком */
+  const U16 M_HINT = g_ftl->dedup[CRC % FTL_DEDUP_SIZE];
+  const FTL_INDEX M_PBI = FTL_MAP_PBI(M_HINT);
+  if((FTL_PBI_NONE == M_HINT)
+  || (FTL_FLAG_VALID != g_ftl->header.table[M_PBI].flag)
+  || (FTL_FORMAT_PACKED != g_ftl->header.table[M_PBI].format))
+  {
+    *return_code = NO_ACTION;
+    return;
+  }
+
+  U32 m_words[FTL_BLOCK_SIZE / sizeof(U32)];
+  const U8 * M_BLOCK = (const U8 *)m_words;
+  RETURN_CODE m_read_error = NO_ERROR;
+  FLASH_READ(
+    M_PBI * FTL_BLOCK_SIZE + g_ftl->header.pba, FTL_BLOCK_SIZE, m_words,
+    &m_read_error
+  );
+  if(NO_ERROR != m_read_error)
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  /* 2. Совпадение проверяется побайтно (CRC32 - только ключ поиска) */
+  FTL_PACK_ENTRY_TYPE m_entry;
+  STD_MEMCPY(
+    sizeof(FTL_PACK_ENTRY_TYPE),
+    (VOID_PTR)(M_BLOCK + FTL_PACK_ENTRIES_OFFSET
+      + FTL_MAP_SLOT(M_HINT) * sizeof(FTL_PACK_ENTRY_TYPE)),
+    &m_entry
+  );
+  if((m_entry.length != LENGTH)
+  || (m_entry.offset < FTL_PACK_DATA_OFFSET)
+  || (m_entry.offset + FTL_PACK_ALIGNED(LENGTH) > FTL_BLOCK_SIZE))
+  {
+    *return_code = NO_ACTION;
+    return;
+  }
+  FTL_PACK_CELL_TYPE m_cell;
+  STD_MEMCPY(
+    sizeof(FTL_PACK_CELL_TYPE), (VOID_PTR)(M_BLOCK + m_entry.offset), &m_cell
+  );
+  if((m_cell.crc32 != CRC) || (m_cell.sequence < g_ftl->barrier))
+  {
+    *return_code = NO_ACTION;
+    return;
+  }
+  for(register SIZE32 i = 0U; i < FTL_PACK_CIPHER_LENGTH(LENGTH); i++)
+  {
+    if(M_BLOCK[m_entry.offset + sizeof(FTL_PACK_CELL_TYPE) + i] != DATA[i])
+    {
+      *return_code = NO_ACTION;
+      return;
+    }
+  }
+
+  /* Данные должны быть новее текущей копии блока */
+  if(FTL_PBI_NONE != g_ftl->header.map[LBI])
+  {
+    U32 m_sequence = 0U;
+    RETURN_CODE m_sequence_error = NO_ERROR;
+    FTL_SEQUENCE_READ(g_ftl->header.map[LBI], &m_sequence, &m_sequence_error);
+    if((NO_ERROR != m_sequence_error) || (m_cell.sequence <= m_sequence))
+    {
+      *return_code = NO_ACTION;
+      return;
+    }
+  }
+
+  /* 3. Первая незаписанная ячейка (ячейки пишутся по порядку) */
+  U8 m_slot = 0U;
+  for(; m_slot < FTL_PACK_SLOTS; m_slot++)
+  {
+    U16 m_lbi;
+    STD_MEMCPY(
+      sizeof(U16),
+      (VOID_PTR)(M_BLOCK + FTL_PACK_ENTRIES_OFFSET
+        + m_slot * sizeof(FTL_PACK_ENTRY_TYPE)),
+      &m_lbi
+    );
+    if(0xFFFFU == m_lbi)
+    {
+      break;
+    }
+  }
+  if(m_slot >= FTL_PACK_SLOTS)
+  {
+    *return_code = NO_ACTION;
+    return;
+  }
+
+  m_entry.lbi = (U16)LBI;
+  FTL_PACK_LINK(LBI, M_PBI, m_slot, m_entry, return_code);
+  if(NO_ERROR != *return_code)
+  {
+    FTL_BLOCK_RETIRE(M_PBI);
+    g_ftl->stats.health.retries++;
+    *return_code = NO_ACTION;
+    return;
+  }
+  for(register SIZE32 f = 0U; f < FTL_FRONTIERS_COUNT; f++)
+  {
+    if(M_PBI == g_ftl->pack[f].pbi)
+    {
+      g_ftl->pack[f].count = m_slot + 1U;
+    }
+  }
+}
+
+/*
+ * ЗАПИСАТЬ СЖАТЫЙ БЛОК В ОТКРЫТЫЙ ФИЗИЧЕСКИЙ БЛОК:
+ *   LBI: Номер логического блока
+ *   FRONTIER: Фронт записи
+ *   DATA: Сжатые данные
+ *   LENGTH: Длина сжатых данных (не больше FTL_PACK_LIMIT)
+ *   return_code: Статус операции
+ *     NO_ERROR: Успешная запись
+ *     NO_ACTION: Нет места (см. FTL_BLOCK_ALLOCATE)
+ *     OPERATION_FAILED: Невозможно записать данные в память
+ */
+void FTL_PACK_WRITE(
+/* IN  */ const FTL_INDEX LBI,
+/* IN  */ const FTL_INDEX FRONTIER,
+/* IN  */ const VOID_PTR DATA,
+/* IN  */ const SIZE32 LENGTH,
+/* OUT */ RETURN_CODE * return_code)
+{
+  FTL_PACK_TYPE * m_pack = &g_ftl->pack[FRONTIER];
+  const SIZE32 M_ALIGNED = FTL_PACK_ALIGNED(LENGTH);
+  const SIZE32 M_CIPHER_LENGTH = FTL_PACK_CIPHER_LENGTH(LENGTH);
+
+  /* Данные во flash: заголовок ячейки + сжатые (зашифрованные) данные */
+  const SIZE32 M_HEADER_WORDS = sizeof(FTL_PACK_CELL_TYPE) / sizeof(U32);
+  U32 m_data[FTL_BLOCK_SIZE / sizeof(U32)];
+  STD_MEMSET(M_ALIGNED, 0xFFU, m_data);
+  STD_MEMCPY(LENGTH, DATA, m_data + M_HEADER_WORDS);
+  U32 m_crc32 = 0U;
+  HASH_CRC(m_data + M_HEADER_WORDS, M_CIPHER_LENGTH, &m_crc32);
+  m_data[0U] = m_crc32;
+#if FTL_ENCRYPT
+  /* Сектор XTS - CRC32: одинаковые данные дают одинаковый шифротекст */
+  U32 m_plain_crc32 = 0U;
+  CRYPT_XTS(
+    m_data + M_HEADER_WORDS, M_CIPHER_LENGTH, m_crc32, FTL_CRYPT_PACKED,
+    CRYPT_ENCRYPT, &m_plain_crc32
+  );
+#endif
+
+#if FTL_DEDUP
+  /* 0. Повтор данных, уже записанных в сжатый блок */
+  RETURN_CODE m_dedup_error = NO_ERROR;
+  FTL_PACK_DEDUP(
+    LBI, (const U8 *)(m_data + M_HEADER_WORDS), LENGTH, m_crc32,
+    &m_dedup_error
+  );
+  if(NO_ACTION != m_dedup_error)
+  {
+    if(NO_ERROR == m_dedup_error)
+    {
+      g_ftl->stats.compress.dedup_blocks++;
+    }
+    *return_code = m_dedup_error;
+    return;
+  }
+#endif
+  m_data[1U] = g_ftl->sequence++;
+
+  /* Блок, не прошедший проверку записи, изымается, запись повторяется */
+  for(SIZE32 m_attempt = 0U; m_attempt <= FTL_WRITE_RETRIES; m_attempt++)
+  {
+    /* 1. Открыть новый блок, если в текущем нет ячейки или места */
+    if(((FTL_INDEX)UN_SET == m_pack->pbi)
+    || (m_pack->count >= FTL_PACK_SLOTS)
+    || (m_pack->end + M_ALIGNED > FTL_BLOCK_SIZE))
+    {
+      m_pack->pbi = (FTL_INDEX)UN_SET;
+
+      FTL_INDEX m_pbi;
+      RETURN_CODE m_alloc_error = NO_ERROR;
+      FTL_BLOCK_ALLOCATE(FRONTIER, &m_pbi, &m_alloc_error);
+      if(NO_ERROR != m_alloc_error)
+      {
+        *return_code = m_alloc_error;
+        return;
+      }
+
+      /* CRC блока не записывается: у данных каждой ячейки свой CRC */
+      const FTL_BLOCK_TYPE M_META =
+      (FTL_BLOCK_TYPE){
+        .flag = FTL_FLAG_VALID,
+        .lbi = 0U,
+        .format = FTL_FORMAT_PACKED,
+        .crc32 = 0xFFFFFFFFUL
+      };
+      U32 m_header[FTL_PACK_ENTRIES_OFFSET / sizeof(U32)];
+      STD_MEMSET(sizeof(m_header), 0xFFU, m_header);
+      STD_MEMCPY(sizeof(FTL_BLOCK_TYPE), (VOID_PTR)&M_META, m_header);
+
+      RETURN_CODE m_write_error = NO_ERROR;
+      FLASH_WRITE(
+        m_pbi * FTL_BLOCK_SIZE + g_ftl->header.pba, sizeof(m_header), m_header,
+        &m_write_error
+      );
+      if(OPERATION_FAILED == m_write_error)
+      {
+        FTL_BLOCK_RETIRE(m_pbi);
+        g_ftl->stats.health.retries++;
+        continue;
+      }
+      if(NO_ERROR != m_write_error)
+      {
+        *return_code = OPERATION_FAILED;
+        return;
+      }
+
+      g_ftl->header.table[m_pbi] = M_META;
+      g_ftl->header.slots[m_pbi] = 0U;
+      m_pack->pbi = m_pbi;
+      m_pack->count = 0U;
+      m_pack->end = FTL_PACK_DATA_OFFSET;
+    }
+
+    /* 2. Данные, затем ячейка (незаписанная ячейка при сбое не читается) */
+    const FTL_INDEX M_PBI = m_pack->pbi;
+    RETURN_CODE m_write_error = NO_ERROR;
+    FLASH_WRITE(
+      M_PBI * FTL_BLOCK_SIZE + g_ftl->header.pba + m_pack->end,
+      M_ALIGNED, m_data, &m_write_error
+    );
+    if(NO_ERROR != m_write_error)
+    {
+      FTL_BLOCK_RETIRE(M_PBI);
+      g_ftl->stats.health.retries++;
+      continue;
+    }
+
+    const U8 M_SLOT = (U8)m_pack->count;
+    const FTL_PACK_ENTRY_TYPE M_ENTRY =
+    (FTL_PACK_ENTRY_TYPE){
+      .lbi = (U16)LBI,
+      .offset = (U8)m_pack->end,
+      .length = (U8)LENGTH
+    };
+    m_pack->count++;
+    m_pack->end += M_ALIGNED;
+
+    RETURN_CODE m_link_error = NO_ERROR;
+    FTL_PACK_LINK(LBI, M_PBI, M_SLOT, M_ENTRY, &m_link_error);
+    if(NO_ERROR != m_link_error)
+    {
+      FTL_BLOCK_RETIRE(M_PBI);
+      g_ftl->stats.health.retries++;
+      continue;
+    }
+    g_ftl->dedup[m_crc32 % FTL_DEDUP_SIZE] = FTL_MAP_ENTRY(M_PBI, M_SLOT);
+
+    *return_code = NO_ERROR;
+    return;
+  }
+
+  *return_code = OPERATION_FAILED;
+}
+
+/*
+ * ПРОЧИТАТЬ СЖАТЫЙ БЛОК:
+ *   BLOCK: Физический блок со сжатыми данными
+ *   SLOT: Номер ячейки
+ *   data: Блок данных (250 байт)
+ *   return_code: Статус операции
+ *     NO_ERROR: Блок успешно прочитан
+ *     OPERATION_FAILED: Данные повреждены
+ */
+void FTL_PACK_READ(
+/* IN  */ const U8 * BLOCK,
+/* IN  */ const U8 SLOT,
+/* OUT */ VOID_PTR data,
+/* OUT */ RETURN_CODE * return_code)
+{
+  FTL_PACK_ENTRY_TYPE m_entry;
+  STD_MEMCPY(
+    sizeof(FTL_PACK_ENTRY_TYPE),
+    (VOID_PTR)(BLOCK + FTL_PACK_ENTRIES_OFFSET
+      + SLOT * sizeof(FTL_PACK_ENTRY_TYPE)),
+    &m_entry
+  );
+  if((SLOT >= FTL_PACK_SLOTS)
+  || (m_entry.offset < FTL_PACK_DATA_OFFSET)
+  || (m_entry.offset + FTL_PACK_ALIGNED(m_entry.length) > FTL_BLOCK_SIZE))
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  const SIZE32 M_CIPHER_LENGTH = FTL_PACK_CIPHER_LENGTH(m_entry.length);
+  U8 m_data[FTL_BLOCK_SIZE - FTL_PACK_DATA_OFFSET];
+  STD_MEMCPY(
+    M_CIPHER_LENGTH,
+    (VOID_PTR)(BLOCK + m_entry.offset + sizeof(FTL_PACK_CELL_TYPE)), m_data
+  );
+  U32 m_stored = 0U;
+  STD_MEMCPY(sizeof(U32), (VOID_PTR)(BLOCK + m_entry.offset), &m_stored);
+  U32 m_crc32 = 0U;
+#if FTL_ENCRYPT
+  CRYPT_XTS(
+    m_data, M_CIPHER_LENGTH, m_stored, FTL_CRYPT_PACKED, CRYPT_DECRYPT,
+    &m_crc32
+  );
+#else
+  HASH_CRC(m_data, M_CIPHER_LENGTH, &m_crc32);
+#endif
+  if(m_crc32 != m_stored)
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  SIZE32 m_size = 0U;
+  RETURN_CODE m_decompress_error = NO_ERROR;
+  LZ_DECOMPRESS(
+    m_data, m_entry.length, FTL_DATA_SIZE, data, &m_size,
+    &m_decompress_error
+  );
+  if((NO_ERROR != m_decompress_error) || (FTL_DATA_SIZE != m_size))
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  *return_code = NO_ERROR;
+}
+
+/*
+ * СРАВНИТЬ КОПИЮ С ОТОБРАЖЕННОЙ (при инициализации):
+ *   OLD: Отображенная копия (FTL_PBI_NONE - нет)
+ *   ENTRY: Элемент отображения копии
+ *   SEQUENCE: Порядковый номер записи копии
+ *   return: 1 - копия ENTRY актуальнее
+ *
+ * Актуальна копия с большим номером. Копии с равным номером в разных
+ * блоках - перенос сборщиком мусора, прерванный до стирания сектора
+ * (данные совпадают): остается прежняя
+ */
+U8 FTL_SCAN_NEWER(
+/* IN  */ const U16 OLD,
+/* IN  */ const U16 ENTRY,
+/* IN  */ const U32 SEQUENCE)
+{
+  if(FTL_PBI_NONE == OLD)
+  {
+    return 1U;
+  }
+
+  U32 m_old_sequence = 0U;
+  RETURN_CODE m_sequence_error = NO_ERROR;
+  FTL_SEQUENCE_READ(OLD, &m_old_sequence, &m_sequence_error);
+  return (NO_ERROR != m_sequence_error)
+      || ((m_old_sequence < SEQUENCE)
+        || ((m_old_sequence == SEQUENCE)
+          && (FTL_MAP_PBI(OLD) == FTL_MAP_PBI(ENTRY))));
+}
+
+/*
+ * ОТОБРАЗИТЬ КОПИЮ ЛОГИЧЕСКОГО БЛОКА (при инициализации):
+ *   LBI: Номер логического блока
+ *   ENTRY: Элемент отображения копии (ячейка сжатого блока уже учтена
+ *          в FTL_HEADER_TYPE.slots)
+ *   SEQUENCE: Порядковый номер записи копии
+ *   map: Восстанавливаемое отображение
+ *
+ * Из двух копий (FTL_SCAN_NEWER) неактуальная освобождается
+ */
+void FTL_SCAN_MAP(
+/* IN  */ const FTL_INDEX LBI,
+/* IN  */ const U16 ENTRY,
+/* IN  */ const U32 SEQUENCE,
+/* INOUT */ U16 * map)
+{
+  const U16 M_OLD = map[LBI];
+  if(!FTL_SCAN_NEWER(M_OLD, ENTRY, SEQUENCE))
+  {
+    FTL_MAP_RELEASE(ENTRY);
+    return;
+  }
+
+  map[LBI] = ENTRY;
+  FTL_MAP_RELEASE(M_OLD);
+}
+
+/*
+ * ВОССТАНОВИТЬ ОТОБРАЖЕНИЕ ЯЧЕЕК СЖАТОГО БЛОКА (при инициализации):
+ *   PBI: Номер физического блока
+ *   map: Восстанавливаемое отображение
+ *   sequence: Номер, следующий за номерами прочитанных копий
+ *   return_code: Статус операции
+ *     NO_ERROR: Ячейки прочитаны
+ *     OPERATION_FAILED: Ошибка чтения
+ */
+void FTL_PACK_SCAN(
+/* IN  */ const FTL_INDEX PBI,
+/* INOUT */ U16 * map,
+/* INOUT */ U32 * sequence,
+/* OUT */ RETURN_CODE * return_code)
+{
+  U32 m_buffer[FTL_BLOCK_SIZE / sizeof(U32)];
+  const U8 * M_BLOCK = (const U8 *)m_buffer;
+  RETURN_CODE m_read_error = NO_ERROR;
+  FLASH_READ(
+    PBI * FTL_BLOCK_SIZE + g_ftl->header.pba, sizeof(m_buffer), m_buffer,
+    &m_read_error
+  );
+  if(NO_ERROR != m_read_error)
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  /* Копии блока сравниваются по номерам записи данных ячеек */
+  g_ftl->header.slots[PBI] = 0U;
+  for(register U8 i = 0U; i < FTL_PACK_SLOTS; i++)
+  {
+    FTL_PACK_ENTRY_TYPE m_entry;
+    STD_MEMCPY(
+      sizeof(FTL_PACK_ENTRY_TYPE),
+      (VOID_PTR)(M_BLOCK + FTL_PACK_ENTRIES_OFFSET
+        + i * sizeof(FTL_PACK_ENTRY_TYPE)),
+      &m_entry
+    );
+    if((m_entry.lbi >= FTL_BLOCKS_COUNT)
+    || (m_entry.offset < FTL_PACK_DATA_OFFSET)
+    || (m_entry.offset + FTL_PACK_ALIGNED(m_entry.length) > FTL_BLOCK_SIZE))
+    {
+      continue;
+    }
+    FTL_PACK_CELL_TYPE m_cell;
+    STD_MEMCPY(
+      sizeof(FTL_PACK_CELL_TYPE), (VOID_PTR)(M_BLOCK + m_entry.offset),
+      &m_cell
+    );
+    if((U32)UN_SET == m_cell.sequence)
+    {
+      continue;
+    }
+    if(m_cell.sequence >= *sequence)
+    {
+      *sequence = m_cell.sequence + 1U;
+    }
+
+    g_ftl->header.slots[PBI]++;
+    FTL_SCAN_MAP(m_entry.lbi, FTL_MAP_ENTRY(PBI, i), m_cell.sequence, map);
+  }
+
+  /* Освобождение отвергнутой копии могло отметить блок устаревшим
+   * до подсчета остальных ячеек */
+  g_ftl->header.table[PBI].flag
+    = (0U != (g_ftl->header.slots[PBI] & FTL_SLOTS_LIVE))
+      ? FTL_FLAG_VALID : FTL_FLAG_DIRTY;
+
+  *return_code = NO_ERROR;
+}
+
+/*
+ * ПЕРЕНЕСТИ СЖАТЫЙ БЛОК (сборка мусора, устаревшие ячейки не переносятся):
+ *   OLD_PBI: Номер переносимого физического блока
+ *   NEW_PBI: Номер свободного физического блока
+ *   BLOCK: Содержимое переносимого блока
+ *   return_code: Статус операции
+ *     NO_ERROR: Блок перенесен
+ *     NO_ACTION: Актуальных ячеек нет (ничего не записано)
+ *     OPERATION_FAILED: Ошибка записи
+ */
+void FTL_PACK_MOVE(
+/* IN  */ const FTL_INDEX OLD_PBI,
+/* IN  */ const FTL_INDEX NEW_PBI,
+/* IN  */ const U8 * BLOCK,
+/* OUT */ RETURN_CODE * return_code)
+{
+  U32 m_image[FTL_BLOCK_SIZE / sizeof(U32)];
+  STD_MEMSET(sizeof(m_image), 0xFFU, m_image);
+  U8 * m_bytes = (U8 *)m_image;
+
+  /* 1. Сборка нового блока из ячеек текущего отображения и снимков */
+  U16 m_lbi[FTL_PACK_SLOTS];
+  U8 m_slot[FTL_PACK_SLOTS];
+  U8 m_from[FTL_PACK_SLOTS];
+  U8 m_to[FTL_PACK_SLOTS];
+  SIZE32 m_kept = 0U;
+  SIZE32 m_live = 0U;
+  SIZE32 m_end = FTL_PACK_DATA_OFFSET;
+  for(register U8 i = 0U; i < FTL_PACK_SLOTS; i++)
+  {
+    FTL_PACK_ENTRY_TYPE m_entry;
+    STD_MEMCPY(
+      sizeof(FTL_PACK_ENTRY_TYPE),
+      (VOID_PTR)(BLOCK + FTL_PACK_ENTRIES_OFFSET
+        + i * sizeof(FTL_PACK_ENTRY_TYPE)),
+      &m_entry
+    );
+    if(m_entry.lbi >= FTL_BLOCKS_COUNT)
+    {
+      continue;
+    }
+
+    const U16 M_ENTRY = FTL_MAP_ENTRY(OLD_PBI, i);
+    const U8 M_CURRENT = (M_ENTRY == g_ftl->header.map[m_entry.lbi]);
+    U8 m_snapshot = 0U;
+    for(register SIZE32 s = 0U; s < FTL_SNAPSHOTS_COUNT; s++)
+    {
+      if(g_ftl->snapshots[s].active
+      && (M_ENTRY == g_ftl->snapshots[s].map[m_entry.lbi]))
+      {
+        m_snapshot = 1U;
+      }
+    }
+    if(!M_CURRENT && !m_snapshot)
+    {
+      continue;
+    }
+
+    /* Общие данные нескольких ячеек переносятся один раз */
+    const U8 M_OFFSET = m_entry.offset;
+    SIZE32 m_copy = 0U;
+    while((m_copy < m_kept) && (m_from[m_copy] != M_OFFSET))
+    {
+      m_copy++;
+    }
+    if(m_copy < m_kept)
+    {
+      m_entry.offset = m_to[m_copy];
+    }
+    else
+    {
+      const SIZE32 M_ALIGNED = FTL_PACK_ALIGNED(m_entry.length);
+      STD_MEMCPY(
+        M_ALIGNED, (VOID_PTR)(BLOCK + m_entry.offset), m_bytes + m_end
+      );
+      m_entry.offset = (U8)m_end;
+      m_end += M_ALIGNED;
+    }
+    m_from[m_kept] = M_OFFSET;
+    m_to[m_kept] = m_entry.offset;
+
+    STD_MEMCPY(
+      sizeof(FTL_PACK_ENTRY_TYPE), &m_entry,
+      m_bytes + FTL_PACK_ENTRIES_OFFSET
+        + m_kept * sizeof(FTL_PACK_ENTRY_TYPE)
+    );
+    m_lbi[m_kept] = m_entry.lbi;
+    m_slot[m_kept] = i;
+    m_kept++;
+    m_live += M_CURRENT;
+  }
+  if(0U == m_kept)
+  {
+    *return_code = NO_ACTION;
+    return;
+  }
+
+  const FTL_BLOCK_TYPE M_META =
+  (FTL_BLOCK_TYPE){
+    .flag = FTL_FLAG_VALID,
+    .lbi = 0U,
+    .format = FTL_FORMAT_PACKED,
+    .crc32 = 0xFFFFFFFFUL
+  };
+  STD_MEMCPY(sizeof(FTL_BLOCK_TYPE), (VOID_PTR)&M_META, m_bytes);
+
+  /* 2. Запись (на flash блок всегда актуален: флаг DIRTY только в ОЗУ,
+   * ячейки снимков снова читаются при FTL_INIT).
+   * Данные, затем заголовок и ячейки: прерванная запись не оставляет
+   * ячеек, ссылающихся на незаписанные данные */
+  const FLASH_ADDRESS M_NEW_PBA = NEW_PBI * FTL_BLOCK_SIZE + g_ftl->header.pba;
+  RETURN_CODE m_write_error = NO_ERROR;
+  FLASH_WRITE(
+    M_NEW_PBA + FTL_PACK_DATA_OFFSET, m_end - FTL_PACK_DATA_OFFSET,
+    m_bytes + FTL_PACK_DATA_OFFSET, &m_write_error
+  );
+  if(NO_ERROR == m_write_error)
+  {
+    FLASH_WRITE(M_NEW_PBA, FTL_PACK_DATA_OFFSET, m_image, &m_write_error);
+  }
+  if(NO_ERROR != m_write_error)
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  /* 3. Обновить таблицу, отображение и снимки */
+  g_ftl->header.table[NEW_PBI] = M_META;
+  g_ftl->header.table[NEW_PBI].flag
+    = (0U != m_live) ? FTL_FLAG_VALID : FTL_FLAG_DIRTY;
+  g_ftl->header.slots[NEW_PBI]
+    = (U8)m_live | ((m_kept != m_live) ? FTL_SLOTS_STALE : 0U);
+  for(register SIZE32 k = 0U; k < m_kept; k++)
+  {
+    const U16 M_OLD = FTL_MAP_ENTRY(OLD_PBI, m_slot[k]);
+    const U16 M_NEW = FTL_MAP_ENTRY(NEW_PBI, k);
+    if(M_OLD == g_ftl->header.map[m_lbi[k]])
+    {
+      g_ftl->header.map[m_lbi[k]] = M_NEW;
+    }
+    for(register SIZE32 s = 0U; s < FTL_SNAPSHOTS_COUNT; s++)
+    {
+      if(g_ftl->snapshots[s].active
+      && (M_OLD == g_ftl->snapshots[s].map[m_lbi[k]]))
+      {
+        g_ftl->snapshots[s].map[m_lbi[k]] = M_NEW;
+        g_ftl->pinned[NEW_PBI / 32U] |= (1UL << (NEW_PBI % 32U));
+      }
+    }
+  }
+
+  *return_code = NO_ERROR;
+}
+
+/*
+ * ПРОЧИТАТЬ ЗАПИСЬ КЛЮЧ-ЗНАЧЕНИЕ:
+ *   RECORD: Запись в виде во flash
+ *   SIZE: Байт от начала записи до конца физического блока
+ *   header: Заголовок записи
+ *   data: Открытые ключ и значение
+ *   return_code: Статус операции
+ *     NO_ERROR: Запись прочитана
+ *     NO_ACTION: Запись не записана (конец записей блока)
+ *     OPERATION_FAILED: Запись повреждена
+ */
+void FTL_KV_DECODE(
+/* IN  */ const U8 * RECORD,
+/* IN  */ const SIZE32 SIZE,
+/* OUT */ FTL_KV_RECORD_TYPE * header,
+/* OUT */ U8 * data,
+/* OUT */ RETURN_CODE * return_code)
+{
+  STD_MEMCPY(sizeof(FTL_KV_RECORD_TYPE), (VOID_PTR)RECORD, header);
+  if(0xFFFFFFFFUL == header->sequence)
+  {
+    *return_code = NO_ACTION;
+    return;
+  }
+  if((0U == header->key_length) || (header->key_length > FTL_KV_KEY_SIZE)
+  || (header->value_length > FTL_KV_VALUE_SIZE)
+  || (FTL_KV_ALIGNED(header->key_length, header->value_length) > SIZE))
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  const SIZE32 M_LENGTH = header->key_length + header->value_length;
+  STD_MEMCPY(
+    M_LENGTH, (VOID_PTR)(RECORD + sizeof(FTL_KV_RECORD_TYPE)), data
+  );
+  U32 m_crc32 = 0U;
+#if FTL_ENCRYPT
+  CRYPT_CTR(
+    data, M_LENGTH, header->sequence, FTL_CRYPT_KV, CRYPT_DECRYPT, &m_crc32
+  );
+#else
+  HASH_CRC(data, M_LENGTH, &m_crc32);
+#endif
+  if(m_crc32 != header->crc32)
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  *return_code = NO_ERROR;
+}
+
+/*
+ * НАЙТИ КЛЮЧ В ИНДЕКСЕ:
+ *   SPACE: Пространство ключей (FTL_KV_SPACE_USER и др.)
+ *   KEY: Ключ
+ *   KEY_LENGTH: Длина ключа
+ *   HASH: CRC32 ключа
+ *   slot: Элемент индекса ключа или свободный элемент для него
+ *   record: Запись ключа в виде во flash (до конца физического блока)
+ *   return_code: Статус операции
+ *     NO_ERROR: Ключ найден
+ *     NO_ACTION: Ключа нет
+ *
+ * Flash читается только для элементов с тем же CRC32 (обычно один раз).
+ * Неисправимая ошибка ECC не прерывает поиск: повреждение записи
+ * обнаружит CRC32 при чтении значения
+ */
+void FTL_KV_FIND(
+/* IN  */ const U8 SPACE,
+/* IN  */ const U8 * KEY,
+/* IN  */ const SIZE32 KEY_LENGTH,
+/* IN  */ const U32 HASH,
+/* OUT */ SIZE32 * slot,
+/* OUT */ U32 * record,
+/* OUT */ RETURN_CODE * return_code)
+{
+  for(register SIZE32 i = 0U; i < FTL_KV_INDEX_SIZE; i++)
+  {
+    const SIZE32 M_SLOT = (HASH + i) & (FTL_KV_INDEX_SIZE - 1U);
+    const FTL_KV_ENTRY_TYPE * M_ENTRY = &g_ftl->kv.index[M_SLOT];
+    if(FTL_PBI_NONE == M_ENTRY->pbi)
+    {
+      *slot = M_SLOT;
+      *return_code = NO_ACTION;
+      return;
+    }
+    if(M_ENTRY->hash != HASH)
+    {
+      continue;
+    }
+
+    RETURN_CODE m_read_error = NO_ERROR;
+    FLASH_READ(
+      M_ENTRY->pbi * FTL_BLOCK_SIZE + g_ftl->header.pba + M_ENTRY->offset,
+      FTL_BLOCK_SIZE - M_ENTRY->offset, record, &m_read_error
+    );
+    FTL_KV_RECORD_TYPE m_header;
+    STD_MEMCPY(sizeof(FTL_KV_RECORD_TYPE), record, &m_header);
+    if((m_header.space != SPACE) || (m_header.key_length != KEY_LENGTH)
+    || (KEY_LENGTH > FTL_BLOCK_SIZE - M_ENTRY->offset
+                     - sizeof(FTL_KV_RECORD_TYPE)))
+    {
+      continue;
+    }
+
+    /* Начало потока ключей расшифровывает ключ без значения */
+    U8 m_key[FTL_KV_KEY_SIZE];
+    STD_MEMCPY(
+      KEY_LENGTH, (U8 *)record + sizeof(FTL_KV_RECORD_TYPE), m_key
+    );
+#if FTL_ENCRYPT
+    U32 m_crc32 = 0U;
+    CRYPT_CTR(
+      m_key, KEY_LENGTH, m_header.sequence, FTL_CRYPT_KV, CRYPT_DECRYPT,
+      &m_crc32
+    );
+#endif
+    SIZE32 m_same = 0U;
+    while((m_same < KEY_LENGTH) && (m_key[m_same] == KEY[m_same]))
+    {
+      m_same++;
+    }
+    if(KEY_LENGTH == m_same)
+    {
+      *slot = M_SLOT;
+      *return_code = NO_ERROR;
+      return;
+    }
+  }
+
+  /* Индекс не заполняется больше FTL_KV_KEYS_COUNT: сюда не доходит */
+  *slot = (SIZE32)UN_SET;
+  *return_code = NO_ACTION;
+}
+
+/*
+ * УДАЛИТЬ ЭЛЕМЕНТ ИНДЕКСА КЛЮЧЕЙ:
+ *   SLOT: Элемент индекса
+ *
+ * Следующие элементы цепочки сдвигаются на место удаленного, поэтому
+ * номера элементов после удаления недействительны
+ */
+void FTL_KV_REMOVE(
+/* IN  */ const SIZE32 SLOT)
+{
+  SIZE32 m_hole = SLOT;
+  for(register SIZE32 i = 1U; i < FTL_KV_INDEX_SIZE; i++)
+  {
+    const SIZE32 M_SLOT = (SLOT + i) & (FTL_KV_INDEX_SIZE - 1U);
+    const FTL_KV_ENTRY_TYPE * M_ENTRY = &g_ftl->kv.index[M_SLOT];
+    if(FTL_PBI_NONE == M_ENTRY->pbi)
+    {
+      break;
+    }
+
+    /* Элемент остается, если его место в цепочке между дыркой и ним */
+    const SIZE32 M_HOME = M_ENTRY->hash & (FTL_KV_INDEX_SIZE - 1U);
+    const SIZE32 M_DISTANCE = (M_SLOT - M_HOME) & (FTL_KV_INDEX_SIZE - 1U);
+    const SIZE32 M_SHIFT = (M_SLOT - m_hole) & (FTL_KV_INDEX_SIZE - 1U);
+    if(M_DISTANCE < M_SHIFT)
+    {
+      continue;
+    }
+    g_ftl->kv.index[m_hole] = *M_ENTRY;
+    m_hole = M_SLOT;
+  }
+
+  g_ftl->kv.index[m_hole].pbi = FTL_PBI_NONE;
+  g_ftl->kv.count--;
+}
+
+/*
+ * НАИМЕНЬШИЙ НОМЕР ЗАПИСИ ВО FLASH ВНЕ ФИЗИЧЕСКОГО БЛОКА:
+ *   EXCLUDE: Номер физического блока
+ *   return: Наименьший номер первой записи блоков ключ-значение
+ *           (0xFFFFFFFF - других записей нет)
+ *
+ * Учитываются и устаревшие, и изъятые блоки: до стирания их записи
+ * снова читаются при FTL_INIT
+ */
+U32 FTL_KV_OLDEST(
+/* IN  */ const FTL_INDEX EXCLUDE)
+{
+  U32 m_oldest = 0xFFFFFFFFUL;
+  for(register FTL_INDEX i = 0U; i < FTL_BLOCKS_COUNT; i++)
+  {
+    if((EXCLUDE == i)
+    || (FTL_FORMAT_KV != g_ftl->header.table[i].format)
+    || (FTL_FLAG_FREE == g_ftl->header.table[i].flag))
+    {
+      continue;
+    }
+
+    U32 m_sequence = 0U;
+    RETURN_CODE m_read_error = NO_ERROR;
+    FLASH_READ(
+      i * FTL_BLOCK_SIZE + g_ftl->header.pba + FTL_KV_DATA_OFFSET,
+      sizeof(U32), &m_sequence, &m_read_error
+    );
+    if(NO_ERROR != m_read_error)
+    {
+      return 0U;
+    }
+    if(m_sequence < m_oldest)
+    {
+      m_oldest = m_sequence;
+    }
+  }
+  return m_oldest;
+}
+
+/*
+ * ПЕРЕНЕСТИ БЛОК КЛЮЧ-ЗНАЧЕНИЕ (сборка мусора, устаревшие записи
+ * не переносятся):
+ *   OLD_PBI: Номер переносимого физического блока
+ *   NEW_PBI: Номер свободного физического блока
+ *   BLOCK: Содержимое переносимого блока
+ *   return_code: Статус операции
+ *     NO_ERROR: Блок перенесен
+ *     NO_ACTION: Актуальных записей нет (ничего не записано)
+ *     OPERATION_FAILED: Ошибка записи
+ *
+ * Записи переносятся без изменений (с прежними номерами). Запись
+ * удаления отбрасывается, когда во flash не осталось более старых
+ * записей, которые она перекрывает
+ */
+void FTL_KV_MOVE(
+/* IN  */ const FTL_INDEX OLD_PBI,
+/* IN  */ const FTL_INDEX NEW_PBI,
+/* IN  */ const U8 * BLOCK,
+/* OUT */ RETURN_CODE * return_code)
+{
+  U32 m_image[FTL_BLOCK_SIZE / sizeof(U32)];
+  STD_MEMSET(sizeof(m_image), 0xFFU, m_image);
+  U8 * m_bytes = (U8 *)m_image;
+
+  /* 1. Элементы индекса блока по смещению (номера записей возрастают) */
+  U16 m_slots[FTL_BLOCK_SIZE / sizeof(U32)];
+  STD_MEMSET(sizeof(m_slots), 0xFFU, m_slots);
+  for(register SIZE32 i = 0U; i < FTL_KV_INDEX_SIZE; i++)
+  {
+    if(OLD_PBI == g_ftl->kv.index[i].pbi)
+    {
+      m_slots[g_ftl->kv.index[i].offset / sizeof(U32)] = (U16)i;
+    }
+  }
+
+  /* 2. Сборка нового блока из актуальных записей */
+  U16 m_kept_slot[FTL_KV_RECORDS];
+  U8 m_kept_offset[FTL_KV_RECORDS];
+  SIZE32 m_kept = 0U;
+  SIZE32 m_dropped = 0U;
+  SIZE32 m_end = FTL_KV_DATA_OFFSET;
+  U32 m_oldest = 0U;
+  U8 m_oldest_known = 0U;
+  for(register SIZE32 w = 0U; w < FTL_BLOCK_SIZE / sizeof(U32); w++)
+  {
+    if(0xFFFFU == m_slots[w])
+    {
+      continue;
+    }
+    const FTL_KV_ENTRY_TYPE * M_ENTRY = &g_ftl->kv.index[m_slots[w]];
+
+    FTL_KV_RECORD_TYPE m_header;
+    STD_MEMCPY(
+      sizeof(FTL_KV_RECORD_TYPE), (VOID_PTR)(BLOCK + M_ENTRY->offset),
+      &m_header
+    );
+    const SIZE32 M_ALIGNED
+      = FTL_KV_ALIGNED(m_header.key_length, m_header.value_length);
+    U8 m_drop = (M_ENTRY->offset + M_ALIGNED > FTL_BLOCK_SIZE);
+    if(!m_drop && M_ENTRY->tombstone)
+    {
+      if(!m_oldest_known)
+      {
+        m_oldest = FTL_KV_OLDEST(OLD_PBI);
+        m_oldest_known = 1U;
+      }
+      m_drop = (M_ENTRY->sequence < m_oldest);
+    }
+    if(m_drop)
+    {
+      m_dropped++;
+      continue;
+    }
+
+    STD_MEMCPY(
+      M_ALIGNED, (VOID_PTR)(BLOCK + M_ENTRY->offset), m_bytes + m_end
+    );
+    m_kept_slot[m_kept] = m_slots[w];
+    m_kept_offset[m_kept] = (U8)m_end;
+    m_kept++;
+    m_end += M_ALIGNED;
+  }
+
+  if(0U != m_kept)
+  {
+    const FTL_BLOCK_TYPE M_META =
+    (FTL_BLOCK_TYPE){
+      .flag = FTL_FLAG_VALID,
+      .lbi = 0U,
+      .format = FTL_FORMAT_KV,
+      .crc32 = 0xFFFFFFFFUL
+    };
+    STD_MEMCPY(sizeof(FTL_BLOCK_TYPE), (VOID_PTR)&M_META, m_bytes);
+
+    /* 3. Запись (индекс не меняется, пока блок не записан) */
+    RETURN_CODE m_write_error = NO_ERROR;
+    FLASH_WRITE(
+      NEW_PBI * FTL_BLOCK_SIZE + g_ftl->header.pba, FTL_BLOCK_SIZE, m_image,
+      &m_write_error
+    );
+    if(NO_ERROR != m_write_error)
+    {
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+
+    g_ftl->header.table[NEW_PBI] = M_META;
+    g_ftl->header.slots[NEW_PBI] = (U8)m_kept;
+    for(register SIZE32 k = 0U; k < m_kept; k++)
+    {
+      g_ftl->kv.index[m_kept_slot[k]].pbi = (U16)NEW_PBI;
+      g_ftl->kv.index[m_kept_slot[k]].offset = m_kept_offset[k];
+    }
+    g_ftl->stats.kv.relocated += m_kept;
+  }
+
+  /* 4. Отброшенные записи удаляются из индекса (элементы сдвигаются
+   * только на место удаленного, поэтому проверяется то же место) */
+  for(register SIZE32 i = 0U; (0U != m_dropped) && (i < FTL_KV_INDEX_SIZE);
+      i++)
+  {
+    while(OLD_PBI == g_ftl->kv.index[i].pbi)
+    {
+      FTL_KV_REMOVE(i);
+      g_ftl->stats.kv.dropped++;
+    }
+  }
+
+  *return_code = (0U != m_kept) ? NO_ERROR : NO_ACTION;
+}
+
+/*
+ * ДОПИСАТЬ ЗАПИСЬ КЛЮЧ-ЗНАЧЕНИЕ:
+ *   SPACE: Пространство ключей
+ *   KEY: Ключ
+ *   KEY_LENGTH: Длина ключа
+ *   VALUE: Значение
+ *   VALUE_LENGTH: Длина значения
+ *   TOMBSTONE: 1 - запись удаления (значения нет)
+ *   return_code: Статус операции
+ *     NO_ERROR: Запись добавлена, индекс обновлен
+ *     NO_ACTION: Удаляемого ключа нет, индекс ключей заполнен или
+ *                нет места (см. FTL_BLOCK_ALLOCATE)
+ *     OPERATION_FAILED: Невозможно записать данные в память
+ */
+void FTL_KV_APPEND(
+/* IN  */ const U8 SPACE,
+/* IN  */ const U8 * KEY,
+/* IN  */ const SIZE32 KEY_LENGTH,
+/* IN  */ const U8 * VALUE,
+/* IN  */ const SIZE32 VALUE_LENGTH,
+/* IN  */ const U8 TOMBSTONE,
+/* OUT */ RETURN_CODE * return_code)
+{
+  FTL_PACK_TYPE * m_block = &g_ftl->kv.block;
+  const SIZE32 M_ALIGNED = FTL_KV_ALIGNED(KEY_LENGTH, VALUE_LENGTH);
+  U32 m_hash = 0U;
+  HASH_CRC((VOID_PTR)KEY, KEY_LENGTH, &m_hash);
+
+  /* Блок, не прошедший проверку записи, изымается, запись повторяется */
+  for(SIZE32 m_attempt = 0U; m_attempt <= FTL_WRITE_RETRIES; m_attempt++)
+  {
+    /* 1. Открыть новый блок, если в текущем нет места */
+    if(((FTL_INDEX)UN_SET == m_block->pbi)
+    || (m_block->end + M_ALIGNED > FTL_BLOCK_SIZE))
+    {
+      m_block->pbi = (FTL_INDEX)UN_SET;
+
+      /* Записи ключ-значение часто перезаписываются */
+      FTL_INDEX m_pbi;
+      RETURN_CODE m_alloc_error = NO_ERROR;
+      FTL_BLOCK_ALLOCATE(FTL_FRONTIER_HOT, &m_pbi, &m_alloc_error);
+      if(NO_ERROR != m_alloc_error)
+      {
+        *return_code = m_alloc_error;
+        return;
+      }
+
+      const FTL_BLOCK_TYPE M_META =
+      (FTL_BLOCK_TYPE){
+        .flag = FTL_FLAG_VALID,
+        .lbi = 0U,
+        .format = FTL_FORMAT_KV,
+        .crc32 = 0xFFFFFFFFUL
+      };
+      U32 m_header[FTL_KV_DATA_OFFSET / sizeof(U32)];
+      STD_MEMSET(sizeof(m_header), 0xFFU, m_header);
+      STD_MEMCPY(sizeof(FTL_BLOCK_TYPE), (VOID_PTR)&M_META, m_header);
+
+      RETURN_CODE m_write_error = NO_ERROR;
+      FLASH_WRITE(
+        m_pbi * FTL_BLOCK_SIZE + g_ftl->header.pba, sizeof(m_header), m_header,
+        &m_write_error
+      );
+      if(OPERATION_FAILED == m_write_error)
+      {
+        FTL_BLOCK_RETIRE(m_pbi);
+        g_ftl->stats.health.retries++;
+        continue;
+      }
+      if(NO_ERROR != m_write_error)
+      {
+        *return_code = OPERATION_FAILED;
+        return;
+      }
+
+      g_ftl->header.table[m_pbi] = M_META;
+      g_ftl->header.slots[m_pbi] = 0U;
+      m_block->pbi = m_pbi;
+      m_block->end = FTL_KV_DATA_OFFSET;
+    }
+
+    /* 2. Поиск после выделения: сборка мусора переносит записи
+     * и удаляет элементы индекса */
+    SIZE32 m_slot;
+    U32 m_record[FTL_BLOCK_SIZE / sizeof(U32)];
+    RETURN_CODE m_find_error = NO_ERROR;
+    FTL_KV_FIND(
+      SPACE, KEY, KEY_LENGTH, m_hash, &m_slot, m_record, &m_find_error
+    );
+    const U8 M_FOUND = (NO_ERROR == m_find_error);
+    if((TOMBSTONE && (!M_FOUND || g_ftl->kv.index[m_slot].tombstone))
+    || (!M_FOUND && (g_ftl->kv.count >= FTL_KV_KEYS_COUNT)))
+    {
+      *return_code = NO_ACTION;
+      return;
+    }
+
+    /* 3. Заголовок, ключ и значение - одним программированием */
+    const U32 M_SEQUENCE = g_ftl->kv.sequence++;
+    U32 m_data[FTL_BLOCK_SIZE / sizeof(U32)];
+    U8 * m_bytes = (U8 *)m_data;
+    STD_MEMSET(M_ALIGNED, 0xFFU, m_data);
+    STD_MEMCPY(
+      KEY_LENGTH, (VOID_PTR)KEY, m_bytes + sizeof(FTL_KV_RECORD_TYPE)
+    );
+    STD_MEMCPY(
+      VALUE_LENGTH, (VOID_PTR)VALUE,
+      m_bytes + sizeof(FTL_KV_RECORD_TYPE) + KEY_LENGTH
+    );
+    U32 m_crc32 = 0U;
+#if FTL_ENCRYPT
+    CRYPT_CTR(
+      m_bytes + sizeof(FTL_KV_RECORD_TYPE), KEY_LENGTH + VALUE_LENGTH,
+      M_SEQUENCE, FTL_CRYPT_KV, CRYPT_ENCRYPT, &m_crc32
+    );
+#else
+    HASH_CRC(
+      m_bytes + sizeof(FTL_KV_RECORD_TYPE), KEY_LENGTH + VALUE_LENGTH,
+      &m_crc32
+    );
+#endif
+    const FTL_KV_RECORD_TYPE M_HEADER =
+    (FTL_KV_RECORD_TYPE){
+      .sequence = M_SEQUENCE,
+      .crc32 = m_crc32,
+      .key_length = (U8)KEY_LENGTH,
+      .value_length = (U8)VALUE_LENGTH,
+      .tombstone = TOMBSTONE,
+      .space = SPACE
+    };
+    STD_MEMCPY(sizeof(FTL_KV_RECORD_TYPE), (VOID_PTR)&M_HEADER, m_data);
+
+    const FTL_INDEX M_PBI = m_block->pbi;
+    const U8 M_OFFSET = (U8)m_block->end;
+    RETURN_CODE m_write_error = NO_ERROR;
+    FLASH_WRITE(
+      M_PBI * FTL_BLOCK_SIZE + g_ftl->header.pba + M_OFFSET, M_ALIGNED,
+      m_data, &m_write_error
+    );
+    if(NO_ERROR != m_write_error)
+    {
+      FTL_BLOCK_RETIRE(M_PBI);
+      g_ftl->stats.health.retries++;
+      continue;
+    }
+    m_block->end += M_ALIGNED;
+
+    /* 4. Новая запись учитывается до освобождения прежней */
+    const FTL_KV_ENTRY_TYPE M_OLD = g_ftl->kv.index[m_slot];
+    g_ftl->kv.index[m_slot] =
+    (FTL_KV_ENTRY_TYPE){
+      .hash = m_hash,
+      .sequence = M_SEQUENCE,
+      .pbi = (U16)M_PBI,
+      .offset = M_OFFSET,
+      .tombstone = TOMBSTONE
+    };
+    g_ftl->header.slots[M_PBI]++;
+    if(M_FOUND)
+    {
+      FTL_MAP_RELEASE(FTL_MAP_ENTRY(M_OLD.pbi, 0U));
+    }
+    else
+    {
+      g_ftl->kv.count++;
+    }
+
+    *return_code = NO_ERROR;
+    return;
+  }
+
+  *return_code = OPERATION_FAILED;
+}
+
+/*
+ * ВОССТАНОВИТЬ ИНДЕКС КЛЮЧЕЙ (при инициализации, после чтения таблицы):
+ *   return_code: Статус операции
+ *     NO_ERROR: Записи прочитаны
+ *     OPERATION_FAILED: Адрес блока вне flash
+ *
+ * Из записей одного ключа актуальна запись с большим номером, поэтому
+ * порядок чтения блоков не важен. Блок с поврежденной записью читается
+ * до нее и уплотняется сборщиком мусора
+ */
+void FTL_KV_SCAN(
+/* OUT */ RETURN_CODE * return_code)
+{
+  for(register FTL_INDEX p = 0U; p < FTL_BLOCKS_COUNT; p++)
+  {
+    if((FTL_FLAG_VALID != g_ftl->header.table[p].flag)
+    || (FTL_FORMAT_KV != g_ftl->header.table[p].format))
+    {
+      continue;
+    }
+
+    U32 m_block[FTL_BLOCK_SIZE / sizeof(U32)];
+    const U8 * M_BLOCK = (const U8 *)m_block;
+    RETURN_CODE m_read_error = NO_ERROR;
+    FLASH_READ(
+      p * FTL_BLOCK_SIZE + g_ftl->header.pba, FTL_BLOCK_SIZE, m_block,
+      &m_read_error
+    );
+    if(INVALID_PARAM == m_read_error)
+    {
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+
+    SIZE32 m_offset = FTL_KV_DATA_OFFSET;
+    while(m_offset + sizeof(FTL_KV_RECORD_TYPE) <= FTL_BLOCK_SIZE)
+    {
+      FTL_KV_RECORD_TYPE m_header;
+      U8 m_data[FTL_KV_KEY_SIZE + FTL_KV_VALUE_SIZE];
+      RETURN_CODE m_decode_error = NO_ERROR;
+      FTL_KV_DECODE(
+        M_BLOCK + m_offset, FTL_BLOCK_SIZE - m_offset, &m_header, m_data,
+        &m_decode_error
+      );
+      if(NO_ACTION == m_decode_error)
+      {
+        break;
+      }
+      if(NO_ERROR != m_decode_error)
+      {
+        g_ftl->header.slots[p] |= FTL_SLOTS_STALE;
+        break;
+      }
+      const SIZE32 M_OFFSET = m_offset;
+      m_offset += FTL_KV_ALIGNED(m_header.key_length, m_header.value_length);
+      if(m_header.sequence >= g_ftl->kv.sequence)
+      {
+        g_ftl->kv.sequence = m_header.sequence + 1U;
+      }
+
+      U32 m_hash = 0U;
+      HASH_CRC(m_data, m_header.key_length, &m_hash);
+      SIZE32 m_slot;
+      U32 m_record[FTL_BLOCK_SIZE / sizeof(U32)];
+      RETURN_CODE m_find_error = NO_ERROR;
+      FTL_KV_FIND(
+        m_header.space, m_data, m_header.key_length, m_hash, &m_slot,
+        m_record, &m_find_error
+      );
+      const U8 M_FOUND = (NO_ERROR == m_find_error);
+      if((M_FOUND
+         && (g_ftl->kv.index[m_slot].sequence >= m_header.sequence))
+      || (!M_FOUND && (g_ftl->kv.count >= FTL_KV_INDEX_SIZE - 1U)))
+      {
+        g_ftl->header.slots[p] |= FTL_SLOTS_STALE;
+        continue;
+      }
+
+      const FTL_KV_ENTRY_TYPE M_OLD = g_ftl->kv.index[m_slot];
+      g_ftl->kv.index[m_slot] =
+      (FTL_KV_ENTRY_TYPE){
+        .hash = m_hash,
+        .sequence = m_header.sequence,
+        .pbi = (U16)p,
+        .offset = (U8)M_OFFSET,
+        .tombstone = (0U != m_header.tombstone)
+      };
+      g_ftl->header.slots[p]++;
+      if(M_FOUND)
+      {
+        FTL_MAP_RELEASE(FTL_MAP_ENTRY(M_OLD.pbi, 0U));
+      }
+      else
+      {
+        g_ftl->kv.count++;
+      }
+    }
+
+    if(0U == (g_ftl->header.slots[p] & FTL_SLOTS_LIVE))
+    {
+      g_ftl->header.table[p].flag = FTL_FLAG_DIRTY;
+    }
+  }
+
+  *return_code = NO_ERROR;
+}
+
+/*
+ * ПРОЧИТАТЬ ЗНАЧЕНИЕ КЛЮЧА (одно чтение flash):
+ *   SPACE: Пространство ключей
+ *   KEY: Ключ
+ *   KEY_LENGTH: Длина ключа (1 - FTL_KV_KEY_SIZE)
+ *   CAPACITY: Размер value
+ *   value: Значение
+ *   value_length: Длина значения
+ *   return_code: Статус операции
+ *     NO_ERROR: Значение прочитано
+ *     NO_ACTION: Ключа нет
+ *     INVALID_PARAM: Значение больше CAPACITY
+ *     OPERATION_FAILED: Запись повреждена
+ */
+void FTL_KV_LOOKUP(
+/* IN  */ const U8 SPACE,
+/* IN  */ const U8 * KEY,
+/* IN  */ const SIZE32 KEY_LENGTH,
+/* IN  */ const SIZE32 CAPACITY,
+/* OUT */ U8 * value,
+/* OUT */ SIZE32 * value_length,
+/* OUT */ RETURN_CODE * return_code)
+{
+  /* 1. Элемент индекса и запись ключа (одно чтение) */
+  U32 m_hash = 0U;
+  HASH_CRC((VOID_PTR)KEY, KEY_LENGTH, &m_hash);
+  SIZE32 m_slot;
+  U32 m_record[FTL_BLOCK_SIZE / sizeof(U32)];
+  RETURN_CODE m_find_error = NO_ERROR;
+  FTL_KV_FIND(
+    SPACE, KEY, KEY_LENGTH, m_hash, &m_slot, m_record, &m_find_error
+  );
+  if((NO_ERROR != m_find_error) || g_ftl->kv.index[m_slot].tombstone)
+  {
+    *return_code = NO_ACTION;
+    return;
+  }
+
+  /* 2. Расшифровать и проверить CRC */
+  FTL_KV_RECORD_TYPE m_header;
+  U8 m_data[FTL_KV_KEY_SIZE + FTL_KV_VALUE_SIZE];
+  RETURN_CODE m_decode_error = NO_ERROR;
+  FTL_KV_DECODE(
+    (const U8 *)m_record, FTL_BLOCK_SIZE - g_ftl->kv.index[m_slot].offset,
+    &m_header, m_data, &m_decode_error
+  );
+  if(NO_ERROR != m_decode_error)
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  *value_length = m_header.value_length;
+  if(m_header.value_length > CAPACITY)
+  {
+    *return_code = INVALID_PARAM;
+    return;
+  }
+  STD_MEMCPY(m_header.value_length, m_data + m_header.key_length, value);
+
+  *return_code = NO_ERROR;
+}
+
+/*
+ * КОПИЯ ВХОДИТ В ОТОБРАЖЕНИЕ (см. FTL_ROLLBACK_TYPE):
+ *   SEQUENCE: Порядковый номер записи копии
+ *   LIMIT: Номер создания снимка ((U32)UN_SET - текущее отображение)
+ *   return: 1 - копия не новее границы и не отменена откатом
+ */
+U8 FTL_SNAPSHOT_VISIBLE(
+/* IN  */ const U32 SEQUENCE,
+/* IN  */ const U32 LIMIT)
+{
+  U32 m_limit = LIMIT;
+  while(SEQUENCE < m_limit)
+  {
+    /* Последний откат до границы (номера end откатов различаются) */
+    const FTL_ROLLBACK_TYPE * m_last = (const FTL_ROLLBACK_TYPE *)(0);
+    for(register SIZE32 r = 0U; r < FTL_ROLLBACKS_COUNT; r++)
+    {
+      const FTL_ROLLBACK_TYPE * M_ROLLBACK = &g_ftl->rollbacks[r];
+      if(M_ROLLBACK->active && (M_ROLLBACK->end < m_limit)
+      && (((const FTL_ROLLBACK_TYPE *)(0) == m_last)
+        || (M_ROLLBACK->end > m_last->end)))
+      {
+        m_last = M_ROLLBACK;
+      }
+    }
+    if(((const FTL_ROLLBACK_TYPE *)(0) == m_last)
+    || (SEQUENCE >= m_last->end))
+    {
+      return 1U;
+    }
+
+    /* Копии до отмененных - по отображению снимка, к которому был откат */
+    m_limit = m_last->start;
+  }
+  return 0U;
+}
+
+/*
+ * ОБНОВИТЬ СОСТОЯНИЕ БЛОКОВ ПО ОТОБРАЖЕНИЮ (после замены отображения):
+ *
+ * Неотображенные блоки устаревают (блоки ключ-значение не отображаются
+ * и не меняются), сжатые блоки уплотняются сборщиком мусора
+ */
+void FTL_MAP_REFLAG(void)
+{
+  for(register FTL_INDEX i = 0U; i < FTL_BLOCKS_COUNT; i++)
+  {
+    if((g_ftl->header.table[i].flag == FTL_FLAG_VALID)
+    && (g_ftl->header.table[i].format != FTL_FORMAT_KV))
+    {
+      g_ftl->header.table[i].flag = FTL_FLAG_DIRTY;
+    }
+  }
+  for(register FTL_INDEX i = 0U; i < FTL_BLOCKS_COUNT; i++)
+  {
+    if(g_ftl->header.table[i].format != FTL_FORMAT_KV)
+    {
+      g_ftl->header.slots[i] = FTL_SLOTS_STALE;
+    }
+  }
+  for(register FTL_INDEX i = 0U; i < FTL_BLOCKS_COUNT; i++)
+  {
+    if(FTL_PBI_NONE != g_ftl->header.map[i])
+    {
+      const FTL_INDEX M_PBI = FTL_MAP_PBI(g_ftl->header.map[i]);
+      g_ftl->header.table[M_PBI].flag = FTL_FLAG_VALID;
+      if(FTL_FORMAT_PACKED == g_ftl->header.table[M_PBI].format)
+      {
+        g_ftl->header.slots[M_PBI]++;
+      }
+    }
+  }
+}
+
+/*
+ * ПРОЧИТАТЬ КОПИИ ЛОГИЧЕСКИХ БЛОКОВ ФИЗИЧЕСКОГО БЛОКА (при инициализации):
+ *   PBI: Номер физического блока
+ *   lbi: Логические блоки копий (FTL_PACK_SLOTS элементов)
+ *   entries: Элементы отображения копий
+ *   sequences: Порядковые номера записи копий
+ *   return: Количество копий (нечитаемые и прерванные записи не учитываются)
+ *
+ * Читаются и устаревшие блоки: в них остаются копии снимков
+ */
+SIZE32 FTL_SNAPSHOT_COPIES(
+/* IN  */ const FTL_INDEX PBI,
+/* OUT */ U16 * lbi,
+/* OUT */ U16 * entries,
+/* OUT */ U32 * sequences)
+{
+  if(((FTL_FLAG_VALID != g_ftl->header.table[PBI].flag)
+    && (FTL_FLAG_DIRTY != g_ftl->header.table[PBI].flag))
+  || (FTL_FORMAT_KV == g_ftl->header.table[PBI].format))
+  {
+    return 0U;
+  }
+
+  /* Блок, стирание которого прервано, отмечен устаревшим только в ОЗУ */
+  U32 m_buffer[FTL_BLOCK_SIZE / sizeof(U32)];
+  const U8 * M_BLOCK = (const U8 *)m_buffer;
+  const FLASH_ADDRESS M_PBA = PBI * FTL_BLOCK_SIZE + g_ftl->header.pba;
+  RETURN_CODE m_read_error = NO_ERROR;
+  FLASH_READ(M_PBA, 8U, m_buffer, &m_read_error);
+  FTL_BLOCK_TYPE m_meta;
+  STD_MEMCPY(sizeof(FTL_BLOCK_TYPE), m_buffer, &m_meta);
+  if((NO_ERROR != m_read_error) || (FTL_FLAG_FREE == m_meta.flag)
+  || (FTL_FLAG_BAD == m_meta.flag))
+  {
+    return 0U;
+  }
+
+  /* 1. Блок без сжатия: номер в таблице сектора */
+  if(FTL_FORMAT_RAW == m_meta.format)
+  {
+    FTL_SEQUENCE_TYPE m_entry;
+    RETURN_CODE m_load_error = NO_ERROR;
+    FTL_SEQUENCE_LOAD(PBI, &m_entry, &m_load_error);
+    if((NO_ERROR != m_load_error) || (m_entry.check != ~m_entry.sequence))
+    {
+      return 0U;
+    }
+    lbi[0U] = m_meta.lbi;
+    entries[0U] = FTL_MAP_ENTRY(PBI, 0U);
+    sequences[0U] = m_entry.sequence;
+    return 1U;
+  }
+  if(FTL_FORMAT_PACKED != m_meta.format)
+  {
+    return 0U;
+  }
+
+  /* 2. Ячейки сжатого блока: номера в заголовках данных */
+  FLASH_READ(M_PBA, sizeof(m_buffer), m_buffer, &m_read_error);
+  if(NO_ERROR != m_read_error)
+  {
+    return 0U;
+  }
+  SIZE32 m_count = 0U;
+  for(register U8 i = 0U; i < FTL_PACK_SLOTS; i++)
+  {
+    FTL_PACK_ENTRY_TYPE m_entry;
+    STD_MEMCPY(
+      sizeof(FTL_PACK_ENTRY_TYPE),
+      (VOID_PTR)(M_BLOCK + FTL_PACK_ENTRIES_OFFSET
+        + i * sizeof(FTL_PACK_ENTRY_TYPE)),
+      &m_entry
+    );
+    if((m_entry.lbi >= FTL_BLOCKS_COUNT)
+    || (m_entry.offset < FTL_PACK_DATA_OFFSET)
+    || (m_entry.offset + FTL_PACK_ALIGNED(m_entry.length) > FTL_BLOCK_SIZE))
+    {
+      continue;
+    }
+    FTL_PACK_CELL_TYPE m_cell;
+    STD_MEMCPY(
+      sizeof(FTL_PACK_CELL_TYPE), (VOID_PTR)(M_BLOCK + m_entry.offset),
+      &m_cell
+    );
+    if((U32)UN_SET == m_cell.sequence)
+    {
+      continue;
+    }
+    lbi[m_count] = m_entry.lbi;
+    entries[m_count] = FTL_MAP_ENTRY(PBI, i);
+    sequences[m_count] = m_cell.sequence;
+    m_count++;
+  }
+  return m_count;
+}
+
+/*
+ * ВОССТАНОВИТЬ СНИМКИ И ОТКАТЫ (при инициализации, после FTL_KV_SCAN):
+ *   return_code: Статус операции
+ *     NO_ERROR: Снимки и откаты восстановлены
+ *     OPERATION_FAILED: Ошибка записи удаления отката
+ *
+ * Отображения снимков и текущее отображение (если были откаты)
+ * собираются из копий во flash (FTL_SNAPSHOT_VISIBLE): при снимках или
+ * откатах блоки читаются второй раз. Запись отката удаляется, когда
+ * отмененных ею копий во flash не осталось и нет отката, который занял бы
+ * ее место в отображениях (с end между ее start и end)
+ */
+void FTL_SNAPSHOT_LOAD(
+/* OUT */ RETURN_CODE * return_code)
+{
+  /* 1. Записи снимков и откатов (номера записи продолжаются после них,
+   * поврежденная запись не восстанавливается) */
+  U8 m_loaded = 0U;
+  for(register SIZE32 s = 0U; s < FTL_SNAPSHOTS_COUNT; s++)
+  {
+    const U8 M_KEY = (U8)s;
+    U32 m_sequence = 0U;
+    SIZE32 m_length = 0U;
+    RETURN_CODE m_lookup_error = NO_ERROR;
+    FTL_KV_LOOKUP(
+      FTL_KV_SPACE_SNAPSHOT, &M_KEY, 1U, sizeof(m_sequence),
+      (U8 *)&m_sequence, &m_length, &m_lookup_error
+    );
+    FTL_SNAPSHOT_TYPE * m_snapshot = &g_ftl->snapshots[s];
+    m_snapshot->active
+      = (NO_ERROR == m_lookup_error) && (sizeof(m_sequence) == m_length);
+    if(!m_snapshot->active)
+    {
+      continue;
+    }
+    m_snapshot->sequence = m_sequence;
+    STD_MEMSET(sizeof(FTL_MAP), 0xFFU, m_snapshot->map);
+    if(m_sequence > g_ftl->barrier)
+    {
+      g_ftl->barrier = m_sequence;
+    }
+    m_loaded = 1U;
+  }
+  U8 m_rolled = 0U;
+  for(register SIZE32 r = 0U; r < FTL_ROLLBACKS_COUNT; r++)
+  {
+    const U8 M_KEY = (U8)r;
+    U32 m_range[2U];
+    SIZE32 m_length = 0U;
+    RETURN_CODE m_lookup_error = NO_ERROR;
+    FTL_KV_LOOKUP(
+      FTL_KV_SPACE_ROLLBACK, &M_KEY, 1U, sizeof(m_range), (U8 *)m_range,
+      &m_length, &m_lookup_error
+    );
+    FTL_ROLLBACK_TYPE * m_rollback = &g_ftl->rollbacks[r];
+    m_rollback->active = (NO_ERROR == m_lookup_error)
+      && (sizeof(m_range) == m_length) && (m_range[0U] < m_range[1U]);
+    if(!m_rollback->active)
+    {
+      continue;
+    }
+    m_rollback->start = m_range[0U];
+    m_rollback->end = m_range[1U];
+    if(m_range[1U] + 1U > g_ftl->barrier)
+    {
+      g_ftl->barrier = m_range[1U] + 1U;
+    }
+    m_rolled = 1U;
+  }
+  if(g_ftl->barrier > g_ftl->sequence)
+  {
+    g_ftl->sequence = g_ftl->barrier;
+  }
+  if(!m_loaded && !m_rolled)
+  {
+    *return_code = NO_ERROR;
+    return;
+  }
+
+  /* 2. Отображения из копий всех блоков */
+  SIZE32 m_voided[FTL_ROLLBACKS_COUNT];
+  STD_MEMSET(sizeof(m_voided), 0x00U, m_voided);
+  if(m_rolled)
+  {
+    STD_MEMSET(sizeof(FTL_MAP), 0xFFU, g_ftl->header.map);
+  }
+  for(register FTL_INDEX p = 0U; p < FTL_BLOCKS_COUNT; p++)
+  {
+    U16 m_lbi[FTL_PACK_SLOTS];
+    U16 m_entries[FTL_PACK_SLOTS];
+    U32 m_sequences[FTL_PACK_SLOTS];
+    const SIZE32 M_COUNT
+      = FTL_SNAPSHOT_COPIES(p, m_lbi, m_entries, m_sequences);
+    for(register SIZE32 c = 0U; c < M_COUNT; c++)
+    {
+      const U32 M_SEQUENCE = m_sequences[c];
+      for(register SIZE32 r = 0U; r < FTL_ROLLBACKS_COUNT; r++)
+      {
+        m_voided[r] += g_ftl->rollbacks[r].active
+          && (M_SEQUENCE >= g_ftl->rollbacks[r].start)
+          && (M_SEQUENCE < g_ftl->rollbacks[r].end);
+      }
+      U16 * m_live = &(g_ftl->header.map[m_lbi[c]]);
+      if(m_rolled && FTL_SNAPSHOT_VISIBLE(M_SEQUENCE, (U32)UN_SET)
+      && FTL_SCAN_NEWER(*m_live, m_entries[c], M_SEQUENCE))
+      {
+        *m_live = m_entries[c];
+      }
+      for(register SIZE32 s = 0U; s < FTL_SNAPSHOTS_COUNT; s++)
+      {
+        FTL_SNAPSHOT_TYPE * m_snapshot = &g_ftl->snapshots[s];
+        U16 * m_entry = &(m_snapshot->map[m_lbi[c]]);
+        if(m_snapshot->active
+        && FTL_SNAPSHOT_VISIBLE(M_SEQUENCE, m_snapshot->sequence)
+        && FTL_SCAN_NEWER(*m_entry, m_entries[c], M_SEQUENCE))
+        {
+          *m_entry = m_entries[c];
+        }
+      }
+    }
+  }
+  if(m_rolled)
+  {
+    FTL_MAP_REFLAG();
+  }
+
+  /* 3. Ненужные записи откатов удаляются (удаление одной может
+   * освободить место другой) */
+  for(U8 m_removed = 1U; m_removed;)
+  {
+    m_removed = 0U;
+    for(register SIZE32 r = 0U; r < FTL_ROLLBACKS_COUNT; r++)
+    {
+      FTL_ROLLBACK_TYPE * m_rollback = &g_ftl->rollbacks[r];
+      U8 m_needed = m_rollback->active && (0U != m_voided[r]);
+      for(register SIZE32 q = 0U; q < FTL_ROLLBACKS_COUNT; q++)
+      {
+        m_needed = m_needed
+          || ((q != r) && g_ftl->rollbacks[q].active
+            && (g_ftl->rollbacks[q].end >= m_rollback->start)
+            && (g_ftl->rollbacks[q].end < m_rollback->end));
+      }
+      if(!m_rollback->active || m_needed)
+      {
+        continue;
+      }
+
+      const U8 M_KEY = (U8)r;
+      RETURN_CODE m_delete_error = NO_ERROR;
+      FTL_KV_APPEND(
+        FTL_KV_SPACE_ROLLBACK, &M_KEY, 1U, (const U8 *)(0), 0U, 1U,
+        &m_delete_error
+      );
+      if(OPERATION_FAILED == m_delete_error)
+      {
+        *return_code = OPERATION_FAILED;
+        return;
+      }
+      if(NO_ERROR == m_delete_error)
+      {
+        m_rollback->active = 0U;
+        m_removed = 1U;
+      }
+    }
+  }
+
+  *return_code = NO_ERROR;
+}
+
+/*
+ * ОСВОБОДИТЬ СЕКТОР (перенос актуальных и закрепленных блоков, стирание):
+ *   SECTOR_ID: Номер сектора FTL
+ *   moved: Количество перенесенных блоков
+ *   return_code: Статус операции
+ *     NO_ERROR: Сектор стерт
+ *     NO_ACTION: Свободных блоков вне сектора не хватает для переноса
+ *                или в секторе есть отображенный в память блок
+ *     OPERATION_FAILED: Ошибка записи (после FTL_WRITE_RETRIES повторов)
+ *                       или стирания
+ *
+ * Перенесенные блоки пережили перезапись - они пишутся в наиболее
+ * изношенные сектора. Карта g_ftl->pinned должна быть актуальна.
+ */
+void FTL_SECTOR_RECLAIM(
+/* IN  */ const FLASH_SECTOR_ID SECTOR_ID,
+/* OUT */ SIZE32 * moved,
+/* OUT */ RETURN_CODE * return_code)
+{
+  *moved = 0U;
+
+  FTL_INDEX m_start_pbi;
+  FTL_INDEX m_end_pbi;
+  FTL_SECTOR_RANGE(SECTOR_ID, &m_start_pbi, &m_end_pbi);
+
+  /* 1. Свободных блоков вне сектора должно хватить для переноса,
+   * отображенные в память блоки не должны стираться */
+  SIZE32 m_valid_count = 0U;
+  SIZE32 m_free_count = 0U;
+  for(register FTL_INDEX i = 0U; i < FTL_BLOCKS_COUNT; i++)
+  {
+    if((i >= m_start_pbi) && (i < m_end_pbi))
+    {
+      if(0U != g_ftl->views[i])
+      {
+        *return_code = NO_ACTION;
+        return;
+      }
+      if((g_ftl->header.table[i].flag == FTL_FLAG_VALID)
+      || (0U != (g_ftl->pinned[i / 32U] & (1UL << (i % 32U)))))
+      {
+        m_valid_count++;
+      }
+    }
+    else if(g_ftl->header.table[i].flag == FTL_FLAG_FREE)
+    {
+      m_free_count++;
+    }
+  }
+  if(m_free_count < m_valid_count)
+  {
+    *return_code = NO_ACTION;
+    return;
+  }
+
+  /* 2. Перенос актуальных блоков в свободные блоки других секторов */
+  FTL_FRONTIER_TYPE m_frontier =
+  (FTL_FRONTIER_TYPE){
+    .sector = FLASH_SECTORS_COUNT
+  };
+  for(FTL_INDEX m_valid_pbi = m_start_pbi; m_valid_pbi < m_end_pbi;
+      m_valid_pbi++)
+  {
+    if((g_ftl->header.table[m_valid_pbi].flag != FTL_FLAG_VALID)
+    && (0U == (g_ftl->pinned[m_valid_pbi / 32U]
+               & (1UL << (m_valid_pbi % 32U)))))
+    {
+      continue;
+    }
+
+    /* Переместить блок (метаданные переносятся вместе с данными).
+     * Неисправимая ошибка ECC не останавливает сборку мусора: данные
+     * переносятся как прочитаны, повреждение обнаружит CRC32 блока */
+    U8 m_data[FTL_BLOCK_SIZE];
+    const FLASH_ADDRESS M_VALID_PBA
+      = m_valid_pbi * FTL_BLOCK_SIZE + g_ftl->header.pba;
+    RETURN_CODE m_read_error = NO_ERROR;
+    FLASH_READ(M_VALID_PBA, FTL_BLOCK_SIZE, m_data, &m_read_error);
+
+    /* Копия блока без сжатия сохраняет порядковый номер записи */
+    const FTL_FORMAT M_FORMAT = g_ftl->header.table[m_valid_pbi].format;
+    U32 m_sequence = FTL_SEQUENCE_FIRST;
+    if(FTL_FORMAT_RAW == M_FORMAT)
+    {
+      RETURN_CODE m_sequence_error = NO_ERROR;
+      FTL_SEQUENCE_READ(
+        FTL_MAP_ENTRY(m_valid_pbi, 0U), &m_sequence, &m_sequence_error
+      );
+    }
+
+    /* Новый блок, не прошедший проверку записи, изымается */
+    FTL_INDEX m_free_pbi;
+    RETURN_CODE m_write_error = OPERATION_FAILED;
+    for(SIZE32 m_attempt = 0U; (OPERATION_FAILED == m_write_error)
+        && (m_attempt <= FTL_WRITE_RETRIES); m_attempt++)
+    {
+      if(0U != m_attempt)
+      {
+        FTL_BLOCK_RETIRE(m_free_pbi);
+        g_ftl->stats.health.retries++;
+      }
+
+      RETURN_CODE m_alloc_error = NO_ERROR;
+      FTL_FRONTIER_ALLOCATE(
+        SECTOR_ID, 1U, &m_frontier, &m_free_pbi, &m_alloc_error
+      );
+      if(NO_ERROR != m_alloc_error)
+      {
+        *return_code = OPERATION_FAILED;
+        return;
+      }
+
+      if(FTL_FORMAT_PACKED == M_FORMAT)
+      {
+        FTL_PACK_MOVE(m_valid_pbi, m_free_pbi, m_data, &m_write_error);
+      }
+      else if(FTL_FORMAT_KV == M_FORMAT)
+      {
+        FTL_KV_MOVE(m_valid_pbi, m_free_pbi, m_data, &m_write_error);
+      }
+      else
+      {
+        FLASH_WRITE(
+          m_free_pbi * FTL_BLOCK_SIZE + g_ftl->header.pba, FTL_BLOCK_SIZE,
+          m_data, &m_write_error
+        );
+        if(NO_ERROR == m_write_error)
+        {
+          FTL_SEQUENCE_WRITE(m_free_pbi, m_sequence, &m_write_error);
+        }
+      }
+    }
+    if((NO_ERROR != m_write_error) && (NO_ACTION != m_write_error))
+    {
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+
+    if(FTL_FORMAT_RAW != M_FORMAT)
+    {
+      if(NO_ERROR == m_write_error)
+      {
+        (*moved)++;
+      }
+      g_ftl->header.table[m_valid_pbi].flag = FTL_FLAG_DIRTY;
+      continue;
+    }
+
+    /* Обновить таблицу FTL, отображение и снимки */
+    const U16 M_LBI = g_ftl->header.table[m_valid_pbi].lbi;
+    g_ftl->header.table[m_free_pbi] = g_ftl->header.table[m_valid_pbi];
+    if(g_ftl->header.table[m_valid_pbi].flag == FTL_FLAG_VALID)
+    {
+      g_ftl->header.map[M_LBI] = FTL_MAP_ENTRY(m_free_pbi, 0U);
+    }
+    for(register SIZE32 s = 0U; s < FTL_SNAPSHOTS_COUNT; s++)
+    {
+      if(g_ftl->snapshots[s].active
+      && (g_ftl->snapshots[s].map[M_LBI] == FTL_MAP_ENTRY(m_valid_pbi, 0U)))
+      {
+        g_ftl->snapshots[s].map[M_LBI] = FTL_MAP_ENTRY(m_free_pbi, 0U);
+        g_ftl->pinned[m_free_pbi / 32U] |= (1UL << (m_free_pbi % 32U));
+      }
+    }
+    g_ftl->header.table[m_valid_pbi].flag = FTL_FLAG_DIRTY;
+    (*moved)++;
+  }
+
+  /* 3. Стирание сектора */
+  RETURN_CODE m_erase_error = NO_ERROR;
+  FLASH_SECTOR_ERASE(SECTOR_ID, &m_erase_error);
+  if(NO_ERROR != m_erase_error)
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+  g_ftl->stats.gc.erases++;
+  g_ftl->stats.gc.relocations += *moved;
+
+  /* Страницы, не прошедшие проверку стирания или записи, не выдаются
+   * (вместе с блоками, чей номер записи хранит такая страница таблицы) */
+  for(register FTL_INDEX i = m_start_pbi; i < m_end_pbi; i++)
+  {
+    U8 m_bad = 0U;
+    RETURN_CODE m_check_error = NO_ERROR;
+    FTL_BLOCK_CHECK(i, &m_bad, &m_check_error);
+    g_ftl->header.table[i] =
+    (FTL_BLOCK_TYPE){
+      .flag = m_bad ? FTL_FLAG_BAD : FTL_FLAG_FREE,
+      .lbi = 0U,
+      .crc32 = 0U
+    };
+    g_ftl->header.slots[i] = 0U;
+  }
+  FTL_FREE_RECOUNT();
+
+  *return_code = NO_ERROR;
+}
+
+/*
+ * СТАТИЧЕСКОЕ ВЫРАВНИВАНИЕ ИЗНОСА (вызывается сборщиком мусора):
+ *   return_code: Статус операции
+ *     NO_ERROR: Данные наименее изношенного сектора перенесены
+ *     NO_ACTION: Разброс износа в пределах FTL_WEAR_THRESHOLD
+ *                или переносить нечего
+ *     OPERATION_FAILED: Ошибка переноса
+ *
+ * Наименее изношенный сектор держит холодные данные и не стирается:
+ * его данные переносятся в изношенные сектора, а сам он освобождается
+ * для новых записей
+ */
+void FTL_WEAR_LEVEL(
+/* OUT */ RETURN_CODE * return_code)
+{
+  /* 1. Разброс счетчиков стираний */
+  FLASH_SECTOR_ID m_coldest = FTL_SECTOR_FIRST;
+  SIZE32 m_min_wear = (SIZE32)UN_SET;
+  SIZE32 m_max_wear = 0U;
+  for(FLASH_SECTOR_ID m_id = FTL_SECTOR_FIRST; m_id < FLASH_SECTORS_COUNT;
+      m_id++)
+  {
+    FLASH_SECTOR_TYPE m_sector;
+    RETURN_CODE m_select_error = NO_ERROR;
+    FLASH_SECTOR_SELECT(m_id, &m_sector, &m_select_error);
+    if(m_sector.wear < m_min_wear)
+    {
+      m_min_wear = m_sector.wear;
+      m_coldest = m_id;
+    }
+    if(m_sector.wear > m_max_wear)
+    {
+      m_max_wear = m_sector.wear;
+    }
+  }
+  if(m_max_wear - m_min_wear < FTL_WEAR_THRESHOLD)
+  {
+    *return_code = NO_ACTION;
+    return;
+  }
+
+  /* 2. Полностью свободный сектор и так будет выбран для записи */
+  FTL_INDEX m_start_pbi;
+  FTL_INDEX m_end_pbi;
+  FTL_SECTOR_RANGE(m_coldest, &m_start_pbi, &m_end_pbi);
+  SIZE32 m_used = 0U;
+  for(register FTL_INDEX i = m_start_pbi; i < m_end_pbi; i++)
+  {
+    if((g_ftl->header.table[i].flag != FTL_FLAG_FREE)
+    && (g_ftl->header.table[i].flag != FTL_FLAG_BAD))
+    {
+      m_used++;
+    }
+  }
+  if(0U == m_used)
+  {
+    *return_code = NO_ACTION;
+    return;
+  }
+
+  /* 3. Перенос холодных данных */
+  SIZE32 m_moved = 0U;
+  FTL_SECTOR_RECLAIM(m_coldest, &m_moved, return_code);
+  if(NO_ERROR == *return_code)
+  {
+    g_ftl->stats.wear.migrations += m_moved;
+  }
+}
+
+/*
+ * ВЫБРАТЬ ФРОНТ ЗАПИСИ ЛОГИЧЕСКОГО БЛОКА (учитывает запись):
+ *   LBI: Номер логического блока
+ *   return: FTL_FRONTIER_HOT или FTL_FRONTIER_COLD
+ */
+FTL_INDEX FTL_HEAT_FRONTIER(
+/* IN  */ const FTL_INDEX LBI)
+{
+  if((g_ftl->heat[LBI] & FTL_HEAT_COUNT) < FTL_HEAT_COUNT)
+  {
+    g_ftl->heat[LBI]++;
+  }
+
+  /* Подсказка вызывающего важнее оценки по частоте перезаписи */
+  switch(g_ftl->heat[LBI] >> FTL_HEAT_HINT_SHIFT)
+  {
+    case FTL_TEMPERATURE_HOT:
+      return FTL_FRONTIER_HOT;
+    case FTL_TEMPERATURE_COLD:
+      return FTL_FRONTIER_COLD;
+    default:
+      break;
+  }
+  return ((g_ftl->heat[LBI] & FTL_HEAT_COUNT) >= FTL_HOT_WRITES)
+    ? FTL_FRONTIER_HOT : FTL_FRONTIER_COLD;
+}
+
+/*
+ * ЗАПИСАТЬ БЛОК:
+ *   LBI: Номер логического блока
+ *   DATA: Блок данных (250 байт)
+ *   return_code: Статус операции
+ *     NO_ERROR: Успешная запись
+ *     NO_ACTION: Нет места (см. FTL_BLOCK_ALLOCATE)
+ *     OPERATION_FAILED: Невозможно записать данные в память
+ */
+void FTL_WRITE_BLOCK(
+/* IN  */ const FTL_INDEX LBI,
+/* IN  */ const VOID_PTR DATA,
+/* OUT */ RETURN_CODE * return_code)
+{
+  const FTL_INDEX M_FRONTIER = FTL_HEAT_FRONTIER(LBI);
+  if(FTL_FRONTIER_HOT == M_FRONTIER)
+  {
+    g_ftl->stats.gc.hot_blocks++;
+  }
+  else
+  {
+    g_ftl->stats.gc.cold_blocks++;
+  }
+
+#if FTL_COMPRESS
+  /* 0. Сжимаемый блок делит физический блок с другими сжатыми блоками */
+  U8 m_packed[FTL_PACK_LIMIT];
+  SIZE32 m_length = 0U;
+  RETURN_CODE m_compress_error = NO_ERROR;
+  LZ_COMPRESS(
+    DATA, FTL_DATA_SIZE, FTL_PACK_LIMIT, m_packed, &m_length,
+    &m_compress_error
+  );
+  if(NO_ERROR == m_compress_error)
+  {
+    FTL_PACK_WRITE(LBI, M_FRONTIER, m_packed, m_length, return_code);
+    if(NO_ERROR == *return_code)
+    {
+      g_ftl->stats.compress.packed_blocks++;
+      g_ftl->stats.compress.bytes_in += FTL_DATA_SIZE;
+      g_ftl->stats.compress.bytes_out += m_length;
+    }
+    return;
+  }
+#endif
+
+  /* 3. Подготовить данные */
+  U8 m_block[FTL_BLOCK_SIZE];
+  U8 m_data[FTL_DATA_SIZE];
+  STD_MEMCPY(FTL_DATA_SIZE, DATA, m_data);
+
+  // 4. Шифрование данных и вычисление CRC (один проход)
+  U32 m_crc32 = 0U;
+#if FTL_ENCRYPT
+  CRYPT_XTS(
+    m_data, FTL_DATA_SIZE, LBI, FTL_CRYPT_RAW, CRYPT_ENCRYPT, &m_crc32
+  );
+#else
+  HASH_CRC(m_data, FTL_DATA_SIZE, &m_crc32);
+#endif
+
+  // 4.3. Формирование блока: метаданные + данные
+  FTL_BLOCK_TYPE m_meta =
+  (FTL_BLOCK_TYPE){
+    .flag = FTL_FLAG_VALID,
+    .lbi = LBI,
+    .format = FTL_FORMAT_RAW,
+    .crc32 = m_crc32
+  };
+
+  // Копируем метаданные
+  STD_MEMCPY(sizeof(FTL_BLOCK_TYPE), &m_meta, m_block);
+  STD_MEMCPY(
+    FTL_DATA_SIZE, m_data,
+    m_block + sizeof(FTL_BLOCK_TYPE)
+  );
+
+  // 5. Записать во flash (блок, не прошедший проверку записи, изымается)
+  FTL_INDEX m_new_pbi;
+  RETURN_CODE m_write_error = OPERATION_FAILED;
+  for(SIZE32 m_attempt = 0U; (OPERATION_FAILED == m_write_error)
+      && (m_attempt <= FTL_WRITE_RETRIES); m_attempt++)
+  {
+    if(0U != m_attempt)
+    {
+      FTL_BLOCK_RETIRE(m_new_pbi);
+      g_ftl->stats.health.retries++;
+    }
+
+    /* Выделить новый физический блок (при нехватке - сборка мусора) */
+    RETURN_CODE m_alloc_error = NO_ERROR;
+    FTL_BLOCK_ALLOCATE(M_FRONTIER, &m_new_pbi, &m_alloc_error);
+    if(NO_ERROR != m_alloc_error)
+    {
+      *return_code = m_alloc_error;
+      return;
+    }
+
+    /* Номер записи - после данных: блок без номера при FTL_INIT
+     * считается прерванной записью */
+    FLASH_WRITE(
+      m_new_pbi * FTL_BLOCK_SIZE + g_ftl->header.pba, FTL_BLOCK_SIZE, m_block,
+      &m_write_error
+    );
+    if(NO_ERROR == m_write_error)
+    {
+      FTL_SEQUENCE_WRITE(m_new_pbi, g_ftl->sequence++, &m_write_error);
+    }
+  }
+  if(NO_ERROR != m_write_error)
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  // 6. Обновить таблицу FTL (после сборки мусора прежний блок мог сместиться)
+  const U16 M_OLD = g_ftl->header.map[LBI];
+  g_ftl->header.table[m_new_pbi] = m_meta;
+  g_ftl->header.map[LBI] = FTL_MAP_ENTRY(m_new_pbi, 0U);
+  FTL_MAP_RELEASE(M_OLD);
+  g_ftl->stats.compress.raw_blocks++;
+
+  *return_code = NO_ERROR;
+}
+
+/*
+ * ПРОЧИТАТЬ БЛОК:
+ *   LBI: Номер логического блока
+ *   data: Блок данных (250 байт)
+ *   return_code: Статус операции
+ *     NO_ERROR: Блок успешно прочитан
+ *     NO_ACTION: Блока не существует или не доступен
+ *     OPERATION_FAILED: Чтение не выполнено или данные повреждены
+ */
+void FTL_READ_BLOCK(
+/* IN  */ const U32 LBI,
+/* OUT */ VOID_PTR data,
+/* OUT */ RETURN_CODE * return_code)
+{
+  /* 1. Найти физический блок */
+  FTL_INDEX m_pbi;
+  RETURN_CODE m_get_error = NO_ERROR;
+  FTL_BLOCK_GET(LBI, &m_pbi, &m_get_error);
+  if(NO_ERROR != m_get_error)
+  {
+    STD_MEMSET(FTL_DATA_SIZE, 0xFF, data);
+    *return_code = NO_ACTION;
+    return;
+  }
+
+  /* 2. Прочитать блок из flash */
+  U8 m_block[FTL_BLOCK_SIZE];
+  FLASH_ADDRESS m_pba = m_pbi * FTL_BLOCK_SIZE + g_ftl->header.pba;
+  RETURN_CODE m_read_error = NO_ERROR;
+  FLASH_READ(m_pba, FTL_BLOCK_SIZE, m_block, &m_read_error);
+  if(OPERATION_FAILED == m_read_error)
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  /* 3. Извлечь метаданные и данные */
+  FTL_BLOCK_TYPE m_meta;
+  STD_MEMCPY(sizeof(FTL_BLOCK_TYPE), m_block, &m_meta);
+  if(FTL_FORMAT_PACKED == m_meta.format)
+  {
+    FTL_PACK_READ(
+      m_block, FTL_MAP_SLOT(g_ftl->header.map[LBI]), data, return_code
+    );
+    return;
+  }
+  U8 m_data[FTL_DATA_SIZE];
+  STD_MEMCPY(
+    FTL_DATA_SIZE,
+    m_block + sizeof(FTL_BLOCK_TYPE), m_data
+  );
+
+  /* 4. Расшифровать данные и вычислить CRC (один проход) */
+  U32 m_crc32 = 0U;
+#if FTL_ENCRYPT
+  CRYPT_XTS(
+    m_data, FTL_DATA_SIZE, LBI, FTL_CRYPT_RAW, CRYPT_DECRYPT, &m_crc32
+  );
+#else
+  HASH_CRC(m_data, FTL_DATA_SIZE, &m_crc32);
+#endif
+
+  /* 5. Проверить CRC */
+  if((FTL_FLAG_VALID == m_meta.flag) && (m_crc32 != m_meta.crc32))
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  /* 6. Скопировать в выходной буфер */
+  STD_MEMCPY(FTL_DATA_SIZE, m_data, data);
+
+  *return_code = NO_ERROR;
+}
+
+/*
+ * ВОССТАНОВИТЬ ФИЗИЧЕСКИЙ БЛОК (при инициализации):
+ *   PBI: Номер физического блока
+ *   map: Восстанавливаемое отображение (из копий логического блока
+ *        остается копия с большим номером записи, см. FTL_SCAN_MAP)
+ *   sequence: Номер, следующий за номерами прочитанных копий
+ *   return_code: Статус операции
+ *     NO_ERROR: Блок прочитан (нечитаемый блок изъят)
+ *     OPERATION_FAILED: Адрес блока вне flash
+ */
+void FTL_SCAN_BLOCK(
+/* IN  */ const FTL_INDEX PBI,
+/* INOUT */ U16 * map,
+/* INOUT */ U32 * sequence,
+/* OUT */ RETURN_CODE * return_code)
+{
+  FLASH_ADDRESS m_pba = PBI * FTL_BLOCK_SIZE + g_ftl->header.pba;
+  FTL_BLOCK_TYPE m_meta;
+
+  /* Изъятая страница хранит данные, только если это сжатый блок или блок
+   * ключ-значение, записанные до ошибки: он уплотняется сборщиком */
+  U8 m_bad = 0U;
+  RETURN_CODE m_check_error = NO_ERROR;
+  FLASH_BADBLOCK_CHECK(m_pba, &m_bad, &m_check_error);
+
+  U32 m_buffer[2U]; /* FLASH_READ требует выравнивания по слову */
+  RETURN_CODE m_read_error = NO_ERROR;
+  FLASH_READ(m_pba, 8U, m_buffer, &m_read_error);
+  if(INVALID_PARAM == m_read_error)
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+  STD_MEMCPY(sizeof(FTL_BLOCK_TYPE), m_buffer, &m_meta);
+
+  g_ftl->header.table[PBI] = m_meta;
+  if(FTL_FLAG_FREE == g_ftl->header.table[PBI].flag)
+  {
+    g_ftl->header.table[PBI] =
+    (FTL_BLOCK_TYPE){
+      .flag = FTL_FLAG_FREE,
+      .lbi = 0U,
+      .crc32 = 0U
+    };
+  }
+  if(NO_ERROR != m_read_error)
+  {
+    g_ftl->header.table[PBI].flag = FTL_FLAG_BAD;
+  }
+
+  /* Номер записи блока без сжатия (у свободного блока - стертый) */
+  FTL_SEQUENCE_TYPE m_entry;
+  STD_MEMSET(sizeof(m_entry), 0xFFU, &m_entry);
+  U8 m_table_bad = 0U;
+  if((FTL_FLAG_FREE == g_ftl->header.table[PBI].flag)
+  || ((FTL_FLAG_VALID == g_ftl->header.table[PBI].flag)
+    && (FTL_FORMAT_RAW == g_ftl->header.table[PBI].format)))
+  {
+    RETURN_CODE m_load_error = NO_ERROR;
+    FTL_SEQUENCE_LOAD(PBI, &m_entry, &m_load_error);
+    FTL_BLOCK_CHECK(PBI, &m_table_bad, &m_check_error);
+    m_table_bad = m_table_bad || (NO_ERROR != m_load_error);
+  }
+
+  if((FTL_FLAG_VALID == g_ftl->header.table[PBI].flag)
+  && (FTL_FORMAT_PACKED == g_ftl->header.table[PBI].format))
+  {
+    RETURN_CODE m_scan_error = NO_ERROR;
+    FTL_PACK_SCAN(PBI, map, sequence, &m_scan_error);
+    if(NO_ERROR != m_scan_error)
+    {
+      g_ftl->header.table[PBI].flag = FTL_FLAG_BAD;
+    }
+    else if(m_bad)
+    {
+      g_ftl->header.slots[PBI] |= FTL_SLOTS_STALE;
+    }
+  }
+  else if((FTL_FLAG_VALID == g_ftl->header.table[PBI].flag)
+  && (FTL_FORMAT_KV == g_ftl->header.table[PBI].format))
+  {
+    /* Записи читаются после таблицы (FTL_KV_SCAN) */
+    g_ftl->header.slots[PBI] = m_bad ? FTL_SLOTS_STALE : 0U;
+  }
+  else if(m_bad || m_table_bad)
+  {
+    g_ftl->header.table[PBI].flag = FTL_FLAG_BAD;
+  }
+  else if(FTL_FLAG_FREE == g_ftl->header.table[PBI].flag)
+  {
+    /* Номер остался от прерванного стирания: блок освободит сборщик */
+    if(((U32)UN_SET != m_entry.sequence) || ((U32)UN_SET != m_entry.check))
+    {
+      g_ftl->header.table[PBI].flag = FTL_FLAG_DIRTY;
+    }
+  }
+  else if(FTL_FLAG_VALID == g_ftl->header.table[PBI].flag)
+  {
+    /* Блок без номера - прерванная запись, актуальна прежняя копия */
+    if(m_entry.check != ~m_entry.sequence)
+    {
+      g_ftl->header.table[PBI].flag = FTL_FLAG_DIRTY;
+    }
+    else
+    {
+      if(m_entry.sequence >= *sequence)
+      {
+        *sequence = m_entry.sequence + 1U;
+      }
+      FTL_SCAN_MAP(
+        g_ftl->header.table[PBI].lbi, FTL_MAP_ENTRY(PBI, 0U),
+        m_entry.sequence, map
+      );
+    }
+  }
+
+  *return_code = NO_ERROR;
+}
+
+/*
+ * ВОССТАНОВИТЬ БЛОКИ СЕКТОРА (при инициализации):
+ *   SECTOR_ID: Номер сектора FTL
+ *   map: Восстанавливаемое отображение
+ *   sequence: Номер, следующий за номерами прочитанных копий
+ *   return_code: Статус операции
+ *     NO_ERROR: Блоки прочитаны
+ *     OPERATION_FAILED: Адрес блока вне flash
+ */
+void FTL_SCAN_SECTOR(
+/* IN  */ const FLASH_SECTOR_ID SECTOR_ID,
+/* INOUT */ U16 * map,
+/* INOUT */ U32 * sequence,
+/* OUT */ RETURN_CODE * return_code)
+{
+  FTL_INDEX m_start_pbi = 0U;
+  FTL_INDEX m_end_pbi = 0U;
+  FTL_SECTOR_RANGE(SECTOR_ID, &m_start_pbi, &m_end_pbi);
+
+  for(register FTL_INDEX i = m_start_pbi; i < m_end_pbi; i++)
+  {
+    RETURN_CODE m_block_error = NO_ERROR;
+    FTL_SCAN_BLOCK(i, map, sequence, &m_block_error);
+    if(NO_ERROR != m_block_error)
+    {
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+  }
+
+  *return_code = NO_ERROR;
+}
+
+/*
+ * ВОССТАНОВЛЕНИЕ ТАБЛИЦЫ ПО ПОРЯДКУ СЕКТОРОВ (при инициализации):
+ *   return_code: Статус операции
+ *     NO_ERROR: Блоки прочитаны, отображение собрано
+ *     OPERATION_FAILED: Адрес блока вне flash
+ */
+void FTL_SCAN_SERIAL(
+/* OUT */ RETURN_CODE * return_code)
+{
+  for(FLASH_SECTOR_ID m_id = FTL_SECTOR_FIRST; m_id < FLASH_SECTORS_COUNT;
+      m_id++)
+  {
+    RETURN_CODE m_scan_error = NO_ERROR;
+    FTL_SCAN_SECTOR(
+      m_id, g_ftl->header.map, &g_ftl->sequence, &m_scan_error
+    );
+    if(NO_ERROR != m_scan_error)
+    {
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+  }
+
+  *return_code = NO_ERROR;
+}
+
+#if FTL_MOUNT_THREADS > 1U
+/*
+ * ПОТОК ЧТЕНИЯ СЕКТОРОВ (берет следующий нечитанный сектор):
+ *   volume: FTL тома, таблица которого читается
+ */
+VOID_PTR FTL_SCAN_WORKER(
+/* IN  */ VOID_PTR volume)
+{
+  RETURN_CODE m_select_error = NO_ERROR;
+  FTL_VOLUME_SELECT(
+    (VOLUME_ID)((FTL_VOLUME_TYPE *)volume - g_ftl_volumes), &m_select_error
+  );
+  for(;;)
+  {
+    const U32 M_INDEX = FS_ATOMIC_INCREMENT(g_ftl->scan.next);
+    if(M_INDEX >= FTL_WEAR_SECTORS)
+    {
+      break;
+    }
+    FTL_SCAN_SECTOR(
+      (FLASH_SECTOR_ID)(FTL_SECTOR_FIRST + M_INDEX), g_ftl->scan.maps[M_INDEX],
+      &(g_ftl->scan.sequences[M_INDEX]), &(g_ftl->scan.errors[M_INDEX])
+    );
+  }
+  return (VOID_PTR)(0);
+}
+
+/*
+ * ПАРАЛЛЕЛЬНОЕ ВОССТАНОВЛЕНИЕ ТАБЛИЦЫ (при инициализации):
+ *   return_code: Статус операции
+ *     NO_ERROR: Блоки прочитаны, отображение собрано
+ *     OPERATION_FAILED: Адрес блока вне flash
+ *
+ * Сектор изменяет только свои блоки и свое отображение. Отображения
+ * сливаются по порядку секторов с тем же сравнением номеров записи
+ * (FTL_SCAN_MAP): результат совпадает с FTL_SCAN_SERIAL
+ */
+void FTL_SCAN_PARALLEL(
+/* OUT */ RETURN_CODE * return_code)
+{
+  /* На одном ядре потоки и слияние только замедляют чтение */
+  SIZE32 m_threads_count = FS_CPU_COUNT();
+  if(m_threads_count > FTL_MOUNT_THREADS)
+  {
+    m_threads_count = FTL_MOUNT_THREADS;
+  }
+  if(m_threads_count < 2U)
+  {
+    FTL_SCAN_SERIAL(return_code);
+    return;
+  }
+
+  STD_MEMSET(sizeof(g_ftl->scan.maps), 0xFFU, g_ftl->scan.maps);
+  for(register SIZE32 m_index = 0U; m_index < FTL_WEAR_SECTORS; m_index++)
+  {
+    g_ftl->scan.sequences[m_index] = FTL_SEQUENCE_FIRST;
+  }
+  g_ftl->scan.next = 0U;
+
+  /* Вызывающий поток читает сектора наравне с запущенными */
+  pthread_t m_threads[FTL_MOUNT_THREADS - 1U];
+  SIZE32 m_started = 0U;
+  for(; m_started < m_threads_count - 1U; m_started++)
+  {
+    if(0 != pthread_create(
+      &m_threads[m_started], (VOID_PTR)(0), FTL_SCAN_WORKER, g_ftl))
+    {
+      break;
+    }
+  }
+  FTL_SCAN_WORKER(g_ftl);
+  for(register SIZE32 t = 0U; t < m_started; t++)
+  {
+    pthread_join(m_threads[t], (VOID_PTR *)(0));
+  }
+
+  for(register SIZE32 m_index = 0U; m_index < FTL_WEAR_SECTORS; m_index++)
+  {
+    if(NO_ERROR != g_ftl->scan.errors[m_index])
+    {
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+
+    if(g_ftl->scan.sequences[m_index] > g_ftl->sequence)
+    {
+      g_ftl->sequence = g_ftl->scan.sequences[m_index];
+    }
+
+    /* Номер записи читается только при совпадении логических блоков */
+    for(register FTL_INDEX m_lbi = 0U; m_lbi < FTL_BLOCKS_COUNT; m_lbi++)
+    {
+      const U16 M_ENTRY = g_ftl->scan.maps[m_index][m_lbi];
+      if(FTL_PBI_NONE == M_ENTRY)
+      {
+        continue;
+      }
+      if(FTL_PBI_NONE == g_ftl->header.map[m_lbi])
+      {
+        g_ftl->header.map[m_lbi] = M_ENTRY;
+        continue;
+      }
+      U32 m_sequence = 0U;
+      RETURN_CODE m_sequence_error = NO_ERROR;
+      FTL_SEQUENCE_READ(M_ENTRY, &m_sequence, &m_sequence_error);
+      FTL_SCAN_MAP(m_lbi, M_ENTRY, m_sequence, g_ftl->header.map);
+    }
+  }
+
+  *return_code = NO_ERROR;
+}
+#endif
+
+
+
+void FTL_VOLUME_SELECT(
+/* IN  */ const VOLUME_ID ID,
+/* OUT */ RETURN_CODE * return_code)
+{
+  if(ID >= FS_VOLUMES_COUNT)
+  {
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  RETURN_CODE m_select_error = NO_ERROR;
+  FLASH_VOLUME_SELECT(ID, &m_select_error);
+  g_ftl = &g_ftl_volumes[ID];
+  *return_code = m_select_error;
+}
+
+void FTL_INIT(
+/* OUT */ RETURN_CODE * return_code)
+{
+#if FS_THREAD_SAFE
+  if(0U == g_ftl->lock_ready)
+  {
+    FS_RWLOCK_INIT(&g_ftl->lock);
+    g_ftl->lock_ready = 1U;
+  }
+#endif
+  FS_RWLOCK_SCOPE_WRITE(&g_ftl->lock);
+  if(FTL_MODE_SUPERVISOR != g_ftl->header.mode)
+  {
+    *return_code = ACCESS_DENIED;
+    return;
+  }
+
+  RETURN_CODE m_flash_init = NO_ERROR;
+  FLASH_INIT(&m_flash_init);
+  if(NO_ERROR != m_flash_init)
+  {
+    *return_code = NO_ACTION;
+    return;
+  }
+
+  /* 1. Восстановление таблицы из flash */
+  FLASH_SECTOR_TYPE m_flash_sector;
+  RETURN_CODE m_select_error = NO_ERROR;
+  FLASH_SECTOR_SELECT(2U, &m_flash_sector, &m_select_error);
+  if(NO_ERROR != m_select_error)
+  {
+    *return_code = NO_ACTION;
+    return;
+  }
+  g_ftl->header.pba = m_flash_sector.pba;
+
+  /* Резерв сборщика мусора - блоки наибольшего сектора */
+  g_ftl->reserve = 0U;
+  for(FLASH_SECTOR_ID m_id = FTL_SECTOR_FIRST; m_id < FLASH_SECTORS_COUNT;
+      m_id++)
+  {
+    FTL_INDEX m_start_pbi;
+    FTL_INDEX m_end_pbi;
+    FTL_SECTOR_RANGE(m_id, &m_start_pbi, &m_end_pbi);
+    if((SIZE32)(m_end_pbi - m_start_pbi) > g_ftl->reserve)
+    {
+      g_ftl->reserve = m_end_pbi - m_start_pbi;
+    }
+  }
+  g_ftl->gc_trigger = g_ftl->reserve + FTL_GC_THRESHOLD;
+
+  /* Блоки таблиц порядковых номеров не читаются и остаются изъятыми */
+  STD_MEMSET(sizeof(g_ftl->header.table), 0x00U, g_ftl->header.table);
+  for(register FTL_INDEX i = 0U; i < FTL_BLOCKS_COUNT; i++)
+  {
+    g_ftl->header.map[i] = FTL_PBI_NONE;
+  }
+  STD_MEMSET(sizeof(g_ftl->header.slots), 0x00U, g_ftl->header.slots);
+  g_ftl->sequence = FTL_SEQUENCE_FIRST;
+  for(register SIZE32 i = 0U; i < FTL_SNAPSHOTS_COUNT; i++)
+  {
+    g_ftl->snapshots[i].active = 0U;
+  }
+  for(register SIZE32 i = 0U; i < FTL_ROLLBACKS_COUNT; i++)
+  {
+    g_ftl->rollbacks[i].active = 0U;
+  }
+  g_ftl->barrier = 0U;
+  for(register SIZE32 f = 0U; f < FTL_FRONTIERS_COUNT; f++)
+  {
+    g_ftl->pack[f].pbi = (FTL_INDEX)UN_SET;
+    g_ftl->frontiers[f].sector = FLASH_SECTORS_COUNT;
+  }
+  STD_MEMSET(sizeof(g_ftl->heat), 0x00U, g_ftl->heat);
+  STD_MEMSET(sizeof(g_ftl->views), 0x00U, g_ftl->views);
+  STD_MEMSET(sizeof(g_ftl->dedup), 0xFFU, g_ftl->dedup);
+  g_ftl->gc_cursor = FLASH_SECTORS_COUNT;
+  g_ftl->kv.block.pbi = (FTL_INDEX)UN_SET;
+  g_ftl->kv.sequence = 0U;
+  g_ftl->kv.count = 0U;
+  for(register SIZE32 i = 0U; i < FTL_KV_INDEX_SIZE; i++)
+  {
+    g_ftl->kv.index[i].pbi = FTL_PBI_NONE;
+  }
+
+  RETURN_CODE m_scan_error = NO_ERROR;
+#if FTL_MOUNT_THREADS > 1U
+  FTL_SCAN_PARALLEL(&m_scan_error);
+#else
+  FTL_SCAN_SERIAL(&m_scan_error);
+#endif
+  if(NO_ERROR == m_scan_error)
+  {
+    FTL_KV_SCAN(&m_scan_error);
+  }
+  if(NO_ERROR != m_scan_error)
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+  FTL_FREE_RECOUNT();
+
+  /* 2. Снимки и откаты (удаление записи отката может выделить блок) */
+  RETURN_CODE m_load_error = NO_ERROR;
+  FTL_SNAPSHOT_LOAD(&m_load_error);
+  if(NO_ERROR != m_load_error)
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  g_ftl->header.mode = FTL_MODE_USER;
+
+  *return_code = NO_ERROR;
+}
+
+void FTL_FREE(
+/* OUT */ RETURN_CODE * return_code)
+{
+  FS_RWLOCK_SCOPE_WRITE(&g_ftl->lock);
+  /*
+   * Устаревшие блоки не отмечены во flash: стираем их до выключения
+   * (блоки снимков закреплены: снимки восстанавливает FTL_INIT)
+   */
+  RETURN_CODE m_gc_error = NO_ERROR;
+  FTL_GC_RUN(&m_gc_error);
+
+  g_ftl->header.mode = FTL_MODE_SUPERVISOR;
+  RETURN_CODE m_flash_free_error = NO_ERROR;
+  FLASH_FREE(&m_flash_free_error);
+  if((NO_ERROR != m_gc_error) || (NO_ERROR != m_flash_free_error))
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  *return_code = NO_ERROR;
+}
+
+void FTL_WRITE(
+/* IN  */ const FTL_INDEX LBI,
+/* IN  */ const SIZE32 COUNT,
+/* IN  */ const VOID_PTR DATA,
+/* OUT */ RETURN_CODE * return_code)
+{
+  FS_RWLOCK_SCOPE_WRITE(&g_ftl->lock);
+  if((LBI + COUNT) > FTL_BLOCKS_COUNT)
+  {
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  for(register FTL_INDEX i = 0U; i < COUNT; i++)
+  {
+    RETURN_CODE m_write_error = NO_ERROR;
+    FTL_WRITE_BLOCK(LBI + i, (U8 *)DATA + i * FTL_DATA_SIZE, &m_write_error);
+    if(NO_ERROR != m_write_error)
+    {
+      *return_code
+        = (NO_ACTION == m_write_error) ? NO_ACTION : OPERATION_FAILED;
+      return;
+    }
+  }
+
+  *return_code = NO_ERROR;
+}
+
+void FTL_READ(
+/* IN  */ const FTL_INDEX LBI,
+/* IN  */ const SIZE32 COUNT,
+/* OUT */ VOID_PTR data,
+/* OUT */ RETURN_CODE * return_code)
+{
+  FS_RWLOCK_SCOPE_READ(&g_ftl->lock);
+  if((LBI + COUNT) > FTL_BLOCKS_COUNT)
+  {
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  for(register FTL_INDEX i = 0U; i < COUNT; i++)
+  {
+    RETURN_CODE m_read_error = NO_ERROR;
+    FTL_READ_BLOCK(LBI + i, (U8 *)data + i * FTL_DATA_SIZE, &m_read_error);
+    if(NO_ACTION == m_read_error)
+    {
+      *return_code = NO_ACTION;
+      return;
+    }
+    if(OPERATION_FAILED == m_read_error)
+    {
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+  }
+
+  *return_code = NO_ERROR;
+}
+
+void FTL_HINT(
+/* IN  */ const FTL_INDEX LBI,
+/* IN  */ const SIZE32 COUNT,
+/* IN  */ const FTL_TEMPERATURE TEMPERATURE,
+/* OUT */ RETURN_CODE * return_code)
+{
+  FS_RWLOCK_SCOPE_WRITE(&g_ftl->lock);
+  if((LBI + COUNT > FTL_BLOCKS_COUNT) || (TEMPERATURE > FTL_TEMPERATURE_COLD))
+  {
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  for(register FTL_INDEX i = LBI; i < LBI + COUNT; i++)
+  {
+    g_ftl->heat[i] = (g_ftl->heat[i] & FTL_HEAT_COUNT)
+                  | (U8)(TEMPERATURE << FTL_HEAT_HINT_SHIFT);
+  }
+
+  *return_code = NO_ERROR;
+}
+
+void FTL_DISCARD(
+/* IN  */ const FTL_INDEX LBI,
+/* IN  */ const SIZE32 COUNT,
+/* OUT */ RETURN_CODE * return_code)
+{
+  FS_RWLOCK_SCOPE_WRITE(&g_ftl->lock);
+  if((LBI + COUNT) > FTL_BLOCKS_COUNT)
+  {
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  /* Снимки закрепляют свои блоки сами: отображение снимка не меняется */
+  for(register FTL_INDEX i = LBI; i < LBI + COUNT; i++)
+  {
+    const U16 M_OLD = g_ftl->header.map[i];
+    if(FTL_PBI_NONE == M_OLD)
+    {
+      continue;
+    }
+    g_ftl->header.map[i] = FTL_PBI_NONE;
+    FTL_MAP_RELEASE(M_OLD);
+
+    /* Новые данные блока оцениваются заново, подсказка сохраняется */
+    g_ftl->heat[i] &= ~FTL_HEAT_COUNT;
+    g_ftl->stats.gc.discards++;
+  }
+
+  *return_code = NO_ERROR;
+}
+
+/*
+ * ПРОВЕРИТЬ РЕЗЕРВ СБОРЩИКА МУСОРА ПЕРЕД ОТОБРАЖЕНИЕМ БЛОКА:
+ *   PBI: Отображаемый физический блок
+ *   return_code: Статус операции
+ *     NO_ERROR: В секторе блока уже есть отображения или сектора без
+ *               отображений вмещают все актуальные блоки, резерв и порог
+ *               сборки
+ *     DEVICE_BUSY: Закрепление сектора оставит сборщик мусора без резерва
+ *
+ * Сектор с отображенным блоком не стирается до FTL_VIEW_CLOSE: его
+ * свободные блоки расходуются, устаревшие не освобождаются. Актуальные
+ * блоки при перезаписи уходят из закрепленных секторов, поэтому остальные
+ * сектора должны вместить их все вместе с резервом
+ */
+void FTL_VIEW_RESERVE(
+/* IN  */ const FTL_INDEX PBI,
+/* OUT */ RETURN_CODE * return_code)
+{
+  SIZE32 m_capacity = 0U;
+  SIZE32 m_live = 0U;
+  for(FLASH_SECTOR_ID m_id = FTL_SECTOR_FIRST; m_id < FLASH_SECTORS_COUNT;
+      m_id++)
+  {
+    FTL_INDEX m_start_pbi;
+    FTL_INDEX m_end_pbi;
+    FTL_SECTOR_RANGE(m_id, &m_start_pbi, &m_end_pbi);
+    const U8 M_TARGET = (PBI >= m_start_pbi) && (PBI < m_end_pbi);
+    U8 m_viewed = 0U;
+    SIZE32 m_usable = 0U;
+    for(register FTL_INDEX i = m_start_pbi; i < m_end_pbi; i++)
+    {
+      m_viewed = m_viewed || (0U != g_ftl->views[i]);
+      m_usable += (FTL_FLAG_BAD != g_ftl->header.table[i].flag);
+      m_live += (FTL_FLAG_VALID == g_ftl->header.table[i].flag)
+        || (0U != (g_ftl->pinned[i / 32U] & (1UL << (i % 32U))));
+    }
+
+    /* Сектор уже закреплен - резерв не меняется */
+    if(M_TARGET && m_viewed)
+    {
+      *return_code = NO_ERROR;
+      return;
+    }
+    if(!M_TARGET && !m_viewed)
+    {
+      m_capacity += m_usable;
+    }
+  }
+
+  *return_code = (m_capacity >= m_live + g_ftl->reserve + FTL_GC_THRESHOLD)
+    ? NO_ERROR : DEVICE_BUSY;
+}
+
+void FTL_VIEW_OPEN(
+/* IN  */ const FTL_INDEX LBI,
+/* OUT */ const U8 ** data,
+/* OUT */ RETURN_CODE * return_code)
+{
+  FS_RWLOCK_SCOPE_WRITE(&g_ftl->lock);
+  if(LBI >= FTL_BLOCKS_COUNT)
+  {
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+#if FTL_ENCRYPT
+  /* Во flash лежат только зашифрованные данные */
+  (void)data;
+  *return_code = NO_ACTION;
+#else
+  /* 1. Данные на месте есть только у блока без сжатия */
+  FTL_INDEX m_pbi;
+  RETURN_CODE m_get_error = NO_ERROR;
+  FTL_BLOCK_GET(LBI, &m_pbi, &m_get_error);
+  if((NO_ERROR != m_get_error)
+  || (FTL_FORMAT_PACKED == g_ftl->header.table[m_pbi].format)
+  || (0xFFU == g_ftl->views[m_pbi]))
+  {
+    *return_code = NO_ACTION;
+    return;
+  }
+
+  const U8 * m_block;
+  RETURN_CODE m_pointer_error = NO_ERROR;
+  FLASH_POINTER(
+    m_pbi * FTL_BLOCK_SIZE + g_ftl->header.pba, &m_block, &m_pointer_error
+  );
+  if(NO_ERROR != m_pointer_error)
+  {
+    *return_code = OPERATION_FAILED;
+    return;
+  }
+
+  /* 2. Проверка один раз: данные с ошибкой (в том числе исправимой ECC)
+   * читаются через FTL_READ */
+  U32 m_crc32 = 0U;
+  HASH_CRC(
+    (VOID_PTR)(m_block + sizeof(FTL_BLOCK_TYPE)), FTL_DATA_SIZE, &m_crc32
+  );
+  if(m_crc32 != g_ftl->header.table[m_pbi].crc32)
+  {
+    *return_code = NO_ACTION;
+    return;
+  }
+
+  /* 3. Закрепленные сектора не должны забирать резерв сборщика мусора */
+  FTL_VIEW_RESERVE(m_pbi, return_code);
+  if(NO_ERROR != *return_code)
+  {
+    return;
+  }
+
+  g_ftl->views[m_pbi]++;
+  *data = m_block + sizeof(FTL_BLOCK_TYPE);
+  *return_code = NO_ERROR;
+#endif
+}
+
+void FTL_VIEW_CLOSE(
+/* IN  */ const U8 * DATA,
+/* OUT */ RETURN_CODE * return_code)
+{
+  FS_RWLOCK_SCOPE_WRITE(&g_ftl->lock);
+  const U8 * m_base;
+  RETURN_CODE m_pointer_error = NO_ERROR;
+  FLASH_POINTER(g_ftl->header.pba, &m_base, &m_pointer_error);
+  if((NO_ERROR != m_pointer_error) || (DATA < m_base)
+  || (DATA >= m_base + FTL_BLOCKS_COUNT * FTL_BLOCK_SIZE))
+  {
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  const FTL_INDEX M_PBI = (FTL_INDEX)(DATA - m_base) / FTL_BLOCK_SIZE;
+  if(0U == g_ftl->views[M_PBI])
+  {
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  /* Сектор снова стирается следующей сборкой мусора */
+  g_ftl->views[M_PBI]--;
+  *return_code = NO_ERROR;
 }
 
+
 /*
- * ПОЛУЧИТЬ ФИЗ. БЛОК ПО ЛОГИЧЕСКОМУ НОМЕРУ:
- *   LBI: Номер логического блока
- *   pbi: Номер физического блока
- *   return_code: Статус операции
- *     NO_ERROR: Найден физический блок с присвоенным логическим номером
- *     INVALID_PARAM: Номер логического блока выходит за границы
- *     NO_ACTION: Блок устаревший
- *     OPERATION_FAILED: Блок не найден
+ * ПОДГОТОВКА СБОРКИ МУСОРА:
+ *   AGE: 1 - начало цикла сборки (счетчики записей стареют)
+ *
+ * Открытые блоки сжатых данных и записей ключ-значение закрываются,
+ * индекс повторов сбрасывается (блоки могут быть перенесены), карта
+ * закрепленных блоков строится заново
  */
-void FTL_BLOCK_GET(
-/* IN  */ const FTL_INDEX LBI,
-/* OUT */ FTL_INDEX * pbi,
-/* OUT */ RETURN_CODE * return_code)
+void FTL_GC_PREPARE(
+/* IN  */ const U8 AGE)
 {
-  if(LBI >= FTL_BLOCKS_COUNT)
+  for(register SIZE32 f = 0U; f < FTL_FRONTIERS_COUNT; f++)
   {
-    *return_code = INVALID_PARAM;
-    return;
+    if(((FTL_INDEX)UN_SET != g_ftl->pack[f].pbi)
+    && (0U == (g_ftl->header.slots[g_ftl->pack[f].pbi] & FTL_SLOTS_LIVE)))
+    {
+      g_ftl->header.table[g_ftl->pack[f].pbi].flag = FTL_FLAG_DIRTY;
+    }
+    g_ftl->pack[f].pbi = (FTL_INDEX)UN_SET;
+  }
+  if(((FTL_INDEX)UN_SET != g_ftl->kv.block.pbi)
+  && (0U == (g_ftl->header.slots[g_ftl->kv.block.pbi] & FTL_SLOTS_LIVE)))
+  {
+    g_ftl->header.table[g_ftl->kv.block.pbi].flag = FTL_FLAG_DIRTY;
   }
+  g_ftl->kv.block.pbi = (FTL_INDEX)UN_SET;
+  STD_MEMSET(sizeof(g_ftl->dedup), 0xFFU, g_ftl->dedup);
 
-  for(register FTL_INDEX i = 0U; i < FTL_BLOCKS_COUNT; i++)
+  /* Счетчики записей стареют: горячими остаются часто перезаписываемые */
+  for(register FTL_INDEX i = 0U; AGE && (i < FTL_BLOCKS_COUNT); i++)
   {
-    if(g_ftl_header.table[i].lbi == LBI)
+    const U8 M_COUNT = g_ftl->heat[i] & FTL_HEAT_COUNT;
+    g_ftl->heat[i] = (g_ftl->heat[i] & ~FTL_HEAT_COUNT) | (M_COUNT >> 1U);
+  }
+
+  /* Устаревшие блоки из снимков считаются актуальными */
+  STD_MEMSET(sizeof(g_ftl->pinned), 0x00U, g_ftl->pinned);
+  for(register SIZE32 s = 0U; s < FTL_SNAPSHOTS_COUNT; s++)
+  {
+    if(0U == g_ftl->snapshots[s].active)
     {
-      *pbi = i;
-      if(g_ftl_header.table[i].flag == FTL_FLAG_VALID)
-      {
-        *return_code = NO_ERROR;
-      }
-      if(g_ftl_header.table[i].flag == FTL_FLAG_DIRTY)
+      continue;
+    }
+    for(register FTL_INDEX i = 0U; i < FTL_BLOCKS_COUNT; i++)
+    {
+      if(FTL_PBI_NONE != g_ftl->snapshots[s].map[i])
       {
-        *return_code = NO_ACTION;
+        const FTL_INDEX M_PBI = FTL_MAP_PBI(g_ftl->snapshots[s].map[i]);
+        g_ftl->pinned[M_PBI / 32U] |= (1UL << (M_PBI % 32U));
       }
-      return;
     }
   }
-  *return_code = OPERATION_FAILED;
 }
 
 /*
- * ЗАПИСАТЬ БЛОК:
- *   LBI: Номер логического блока
- *   DATA: Блок данных (250 байт)
+ * СБОРКА МУСОРА В СЕКТОРЕ:
+ *   SECTOR_ID: Номер сектора FTL
  *   return_code: Статус операции
- *     NO_ERROR: Успешная запись
- *     OPERATION_FAILED: Невозможно записать данные в память
+ *     NO_ERROR: Сектор освобожден и стерт
+ *     NO_ACTION: Устаревших блоков нет или не хватает места для переноса
+ *     OPERATION_FAILED: Ошибка переноса или стирания
  */
-void FTL_WRITE_BLOCK(
-/* IN  */ const FTL_INDEX LBI,
-/* IN  */ const VOID_PTR DATA,
+void FTL_GC_SECTOR(
+/* IN  */ const FLASH_SECTOR_ID SECTOR_ID,
 /* OUT */ RETURN_CODE * return_code)
 {
-  /* 1. Найти текущий физический блок (если есть) */
-  FTL_INDEX m_old_pbi;
-  RETURN_CODE m_get_error = NO_ERROR;
-  FTL_BLOCK_GET(LBI, &m_old_pbi, &m_get_error);
+  FTL_INDEX m_start_pbi;
+  FTL_INDEX m_end_pbi;
+  FTL_SECTOR_RANGE(SECTOR_ID, &m_start_pbi, &m_end_pbi);
 
-  /* 2. Выделить новый физический блок */
-  FTL_INDEX m_new_pbi;
-  RETURN_CODE m_alloc_error = NO_ERROR;
-  FTL_BLOCK_ALLOCATE(&m_new_pbi, &m_alloc_error);
-  if(NO_ERROR != m_alloc_error)
+  /* 1. Подсчет устаревших блоков сектора */
+  SIZE32 m_dirty_count = 0U;
+  for(register FTL_INDEX i = m_start_pbi; i < m_end_pbi; i++)
   {
-    *return_code = OPERATION_FAILED;
+    const U8 M_PINNED = (0U != (g_ftl->pinned[i / 32U] & (1UL << (i % 32U))));
+    if((g_ftl->header.table[i].flag == FTL_FLAG_DIRTY) && !M_PINNED)
+    {
+      m_dirty_count++;
+    }
+    /* Сжатый блок с устаревшими ячейками (блок ключ-значение
+     * с устаревшими записями) при переносе уплотняется */
+    if((g_ftl->header.table[i].flag == FTL_FLAG_VALID)
+    && (g_ftl->header.table[i].format != FTL_FORMAT_RAW)
+    && (0U != (g_ftl->header.slots[i] & FTL_SLOTS_STALE)))
+    {
+      m_dirty_count++;
+    }
+  }
+  if(0U == m_dirty_count)
+  {
+    *return_code = NO_ACTION;
     return;
   }
 
-  /* 3. Подготовить данные */
-  U8 m_block[FTL_BLOCK_SIZE];
-  U8 m_data[FTL_BLOCK_SIZE - sizeof(FTL_BLOCK_TYPE)];
-  STD_MEMCPY(FTL_BLOCK_SIZE - sizeof(FTL_BLOCK_TYPE), DATA, m_data);
-
-  // 4.1. Шифрование данных
-  FLASH_ADDRESS m_new_pba = m_new_pbi * FTL_BLOCK_SIZE + g_ftl_header.pba;
-  //CRYPT_XOR(m_data, FTL_BLOCK_SIZE - sizeof(FTL_BLOCK_TYPE), m_new_pba);
-
-  // 4.2. Вычисление CRC
-  U32 m_crc32 = 0U;
-  HASH_CRC(m_data, FTL_BLOCK_SIZE - sizeof(FTL_BLOCK_TYPE), &m_crc32);
+  /* 2. Перенос актуальных блоков и стирание */
+  SIZE32 m_moved = 0U;
+  FTL_SECTOR_RECLAIM(SECTOR_ID, &m_moved, return_code);
+}
 
-  // 4.3. Формирование блока: метаданные + данные
-  FTL_BLOCK_TYPE m_meta =
-  (FTL_BLOCK_TYPE){
-    .flag = FTL_FLAG_VALID,
-    .lbi = LBI,
-    .crc32 = m_crc32
-  };
+void FTL_GC_RUN(
+/* OUT */ RETURN_CODE * return_code)
+{
+  g_ftl->stats.gc.runs++;
+  FTL_GC_PREPARE(1U);
 
-  // Копируем метаданные
-  STD_MEMCPY(sizeof(FTL_BLOCK_TYPE), &m_meta, m_block);
-  STD_MEMCPY(
-    FTL_BLOCK_SIZE - sizeof(FTL_BLOCK_TYPE), m_data,
-    m_block + sizeof(FTL_BLOCK_TYPE)
-  );
+  /* Проходим по каждому сектору */
+  FLASH_SECTOR_ID m_sector_id = FTL_SECTOR_FIRST;
+  for(; m_sector_id < FLASH_SECTORS_COUNT; m_sector_id++)
+  {
+    RETURN_CODE m_sector_error = NO_ERROR;
+    FTL_GC_SECTOR(m_sector_id, &m_sector_error);
+    if(OPERATION_FAILED == m_sector_error)
+    {
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+  }
 
-  // 5. Записать во flash
-  RETURN_CODE m_write_error = NO_ERROR;
-  FLASH_WRITE(m_new_pba, FTL_BLOCK_SIZE, m_block, &m_write_error);
-  if(NO_ERROR != m_write_error)
+  /* Статическое выравнивание износа */
+  RETURN_CODE m_level_error = NO_ERROR;
+  FTL_WEAR_LEVEL(&m_level_error);
+  if(OPERATION_FAILED == m_level_error)
   {
     *return_code = OPERATION_FAILED;
     return;
   }
 
-  // 6. Обновить таблицу FTL
-  g_ftl_header.table[m_new_pbi] = m_meta;
-  if(NO_ERROR == m_get_error)
+  /* Запас не восстановлен: следующая сборка - после расхода половины
+   * остатка (сборка без результата не повторяется на каждой записи) */
+  if(g_ftl->free_count < g_ftl->reserve + FTL_GC_THRESHOLD)
   {
-    g_ftl_header.table[m_old_pbi].flag = FTL_FLAG_DIRTY;
+    g_ftl->gc_trigger = (g_ftl->free_count > g_ftl->reserve)
+      ? g_ftl->reserve + (g_ftl->free_count - g_ftl->reserve) / 2U
+      : g_ftl->reserve;
   }
 
   *return_code = NO_ERROR;
 }
 
-/*
- * ПРОЧИТАТЬ БЛОК:
- *   LBI: Номер логического блока
- *   data: Блок данных (250 байт)
- *   return_code: Статус операции
- *     NO_ERROR: Блок успешно прочитан
- *     NO_ACTION: Блока не существует или не доступен
- *     OPERATION_FAILED: Чтение не выполнено или данные повреждены
- */
-void FTL_READ_BLOCK(
-/* IN  */ const U32 LBI,
-/* OUT */ VOID_PTR data,
+void FTL_GARBAGE_COLLECT(
 /* OUT */ RETURN_CODE * return_code)
 {
-  /* 1. Найти физический блок */
-  FTL_INDEX m_pbi;
-  RETURN_CODE m_get_error = NO_ERROR;
-  FTL_BLOCK_GET(LBI, &m_pbi, &m_get_error);
-  if(NO_ERROR != m_get_error)
+  FS_RWLOCK_SCOPE_WRITE(&g_ftl->lock);
+  FTL_GC_RUN(return_code);
+}
+
+void FTL_GARBAGE_COLLECT_STEP(
+/* OUT */ U8 * done,
+/* OUT */ RETURN_CODE * return_code)
+{
+  FS_RWLOCK_SCOPE_WRITE(&g_ftl->lock);
+  *done = 0U;
+
+  /* Между шагами идет запись: подготовка повторяется на каждом шаге */
+  if(FLASH_SECTORS_COUNT == g_ftl->gc_cursor)
   {
-    STD_MEMSET(250U, 0xFF, data);
-    *return_code = NO_ACTION;
-    return;
+    g_ftl->stats.gc.runs++;
+    g_ftl->gc_cursor = FTL_SECTOR_FIRST;
+    FTL_GC_PREPARE(1U);
+  }
+  else
+  {
+    FTL_GC_PREPARE(0U);
   }
 
-  /* 2. Прочитать блок из flash */
-  U8 m_block[FTL_BLOCK_SIZE];
-  FLASH_ADDRESS m_pba = m_pbi * FTL_BLOCK_SIZE + g_ftl_header.pba;
-  RETURN_CODE m_read_error = NO_ERROR;
-  FLASH_READ(m_pba, FTL_BLOCK_SIZE, m_block, &m_read_error);
-  if(OPERATION_FAILED == m_read_error)
+  /* 1. Следующий сектор с устаревшими блоками */
+  while(g_ftl->gc_cursor < FLASH_SECTORS_COUNT)
+  {
+    RETURN_CODE m_sector_error = NO_ERROR;
+    FTL_GC_SECTOR(g_ftl->gc_cursor++, &m_sector_error);
+    if(OPERATION_FAILED == m_sector_error)
+    {
+      g_ftl->gc_cursor = FLASH_SECTORS_COUNT;
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+    if(NO_ERROR == m_sector_error)
+    {
+      *return_code = NO_ERROR;
+      return;
+    }
+  }
+
+  /* 2. Конец цикла: статическое выравнивание износа */
+  RETURN_CODE m_level_error = NO_ERROR;
+  FTL_WEAR_LEVEL(&m_level_error);
+  if(OPERATION_FAILED == m_level_error)
   {
     *return_code = OPERATION_FAILED;
     return;
   }
 
-  /* 3. Извлечь метаданные и данные */
-  FTL_BLOCK_TYPE m_meta;
-  STD_MEMCPY(sizeof(FTL_BLOCK_TYPE), m_block, &m_meta);
-  U8 m_data[FTL_BLOCK_SIZE - sizeof(FTL_BLOCK_TYPE)];
-  STD_MEMCPY(
-    FTL_BLOCK_SIZE - sizeof(FTL_BLOCK_TYPE),
-    m_block + sizeof(FTL_BLOCK_TYPE), m_data
-  );
+  *done = 1U;
+  *return_code = NO_ERROR;
+}
+
 
-  if(FTL_FLAG_VALID == m_meta.flag)
+void FTL_SNAPSHOT_CREATE(
+/* OUT */ FTL_SNAPSHOT_ID * id,
+/* OUT */ RETURN_CODE * return_code)
+{
+  FS_RWLOCK_SCOPE_WRITE(&g_ftl->lock);
+  for(register FTL_SNAPSHOT_ID i = 0U; i < FTL_SNAPSHOTS_COUNT; i++)
   {
-    /* 4. Проверить CRC */
-    U32 m_crc32 = 0U;
-    HASH_CRC(m_data, FTL_BLOCK_SIZE - sizeof(FTL_BLOCK_TYPE), &m_crc32);
+    if(g_ftl->snapshots[i].active)
+    {
+      continue;
+    }
 
-    if(m_crc32 != m_meta.crc32)
+    /* Во flash - номер создания: снимок содержит копии с меньшими
+     * номерами (запись может запустить сборку мусора, поэтому
+     * отображение копируется после нее) */
+    const U8 M_KEY = (U8)i;
+    const U32 M_SEQUENCE = g_ftl->sequence;
+    FTL_KV_APPEND(
+      FTL_KV_SPACE_SNAPSHOT, &M_KEY, 1U, (const U8 *)&M_SEQUENCE,
+      sizeof(M_SEQUENCE), 0U, return_code
+    );
+    if(NO_ERROR != *return_code)
     {
-      *return_code = OPERATION_FAILED;
       return;
     }
-  }
 
-  /* 5. Расшифровать данные */
-  //CRYPT_XOR(m_data, FTL_BLOCK_SIZE - sizeof(FTL_BLOCK_TYPE), m_pba);
+    /* Данные не копируются: снимок - копия отображения */
+    STD_MEMCPY(sizeof(FTL_MAP), g_ftl->header.map, g_ftl->snapshots[i].map);
+    g_ftl->snapshots[i].sequence = M_SEQUENCE;
+    g_ftl->snapshots[i].active = 1U;
+    g_ftl->barrier = M_SEQUENCE;
 
-  /* 6. Скопировать в выходной буфер */
-  STD_MEMCPY(FTL_BLOCK_SIZE - sizeof(FTL_BLOCK_TYPE), m_data, data);
+    *id = i;
+    *return_code = NO_ERROR;
+    return;
+  }
 
-  *return_code = NO_ERROR;
+  *return_code = NO_ACTION;
 }
 
+void FTL_SNAPSHOT_DELETE(
+/* IN  */ const FTL_SNAPSHOT_ID ID,
+/* OUT */ RETURN_CODE * return_code)
+{
+  FS_RWLOCK_SCOPE_WRITE(&g_ftl->lock);
+  if((ID >= FTL_SNAPSHOTS_COUNT) || !g_ftl->snapshots[ID].active)
+  {
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  const U8 M_KEY = (U8)ID;
+  FTL_KV_APPEND(
+    FTL_KV_SPACE_SNAPSHOT, &M_KEY, 1U, (const U8 *)(0), 0U, 1U, return_code
+  );
+  if(NO_ERROR != *return_code)
+  {
+    return;
+  }
 
+  /* Закрепленные блоки освободит следующая сборка мусора */
+  g_ftl->snapshots[ID].active = 0U;
+}
 
-void FTL_INIT(
+void FTL_SNAPSHOT_ROLLBACK(
+/* IN  */ const FTL_SNAPSHOT_ID ID,
 /* OUT */ RETURN_CODE * return_code)
 {
-  if(FTL_MODE_SUPERVISOR != g_ftl_header.mode)
+  FS_RWLOCK_SCOPE_WRITE(&g_ftl->lock);
+  if((ID >= FTL_SNAPSHOTS_COUNT) || !g_ftl->snapshots[ID].active)
   {
-    *return_code = ACCESS_DENIED;
+    *return_code = INVALID_PARAM;
     return;
   }
 
-  RETURN_CODE m_flash_init = NO_ERROR;
-  FLASH_INIT(&m_flash_init);
-  if(NO_ERROR != m_flash_init)
+  SIZE32 m_free = 0U;
+  while((m_free < FTL_ROLLBACKS_COUNT) && g_ftl->rollbacks[m_free].active)
+  {
+    m_free++;
+  }
+  if(m_free >= FTL_ROLLBACKS_COUNT)
   {
     *return_code = NO_ACTION;
     return;
   }
 
-  /* 1. Восстановление таблицы из flash */
-  FLASH_SECTOR_TYPE m_flash_sector;
-  RETURN_CODE m_select_error = NO_ERROR;
-  FLASH_SECTOR_SELECT(2U, &m_flash_sector, &m_select_error);
-  if(NO_ERROR != m_select_error)
+  /* 1. Запись отката - точка фиксации: после сбоя питания FTL_INIT
+   * отменяет копии, записанные после снимка */
+  const U8 M_KEY = (U8)m_free;
+  const U32 M_RANGE[2U] = { g_ftl->snapshots[ID].sequence, g_ftl->sequence };
+  FTL_KV_APPEND(
+    FTL_KV_SPACE_ROLLBACK, &M_KEY, 1U, (const U8 *)M_RANGE, sizeof(M_RANGE),
+    0U, return_code
+  );
+  if(NO_ERROR != *return_code)
   {
-    *return_code = NO_ACTION;
     return;
   }
-  g_ftl_header.pba = m_flash_sector.pba;
+  g_ftl->rollbacks[m_free] =
+  (FTL_ROLLBACK_TYPE){
+    .active = 1U,
+    .start = M_RANGE[0U],
+    .end = M_RANGE[1U]
+  };
 
-  for(U32 i = 0U; i < FTL_BLOCKS_COUNT; i++)
-  {
-    FLASH_ADDRESS m_pba = i * FTL_BLOCK_SIZE + g_ftl_header.pba;
-    FTL_BLOCK_TYPE m_meta;
+  /* Номер end пропускается: снимки до и после отката различаются */
+  g_ftl->sequence = M_RANGE[1U] + 1U;
+  g_ftl->barrier = g_ftl->sequence;
 
-    U8 m_buffer[8U];
-    RETURN_CODE m_read_error = NO_ERROR;
-    FLASH_READ(m_pba, 8U, m_buffer, &m_read_error);
-    if(NO_ERROR != m_read_error)
-    {
-      *return_code = OPERATION_FAILED;
-      return;
-    }
-    STD_MEMCPY(sizeof(FTL_BLOCK_TYPE), m_buffer, &m_meta);
+  /* 2. Версии снимка снова актуальны, текущие устаревают (хранилище
+   * ключ-значение не в снимке) */
+  STD_MEMCPY(sizeof(FTL_MAP), g_ftl->snapshots[ID].map, g_ftl->header.map);
+  FTL_MAP_REFLAG();
 
-    g_ftl_header.table[i] = m_meta;
-    if(FTL_FLAG_FREE == g_ftl_header.table[i].flag)
-    {
-      g_ftl_header.table[i] =
-      (FTL_BLOCK_TYPE){
-        .flag = FTL_FLAG_FREE,
-        .lbi = 0U,
-        .crc32 = 0U
-      };
-    }
+  /* 3. Новые ячейки пишутся в новые блоки */
+  for(register SIZE32 f = 0U; f < FTL_FRONTIERS_COUNT; f++)
+  {
+    g_ftl->pack[f].pbi = (FTL_INDEX)UN_SET;
   }
-
-  g_ftl_header.mode = FTL_MODE_USER;
+  STD_MEMSET(sizeof(g_ftl->dedup), 0xFFU, g_ftl->dedup);
 
   *return_code = NO_ERROR;
 }
 
-void FTL_FREE(
+void FTL_KV_PUT(
+/* IN  */ const VOID_PTR KEY,
+/* IN  */ const SIZE32 KEY_LENGTH,
+/* IN  */ const VOID_PTR VALUE,
+/* IN  */ const SIZE32 VALUE_LENGTH,
 /* OUT */ RETURN_CODE * return_code)
 {
-  g_ftl_header.mode = FTL_MODE_SUPERVISOR;
-  /* TODO: garbage_collect */
-  RETURN_CODE m_flash_free_error = NO_ERROR;
-  FLASH_FREE(&m_flash_free_error);
-  /* TODO: m_flash_free_error */
+  FS_RWLOCK_SCOPE_WRITE(&g_ftl->lock);
+  if((0U == KEY_LENGTH) || (KEY_LENGTH > FTL_KV_KEY_SIZE)
+  || (VALUE_LENGTH > FTL_KV_VALUE_SIZE))
+  {
+    *return_code = INVALID_PARAM;
+    return;
+  }
+
+  FTL_KV_APPEND(
+    FTL_KV_SPACE_USER, (const U8 *)KEY, KEY_LENGTH, (const U8 *)VALUE,
+    VALUE_LENGTH, 0U, return_code
+  );
+  if(NO_ERROR == *return_code)
+  {
+    g_ftl->stats.kv.puts++;
+  }
 }
 
-void FTL_WRITE(
-/* IN  */ const FTL_INDEX LBI,
-/* IN  */ const SIZE32 COUNT,
-/* IN  */ const VOID_PTR DATA,
+void FTL_KV_GET(
+/* IN  */ const VOID_PTR KEY,
+/* IN  */ const SIZE32 KEY_LENGTH,
+/* IN  */ const SIZE32 CAPACITY,
+/* OUT */ VOID_PTR value,
+/* OUT */ SIZE32 * value_length,
 /* OUT */ RETURN_CODE * return_code)
 {
-  if((LBI + COUNT) >= FTL_BLOCKS_COUNT) /* TODO: check > or >= */
+  FS_RWLOCK_SCOPE_READ(&g_ftl->lock);
+  *value_length = 0U;
+  if((0U == KEY_LENGTH) || (KEY_LENGTH > FTL_KV_KEY_SIZE))
   {
     *return_code = INVALID_PARAM;
     return;
   }
 
-  for(register FTL_INDEX i = 0U; i < COUNT; i++)
-  {
-    RETURN_CODE m_write_error = NO_ERROR;
-    FTL_WRITE_BLOCK(LBI + i, (U8 *)DATA + i * FTL_BLOCK_SIZE, &m_write_error);
-    if(NO_ERROR != m_write_error)
-    {
-      *return_code = OPERATION_FAILED;
-      return;
-    }
-  }
+  FTL_KV_LOOKUP(
+    FTL_KV_SPACE_USER, (const U8 *)KEY, KEY_LENGTH, CAPACITY, (U8 *)value,
+    value_length, return_code
+  );
 }
 
-void FTL_READ(
-/* IN  */ const FTL_INDEX LBI,
-/* IN  */ const SIZE32 COUNT,
-/* OUT */ VOID_PTR data,
+void FTL_KV_DELETE(
+/* IN  */ const VOID_PTR KEY,
+/* IN  */ const SIZE32 KEY_LENGTH,
 /* OUT */ RETURN_CODE * return_code)
 {
-  if((LBI + COUNT) >= FTL_BLOCKS_COUNT) /* TODO: check > or >= */
+  FS_RWLOCK_SCOPE_WRITE(&g_ftl->lock);
+  if((0U == KEY_LENGTH) || (KEY_LENGTH > FTL_KV_KEY_SIZE))
   {
     *return_code = INVALID_PARAM;
     return;
   }
 
-  for(register FTL_INDEX i = 0U; i < COUNT; i++)
+  FTL_KV_APPEND(
+    FTL_KV_SPACE_USER, (const U8 *)KEY, KEY_LENGTH, (const U8 *)(0), 0U, 1U,
+    return_code
+  );
+  if(NO_ERROR == *return_code)
   {
-    RETURN_CODE m_read_error = NO_ERROR;
-    FTL_READ_BLOCK(LBI + i, data + i * FTL_BLOCK_SIZE, &m_read_error);
-    if(NO_ACTION == m_read_error)
-    {
-      *return_code = NO_ACTION;
-      return;
-    }
-    if(OPERATION_FAILED == m_read_error)
-    {
-      *return_code = OPERATION_FAILED;
-      return;
-    }
+    g_ftl->stats.kv.deletes++;
   }
 }
 
-
-void FTL_GARBAGE_COLLECT(
+void FTL_STATS(
+/* OUT */ FTL_STATS_TYPE * stats,
 /* OUT */ RETURN_CODE * return_code)
 {
-  /* Проходим по каждому сектору */
-  FLASH_SECTOR_ID m_sector_id = 2U;
-  for(; m_sector_id < FLASH_SECTORS_COUNT; m_sector_id++)
-  {
-    FLASH_ADDRESS m_start_pba = 0x0;
-    FLASH_ADDRESS m_end_pba = 0x0;
-
-    /* no need to check m_select_error */
-    RETURN_CODE m_borders_error = NO_ERROR;
-    FLASH_SECTOR_BORDERS(
-      m_sector_id, &m_start_pba, &m_end_pba, &m_borders_error
-    );
+  FS_RWLOCK_SCOPE_READ(&g_ftl->lock);
+  *stats = g_ftl->stats;
+  stats->kv.keys = g_ftl->kv.count;
+  stats->gc.free_blocks = g_ftl->free_count;
+  stats->gc.reserve = g_ftl->reserve;
 
-    FTL_INDEX m_start_pbi = (m_start_pba - g_ftl_header.pba) / FTL_BLOCK_SIZE;
-    FTL_INDEX m_end_pbi = (m_end_pba - g_ftl_header.pba) / FTL_BLOCK_SIZE;
-
-    FTL_INDEX m_dirty_pbi = m_start_pbi;
-    I32 m_sector_to_erase = 0;
-    for(; m_dirty_pbi < m_end_pbi; m_dirty_pbi++)
+  /* Изъятые блоки учитываются по таблице (без блоков таблиц порядковых
+   * номеров), коррекции считает flash-драйвер */
+  stats->health.bad_blocks = 0U;
+  for(FLASH_SECTOR_ID m_id = FTL_SECTOR_FIRST; m_id < FLASH_SECTORS_COUNT;
+      m_id++)
+  {
+    FTL_INDEX m_start_pbi;
+    FTL_INDEX m_end_pbi;
+    FTL_SECTOR_RANGE(m_id, &m_start_pbi, &m_end_pbi);
+    for(register FTL_INDEX i = m_start_pbi; i < m_end_pbi; i++)
     {
-      if(g_ftl_header.table[m_dirty_pbi].flag == FTL_FLAG_DIRTY)
+      if(g_ftl->header.table[i].flag == FTL_FLAG_BAD)
       {
-        I32 m_sector_to_erase = 1;
-        /* Найти свободный блок в следующих секторах */
-        FTL_INDEX m_free_pbi = 0U;
-        for(; m_free_pbi < FTL_BLOCKS_COUNT; m_free_pbi++)
-        {
-          if((m_free_pbi >= m_start_pbi) && (m_free_pbi < m_end_pbi))
-          {
-            continue;
-          }
-          if(g_ftl_header.table[m_free_pbi].flag == FTL_FLAG_FREE)
-          {
-            break;
-          }
-        }
-        /* TODO: свободный блок не найден */
-
-        /* Получить адреса старого и нового блока */
-        U8 m_data[FTL_BLOCK_SIZE];
-        const FLASH_ADDRESS M_DIRTY_PBA
-          = m_dirty_pbi * FTL_BLOCK_SIZE + g_ftl_header.pba;
-        const FLASH_ADDRESS M_FREE_PBA
-          = m_free_pbi * FTL_BLOCK_SIZE + g_ftl_header.pba;
-
-        /* Переместить блок */
-        RETURN_CODE m_read_error = NO_ERROR;
-        FLASH_READ(M_DIRTY_PBA, FTL_BLOCK_SIZE, m_data, &m_read_error);
-        if(NO_ERROR != m_read_error)
-        {
-          *return_code = OPERATION_FAILED;
-          return;
-        }
-
-        RETURN_CODE m_write_error = NO_ERROR;
-        FLASH_WRITE(M_FREE_PBA, FTL_BLOCK_SIZE, m_data, &m_write_error);
-        if(NO_ERROR != m_write_error)
-        {
-          *return_code = OPERATION_FAILED;
-          return;
-        }
-
-        /* Обновить таблицу FTL */
-        g_ftl_header.table[m_free_pbi] = g_ftl_header.table[m_dirty_pbi];
-        g_ftl_header.table[m_dirty_pbi] =
-        (FTL_BLOCK_TYPE){
-          .flag = FTL_FLAG_FREE,
-          .lbi = 0U,
-          .crc32 = 0U
-        };
+        stats->health.bad_blocks++;
       }
     }
+  }
+  FLASH_STATS_TYPE m_flash_stats;
+  RETURN_CODE m_flash_stats_error = NO_ERROR;
+  FLASH_STATS(&m_flash_stats, &m_flash_stats_error);
+  stats->health.ecc_corrected = m_flash_stats.ecc_corrected;
+  stats->health.ecc_failed = m_flash_stats.ecc_failed;
 
-    if(0 == m_sector_to_erase)
+  /* Счетчики стираний хранит flash-драйвер */
+  stats->wear.min = (SIZE32)UN_SET;
+  stats->wear.max = 0U;
+  for(FLASH_SECTOR_ID m_id = FTL_SECTOR_FIRST; m_id < FLASH_SECTORS_COUNT;
+      m_id++)
+  {
+    FLASH_SECTOR_TYPE m_sector;
+    RETURN_CODE m_select_error = NO_ERROR;
+    FLASH_SECTOR_SELECT(m_id, &m_sector, &m_select_error);
+    stats->wear.erases[m_id - FTL_SECTOR_FIRST] = m_sector.wear;
+    if(m_sector.wear < stats->wear.min)
     {
-      continue;
+      stats->wear.min = m_sector.wear;
     }
-
-    RETURN_CODE m_erase_error = NO_ERROR;
-    FLASH_SECTOR_ERASE(m_sector_id, &m_erase_error);
-    if(NO_ERROR != m_erase_error)
+    if(m_sector.wear > stats->wear.max)
     {
-      *return_code = OPERATION_FAILED;
-      return;
+      stats->wear.max = m_sector.wear;
     }
   }
+
+  *return_code = NO_ERROR;
 }
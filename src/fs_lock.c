@@ -0,0 +1,58 @@
+/* pthread_rwlockattr_setkind_np, sched_getaffinity */
+#define _GNU_SOURCE
+#include <sched.h>
+
+#include "fs_def.h"
+#include "fs_lock.h"
+
+#if FS_THREAD_SAFE
+
+void FS_LOCK_INIT(
+/* OUT */ FS_LOCK_TYPE * lock)
+{
+  pthread_mutexattr_t m_attr;
+  pthread_mutexattr_init(&m_attr);
+  pthread_mutexattr_settype(&m_attr, PTHREAD_MUTEX_RECURSIVE);
+  pthread_mutex_init(lock, &m_attr);
+  pthread_mutexattr_destroy(&m_attr);
+}
+
+void FS_RWLOCK_INIT(
+/* OUT */ FS_RWLOCK_TYPE * lock)
+{
+  pthread_rwlockattr_t m_attr;
+  pthread_rwlockattr_init(&m_attr);
+  pthread_rwlockattr_setkind_np(
+    &m_attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP
+  );
+  pthread_rwlock_init(lock, &m_attr);
+  pthread_rwlockattr_destroy(&m_attr);
+}
+
+void FS_LOCK_SCOPE_EXIT(
+/* IN  */ FS_LOCK_TYPE ** lock)
+{
+  pthread_mutex_unlock(*lock);
+}
+
+void FS_RWLOCK_SCOPE_EXIT(
+/* IN  */ FS_RWLOCK_TYPE ** lock)
+{
+  pthread_rwlock_unlock(*lock);
+}
+
+SIZE32 FS_CPU_COUNT(void)
+{
+  /* Маска привязки учитывает taskset и cpuset: онлайн-ядра вне маски
+   * потокам монтирования недоступны */
+  cpu_set_t m_set;
+  if(0 == sched_getaffinity(0, sizeof(m_set), &m_set))
+  {
+    const int M_COUNT = CPU_COUNT(&m_set);
+    return (M_COUNT > 0) ? (SIZE32)M_COUNT : 1U;
+  }
+  const long M_ONLINE = sysconf(_SC_NPROCESSORS_ONLN);
+  return (M_ONLINE > 0) ? (SIZE32)M_ONLINE : 1U;
+}
+
+#endif /* FS_THREAD_SAFE */
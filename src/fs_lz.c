@@ -0,0 +1,328 @@
+#include "fs_def.h"
+#include "fs_lz.h"
+
+/*
+ * Минимальная длина совпадения
+ */
+#define LZ_MIN_MATCH 3U
+
+/*
+ * Количество ячеек хеш-таблицы поиска совпадений (степень двойки)
+ */
+#define LZ_HASH_BITS 6U
+#define LZ_HASH_SIZE (1U << LZ_HASH_BITS)
+
+/*
+ * Позиция не записана в хеш-таблицу
+ */
+#define LZ_POSITION_NONE 0xFFFFU
+
+/*
+ * ФОРМАТ ПОСЛЕДОВАТЕЛЬНОСТИ:
+ *   token: Старшие 4 бита - количество литералов,
+ *          младшие 4 бита - длина совпадения - LZ_MIN_MATCH
+ *          (значение 15 продолжается байтами, 255 - есть следующий байт)
+ *   literals: Литералы
+ *   offset: Смещение совпадения (1 байт, у последней последовательности нет)
+ */
+
+
+
+/*
+ * ЗАПИСЬ ПРОДОЛЖЕНИЯ ДЛИНЫ:
+ *   LENGTH: Остаток длины после 15
+ *   CAPACITY: Размер буфера dest
+ *   dest: Сжатые данные
+ *   index: Позиция записи
+ *   return_code: Статус операции
+ *     NO_ERROR: Длина записана
+ *     NO_ACTION: Нет места в буфере
+ */
+static void LZ_LENGTH_WRITE(
+/* IN    */ SIZE32 LENGTH,
+/* IN    */ const SIZE32 CAPACITY,
+/* OUT   */ U8 * dest,
+/* INOUT */ SIZE32 * index,
+/* OUT   */ RETURN_CODE * return_code);
+
+/*
+ * ЗАПИСЬ ПОСЛЕДОВАТЕЛЬНОСТИ:
+ *   LITERALS: Литералы
+ *   LITERALS_COUNT: Количество литералов
+ *   OFFSET: Смещение совпадения (0 - последняя последовательность)
+ *   MATCH_LENGTH: Длина совпадения
+ *   CAPACITY: Размер буфера dest
+ *   dest: Сжатые данные
+ *   index: Позиция записи
+ *   return_code: Статус операции
+ *     NO_ERROR: Последовательность записана
+ *     NO_ACTION: Нет места в буфере
+ */
+static void LZ_SEQUENCE_WRITE(
+/* IN    */ const U8 * LITERALS,
+/* IN    */ const SIZE32 LITERALS_COUNT,
+/* IN    */ const SIZE32 OFFSET,
+/* IN    */ const SIZE32 MATCH_LENGTH,
+/* IN    */ const SIZE32 CAPACITY,
+/* OUT   */ U8 * dest,
+/* INOUT */ SIZE32 * index,
+/* OUT   */ RETURN_CODE * return_code);
+
+
+
+static void LZ_LENGTH_WRITE(
+/* IN    */ SIZE32 LENGTH,
+/* IN    */ const SIZE32 CAPACITY,
+/* OUT   */ U8 * dest,
+/* INOUT */ SIZE32 * index,
+/* OUT   */ RETURN_CODE * return_code)
+{
+  for(;;)
+  {
+    if(*index >= CAPACITY)
+    {
+      *return_code = NO_ACTION;
+      return;
+    }
+    if(LENGTH < 0xFFU)
+    {
+      dest[(*index)++] = (U8)LENGTH;
+      break;
+    }
+    dest[(*index)++] = 0xFFU;
+    LENGTH -= 0xFFU;
+  }
+
+  *return_code = NO_ERROR;
+}
+
+static void LZ_SEQUENCE_WRITE(
+/* IN    */ const U8 * LITERALS,
+/* IN    */ const SIZE32 LITERALS_COUNT,
+/* IN    */ const SIZE32 OFFSET,
+/* IN    */ const SIZE32 MATCH_LENGTH,
+/* IN    */ const SIZE32 CAPACITY,
+/* OUT   */ U8 * dest,
+/* INOUT */ SIZE32 * index,
+/* OUT   */ RETURN_CODE * return_code)
+{
+  const SIZE32 M_MATCH = (0U == OFFSET) ? 0U : MATCH_LENGTH - LZ_MIN_MATCH;
+  if(*index >= CAPACITY)
+  {
+    *return_code = NO_ACTION;
+    return;
+  }
+  dest[(*index)++] = (U8)(((LITERALS_COUNT < 15U ? LITERALS_COUNT : 15U) << 4U)
+                        | (M_MATCH < 15U ? M_MATCH : 15U));
+
+  RETURN_CODE m_length_error = NO_ERROR;
+  if(LITERALS_COUNT >= 15U)
+  {
+    LZ_LENGTH_WRITE(
+      LITERALS_COUNT - 15U, CAPACITY, dest, index, &m_length_error
+    );
+    if(NO_ERROR != m_length_error)
+    {
+      *return_code = NO_ACTION;
+      return;
+    }
+  }
+
+  if(*index + LITERALS_COUNT > CAPACITY)
+  {
+    *return_code = NO_ACTION;
+    return;
+  }
+  for(register SIZE32 i = 0U; i < LITERALS_COUNT; i++)
+  {
+    dest[(*index)++] = LITERALS[i];
+  }
+
+  /* Последняя последовательность состоит только из литералов */
+  if(0U == OFFSET)
+  {
+    *return_code = NO_ERROR;
+    return;
+  }
+
+  if(*index >= CAPACITY)
+  {
+    *return_code = NO_ACTION;
+    return;
+  }
+  dest[(*index)++] = (U8)OFFSET;
+  if(M_MATCH >= 15U)
+  {
+    LZ_LENGTH_WRITE(M_MATCH - 15U, CAPACITY, dest, index, &m_length_error);
+    if(NO_ERROR != m_length_error)
+    {
+      *return_code = NO_ACTION;
+      return;
+    }
+  }
+
+  *return_code = NO_ERROR;
+}
+
+
+
+void LZ_COMPRESS(
+/* IN  */ const VOID_PTR SRC,
+/* IN  */ const SIZE32 SIZE,
+/* IN  */ const SIZE32 CAPACITY,
+/* OUT */ VOID_PTR dest,
+/* OUT */ SIZE32 * out_size,
+/* OUT */ RETURN_CODE * return_code)
+{
+  const U8 * M_SRC = (const U8 *)SRC;
+  U8 * m_dest = (U8 *)dest;
+
+  U16 m_table[LZ_HASH_SIZE];
+  for(register SIZE32 i = 0U; i < LZ_HASH_SIZE; i++)
+  {
+    m_table[i] = LZ_POSITION_NONE;
+  }
+
+  SIZE32 m_index = 0U;
+  SIZE32 m_anchor = 0U;
+  SIZE32 m_position = 0U;
+  while(m_position + LZ_MIN_MATCH <= SIZE)
+  {
+    /* 1. Кандидат на совпадение - последняя позиция с тем же хешем */
+    const U32 M_KEY = ((U32)M_SRC[m_position] << 16U)
+                    | ((U32)M_SRC[m_position + 1U] << 8U)
+                    | (U32)M_SRC[m_position + 2U];
+    const U32 M_HASH = (U32)(M_KEY * 2654435761U) >> (32U - LZ_HASH_BITS);
+    const SIZE32 M_CANDIDATE = m_table[M_HASH];
+    m_table[M_HASH] = (U16)m_position;
+
+    if((LZ_POSITION_NONE == M_CANDIDATE)
+    || (m_position - M_CANDIDATE > LZ_WINDOW_SIZE)
+    || (M_SRC[M_CANDIDATE] != M_SRC[m_position])
+    || (M_SRC[M_CANDIDATE + 1U] != M_SRC[m_position + 1U])
+    || (M_SRC[M_CANDIDATE + 2U] != M_SRC[m_position + 2U]))
+    {
+      m_position++;
+      continue;
+    }
+
+    /* 2. Продление совпадения (может перекрывать текущую позицию) */
+    SIZE32 m_length = LZ_MIN_MATCH;
+    while((m_position + m_length < SIZE)
+    && (M_SRC[M_CANDIDATE + m_length] == M_SRC[m_position + m_length]))
+    {
+      m_length++;
+    }
+
+    RETURN_CODE m_write_error = NO_ERROR;
+    LZ_SEQUENCE_WRITE(
+      M_SRC + m_anchor, m_position - m_anchor, m_position - M_CANDIDATE,
+      m_length, CAPACITY, m_dest, &m_index, &m_write_error
+    );
+    if(NO_ERROR != m_write_error)
+    {
+      *return_code = NO_ACTION;
+      return;
+    }
+
+    m_position += m_length;
+    m_anchor = m_position;
+  }
+
+  /* 3. Оставшиеся литералы */
+  RETURN_CODE m_write_error = NO_ERROR;
+  LZ_SEQUENCE_WRITE(
+    M_SRC + m_anchor, SIZE - m_anchor, 0U, 0U, CAPACITY, m_dest, &m_index,
+    &m_write_error
+  );
+  if(NO_ERROR != m_write_error)
+  {
+    *return_code = NO_ACTION;
+    return;
+  }
+
+  *out_size = m_index;
+  *return_code = NO_ERROR;
+}
+
+void LZ_DECOMPRESS(
+/* IN  */ const VOID_PTR SRC,
+/* IN  */ const SIZE32 SIZE,
+/* IN  */ const SIZE32 CAPACITY,
+/* OUT */ VOID_PTR dest,
+/* OUT */ SIZE32 * out_size,
+/* OUT */ RETURN_CODE * return_code)
+{
+  const U8 * M_SRC = (const U8 *)SRC;
+  U8 * m_dest = (U8 *)dest;
+
+  SIZE32 m_index = 0U;
+  SIZE32 m_position = 0U;
+  while(m_index < SIZE)
+  {
+    const U8 M_TOKEN = M_SRC[m_index++];
+
+    /* 1. Литералы */
+    SIZE32 m_count = M_TOKEN >> 4U;
+    if(15U == m_count)
+    {
+      U8 m_byte;
+      do
+      {
+        if(m_index >= SIZE)
+        {
+          *return_code = OPERATION_FAILED;
+          return;
+        }
+        m_byte = M_SRC[m_index++];
+        m_count += m_byte;
+      } while(0xFFU == m_byte);
+    }
+    if((m_index + m_count > SIZE) || (m_position + m_count > CAPACITY))
+    {
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+    for(register SIZE32 i = 0U; i < m_count; i++)
+    {
+      m_dest[m_position++] = M_SRC[m_index++];
+    }
+
+    /* 2. Последняя последовательность не содержит совпадения */
+    if(m_index >= SIZE)
+    {
+      break;
+    }
+
+    /* 3. Совпадение (копирование побайтно: источник может перекрываться) */
+    const SIZE32 M_OFFSET = M_SRC[m_index++];
+    SIZE32 m_length = (M_TOKEN & 0x0FU) + LZ_MIN_MATCH;
+    if(15U + LZ_MIN_MATCH == m_length)
+    {
+      U8 m_byte;
+      do
+      {
+        if(m_index >= SIZE)
+        {
+          *return_code = OPERATION_FAILED;
+          return;
+        }
+        m_byte = M_SRC[m_index++];
+        m_length += m_byte;
+      } while(0xFFU == m_byte);
+    }
+    if((0U == M_OFFSET) || (M_OFFSET > m_position)
+    || (m_position + m_length > CAPACITY))
+    {
+      *return_code = OPERATION_FAILED;
+      return;
+    }
+    for(register SIZE32 i = 0U; i < m_length; i++, m_position++)
+    {
+      m_dest[m_position] = m_dest[m_position - M_OFFSET];
+    }
+  }
+
+  *out_size = m_position;
+  *return_code = NO_ERROR;
+}
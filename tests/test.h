@@ -0,0 +1,148 @@
+#ifndef __TEST_H__
+#define __TEST_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fs_def.h"
+#include "fs_std.h"
+#include "fs_emulator.h"
+#include "fs_ftl.h"
+#include "fs_driver.h"
+
+/*
+ * Количество непройденных проверок теста
+ */
+static SIZE32 g_test_failures = 0U;
+
+/*
+ * Файл образа flash, переданный тесту первым аргументом
+ */
+static const CHAR * g_test_image = "test.bin";
+
+/*
+ * ПРОВЕРКА УСЛОВИЯ (тест продолжается, итог - в TEST_END)
+ */
+#define TEST_CHECK(CONDITION)                                               \
+  do                                                                        \
+  {                                                                         \
+    if(!(CONDITION))                                                        \
+    {                                                                       \
+      printf("%s:%d: FAILED: %s\n", __FILE__, __LINE__, #CONDITION);        \
+      g_test_failures++;                                                    \
+    }                                                                       \
+  } while(0)
+
+/*
+ * НАЧАЛО ТЕСТА:
+ *   ARGC, ARGV: Аргументы программы (argv[1] - файл образа flash)
+ *
+ * Тест всегда начинается с пустого образа
+ */
+static inline void TEST_BEGIN(
+/* IN  */ const int ARGC,
+/* IN  */ CHAR ** ARGV)
+{
+  if(ARGC > 1)
+  {
+    g_test_image = ARGV[1];
+  }
+  remove(g_test_image);
+}
+
+/*
+ * ИТОГ ТЕСТА:
+ *   NAME: Имя теста
+ *   return: Код завершения программы
+ */
+static inline int TEST_END(
+/* IN  */ const CHAR * NAME)
+{
+  remove(g_test_image);
+  printf("%s: %s\n", NAME, (0U == g_test_failures) ? "OK" : "FAILED");
+  return (0U == g_test_failures) ? 0 : 1;
+}
+
+/*
+ * ПОДКЛЮЧЕНИЕ ОБРАЗА И ФС:
+ *   return_code: Статус FS_INIT
+ */
+static inline void TEST_MOUNT(
+/* OUT */ RETURN_CODE * return_code)
+{
+  EMULATOR_INIT(g_test_image, return_code);
+  if(NO_ERROR != *return_code)
+  {
+    return;
+  }
+  FS_INIT(return_code);
+}
+
+/*
+ * ОТКЛЮЧЕНИЕ ФС И ОБРАЗА:
+ *   return_code: Статус FS_FREE
+ */
+static inline void TEST_UNMOUNT(
+/* OUT */ RETURN_CODE * return_code)
+{
+  FS_FREE(return_code);
+  EMULATOR_FREE();
+}
+
+/*
+ * ПОДКЛЮЧЕНИЕ ОБРАЗА И FTL (без файловой системы):
+ *   return_code: Статус FTL_INIT
+ */
+static inline void TEST_FTL_MOUNT(
+/* OUT */ RETURN_CODE * return_code)
+{
+  EMULATOR_INIT(g_test_image, return_code);
+  if(NO_ERROR != *return_code)
+  {
+    return;
+  }
+  FTL_INIT(return_code);
+}
+
+/*
+ * ОТКЛЮЧЕНИЕ FTL И ОБРАЗА:
+ *   return_code: Статус FTL_FREE
+ */
+static inline void TEST_FTL_UNMOUNT(
+/* OUT */ RETURN_CODE * return_code)
+{
+  FTL_FREE(return_code);
+  EMULATOR_FREE();
+}
+
+/*
+ * ПСЕВДОСЛУЧАЙНОЕ ЧИСЛО (xorshift32, воспроизводимая последовательность):
+ *   state: Состояние генератора (не 0)
+ *   return: Следующее число
+ */
+static inline U32 TEST_RANDOM(
+/* INOUT */ U32 * state)
+{
+  U32 m_x = *state;
+  m_x ^= m_x << 13U;
+  m_x ^= m_x >> 17U;
+  m_x ^= m_x << 5U;
+  *state = m_x;
+  return m_x;
+}
+
+/*
+ * ИМЯ ФАЙЛА ПО НОМЕРУ:
+ *   INDEX: Номер файла
+ *   name: Имя "fileNN"
+ */
+static inline void TEST_NAME(
+/* IN  */ const SIZE32 INDEX,
+/* OUT */ FILE_NAME name)
+{
+  STD_MEMSET(FILE_NAME_SIZE, 0x00U, name);
+  snprintf(name, FILE_NAME_SIZE, "file%02u", INDEX);
+}
+
+#endif /* __TEST_H__ */
@@ -0,0 +1,159 @@
+/*
+ * АСИНХРОННЫЕ ЗАПРОСЫ:
+ * запись файла частями через очередь запросов (заполненная очередь
+ * освобождается забором завершений), синхронизация и шаг сборки мусора,
+ * затем чтение частями. Завершения приходят в порядке отправки,
+ * содержимое файла совпадает с записанным
+ */
+#include "test.h"
+#include "fs_async.h"
+
+#define TEST_CHUNK_SIZE 1000U
+#define TEST_CHUNKS_COUNT 40U
+
+static U8 g_data[TEST_CHUNKS_COUNT * TEST_CHUNK_SIZE];
+static U8 g_read[TEST_CHUNKS_COUNT * TEST_CHUNK_SIZE];
+
+/*
+ * Номер следующего ожидаемого завершения
+ */
+static U32 g_reaped = 0U;
+
+/*
+ * ЗАБОР ЗАВЕРШЕНИЯ С ПРОВЕРКОЙ ПОРЯДКА:
+ *   LENGTH: Ожидаемая длина (UN_SET - не проверять)
+ *   return: 1 - завершение получено, успешно и по порядку
+ */
+static U8 TEST_REAP(
+/* IN  */ const SIZE32 LENGTH)
+{
+  FS_ASYNC_COMPLETION_TYPE m_completion;
+  RETURN_CODE m_rc = NO_ERROR;
+  FS_ASYNC_REAP(1U, &m_completion, &m_rc);
+  if(NO_ERROR != m_rc)
+  {
+    return 0U;
+  }
+  const U8 M_ORDERED = ((VOID_PTR)(size_t)g_reaped == m_completion.user_data);
+  g_reaped++;
+  return M_ORDERED && (NO_ERROR == m_completion.return_code)
+      && ((UN_SET == LENGTH) || (LENGTH == m_completion.length));
+}
+
+/*
+ * ОТПРАВКА ЗАПРОСА (при заполненной очереди забирается завершение):
+ *   OP: Операция
+ *   ID: Дескриптор файла
+ *   BUFFER: Данные
+ *   SUBMITTED: Номер запроса (user_data)
+ *   return: Количество ошибочных завершений, забранных ради места
+ */
+static SIZE32 TEST_SUBMIT(
+/* IN  */ const FS_ASYNC_OP OP,
+/* IN  */ const FILE_ID ID,
+/* IN  */ const VOID_PTR BUFFER,
+/* IN  */ const U32 SUBMITTED)
+{
+  const FS_ASYNC_REQUEST_TYPE M_REQUEST =
+  {
+    .op = OP,
+    .id = ID,
+    .length = TEST_CHUNK_SIZE,
+    .buffer = BUFFER,
+    .user_data = (VOID_PTR)(size_t)SUBMITTED
+  };
+  SIZE32 m_failed = 0U;
+  RETURN_CODE m_rc = NO_ERROR;
+  FS_ASYNC_SUBMIT(&M_REQUEST, &m_rc);
+  while(NO_ACTION == m_rc)
+  {
+    m_failed += !TEST_REAP(TEST_CHUNK_SIZE);
+    FS_ASYNC_SUBMIT(&M_REQUEST, &m_rc);
+  }
+  return m_failed + (NO_ERROR != m_rc);
+}
+
+int main(int argc, char ** argv)
+{
+  TEST_BEGIN(argc, argv);
+  U32 m_seed = 0xD3A2646CU;
+  for(SIZE32 i = 0U; i < sizeof(g_data); i++)
+  {
+    g_data[i] = (U8)TEST_RANDOM(&m_seed);
+  }
+
+  RETURN_CODE m_rc = NO_ERROR;
+  FILE_ERROR m_fe = 0;
+  TEST_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  FILE_NAME m_name;
+  TEST_NAME(0U, m_name);
+  FS_FILE_CREATE(m_name, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+
+  /* 1. Запись частями, синхронизация и шаг сборки мусора */
+  FILE_ID m_id;
+  FS_FILE_OPEN(m_name, FILE_MODE_READ_WRITE, &m_id, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+  FS_ASYNC_INIT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  const FS_ASYNC_REQUEST_TYPE M_INVALID = { .op = FS_ASYNC_OP_GC_STEP + 1U };
+  FS_ASYNC_SUBMIT(&M_INVALID, &m_rc);
+  TEST_CHECK(INVALID_PARAM == m_rc);
+
+  SIZE32 m_failed = 0U;
+  U32 m_submitted = 0U;
+  for(SIZE32 c = 0U; c < TEST_CHUNKS_COUNT; c++)
+  {
+    m_failed += TEST_SUBMIT(
+      FS_ASYNC_OP_WRITE, m_id, &g_data[c * TEST_CHUNK_SIZE], m_submitted++
+    );
+  }
+  m_failed += TEST_SUBMIT(FS_ASYNC_OP_SYNC, m_id, (VOID_PTR)(0), m_submitted++);
+  m_failed += TEST_SUBMIT(
+    FS_ASYNC_OP_GC_STEP, m_id, (VOID_PTR)(0), m_submitted++
+  );
+  while(g_reaped + 2U < m_submitted)
+  {
+    m_failed += !TEST_REAP(TEST_CHUNK_SIZE);
+  }
+  m_failed += !TEST_REAP((SIZE32)UN_SET);
+  m_failed += !TEST_REAP((SIZE32)UN_SET);
+  TEST_CHECK(0U == m_failed);
+  FS_ASYNC_COMPLETION_TYPE m_completion;
+  FS_ASYNC_REAP(1U, &m_completion, &m_rc);
+  TEST_CHECK(NO_ACTION == m_rc);
+  FS_ASYNC_FREE(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  FS_FILE_CLOSE(m_id, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+
+  /* 2. Чтение частями */
+  FS_FILE_OPEN(m_name, FILE_MODE_READ_ONLY, &m_id, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+  FS_ASYNC_INIT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  g_reaped = 0U;
+  m_submitted = 0U;
+  m_failed = 0U;
+  for(SIZE32 c = 0U; c < TEST_CHUNKS_COUNT; c++)
+  {
+    m_failed += TEST_SUBMIT(
+      FS_ASYNC_OP_READ, m_id, &g_read[c * TEST_CHUNK_SIZE], m_submitted++
+    );
+  }
+  while(g_reaped < m_submitted)
+  {
+    m_failed += !TEST_REAP(TEST_CHUNK_SIZE);
+  }
+  TEST_CHECK(0U == m_failed);
+  TEST_CHECK(0 == memcmp(g_read, g_data, sizeof(g_data)));
+  FS_ASYNC_FREE(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  FS_FILE_CLOSE(m_id, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+
+  TEST_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  return TEST_END("test_async");
+}
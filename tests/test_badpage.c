@@ -0,0 +1,191 @@
+/*
+ * ИЗНОШЕННЫЕ СТРАНИЦЫ И ОШИБКИ ХРАНЕНИЯ:
+ * запись в страницу с залипшими битами не проходит проверку, страница
+ * изымается, блок пишется в следующую. Страница, которая не стирается,
+ * изымается при стирании сектора. Изъятые страницы не возвращаются
+ * после переподключения. Инверсия бита хранимых данных обнаруживается
+ * CRC32 блока, а с ECC (EMULATOR_NAND) исправляется при чтении
+ */
+#include "test.h"
+#include "fs_flash.h"
+
+#define TEST_DATA_SIZE 250U
+#define TEST_SECTOR_BLOCKS 60U
+
+/*
+ * Смещение проверяемого байта данных внутри страницы блока
+ */
+#define TEST_DATA_OFFSET 32U
+
+/*
+ * Копия памяти эмулятора (поиск страниц, измененных записью)
+ */
+static U8 g_snapshot[FLASH_SIZE];
+
+/*
+ * ДАННЫЕ ЛОГИЧЕСКОГО БЛОКА (несжимаемые):
+ *   LBI: Номер логического блока
+ *   ROUND: Номер перезаписи
+ *   data: Данные
+ */
+static void TEST_BLOCK(
+/* IN  */ const FTL_INDEX LBI,
+/* IN  */ const U32 ROUND,
+/* OUT */ U8 * data)
+{
+  U32 m_seed = LBI * 2654435761U + ROUND * 40503U + 1U;
+  for(SIZE32 i = 0U; i < TEST_DATA_SIZE; i++)
+  {
+    data[i] = (U8)TEST_RANDOM(&m_seed);
+  }
+}
+
+/*
+ * ЗАПИСЬ БЛОКА С ПОИСКОМ ЕГО СТРАНИЦЫ:
+ *   LBI: Номер логического блока
+ *   ROUND: Номер перезаписи
+ *   return: Смещение первой страницы, измененной записью (страница данных
+ *           или страница неудачной попытки; таблица порядковых номеров -
+ *           в конце сектора), UN_SET - ошибка
+ */
+static SIZE32 TEST_WRITE(
+/* IN  */ const FTL_INDEX LBI,
+/* IN  */ const U32 ROUND)
+{
+  U8 m_data[TEST_DATA_SIZE] __attribute__((aligned(4)));
+  TEST_BLOCK(LBI, ROUND, m_data);
+  STD_MEMCPY(FLASH_SIZE, g_emulator->mem, g_snapshot);
+  RETURN_CODE m_rc = NO_ERROR;
+  FTL_WRITE(LBI, 1U, m_data, &m_rc);
+  if(NO_ERROR != m_rc)
+  {
+    return (SIZE32)UN_SET;
+  }
+  for(SIZE32 i = 0U; i < FLASH_SIZE; i++)
+  {
+    if(g_snapshot[i] != g_emulator->mem[i])
+    {
+      return i - i % FLASH_PAGE_SIZE;
+    }
+  }
+  return (SIZE32)UN_SET;
+}
+
+/*
+ * ПРОВЕРКА БЛОКА:
+ *   LBI: Номер логического блока
+ *   ROUND: Номер перезаписи
+ *   return: 1 - блок прочитан и совпал
+ */
+static U8 TEST_READ(
+/* IN  */ const FTL_INDEX LBI,
+/* IN  */ const U32 ROUND)
+{
+  U8 m_data[TEST_DATA_SIZE] __attribute__((aligned(4)));
+  U8 m_model[TEST_DATA_SIZE];
+  TEST_BLOCK(LBI, ROUND, m_model);
+  RETURN_CODE m_rc = NO_ERROR;
+  FTL_READ(LBI, 1U, m_data, &m_rc);
+  return (NO_ERROR == m_rc) && (0 == memcmp(m_data, m_model, TEST_DATA_SIZE));
+}
+
+int main(int argc, char ** argv)
+{
+  TEST_BEGIN(argc, argv);
+  RETURN_CODE m_rc = NO_ERROR;
+  TEST_FTL_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+
+  /* 1. Залипшие в 1 биты следующей страницы фронта записи: запись
+   * не проходит проверку, блок пишется в другую страницу */
+  const SIZE32 M_FIRST = TEST_WRITE(0U, 0U);
+  TEST_CHECK((SIZE32)UN_SET != M_FIRST);
+  const SIZE32 M_WORN = M_FIRST + FLASH_PAGE_SIZE;
+  for(U8 b = 0U; b < 8U; b++)
+  {
+    EMULATOR_FAULT(M_WORN + TEST_DATA_OFFSET, b, 1U, &m_rc);
+    TEST_CHECK(NO_ERROR == m_rc);
+  }
+  FTL_STATS_TYPE m_stats;
+  FTL_STATS(&m_stats, &m_rc);
+  const FTL_HEALTH_STATS_TYPE M_HEALTH = m_stats.health;
+  TEST_CHECK(M_WORN == TEST_WRITE(1U, 0U));
+  FTL_STATS(&m_stats, &m_rc);
+  TEST_CHECK(M_HEALTH.bad_blocks + 1U == m_stats.health.bad_blocks);
+  TEST_CHECK(M_HEALTH.retired + 1U == m_stats.health.retired);
+  TEST_CHECK(M_HEALTH.retries + 1U == m_stats.health.retries);
+  TEST_CHECK(TEST_READ(0U, 0U));
+  TEST_CHECK(TEST_READ(1U, 0U));
+
+  /* 2. Залипший в 0 бит свободной страницы: сектор переписан целиком,
+   * при стирании страница не стирается и изымается */
+  const SIZE32 M_STUCK = M_FIRST + (TEST_SECTOR_BLOCKS - 1U) * FLASH_PAGE_SIZE;
+  EMULATOR_FAULT(M_STUCK + TEST_DATA_OFFSET, 3U, 0U, &m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  for(U32 r = 0U; r < 2U; r++)
+  {
+    for(FTL_INDEX m_lbi = 0U; m_lbi < TEST_SECTOR_BLOCKS; m_lbi++)
+    {
+      TEST_CHECK((SIZE32)UN_SET != TEST_WRITE(m_lbi, 1U + r));
+    }
+  }
+  FTL_GARBAGE_COLLECT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  FTL_STATS(&m_stats, &m_rc);
+  TEST_CHECK(M_HEALTH.bad_blocks + 2U <= m_stats.health.bad_blocks);
+  SIZE32 m_failures = 0U;
+  for(FTL_INDEX m_lbi = 0U; m_lbi < TEST_SECTOR_BLOCKS; m_lbi++)
+  {
+    m_failures += !TEST_READ(m_lbi, 2U);
+  }
+  TEST_CHECK(0U == m_failures);
+
+  /* 3. Изъятые страницы не возвращаются после переподключения
+   * (неисправности эмулятора хранятся только в ОЗУ) */
+  const SIZE32 M_BAD = m_stats.health.bad_blocks;
+  TEST_FTL_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_FTL_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  FTL_STATS(&m_stats, &m_rc);
+  TEST_CHECK(M_BAD == m_stats.health.bad_blocks);
+
+  /* 4. Инверсия бита хранимых данных: CRC32 блока не совпадает,
+   * с ECC ошибка исправляется */
+  const SIZE32 M_PAGE = TEST_WRITE(TEST_SECTOR_BLOCKS, 0U);
+  TEST_CHECK((SIZE32)UN_SET != M_PAGE);
+  EMULATOR_BITFLIP(M_PAGE + TEST_DATA_OFFSET, 5U, &m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  FTL_STATS(&m_stats, &m_rc);
+  const FTL_HEALTH_STATS_TYPE M_BEFORE_FLIP = m_stats.health;
+#if EMULATOR_NAND
+  TEST_CHECK(TEST_READ(TEST_SECTOR_BLOCKS, 0U));
+  FTL_STATS(&m_stats, &m_rc);
+  TEST_CHECK(M_BEFORE_FLIP.ecc_corrected < m_stats.health.ecc_corrected);
+
+  /* Две инверсии в одном слове не исправляются */
+  EMULATOR_BITFLIP(M_PAGE + TEST_DATA_OFFSET, 6U, &m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_CHECK(!TEST_READ(TEST_SECTOR_BLOCKS, 0U));
+  FTL_STATS(&m_stats, &m_rc);
+  TEST_CHECK(M_BEFORE_FLIP.ecc_failed < m_stats.health.ecc_failed);
+#else
+  TEST_CHECK(!TEST_READ(TEST_SECTOR_BLOCKS, 0U));
+  FTL_STATS(&m_stats, &m_rc);
+  TEST_CHECK(M_BEFORE_FLIP.ecc_corrected == m_stats.health.ecc_corrected);
+#endif
+
+  /* 5. Перезапись восстанавливает блок, остальные блоки не задеты */
+  TEST_CHECK((SIZE32)UN_SET != TEST_WRITE(TEST_SECTOR_BLOCKS, 1U));
+  TEST_CHECK(TEST_READ(TEST_SECTOR_BLOCKS, 1U));
+  m_failures = 0U;
+  for(FTL_INDEX m_lbi = 0U; m_lbi < TEST_SECTOR_BLOCKS; m_lbi++)
+  {
+    m_failures += !TEST_READ(m_lbi, 2U);
+  }
+  TEST_CHECK(0U == m_failures);
+  TEST_FTL_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+
+  return TEST_END("test_badpage");
+}
@@ -0,0 +1,349 @@
+/*
+ * КОПИРОВАНИЕ ФАЙЛА ПРИ ЗАПИСИ:
+ * копия и копия копии разделяют блоки с исходным файлом. Запись,
+ * дописывание и усечение любого из файлов не меняют остальные; удаление
+ * исходного файла не затрагивает копии, содержимое сохраняется после
+ * переподключения. Многократные копирование, изменение и удаление не
+ * теряют блоки: место освобождается, пока счетчики ссылок верны. Сбой
+ * записи во время копирования или удаления отменяет транзакцию: файлы
+ * в ОЗУ совпадают с томом после переподключения
+ */
+#include "test.h"
+
+#define TEST_FILES_COUNT 3U
+#define TEST_FILE_SIZE 6000U
+#define TEST_FILE_LIMIT 9000U
+#define TEST_OPERATIONS 600U
+#define TEST_CHUNK_SIZE 700U
+#define TEST_CYCLES 400U
+#define TEST_FAULTS 16U
+
+static U8 g_model[TEST_FILES_COUNT][TEST_FILE_LIMIT];
+static SIZE32 g_sizes[TEST_FILES_COUNT];
+static U8 g_buffer[TEST_FILE_LIMIT];
+
+/*
+ * ЗАПИСЬ ФРАГМЕНТА ФАЙЛА (из модели):
+ *   INDEX: Номер файла
+ *   OFFSET: Смещение (не больше размера файла)
+ *   LENGTH: Длина
+ *   return: 1 - записано
+ */
+static U8 TEST_WRITE(
+/* IN  */ const SIZE32 INDEX,
+/* IN  */ const SIZE32 OFFSET,
+/* IN  */ const SIZE32 LENGTH)
+{
+  FILE_NAME m_name;
+  TEST_NAME(INDEX, m_name);
+  RETURN_CODE m_rc = NO_ERROR;
+  FILE_ERROR m_fe = 0;
+  FILE_ID m_id;
+  FS_FILE_OPEN(m_name, FILE_MODE_READ_WRITE, &m_id, &m_rc, &m_fe);
+  if(NO_ERROR != m_rc)
+  {
+    return 0U;
+  }
+  FILE_POSITION m_position;
+  FS_FILE_SEEK(
+    m_id, (FILE_POSITION)OFFSET, FILE_SEEK_SET, &m_position, &m_rc, &m_fe
+  );
+  RETURN_CODE m_write_rc = m_rc;
+  if(NO_ERROR == m_rc)
+  {
+    FS_FILE_WRITE(m_id, LENGTH, &g_model[INDEX][OFFSET], &m_write_rc, &m_fe);
+  }
+  FS_FILE_CLOSE(m_id, &m_rc, &m_fe);
+  return (NO_ERROR == m_write_rc) && (NO_ERROR == m_rc);
+}
+
+/*
+ * УСЕЧЕНИЕ ФАЙЛА:
+ *   INDEX: Номер файла
+ *   SIZE: Новый размер
+ *   return: 1 - файл усечен
+ */
+static U8 TEST_TRUNCATE(
+/* IN  */ const SIZE32 INDEX,
+/* IN  */ const SIZE32 SIZE)
+{
+  FILE_NAME m_name;
+  TEST_NAME(INDEX, m_name);
+  RETURN_CODE m_rc = NO_ERROR;
+  FILE_ERROR m_fe = 0;
+  FILE_ID m_id;
+  FS_FILE_OPEN(m_name, FILE_MODE_READ_WRITE, &m_id, &m_rc, &m_fe);
+  if(NO_ERROR != m_rc)
+  {
+    return 0U;
+  }
+  RETURN_CODE m_truncate_rc = NO_ERROR;
+  FS_FILE_TRUNCATE(m_id, SIZE, &m_truncate_rc, &m_fe);
+  FS_FILE_CLOSE(m_id, &m_rc, &m_fe);
+  return (NO_ERROR == m_truncate_rc) && (NO_ERROR == m_rc);
+}
+
+/*
+ * СВЕРКА ФАЙЛА С МОДЕЛЬЮ:
+ *   INDEX: Номер файла
+ *   return: 1 - размер и данные совпадают
+ */
+static U8 TEST_VERIFY(
+/* IN  */ const SIZE32 INDEX)
+{
+  FILE_NAME m_name;
+  TEST_NAME(INDEX, m_name);
+  RETURN_CODE m_rc = NO_ERROR;
+  FILE_ERROR m_fe = 0;
+  FILE_ID m_id;
+  FS_FILE_OPEN(m_name, FILE_MODE_READ_ONLY, &m_id, &m_rc, &m_fe);
+  if(NO_ERROR != m_rc)
+  {
+    return 0U;
+  }
+  SIZE32 m_length = 0U;
+  FS_FILE_READ(m_id, TEST_FILE_LIMIT, &m_length, g_buffer, &m_rc, &m_fe);
+  FS_FILE_CLOSE(m_id, &m_rc, &m_fe);
+  return (g_sizes[INDEX] == m_length)
+      && (0 == memcmp(g_buffer, g_model[INDEX], m_length));
+}
+
+/*
+ * КОПИРОВАНИЕ ФАЙЛА В МОДЕЛИ И ФС:
+ *   SOURCE: Номер исходного файла
+ *   TARGET: Номер копии
+ *   return: 1 - копия создана
+ */
+static U8 TEST_CLONE(
+/* IN  */ const SIZE32 SOURCE,
+/* IN  */ const SIZE32 TARGET)
+{
+  FILE_NAME m_source;
+  FILE_NAME m_target;
+  TEST_NAME(SOURCE, m_source);
+  TEST_NAME(TARGET, m_target);
+  RETURN_CODE m_rc = NO_ERROR;
+  FILE_ERROR m_fe = 0;
+  FS_FILE_CLONE(m_source, m_target, &m_rc, &m_fe);
+  STD_MEMCPY(TEST_FILE_LIMIT, g_model[SOURCE], g_model[TARGET]);
+  g_sizes[TARGET] = g_sizes[SOURCE];
+  return NO_ERROR == m_rc;
+}
+
+/*
+ * СОСТОЯНИЕ КОПИИ ПОСЛЕ СБОЯ (файл 0 - копия файла 1):
+ *   return: 0 - файла нет, 1 - файл совпадает с файлом 1, 2 - файл
+ *           поврежден
+ */
+static U8 TEST_STATE(void)
+{
+  FILE_NAME m_name;
+  TEST_NAME(0U, m_name);
+  RETURN_CODE m_rc = NO_ERROR;
+  FILE_ERROR m_fe = 0;
+  FILE_ID m_id;
+  FS_FILE_OPEN(m_name, FILE_MODE_READ_ONLY, &m_id, &m_rc, &m_fe);
+  if(NO_ERROR != m_rc)
+  {
+    return 0U;
+  }
+  FS_FILE_CLOSE(m_id, &m_rc, &m_fe);
+  STD_MEMCPY(TEST_FILE_LIMIT, g_model[1U], g_model[0U]);
+  g_sizes[0U] = g_sizes[1U];
+  return TEST_VERIFY(0U) ? 1U : 2U;
+}
+
+/*
+ * СВОБОДНОЕ МЕСТО ТОМА (файл 4 записывается до отказа и удаляется):
+ *   return: Количество записанных байтов
+ */
+static SIZE32 TEST_CAPACITY(void)
+{
+  FILE_NAME m_name;
+  TEST_NAME(4U, m_name);
+  RETURN_CODE m_rc = NO_ERROR;
+  FILE_ERROR m_fe = 0;
+  FS_FILE_CREATE(m_name, &m_rc, &m_fe);
+  FILE_ID m_id;
+  FS_FILE_OPEN(m_name, FILE_MODE_READ_WRITE, &m_id, &m_rc, &m_fe);
+  STD_MEMSET(TEST_FILE_LIMIT, 0x00U, g_buffer);
+  SIZE32 m_size = 0U;
+  while(NO_ERROR == m_rc)
+  {
+    FS_FILE_WRITE(m_id, TEST_FILE_LIMIT, g_buffer, &m_rc, &m_fe);
+    if(NO_ERROR == m_rc)
+    {
+      m_size += TEST_FILE_LIMIT;
+    }
+  }
+  FS_FILE_CLOSE(m_id, &m_rc, &m_fe);
+  FS_FILE_REMOVE(m_name, &m_rc, &m_fe);
+  return m_size;
+}
+
+int main(int argc, char ** argv)
+{
+  TEST_BEGIN(argc, argv);
+  U32 m_seed = 0xC2B2AE35U;
+
+  RETURN_CODE m_rc = NO_ERROR;
+  FILE_ERROR m_fe = 0;
+  TEST_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+
+  /* 1. Исходный файл, копия и копия копии */
+  FILE_NAME m_name;
+  TEST_NAME(0U, m_name);
+  FS_FILE_CREATE(m_name, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+  for(SIZE32 i = 0U; i < TEST_FILE_SIZE; i++)
+  {
+    g_model[0U][i] = (U8)TEST_RANDOM(&m_seed);
+  }
+  g_sizes[0U] = TEST_FILE_SIZE;
+  TEST_CHECK(TEST_WRITE(0U, 0U, TEST_FILE_SIZE));
+  TEST_CHECK(TEST_CLONE(0U, 1U));
+  TEST_CHECK(TEST_CLONE(1U, 2U));
+  for(SIZE32 f = 0U; f < TEST_FILES_COUNT; f++)
+  {
+    TEST_CHECK(TEST_VERIFY(f));
+  }
+
+  /* 2. Запись, дописывание и усечение файлов по отдельности */
+  SIZE32 m_failed = 0U;
+  for(SIZE32 n = 0U; n < TEST_OPERATIONS; n++)
+  {
+    const SIZE32 M_FILE = TEST_RANDOM(&m_seed) % TEST_FILES_COUNT;
+    if(0U == TEST_RANDOM(&m_seed) % 8U)
+    {
+      const SIZE32 M_SIZE = TEST_RANDOM(&m_seed) % (g_sizes[M_FILE] + 1U);
+      g_sizes[M_FILE] = M_SIZE;
+      m_failed += !TEST_TRUNCATE(M_FILE, M_SIZE);
+      continue;
+    }
+    const SIZE32 M_OFFSET = TEST_RANDOM(&m_seed) % (g_sizes[M_FILE] + 1U);
+    SIZE32 m_length = 1U + TEST_RANDOM(&m_seed) % TEST_CHUNK_SIZE;
+    if(M_OFFSET + m_length > TEST_FILE_LIMIT)
+    {
+      m_length = TEST_FILE_LIMIT - M_OFFSET;
+    }
+    if(0U == m_length)
+    {
+      continue;
+    }
+    for(SIZE32 i = 0U; i < m_length; i++)
+    {
+      g_model[M_FILE][M_OFFSET + i] = (U8)TEST_RANDOM(&m_seed);
+    }
+    if(M_OFFSET + m_length > g_sizes[M_FILE])
+    {
+      g_sizes[M_FILE] = M_OFFSET + m_length;
+    }
+    m_failed += !TEST_WRITE(M_FILE, M_OFFSET, m_length);
+  }
+  TEST_CHECK(0U == m_failed);
+  for(SIZE32 f = 0U; f < TEST_FILES_COUNT; f++)
+  {
+    TEST_CHECK(TEST_VERIFY(f));
+  }
+
+  /* 3. Удаление исходного файла не затрагивает копии */
+  FS_FILE_REMOVE(m_name, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_CHECK(TEST_VERIFY(1U));
+  TEST_CHECK(TEST_VERIFY(2U));
+  TEST_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_CHECK(TEST_VERIFY(1U));
+  TEST_CHECK(TEST_VERIFY(2U));
+
+  /* 4. Копирование, изменение и удаление по кругу: блоки не теряются
+   * (дописанные за TEST_CYCLES кругов блоки превышают область данных ФС) */
+  if(g_sizes[1U] > TEST_FILE_SIZE / 2U)
+  {
+    g_sizes[1U] = TEST_FILE_SIZE / 2U;
+    TEST_CHECK(TEST_TRUNCATE(1U, g_sizes[1U]));
+  }
+  const SIZE32 M_APPEND = TEST_FILE_LIMIT - TEST_FILE_SIZE / 2U;
+  for(SIZE32 c = 0U; c < TEST_CYCLES; c++)
+  {
+    TEST_CHECK(TEST_CLONE(1U, 0U));
+    if(0U != g_sizes[0U])
+    {
+      const SIZE32 M_OFFSET = TEST_RANDOM(&m_seed) % g_sizes[0U];
+      g_model[0U][M_OFFSET] ^= 0xA5U;
+      TEST_CHECK(TEST_WRITE(0U, M_OFFSET, 1U));
+    }
+    const SIZE32 M_END = g_sizes[0U];
+    for(SIZE32 i = 0U; i < M_APPEND; i++)
+    {
+      g_model[0U][M_END + i] = (U8)TEST_RANDOM(&m_seed);
+    }
+    g_sizes[0U] = M_END + M_APPEND;
+    TEST_CHECK(TEST_WRITE(0U, M_END, M_APPEND));
+    TEST_CHECK(TEST_VERIFY(0U));
+    TEST_NAME(0U, m_name);
+    FS_FILE_REMOVE(m_name, &m_rc, &m_fe);
+    TEST_CHECK(NO_ERROR == m_rc);
+  }
+  TEST_CHECK(TEST_VERIFY(1U));
+  TEST_CHECK(TEST_VERIFY(2U));
+
+  /* 5. Сбой записи на каждой операции flash копирования и удаления:
+   * следующая фиксация (создание файла 3) не дописывает отмененные
+   * записи, том после переподключения совпадает с ОЗУ, блоки
+   * не теряются */
+  const SIZE32 M_CAPACITY = TEST_CAPACITY();
+  for(SIZE32 m_remove = 0U; m_remove < 2U; m_remove++)
+  {
+    for(SIZE32 k = 1U; k <= TEST_FAULTS; k++)
+    {
+      TEST_NAME(0U, m_name);
+      if(m_remove)
+      {
+        TEST_CHECK(TEST_CLONE(1U, 0U));
+      }
+      EMULATOR_POWER_CUT(k);
+      if(m_remove)
+      {
+        FS_FILE_REMOVE(m_name, &m_rc, &m_fe);
+      }
+      else
+      {
+        FILE_NAME m_source;
+        TEST_NAME(1U, m_source);
+        FS_FILE_CLONE(m_source, m_name, &m_rc, &m_fe);
+      }
+      EMULATOR_POWER_CUT(0U);
+
+      const U8 M_STATE = TEST_STATE();
+      TEST_CHECK(2U != M_STATE);
+      FILE_NAME m_other;
+      TEST_NAME(3U, m_other);
+      FS_FILE_CREATE(m_other, &m_rc, &m_fe);
+      TEST_CHECK(NO_ERROR == m_rc);
+      TEST_UNMOUNT(&m_rc);
+      TEST_CHECK(NO_ERROR == m_rc);
+      TEST_MOUNT(&m_rc);
+      TEST_CHECK(NO_ERROR == m_rc);
+      TEST_CHECK(M_STATE == TEST_STATE());
+
+      FS_FILE_REMOVE(m_other, &m_rc, &m_fe);
+      TEST_CHECK(NO_ERROR == m_rc);
+      if(0U != M_STATE)
+      {
+        FS_FILE_REMOVE(m_name, &m_rc, &m_fe);
+        TEST_CHECK(NO_ERROR == m_rc);
+      }
+    }
+  }
+  TEST_CHECK(TEST_VERIFY(1U));
+  TEST_CHECK(TEST_VERIFY(2U));
+  TEST_CHECK(M_CAPACITY == TEST_CAPACITY());
+
+  TEST_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  return TEST_END("test_clone");
+}
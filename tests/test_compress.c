@@ -0,0 +1,168 @@
+/*
+ * СЖАТИЕ БЛОКОВ:
+ * LZ_COMPRESS/LZ_DECOMPRESS восстанавливают данные без потерь, несжимаемые
+ * данные не помещаются в буфер меньше исходных. Через FTL сжимаемые блоки
+ * пишутся в ячейки общих блоков, несжимаемые - без сжатия; все блоки
+ * читаются до и после переподключения. Тест печатает степень сжатия
+ * и время сжатия и распаковки одного блока
+ */
+#include <time.h>
+
+#include "test.h"
+#include "fs_lz.h"
+
+#define TEST_DATA_SIZE 250U
+#define TEST_BLOCKS_COUNT 192U
+#define TEST_TIMING_ROUNDS 2000U
+
+/*
+ * ДАННЫЕ ЛОГИЧЕСКОГО БЛОКА:
+ *   LBI: Номер логического блока
+ *   data: Данные (каждый третий блок несжимаемый, остальные - строки
+ *         журнала с разными значениями; у всех блоков данные разные)
+ *   return: 1 - блок сжимаемый
+ */
+static U8 TEST_BLOCK(
+/* IN  */ const FTL_INDEX LBI,
+/* OUT */ U8 * data)
+{
+  U32 m_seed = LBI * 2654435761U + 1U;
+  if(0U == LBI % 3U)
+  {
+    for(SIZE32 i = 0U; i < TEST_DATA_SIZE; i++)
+    {
+      data[i] = (U8)TEST_RANDOM(&m_seed);
+    }
+    return 0U;
+  }
+  CHAR m_text[TEST_DATA_SIZE + 32U];
+  SIZE32 m_length = (SIZE32)snprintf(m_text, sizeof(m_text),
+    "block %u\n", LBI);
+  while(m_length < TEST_DATA_SIZE)
+  {
+    m_length += (SIZE32)snprintf(m_text + m_length, sizeof(m_text) - m_length,
+      "sensor=%u temp=%u status:ok\n", TEST_RANDOM(&m_seed) % 2U,
+      20U + TEST_RANDOM(&m_seed) % 2U);
+  }
+  STD_MEMCPY(TEST_DATA_SIZE, m_text, data);
+  return 1U;
+}
+
+/*
+ * СВЕРКА БЛОКОВ FTL:
+ *   return: Количество несовпадений
+ */
+static SIZE32 TEST_VERIFY(void)
+{
+  SIZE32 m_mismatches = 0U;
+  for(FTL_INDEX m_lbi = 0U; m_lbi < TEST_BLOCKS_COUNT; m_lbi++)
+  {
+    U8 m_data[TEST_DATA_SIZE] __attribute__((aligned(4)));
+    U8 m_model[TEST_DATA_SIZE];
+    TEST_BLOCK(m_lbi, m_model);
+    RETURN_CODE m_rc = NO_ERROR;
+    FTL_READ(m_lbi, 1U, m_data, &m_rc);
+    m_mismatches += (NO_ERROR != m_rc)
+      || (0 != memcmp(m_data, m_model, TEST_DATA_SIZE));
+  }
+  return m_mismatches;
+}
+
+int main(int argc, char ** argv)
+{
+  TEST_BEGIN(argc, argv);
+  RETURN_CODE m_rc = NO_ERROR;
+
+  /* 1. Сжатие и распаковка без потерь: блок текста, 64 байта, 1 байт */
+  U8 m_plain[TEST_DATA_SIZE];
+  U8 m_packed[TEST_DATA_SIZE];
+  U8 m_unpacked[TEST_DATA_SIZE];
+  SIZE32 m_packed_size = 0U;
+  SIZE32 m_unpacked_size = 0U;
+  const SIZE32 M_SIZES[3] = { TEST_DATA_SIZE, 64U, 1U };
+  for(SIZE32 s = 0U; s < 3U; s++)
+  {
+    TEST_BLOCK(1U + s, m_plain);
+    LZ_COMPRESS(m_plain, M_SIZES[s], TEST_DATA_SIZE, m_packed,
+      &m_packed_size, &m_rc);
+    TEST_CHECK(NO_ERROR == m_rc);
+    LZ_DECOMPRESS(m_packed, m_packed_size, TEST_DATA_SIZE, m_unpacked,
+      &m_unpacked_size, &m_rc);
+    TEST_CHECK(NO_ERROR == m_rc);
+    TEST_CHECK(M_SIZES[s] == m_unpacked_size);
+    TEST_CHECK(0 == memcmp(m_plain, m_unpacked, M_SIZES[s]));
+  }
+  TEST_BLOCK(1U, m_plain);
+  LZ_COMPRESS(m_plain, TEST_DATA_SIZE, TEST_DATA_SIZE, m_packed,
+    &m_packed_size, &m_rc);
+  TEST_CHECK(m_packed_size < TEST_DATA_SIZE / 3U);
+
+  /* 2. Несжимаемые данные не помещаются в буфер меньше исходных,
+   * распаковка в короткий буфер - ошибка */
+  TEST_BLOCK(0U, m_plain);
+  LZ_COMPRESS(m_plain, TEST_DATA_SIZE, TEST_DATA_SIZE - 1U, m_packed,
+    &m_packed_size, &m_rc);
+  TEST_CHECK(NO_ACTION == m_rc);
+  TEST_BLOCK(1U, m_plain);
+  LZ_COMPRESS(m_plain, TEST_DATA_SIZE, TEST_DATA_SIZE, m_packed,
+    &m_packed_size, &m_rc);
+  LZ_DECOMPRESS(m_packed, m_packed_size, TEST_DATA_SIZE / 2U, m_unpacked,
+    &m_unpacked_size, &m_rc);
+  TEST_CHECK(OPERATION_FAILED == m_rc);
+
+  /* 3. Время сжатия и распаковки одного блока текста */
+  const clock_t M_COMPRESS_START = clock();
+  for(SIZE32 r = 0U; r < TEST_TIMING_ROUNDS; r++)
+  {
+    LZ_COMPRESS(m_plain, TEST_DATA_SIZE, TEST_DATA_SIZE, m_packed,
+      &m_packed_size, &m_rc);
+  }
+  const clock_t M_DECOMPRESS_START = clock();
+  for(SIZE32 r = 0U; r < TEST_TIMING_ROUNDS; r++)
+  {
+    LZ_DECOMPRESS(m_packed, m_packed_size, TEST_DATA_SIZE, m_unpacked,
+      &m_unpacked_size, &m_rc);
+  }
+  const clock_t M_END = clock();
+
+  /* 4. Запись через FTL: сжимаемые блоки - в ячейки, несжимаемые -
+   * без сжатия */
+  TEST_FTL_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  SIZE32 m_compressible = 0U;
+  for(FTL_INDEX m_lbi = 0U; m_lbi < TEST_BLOCKS_COUNT; m_lbi++)
+  {
+    U8 m_data[TEST_DATA_SIZE] __attribute__((aligned(4)));
+    m_compressible += TEST_BLOCK(m_lbi, m_data);
+    FTL_WRITE(m_lbi, 1U, m_data, &m_rc);
+    TEST_CHECK(NO_ERROR == m_rc);
+  }
+  FTL_STATS_TYPE m_stats;
+  FTL_STATS(&m_stats, &m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_CHECK(m_compressible == m_stats.compress.packed_blocks);
+  TEST_CHECK(TEST_BLOCKS_COUNT - m_compressible
+    == m_stats.compress.raw_blocks);
+  TEST_CHECK(0U == m_stats.compress.dedup_blocks);
+  TEST_CHECK(2U * m_stats.compress.bytes_out < m_stats.compress.bytes_in);
+  TEST_CHECK(0U == TEST_VERIFY());
+
+  /* 5. Блоки читаются после переподключения */
+  TEST_FTL_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_FTL_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_CHECK(0U == TEST_VERIFY());
+  TEST_FTL_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+
+  printf("test_compress: packed %u/%u bytes (%.1f%%), compress %.2f us/block, "
+    "decompress %.2f us/block\n",
+    m_stats.compress.bytes_out, m_stats.compress.bytes_in,
+    100.0 * m_stats.compress.bytes_out / m_stats.compress.bytes_in,
+    1e6 * (double)(M_DECOMPRESS_START - M_COMPRESS_START)
+      / CLOCKS_PER_SEC / TEST_TIMING_ROUNDS,
+    1e6 * (double)(M_END - M_DECOMPRESS_START)
+      / CLOCKS_PER_SEC / TEST_TIMING_ROUNDS);
+  return TEST_END("test_compress");
+}
@@ -0,0 +1,169 @@
+/*
+ * ШИФРОВАНИЕ БЛОКОВ:
+ * CRYPT_XTS совпадает с AES-128-XTS (IEEE 1619) на контрольных векторах,
+ * в том же проходе дает CRC32 открытых данных, а перезапись сектора
+ * другими данными не раскрывает XOR открытых данных. Через FTL
+ * проверяется, что перезаписанные, сжатые и повторяющиеся (записанные
+ * ссылкой) блоки читаются после переподключения
+ */
+#include "test.h"
+#include "fs_crypt.h"
+
+#define TEST_DATA_SIZE 250U
+#define TEST_BLOCKS_COUNT 64U
+#define TEST_ROUNDS 4U
+
+/*
+ * Номер сектора контрольных векторов
+ */
+#define TEST_TWEAK 0x11223344U
+#define TEST_DOMAIN 0x55667788U
+
+/*
+ * КОНТРОЛЬНЫЕ ВЕКТОРЫ (ключ по умолчанию, открытые данные i * 7 + 3;
+ * получены AES-128-ECB openssl по алгоритму IEEE 1619):
+ *   g_test_xts_32: Два полных блока
+ *   g_test_xts_20: Блок и 4 байта (перенос шифротекста)
+ */
+static const U8 g_test_xts_32[32] = {
+  0xBA, 0xAD, 0x1C, 0x53, 0x65, 0x8D, 0x8A, 0x57,
+  0x0F, 0xFE, 0x54, 0x80, 0x54, 0xE3, 0xC5, 0x7F,
+  0xE9, 0x00, 0xE0, 0xD0, 0xC6, 0x2D, 0x27, 0xA1,
+  0x76, 0x68, 0x39, 0x8B, 0x56, 0x01, 0xF0, 0x9A
+};
+static const U8 g_test_xts_20[20] = {
+  0x12, 0x26, 0x43, 0x9E, 0x79, 0x61, 0x30, 0x00,
+  0x1C, 0x3A, 0x98, 0x48, 0x8E, 0x2F, 0x7F, 0xD7,
+  0xBA, 0xAD, 0x1C, 0x53
+};
+
+/*
+ * ДАННЫЕ ЛОГИЧЕСКОГО БЛОКА:
+ *   LBI: Номер логического блока
+ *   ROUND: Номер перезаписи
+ *   data: Данные (четные блоки не сжимаются; нечетные сжимаются,
+ *         и у нечетных блоков одного раунда данные одинаковые)
+ */
+static void TEST_BLOCK(
+/* IN  */ const FTL_INDEX LBI,
+/* IN  */ const U32 ROUND,
+/* OUT */ U8 * data)
+{
+  U32 m_seed = LBI * 7919U + ROUND + 1U;
+  for(SIZE32 i = 0U; i < TEST_DATA_SIZE; i++)
+  {
+    data[i] = (0U == LBI % 2U)
+      ? (U8)TEST_RANDOM(&m_seed) : (U8)(ROUND + i / 50U);
+  }
+}
+
+/*
+ * ПРОВЕРКА ПО КОНТРОЛЬНОМУ ВЕКТОРУ:
+ *   EXPECTED: Шифротекст
+ *   SIZE: Размер данных
+ */
+static void TEST_VECTOR(
+/* IN  */ const U8 * EXPECTED,
+/* IN  */ const SIZE32 SIZE)
+{
+  U8 m_data[32];
+  for(SIZE32 i = 0U; i < SIZE; i++)
+  {
+    m_data[i] = (U8)(i * 7U + 3U);
+  }
+  U32 m_crc = 0U;
+  U32 m_expected = 0U;
+  HASH_CRC(m_data, SIZE, &m_expected);
+  CRYPT_XTS(m_data, SIZE, TEST_TWEAK, TEST_DOMAIN, CRYPT_ENCRYPT, &m_crc);
+  TEST_CHECK(0 == memcmp(m_data, EXPECTED, SIZE));
+  TEST_CHECK(m_expected == m_crc);
+}
+
+int main(int argc, char ** argv)
+{
+  TEST_BEGIN(argc, argv);
+
+  /* 1. Контрольные векторы: полные блоки и перенос шифротекста */
+  TEST_VECTOR(g_test_xts_32, sizeof(g_test_xts_32));
+  TEST_VECTOR(g_test_xts_20, sizeof(g_test_xts_20));
+
+  /* 2. Блок FTL (перенос шифротекста) и один блок AES: CRC32 открытых
+   * данных в обоих направлениях, расшифровка восстанавливает данные */
+  const SIZE32 M_SIZES[2] = { TEST_DATA_SIZE, CRYPT_BLOCK_SIZE };
+  for(SIZE32 s = 0U; s < 2U; s++)
+  {
+    U8 m_plain[TEST_DATA_SIZE];
+    U8 m_data[TEST_DATA_SIZE];
+    TEST_BLOCK(0U, s, m_plain);
+    STD_MEMCPY(M_SIZES[s], m_plain, m_data);
+    U32 m_expected = 0U;
+    U32 m_crc = 0U;
+    HASH_CRC(m_plain, M_SIZES[s], &m_expected);
+    CRYPT_XTS(m_data, M_SIZES[s], 5U, 0U, CRYPT_ENCRYPT, &m_crc);
+    TEST_CHECK(m_expected == m_crc);
+    TEST_CHECK(0 != memcmp(m_data, m_plain, M_SIZES[s]));
+    m_crc = 0U;
+    CRYPT_XTS(m_data, M_SIZES[s], 5U, 0U, CRYPT_DECRYPT, &m_crc);
+    TEST_CHECK(m_expected == m_crc);
+    TEST_CHECK(0 == memcmp(m_data, m_plain, M_SIZES[s]));
+  }
+
+  /* 3. Перезапись сектора другими данными: XOR шифротекстов не равен
+   * XOR открытых данных (повтор потока ключей CTR дал бы равенство) */
+  U8 m_first_plain[TEST_DATA_SIZE];
+  U8 m_second_plain[TEST_DATA_SIZE];
+  U8 m_first[TEST_DATA_SIZE];
+  U8 m_second[TEST_DATA_SIZE];
+  TEST_BLOCK(2U, 0U, m_first_plain);
+  TEST_BLOCK(2U, 1U, m_second_plain);
+  STD_MEMCPY(TEST_DATA_SIZE, m_first_plain, m_first);
+  STD_MEMCPY(TEST_DATA_SIZE, m_second_plain, m_second);
+  U32 m_crc = 0U;
+  CRYPT_XTS(m_first, TEST_DATA_SIZE, 5U, 0U, CRYPT_ENCRYPT, &m_crc);
+  CRYPT_XTS(m_second, TEST_DATA_SIZE, 5U, 0U, CRYPT_ENCRYPT, &m_crc);
+  SIZE32 m_leaked = 0U;
+  for(SIZE32 i = 0U; i < TEST_DATA_SIZE; i++)
+  {
+    if((m_first[i] ^ m_second[i]) == (m_first_plain[i] ^ m_second_plain[i]))
+    {
+      m_leaked++;
+    }
+  }
+  TEST_CHECK(m_leaked < TEST_DATA_SIZE / 16U);
+
+  /* 4. Перезапись блоков FTL с переподключением */
+  RETURN_CODE m_rc = NO_ERROR;
+  FTL_STATS_TYPE m_stats;
+  TEST_FTL_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  for(U32 r = 0U; r < TEST_ROUNDS; r++)
+  {
+    for(FTL_INDEX m_lbi = 0U; m_lbi < TEST_BLOCKS_COUNT; m_lbi++)
+    {
+      U8 m_data[TEST_DATA_SIZE] __attribute__((aligned(4)));
+      TEST_BLOCK(m_lbi, r, m_data);
+      FTL_WRITE(m_lbi, 1U, m_data, &m_rc);
+      TEST_CHECK(NO_ERROR == m_rc);
+    }
+  }
+  FTL_STATS(&m_stats, &m_rc);
+  TEST_CHECK(m_stats.compress.dedup_blocks > 0U);
+  TEST_FTL_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+
+  TEST_FTL_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  for(FTL_INDEX m_lbi = 0U; m_lbi < TEST_BLOCKS_COUNT; m_lbi++)
+  {
+    U8 m_data[TEST_DATA_SIZE] __attribute__((aligned(4)));
+    U8 m_model[TEST_DATA_SIZE];
+    TEST_BLOCK(m_lbi, TEST_ROUNDS - 1U, m_model);
+    FTL_READ(m_lbi, 1U, m_data, &m_rc);
+    TEST_CHECK(NO_ERROR == m_rc);
+    TEST_CHECK(0 == memcmp(m_data, m_model, TEST_DATA_SIZE));
+  }
+  TEST_FTL_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+
+  return TEST_END("test_crypt");
+}
@@ -0,0 +1,135 @@
+/*
+ * ОДИНАКОВЫЕ СЖАТЫЕ БЛОКИ:
+ * повтор данных, уже записанных в сжатый блок, записывается ссылкой
+ * (занимает только ячейку, физические блоки не расходуются). Перезапись
+ * и освобождение одного из блоков с общими данными не меняют остальные;
+ * данные читаются после сборки мусора и переподключения
+ */
+#include "test.h"
+
+#define TEST_DATA_SIZE 250U
+#define TEST_BLOCKS_COUNT 45U
+#define TEST_PACK_SLOTS 15U
+
+/*
+ * ДАННЫЕ ЛОГИЧЕСКОГО БЛОКА:
+ *   VERSION: Вариант данных (0 - общие для всех блоков)
+ *   data: Сжимаемые данные
+ */
+static void TEST_BLOCK(
+/* IN  */ const U32 VERSION,
+/* OUT */ U8 * data)
+{
+  for(SIZE32 i = 0U; i < TEST_DATA_SIZE; i++)
+  {
+    data[i] = (U8)(VERSION * 31U + i / 25U);
+  }
+}
+
+/*
+ * СВЕРКА БЛОКОВ:
+ *   VERSIONS: Вариант данных каждого блока (UN_SET - блок освобожден)
+ *   return: Количество несовпадений
+ */
+static SIZE32 TEST_VERIFY(
+/* IN  */ const U32 * VERSIONS)
+{
+  SIZE32 m_mismatches = 0U;
+  for(FTL_INDEX m_lbi = 0U; m_lbi < TEST_BLOCKS_COUNT; m_lbi++)
+  {
+    U8 m_data[TEST_DATA_SIZE] __attribute__((aligned(4)));
+    U8 m_model[TEST_DATA_SIZE];
+    RETURN_CODE m_rc = NO_ERROR;
+    FTL_READ(m_lbi, 1U, m_data, &m_rc);
+    if((U32)UN_SET == VERSIONS[m_lbi])
+    {
+      m_mismatches += (NO_ACTION != m_rc);
+      continue;
+    }
+    TEST_BLOCK(VERSIONS[m_lbi], m_model);
+    m_mismatches += (NO_ERROR != m_rc)
+      || (0 != memcmp(m_data, m_model, TEST_DATA_SIZE));
+  }
+  return m_mismatches;
+}
+
+int main(int argc, char ** argv)
+{
+  TEST_BEGIN(argc, argv);
+  RETURN_CODE m_rc = NO_ERROR;
+  U32 m_versions[TEST_BLOCKS_COUNT] = { 0U };
+  TEST_FTL_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+
+  /* 1. Одинаковые блоки: данные программируются один раз на физический
+   * блок, остальные ячейки блока - ссылки */
+  FTL_STATS_TYPE m_before;
+  FTL_STATS(&m_before, &m_rc);
+  U8 m_data[TEST_DATA_SIZE] __attribute__((aligned(4)));
+  TEST_BLOCK(0U, m_data);
+  for(FTL_INDEX m_lbi = 0U; m_lbi < TEST_BLOCKS_COUNT; m_lbi++)
+  {
+    FTL_WRITE(m_lbi, 1U, m_data, &m_rc);
+    TEST_CHECK(NO_ERROR == m_rc);
+  }
+  FTL_STATS_TYPE m_after;
+  FTL_STATS(&m_after, &m_rc);
+  const SIZE32 M_PROGRAMMED = TEST_BLOCKS_COUNT / TEST_PACK_SLOTS;
+  TEST_CHECK(TEST_BLOCKS_COUNT == m_after.compress.packed_blocks);
+  TEST_CHECK(TEST_BLOCKS_COUNT - M_PROGRAMMED
+    == m_after.compress.dedup_blocks);
+  TEST_CHECK(m_before.gc.free_blocks - m_after.gc.free_blocks
+    <= M_PROGRAMMED);
+  TEST_CHECK(0U == TEST_VERIFY(m_versions));
+
+  /* 2. Перезапись и освобождение части блоков не задевают остальные */
+  for(FTL_INDEX m_lbi = 0U; m_lbi < TEST_BLOCKS_COUNT; m_lbi += 3U)
+  {
+    m_versions[m_lbi] = 1U + m_lbi;
+    TEST_BLOCK(m_versions[m_lbi], m_data);
+    FTL_WRITE(m_lbi, 1U, m_data, &m_rc);
+    TEST_CHECK(NO_ERROR == m_rc);
+  }
+  for(FTL_INDEX m_lbi = 1U; m_lbi < TEST_BLOCKS_COUNT; m_lbi += 3U)
+  {
+    m_versions[m_lbi] = (U32)UN_SET;
+    FTL_DISCARD(m_lbi, 1U, &m_rc);
+    TEST_CHECK(NO_ERROR == m_rc);
+  }
+  TEST_CHECK(0U == TEST_VERIFY(m_versions));
+
+  /* 3. Сборка мусора переносит общие данные вместе со ссылками */
+  FTL_GARBAGE_COLLECT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_CHECK(0U == TEST_VERIFY(m_versions));
+
+  /* 4. Ссылки сохраняются после переподключения (освобожденные
+   * блоки стираются при выключении) */
+  TEST_FTL_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_FTL_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_CHECK(0U == TEST_VERIFY(m_versions));
+
+  /* 5. Новый повтор после переподключения - снова ссылка */
+  FTL_STATS(&m_before, &m_rc);
+  TEST_BLOCK(0U, m_data);
+  FTL_WRITE(1U, 1U, m_data, &m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  m_versions[1U] = 0U;
+  FTL_WRITE(4U, 1U, m_data, &m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  m_versions[4U] = 0U;
+  FTL_STATS(&m_after, &m_rc);
+  TEST_CHECK(m_after.compress.dedup_blocks > m_before.compress.dedup_blocks);
+  TEST_CHECK(0U == TEST_VERIFY(m_versions));
+  TEST_FTL_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_FTL_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_CHECK(0U == TEST_VERIFY(m_versions));
+  TEST_FTL_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+
+  return TEST_END("test_dedup");
+}
@@ -0,0 +1,256 @@
+/*
+ * ТАБЛИЦА ДЕСКРИПТОРОВ:
+ * таблица заполняется до отказа (FILE_ERROR_DESCRIPTOR), дескрипторы
+ * различны. Закрытый дескриптор отклоняется, даже когда его ячейку
+ * занял новый. Потоки одновременно открывают и закрывают общий файл
+ * на чтение и соревнуются за файл на запись: запись открыта не более
+ * чем у одного, после потоков все ячейки снова свободны (без
+ * FS_THREAD_SAFE потоки выполняются по очереди)
+ */
+#include <pthread.h>
+
+#include "test.h"
+#include "fs_lock.h"
+
+#define TEST_THREADS 6U
+#define TEST_ROUNDS 300U
+#define TEST_HELD 3U
+#define TEST_MAX_DESCRIPTORS 256U
+#define TEST_DATA_SIZE 64U
+
+static FILE_ID g_ids[TEST_MAX_DESCRIPTORS];
+static U8 g_data[TEST_DATA_SIZE];
+
+/*
+ * Владелец файла на запись (0 - свободен) и количество ошибок потоков
+ */
+static U32 g_writer = 0U;
+static SIZE32 g_failed[TEST_THREADS];
+
+/*
+ * ЗАПОЛНЕНИЕ ТАБЛИЦЫ (файл открывается на чтение до отказа):
+ *   NAME: Имя файла
+ *   return: Количество открытых дескрипторов (0 - другая ошибка, открытые
+ *           дескрипторы остаются в g_ids)
+ */
+static SIZE32 TEST_FILL(
+/* IN  */ const FILE_NAME NAME)
+{
+  SIZE32 m_count = 0U;
+  RETURN_CODE m_rc = NO_ERROR;
+  FILE_ERROR m_fe = 0;
+  while(m_count < TEST_MAX_DESCRIPTORS)
+  {
+    FS_FILE_OPEN(NAME, FILE_MODE_READ_ONLY, &g_ids[m_count], &m_rc, &m_fe);
+    if(NO_ERROR != m_rc)
+    {
+      break;
+    }
+    m_count++;
+  }
+  return ((DEVICE_BUSY == m_rc) && (FILE_ERROR_DESCRIPTOR == m_fe))
+    ? m_count : 0U;
+}
+
+/*
+ * ЗАКРЫТИЕ ДЕСКРИПТОРОВ:
+ *   COUNT: Количество дескрипторов в g_ids
+ *   return: Количество ошибок
+ */
+static SIZE32 TEST_CLOSE_ALL(
+/* IN  */ const SIZE32 COUNT)
+{
+  SIZE32 m_failed = 0U;
+  for(SIZE32 i = 0U; i < COUNT; i++)
+  {
+    RETURN_CODE m_rc = NO_ERROR;
+    FILE_ERROR m_fe = 0;
+    FS_FILE_CLOSE(g_ids[i], &m_rc, &m_fe);
+    m_failed += (NO_ERROR != m_rc);
+  }
+  return m_failed;
+}
+
+/*
+ * ДЕСКРИПТОР ОТКЛОНЯЕТСЯ:
+ *   ID: Дескриптор
+ *   return: 1 - статус и закрытие отклонены как неправильный дескриптор
+ */
+static U8 TEST_REJECTED(
+/* IN  */ const FILE_ID ID)
+{
+  FILE_STATUS_TYPE m_status;
+  RETURN_CODE m_rc = NO_ERROR;
+  FILE_ERROR m_fe = 0;
+  FS_FILE_STATUS(ID, &m_status, &m_rc, &m_fe);
+  const U8 M_STATUS = (INVALID_PARAM == m_rc);
+  FS_FILE_CLOSE(ID, &m_rc, &m_fe);
+  return M_STATUS && (INVALID_PARAM == m_rc)
+    && (FILE_ERROR_DESCRIPTOR == m_fe);
+}
+
+/*
+ * ПОТОК ОТКРЫТИЙ И ЗАКРЫТИЙ:
+ *   index: Номер потока
+ */
+static VOID_PTR TEST_WORKER(
+/* IN  */ VOID_PTR index)
+{
+  const SIZE32 M_INDEX = (SIZE32)(size_t)index;
+  FILE_NAME m_shared;
+  FILE_NAME m_exclusive;
+  TEST_NAME(0U, m_shared);
+  TEST_NAME(1U, m_exclusive);
+  for(U32 r = 0U; r < TEST_ROUNDS; r++)
+  {
+    /* Несколько дескрипторов общего файла одновременно: все различны
+     * и читают файл со своей позиции */
+    FILE_ID m_held[TEST_HELD];
+    RETURN_CODE m_rc = NO_ERROR;
+    FILE_ERROR m_fe = 0;
+    for(SIZE32 h = 0U; h < TEST_HELD; h++)
+    {
+      FS_FILE_OPEN(m_shared, FILE_MODE_READ_ONLY, &m_held[h], &m_rc, &m_fe);
+      g_failed[M_INDEX] += (NO_ERROR != m_rc);
+      for(SIZE32 p = 0U; p < h; p++)
+      {
+        g_failed[M_INDEX] += (m_held[p] == m_held[h]);
+      }
+    }
+    for(SIZE32 h = 0U; h < TEST_HELD; h++)
+    {
+      U8 m_read[TEST_DATA_SIZE];
+      SIZE32 m_length = 0U;
+      FS_FILE_READ(m_held[h], TEST_DATA_SIZE, &m_length, m_read, &m_rc,
+        &m_fe);
+      g_failed[M_INDEX] += (NO_ERROR != m_rc) || (TEST_DATA_SIZE != m_length)
+        || (0 != memcmp(m_read, g_data, TEST_DATA_SIZE));
+      FS_FILE_CLOSE(m_held[h], &m_rc, &m_fe);
+      g_failed[M_INDEX] += (NO_ERROR != m_rc);
+    }
+
+    /* Файл на запись открыт не более чем у одного потока */
+    FILE_ID m_id;
+    FS_FILE_OPEN(m_exclusive, FILE_MODE_READ_WRITE, &m_id, &m_rc, &m_fe);
+    if(NO_ERROR == m_rc)
+    {
+      g_failed[M_INDEX] += !FS_ATOMIC_CAS(g_writer, 0U, M_INDEX + 1U);
+      U8 m_byte = (U8)M_INDEX;
+      FS_FILE_WRITE(m_id, 1U, &m_byte, &m_rc, &m_fe);
+      g_failed[M_INDEX] += (NO_ERROR != m_rc);
+      FS_ATOMIC_STORE(g_writer, 0U);
+      FS_FILE_CLOSE(m_id, &m_rc, &m_fe);
+      g_failed[M_INDEX] += (NO_ERROR != m_rc);
+    }
+    else
+    {
+      g_failed[M_INDEX] += (DEVICE_BUSY != m_rc) || (FILE_ERROR_BUSY != m_fe);
+    }
+  }
+  return (VOID_PTR)(0);
+}
+
+int main(int argc, char ** argv)
+{
+  TEST_BEGIN(argc, argv);
+  RETURN_CODE m_rc = NO_ERROR;
+  FILE_ERROR m_fe = 0;
+  TEST_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  U32 m_seed = 0xCC9E2D51U;
+  for(SIZE32 i = 0U; i < TEST_DATA_SIZE; i++)
+  {
+    g_data[i] = (U8)TEST_RANDOM(&m_seed);
+  }
+  FILE_NAME m_shared;
+  FILE_NAME m_exclusive;
+  TEST_NAME(0U, m_shared);
+  TEST_NAME(1U, m_exclusive);
+  FS_FILE_CREATE(m_shared, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+  FS_FILE_CREATE(m_exclusive, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+  FILE_ID m_id;
+  FS_FILE_OPEN(m_shared, FILE_MODE_READ_WRITE, &m_id, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+  FS_FILE_WRITE(m_id, TEST_DATA_SIZE, g_data, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+  FS_FILE_CLOSE(m_id, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+
+  /* 1. Таблица заполняется до отказа, дескрипторы различны */
+  const SIZE32 M_COUNT = TEST_FILL(m_shared);
+  TEST_CHECK(TEST_THREADS * (TEST_HELD + 1U) <= M_COUNT);
+  SIZE32 m_duplicates = 0U;
+  for(SIZE32 i = 0U; i < M_COUNT; i++)
+  {
+    for(SIZE32 j = 0U; j < i; j++)
+    {
+      m_duplicates += (g_ids[i] == g_ids[j]);
+    }
+  }
+  TEST_CHECK(0U == m_duplicates);
+
+  /* 2. Единственная свободная ячейка занимается заново: закрытый
+   * дескриптор отклоняется, новый работает */
+  const SIZE32 M_LAST = M_COUNT - 1U;
+  for(SIZE32 r = 0U; (0U < M_COUNT) && (r < 10U); r++)
+  {
+    const FILE_ID M_OLD = g_ids[M_LAST];
+    FS_FILE_CLOSE(M_OLD, &m_rc, &m_fe);
+    TEST_CHECK(NO_ERROR == m_rc);
+    FS_FILE_OPEN(m_shared, FILE_MODE_READ_ONLY, &g_ids[M_LAST], &m_rc,
+      &m_fe);
+    TEST_CHECK(NO_ERROR == m_rc);
+    TEST_CHECK(M_OLD != g_ids[M_LAST]);
+    TEST_CHECK(TEST_REJECTED(M_OLD));
+    FILE_STATUS_TYPE m_status;
+    FS_FILE_STATUS(g_ids[M_LAST], &m_status, &m_rc, &m_fe);
+    TEST_CHECK(NO_ERROR == m_rc);
+    TEST_CHECK(TEST_DATA_SIZE == m_status.size);
+  }
+  TEST_CHECK(0U == TEST_CLOSE_ALL(M_COUNT));
+
+  /* 3. Несуществующий и повторно закрытый дескрипторы отклоняются */
+  TEST_CHECK(TEST_REJECTED((FILE_ID)UN_SET));
+  TEST_CHECK(TEST_REJECTED(g_ids[0U]));
+
+  /* 4. Потоки открывают и закрывают дескрипторы одновременно */
+#if FS_THREAD_SAFE
+  pthread_t m_threads[TEST_THREADS];
+  for(SIZE32 t = 0U; t < TEST_THREADS; t++)
+  {
+    TEST_CHECK(0 == pthread_create(
+      &m_threads[t], (VOID_PTR)(0), TEST_WORKER, (VOID_PTR)(size_t)t));
+  }
+  for(SIZE32 t = 0U; t < TEST_THREADS; t++)
+  {
+    pthread_join(m_threads[t], (VOID_PTR *)(0));
+  }
+#else
+  for(SIZE32 t = 0U; t < TEST_THREADS; t++)
+  {
+    TEST_WORKER((VOID_PTR)(size_t)t);
+  }
+#endif
+  for(SIZE32 t = 0U; t < TEST_THREADS; t++)
+  {
+    TEST_CHECK(0U == g_failed[t]);
+  }
+  TEST_CHECK(0U == g_writer);
+
+  /* 5. Все ячейки снова свободны, файл на запись не занят */
+  TEST_CHECK(M_COUNT == TEST_FILL(m_shared));
+  TEST_CHECK(0U == TEST_CLOSE_ALL(M_COUNT));
+  FS_FILE_OPEN(m_exclusive, FILE_MODE_READ_WRITE, &m_id, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+  FILE_STATUS_TYPE m_status;
+  FS_FILE_STATUS(m_id, &m_status, &m_rc, &m_fe);
+  TEST_CHECK(0U < m_status.size);
+  FS_FILE_CLOSE(m_id, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+
+  TEST_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  return TEST_END("test_descriptor");
+}
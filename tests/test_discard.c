@@ -0,0 +1,202 @@
+/*
+ * ОСВОБОЖДЕНИЕ ЛОГИЧЕСКИХ БЛОКОВ:
+ * FTL_DISCARD снимает отображение: блок не читается, сборщик мусора
+ * его не переносит, и место возвращается после сборки. Отметка хранится
+ * в ОЗУ: после сбоя питания блоки снова читаются, после FTL_FREE -
+ * нет. Усечение и удаление файла освобождают его блоки в FTL
+ */
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "test.h"
+
+#define TEST_DATA_SIZE 250U
+#define TEST_BLOCKS_COUNT 600U
+#define TEST_DISCARDED_COUNT 300U
+#define TEST_FS_DATA_SIZE 248U
+#define TEST_FILE_BLOCKS 20U
+
+/*
+ * ДАННЫЕ ЛОГИЧЕСКОГО БЛОКА (несжимаемые):
+ *   LBI: Номер логического блока
+ *   data: Данные
+ */
+static void TEST_BLOCK(
+/* IN  */ const FTL_INDEX LBI,
+/* OUT */ U8 * data)
+{
+  U32 m_seed = LBI * 2654435761U + 1U;
+  for(SIZE32 i = 0U; i < TEST_DATA_SIZE; i++)
+  {
+    data[i] = (U8)TEST_RANDOM(&m_seed);
+  }
+}
+
+/*
+ * СВЕРКА ДИАПАЗОНА БЛОКОВ:
+ *   LBI: Первый блок
+ *   COUNT: Количество блоков
+ *   MAPPED: 1 - блоки читаются, 0 - блоков не существует
+ *   return: Количество несовпадений
+ */
+static SIZE32 TEST_VERIFY(
+/* IN  */ const FTL_INDEX LBI,
+/* IN  */ const SIZE32 COUNT,
+/* IN  */ const U8 MAPPED)
+{
+  SIZE32 m_mismatches = 0U;
+  for(FTL_INDEX m_lbi = LBI; m_lbi < LBI + COUNT; m_lbi++)
+  {
+    U8 m_data[TEST_DATA_SIZE] __attribute__((aligned(4)));
+    U8 m_model[TEST_DATA_SIZE];
+    TEST_BLOCK(m_lbi, m_model);
+    RETURN_CODE m_rc = NO_ERROR;
+    FTL_READ(m_lbi, 1U, m_data, &m_rc);
+    m_mismatches += MAPPED
+      ? ((NO_ERROR != m_rc) || (0 != memcmp(m_data, m_model, TEST_DATA_SIZE)))
+      : (NO_ACTION != m_rc);
+  }
+  return m_mismatches;
+}
+
+/*
+ * ОСВОБОЖДЕНИЕ В ДОЧЕРНЕМ ПРОЦЕССЕ (FTL_FREE не вызывается):
+ *   LBI: Первый блок
+ *   COUNT: Количество блоков
+ */
+static void TEST_DISCARD_CHILD(
+/* IN  */ const FTL_INDEX LBI,
+/* IN  */ const SIZE32 COUNT)
+{
+  const pid_t M_PID = fork();
+  if(0 == M_PID)
+  {
+    RETURN_CODE m_rc = NO_ERROR;
+    TEST_FTL_MOUNT(&m_rc);
+    FTL_DISCARD(LBI, COUNT, &m_rc);
+    _exit(0);
+  }
+  int m_status = 0;
+  waitpid(M_PID, &m_status, 0);
+}
+
+int main(int argc, char ** argv)
+{
+  TEST_BEGIN(argc, argv);
+  RETURN_CODE m_rc = NO_ERROR;
+  FILE_ERROR m_fe = 0;
+  TEST_FTL_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  for(FTL_INDEX m_lbi = 0U; m_lbi < TEST_BLOCKS_COUNT; m_lbi++)
+  {
+    U8 m_data[TEST_DATA_SIZE] __attribute__((aligned(4)));
+    TEST_BLOCK(m_lbi, m_data);
+    FTL_WRITE(m_lbi, 1U, m_data, &m_rc);
+    TEST_CHECK(NO_ERROR == m_rc);
+  }
+
+  /* 1. Освобожденные блоки не читаются, повторное освобождение
+   * не учитывается */
+  FTL_DISCARD(3967U, 2U, &m_rc);
+  TEST_CHECK(INVALID_PARAM == m_rc);
+  FTL_STATS_TYPE m_before;
+  FTL_STATS(&m_before, &m_rc);
+  FTL_DISCARD(0U, TEST_DISCARDED_COUNT, &m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  FTL_DISCARD(0U, TEST_DISCARDED_COUNT, &m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  FTL_STATS_TYPE m_after;
+  FTL_STATS(&m_after, &m_rc);
+  TEST_CHECK(TEST_DISCARDED_COUNT
+    == m_after.gc.discards - m_before.gc.discards);
+  TEST_CHECK(0U == TEST_VERIFY(0U, TEST_DISCARDED_COUNT, 0U));
+  TEST_CHECK(0U == TEST_VERIFY(TEST_DISCARDED_COUNT,
+    TEST_BLOCKS_COUNT - TEST_DISCARDED_COUNT, 1U));
+
+  /* 2. Сборщик мусора не переносит освобожденные блоки и возвращает
+   * их место */
+  FTL_STATS(&m_before, &m_rc);
+  FTL_GARBAGE_COLLECT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  FTL_STATS(&m_after, &m_rc);
+  TEST_CHECK(m_after.gc.relocations - m_before.gc.relocations
+    <= TEST_BLOCKS_COUNT - TEST_DISCARDED_COUNT);
+  TEST_CHECK(m_after.gc.free_blocks > m_before.gc.free_blocks);
+  TEST_CHECK(0U == TEST_VERIFY(TEST_DISCARDED_COUNT,
+    TEST_BLOCKS_COUNT - TEST_DISCARDED_COUNT, 1U));
+  TEST_FTL_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+
+  /* 3. После сбоя питания освобожденные блоки снова читаются */
+  TEST_DISCARD_CHILD(TEST_DISCARDED_COUNT, 100U);
+  TEST_FTL_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_CHECK(0U == TEST_VERIFY(0U, TEST_DISCARDED_COUNT, 0U));
+  TEST_CHECK(0U == TEST_VERIFY(TEST_DISCARDED_COUNT,
+    TEST_BLOCKS_COUNT - TEST_DISCARDED_COUNT, 1U));
+
+  /* 4. После FTL_FREE освобождение сохраняется */
+  FTL_DISCARD(TEST_DISCARDED_COUNT, 100U, &m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_FTL_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_FTL_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_CHECK(0U == TEST_VERIFY(0U, TEST_DISCARDED_COUNT + 100U, 0U));
+  TEST_CHECK(0U == TEST_VERIFY(TEST_DISCARDED_COUNT + 100U,
+    TEST_BLOCKS_COUNT - TEST_DISCARDED_COUNT - 100U, 1U));
+  TEST_FTL_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+
+  /* 5. Усечение и удаление файла освобождают его блоки */
+  remove(g_test_image);
+  TEST_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  static U8 s_file[TEST_FILE_BLOCKS * TEST_FS_DATA_SIZE];
+  U32 m_seed = 0x9E3779B9U;
+  for(SIZE32 i = 0U; i < sizeof(s_file); i++)
+  {
+    s_file[i] = (U8)TEST_RANDOM(&m_seed);
+  }
+  FILE_NAME m_name;
+  TEST_NAME(0U, m_name);
+  FS_FILE_CREATE(m_name, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+  FILE_ID m_id;
+  FS_FILE_OPEN(m_name, FILE_MODE_READ_WRITE, &m_id, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+  FS_FILE_WRITE(m_id, sizeof(s_file), s_file, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+  FS_FILE_SYNC(m_id, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+  FTL_STATS(&m_before, &m_rc);
+  FS_FILE_TRUNCATE(m_id, TEST_FS_DATA_SIZE, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+  FS_FILE_CLOSE(m_id, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+  FTL_STATS(&m_after, &m_rc);
+  TEST_CHECK(m_after.gc.discards - m_before.gc.discards
+    >= TEST_FILE_BLOCKS - 1U);
+
+  FS_FILE_OPEN(m_name, FILE_MODE_READ_ONLY, &m_id, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+  U8 m_read[2U * TEST_FS_DATA_SIZE];
+  SIZE32 m_length = 0U;
+  FS_FILE_READ(m_id, sizeof(m_read), &m_length, m_read, &m_rc, &m_fe);
+  TEST_CHECK(TEST_FS_DATA_SIZE == m_length);
+  TEST_CHECK(0 == memcmp(m_read, s_file, TEST_FS_DATA_SIZE));
+  FS_FILE_CLOSE(m_id, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+
+  FTL_STATS(&m_before, &m_rc);
+  FS_FILE_REMOVE(m_name, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+  FTL_STATS(&m_after, &m_rc);
+  TEST_CHECK(m_after.gc.discards > m_before.gc.discards);
+  FS_FILE_OPEN(m_name, FILE_MODE_READ_ONLY, &m_id, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR != m_rc);
+
+  TEST_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  return TEST_END("test_discard");
+}
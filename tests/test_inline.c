@@ -0,0 +1,198 @@
+/*
+ * МАЛЕНЬКИЕ ФАЙЛЫ В ОБЩИХ БЛОКАХ:
+ * файлы до 62 байт хранятся по четыре в одном блоке FTL (байт занятости
+ * ячеек, затем ячейки по 62 байта). Файл, выросший больше ячейки, уходит
+ * в свою цепочку, не задевая соседей; освободившуюся ячейку занимает
+ * новый маленький файл, пустой общий блок освобождается в FTL.
+ * Содержимое сохраняется после переподключения
+ */
+#include "test.h"
+
+#define TEST_BLOCK_SIZE 250U
+#define TEST_INLINE_SIZE 62U
+#define TEST_SLOTS_COUNT 4U
+#define TEST_FILES_COUNT 9U
+#define TEST_GROWN_SIZE 300U
+
+static U8 g_data[TEST_FILES_COUNT][TEST_GROWN_SIZE];
+static SIZE32 g_sizes[TEST_FILES_COUNT];
+static U8 g_present[TEST_FILES_COUNT];
+
+/*
+ * ЗАПИСЬ ФАЙЛА (файл создается при необходимости, дописывается до SIZE):
+ *   INDEX: Номер файла
+ *   SIZE: Новый размер файла
+ *   return: 1 - успешно
+ */
+static U8 TEST_WRITE(
+/* IN  */ const SIZE32 INDEX,
+/* IN  */ const SIZE32 SIZE)
+{
+  FILE_NAME m_name;
+  TEST_NAME(INDEX, m_name);
+  RETURN_CODE m_rc = NO_ERROR;
+  FILE_ERROR m_fe = 0;
+  if(!g_present[INDEX])
+  {
+    FS_FILE_CREATE(m_name, &m_rc, &m_fe);
+    if(NO_ERROR != m_rc)
+    {
+      return 0U;
+    }
+    g_present[INDEX] = 1U;
+  }
+  FILE_ID m_id;
+  FS_FILE_OPEN(m_name, FILE_MODE_READ_WRITE, &m_id, &m_rc, &m_fe);
+  if(NO_ERROR != m_rc)
+  {
+    return 0U;
+  }
+  FILE_POSITION m_position;
+  FS_FILE_SEEK(m_id, 0, FILE_SEEK_END, &m_position, &m_rc, &m_fe);
+  RETURN_CODE m_write_rc = NO_ERROR;
+  FS_FILE_WRITE(m_id, SIZE - g_sizes[INDEX], &g_data[INDEX][g_sizes[INDEX]],
+    &m_write_rc, &m_fe);
+  FS_FILE_CLOSE(m_id, &m_rc, &m_fe);
+  g_sizes[INDEX] = SIZE;
+  return (NO_ERROR == m_write_rc) && (NO_ERROR == m_rc);
+}
+
+/*
+ * СВЕРКА ФАЙЛОВ:
+ *   return: Количество несовпадений
+ */
+static SIZE32 TEST_VERIFY(void)
+{
+  SIZE32 m_mismatches = 0U;
+  for(SIZE32 f = 0U; f < TEST_FILES_COUNT; f++)
+  {
+    FILE_NAME m_name;
+    TEST_NAME(f, m_name);
+    RETURN_CODE m_rc = NO_ERROR;
+    FILE_ERROR m_fe = 0;
+    FILE_ID m_id;
+    FS_FILE_OPEN(m_name, FILE_MODE_READ_ONLY, &m_id, &m_rc, &m_fe);
+    if(!g_present[f])
+    {
+      m_mismatches += (NO_ERROR == m_rc);
+      continue;
+    }
+    U8 m_read[TEST_GROWN_SIZE + 1U];
+    SIZE32 m_length = 0U;
+    FS_FILE_READ(m_id, sizeof(m_read), &m_length, m_read, &m_rc, &m_fe);
+    m_mismatches += (g_sizes[f] != m_length)
+      || (0 != memcmp(m_read, g_data[f], g_sizes[f]));
+    FS_FILE_CLOSE(m_id, &m_rc, &m_fe);
+  }
+  return m_mismatches;
+}
+
+/*
+ * ПОИСК ОБЩЕГО БЛОКА ФАЙЛА В FTL:
+ *   INDEX: Номер файла (маленький)
+ *   occupied: Байт занятости ячеек блока
+ *   return: Логический блок (UN_SET - не найден)
+ */
+static FTL_INDEX TEST_FIND_SHARED(
+/* IN  */ const SIZE32 INDEX,
+/* OUT */ U8 * occupied)
+{
+  for(FTL_INDEX b = 0U; b < 3968U; b++)
+  {
+    U8 m_block[TEST_BLOCK_SIZE];
+    RETURN_CODE m_rc = NO_ERROR;
+    FTL_READ(b, 1U, m_block, &m_rc);
+    if((NO_ERROR != m_rc) || (0U == m_block[0U])
+    || (m_block[0U] >= (1U << TEST_SLOTS_COUNT)))
+    {
+      continue;
+    }
+    for(SIZE32 s = 0U; s < TEST_SLOTS_COUNT; s++)
+    {
+      const U8 * M_SLOT = m_block + 2U + s * TEST_INLINE_SIZE;
+      if((m_block[0U] & (1U << s))
+      && (0 == memcmp(M_SLOT, g_data[INDEX], g_sizes[INDEX])))
+      {
+        *occupied = m_block[0U];
+        return b;
+      }
+    }
+  }
+  return (FTL_INDEX)UN_SET;
+}
+
+int main(int argc, char ** argv)
+{
+  TEST_BEGIN(argc, argv);
+  U32 m_seed = 0x7FEB352DU;
+  for(SIZE32 f = 0U; f < TEST_FILES_COUNT; f++)
+  {
+    for(SIZE32 i = 0U; i < TEST_GROWN_SIZE; i++)
+    {
+      g_data[f][i] = (U8)(1U + TEST_RANDOM(&m_seed) % 255U);
+    }
+  }
+
+  RETURN_CODE m_rc = NO_ERROR;
+  FILE_ERROR m_fe = 0;
+  TEST_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+
+  /* 1. Восемь маленьких файлов занимают два общих блока */
+  for(SIZE32 f = 0U; f < 8U; f++)
+  {
+    TEST_CHECK(TEST_WRITE(f, 6U + 8U * f - (7U == f)));
+  }
+  U8 m_occupied = 0U;
+  const FTL_INDEX M_FIRST = TEST_FIND_SHARED(0U, &m_occupied);
+  TEST_CHECK((FTL_INDEX)UN_SET != M_FIRST);
+  TEST_CHECK(0x0FU == m_occupied);
+  for(SIZE32 f = 1U; f < 8U; f++)
+  {
+    const FTL_INDEX M_SHARED = TEST_FIND_SHARED(f, &m_occupied);
+    TEST_CHECK((f < TEST_SLOTS_COUNT) == (M_FIRST == M_SHARED));
+    TEST_CHECK(0x0FU == m_occupied);
+  }
+  TEST_CHECK(0U == TEST_VERIFY());
+  TEST_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_CHECK(0U == TEST_VERIFY());
+
+  /* 2. Выросший файл уходит в свою цепочку, ячейка освобождается */
+  TEST_CHECK(TEST_WRITE(1U, TEST_GROWN_SIZE));
+  TEST_CHECK(M_FIRST == TEST_FIND_SHARED(0U, &m_occupied));
+  TEST_CHECK(0x0DU == m_occupied);
+  TEST_CHECK(0U == TEST_VERIFY());
+
+  /* 3. Новый маленький файл занимает освободившуюся ячейку */
+  TEST_CHECK(TEST_WRITE(8U, TEST_INLINE_SIZE));
+  TEST_CHECK(M_FIRST == TEST_FIND_SHARED(8U, &m_occupied));
+  TEST_CHECK(0x0FU == m_occupied);
+  TEST_CHECK(0U == TEST_VERIFY());
+
+  /* 4. Удаление всех файлов блока освобождает его в FTL */
+  const SIZE32 M_REMOVED[TEST_SLOTS_COUNT] = { 0U, 2U, 3U, 8U };
+  for(SIZE32 r = 0U; r < TEST_SLOTS_COUNT; r++)
+  {
+    FILE_NAME m_name;
+    TEST_NAME(M_REMOVED[r], m_name);
+    FS_FILE_REMOVE(m_name, &m_rc, &m_fe);
+    TEST_CHECK(NO_ERROR == m_rc);
+    g_present[M_REMOVED[r]] = 0U;
+  }
+  U8 m_block[TEST_BLOCK_SIZE];
+  FTL_READ(M_FIRST, 1U, m_block, &m_rc);
+  TEST_CHECK(NO_ACTION == m_rc);
+  TEST_CHECK(0U == TEST_VERIFY());
+
+  TEST_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_CHECK(0U == TEST_VERIFY());
+  TEST_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  return TEST_END("test_inline");
+}
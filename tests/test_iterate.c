@@ -0,0 +1,261 @@
+/*
+ * ОБХОД ФАЙЛОВ КУРСОРОМ:
+ * обход партиями разного размера возвращает каждый файл ровно один раз
+ * с верными размером и тегами, фильтры по префиксу имени и по тегам
+ * сужают результат. Файлы, удаленные между партиями, не выдаются,
+ * остальные выдаются по одному разу. Размер файла, открытого на запись, -
+ * текущий, еще не сохраненный во flash
+ */
+#include "test.h"
+
+#define TEST_FILES_COUNT 90U
+#define TEST_BATCH_SIZE 7U
+
+static SIZE32 g_sizes[TEST_FILES_COUNT];
+static U8 g_present[TEST_FILES_COUNT];
+static U8 g_tagged[TEST_FILES_COUNT];
+
+/*
+ * ИМЯ ФАЙЛА ОБХОДА (четные номера - "even/", нечетные - "odd/"):
+ *   INDEX: Номер файла
+ *   name: Имя
+ */
+static void TEST_ITERATE_NAME(
+/* IN  */ const SIZE32 INDEX,
+/* OUT */ FILE_NAME name)
+{
+  STD_MEMSET(FILE_NAME_SIZE, 0x00U, name);
+  snprintf(name, FILE_NAME_SIZE, "%s/%03u",
+    (0U == INDEX % 2U) ? "even" : "odd", INDEX);
+}
+
+/*
+ * ОБХОД С ФИЛЬТРОМ:
+ *   PREFIX: Префикс имени
+ *   QUERY: Фильтр по тегам
+ *   QUERY_LENGTH: Количество элементов фильтра
+ *   BATCH: Размер партии
+ *   seen: Сколько раз выдан каждый файл
+ *   return: Количество выданных элементов с неверным размером или тегом
+ *           (UN_SET - ошибка обхода)
+ */
+static SIZE32 TEST_ITERATE(
+/* IN  */ const CHAR * PREFIX,
+/* IN  */ const TAG_QUERY_TYPE * QUERY,
+/* IN  */ const SIZE32 QUERY_LENGTH,
+/* IN  */ const SIZE32 BATCH,
+/* OUT */ SIZE32 * seen)
+{
+  STD_MEMSET(TEST_FILES_COUNT * sizeof(SIZE32), 0x00U, seen);
+  FILE_CURSOR_TYPE m_cursor;
+  RETURN_CODE m_rc = NO_ERROR;
+  FS_FILE_ITERATE_BEGIN(PREFIX, QUERY, QUERY_LENGTH, &m_cursor, &m_rc);
+  if(NO_ERROR != m_rc)
+  {
+    return (SIZE32)UN_SET;
+  }
+
+  SIZE32 m_wrong = 0U;
+  for(;;)
+  {
+    FILE_ENTRY_TYPE m_entries[TEST_BATCH_SIZE];
+    SIZE32 m_count = 0U;
+    FS_FILE_ITERATE(&m_cursor, BATCH, m_entries, &m_count, &m_rc);
+    if(NO_ACTION == m_rc)
+    {
+      return m_wrong;
+    }
+    if((NO_ERROR != m_rc) || (0U == m_count) || (m_count > BATCH))
+    {
+      return (SIZE32)UN_SET;
+    }
+    for(SIZE32 i = 0U; i < m_count; i++)
+    {
+      U32 m_index = 0U;
+      if((1 != sscanf(strchr(m_entries[i].name, '/') + 1, "%u", &m_index))
+      || (m_index >= TEST_FILES_COUNT))
+      {
+        return (SIZE32)UN_SET;
+      }
+      seen[m_index]++;
+      m_wrong += (g_sizes[m_index] != m_entries[i].size)
+        || (g_tagged[m_index] != (m_entries[i].tags[0U] & 1U));
+    }
+  }
+}
+
+/*
+ * СВЕРКА ОБХОДА С МОДЕЛЬЮ:
+ *   SEEN: Сколько раз выдан каждый файл
+ *   PARITY: Четность выдаваемых файлов (2 - все, 3 - ни одного)
+ *   TAGGED: 1 - выдаются только файлы с тегом
+ *   return: Количество несовпадений
+ */
+static SIZE32 TEST_EXPECT(
+/* IN  */ const SIZE32 * SEEN,
+/* IN  */ const SIZE32 PARITY,
+/* IN  */ const U8 TAGGED)
+{
+  SIZE32 m_mismatches = 0U;
+  for(SIZE32 f = 0U; f < TEST_FILES_COUNT; f++)
+  {
+    const U8 M_EXPECTED = g_present[f]
+      && ((2U == PARITY) || (f % 2U == PARITY)) && (!TAGGED || g_tagged[f]);
+    m_mismatches += (M_EXPECTED != SEEN[f]);
+  }
+  return m_mismatches;
+}
+
+int main(int argc, char ** argv)
+{
+  TEST_BEGIN(argc, argv);
+  U32 m_seed = 0x1B873593U;
+
+  RETURN_CODE m_rc = NO_ERROR;
+  FILE_ERROR m_fe = 0;
+  TEST_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+
+  /* 1. Файлы разного размера, у части - тег (первый созданный тег) */
+  U8 m_data[600U];
+  STD_MEMSET(sizeof(m_data), 0x5AU, m_data);
+  TAG_NAME m_tag = "marked";
+  for(SIZE32 f = 0U; f < TEST_FILES_COUNT; f++)
+  {
+    FILE_NAME m_name;
+    TEST_ITERATE_NAME(f, m_name);
+    FS_FILE_CREATE(m_name, &m_rc, &m_fe);
+    TEST_CHECK(NO_ERROR == m_rc);
+    g_present[f] = 1U;
+    g_sizes[f] = TEST_RANDOM(&m_seed) % sizeof(m_data);
+    FILE_ID m_id;
+    FS_FILE_OPEN(m_name, FILE_MODE_READ_WRITE, &m_id, &m_rc, &m_fe);
+    TEST_CHECK(NO_ERROR == m_rc);
+    FS_FILE_WRITE(m_id, g_sizes[f], m_data, &m_rc, &m_fe);
+    TEST_CHECK(NO_ERROR == m_rc);
+    FS_FILE_CLOSE(m_id, &m_rc, &m_fe);
+    TEST_CHECK(NO_ERROR == m_rc);
+    if(0U == TEST_RANDOM(&m_seed) % 3U)
+    {
+      FS_TAG_ADD(m_name, m_tag, &m_rc);
+      TEST_CHECK(NO_ERROR == m_rc);
+      g_tagged[f] = 1U;
+    }
+  }
+
+  /* 2. Полный обход партиями разного размера */
+  SIZE32 m_seen[TEST_FILES_COUNT];
+  for(SIZE32 b = 1U; b <= TEST_BATCH_SIZE; b += 3U)
+  {
+    TEST_CHECK(0U == TEST_ITERATE(
+      "", (const TAG_QUERY_TYPE *)(0), 0U, b, m_seen));
+    TEST_CHECK(0U == TEST_EXPECT(m_seen, 2U, 0U));
+  }
+
+  /* 3. Фильтры: префикс, тег, префикс и тег */
+  TAG_QUERY_TYPE m_query;
+  STD_MEMSET(sizeof(m_query), 0x00U, &m_query);
+  m_query.op = TAG_QUERY_TAG;
+  STD_MEMCPY(sizeof(TAG_NAME), m_tag, m_query.tag);
+  TEST_CHECK(0U == TEST_ITERATE(
+    "odd/", (const TAG_QUERY_TYPE *)(0), 0U, TEST_BATCH_SIZE, m_seen));
+  TEST_CHECK(0U == TEST_EXPECT(m_seen, 1U, 0U));
+  TEST_CHECK(0U == TEST_ITERATE("", &m_query, 1U, TEST_BATCH_SIZE, m_seen));
+  TEST_CHECK(0U == TEST_EXPECT(m_seen, 2U, 1U));
+  TEST_CHECK(0U == TEST_ITERATE(
+    "even/", &m_query, 1U, TEST_BATCH_SIZE, m_seen));
+  TEST_CHECK(0U == TEST_EXPECT(m_seen, 0U, 1U));
+  TEST_CHECK(0U == TEST_ITERATE(
+    "none/", (const TAG_QUERY_TYPE *)(0), 0U, TEST_BATCH_SIZE, m_seen));
+  TEST_CHECK(0U == TEST_EXPECT(m_seen, 3U, 0U));
+
+  /* 4. Некорректные префикс и фильтр отклоняются */
+  CHAR m_long[FILE_NAME_SIZE + 1U];
+  STD_MEMSET(FILE_NAME_SIZE, 'p', m_long);
+  m_long[FILE_NAME_SIZE] = '\0';
+  FILE_CURSOR_TYPE m_cursor;
+  FS_FILE_ITERATE_BEGIN(
+    m_long, (const TAG_QUERY_TYPE *)(0), 0U, &m_cursor, &m_rc
+  );
+  TEST_CHECK(INVALID_PARAM == m_rc);
+  m_query.op = TAG_QUERY_NOT;
+  FS_FILE_ITERATE_BEGIN("", &m_query, 1U, &m_cursor, &m_rc);
+  TEST_CHECK(INVALID_PARAM == m_rc);
+  m_query.op = TAG_QUERY_TAG;
+
+  /* 5. Удаление файлов между партиями: удаленные не выдаются,
+   * выданные не повторяются */
+  FS_FILE_ITERATE_BEGIN(
+    "", (const TAG_QUERY_TYPE *)(0), 0U, &m_cursor, &m_rc
+  );
+  TEST_CHECK(NO_ERROR == m_rc);
+  STD_MEMSET(sizeof(m_seen), 0x00U, m_seen);
+  SIZE32 m_batches = 0U;
+  for(;;)
+  {
+    FILE_ENTRY_TYPE m_entries[TEST_BATCH_SIZE];
+    SIZE32 m_count = 0U;
+    FS_FILE_ITERATE(&m_cursor, TEST_BATCH_SIZE, m_entries, &m_count, &m_rc);
+    if(NO_ERROR != m_rc)
+    {
+      TEST_CHECK(NO_ACTION == m_rc);
+      break;
+    }
+    for(SIZE32 i = 0U; i < m_count; i++)
+    {
+      U32 m_index = 0U;
+      TEST_CHECK(1 == sscanf(strchr(m_entries[i].name, '/') + 1, "%u",
+        &m_index));
+      m_seen[m_index % TEST_FILES_COUNT]++;
+    }
+
+    /* Удаляется последний файл, еще не выданный обходом */
+    if(0U == m_batches++ % 2U)
+    {
+      SIZE32 f = TEST_FILES_COUNT;
+      while((f > 0U) && !g_present[f - 1U])
+      {
+        f--;
+      }
+      if((f > 0U) && (0U == m_seen[f - 1U]))
+      {
+        FILE_NAME m_name;
+        TEST_ITERATE_NAME(f - 1U, m_name);
+        FS_FILE_REMOVE(m_name, &m_rc, &m_fe);
+        TEST_CHECK(NO_ERROR == m_rc);
+        g_present[f - 1U] = 0U;
+      }
+    }
+  }
+  TEST_CHECK(0U == TEST_EXPECT(m_seen, 2U, 0U));
+
+  /* 6. Размер файла, открытого на запись, - текущий */
+  FILE_NAME m_name;
+  TEST_ITERATE_NAME(0U, m_name);
+  FILE_ID m_id;
+  FS_FILE_OPEN(m_name, FILE_MODE_READ_WRITE, &m_id, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+  FILE_POSITION m_position;
+  FS_FILE_SEEK(m_id, 0, FILE_SEEK_END, &m_position, &m_rc, &m_fe);
+  FS_FILE_WRITE(m_id, sizeof(m_data), m_data, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+  g_sizes[0U] += sizeof(m_data);
+  TEST_CHECK(0U == TEST_ITERATE(
+    "even/", (const TAG_QUERY_TYPE *)(0), 0U, TEST_BATCH_SIZE, m_seen));
+  TEST_CHECK(0U == TEST_EXPECT(m_seen, 0U, 0U));
+  FS_FILE_CLOSE(m_id, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+
+  /* 7. После переподключения обход тот же */
+  TEST_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_CHECK(0U == TEST_ITERATE(
+    "", (const TAG_QUERY_TYPE *)(0), 0U, TEST_BATCH_SIZE, m_seen));
+  TEST_CHECK(0U == TEST_EXPECT(m_seen, 2U, 0U));
+
+  TEST_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  return TEST_END("test_iterate");
+}
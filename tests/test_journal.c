@@ -0,0 +1,377 @@
+/*
+ * ВОСПРОИЗВЕДЕНИЕ ЖУРНАЛА МЕТАДАННЫХ:
+ * дочерний процесс создает и заполняет файлы и завершается без FS_FREE
+ * (контрольная точка при отключении не выполняется) или теряет питание
+ * на случайной операции flash. Журнал переполняется несколько раз, таблицы
+ * записываются на место и вытеснением из кэша, и контрольными точками.
+ * После переподключения созданные файлы должны быть префиксом
+ * последовательности создания, а закрытые файлы - содержать свои данные.
+ * Удаление и усечение большого файла с отключением питания дают старый
+ * или новый файл, а освобождение цепочки не теряет блоки: циклов больше,
+ * чем помещается утерянных цепочек в томе
+ */
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "test.h"
+
+#define TEST_FILES_COUNT 40U
+#define TEST_FILE_SIZE 300U
+#define TEST_CUTS_COUNT 12U
+#define TEST_CUT_RANGE 900U
+#define TEST_BIG_SIZE (200U * 248U)
+#define TEST_BIG_CYCLES 24U
+#define TEST_BIG_CUT_RANGE 12U
+
+/*
+ * ДАННЫЕ ФАЙЛА:
+ *   INDEX: Номер файла
+ *   data: Данные
+ */
+static void TEST_DATA(
+/* IN  */ const SIZE32 INDEX,
+/* OUT */ U8 * data)
+{
+  U32 m_seed = INDEX * 2654435761U + 1U;
+  for(SIZE32 i = 0U; i < TEST_FILE_SIZE; i++)
+  {
+    data[i] = (U8)TEST_RANDOM(&m_seed);
+  }
+}
+
+/*
+ * СОЗДАНИЕ И ЗАПОЛНЕНИЕ ФАЙЛА:
+ *   INDEX: Номер файла
+ *   return: 1 - файл создан, записан и закрыт
+ */
+static U8 TEST_CREATE(
+/* IN  */ const SIZE32 INDEX)
+{
+  FILE_NAME m_name;
+  TEST_NAME(INDEX, m_name);
+  U8 m_data[TEST_FILE_SIZE];
+  TEST_DATA(INDEX, m_data);
+  RETURN_CODE m_rc = NO_ERROR;
+  FILE_ERROR m_fe = 0;
+  FS_FILE_CREATE(m_name, &m_rc, &m_fe);
+  if(NO_ERROR != m_rc)
+  {
+    return 0U;
+  }
+  FILE_ID m_id;
+  FS_FILE_OPEN(m_name, FILE_MODE_READ_WRITE, &m_id, &m_rc, &m_fe);
+  if(NO_ERROR != m_rc)
+  {
+    return 0U;
+  }
+  RETURN_CODE m_write_rc = NO_ERROR;
+  FS_FILE_WRITE(m_id, TEST_FILE_SIZE, m_data, &m_write_rc, &m_fe);
+  FS_FILE_CLOSE(m_id, &m_rc, &m_fe);
+  return (NO_ERROR == m_write_rc) && (NO_ERROR == m_rc);
+}
+
+/*
+ * ПРОВЕРКА ФАЙЛА:
+ *   INDEX: Номер файла
+ *   CONTENT: 1 - сверить данные
+ *   return: 1 - файл есть (и данные совпадают)
+ */
+static U8 TEST_EXISTS(
+/* IN  */ const SIZE32 INDEX,
+/* IN  */ const U8 CONTENT)
+{
+  FILE_NAME m_name;
+  TEST_NAME(INDEX, m_name);
+  RETURN_CODE m_rc = NO_ERROR;
+  FILE_ERROR m_fe = 0;
+  FILE_ID m_id;
+  FS_FILE_OPEN(m_name, FILE_MODE_READ_ONLY, &m_id, &m_rc, &m_fe);
+  if(NO_ERROR != m_rc)
+  {
+    return 0U;
+  }
+  U8 m_data[TEST_FILE_SIZE];
+  U8 m_expected[TEST_FILE_SIZE];
+  TEST_DATA(INDEX, m_expected);
+  SIZE32 m_length = 0U;
+  FS_FILE_READ(m_id, TEST_FILE_SIZE, &m_length, m_data, &m_rc, &m_fe);
+  FS_FILE_CLOSE(m_id, &m_rc, &m_fe);
+  return !CONTENT || ((TEST_FILE_SIZE == m_length)
+                  && (0 == memcmp(m_data, m_expected, TEST_FILE_SIZE)));
+}
+
+/*
+ * СОЗДАНИЕ ФАЙЛОВ В ДОЧЕРНЕМ ПРОЦЕССЕ (FS_FREE не вызывается):
+ *   CUT: Операция flash, на которой отключается питание (0 - без отключения)
+ */
+static void TEST_CHILD(
+/* IN  */ const SIZE32 CUT)
+{
+  const pid_t M_PID = fork();
+  if(0 == M_PID)
+  {
+    RETURN_CODE m_rc = NO_ERROR;
+    TEST_MOUNT(&m_rc);
+    EMULATOR_POWER_CUT(CUT);
+    for(SIZE32 f = 0U; (f < TEST_FILES_COUNT) && !g_emulator->power_off; f++)
+    {
+      if(!TEST_CREATE(f))
+      {
+        break;
+      }
+    }
+    _exit(0);
+  }
+  int m_status = 0;
+  waitpid(M_PID, &m_status, 0);
+}
+
+/*
+ * ЗАПИСЬ БОЛЬШОГО ФАЙЛА (имя - номер TEST_FILES_COUNT):
+ *   return: 1 - файл создан, записан и закрыт
+ */
+static U8 TEST_BIG_CREATE(void)
+{
+  static U8 s_data[TEST_BIG_SIZE];
+  for(SIZE32 i = 0U; i < TEST_BIG_SIZE; i++)
+  {
+    s_data[i] = (U8)(i * 31U + i / 248U);
+  }
+  FILE_NAME m_name;
+  TEST_NAME(TEST_FILES_COUNT, m_name);
+  RETURN_CODE m_rc = NO_ERROR;
+  FILE_ERROR m_fe = 0;
+  FS_FILE_CREATE(m_name, &m_rc, &m_fe);
+  if(NO_ERROR != m_rc)
+  {
+    return 0U;
+  }
+  FILE_ID m_id;
+  FS_FILE_OPEN(m_name, FILE_MODE_READ_WRITE, &m_id, &m_rc, &m_fe);
+  if(NO_ERROR != m_rc)
+  {
+    return 0U;
+  }
+  RETURN_CODE m_write_rc = NO_ERROR;
+  FS_FILE_WRITE(m_id, TEST_BIG_SIZE, s_data, &m_write_rc, &m_fe);
+  FS_FILE_CLOSE(m_id, &m_rc, &m_fe);
+  return (NO_ERROR == m_write_rc) && (NO_ERROR == m_rc);
+}
+
+/*
+ * ПРОВЕРКА БОЛЬШОГО ФАЙЛА:
+ *   return: Размер файла (UN_SET - файла нет, 0 - данные не совпадают
+ *           с префиксом записанных)
+ */
+static SIZE32 TEST_BIG_CHECK(void)
+{
+  static U8 s_data[TEST_BIG_SIZE];
+  FILE_NAME m_name;
+  TEST_NAME(TEST_FILES_COUNT, m_name);
+  RETURN_CODE m_rc = NO_ERROR;
+  FILE_ERROR m_fe = 0;
+  FILE_ID m_id;
+  FS_FILE_OPEN(m_name, FILE_MODE_READ_ONLY, &m_id, &m_rc, &m_fe);
+  if(NO_ERROR != m_rc)
+  {
+    return (SIZE32)UN_SET;
+  }
+  SIZE32 m_length = 0U;
+  FS_FILE_READ(m_id, TEST_BIG_SIZE, &m_length, s_data, &m_rc, &m_fe);
+  FS_FILE_CLOSE(m_id, &m_rc, &m_fe);
+  for(SIZE32 i = 0U; i < m_length; i++)
+  {
+    if(s_data[i] != (U8)(i * 31U + i / 248U))
+    {
+      return 0U;
+    }
+  }
+  return m_length;
+}
+
+/*
+ * СВОБОДНОЕ МЕСТО ТОМА (файл записывается до отказа и удаляется):
+ *   return: Количество записанных байтов
+ */
+static SIZE32 TEST_CAPACITY(void)
+{
+  U8 m_data[8U * 248U] = {0};
+  FILE_NAME m_name;
+  TEST_NAME(TEST_FILES_COUNT + 1U, m_name);
+  RETURN_CODE m_rc = NO_ERROR;
+  FILE_ERROR m_fe = 0;
+  FS_FILE_CREATE(m_name, &m_rc, &m_fe);
+  FILE_ID m_id;
+  FS_FILE_OPEN(m_name, FILE_MODE_READ_WRITE, &m_id, &m_rc, &m_fe);
+  SIZE32 m_size = 0U;
+  while(NO_ERROR == m_rc)
+  {
+    FS_FILE_WRITE(m_id, sizeof(m_data), m_data, &m_rc, &m_fe);
+    if(NO_ERROR == m_rc)
+    {
+      m_size += sizeof(m_data);
+    }
+  }
+  FS_FILE_CLOSE(m_id, &m_rc, &m_fe);
+  FS_FILE_REMOVE(m_name, &m_rc, &m_fe);
+  return m_size;
+}
+
+/*
+ * УДАЛЕНИЕ ИЛИ УСЕЧЕНИЕ БОЛЬШОГО ФАЙЛА В ДОЧЕРНЕМ ПРОЦЕССЕ:
+ *   CUT: Операция flash, на которой отключается питание
+ *   REMOVE: 1 - удаление, 0 - усечение до TEST_FILE_SIZE
+ */
+static void TEST_BIG_CHILD(
+/* IN  */ const SIZE32 CUT,
+/* IN  */ const U8 REMOVE)
+{
+  const pid_t M_PID = fork();
+  if(0 == M_PID)
+  {
+    RETURN_CODE m_rc = NO_ERROR;
+    FILE_ERROR m_fe = 0;
+    FILE_NAME m_name;
+    TEST_NAME(TEST_FILES_COUNT, m_name);
+    TEST_MOUNT(&m_rc);
+    FILE_ID m_id = 0U;
+    if(!REMOVE)
+    {
+      FS_FILE_OPEN(m_name, FILE_MODE_READ_WRITE, &m_id, &m_rc, &m_fe);
+    }
+    EMULATOR_POWER_CUT(CUT);
+    if(REMOVE)
+    {
+      FS_FILE_REMOVE(m_name, &m_rc, &m_fe);
+    }
+    else
+    {
+      FS_FILE_TRUNCATE(m_id, TEST_FILE_SIZE, &m_rc, &m_fe);
+    }
+    _exit(0);
+  }
+  int m_status = 0;
+  waitpid(M_PID, &m_status, 0);
+}
+
+/*
+ * ЧИСТЫЙ ОБРАЗ (заголовок flash-драйвера пишет FLASH_FREE):
+ *   return_code: Статус FS_FREE
+ */
+static void TEST_FORMAT(
+/* OUT */ RETURN_CODE * return_code)
+{
+  remove(g_test_image);
+  TEST_MOUNT(return_code);
+  if(NO_ERROR != *return_code)
+  {
+    return;
+  }
+  TEST_UNMOUNT(return_code);
+}
+
+int main(int argc, char ** argv)
+{
+  TEST_BEGIN(argc, argv);
+  RETURN_CODE m_rc = NO_ERROR;
+
+  /* 1. Завершение без контрольной точки: все транзакции воспроизводятся */
+  TEST_FORMAT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_CHILD(0U);
+  TEST_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  for(SIZE32 f = 0U; f < TEST_FILES_COUNT; f++)
+  {
+    TEST_CHECK(TEST_EXISTS(f, 1U));
+  }
+  TEST_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+
+  /* 2. Отключение питания: созданные файлы - префикс, том пригоден */
+  U32 m_seed = 0x9E3779B9U;
+  for(SIZE32 c = 0U; c < TEST_CUTS_COUNT; c++)
+  {
+    const SIZE32 M_CUT = 1U + TEST_RANDOM(&m_seed) % TEST_CUT_RANGE;
+    TEST_FORMAT(&m_rc);
+    TEST_CHECK(NO_ERROR == m_rc);
+    TEST_CHILD(M_CUT);
+
+    TEST_MOUNT(&m_rc);
+    TEST_CHECK(NO_ERROR == m_rc);
+    SIZE32 m_count = 0U;
+    while((m_count < TEST_FILES_COUNT) && TEST_EXISTS(m_count, 0U))
+    {
+      m_count++;
+    }
+    for(SIZE32 f = m_count; f < TEST_FILES_COUNT; f++)
+    {
+      TEST_CHECK(!TEST_EXISTS(f, 0U));
+    }
+    for(SIZE32 f = 0U; f + 1U < m_count; f++)
+    {
+      TEST_CHECK(TEST_EXISTS(f, 1U));
+    }
+
+    /* Том после воспроизведения пригоден для записи */
+    for(SIZE32 f = m_count; f < TEST_FILES_COUNT; f++)
+    {
+      FILE_NAME m_name;
+      FILE_ERROR m_fe = 0;
+      TEST_NAME(f, m_name);
+      FS_FILE_REMOVE(m_name, &m_rc, &m_fe);
+      TEST_CHECK(TEST_CREATE(f));
+    }
+    TEST_UNMOUNT(&m_rc);
+    TEST_CHECK(NO_ERROR == m_rc);
+    TEST_MOUNT(&m_rc);
+    TEST_CHECK(NO_ERROR == m_rc);
+    for(SIZE32 f = 0U; f < TEST_FILES_COUNT; f++)
+    {
+      TEST_CHECK(TEST_EXISTS(f, f + 1U < m_count || f >= m_count));
+    }
+    TEST_UNMOUNT(&m_rc);
+    TEST_CHECK(NO_ERROR == m_rc);
+  }
+
+  /* 3. Удаление и усечение с отключением питания: файл старый или новый,
+   *    блоки цепочки не теряются */
+  TEST_FORMAT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  const SIZE32 M_CAPACITY = TEST_CAPACITY();
+  TEST_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  for(SIZE32 c = 0U; c < TEST_BIG_CYCLES; c++)
+  {
+    TEST_MOUNT(&m_rc);
+    TEST_CHECK(NO_ERROR == m_rc);
+    TEST_CHECK(TEST_BIG_CREATE());
+    TEST_UNMOUNT(&m_rc);
+    TEST_CHECK(NO_ERROR == m_rc);
+
+    const U8 M_REMOVE = (U8)(0U == c % 2U);
+    TEST_BIG_CHILD(1U + (c / 2U) % TEST_BIG_CUT_RANGE, M_REMOVE);
+
+    TEST_MOUNT(&m_rc);
+    TEST_CHECK(NO_ERROR == m_rc);
+    const SIZE32 M_SIZE = TEST_BIG_CHECK();
+    TEST_CHECK((TEST_BIG_SIZE == M_SIZE)
+            || (M_REMOVE ? ((SIZE32)UN_SET == M_SIZE)
+                         : (TEST_FILE_SIZE == M_SIZE)));
+    FILE_NAME m_name;
+    FILE_ERROR m_fe = 0;
+    TEST_NAME(TEST_FILES_COUNT, m_name);
+    FS_FILE_REMOVE(m_name, &m_rc, &m_fe);
+    TEST_UNMOUNT(&m_rc);
+    TEST_CHECK(NO_ERROR == m_rc);
+  }
+  TEST_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_CHECK(M_CAPACITY == TEST_CAPACITY());
+  TEST_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+
+  return TEST_END("test_journal");
+}
@@ -0,0 +1,156 @@
+/*
+ * ХРАНИЛИЩЕ КЛЮЧ-ЗНАЧЕНИЕ:
+ * случайные записи, перезаписи и удаления ключей сверяются с моделью в ОЗУ
+ * (объем записей превышает область FTL: блоки записей собираются сборщиком
+ * мусора), затем - после переподключения. Проверяются границы длин,
+ * независимость от отката снимка ФС и отказ при переполнении индекса
+ */
+#include "test.h"
+
+#define TEST_KEYS_COUNT 128U
+#define TEST_OPERATIONS 12000U
+#define TEST_EXTRA_KEYS 256U
+
+static U8 g_values[TEST_KEYS_COUNT][FS_KV_VALUE_SIZE];
+static SIZE32 g_lengths[TEST_KEYS_COUNT];
+static U8 g_present[TEST_KEYS_COUNT];
+
+/*
+ * КЛЮЧ:
+ *   INDEX: Номер ключа
+ *   key: Ключ
+ *   return: Длина ключа
+ */
+static SIZE32 TEST_KEY(
+/* IN  */ const U32 INDEX,
+/* OUT */ CHAR * key)
+{
+  return (SIZE32)snprintf(key, FS_KV_KEY_SIZE + 1U, "key/%u", INDEX);
+}
+
+/*
+ * СВЕРКА ХРАНИЛИЩА С МОДЕЛЬЮ:
+ *   return: Количество несовпавших ключей
+ */
+static SIZE32 TEST_VERIFY(void)
+{
+  SIZE32 m_mismatches = 0U;
+  for(U32 k = 0U; k < TEST_KEYS_COUNT; k++)
+  {
+    CHAR m_key[FS_KV_KEY_SIZE + 1U];
+    const SIZE32 M_KEY_LENGTH = TEST_KEY(k, m_key);
+    U8 m_value[FS_KV_VALUE_SIZE];
+    SIZE32 m_length = 0U;
+    RETURN_CODE m_rc = NO_ERROR;
+    FS_KV_GET(
+      m_key, M_KEY_LENGTH, FS_KV_VALUE_SIZE, m_value, &m_length, &m_rc
+    );
+    if(!g_present[k])
+    {
+      m_mismatches += (NO_ACTION != m_rc);
+      continue;
+    }
+    m_mismatches += (NO_ERROR != m_rc) || (g_lengths[k] != m_length)
+                 || (0 != memcmp(m_value, g_values[k], m_length));
+  }
+  return m_mismatches;
+}
+
+int main(int argc, char ** argv)
+{
+  TEST_BEGIN(argc, argv);
+  U32 m_seed = 0x165667B1U;
+
+  RETURN_CODE m_rc = NO_ERROR;
+  TEST_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+
+  /* 1. Границы длин ключа и значения */
+  U8 m_value[FS_KV_VALUE_SIZE + 1U] = { 0U };
+  CHAR m_long[FS_KV_KEY_SIZE + 2U];
+  STD_MEMSET(sizeof(m_long), 'k', m_long);
+  FS_KV_PUT(m_long, 0U, m_value, 1U, &m_rc);
+  TEST_CHECK(INVALID_PARAM == m_rc);
+  FS_KV_PUT(m_long, FS_KV_KEY_SIZE + 1U, m_value, 1U, &m_rc);
+  TEST_CHECK(INVALID_PARAM == m_rc);
+  FS_KV_PUT(m_long, 1U, m_value, FS_KV_VALUE_SIZE + 1U, &m_rc);
+  TEST_CHECK(INVALID_PARAM == m_rc);
+  FS_KV_PUT(m_long, FS_KV_KEY_SIZE, m_value, FS_KV_VALUE_SIZE, &m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  SIZE32 m_length = 0U;
+  FS_KV_GET(m_long, FS_KV_KEY_SIZE, 1U, m_value, &m_length, &m_rc);
+  TEST_CHECK(INVALID_PARAM == m_rc);
+  TEST_CHECK(FS_KV_VALUE_SIZE == m_length);
+  FS_KV_DELETE(m_long, FS_KV_KEY_SIZE, &m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  FS_KV_DELETE(m_long, FS_KV_KEY_SIZE, &m_rc);
+  TEST_CHECK(NO_ACTION == m_rc);
+
+  /* 2. Случайные записи и удаления */
+  SIZE32 m_failed = 0U;
+  for(SIZE32 n = 0U; n < TEST_OPERATIONS; n++)
+  {
+    const U32 M_INDEX = TEST_RANDOM(&m_seed) % TEST_KEYS_COUNT;
+    CHAR m_key[FS_KV_KEY_SIZE + 1U];
+    const SIZE32 M_KEY_LENGTH = TEST_KEY(M_INDEX, m_key);
+    if(0U == TEST_RANDOM(&m_seed) % 5U)
+    {
+      FS_KV_DELETE(m_key, M_KEY_LENGTH, &m_rc);
+      m_failed += (g_present[M_INDEX] ? NO_ERROR : NO_ACTION) != m_rc;
+      g_present[M_INDEX] = 0U;
+      continue;
+    }
+    g_lengths[M_INDEX] = TEST_RANDOM(&m_seed) % (FS_KV_VALUE_SIZE + 1U);
+    for(SIZE32 i = 0U; i < g_lengths[M_INDEX]; i++)
+    {
+      g_values[M_INDEX][i] = (U8)TEST_RANDOM(&m_seed);
+    }
+    FS_KV_PUT(
+      m_key, M_KEY_LENGTH, g_values[M_INDEX], g_lengths[M_INDEX], &m_rc
+    );
+    m_failed += (NO_ERROR != m_rc);
+    g_present[M_INDEX] = 1U;
+  }
+  TEST_CHECK(0U == m_failed);
+  TEST_CHECK(0U == TEST_VERIFY());
+
+  /* 3. Переподключение: индекс восстанавливается из flash */
+  TEST_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_CHECK(0U == TEST_VERIFY());
+
+  /* 4. Откат снимка ФС не меняет хранилище */
+  SNAPSHOT_ID m_snapshot;
+  FS_SNAPSHOT_CREATE(&m_snapshot, &m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  CHAR m_key[FS_KV_KEY_SIZE + 1U];
+  const SIZE32 M_KEY_LENGTH = TEST_KEY(0U, m_key);
+  g_lengths[0U] = 3U;
+  STD_MEMCPY(3U, (VOID_PTR)"new", g_values[0U]);
+  g_present[0U] = 1U;
+  FS_KV_PUT(m_key, M_KEY_LENGTH, g_values[0U], g_lengths[0U], &m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  FS_SNAPSHOT_ROLLBACK(m_snapshot, &m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  FS_SNAPSHOT_DELETE(m_snapshot, &m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_CHECK(0U == TEST_VERIFY());
+
+  /* 5. Переполнение индекса: новые ключи отклоняются, старые читаются */
+  SIZE32 m_refused = 0U;
+  for(U32 k = TEST_KEYS_COUNT; k < TEST_KEYS_COUNT + TEST_EXTRA_KEYS; k++)
+  {
+    const SIZE32 M_LENGTH = TEST_KEY(k, m_key);
+    FS_KV_PUT(m_key, M_LENGTH, m_key, M_LENGTH, &m_rc);
+    m_refused += (NO_ACTION == m_rc);
+    TEST_CHECK((NO_ERROR == m_rc) || (NO_ACTION == m_rc));
+  }
+  TEST_CHECK(0U != m_refused);
+  TEST_CHECK(0U == TEST_VERIFY());
+
+  TEST_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  return TEST_END("test_kv");
+}
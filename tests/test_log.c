@@ -0,0 +1,169 @@
+/*
+ * ЖУРНАЛ ЗАПИСЕЙ:
+ * записи переменной длины добавляются в конец и читаются по порядку,
+ * прочитанное начало отбрасывается FS_LOG_TRIM. Добавленные за все круги
+ * данные превышают область данных ФС: отброшенные блоки должны
+ * освобождаться. После переподключения журнал начинается с первой
+ * неотброшенной записи
+ */
+#include "test.h"
+
+#define TEST_RECORD_MAX 300U
+#define TEST_RECORDS_COUNT 200U
+#define TEST_ROUNDS 60U
+#define TEST_TRIM_COUNT 150U
+
+/*
+ * ДАННЫЕ ЗАПИСИ:
+ *   INDEX: Номер записи от создания журнала
+ *   data: Данные
+ *   return: Длина записи
+ */
+static SIZE32 TEST_RECORD(
+/* IN  */ const U32 INDEX,
+/* OUT */ U8 * data)
+{
+  const SIZE32 M_LENGTH
+    = sizeof(U32) + (INDEX * 37U) % (TEST_RECORD_MAX - sizeof(U32) + 1U);
+  U32 m_seed = INDEX * 2246822519U + 1U;
+  for(SIZE32 i = 0U; i < M_LENGTH; i++)
+  {
+    data[i] = (U8)TEST_RANDOM(&m_seed);
+  }
+  STD_MEMCPY(sizeof(U32), (VOID_PTR)&INDEX, data);
+  return M_LENGTH;
+}
+
+/*
+ * ДОБАВЛЕНИЕ ЗАПИСЕЙ:
+ *   ID: Дескриптор журнала
+ *   FIRST: Номер первой записи
+ *   COUNT: Количество записей
+ *   return: Количество неудачных добавлений
+ */
+static SIZE32 TEST_APPEND(
+/* IN  */ const FILE_ID ID,
+/* IN  */ const U32 FIRST,
+/* IN  */ const SIZE32 COUNT)
+{
+  SIZE32 m_failed = 0U;
+  for(U32 k = FIRST; k < FIRST + COUNT; k++)
+  {
+    U8 m_data[TEST_RECORD_MAX];
+    const SIZE32 M_LENGTH = TEST_RECORD(k, m_data);
+    RETURN_CODE m_rc = NO_ERROR;
+    FILE_ERROR m_fe = 0;
+    FS_LOG_APPEND(ID, M_LENGTH, m_data, &m_rc, &m_fe);
+    m_failed += (NO_ERROR != m_rc);
+  }
+  return m_failed;
+}
+
+/*
+ * ЧТЕНИЕ ЗАПИСЕЙ С ТЕКУЩЕЙ ПОЗИЦИИ:
+ *   ID: Дескриптор журнала
+ *   FIRST: Номер ожидаемой первой записи
+ *   COUNT: Количество записей (UN_SET - до конца журнала)
+ *   return: Количество прочитанных совпавших записей (UN_SET - несовпадение
+ *           или ошибка)
+ */
+static SIZE32 TEST_READ(
+/* IN  */ const FILE_ID ID,
+/* IN  */ const U32 FIRST,
+/* IN  */ const SIZE32 COUNT)
+{
+  SIZE32 m_count = 0U;
+  while((UN_SET == COUNT) || (m_count < COUNT))
+  {
+    U8 m_data[TEST_RECORD_MAX];
+    U8 m_expected[TEST_RECORD_MAX];
+    SIZE32 m_length = 0U;
+    RETURN_CODE m_rc = NO_ERROR;
+    FILE_ERROR m_fe = 0;
+    FS_LOG_READ(ID, TEST_RECORD_MAX, m_data, &m_length, &m_rc, &m_fe);
+    if((NO_ACTION == m_rc) && (UN_SET == COUNT))
+    {
+      return m_count;
+    }
+    const SIZE32 M_LENGTH = TEST_RECORD(FIRST + m_count, m_expected);
+    if((NO_ERROR != m_rc) || (M_LENGTH != m_length)
+    || (0 != memcmp(m_data, m_expected, M_LENGTH)))
+    {
+      return UN_SET;
+    }
+    m_count++;
+  }
+  return m_count;
+}
+
+int main(int argc, char ** argv)
+{
+  TEST_BEGIN(argc, argv);
+
+  RETURN_CODE m_rc = NO_ERROR;
+  FILE_ERROR m_fe = 0;
+  TEST_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+
+  /* 1. Создание и заполнение журнала */
+  FILE_NAME m_name;
+  TEST_NAME(0U, m_name);
+  FS_LOG_CREATE(m_name, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+  FILE_ID m_id;
+  FS_FILE_OPEN(m_name, FILE_MODE_READ_WRITE, &m_id, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_CHECK(0U == TEST_APPEND(m_id, 0U, TEST_RECORDS_COUNT));
+  FS_FILE_CLOSE(m_id, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+
+  /* 2. Чтение всех записей по порядку */
+  FS_FILE_OPEN(m_name, FILE_MODE_READ_ONLY, &m_id, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_CHECK(TEST_RECORDS_COUNT == TEST_READ(m_id, 0U, UN_SET));
+  FS_LOG_TRIM(m_id, &m_rc, &m_fe);
+  TEST_CHECK(ACCESS_DENIED == m_rc);
+  FS_FILE_CLOSE(m_id, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+
+  /* 3. Отбрасывание прочитанного начала и добавление по кругу */
+  U32 m_first = 0U;
+  U32 m_next = TEST_RECORDS_COUNT;
+  SIZE32 m_failed = 0U;
+  for(SIZE32 r = 0U; r < TEST_ROUNDS; r++)
+  {
+    FS_FILE_OPEN(m_name, FILE_MODE_READ_WRITE, &m_id, &m_rc, &m_fe);
+    TEST_CHECK(NO_ERROR == m_rc);
+    TEST_CHECK(TEST_TRIM_COUNT == TEST_READ(m_id, m_first, TEST_TRIM_COUNT));
+    FS_LOG_TRIM(m_id, &m_rc, &m_fe);
+    TEST_CHECK(NO_ERROR == m_rc);
+    m_first += TEST_TRIM_COUNT;
+    m_failed += TEST_APPEND(m_id, m_next, TEST_TRIM_COUNT);
+    m_next += TEST_TRIM_COUNT;
+    FS_FILE_CLOSE(m_id, &m_rc, &m_fe);
+    TEST_CHECK(NO_ERROR == m_rc);
+  }
+  TEST_CHECK(0U == m_failed);
+
+  /* 4. После переподключения журнал начинается с первой неотброшенной
+   *    записи */
+  TEST_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  FS_FILE_OPEN(m_name, FILE_MODE_READ_ONLY, &m_id, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_CHECK(m_next - m_first == TEST_READ(m_id, m_first, UN_SET));
+  FS_FILE_CLOSE(m_id, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+
+  /* 5. Журнал не копируется */
+  FILE_NAME m_copy;
+  TEST_NAME(1U, m_copy);
+  FS_FILE_CLONE(m_name, m_copy, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR != m_rc);
+
+  TEST_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  return TEST_END("test_log");
+}
@@ -0,0 +1,184 @@
+/*
+ * ОТОБРАЖЕНИЕ ФАЙЛОВ В ПАМЯТЬ:
+ * отображения всех файлов удерживаются, пока файлы многократно
+ * перезаписываются. Закрепленные данные не меняются, запись не получает
+ * отказа: закрепление, которое оставило бы сборщик мусора без резерва,
+ * отклоняется FS_FILE_MAP с FILE_ERROR_NO_SPACE. После снятия отображений
+ * файлы сверяются с копией в ОЗУ. Блоки закрепляются при сборке
+ * без шифрования (FTL_ENCRYPT=0), иначе отображение - копии в буфере
+ */
+#include "test.h"
+
+#define TEST_FILES_COUNT 24U
+#define TEST_FILE_SIZE 8500U
+#define TEST_OPERATIONS 4800U
+#define TEST_CHUNK_SIZE 2000U
+#define TEST_SEGMENTS_COUNT 64U
+
+static U8 g_model[TEST_FILES_COUNT][TEST_FILE_SIZE];
+static U8 g_mapped[TEST_FILES_COUNT][TEST_FILE_SIZE];
+static U8 g_scratch[TEST_FILES_COUNT][TEST_FILE_SIZE];
+static FILE_SEGMENT_TYPE g_segments[TEST_FILES_COUNT][TEST_SEGMENTS_COUNT];
+static SIZE32 g_counts[TEST_FILES_COUNT];
+static U8 g_buffer[TEST_FILE_SIZE];
+
+/*
+ * ЗАПИСЬ ФРАГМЕНТА ФАЙЛА:
+ *   INDEX: Номер файла
+ *   OFFSET: Смещение
+ *   LENGTH: Длина
+ *   return: 1 - записано
+ */
+static U8 TEST_WRITE(
+/* IN  */ const SIZE32 INDEX,
+/* IN  */ const SIZE32 OFFSET,
+/* IN  */ const SIZE32 LENGTH)
+{
+  FILE_NAME m_name;
+  TEST_NAME(INDEX, m_name);
+  RETURN_CODE m_rc = NO_ERROR;
+  FILE_ERROR m_fe = 0;
+  FILE_ID m_id;
+  FS_FILE_OPEN(m_name, FILE_MODE_READ_WRITE, &m_id, &m_rc, &m_fe);
+  if(NO_ERROR != m_rc)
+  {
+    return 0U;
+  }
+  FILE_POSITION m_position;
+  FS_FILE_SEEK(
+    m_id, (FILE_POSITION)OFFSET, FILE_SEEK_SET, &m_position, &m_rc, &m_fe
+  );
+  RETURN_CODE m_write_rc = m_rc;
+  if(NO_ERROR == m_rc)
+  {
+    FS_FILE_WRITE(m_id, LENGTH, &g_model[INDEX][OFFSET], &m_write_rc, &m_fe);
+  }
+  FS_FILE_CLOSE(m_id, &m_rc, &m_fe);
+  return (NO_ERROR == m_write_rc) && (NO_ERROR == m_rc);
+}
+
+/*
+ * СБОРКА ДАННЫХ ОТОБРАЖЕНИЯ:
+ *   INDEX: Номер файла
+ *   data: Данные частей по порядку
+ *   return: Суммарная длина частей
+ */
+static SIZE32 TEST_GATHER(
+/* IN  */ const SIZE32 INDEX,
+/* OUT */ U8 * data)
+{
+  SIZE32 m_length = 0U;
+  for(SIZE32 i = 0U; i < g_counts[INDEX]; i++)
+  {
+    const FILE_SEGMENT_TYPE * M_SEGMENT = &g_segments[INDEX][i];
+    if(m_length + M_SEGMENT->length > TEST_FILE_SIZE)
+    {
+      return TEST_FILE_SIZE + 1U;
+    }
+    STD_MEMCPY(M_SEGMENT->length, (VOID_PTR)M_SEGMENT->data, data + m_length);
+    m_length += M_SEGMENT->length;
+  }
+  return m_length;
+}
+
+int main(int argc, char ** argv)
+{
+  TEST_BEGIN(argc, argv);
+  U32 m_seed = 0x1B873593U;
+
+  RETURN_CODE m_rc = NO_ERROR;
+  FILE_ERROR m_fe = 0;
+  TEST_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+
+  /* 1. Исходные файлы */
+  for(SIZE32 f = 0U; f < TEST_FILES_COUNT; f++)
+  {
+    for(SIZE32 i = 0U; i < TEST_FILE_SIZE; i++)
+    {
+      g_model[f][i] = (U8)TEST_RANDOM(&m_seed);
+    }
+    FILE_NAME m_name;
+    TEST_NAME(f, m_name);
+    FS_FILE_CREATE(m_name, &m_rc, &m_fe);
+    TEST_CHECK(NO_ERROR == m_rc);
+    TEST_CHECK(TEST_WRITE(f, 0U, TEST_FILE_SIZE));
+  }
+
+  /* 2. Отображения файлов по одному между перезаписями: закрепленные
+   * блоки оказываются в разных секторах (отказ - только из-за резерва) */
+  SIZE32 m_refused = 0U;
+  SIZE32 m_failed_writes = 0U;
+  for(SIZE32 f = 0U; f < TEST_FILES_COUNT; f++)
+  {
+    FILE_NAME m_name;
+    TEST_NAME(f, m_name);
+    FILE_ID m_id;
+    FS_FILE_OPEN(m_name, FILE_MODE_READ_ONLY, &m_id, &m_rc, &m_fe);
+    TEST_CHECK(NO_ERROR == m_rc);
+    FS_FILE_MAP(
+      m_id, TEST_SEGMENTS_COUNT, g_segments[f], &g_counts[f], TEST_FILE_SIZE,
+      g_scratch[f], &m_rc, &m_fe
+    );
+    if(NO_ERROR != m_rc)
+    {
+      TEST_CHECK(FILE_ERROR_NO_SPACE == m_fe);
+      TEST_CHECK(0U == g_counts[f]);
+      m_refused++;
+    }
+    else
+    {
+      TEST_CHECK(TEST_FILE_SIZE == TEST_GATHER(f, g_mapped[f]));
+      TEST_CHECK(0 == memcmp(g_mapped[f], g_model[f], TEST_FILE_SIZE));
+    }
+    FS_FILE_CLOSE(m_id, &m_rc, &m_fe);
+
+    /* 3. Перезапись при удерживаемых отображениях */
+    for(SIZE32 n = 0U; n < TEST_OPERATIONS / TEST_FILES_COUNT; n++)
+    {
+      const SIZE32 M_FILE = TEST_RANDOM(&m_seed) % TEST_FILES_COUNT;
+      const SIZE32 M_LENGTH = 1U + TEST_RANDOM(&m_seed) % TEST_CHUNK_SIZE;
+      const SIZE32 M_OFFSET
+        = TEST_RANDOM(&m_seed) % (TEST_FILE_SIZE - M_LENGTH + 1U);
+      for(SIZE32 i = 0U; i < M_LENGTH; i++)
+      {
+        g_model[M_FILE][M_OFFSET + i] = (U8)TEST_RANDOM(&m_seed);
+      }
+      m_failed_writes += !TEST_WRITE(M_FILE, M_OFFSET, M_LENGTH);
+    }
+  }
+  TEST_CHECK(m_refused < TEST_FILES_COUNT);
+  TEST_CHECK(0U == m_failed_writes);
+
+  /* 4. Отображенные данные не изменились, отображения снимаются */
+  for(SIZE32 f = 0U; f < TEST_FILES_COUNT; f++)
+  {
+    if(0U == g_counts[f])
+    {
+      continue;
+    }
+    TEST_CHECK(TEST_FILE_SIZE == TEST_GATHER(f, g_buffer));
+    TEST_CHECK(0 == memcmp(g_buffer, g_mapped[f], TEST_FILE_SIZE));
+    FS_FILE_UNMAP(g_counts[f], g_segments[f], &m_rc, &m_fe);
+    TEST_CHECK(NO_ERROR == m_rc);
+  }
+
+  /* 5. Содержимое файлов после перезаписи */
+  for(SIZE32 f = 0U; f < TEST_FILES_COUNT; f++)
+  {
+    FILE_NAME m_name;
+    TEST_NAME(f, m_name);
+    FILE_ID m_id;
+    FS_FILE_OPEN(m_name, FILE_MODE_READ_ONLY, &m_id, &m_rc, &m_fe);
+    TEST_CHECK(NO_ERROR == m_rc);
+    SIZE32 m_length = 0U;
+    FS_FILE_READ(m_id, TEST_FILE_SIZE, &m_length, g_buffer, &m_rc, &m_fe);
+    TEST_CHECK(TEST_FILE_SIZE == m_length);
+    TEST_CHECK(0 == memcmp(g_buffer, g_model[f], TEST_FILE_SIZE));
+    FS_FILE_CLOSE(m_id, &m_rc, &m_fe);
+  }
+
+  TEST_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  return TEST_END("test_map");
+}
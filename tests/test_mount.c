@@ -0,0 +1,230 @@
+/*
+ * ПАРАЛЛЕЛЬНОЕ МОНТИРОВАНИЕ:
+ * образ состарен созданием, перезаписью и удалением файлов разного
+ * размера. Монтирование на 1, 2, ... доступных ядрах (маска привязки
+ * процесса) дает одно и то же содержимое FTL и файлов. Тест печатает
+ * время монтирования и ускорение относительно одного ядра
+ */
+/* sched_setaffinity */
+#define _GNU_SOURCE
+#include <sched.h>
+#include <time.h>
+
+#include "test.h"
+#include "fs_crypt.h"
+#include "fs_lock.h"
+
+#define TEST_FILES_COUNT 160U
+#define TEST_MAX_SIZE 3000U
+#define TEST_ROUNDS 3U
+#define TEST_MOUNTS_COUNT 20U
+#define TEST_BLOCKS_COUNT 3968U
+#define TEST_BLOCK_SIZE 250U
+#define TEST_MAX_CORES 8U
+
+static U8 g_data[TEST_FILES_COUNT][TEST_MAX_SIZE];
+static SIZE32 g_sizes[TEST_FILES_COUNT];
+static U8 g_present[TEST_FILES_COUNT];
+
+/*
+ * ЗАПИСЬ ФАЙЛА ЦЕЛИКОМ (файл создается при необходимости):
+ *   INDEX: Номер файла
+ *   SIZE: Размер
+ *   seed: Состояние генератора данных
+ *   return: 1 - успешно
+ */
+static U8 TEST_WRITE(
+/* IN    */ const SIZE32 INDEX,
+/* IN    */ const SIZE32 SIZE,
+/* INOUT */ U32 * seed)
+{
+  FILE_NAME m_name;
+  TEST_NAME(INDEX, m_name);
+  RETURN_CODE m_rc = NO_ERROR;
+  FILE_ERROR m_fe = 0;
+  if(!g_present[INDEX])
+  {
+    FS_FILE_CREATE(m_name, &m_rc, &m_fe);
+    if(NO_ERROR != m_rc)
+    {
+      return 0U;
+    }
+    g_present[INDEX] = 1U;
+  }
+  for(SIZE32 i = 0U; i < SIZE; i++)
+  {
+    g_data[INDEX][i] = (0U == INDEX % 2U)
+      ? (U8)TEST_RANDOM(seed) : (U8)(INDEX + i / 64U);
+  }
+  FILE_ID m_id;
+  FS_FILE_OPEN(m_name, FILE_MODE_READ_WRITE, &m_id, &m_rc, &m_fe);
+  if(NO_ERROR != m_rc)
+  {
+    return 0U;
+  }
+  RETURN_CODE m_write_rc = NO_ERROR;
+  if(SIZE < g_sizes[INDEX])
+  {
+    FS_FILE_TRUNCATE(m_id, 0U, &m_write_rc, &m_fe);
+  }
+  FILE_POSITION m_position;
+  FS_FILE_SEEK(m_id, 0, FILE_SEEK_SET, &m_position, &m_rc, &m_fe);
+  if(NO_ERROR == m_write_rc)
+  {
+    FS_FILE_WRITE(m_id, SIZE, g_data[INDEX], &m_write_rc, &m_fe);
+  }
+  FS_FILE_CLOSE(m_id, &m_rc, &m_fe);
+  g_sizes[INDEX] = SIZE;
+  return (NO_ERROR == m_write_rc) && (NO_ERROR == m_rc);
+}
+
+/*
+ * СВЕРКА ФАЙЛОВ:
+ *   return: Количество несовпадений
+ */
+static SIZE32 TEST_VERIFY(void)
+{
+  SIZE32 m_mismatches = 0U;
+  for(SIZE32 f = 0U; f < TEST_FILES_COUNT; f++)
+  {
+    FILE_NAME m_name;
+    TEST_NAME(f, m_name);
+    RETURN_CODE m_rc = NO_ERROR;
+    FILE_ERROR m_fe = 0;
+    FILE_ID m_id;
+    FS_FILE_OPEN(m_name, FILE_MODE_READ_ONLY, &m_id, &m_rc, &m_fe);
+    if(!g_present[f])
+    {
+      m_mismatches += (NO_ERROR == m_rc);
+      continue;
+    }
+    static U8 s_read[TEST_MAX_SIZE + 1U];
+    SIZE32 m_length = 0U;
+    FS_FILE_READ(m_id, sizeof(s_read), &m_length, s_read, &m_rc, &m_fe);
+    m_mismatches += (g_sizes[f] != m_length)
+      || (0 != memcmp(s_read, g_data[f], g_sizes[f]));
+    FS_FILE_CLOSE(m_id, &m_rc, &m_fe);
+  }
+  return m_mismatches;
+}
+
+/*
+ * ОТПЕЧАТОК СОДЕРЖИМОГО FTL (CRC32 логических блоков по порядку):
+ *   return: Отпечаток
+ */
+static U32 TEST_FTL_HASH(void)
+{
+  U32 m_hash = 0U;
+  for(FTL_INDEX m_lbi = 0U; m_lbi < TEST_BLOCKS_COUNT; m_lbi++)
+  {
+    U8 m_block[TEST_BLOCK_SIZE] __attribute__((aligned(4)));
+    RETURN_CODE m_rc = NO_ERROR;
+    FTL_READ(m_lbi, 1U, m_block, &m_rc);
+    U32 m_crc = 0U;
+    if(NO_ERROR == m_rc)
+    {
+      HASH_CRC(m_block, TEST_BLOCK_SIZE, &m_crc);
+    }
+    m_hash = (m_hash * 31U) ^ m_crc ^ (U32)m_rc;
+  }
+  return m_hash;
+}
+
+/*
+ * ВРЕМЯ (монотонные часы):
+ *   return: Секунды
+ */
+static double TEST_NOW(void)
+{
+  struct timespec m_time;
+  clock_gettime(CLOCK_MONOTONIC, &m_time);
+  return (double)m_time.tv_sec + 1e-9 * (double)m_time.tv_nsec;
+}
+
+int main(int argc, char ** argv)
+{
+  TEST_BEGIN(argc, argv);
+  U32 m_seed = 0x68E31DA4U;
+  RETURN_CODE m_rc = NO_ERROR;
+  TEST_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+
+  /* 1. Старение образа: файлы перезаписываются, часть удаляется */
+  SIZE32 m_failures = 0U;
+  for(U32 r = 0U; r < TEST_ROUNDS; r++)
+  {
+    for(SIZE32 f = 0U; f < TEST_FILES_COUNT; f++)
+    {
+      m_failures += !TEST_WRITE(f,
+        1U + TEST_RANDOM(&m_seed) % TEST_MAX_SIZE, &m_seed);
+    }
+  }
+  for(SIZE32 f = 0U; f < TEST_FILES_COUNT; f += 5U)
+  {
+    FILE_NAME m_name;
+    TEST_NAME(f, m_name);
+    FILE_ERROR m_fe = 0;
+    FS_FILE_REMOVE(m_name, &m_rc, &m_fe);
+    m_failures += (NO_ERROR != m_rc);
+    g_present[f] = 0U;
+  }
+  TEST_CHECK(0U == m_failures);
+  TEST_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+
+  /* 2. Монтирование на 1, 2, ... ядрах: содержимое совпадает */
+  cpu_set_t m_all;
+  TEST_CHECK(0 == sched_getaffinity(0, sizeof(m_all), &m_all));
+  SIZE32 m_cpus[TEST_MAX_CORES];
+  SIZE32 m_cores = 0U;
+  for(SIZE32 c = 0U; (c < CPU_SETSIZE) && (m_cores < TEST_MAX_CORES); c++)
+  {
+    if(CPU_ISSET(c, &m_all))
+    {
+      m_cpus[m_cores++] = c;
+    }
+  }
+  U32 m_hash = 0U;
+  double m_serial = 0.0;
+  for(SIZE32 k = 1U; k <= m_cores; k++)
+  {
+    cpu_set_t m_set;
+    CPU_ZERO(&m_set);
+    for(SIZE32 c = 0U; c < k; c++)
+    {
+      CPU_SET(m_cpus[c], &m_set);
+    }
+    TEST_CHECK(0 == sched_setaffinity(0, sizeof(m_set), &m_set));
+    TEST_CHECK(!FS_THREAD_SAFE || (k == FS_CPU_COUNT()));
+
+    TEST_MOUNT(&m_rc);
+    TEST_CHECK(NO_ERROR == m_rc);
+    const U32 M_HASH = TEST_FTL_HASH();
+    TEST_CHECK((1U == k) || (m_hash == M_HASH));
+    m_hash = M_HASH;
+    TEST_CHECK(0U == TEST_VERIFY());
+    TEST_UNMOUNT(&m_rc);
+    TEST_CHECK(NO_ERROR == m_rc);
+
+    /* 3. Время монтирования (FTL и таблицы ФС) */
+    double m_total = 0.0;
+    for(SIZE32 m = 0U; m < TEST_MOUNTS_COUNT; m++)
+    {
+      const double M_START = TEST_NOW();
+      TEST_MOUNT(&m_rc);
+      m_total += TEST_NOW() - M_START;
+      TEST_CHECK(NO_ERROR == m_rc);
+      TEST_UNMOUNT(&m_rc);
+    }
+    const double M_MOUNT = m_total / TEST_MOUNTS_COUNT;
+    if(1U == k)
+    {
+      m_serial = M_MOUNT;
+    }
+    printf("test_mount: %u core(s): mount %.3f ms, speedup %.2f\n",
+      k, 1e3 * M_MOUNT, m_serial / M_MOUNT);
+  }
+  TEST_CHECK(0 == sched_setaffinity(0, sizeof(m_all), &m_all));
+
+  return TEST_END("test_mount");
+}
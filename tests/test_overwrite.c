@@ -0,0 +1,147 @@
+/*
+ * СЛУЧАЙНАЯ ПЕРЕЗАПИСЬ С ПЕРЕПОДКЛЮЧЕНИЕМ:
+ * 24 файла (около 200 КБ несжимаемых данных) перезаписываются случайными
+ * фрагментами. Перезапись многократно превышает объем flash: сборщик
+ * мусора должен освобождать место, не расходуя свой резерв на запись.
+ * Содержимое сверяется с копией в ОЗУ после каждого переподключения
+ */
+#include "test.h"
+
+#define TEST_FILES_COUNT 24U
+#define TEST_FILE_SIZE 8500U
+#define TEST_OPERATIONS 3000U
+#define TEST_REMOUNT_PERIOD 1000U
+#define TEST_CHUNK_SIZE 2000U
+
+static U8 g_model[TEST_FILES_COUNT][TEST_FILE_SIZE];
+static U8 g_buffer[TEST_FILE_SIZE];
+
+/*
+ * ЗАПИСЬ ФРАГМЕНТА ФАЙЛА:
+ *   INDEX: Номер файла
+ *   OFFSET: Смещение
+ *   LENGTH: Длина
+ *   return: 1 - записано
+ */
+static U8 TEST_WRITE(
+/* IN  */ const SIZE32 INDEX,
+/* IN  */ const SIZE32 OFFSET,
+/* IN  */ const SIZE32 LENGTH)
+{
+  FILE_NAME m_name;
+  TEST_NAME(INDEX, m_name);
+  RETURN_CODE m_rc = NO_ERROR;
+  FILE_ERROR m_fe = 0;
+  FILE_ID m_id;
+  FS_FILE_OPEN(m_name, FILE_MODE_READ_WRITE, &m_id, &m_rc, &m_fe);
+  if(NO_ERROR != m_rc)
+  {
+    return 0U;
+  }
+  FILE_POSITION m_position;
+  FS_FILE_SEEK(
+    m_id, (FILE_POSITION)OFFSET, FILE_SEEK_SET, &m_position, &m_rc, &m_fe
+  );
+  RETURN_CODE m_write_rc = m_rc;
+  if(NO_ERROR == m_rc)
+  {
+    FS_FILE_WRITE(m_id, LENGTH, &g_model[INDEX][OFFSET], &m_write_rc, &m_fe);
+  }
+  FS_FILE_CLOSE(m_id, &m_rc, &m_fe);
+  return (NO_ERROR == m_write_rc) && (NO_ERROR == m_rc);
+}
+
+/*
+ * СВЕРКА ВСЕХ ФАЙЛОВ С КОПИЕЙ В ОЗУ:
+ *   return: Количество расхождений
+ */
+static SIZE32 TEST_VERIFY(void)
+{
+  SIZE32 m_mismatches = 0U;
+  for(SIZE32 f = 0U; f < TEST_FILES_COUNT; f++)
+  {
+    FILE_NAME m_name;
+    TEST_NAME(f, m_name);
+    RETURN_CODE m_rc = NO_ERROR;
+    FILE_ERROR m_fe = 0;
+    FILE_ID m_id;
+    FS_FILE_OPEN(m_name, FILE_MODE_READ_ONLY, &m_id, &m_rc, &m_fe);
+    if(NO_ERROR != m_rc)
+    {
+      m_mismatches++;
+      continue;
+    }
+    SIZE32 m_length = 0U;
+    FS_FILE_READ(m_id, TEST_FILE_SIZE, &m_length, g_buffer, &m_rc, &m_fe);
+    if((TEST_FILE_SIZE != m_length)
+    || (0 != memcmp(g_buffer, g_model[f], TEST_FILE_SIZE)))
+    {
+      m_mismatches++;
+    }
+    FS_FILE_CLOSE(m_id, &m_rc, &m_fe);
+  }
+  return m_mismatches;
+}
+
+int main(int argc, char ** argv)
+{
+  TEST_BEGIN(argc, argv);
+  U32 m_seed = 0x2545F491U;
+
+  RETURN_CODE m_rc = NO_ERROR;
+  FILE_ERROR m_fe = 0;
+  TEST_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+
+  /* 1. Исходные файлы */
+  for(SIZE32 f = 0U; f < TEST_FILES_COUNT; f++)
+  {
+    for(SIZE32 i = 0U; i < TEST_FILE_SIZE; i++)
+    {
+      g_model[f][i] = (U8)TEST_RANDOM(&m_seed);
+    }
+    FILE_NAME m_name;
+    TEST_NAME(f, m_name);
+    FS_FILE_CREATE(m_name, &m_rc, &m_fe);
+    TEST_CHECK(NO_ERROR == m_rc);
+    TEST_CHECK(TEST_WRITE(f, 0U, TEST_FILE_SIZE));
+  }
+
+  /* 2. Случайная перезапись */
+  SIZE32 m_failed_writes = 0U;
+  for(SIZE32 n = 1U; n <= TEST_OPERATIONS; n++)
+  {
+    const SIZE32 M_FILE = TEST_RANDOM(&m_seed) % TEST_FILES_COUNT;
+    const SIZE32 M_LENGTH = 1U + TEST_RANDOM(&m_seed) % TEST_CHUNK_SIZE;
+    const SIZE32 M_OFFSET
+      = TEST_RANDOM(&m_seed) % (TEST_FILE_SIZE - M_LENGTH + 1U);
+    for(SIZE32 i = 0U; i < M_LENGTH; i++)
+    {
+      g_model[M_FILE][M_OFFSET + i] = (U8)TEST_RANDOM(&m_seed);
+    }
+    if(!TEST_WRITE(M_FILE, M_OFFSET, M_LENGTH))
+    {
+      m_failed_writes++;
+    }
+
+    if(0U == n % TEST_REMOUNT_PERIOD)
+    {
+      TEST_UNMOUNT(&m_rc);
+      TEST_CHECK(NO_ERROR == m_rc);
+      TEST_MOUNT(&m_rc);
+      TEST_CHECK(NO_ERROR == m_rc);
+      TEST_CHECK(0U == TEST_VERIFY());
+    }
+  }
+  TEST_CHECK(0U == m_failed_writes);
+
+  /* 3. Сборка мусора возвращает резерв */
+  FTL_STATS_TYPE m_stats;
+  FTL_STATS(&m_stats, &m_rc);
+  TEST_CHECK(m_stats.gc.erases > 0U);
+  TEST_CHECK(0U == TEST_VERIFY());
+
+  TEST_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  return TEST_END("test_overwrite");
+}
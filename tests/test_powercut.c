@@ -0,0 +1,226 @@
+/*
+ * ОТКЛЮЧЕНИЕ ПИТАНИЯ ВО ВРЕМЯ ЗАПИСИ:
+ * дочерний процесс перезаписывает логические блоки (сжимаемые и
+ * несжимаемые), питание отключается на случайной операции flash.
+ * После переподключения каждый блок должен содержать свою последнюю
+ * версию на момент отключения: состояние совпадает с некоторым префиксом
+ * последовательности записей. Отдельно проверяется, что копии устаревших
+ * блоков, перенесенные сборщиком мусора ради снимка, не становятся
+ * актуальными после сбоя
+ */
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "test.h"
+
+#define TEST_DATA_SIZE 250U
+#define TEST_BLOCKS_COUNT 96U
+#define TEST_OPERATIONS 10000U
+#define TEST_CUTS_COUNT 16U
+#define TEST_CUT_RANGE 24000U
+
+static FTL_INDEX g_ops[TEST_OPERATIONS + 1U];
+static U32 g_model[TEST_BLOCKS_COUNT];
+static U32 g_read[TEST_BLOCKS_COUNT];
+
+/*
+ * ВЕРСИЯ ЛОГИЧЕСКОГО БЛОКА:
+ *   LBI: Номер логического блока
+ *   VERSION: Номер версии (номер записи в последовательности)
+ *   data: Данные блока (четные блоки не сжимаются, нечетные сжимаются)
+ */
+static void TEST_BLOCK(
+/* IN  */ const FTL_INDEX LBI,
+/* IN  */ const U32 VERSION,
+/* OUT */ U8 * data)
+{
+  U32 m_seed = LBI * 7919U + VERSION + 1U;
+  for(SIZE32 i = 0U; i < TEST_DATA_SIZE; i++)
+  {
+    data[i] = (0U == LBI % 2U) ? (U8)TEST_RANDOM(&m_seed) : (U8)VERSION;
+  }
+  STD_MEMCPY(sizeof(U32), (VOID_PTR)&VERSION, data);
+  data[4U] = (U8)LBI;
+}
+
+/*
+ * ЧИСТЫЙ ОБРАЗ (заголовок flash-драйвера пишет FTL_FREE):
+ *   return_code: Статус FTL_FREE
+ */
+static void TEST_FORMAT(
+/* OUT */ RETURN_CODE * return_code)
+{
+  remove(g_test_image);
+  TEST_FTL_MOUNT(return_code);
+  if(NO_ERROR != *return_code)
+  {
+    return;
+  }
+  TEST_FTL_UNMOUNT(return_code);
+}
+
+/*
+ * ЗАПИСЬ ВЕРСИИ БЛОКА:
+ *   VERSION: Номер записи (блок - g_ops[VERSION])
+ *   return: 1 - записано
+ */
+static U8 TEST_WRITE(
+/* IN  */ const U32 VERSION)
+{
+  U8 m_data[TEST_DATA_SIZE] __attribute__((aligned(4)));
+  TEST_BLOCK(g_ops[VERSION], VERSION, m_data);
+  RETURN_CODE m_rc = NO_ERROR;
+  FTL_WRITE(g_ops[VERSION], 1U, m_data, &m_rc);
+  return NO_ERROR == m_rc;
+}
+
+/*
+ * ЧТЕНИЕ ВЕРСИЙ ВСЕХ БЛОКОВ В g_read:
+ *   return: Количество блоков с данными, не совпадающими ни с одной
+ *           записанной версией
+ */
+static SIZE32 TEST_READ(void)
+{
+  SIZE32 m_corrupted = 0U;
+  for(FTL_INDEX m_lbi = 0U; m_lbi < TEST_BLOCKS_COUNT; m_lbi++)
+  {
+    U8 m_data[TEST_DATA_SIZE] __attribute__((aligned(4)));
+    U8 m_expected[TEST_DATA_SIZE];
+    RETURN_CODE m_rc = NO_ERROR;
+    FTL_READ(m_lbi, 1U, m_data, &m_rc);
+    g_read[m_lbi] = 0U;
+    if(NO_ACTION == m_rc)
+    {
+      continue;
+    }
+    STD_MEMCPY(sizeof(U32), m_data, &g_read[m_lbi]);
+    if((NO_ERROR != m_rc) || (g_read[m_lbi] > TEST_OPERATIONS)
+    || (0U == g_read[m_lbi]) || (m_lbi != g_ops[g_read[m_lbi]]))
+    {
+      m_corrupted++;
+      continue;
+    }
+    TEST_BLOCK(m_lbi, g_read[m_lbi], m_expected);
+    if(0 != memcmp(m_data, m_expected, TEST_DATA_SIZE))
+    {
+      m_corrupted++;
+    }
+  }
+  return m_corrupted;
+}
+
+/*
+ * ПРОВЕРКА ПРЕФИКСА:
+ *   return: 1 - версии g_read совпадают с состоянием после некоторого
+ *           количества первых записей
+ */
+static U8 TEST_PREFIX(void)
+{
+  SIZE32 m_mismatches = 0U;
+  for(FTL_INDEX m_lbi = 0U; m_lbi < TEST_BLOCKS_COUNT; m_lbi++)
+  {
+    g_model[m_lbi] = 0U;
+    m_mismatches += (0U != g_read[m_lbi]);
+  }
+  for(U32 k = 1U; (0U != m_mismatches) && (k <= TEST_OPERATIONS); k++)
+  {
+    const FTL_INDEX M_LBI = g_ops[k];
+    m_mismatches -= (g_model[M_LBI] != g_read[M_LBI]);
+    g_model[M_LBI] = k;
+    m_mismatches += (g_model[M_LBI] != g_read[M_LBI]);
+  }
+  return 0U == m_mismatches;
+}
+
+/*
+ * ЗАПИСЬ В ДОЧЕРНЕМ ПРОЦЕССЕ ДО ОТКЛЮЧЕНИЯ ПИТАНИЯ (FTL_FREE не вызывается):
+ *   CUT: Операция flash, на которой отключается питание (0 - без отключения)
+ *   SNAPSHOT: 1 - после первого прохода создать снимок и в конце собрать
+ *             мусор (устаревшие блоки снимка переносятся)
+ */
+static void TEST_CHILD(
+/* IN  */ const SIZE32 CUT,
+/* IN  */ const U8 SNAPSHOT)
+{
+  const pid_t M_PID = fork();
+  if(0 == M_PID)
+  {
+    RETURN_CODE m_rc = NO_ERROR;
+    TEST_FTL_MOUNT(&m_rc);
+    EMULATOR_POWER_CUT(CUT);
+    for(U32 k = 1U; (k <= TEST_OPERATIONS) && !g_emulator->power_off; k++)
+    {
+      if(SNAPSHOT && (TEST_BLOCKS_COUNT + 1U == k))
+      {
+        FTL_SNAPSHOT_ID m_id;
+        FTL_SNAPSHOT_CREATE(&m_id, &m_rc);
+      }
+      if(!TEST_WRITE(k))
+      {
+        break;
+      }
+      if(SNAPSHOT && (2U * TEST_BLOCKS_COUNT == k))
+      {
+        FTL_GARBAGE_COLLECT(&m_rc);
+        break;
+      }
+    }
+    _exit(0);
+  }
+  int m_status = 0;
+  waitpid(M_PID, &m_status, 0);
+}
+
+int main(int argc, char ** argv)
+{
+  TEST_BEGIN(argc, argv);
+  U32 m_seed = 0x6C078965U;
+  for(U32 k = 1U; k <= TEST_OPERATIONS; k++)
+  {
+    g_ops[k] = TEST_RANDOM(&m_seed) % TEST_BLOCKS_COUNT;
+  }
+
+  /* 1. Отключение питания на случайной операции */
+  RETURN_CODE m_rc = NO_ERROR;
+  for(SIZE32 c = 0U; c < TEST_CUTS_COUNT; c++)
+  {
+    const SIZE32 M_CUT = 1U + TEST_RANDOM(&m_seed) % TEST_CUT_RANGE;
+    TEST_FORMAT(&m_rc);
+    TEST_CHECK(NO_ERROR == m_rc);
+    TEST_CHILD(M_CUT, 0U);
+
+    TEST_FTL_MOUNT(&m_rc);
+    TEST_CHECK(NO_ERROR == m_rc);
+    TEST_CHECK(0U == TEST_READ());
+    TEST_CHECK(TEST_PREFIX());
+
+    /* Восстановленный том пригоден для записи */
+    for(U32 k = 1U; k <= TEST_BLOCKS_COUNT; k++)
+    {
+      TEST_CHECK(TEST_WRITE(k));
+    }
+    TEST_FTL_UNMOUNT(&m_rc);
+    TEST_CHECK(NO_ERROR == m_rc);
+  }
+
+  /* 2. Перенесенные копии устаревших блоков снимка не актуальны */
+  TEST_FORMAT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_CHILD(0U, 1U);
+  TEST_FTL_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_CHECK(0U == TEST_READ());
+  for(FTL_INDEX m_lbi = 0U; m_lbi < TEST_BLOCKS_COUNT; m_lbi++)
+  {
+    g_model[m_lbi] = 0U;
+  }
+  for(U32 k = 1U; k <= 2U * TEST_BLOCKS_COUNT; k++)
+  {
+    g_model[g_ops[k]] = k;
+  }
+  TEST_CHECK(0 == memcmp(g_model, g_read, sizeof(g_model)));
+  TEST_FTL_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+
+  return TEST_END("test_powercut");
+}
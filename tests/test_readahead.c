@@ -0,0 +1,173 @@
+/*
+ * УПРЕЖДАЮЩЕЕ ЧТЕНИЕ:
+ * последовательное чтение файла по блокам идет через окно: окно растет,
+ * большая часть блоков берется из окна. Переход назад сбрасывает окно,
+ * файл, открытый на запись, читается без упреждения. Окон в пуле меньше,
+ * чем читающих дескрипторов, и цепочки двух файлов перемежаются: данные
+ * при этом читаются верно
+ */
+#include "test.h"
+
+#define TEST_DATA_SIZE 248U
+#define TEST_BLOCKS_COUNT 48U
+#define TEST_FILE_SIZE (TEST_BLOCKS_COUNT * TEST_DATA_SIZE)
+#define TEST_READERS_COUNT 12U
+
+static U8 g_data[2U][TEST_FILE_SIZE];
+static U8 g_read[TEST_FILE_SIZE];
+
+/*
+ * ЧТЕНИЕ ФАЙЛА ПО БЛОКАМ:
+ *   ID: Дескриптор файла
+ *   INDEX: Номер файла (g_data)
+ *   status: Статус файла после чтения
+ *   return: Количество несовпавших блоков
+ */
+static SIZE32 TEST_READ_BLOCKS(
+/* IN  */ const FILE_ID ID,
+/* IN  */ const SIZE32 INDEX,
+/* OUT */ FILE_STATUS_TYPE * status)
+{
+  SIZE32 m_mismatches = 0U;
+  for(SIZE32 b = 0U; b < TEST_BLOCKS_COUNT; b++)
+  {
+    RETURN_CODE m_rc = NO_ERROR;
+    FILE_ERROR m_fe = 0;
+    SIZE32 m_length = 0U;
+    FS_FILE_READ(ID, TEST_DATA_SIZE, &m_length, g_read, &m_rc, &m_fe);
+    m_mismatches += (NO_ERROR != m_rc) || (TEST_DATA_SIZE != m_length)
+      || (0 != memcmp(g_read, &g_data[INDEX][b * TEST_DATA_SIZE],
+                      TEST_DATA_SIZE));
+  }
+  RETURN_CODE m_rc = NO_ERROR;
+  FILE_ERROR m_fe = 0;
+  FS_FILE_STATUS(ID, status, &m_rc, &m_fe);
+  return m_mismatches + (NO_ERROR != m_rc);
+}
+
+int main(int argc, char ** argv)
+{
+  TEST_BEGIN(argc, argv);
+  U32 m_seed = 0x2545F491U;
+  for(SIZE32 f = 0U; f < 2U; f++)
+  {
+    for(SIZE32 i = 0U; i < TEST_FILE_SIZE; i++)
+    {
+      g_data[f][i] = (U8)TEST_RANDOM(&m_seed);
+    }
+  }
+
+  RETURN_CODE m_rc = NO_ERROR;
+  FILE_ERROR m_fe = 0;
+  TEST_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+
+  /* 1. Файл 0 записывается целиком, файл 1 - по блоку вперемежку
+   * с файлом 2 (цепочки файлов 1 и 2 перемежаются) */
+  FILE_NAME m_names[3U];
+  FILE_ID m_ids[3U];
+  for(SIZE32 f = 0U; f < 3U; f++)
+  {
+    TEST_NAME(f, m_names[f]);
+    FS_FILE_CREATE(m_names[f], &m_rc, &m_fe);
+    TEST_CHECK(NO_ERROR == m_rc);
+    FS_FILE_OPEN(m_names[f], FILE_MODE_READ_WRITE, &m_ids[f], &m_rc, &m_fe);
+    TEST_CHECK(NO_ERROR == m_rc);
+  }
+  FS_FILE_WRITE(m_ids[0U], TEST_FILE_SIZE, g_data[0U], &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+  for(SIZE32 b = 0U; b < TEST_BLOCKS_COUNT; b++)
+  {
+    for(SIZE32 f = 1U; f < 3U; f++)
+    {
+      FS_FILE_WRITE(m_ids[f], TEST_DATA_SIZE,
+        &g_data[1U][b * TEST_DATA_SIZE], &m_rc, &m_fe);
+      TEST_CHECK(NO_ERROR == m_rc);
+      FS_FILE_SYNC(m_ids[f], &m_rc, &m_fe);
+      TEST_CHECK(NO_ERROR == m_rc);
+    }
+  }
+
+  /* 2. Файл, открытый на запись, читается без упреждения */
+  FILE_POSITION m_position;
+  FS_FILE_SEEK(m_ids[0U], 0, FILE_SEEK_SET, &m_position, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+  FILE_STATUS_TYPE m_status;
+  TEST_CHECK(0U == TEST_READ_BLOCKS(m_ids[0U], 0U, &m_status));
+  TEST_CHECK(0U == m_status.readahead.hits);
+  TEST_CHECK(0U == m_status.readahead.window);
+  for(SIZE32 f = 0U; f < 3U; f++)
+  {
+    FS_FILE_CLOSE(m_ids[f], &m_rc, &m_fe);
+    TEST_CHECK(NO_ERROR == m_rc);
+  }
+
+  /* 3. Последовательное чтение: окно растет, блоки берутся из окна */
+  TEST_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  FS_FILE_OPEN(m_names[0U], FILE_MODE_READ_ONLY, &m_ids[0U], &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_CHECK(0U == TEST_READ_BLOCKS(m_ids[0U], 0U, &m_status));
+  TEST_CHECK(TEST_BLOCKS_COUNT
+    == m_status.readahead.hits + m_status.readahead.misses);
+  TEST_CHECK(m_status.readahead.hits > 2U * m_status.readahead.misses);
+  TEST_CHECK(m_status.readahead.window > 1U);
+
+  /* 4. Переход назад сбрасывает окно, чтение продолжается верно */
+  FS_FILE_SEEK(m_ids[0U], (FILE_POSITION)(TEST_FILE_SIZE / 2U),
+    FILE_SEEK_SET, &m_position, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+  SIZE32 m_length = 0U;
+  FS_FILE_READ(m_ids[0U], TEST_DATA_SIZE, &m_length, g_read, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_CHECK(0 == memcmp(
+    g_read, &g_data[0U][TEST_FILE_SIZE / 2U], TEST_DATA_SIZE));
+  FS_FILE_STATUS(m_ids[0U], &m_status, &m_rc, &m_fe);
+  TEST_CHECK(0U == m_status.readahead.window);
+  FS_FILE_CLOSE(m_ids[0U], &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+
+  /* 5. Перемежающаяся цепочка: окно не содержит чужих блоков */
+  FS_FILE_OPEN(m_names[1U], FILE_MODE_READ_ONLY, &m_ids[1U], &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_CHECK(0U == TEST_READ_BLOCKS(m_ids[1U], 1U, &m_status));
+  FS_FILE_CLOSE(m_ids[1U], &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+
+  /* 6. Читающих дескрипторов больше, чем окон: чтение по блоку каждым */
+  FILE_ID m_readers[TEST_READERS_COUNT];
+  for(SIZE32 r = 0U; r < TEST_READERS_COUNT; r++)
+  {
+    FS_FILE_OPEN(m_names[0U], FILE_MODE_READ_ONLY, &m_readers[r],
+      &m_rc, &m_fe);
+    TEST_CHECK(NO_ERROR == m_rc);
+  }
+  SIZE32 m_mismatches = 0U;
+  for(SIZE32 b = 0U; b < TEST_BLOCKS_COUNT; b++)
+  {
+    for(SIZE32 r = 0U; r < TEST_READERS_COUNT; r++)
+    {
+      FS_FILE_READ(m_readers[r], TEST_DATA_SIZE, &m_length, g_read,
+        &m_rc, &m_fe);
+      m_mismatches += (NO_ERROR != m_rc) || (TEST_DATA_SIZE != m_length)
+        || (0 != memcmp(g_read, &g_data[0U][b * TEST_DATA_SIZE],
+                        TEST_DATA_SIZE));
+    }
+  }
+  TEST_CHECK(0U == m_mismatches);
+  SIZE32 m_windows = 0U;
+  for(SIZE32 r = 0U; r < TEST_READERS_COUNT; r++)
+  {
+    FS_FILE_STATUS(m_readers[r], &m_status, &m_rc, &m_fe);
+    m_windows += (0U != m_status.readahead.hits);
+    FS_FILE_CLOSE(m_readers[r], &m_rc, &m_fe);
+    TEST_CHECK(NO_ERROR == m_rc);
+  }
+  TEST_CHECK((0U != m_windows) && (m_windows < TEST_READERS_COUNT));
+
+  TEST_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  return TEST_END("test_readahead");
+}
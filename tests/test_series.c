@@ -0,0 +1,247 @@
+/*
+ * ВРЕМЕННЫЕ РЯДЫ:
+ * ряд записей постоянного размера (разностное кодирование) и ряд записей
+ * переменного размера с повторяющимися метками времени. Чтение диапазонов
+ * [FROM, TO] после FS_SERIES_SEEK должно давать ровно записи диапазона по
+ * порядку, в том числе после переподключения и после отбрасывания начала
+ * ряда. Запись с меньшим временем отклоняется
+ */
+#include "test.h"
+
+#define TEST_RECORDS_COUNT 3000U
+#define TEST_RANGES_COUNT 64U
+#define TEST_FIXED_SIZE 8U
+#define TEST_VARIABLE_MAX 24U
+
+/*
+ * ДАННЫЕ ЗАПИСИ:
+ *   SERIES: 0 - записи постоянного размера, 1 - переменного
+ *   INDEX: Номер записи
+ *   time: Метка времени
+ *   data: Данные
+ *   return: Длина записи
+ */
+static SIZE32 TEST_RECORD(
+/* IN  */ const SIZE32 SERIES,
+/* IN  */ const U32 INDEX,
+/* OUT */ U32 * time,
+/* OUT */ U8 * data)
+{
+  if(0U == SERIES)
+  {
+    /* Медленно меняющиеся значения */
+    const U32 M_VALUES[2U] = { INDEX, INDEX / 16U };
+    *time = INDEX * 3U;
+    STD_MEMCPY(TEST_FIXED_SIZE, (VOID_PTR)M_VALUES, data);
+    return TEST_FIXED_SIZE;
+  }
+  const SIZE32 M_LENGTH = sizeof(U32) + INDEX % (TEST_VARIABLE_MAX - 3U);
+  *time = INDEX / 2U;
+  for(SIZE32 i = 0U; i < M_LENGTH; i++)
+  {
+    data[i] = (U8)(INDEX * 31U + i);
+  }
+  STD_MEMCPY(sizeof(U32), (VOID_PTR)&INDEX, data);
+  return M_LENGTH;
+}
+
+/*
+ * ПРОВЕРКА ДИАПАЗОНА:
+ *   SERIES: Номер ряда
+ *   ID: Дескриптор ряда
+ *   FIRST: Первая существующая запись ряда
+ *   FROM, TO: Диапазон времени
+ *   return: 1 - прочитаны ровно записи диапазона
+ */
+static U8 TEST_RANGE(
+/* IN  */ const SIZE32 SERIES,
+/* IN  */ const FILE_ID ID,
+/* IN  */ const U32 FIRST,
+/* IN  */ const U32 FROM,
+/* IN  */ const U32 TO)
+{
+  RETURN_CODE m_rc = NO_ERROR;
+  FILE_ERROR m_fe = 0;
+  FS_SERIES_SEEK(ID, FROM, &m_rc, &m_fe);
+  if(NO_ERROR != m_rc)
+  {
+    return 0U;
+  }
+  for(U32 k = FIRST; k < TEST_RECORDS_COUNT; k++)
+  {
+    U32 m_expected_time = 0U;
+    U8 m_expected[TEST_VARIABLE_MAX];
+    const SIZE32 M_LENGTH
+      = TEST_RECORD(SERIES, k, &m_expected_time, m_expected);
+    if(m_expected_time < FROM)
+    {
+      continue;
+    }
+    if(m_expected_time > TO)
+    {
+      break;
+    }
+    U32 m_time = 0U;
+    U8 m_data[TEST_VARIABLE_MAX];
+    SIZE32 m_length = 0U;
+    FS_SERIES_READ(
+      ID, TO, TEST_VARIABLE_MAX, &m_time, m_data, &m_length, &m_rc, &m_fe
+    );
+    if((NO_ERROR != m_rc) || (m_expected_time != m_time)
+    || (M_LENGTH != m_length) || (0 != memcmp(m_data, m_expected, M_LENGTH)))
+    {
+      return 0U;
+    }
+  }
+  U32 m_time = 0U;
+  U8 m_data[TEST_VARIABLE_MAX];
+  SIZE32 m_length = 0U;
+  FS_SERIES_READ(
+    ID, TO, TEST_VARIABLE_MAX, &m_time, m_data, &m_length, &m_rc, &m_fe
+  );
+  return NO_ACTION == m_rc;
+}
+
+/*
+ * СЛУЧАЙНЫЕ ДИАПАЗОНЫ ОБОИХ РЯДОВ:
+ *   FIRST: Первые существующие записи рядов
+ *   seed: Состояние генератора
+ *   return: Количество неверно прочитанных диапазонов
+ */
+static SIZE32 TEST_RANGES(
+/* IN    */ const U32 FIRST[2U],
+/* INOUT */ U32 * seed)
+{
+  SIZE32 m_failed = 0U;
+  for(SIZE32 s = 0U; s < 2U; s++)
+  {
+    FILE_NAME m_name;
+    TEST_NAME(s, m_name);
+    RETURN_CODE m_rc = NO_ERROR;
+    FILE_ERROR m_fe = 0;
+    FILE_ID m_id;
+    FS_FILE_OPEN(m_name, FILE_MODE_READ_ONLY, &m_id, &m_rc, &m_fe);
+    if(NO_ERROR != m_rc)
+    {
+      return TEST_RANGES_COUNT;
+    }
+    U32 m_last = 0U;
+    U8 m_data[TEST_VARIABLE_MAX];
+    TEST_RECORD(s, TEST_RECORDS_COUNT - 1U, &m_last, m_data);
+    for(SIZE32 n = 0U; n < TEST_RANGES_COUNT; n++)
+    {
+      const U32 M_FROM = TEST_RANDOM(seed) % (m_last + 2U);
+      const U32 M_TO = M_FROM + TEST_RANDOM(seed) % (m_last / 8U + 1U);
+      m_failed += !TEST_RANGE(s, m_id, FIRST[s], M_FROM, M_TO);
+    }
+    m_failed += !TEST_RANGE(s, m_id, FIRST[s], 0U, (U32)UN_SET);
+    FS_FILE_CLOSE(m_id, &m_rc, &m_fe);
+  }
+  return m_failed;
+}
+
+int main(int argc, char ** argv)
+{
+  TEST_BEGIN(argc, argv);
+  U32 m_seed = 0x27D4EB2FU;
+
+  RETURN_CODE m_rc = NO_ERROR;
+  FILE_ERROR m_fe = 0;
+  TEST_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+
+  /* 1. Ряд постоянного размера (разности) и ряд переменного размера */
+  for(SIZE32 s = 0U; s < 2U; s++)
+  {
+    FILE_NAME m_name;
+    TEST_NAME(s, m_name);
+    FS_SERIES_CREATE(
+      m_name, (0U == s) ? TEST_FIXED_SIZE : 0U,
+      (0U == s) ? FS_SERIES_DELTA : FS_SERIES_RAW, &m_rc, &m_fe
+    );
+    TEST_CHECK(NO_ERROR == m_rc);
+    FILE_ID m_id;
+    FS_FILE_OPEN(m_name, FILE_MODE_READ_WRITE, &m_id, &m_rc, &m_fe);
+    TEST_CHECK(NO_ERROR == m_rc);
+    SIZE32 m_failed = 0U;
+    for(U32 k = 0U; k < TEST_RECORDS_COUNT; k++)
+    {
+      U32 m_time = 0U;
+      U8 m_data[TEST_VARIABLE_MAX];
+      const SIZE32 M_LENGTH = TEST_RECORD(s, k, &m_time, m_data);
+      FS_SERIES_APPEND(m_id, m_time, M_LENGTH, m_data, &m_rc, &m_fe);
+      m_failed += (NO_ERROR != m_rc);
+    }
+    TEST_CHECK(0U == m_failed);
+
+    /* Время меньше последнего отклоняется */
+    U8 m_data[TEST_FIXED_SIZE] = { 0U };
+    FS_SERIES_APPEND(m_id, 0U, TEST_FIXED_SIZE, m_data, &m_rc, &m_fe);
+    TEST_CHECK(INVALID_PARAM == m_rc);
+    FS_FILE_CLOSE(m_id, &m_rc, &m_fe);
+    TEST_CHECK(NO_ERROR == m_rc);
+  }
+
+  /* 2. Диапазоны до и после переподключения */
+  U32 m_first[2U] = { 0U, 0U };
+  TEST_CHECK(0U == TEST_RANGES(m_first, &m_seed));
+  TEST_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_CHECK(0U == TEST_RANGES(m_first, &m_seed));
+
+  /* 3. Отбрасывание начала ряда: записи после позиции сохраняются,
+   *    отброшенные блоки не читаются */
+  for(SIZE32 s = 0U; s < 2U; s++)
+  {
+    FILE_NAME m_name;
+    TEST_NAME(s, m_name);
+    FILE_ID m_id;
+    FS_FILE_OPEN(m_name, FILE_MODE_READ_WRITE, &m_id, &m_rc, &m_fe);
+    TEST_CHECK(NO_ERROR == m_rc);
+    m_first[s] = TEST_RECORDS_COUNT / 2U;
+    U32 m_time = 0U;
+    U8 m_data[TEST_VARIABLE_MAX];
+    TEST_RECORD(s, m_first[s], &m_time, m_data);
+    FS_SERIES_SEEK(m_id, m_time, &m_rc, &m_fe);
+    TEST_CHECK(NO_ERROR == m_rc);
+    FS_LOG_TRIM(m_id, &m_rc, &m_fe);
+    TEST_CHECK(NO_ERROR == m_rc);
+    FS_SERIES_SEEK(m_id, 0U, &m_rc, &m_fe);
+    TEST_CHECK(NO_ERROR == m_rc);
+    U32 m_oldest = 0U;
+    SIZE32 m_length = 0U;
+    FS_SERIES_READ(
+      m_id, (U32)UN_SET, TEST_VARIABLE_MAX, &m_oldest, m_data, &m_length,
+      &m_rc, &m_fe
+    );
+    TEST_CHECK(NO_ERROR == m_rc);
+    TEST_CHECK(m_oldest <= m_time);
+    TEST_CHECK(m_oldest > 0U);
+    FS_FILE_CLOSE(m_id, &m_rc, &m_fe);
+    TEST_CHECK(NO_ERROR == m_rc);
+  }
+  TEST_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  for(SIZE32 s = 0U; s < 2U; s++)
+  {
+    FILE_NAME m_name;
+    TEST_NAME(s, m_name);
+    FILE_ID m_id;
+    FS_FILE_OPEN(m_name, FILE_MODE_READ_ONLY, &m_id, &m_rc, &m_fe);
+    TEST_CHECK(NO_ERROR == m_rc);
+    U32 m_time = 0U;
+    U8 m_data[TEST_VARIABLE_MAX];
+    TEST_RECORD(s, m_first[s], &m_time, m_data);
+    TEST_CHECK(TEST_RANGE(s, m_id, m_first[s], m_time, (U32)UN_SET));
+    FS_FILE_CLOSE(m_id, &m_rc, &m_fe);
+    TEST_CHECK(NO_ERROR == m_rc);
+  }
+
+  TEST_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  return TEST_END("test_series");
+}
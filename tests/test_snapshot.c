@@ -0,0 +1,315 @@
+/*
+ * ОТКАТ К СНИМКУ:
+ * после снимка файлы многократно перезаписываются (сборщик мусора
+ * переносит устаревшие блоки снимка), часть файлов удаляется, создаются
+ * новые. Откат при открытом файле отклоняется; после отката ФС совпадает
+ * с состоянием на момент снимка, пригодна для записи и сохраняет
+ * состояние после переподключения. Снимок переживает переподключение
+ * (откат после него возвращает то же состояние), откат, прерванный
+ * отключением питания, после переподключения выполнен целиком или
+ * не выполнен
+ */
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "test.h"
+
+#define TEST_FILES_COUNT 16U
+#define TEST_FILE_SIZE 2000U
+#define TEST_OPERATIONS 3000U
+#define TEST_CHUNK_SIZE 1000U
+#define TEST_CUTS_COUNT 64U
+
+static U8 g_model[TEST_FILES_COUNT][TEST_FILE_SIZE];
+static U8 g_saved[TEST_FILES_COUNT][TEST_FILE_SIZE];
+static U8 g_buffer[TEST_FILE_SIZE];
+
+/*
+ * ЗАПИСЬ ФРАГМЕНТА ФАЙЛА:
+ *   INDEX: Номер файла
+ *   OFFSET: Смещение
+ *   LENGTH: Длина
+ *   return: 1 - записано
+ */
+static U8 TEST_WRITE(
+/* IN  */ const SIZE32 INDEX,
+/* IN  */ const SIZE32 OFFSET,
+/* IN  */ const SIZE32 LENGTH)
+{
+  FILE_NAME m_name;
+  TEST_NAME(INDEX, m_name);
+  RETURN_CODE m_rc = NO_ERROR;
+  FILE_ERROR m_fe = 0;
+  FILE_ID m_id;
+  FS_FILE_OPEN(m_name, FILE_MODE_READ_WRITE, &m_id, &m_rc, &m_fe);
+  if(NO_ERROR != m_rc)
+  {
+    return 0U;
+  }
+  FILE_POSITION m_position;
+  FS_FILE_SEEK(
+    m_id, (FILE_POSITION)OFFSET, FILE_SEEK_SET, &m_position, &m_rc, &m_fe
+  );
+  RETURN_CODE m_write_rc = m_rc;
+  if(NO_ERROR == m_rc)
+  {
+    FS_FILE_WRITE(m_id, LENGTH, &g_model[INDEX][OFFSET], &m_write_rc, &m_fe);
+  }
+  FS_FILE_CLOSE(m_id, &m_rc, &m_fe);
+  return (NO_ERROR == m_write_rc) && (NO_ERROR == m_rc);
+}
+
+/*
+ * СОЗДАНИЕ И ЗАПОЛНЕНИЕ ФАЙЛА СЛУЧАЙНЫМИ ДАННЫМИ:
+ *   INDEX: Номер файла
+ *   seed: Состояние генератора
+ *   return: 1 - файл создан и записан
+ */
+static U8 TEST_CREATE(
+/* IN    */ const SIZE32 INDEX,
+/* INOUT */ U32 * seed)
+{
+  for(SIZE32 i = 0U; i < TEST_FILE_SIZE; i++)
+  {
+    g_model[INDEX][i] = (U8)TEST_RANDOM(seed);
+  }
+  FILE_NAME m_name;
+  TEST_NAME(INDEX, m_name);
+  RETURN_CODE m_rc = NO_ERROR;
+  FILE_ERROR m_fe = 0;
+  FS_FILE_CREATE(m_name, &m_rc, &m_fe);
+  return (NO_ERROR == m_rc) && TEST_WRITE(INDEX, 0U, TEST_FILE_SIZE);
+}
+
+/*
+ * СЛУЧАЙНЫЕ ПЕРЕЗАПИСИ ФАЙЛОВ:
+ *   COUNT: Количество существующих файлов
+ *   OPERATIONS: Количество перезаписей
+ *   seed: Состояние генератора
+ *   return: Количество неудачных записей
+ */
+static SIZE32 TEST_REWRITE(
+/* IN    */ const SIZE32 COUNT,
+/* IN    */ const SIZE32 OPERATIONS,
+/* INOUT */ U32 * seed)
+{
+  SIZE32 m_failed_writes = 0U;
+  for(SIZE32 n = 0U; n < OPERATIONS; n++)
+  {
+    const SIZE32 M_FILE = TEST_RANDOM(seed) % COUNT;
+    const SIZE32 M_LENGTH = 1U + TEST_RANDOM(seed) % TEST_CHUNK_SIZE;
+    const SIZE32 M_OFFSET
+      = TEST_RANDOM(seed) % (TEST_FILE_SIZE - M_LENGTH + 1U);
+    for(SIZE32 i = 0U; i < M_LENGTH; i++)
+    {
+      g_model[M_FILE][M_OFFSET + i] = (U8)TEST_RANDOM(seed);
+    }
+    m_failed_writes += !TEST_WRITE(M_FILE, M_OFFSET, M_LENGTH);
+  }
+  return m_failed_writes;
+}
+
+/*
+ * ОТКАТ В ДОЧЕРНЕМ ПРОЦЕССЕ (FS_FREE не вызывается):
+ *   ID: Номер снимка
+ *   CUT: Операция flash, на которой отключается питание
+ */
+static void TEST_ROLLBACK_CHILD(
+/* IN  */ const SNAPSHOT_ID ID,
+/* IN  */ const SIZE32 CUT)
+{
+  const pid_t M_PID = fork();
+  if(0 == M_PID)
+  {
+    RETURN_CODE m_rc = NO_ERROR;
+    TEST_MOUNT(&m_rc);
+    EMULATOR_POWER_CUT(CUT);
+    FS_SNAPSHOT_ROLLBACK(ID, &m_rc);
+    _exit(0);
+  }
+  int m_status = 0;
+  waitpid(M_PID, &m_status, 0);
+}
+
+/*
+ * СВЕРКА ФАЙЛОВ:
+ *   COUNT: Количество файлов, которые должны существовать (остальные
+ *          TEST_FILES_COUNT - отсутствуют)
+ *   model: Ожидаемое содержимое
+ *   return: Количество несовпадений
+ */
+static SIZE32 TEST_VERIFY(
+/* IN  */ const SIZE32 COUNT,
+/* IN  */ U8 (* model)[TEST_FILE_SIZE])
+{
+  SIZE32 m_mismatches = 0U;
+  for(SIZE32 f = 0U; f < TEST_FILES_COUNT; f++)
+  {
+    FILE_NAME m_name;
+    TEST_NAME(f, m_name);
+    RETURN_CODE m_rc = NO_ERROR;
+    FILE_ERROR m_fe = 0;
+    FILE_ID m_id;
+    FS_FILE_OPEN(m_name, FILE_MODE_READ_ONLY, &m_id, &m_rc, &m_fe);
+    if(f >= COUNT)
+    {
+      m_mismatches += (NO_ERROR == m_rc);
+      if(NO_ERROR == m_rc)
+      {
+        FS_FILE_CLOSE(m_id, &m_rc, &m_fe);
+      }
+      continue;
+    }
+    if(NO_ERROR != m_rc)
+    {
+      m_mismatches++;
+      continue;
+    }
+    SIZE32 m_length = 0U;
+    FS_FILE_READ(m_id, TEST_FILE_SIZE, &m_length, g_buffer, &m_rc, &m_fe);
+    m_mismatches += (TEST_FILE_SIZE != m_length)
+                 || (0 != memcmp(g_buffer, model[f], TEST_FILE_SIZE));
+    FS_FILE_CLOSE(m_id, &m_rc, &m_fe);
+  }
+  return m_mismatches;
+}
+
+int main(int argc, char ** argv)
+{
+  TEST_BEGIN(argc, argv);
+  U32 m_seed = 0x85EBCA6BU;
+
+  RETURN_CODE m_rc = NO_ERROR;
+  FILE_ERROR m_fe = 0;
+  TEST_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+
+  /* 1. Исходные файлы (вторая половина создается после снимка) */
+  for(SIZE32 f = 0U; f < TEST_FILES_COUNT / 2U; f++)
+  {
+    TEST_CHECK(TEST_CREATE(f, &m_seed));
+  }
+  STD_MEMCPY(sizeof(g_model), g_model, g_saved);
+
+  SNAPSHOT_ID m_snapshot;
+  FS_SNAPSHOT_CREATE(&m_snapshot, &m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+
+  /* 2. Перезапись, удаление и создание файлов после снимка */
+  for(SIZE32 f = TEST_FILES_COUNT / 2U; f < TEST_FILES_COUNT; f++)
+  {
+    TEST_CHECK(TEST_CREATE(f, &m_seed));
+  }
+  TEST_CHECK(0U == TEST_REWRITE(TEST_FILES_COUNT, TEST_OPERATIONS, &m_seed));
+  FILE_NAME m_name;
+  TEST_NAME(0U, m_name);
+  FS_FILE_REMOVE(m_name, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_CHECK(0U != TEST_VERIFY(TEST_FILES_COUNT, g_saved));
+
+  /* 3. Откат при открытом файле отклоняется */
+  FILE_ID m_id;
+  TEST_NAME(1U, m_name);
+  FS_FILE_OPEN(m_name, FILE_MODE_READ_ONLY, &m_id, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+  FS_SNAPSHOT_ROLLBACK(m_snapshot, &m_rc);
+  TEST_CHECK(DEVICE_BUSY == m_rc);
+  FS_FILE_CLOSE(m_id, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+
+  /* 4. Откат: файлы совпадают с состоянием на момент снимка */
+  FS_SNAPSHOT_ROLLBACK(m_snapshot, &m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_CHECK(0U == TEST_VERIFY(TEST_FILES_COUNT / 2U, g_saved));
+  STD_MEMCPY(sizeof(g_saved), g_saved, g_model);
+
+  /* 5. Откат и снимок сохраняются после переподключения: перезаписи
+   * после переподключения снова отменяются откатом */
+  TEST_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_CHECK(0U == TEST_VERIFY(TEST_FILES_COUNT / 2U, g_saved));
+  TEST_CHECK(0U == TEST_REWRITE(
+    TEST_FILES_COUNT / 2U, TEST_OPERATIONS / 4U, &m_seed));
+  TEST_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_CHECK(0U == TEST_VERIFY(TEST_FILES_COUNT / 2U, g_model));
+  FS_SNAPSHOT_ROLLBACK(m_snapshot, &m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_CHECK(0U == TEST_VERIFY(TEST_FILES_COUNT / 2U, g_saved));
+
+  /* 6. Снимок удаляется, откат к удаленному снимку отклоняется */
+  FS_SNAPSHOT_DELETE(m_snapshot, &m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  FS_SNAPSHOT_ROLLBACK(m_snapshot, &m_rc);
+  TEST_CHECK(INVALID_PARAM == m_rc);
+
+  /* 7. ФС после отката пригодна для записи */
+  STD_MEMCPY(sizeof(g_saved), g_saved, g_model);
+  for(SIZE32 f = TEST_FILES_COUNT / 2U; f < TEST_FILES_COUNT; f++)
+  {
+    TEST_CHECK(TEST_CREATE(f, &m_seed));
+  }
+  for(SIZE32 i = 0U; i < TEST_FILE_SIZE; i++)
+  {
+    g_model[2U][i] = (U8)TEST_RANDOM(&m_seed);
+  }
+  TEST_CHECK(TEST_WRITE(2U, 0U, TEST_FILE_SIZE));
+  TEST_CHECK(0U == TEST_VERIFY(TEST_FILES_COUNT, g_model));
+
+  /* 8. Состояние после переподключения: удаленный снимок
+   * не восстанавливается */
+  TEST_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_CHECK(0U == TEST_VERIFY(TEST_FILES_COUNT, g_model));
+  FS_SNAPSHOT_ROLLBACK(m_snapshot, &m_rc);
+  TEST_CHECK(INVALID_PARAM == m_rc);
+
+  /* 9. Отключение питания во время отката: после переподключения
+   * состояние до отката или состояние снимка, со следующей операции
+   * flash после записи отката - состояние снимка */
+  STD_MEMCPY(sizeof(g_model), g_model, g_saved);
+  FS_SNAPSHOT_CREATE(&m_snapshot, &m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_CHECK(0U == TEST_REWRITE(
+    TEST_FILES_COUNT, TEST_OPERATIONS / 4U, &m_seed));
+  TEST_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  SIZE32 m_cut = 1U;
+  U8 m_rolled = 0U;
+  for(; !m_rolled && (m_cut <= TEST_CUTS_COUNT); m_cut++)
+  {
+    TEST_ROLLBACK_CHILD(m_snapshot, m_cut);
+    TEST_MOUNT(&m_rc);
+    TEST_CHECK(NO_ERROR == m_rc);
+    m_rolled = (0U == TEST_VERIFY(TEST_FILES_COUNT, g_saved));
+    TEST_CHECK(m_rolled || (0U == TEST_VERIFY(TEST_FILES_COUNT, g_model)));
+    TEST_UNMOUNT(&m_rc);
+    TEST_CHECK(NO_ERROR == m_rc);
+  }
+  TEST_CHECK(m_rolled && (m_cut > 2U));
+
+  /* Откат выполнен один раз: после переподключения ФС пригодна
+   * для записи, снимок удаляется */
+  TEST_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  STD_MEMCPY(sizeof(g_saved), g_saved, g_model);
+  TEST_CHECK(0U == TEST_REWRITE(
+    TEST_FILES_COUNT, TEST_OPERATIONS / 8U, &m_seed));
+  FS_SNAPSHOT_DELETE(m_snapshot, &m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_CHECK(0U == TEST_VERIFY(TEST_FILES_COUNT, g_model));
+  TEST_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+
+  return TEST_END("test_snapshot");
+}
@@ -0,0 +1,306 @@
+/*
+ * ПОИСК ПО ТЕГАМ:
+ * файлам случайно добавляются и снимаются теги, выражения в обратной
+ * польской записи (один тег, AND, OR, NOT и их вложение) сверяются
+ * с моделью. Неизвестный тег дает пустое множество, некорректное или
+ * слишком глубокое выражение отклоняется. Удаленный файл исчезает из
+ * результатов, переименованный тег находится по новому имени, индекс
+ * сохраняется после переподключения
+ */
+#include "test.h"
+
+#define TEST_FILES_COUNT 70U
+#define TEST_TAGS_COUNT 5U
+#define TEST_OPERATIONS 400U
+
+static U8 g_tags[TEST_FILES_COUNT][TEST_TAGS_COUNT];
+static U8 g_present[TEST_FILES_COUNT];
+static FILE_ID g_ids[TEST_FILES_COUNT];
+static CHAR g_tag_names[TEST_TAGS_COUNT][TAG_NAME_SIZE];
+
+/*
+ * ЭЛЕМЕНТ ВЫРАЖЕНИЯ:
+ *   OP: Операция
+ *   TAG: Номер тега (для TAG_QUERY_TAG)
+ *   return: Элемент
+ */
+static TAG_QUERY_TYPE TEST_OP(
+/* IN  */ const TAG_QUERY_OP OP,
+/* IN  */ const SIZE32 TAG)
+{
+  TAG_QUERY_TYPE m_item;
+  STD_MEMSET(sizeof(m_item), 0x00U, &m_item);
+  m_item.op = OP;
+  if(TAG_QUERY_TAG == OP)
+  {
+    STD_MEMCPY(TAG_NAME_SIZE, g_tag_names[TAG], m_item.tag);
+  }
+  return m_item;
+}
+
+/*
+ * Выражения, сверяемые с моделью
+ */
+#define TEST_EXPR_T0 0U
+#define TEST_EXPR_AND 1U
+#define TEST_EXPR_OR 2U
+#define TEST_EXPR_NOT 3U
+#define TEST_EXPR_NESTED 4U
+#define TEST_EXPR_ALL 5U
+#define TEST_EXPR_NONE 6U
+
+/*
+ * ФАЙЛ ВХОДИТ В РЕЗУЛЬТАТ ВЫРАЖЕНИЯ (по модели):
+ *   EXPRESSION: Выражение (TEST_EXPR_*)
+ *   TAGS: Теги файла
+ *   return: 1 - входит
+ */
+static U8 TEST_MATCH(
+/* IN  */ const SIZE32 EXPRESSION,
+/* IN  */ const U8 * TAGS)
+{
+  switch(EXPRESSION)
+  {
+    case TEST_EXPR_T0:
+      return TAGS[0U];
+    case TEST_EXPR_AND:
+      return TAGS[0U] && TAGS[1U];
+    case TEST_EXPR_OR:
+      return TAGS[2U] || TAGS[3U];
+    case TEST_EXPR_NOT:
+      return !TAGS[4U];
+    case TEST_EXPR_NESTED:
+      return TAGS[0U] && (TAGS[1U] || !TAGS[2U]);
+    case TEST_EXPR_ALL:
+      return 1U;
+    default:
+      return 0U;
+  }
+}
+
+/*
+ * СВЕРКА ПОИСКА С МОДЕЛЬЮ:
+ *   QUERY: Выражение
+ *   QUERY_LENGTH: Количество элементов
+ *   EXPRESSION: То же выражение для модели (TEST_EXPR_*)
+ *   return: 1 - результат совпал
+ */
+static U8 TEST_SEARCH(
+/* IN  */ const TAG_QUERY_TYPE * QUERY,
+/* IN  */ const SIZE32 QUERY_LENGTH,
+/* IN  */ const SIZE32 EXPRESSION)
+{
+  FILE_ID m_found[TEST_FILES_COUNT];
+  SIZE32 m_count = 0U;
+  RETURN_CODE m_rc = NO_ERROR;
+  FS_TAG_SEARCH(
+    QUERY, QUERY_LENGTH, TEST_FILES_COUNT, m_found, &m_count, &m_rc
+  );
+  if((NO_ERROR != m_rc) || (m_count > TEST_FILES_COUNT))
+  {
+    return 0U;
+  }
+
+  /* Номера возрастают, каждый принадлежит подходящему файлу */
+  SIZE32 m_expected = 0U;
+  for(SIZE32 f = 0U; f < TEST_FILES_COUNT; f++)
+  {
+    m_expected += g_present[f] && TEST_MATCH(EXPRESSION, g_tags[f]);
+  }
+  if(m_expected != m_count)
+  {
+    return 0U;
+  }
+  for(SIZE32 i = 0U; i < m_count; i++)
+  {
+    if((i > 0U) && (m_found[i - 1U] >= m_found[i]))
+    {
+      return 0U;
+    }
+    SIZE32 f = 0U;
+    while((f < TEST_FILES_COUNT)
+    && (!g_present[f] || (g_ids[f] != m_found[i])))
+    {
+      f++;
+    }
+    if((TEST_FILES_COUNT == f) || !TEST_MATCH(EXPRESSION, g_tags[f]))
+    {
+      return 0U;
+    }
+  }
+  return 1U;
+}
+
+/*
+ * СВЕРКА ВСЕХ ВЫРАЖЕНИЙ:
+ *   return: Количество несовпавших выражений
+ */
+static SIZE32 TEST_VERIFY(void)
+{
+  const TAG_QUERY_TYPE M_T0[] = { TEST_OP(TAG_QUERY_TAG, 0U) };
+  const TAG_QUERY_TYPE M_AND[] =
+  {
+    TEST_OP(TAG_QUERY_TAG, 0U), TEST_OP(TAG_QUERY_TAG, 1U),
+    TEST_OP(TAG_QUERY_AND, 0U)
+  };
+  const TAG_QUERY_TYPE M_OR[] =
+  {
+    TEST_OP(TAG_QUERY_TAG, 2U), TEST_OP(TAG_QUERY_TAG, 3U),
+    TEST_OP(TAG_QUERY_OR, 0U)
+  };
+  const TAG_QUERY_TYPE M_NOT[] =
+  {
+    TEST_OP(TAG_QUERY_TAG, 4U), TEST_OP(TAG_QUERY_NOT, 0U)
+  };
+  /* t0 AND (t1 OR NOT t2) = t0 t1 t2 NOT OR AND */
+  const TAG_QUERY_TYPE M_NESTED[] =
+  {
+    TEST_OP(TAG_QUERY_TAG, 0U), TEST_OP(TAG_QUERY_TAG, 1U),
+    TEST_OP(TAG_QUERY_TAG, 2U), TEST_OP(TAG_QUERY_NOT, 0U),
+    TEST_OP(TAG_QUERY_OR, 0U), TEST_OP(TAG_QUERY_AND, 0U)
+  };
+  return !TEST_SEARCH(M_T0, 1U, TEST_EXPR_T0)
+       + !TEST_SEARCH(M_AND, 3U, TEST_EXPR_AND)
+       + !TEST_SEARCH(M_OR, 3U, TEST_EXPR_OR)
+       + !TEST_SEARCH(M_NOT, 2U, TEST_EXPR_NOT)
+       + !TEST_SEARCH(M_NESTED, 6U, TEST_EXPR_NESTED)
+       + !TEST_SEARCH((const TAG_QUERY_TYPE *)(0), 0U, TEST_EXPR_ALL);
+}
+
+int main(int argc, char ** argv)
+{
+  TEST_BEGIN(argc, argv);
+  U32 m_seed = 0x68E31DA4U;
+  for(SIZE32 t = 0U; t < TEST_TAGS_COUNT; t++)
+  {
+    snprintf(g_tag_names[t], TAG_NAME_SIZE, "tag%u", t);
+  }
+
+  RETURN_CODE m_rc = NO_ERROR;
+  FILE_ERROR m_fe = 0;
+  TEST_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+
+  /* 1. Файлы и их системные номера (курсор обхода по одному файлу) */
+  for(SIZE32 f = 0U; f < TEST_FILES_COUNT; f++)
+  {
+    FILE_NAME m_name;
+    TEST_NAME(f, m_name);
+    FS_FILE_CREATE(m_name, &m_rc, &m_fe);
+    TEST_CHECK(NO_ERROR == m_rc);
+    g_present[f] = 1U;
+  }
+  FILE_CURSOR_TYPE m_cursor;
+  FS_FILE_ITERATE_BEGIN(
+    "", (const TAG_QUERY_TYPE *)(0), 0U, &m_cursor, &m_rc
+  );
+  TEST_CHECK(NO_ERROR == m_rc);
+  for(;;)
+  {
+    FILE_ENTRY_TYPE m_entry;
+    SIZE32 m_count = 0U;
+    FS_FILE_ITERATE(&m_cursor, 1U, &m_entry, &m_count, &m_rc);
+    if(NO_ERROR != m_rc)
+    {
+      break;
+    }
+    U32 m_index = 0U;
+    TEST_CHECK(1 == sscanf(m_entry.name, "file%u", &m_index));
+    TEST_CHECK(m_index < TEST_FILES_COUNT);
+    g_ids[m_index % TEST_FILES_COUNT] = (FILE_ID)(m_cursor.next - 1U);
+  }
+
+  /* 2. Неизвестный тег - пустое множество; некорректные выражения */
+  const TAG_QUERY_TYPE M_T0[] = { TEST_OP(TAG_QUERY_TAG, 0U) };
+  TEST_CHECK(TEST_SEARCH(M_T0, 1U, TEST_EXPR_NONE));
+  const TAG_QUERY_TYPE M_BAD[] =
+  {
+    TEST_OP(TAG_QUERY_TAG, 0U), TEST_OP(TAG_QUERY_TAG, 1U),
+    TEST_OP(TAG_QUERY_TAG, 2U), TEST_OP(TAG_QUERY_TAG, 3U),
+    TEST_OP(TAG_QUERY_TAG, 4U), TEST_OP(TAG_QUERY_AND, 0U)
+  };
+  FILE_ID m_found[TEST_FILES_COUNT];
+  SIZE32 m_count = 0U;
+  FS_TAG_SEARCH(&M_BAD[4U], 2U, TEST_FILES_COUNT, m_found, &m_count, &m_rc);
+  TEST_CHECK(INVALID_PARAM == m_rc);
+  FS_TAG_SEARCH(M_BAD, 2U, TEST_FILES_COUNT, m_found, &m_count, &m_rc);
+  TEST_CHECK(INVALID_PARAM == m_rc);
+  FS_TAG_SEARCH(M_BAD, 5U, TEST_FILES_COUNT, m_found, &m_count, &m_rc);
+  TEST_CHECK(INVALID_PARAM == m_rc);
+  TAG_QUERY_TYPE m_unknown = TEST_OP(TAG_QUERY_NOT, 0U);
+  m_unknown.op = (TAG_QUERY_OP)0x7F;
+  FS_TAG_SEARCH(&m_unknown, 1U, TEST_FILES_COUNT, m_found, &m_count, &m_rc);
+  TEST_CHECK(INVALID_PARAM == m_rc);
+
+  /* 3. Случайные добавления и снятия тегов (теги создаются на файле 1) */
+  FILE_NAME m_tagged;
+  TEST_NAME(1U, m_tagged);
+  for(SIZE32 t = 0U; t < TEST_TAGS_COUNT; t++)
+  {
+    FS_TAG_ADD(m_tagged, g_tag_names[t], &m_rc);
+    TEST_CHECK(NO_ERROR == m_rc);
+    g_tags[1U][t] = 1U;
+  }
+  SIZE32 m_failed = 0U;
+  for(SIZE32 n = 0U; n < TEST_OPERATIONS; n++)
+  {
+    const SIZE32 M_FILE = TEST_RANDOM(&m_seed) % TEST_FILES_COUNT;
+    const SIZE32 M_TAG = TEST_RANDOM(&m_seed) % TEST_TAGS_COUNT;
+    FILE_NAME m_name;
+    TEST_NAME(M_FILE, m_name);
+    if(0U == TEST_RANDOM(&m_seed) % 3U)
+    {
+      FS_TAG_REMOVE(m_name, g_tag_names[M_TAG], &m_rc);
+      g_tags[M_FILE][M_TAG] = 0U;
+    }
+    else
+    {
+      FS_TAG_ADD(m_name, g_tag_names[M_TAG], &m_rc);
+      g_tags[M_FILE][M_TAG] = 1U;
+    }
+    m_failed += (NO_ERROR != m_rc);
+  }
+  TEST_CHECK(0U == m_failed);
+  TEST_CHECK(0U == TEST_VERIFY());
+
+  /* 4. Результат длиннее массива: количество полное, номера - первые */
+  FILE_ID m_first[2U];
+  SIZE32 m_all = 0U;
+  FS_TAG_SEARCH(M_T0, 1U, TEST_FILES_COUNT, m_found, &m_count, &m_rc);
+  FS_TAG_SEARCH(M_T0, 1U, 2U, m_first, &m_all, &m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_CHECK((m_count == m_all) && (m_all > 2U));
+  TEST_CHECK((m_found[0U] == m_first[0U]) && (m_found[1U] == m_first[1U]));
+
+  /* 5. Удаленные файлы исчезают из результатов (и из NOT) */
+  for(SIZE32 f = 0U; f < TEST_FILES_COUNT; f += 7U)
+  {
+    FILE_NAME m_name;
+    TEST_NAME(f, m_name);
+    FS_FILE_REMOVE(m_name, &m_rc, &m_fe);
+    TEST_CHECK(NO_ERROR == m_rc);
+    g_present[f] = 0U;
+  }
+  TEST_CHECK(0U == TEST_VERIFY());
+
+  /* 6. Индекс сохраняется после переподключения */
+  TEST_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_CHECK(0U == TEST_VERIFY());
+
+  /* 7. Переименованный тег находится по новому имени */
+  CHAR m_renamed[TAG_NAME_SIZE] = "renamed";
+  FS_TAG_RENAME(g_tag_names[0U], m_renamed, &m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  FS_TAG_RENAME(g_tag_names[1U], m_renamed, &m_rc);
+  TEST_CHECK(NO_ACTION == m_rc);
+  TEST_CHECK(TEST_SEARCH(M_T0, 1U, TEST_EXPR_NONE));
+  STD_MEMCPY(TAG_NAME_SIZE, m_renamed, g_tag_names[0U]);
+  TEST_CHECK(0U == TEST_VERIFY());
+
+  TEST_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  return TEST_END("test_tag");
+}
@@ -0,0 +1,154 @@
+/*
+ * ГОРЯЧИЕ И ХОЛОДНЫЕ ДАННЫЕ:
+ * без подсказки блок горячий со второй записи, подсказка FTL_HINT важнее
+ * оценки и действует до FTL_INIT. Горячие и холодные данные пишутся
+ * на разные фронты: при перезаписи горячего набора поверх заполняющихся
+ * холодных данных сборщик мусора переносит во много раз меньше блоков,
+ * чем при записи всех данных на один фронт
+ */
+#include "test.h"
+
+#define TEST_DATA_SIZE 250U
+#define TEST_BLOCKS_COUNT 3968U
+#define TEST_COLD_COUNT 3000U
+#define TEST_HOT_COUNT 64U
+#define TEST_HOT_PER_COLD 4U
+
+/*
+ * ДАННЫЕ ЛОГИЧЕСКОГО БЛОКА (несжимаемые):
+ *   LBI: Номер логического блока
+ *   ROUND: Номер перезаписи
+ *   data: Данные
+ */
+static void TEST_BLOCK(
+/* IN  */ const FTL_INDEX LBI,
+/* IN  */ const U32 ROUND,
+/* OUT */ U8 * data)
+{
+  U32 m_seed = LBI * 2654435761U + ROUND * 40503U + 1U;
+  for(SIZE32 i = 0U; i < TEST_DATA_SIZE; i++)
+  {
+    data[i] = (U8)TEST_RANDOM(&m_seed);
+  }
+}
+
+/*
+ * ЗАПИСЬ БЛОКА С ПОДСЧЕТОМ ФРОНТА:
+ *   LBI: Номер логического блока
+ *   ROUND: Номер перезаписи
+ *   return: 1 - блок записан на горячий фронт, 0 - на холодный,
+ *           UN_SET - ошибка записи
+ */
+static U32 TEST_WRITE(
+/* IN  */ const FTL_INDEX LBI,
+/* IN  */ const U32 ROUND)
+{
+  U8 m_data[TEST_DATA_SIZE] __attribute__((aligned(4)));
+  TEST_BLOCK(LBI, ROUND, m_data);
+  FTL_STATS_TYPE m_before;
+  FTL_STATS_TYPE m_after;
+  RETURN_CODE m_rc = NO_ERROR;
+  FTL_STATS(&m_before, &m_rc);
+  FTL_WRITE(LBI, 1U, m_data, &m_rc);
+  if(NO_ERROR != m_rc)
+  {
+    return (U32)UN_SET;
+  }
+  FTL_STATS(&m_after, &m_rc);
+  return m_after.gc.hot_blocks - m_before.gc.hot_blocks;
+}
+
+/*
+ * ЗАПОЛНЕНИЕ ХОЛОДНЫМИ ДАННЫМИ ВПЕРЕМЕЖКУ С ПЕРЕЗАПИСЬЮ ГОРЯЧИХ
+ * (пустой образ):
+ *   COLD: Подсказка для холодных блоков
+ *   return: Блоков перенесено сборщиком мусора (UN_SET - ошибка)
+ */
+static SIZE32 TEST_FILL(
+/* IN  */ const FTL_TEMPERATURE COLD)
+{
+  RETURN_CODE m_rc = NO_ERROR;
+  remove(g_test_image);
+  TEST_FTL_MOUNT(&m_rc);
+  if(NO_ERROR != m_rc)
+  {
+    return (SIZE32)UN_SET;
+  }
+  FTL_STATS_TYPE m_before;
+  FTL_STATS(&m_before, &m_rc);
+  RETURN_CODE m_hint_rc = NO_ERROR;
+  FTL_HINT(0U, TEST_COLD_COUNT, COLD, &m_hint_rc);
+  FTL_HINT(TEST_COLD_COUNT, TEST_HOT_COUNT, FTL_TEMPERATURE_HOT, &m_rc);
+  SIZE32 m_failures = (NO_ERROR != m_rc) + (NO_ERROR != m_hint_rc);
+  for(FTL_INDEX m_lbi = 0U; m_lbi < TEST_COLD_COUNT; m_lbi++)
+  {
+    m_failures += ((U32)UN_SET == TEST_WRITE(m_lbi, 0U));
+    for(U32 h = 0U; h < TEST_HOT_PER_COLD; h++)
+    {
+      const U32 M_WRITE = m_lbi * TEST_HOT_PER_COLD + h;
+      m_failures += ((U32)UN_SET == TEST_WRITE(
+        TEST_COLD_COUNT + M_WRITE % TEST_HOT_COUNT, M_WRITE));
+    }
+  }
+  for(FTL_INDEX m_lbi = 0U; m_lbi < TEST_COLD_COUNT; m_lbi++)
+  {
+    U8 m_data[TEST_DATA_SIZE] __attribute__((aligned(4)));
+    U8 m_model[TEST_DATA_SIZE];
+    TEST_BLOCK(m_lbi, 0U, m_model);
+    FTL_READ(m_lbi, 1U, m_data, &m_rc);
+    m_failures += (NO_ERROR != m_rc)
+      || (0 != memcmp(m_data, m_model, TEST_DATA_SIZE));
+  }
+  FTL_STATS_TYPE m_after;
+  FTL_STATS(&m_after, &m_rc);
+  TEST_FTL_UNMOUNT(&m_rc);
+  m_failures += (NO_ERROR != m_rc);
+  return (0U == m_failures)
+    ? m_after.gc.relocations - m_before.gc.relocations : (SIZE32)UN_SET;
+}
+
+int main(int argc, char ** argv)
+{
+  TEST_BEGIN(argc, argv);
+  RETURN_CODE m_rc = NO_ERROR;
+  TEST_FTL_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+
+  /* 1. Подсказка за границей памяти */
+  FTL_HINT(TEST_BLOCKS_COUNT - 1U, 2U, FTL_TEMPERATURE_HOT, &m_rc);
+  TEST_CHECK(INVALID_PARAM == m_rc);
+
+  /* 2. Без подсказки: первая запись холодная, повторная - горячая */
+  TEST_CHECK(0U == TEST_WRITE(10U, 0U));
+  TEST_CHECK(1U == TEST_WRITE(10U, 1U));
+  TEST_CHECK(1U == TEST_WRITE(10U, 2U));
+
+  /* 3. Подсказка важнее частоты перезаписи */
+  FTL_HINT(20U, 2U, FTL_TEMPERATURE_HOT, &m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  FTL_HINT(10U, 1U, FTL_TEMPERATURE_COLD, &m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_CHECK(1U == TEST_WRITE(20U, 0U));
+  TEST_CHECK(1U == TEST_WRITE(21U, 0U));
+  TEST_CHECK(0U == TEST_WRITE(10U, 3U));
+  TEST_CHECK(0U == TEST_WRITE(10U, 4U));
+
+  /* 4. Подсказка сбрасывается при FTL_INIT */
+  TEST_FTL_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_FTL_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_CHECK(0U == TEST_WRITE(20U, 1U));
+  TEST_CHECK(1U == TEST_WRITE(20U, 2U));
+  TEST_FTL_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+
+  /* 5. Разделение фронтов сокращает перенос блоков сборщиком мусора */
+  const SIZE32 M_SEPARATED = TEST_FILL(FTL_TEMPERATURE_COLD);
+  const SIZE32 M_MIXED = TEST_FILL(FTL_TEMPERATURE_HOT);
+  TEST_CHECK((SIZE32)UN_SET != M_SEPARATED);
+  TEST_CHECK((SIZE32)UN_SET != M_MIXED);
+  TEST_CHECK(4U * M_SEPARATED < M_MIXED);
+
+  return TEST_END("test_temperature");
+}
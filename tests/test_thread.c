@@ -0,0 +1,336 @@
+/*
+ * ПАРАЛЛЕЛЬНАЯ РАБОТА ПОТОКОВ:
+ * шесть потоков создают, перезаписывают, усекают, читают и помечают
+ * тегами свои файлы и одновременно читают общий файл, открытый каждым
+ * только на чтение. Фоновый поток в это время обходит файлы курсором
+ * и шагами собирает мусор. Данные и теги каждого файла совпадают
+ * с моделью его потока и сохраняются после переподключения (без
+ * FS_THREAD_SAFE потоки выполняются по очереди)
+ */
+#include <pthread.h>
+
+#include "test.h"
+#include "fs_lock.h"
+
+#define TEST_THREADS 6U
+#define TEST_THREAD_FILES 4U
+#define TEST_ROUNDS 40U
+#define TEST_MAX_SIZE 2000U
+#define TEST_SHARED_SIZE 3000U
+#define TEST_SHARED_INDEX (TEST_THREADS * TEST_THREAD_FILES)
+#define TEST_BATCH_SIZE 5U
+
+/*
+ * ПОТОК:
+ *   index: Номер потока (тег "tagN", файлы N * TEST_THREAD_FILES + ...)
+ *   seed: Состояние генератора данных
+ *   data: Модель данных файлов
+ *   sizes: Модель размеров файлов
+ *   tagged: Модель тега файлов
+ *   failed: Количество ошибок
+ */
+typedef struct
+{
+  SIZE32 index;
+  U32 seed;
+  U8 data[TEST_THREAD_FILES][TEST_MAX_SIZE];
+  SIZE32 sizes[TEST_THREAD_FILES];
+  U8 tagged[TEST_THREAD_FILES];
+  SIZE32 failed;
+} TEST_THREAD_TYPE;
+
+static TEST_THREAD_TYPE g_threads[TEST_THREADS];
+static U8 g_shared[TEST_SHARED_SIZE];
+
+/*
+ * Признак остановки фонового потока и количество его ошибок
+ */
+static U8 g_stop = 0U;
+static SIZE32 g_background_failed = 0U;
+
+/*
+ * ТЕГ ПОТОКА:
+ *   INDEX: Номер потока
+ *   tag: Название тега
+ */
+static void TEST_TAG(
+/* IN  */ const SIZE32 INDEX,
+/* OUT */ TAG_NAME tag)
+{
+  STD_MEMSET(TAG_NAME_SIZE, 0x00U, tag);
+  snprintf(tag, TAG_NAME_SIZE, "tag%u", INDEX);
+}
+
+/*
+ * СВЕРКА ФАЙЛА С МОДЕЛЬЮ:
+ *   INDEX: Номер файла
+ *   SIZE: Размер по модели
+ *   DATA: Данные по модели
+ *   return: 1 - файл совпал
+ */
+static U8 TEST_VERIFY(
+/* IN  */ const SIZE32 INDEX,
+/* IN  */ const SIZE32 SIZE,
+/* IN  */ const U8 * DATA)
+{
+  FILE_NAME m_name;
+  TEST_NAME(INDEX, m_name);
+  RETURN_CODE m_rc = NO_ERROR;
+  FILE_ERROR m_fe = 0;
+  FILE_ID m_id;
+  FS_FILE_OPEN(m_name, FILE_MODE_READ_ONLY, &m_id, &m_rc, &m_fe);
+  if(NO_ERROR != m_rc)
+  {
+    return 0U;
+  }
+  U8 m_read[TEST_SHARED_SIZE + 1U];
+  SIZE32 m_length = 0U;
+  FS_FILE_READ(m_id, sizeof(m_read), &m_length, m_read, &m_rc, &m_fe);
+  const U8 M_MATCH = (SIZE == m_length) && (0 == memcmp(m_read, DATA, SIZE));
+  FS_FILE_CLOSE(m_id, &m_rc, &m_fe);
+  return M_MATCH && (NO_ERROR == m_rc);
+}
+
+/*
+ * ОДИН ШАГ ПОТОКА НАД СВОИМ ФАЙЛОМ (перезапись или усечение, тег,
+ * сверка своего и общего файлов):
+ *   thread: Поток
+ *   ROUND: Номер шага
+ */
+static void TEST_STEP(
+/* INOUT */ TEST_THREAD_TYPE * thread,
+/* IN    */ const U32 ROUND)
+{
+  const SIZE32 M_FILE = ROUND % TEST_THREAD_FILES;
+  const SIZE32 M_INDEX = thread->index * TEST_THREAD_FILES + M_FILE;
+  FILE_NAME m_name;
+  TEST_NAME(M_INDEX, m_name);
+  RETURN_CODE m_rc = NO_ERROR;
+  FILE_ERROR m_fe = 0;
+  if(ROUND < TEST_THREAD_FILES)
+  {
+    FS_FILE_CREATE(m_name, &m_rc, &m_fe);
+    thread->failed += (NO_ERROR != m_rc);
+  }
+
+  /* Каждый третий шаг усекает файл вдвое, остальные перезаписывают его
+   * с начала данными случайного размера */
+  FILE_ID m_id;
+  FS_FILE_OPEN(m_name, FILE_MODE_READ_WRITE, &m_id, &m_rc, &m_fe);
+  thread->failed += (NO_ERROR != m_rc);
+  if(2U == ROUND % 3U)
+  {
+    thread->sizes[M_FILE] /= 2U;
+    FS_FILE_TRUNCATE(m_id, thread->sizes[M_FILE], &m_rc, &m_fe);
+    thread->failed += (NO_ERROR != m_rc);
+  }
+  else
+  {
+    const SIZE32 M_SIZE = 1U + TEST_RANDOM(&thread->seed) % TEST_MAX_SIZE;
+    for(SIZE32 i = 0U; i < M_SIZE; i++)
+    {
+      thread->data[M_FILE][i] = (U8)TEST_RANDOM(&thread->seed);
+    }
+    if(M_SIZE < thread->sizes[M_FILE])
+    {
+      FS_FILE_TRUNCATE(m_id, 0U, &m_rc, &m_fe);
+      thread->failed += (NO_ERROR != m_rc);
+    }
+    FILE_POSITION m_position;
+    FS_FILE_SEEK(m_id, 0, FILE_SEEK_SET, &m_position, &m_rc, &m_fe);
+    FS_FILE_WRITE(m_id, M_SIZE, thread->data[M_FILE], &m_rc, &m_fe);
+    thread->failed += (NO_ERROR != m_rc);
+    thread->sizes[M_FILE] = M_SIZE;
+  }
+  FS_FILE_CLOSE(m_id, &m_rc, &m_fe);
+  thread->failed += (NO_ERROR != m_rc);
+
+  /* Тег потока ставится и снимается по очереди */
+  TAG_NAME m_tag;
+  TEST_TAG(thread->index, m_tag);
+  if(thread->tagged[M_FILE])
+  {
+    FS_TAG_REMOVE(m_name, m_tag, &m_rc);
+  }
+  else
+  {
+    FS_TAG_ADD(m_name, m_tag, &m_rc);
+  }
+  thread->failed += (NO_ERROR != m_rc);
+  thread->tagged[M_FILE] = !thread->tagged[M_FILE];
+
+  thread->failed += !TEST_VERIFY(
+    M_INDEX, thread->sizes[M_FILE], thread->data[M_FILE]);
+  thread->failed += !TEST_VERIFY(
+    TEST_SHARED_INDEX, TEST_SHARED_SIZE, g_shared);
+}
+
+/*
+ * РАБОЧИЙ ПОТОК:
+ *   thread: Поток (TEST_THREAD_TYPE)
+ */
+static VOID_PTR TEST_WORKER(
+/* INOUT */ VOID_PTR thread)
+{
+  for(U32 r = 0U; r < TEST_ROUNDS; r++)
+  {
+    TEST_STEP((TEST_THREAD_TYPE *)thread, r);
+  }
+  return (VOID_PTR)(0);
+}
+
+/*
+ * ПРОХОД ФОНОВОГО ПОТОКА (обход всех файлов и шаг сборки мусора):
+ *   return: Количество ошибок
+ */
+static SIZE32 TEST_BACKGROUND_PASS(void)
+{
+  SIZE32 m_failed = 0U;
+  FILE_CURSOR_TYPE m_cursor;
+  RETURN_CODE m_rc = NO_ERROR;
+  FS_FILE_ITERATE_BEGIN("", (const TAG_QUERY_TYPE *)(0), 0U, &m_cursor, &m_rc);
+  m_failed += (NO_ERROR != m_rc);
+  while(NO_ERROR == m_rc)
+  {
+    FILE_ENTRY_TYPE m_entries[TEST_BATCH_SIZE];
+    SIZE32 m_count = 0U;
+    FS_FILE_ITERATE(&m_cursor, TEST_BATCH_SIZE, m_entries, &m_count, &m_rc);
+    m_failed += (NO_ERROR != m_rc) && (NO_ACTION != m_rc);
+    for(SIZE32 i = 0U; (NO_ERROR == m_rc) && (i < m_count); i++)
+    {
+      m_failed += (m_entries[i].size > TEST_SHARED_SIZE);
+    }
+  }
+  U8 m_done = 0U;
+  FTL_GARBAGE_COLLECT_STEP(&m_done, &m_rc);
+  m_failed += (NO_ERROR != m_rc);
+  return m_failed;
+}
+
+/*
+ * ФОНОВЫЙ ПОТОК (до g_stop):
+ *   unused: Не используется
+ */
+static VOID_PTR TEST_BACKGROUND(
+/* IN  */ VOID_PTR unused)
+{
+  (void)unused;
+  while(!FS_ATOMIC_LOAD(g_stop))
+  {
+    g_background_failed += TEST_BACKGROUND_PASS();
+  }
+  return (VOID_PTR)(0);
+}
+
+/*
+ * СВЕРКА ТЕГА ПОТОКА С МОДЕЛЬЮ:
+ *   THREAD: Поток
+ *   return: 1 - поиск по тегу дал файлы, помеченные в модели
+ */
+static U8 TEST_TAGGED(
+/* IN  */ const TEST_THREAD_TYPE * THREAD)
+{
+  TAG_QUERY_TYPE m_query;
+  STD_MEMSET(sizeof(m_query), 0x00U, &m_query);
+  m_query.op = TAG_QUERY_TAG;
+  TEST_TAG(THREAD->index, m_query.tag);
+  FILE_ID m_found[TEST_THREAD_FILES + 1U];
+  SIZE32 m_count = 0U;
+  RETURN_CODE m_rc = NO_ERROR;
+  FS_TAG_SEARCH(&m_query, 1U, TEST_THREAD_FILES + 1U, m_found, &m_count,
+    &m_rc);
+  SIZE32 m_expected = 0U;
+  for(SIZE32 f = 0U; f < TEST_THREAD_FILES; f++)
+  {
+    m_expected += THREAD->tagged[f];
+  }
+  return (NO_ERROR == m_rc) && (m_expected == m_count);
+}
+
+int main(int argc, char ** argv)
+{
+  TEST_BEGIN(argc, argv);
+  RETURN_CODE m_rc = NO_ERROR;
+  FILE_ERROR m_fe = 0;
+  TEST_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+
+  /* 1. Общий файл, который потоки только читают */
+  U32 m_seed = 0x85EBCA6BU;
+  for(SIZE32 i = 0U; i < TEST_SHARED_SIZE; i++)
+  {
+    g_shared[i] = (U8)TEST_RANDOM(&m_seed);
+  }
+  FILE_NAME m_name;
+  TEST_NAME(TEST_SHARED_INDEX, m_name);
+  FS_FILE_CREATE(m_name, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+  FILE_ID m_id;
+  FS_FILE_OPEN(m_name, FILE_MODE_READ_WRITE, &m_id, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+  FS_FILE_WRITE(m_id, TEST_SHARED_SIZE, g_shared, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+  FS_FILE_CLOSE(m_id, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+
+  /* 2. Рабочие потоки со своими файлами и фоновый обход со сборкой
+   * мусора */
+  for(SIZE32 t = 0U; t < TEST_THREADS; t++)
+  {
+    g_threads[t].index = t;
+    g_threads[t].seed = 0x27D4EB2FU + t;
+  }
+#if FS_THREAD_SAFE
+  pthread_t m_background;
+  TEST_CHECK(0 == pthread_create(
+    &m_background, (VOID_PTR)(0), TEST_BACKGROUND, (VOID_PTR)(0)));
+  pthread_t m_workers[TEST_THREADS];
+  for(SIZE32 t = 0U; t < TEST_THREADS; t++)
+  {
+    TEST_CHECK(0 == pthread_create(
+      &m_workers[t], (VOID_PTR)(0), TEST_WORKER, &g_threads[t]));
+  }
+  for(SIZE32 t = 0U; t < TEST_THREADS; t++)
+  {
+    pthread_join(m_workers[t], (VOID_PTR *)(0));
+  }
+  FS_ATOMIC_STORE(g_stop, 1U);
+  pthread_join(m_background, (VOID_PTR *)(0));
+#else
+  for(SIZE32 t = 0U; t < TEST_THREADS; t++)
+  {
+    TEST_WORKER(&g_threads[t]);
+    g_background_failed += TEST_BACKGROUND_PASS();
+  }
+#endif
+  TEST_CHECK(0U == g_background_failed);
+
+  /* 3. Файлы и теги совпадают с моделями потоков */
+  for(SIZE32 t = 0U; t < TEST_THREADS; t++)
+  {
+    TEST_CHECK(0U == g_threads[t].failed);
+    TEST_CHECK(TEST_TAGGED(&g_threads[t]));
+  }
+
+  /* 4. После переподключения данные и теги сохраняются */
+  TEST_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  SIZE32 m_failures = 0U;
+  for(SIZE32 t = 0U; t < TEST_THREADS; t++)
+  {
+    for(SIZE32 f = 0U; f < TEST_THREAD_FILES; f++)
+    {
+      m_failures += !TEST_VERIFY(t * TEST_THREAD_FILES + f,
+        g_threads[t].sizes[f], g_threads[t].data[f]);
+    }
+    m_failures += !TEST_TAGGED(&g_threads[t]);
+  }
+  m_failures += !TEST_VERIFY(TEST_SHARED_INDEX, TEST_SHARED_SIZE, g_shared);
+  TEST_CHECK(0U == m_failures);
+
+  TEST_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  return TEST_END("test_thread");
+}
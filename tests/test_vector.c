@@ -0,0 +1,211 @@
+/*
+ * ВЕКТОРНЫЙ ВВОД/ВЫВОД:
+ * FS_FILE_WRITEV записывает части подряд (пустые, короче и длиннее
+ * блока, через границы блоков), FS_FILE_READV раскладывает данные
+ * по частям другой нарезки и останавливается на конце файла. Атомарное
+ * добавление пишет в конец файла с любой позиции; добавление, которому
+ * не хватило места, отбрасывается целиком, и место возвращается.
+ * Вектор, превышающий размер файла, отклоняется до записи
+ */
+#include "test.h"
+
+#define TEST_DATA_SIZE 248U
+#define TEST_FILE_SIZE 3000U
+#define TEST_APPEND_SIZE 400U
+#define TEST_PART_SIZE (256U * 1024U)
+#define TEST_PARTS_COUNT 5U
+
+static U8 g_model[TEST_FILE_SIZE + TEST_APPEND_SIZE];
+static U8 g_read[TEST_FILE_SIZE + TEST_APPEND_SIZE];
+
+/*
+ * ЗАПИСЬ ВЕКТОРА ПО НАРЕЗКЕ:
+ *   ID: Дескриптор файла
+ *   SIZES: Размеры частей
+ *   COUNT: Количество частей
+ *   DATA: Данные (части - подряд)
+ *   APPEND: Атомарное добавление
+ *   return_code: Статус FS_FILE_WRITEV
+ */
+static void TEST_WRITEV(
+/* IN  */ const FILE_ID ID,
+/* IN  */ const SIZE32 * SIZES,
+/* IN  */ const SIZE32 COUNT,
+/* IN  */ const U8 * DATA,
+/* IN  */ const U8 APPEND,
+/* OUT */ RETURN_CODE * return_code)
+{
+  FILE_IOVEC_TYPE m_vector[8U];
+  SIZE32 m_offset = 0U;
+  for(SIZE32 i = 0U; i < COUNT; i++)
+  {
+    m_vector[i] = (FILE_IOVEC_TYPE){
+      .length = SIZES[i],
+      .data = (VOID_PTR)(DATA + m_offset)
+    };
+    m_offset += SIZES[i];
+  }
+  FILE_ERROR m_fe = 0;
+  FS_FILE_WRITEV(ID, COUNT, m_vector, APPEND, return_code, &m_fe);
+}
+
+/*
+ * ЧТЕНИЕ ВЕКТОРОМ С НАЧАЛА ФАЙЛА (части по STEP байт в g_read):
+ *   ID: Дескриптор файла
+ *   STEP: Размер части
+ *   return: Прочитано байт (UN_SET - ошибка)
+ */
+static SIZE32 TEST_READV(
+/* IN  */ const FILE_ID ID,
+/* IN  */ const SIZE32 STEP)
+{
+  FILE_IOVEC_TYPE m_vector[64U];
+  const SIZE32 M_COUNT = (sizeof(g_read) + STEP - 1U) / STEP;
+  for(SIZE32 i = 0U; i < M_COUNT; i++)
+  {
+    m_vector[i] = (FILE_IOVEC_TYPE){
+      .length = (i + 1U < M_COUNT) ? STEP : sizeof(g_read) - i * STEP,
+      .data = (VOID_PTR)(g_read + i * STEP)
+    };
+  }
+  RETURN_CODE m_rc = NO_ERROR;
+  FILE_ERROR m_fe = 0;
+  FILE_POSITION m_position;
+  FS_FILE_SEEK(ID, 0, FILE_SEEK_SET, &m_position, &m_rc, &m_fe);
+  SIZE32 m_length = 0U;
+  STD_MEMSET(sizeof(g_read), 0x00U, g_read);
+  FS_FILE_READV(ID, M_COUNT, m_vector, &m_length, &m_rc, &m_fe);
+  return (NO_ERROR == m_rc) ? m_length : (SIZE32)UN_SET;
+}
+
+int main(int argc, char ** argv)
+{
+  TEST_BEGIN(argc, argv);
+  U32 m_seed = 0x1B873593U;
+  for(SIZE32 i = 0U; i < sizeof(g_model); i++)
+  {
+    g_model[i] = (U8)TEST_RANDOM(&m_seed);
+  }
+
+  RETURN_CODE m_rc = NO_ERROR;
+  FILE_ERROR m_fe = 0;
+  TEST_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  FILE_NAME m_name;
+  TEST_NAME(0U, m_name);
+  FS_FILE_CREATE(m_name, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+  FILE_ID m_id;
+  FS_FILE_OPEN(m_name, FILE_MODE_READ_WRITE, &m_id, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+
+  /* 1. Части разного размера через границы блоков */
+  const SIZE32 M_SIZES[8U] = {
+    0U, 1U, TEST_DATA_SIZE - 1U, TEST_DATA_SIZE, 0U, TEST_DATA_SIZE + 1U,
+    1000U, TEST_FILE_SIZE - 1001U - 3U * TEST_DATA_SIZE
+  };
+  TEST_WRITEV(m_id, M_SIZES, 8U, g_model, 0U, &m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  FILE_STATUS_TYPE m_status;
+  FS_FILE_STATUS(m_id, &m_status, &m_rc, &m_fe);
+  TEST_CHECK(TEST_FILE_SIZE == m_status.size);
+  TEST_CHECK(TEST_FILE_SIZE == m_status.position);
+
+  /* 2. Чтение другой нарезкой: последняя часть - короткая, чтение
+   * останавливается на конце файла */
+  const SIZE32 M_STEPS[3U] = { 1U + TEST_DATA_SIZE / 3U, TEST_DATA_SIZE, 997U };
+  for(SIZE32 s = 0U; s < 3U; s++)
+  {
+    TEST_CHECK(TEST_FILE_SIZE == TEST_READV(m_id, M_STEPS[s]));
+    TEST_CHECK(0 == memcmp(g_read, g_model, TEST_FILE_SIZE));
+  }
+
+  /* 3. Перезапись вектором с середины файла */
+  for(SIZE32 i = 600U; i < 1100U; i++)
+  {
+    g_model[i] ^= 0x5AU;
+  }
+  FILE_POSITION m_position;
+  FS_FILE_SEEK(m_id, 600, FILE_SEEK_SET, &m_position, &m_rc, &m_fe);
+  const SIZE32 M_MIDDLE[2U] = { 123U, 377U };
+  TEST_WRITEV(m_id, M_MIDDLE, 2U, g_model + 600U, 0U, &m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_CHECK(TEST_FILE_SIZE == TEST_READV(m_id, TEST_DATA_SIZE));
+  TEST_CHECK(0 == memcmp(g_read, g_model, TEST_FILE_SIZE));
+
+  /* 4. Атомарное добавление с начала файла пишет в конец */
+  FS_FILE_SEEK(m_id, 0, FILE_SEEK_SET, &m_position, &m_rc, &m_fe);
+  const SIZE32 M_APPEND[3U] = { 100U, 0U, TEST_APPEND_SIZE - 100U };
+  TEST_WRITEV(m_id, M_APPEND, 3U, g_model + TEST_FILE_SIZE, 1U, &m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  FS_FILE_STATUS(m_id, &m_status, &m_rc, &m_fe);
+  TEST_CHECK(TEST_FILE_SIZE + TEST_APPEND_SIZE == m_status.size);
+  TEST_CHECK(TEST_FILE_SIZE + TEST_APPEND_SIZE == m_status.position);
+  TEST_CHECK(sizeof(g_model) == TEST_READV(m_id, 500U));
+  TEST_CHECK(0 == memcmp(g_read, g_model, sizeof(g_model)));
+
+  /* 5. Вектор больше предельного размера файла отклоняется до записи */
+  FILE_IOVEC_TYPE m_huge[2U] = {
+    { .length = 0x40000000U, .data = (VOID_PTR)g_model },
+    { .length = 0x40000000U, .data = (VOID_PTR)g_model }
+  };
+  FS_FILE_WRITEV(m_id, 2U, m_huge, 1U, &m_rc, &m_fe);
+  TEST_CHECK(INVALID_PARAM == m_rc);
+  TEST_CHECK(FILE_ERROR_FILE_SIZE == m_fe);
+  FS_FILE_STATUS(m_id, &m_status, &m_rc, &m_fe);
+  TEST_CHECK(sizeof(g_model) == m_status.size);
+
+  /* 6. Добавление, которому не хватило места, отбрасывается целиком,
+   * позиция восстанавливается, место возвращается */
+  FS_FILE_SEEK(m_id, 10, FILE_SEEK_SET, &m_position, &m_rc, &m_fe);
+  static U8 s_part[TEST_PART_SIZE];
+  FILE_IOVEC_TYPE m_parts[TEST_PARTS_COUNT];
+  for(SIZE32 i = 0U; i < TEST_PARTS_COUNT; i++)
+  {
+    m_parts[i] = (FILE_IOVEC_TYPE){
+      .length = TEST_PART_SIZE, .data = (VOID_PTR)s_part
+    };
+  }
+  for(SIZE32 i = 0U; i < TEST_PART_SIZE; i++)
+  {
+    s_part[i] = (U8)TEST_RANDOM(&m_seed);
+  }
+  FS_FILE_WRITEV(m_id, TEST_PARTS_COUNT, m_parts, 1U, &m_rc, &m_fe);
+  TEST_CHECK(OPERATION_FAILED == m_rc);
+  TEST_CHECK(FILE_ERROR_NO_SPACE == m_fe);
+  FS_FILE_STATUS(m_id, &m_status, &m_rc, &m_fe);
+  TEST_CHECK(sizeof(g_model) == m_status.size);
+  TEST_CHECK(10 == m_status.position);
+  TEST_CHECK(sizeof(g_model) == TEST_READV(m_id, TEST_DATA_SIZE));
+  TEST_CHECK(0 == memcmp(g_read, g_model, sizeof(g_model)));
+  FS_FILE_WRITEV(m_id, 1U, m_parts, 1U, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+  FS_FILE_TRUNCATE(m_id, sizeof(g_model), &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+
+  /* 7. Запись вектором через дескриптор только на чтение запрещена */
+  FS_FILE_CLOSE(m_id, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+  FS_FILE_OPEN(m_name, FILE_MODE_READ_ONLY, &m_id, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_WRITEV(m_id, M_APPEND, 3U, g_model, 1U, &m_rc);
+  TEST_CHECK(ACCESS_DENIED == m_rc);
+  FS_FILE_CLOSE(m_id, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+
+  /* 8. Данные сохраняются после переподключения */
+  TEST_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  FS_FILE_OPEN(m_name, FILE_MODE_READ_ONLY, &m_id, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_CHECK(sizeof(g_model) == TEST_READV(m_id, 333U));
+  TEST_CHECK(0 == memcmp(g_read, g_model, sizeof(g_model)));
+  FS_FILE_CLOSE(m_id, &m_rc, &m_fe);
+  TEST_CHECK(NO_ERROR == m_rc);
+
+  TEST_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  return TEST_END("test_vector");
+}
@@ -0,0 +1,252 @@
+/*
+ * ОТОБРАЖЕНИЕ БЛОКОВ И ПОШАГОВАЯ СБОРКА МУСОРА:
+ * отображенный блок не меняется, пока его логический блок многократно
+ * перезаписывается и сборщик мусора идет шагами (не больше одного
+ * стирания за шаг, цикл завершается). После закрытия отображений место
+ * возвращается. Закрепление, которое оставило бы сборщик без резерва,
+ * отклоняется DEVICE_BUSY, запись при этом не отказывает. Блоки
+ * закрепляются при сборке без шифрования (FTL_ENCRYPT=0), иначе
+ * отображение отклоняется NO_ACTION и данные читаются FTL_READ
+ */
+#include "test.h"
+#include "fs_flash.h"
+
+#define TEST_DATA_SIZE 250U
+#define TEST_BLOCKS_COUNT 3968U
+#define TEST_LIVE_COUNT 600U
+#define TEST_VIEWS_COUNT 8U
+#define TEST_ROUNDS 6U
+#define TEST_FULL_COUNT 2400U
+
+static const U8 * g_views[TEST_BLOCKS_COUNT];
+
+/*
+ * ДАННЫЕ ЛОГИЧЕСКОГО БЛОКА (несжимаемые):
+ *   LBI: Номер логического блока
+ *   ROUND: Номер перезаписи
+ *   data: Данные
+ */
+static void TEST_BLOCK(
+/* IN  */ const FTL_INDEX LBI,
+/* IN  */ const U32 ROUND,
+/* OUT */ U8 * data)
+{
+  U32 m_seed = LBI * 2654435761U + ROUND * 40503U + 1U;
+  for(SIZE32 i = 0U; i < TEST_DATA_SIZE; i++)
+  {
+    data[i] = (U8)TEST_RANDOM(&m_seed);
+  }
+}
+
+/*
+ * ЗАПИСЬ ДИАПАЗОНА БЛОКОВ:
+ *   COUNT: Количество блоков (с 0)
+ *   ROUND: Номер перезаписи
+ *   return: Количество ошибок
+ */
+static SIZE32 TEST_WRITE(
+/* IN  */ const SIZE32 COUNT,
+/* IN  */ const U32 ROUND)
+{
+  SIZE32 m_failures = 0U;
+  for(FTL_INDEX m_lbi = 0U; m_lbi < COUNT; m_lbi++)
+  {
+    U8 m_data[TEST_DATA_SIZE] __attribute__((aligned(4)));
+    TEST_BLOCK(m_lbi, ROUND, m_data);
+    RETURN_CODE m_rc = NO_ERROR;
+    FTL_WRITE(m_lbi, 1U, m_data, &m_rc);
+    m_failures += (NO_ERROR != m_rc);
+  }
+  return m_failures;
+}
+
+/*
+ * СВЕРКА ДИАПАЗОНА БЛОКОВ:
+ *   COUNT: Количество блоков (с 0)
+ *   ROUND: Номер перезаписи
+ *   return: Количество несовпадений
+ */
+static SIZE32 TEST_VERIFY(
+/* IN  */ const SIZE32 COUNT,
+/* IN  */ const U32 ROUND)
+{
+  SIZE32 m_mismatches = 0U;
+  for(FTL_INDEX m_lbi = 0U; m_lbi < COUNT; m_lbi++)
+  {
+    U8 m_data[TEST_DATA_SIZE] __attribute__((aligned(4)));
+    U8 m_model[TEST_DATA_SIZE];
+    TEST_BLOCK(m_lbi, ROUND, m_model);
+    RETURN_CODE m_rc = NO_ERROR;
+    FTL_READ(m_lbi, 1U, m_data, &m_rc);
+    m_mismatches += (NO_ERROR != m_rc)
+      || (0 != memcmp(m_data, m_model, TEST_DATA_SIZE));
+  }
+  return m_mismatches;
+}
+
+/*
+ * ЦИКЛ СБОРКИ МУСОРА ШАГАМИ:
+ *   return: Количество шагов (UN_SET - ошибка, больше одного стирания
+ *           за шаг или цикл не завершился)
+ */
+static SIZE32 TEST_GC_CYCLE(void)
+{
+  for(SIZE32 m_steps = 1U; m_steps <= 2U * FLASH_SECTORS_COUNT; m_steps++)
+  {
+    FTL_STATS_TYPE m_before;
+    FTL_STATS_TYPE m_after;
+    RETURN_CODE m_rc = NO_ERROR;
+    FTL_STATS(&m_before, &m_rc);
+    U8 m_done = 0U;
+    FTL_GARBAGE_COLLECT_STEP(&m_done, &m_rc);
+    FTL_STATS(&m_after, &m_rc);
+    if((NO_ERROR != m_rc) || (m_after.gc.erases - m_before.gc.erases > 1U))
+    {
+      return (SIZE32)UN_SET;
+    }
+    if(m_done)
+    {
+      return m_steps;
+    }
+  }
+  return (SIZE32)UN_SET;
+}
+
+/*
+ * ЗАКРЫТИЕ ОТОБРАЖЕНИЙ:
+ *   COUNT: Количество блоков (с 0; закрываются открытые)
+ *   return: Количество ошибок
+ */
+static SIZE32 TEST_CLOSE_ALL(
+/* IN  */ const SIZE32 COUNT)
+{
+  SIZE32 m_failures = 0U;
+  for(FTL_INDEX m_lbi = 0U; m_lbi < COUNT; m_lbi++)
+  {
+    if((const U8 *)(0) != g_views[m_lbi])
+    {
+      RETURN_CODE m_rc = NO_ERROR;
+      FTL_VIEW_CLOSE(g_views[m_lbi], &m_rc);
+      m_failures += (NO_ERROR != m_rc);
+      g_views[m_lbi] = (const U8 *)(0);
+    }
+  }
+  return m_failures;
+}
+
+int main(int argc, char ** argv)
+{
+  TEST_BEGIN(argc, argv);
+  RETURN_CODE m_rc = NO_ERROR;
+  TEST_FTL_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  const U8 * m_view = (const U8 *)(0);
+
+  /* 1. Блок за границей, несуществующий и сжатый блоки не отображаются */
+  FTL_VIEW_OPEN(TEST_BLOCKS_COUNT, &m_view, &m_rc);
+  TEST_CHECK(INVALID_PARAM == m_rc);
+  FTL_VIEW_OPEN(TEST_LIVE_COUNT, &m_view, &m_rc);
+  TEST_CHECK(NO_ACTION == m_rc);
+  U8 m_zero[TEST_DATA_SIZE] __attribute__((aligned(4)));
+  STD_MEMSET(TEST_DATA_SIZE, 0x00U, m_zero);
+  FTL_WRITE(TEST_BLOCKS_COUNT - 1U, 1U, m_zero, &m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  FTL_VIEW_OPEN(TEST_BLOCKS_COUNT - 1U, &m_view, &m_rc);
+  TEST_CHECK(NO_ACTION == m_rc);
+  FTL_DISCARD(TEST_BLOCKS_COUNT - 1U, 1U, &m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+
+  /* 2. Отображения несжатых блоков: закреплены без шифрования, иначе
+   * отклонены все */
+  TEST_CHECK(0U == TEST_WRITE(TEST_LIVE_COUNT, 0U));
+  FTL_VIEW_OPEN(0U, &g_views[0U], &m_rc);
+  const U8 M_PINNED = (NO_ERROR == m_rc);
+  TEST_CHECK(M_PINNED || (NO_ACTION == m_rc));
+  SIZE32 m_wrong = 0U;
+  for(FTL_INDEX m_lbi = 1U; M_PINNED && (m_lbi < TEST_VIEWS_COUNT); m_lbi++)
+  {
+    FTL_VIEW_OPEN(m_lbi, &g_views[m_lbi], &m_rc);
+    m_wrong += (NO_ERROR != m_rc);
+  }
+  for(FTL_INDEX m_lbi = 0U; M_PINNED && (m_lbi < TEST_VIEWS_COUNT); m_lbi++)
+  {
+    U8 m_model[TEST_DATA_SIZE];
+    TEST_BLOCK(m_lbi, 0U, m_model);
+    m_wrong += (0 != memcmp(g_views[m_lbi], m_model, TEST_DATA_SIZE));
+  }
+  TEST_CHECK(0U == m_wrong);
+
+  /* 3. Перезапись и пошаговая сборка мусора: отображения не меняются,
+   * FTL_READ возвращает новые данные */
+  FTL_STATS_TYPE m_before;
+  FTL_STATS(&m_before, &m_rc);
+  for(U32 r = 1U; r <= TEST_ROUNDS; r++)
+  {
+    TEST_CHECK(0U == TEST_WRITE(TEST_LIVE_COUNT, r));
+    TEST_CHECK((SIZE32)UN_SET != TEST_GC_CYCLE());
+  }
+  FTL_STATS_TYPE m_after;
+  FTL_STATS(&m_after, &m_rc);
+  TEST_CHECK(m_after.gc.runs - m_before.gc.runs >= TEST_ROUNDS);
+  TEST_CHECK(0U == TEST_VERIFY(TEST_LIVE_COUNT, TEST_ROUNDS));
+  m_wrong = 0U;
+  for(FTL_INDEX m_lbi = 0U; M_PINNED && (m_lbi < TEST_VIEWS_COUNT); m_lbi++)
+  {
+    U8 m_model[TEST_DATA_SIZE];
+    TEST_BLOCK(m_lbi, 0U, m_model);
+    m_wrong += (0 != memcmp(g_views[m_lbi], m_model, TEST_DATA_SIZE));
+  }
+  TEST_CHECK(0U == m_wrong);
+
+  /* 4. Закрытие: чужой адрес отклоняется, после закрытия цикл сборки
+   * возвращает место закрепленных секторов */
+  FTL_VIEW_CLOSE(m_zero, &m_rc);
+  TEST_CHECK(INVALID_PARAM == m_rc);
+  FTL_STATS(&m_before, &m_rc);
+  TEST_CHECK(0U == TEST_CLOSE_ALL(TEST_VIEWS_COUNT));
+  TEST_CHECK((SIZE32)UN_SET != TEST_GC_CYCLE());
+  TEST_CHECK((SIZE32)UN_SET != TEST_GC_CYCLE());
+  FTL_STATS(&m_after, &m_rc);
+  TEST_CHECK(m_after.gc.free_blocks >= m_before.gc.free_blocks);
+  TEST_CHECK(!M_PINNED || (m_after.gc.free_blocks > m_before.gc.free_blocks));
+
+  /* 5. Почти полная память: закрепление лишних секторов отклоняется,
+   * запись не отказывает */
+  TEST_CHECK(0U == TEST_WRITE(TEST_FULL_COUNT, TEST_ROUNDS + 1U));
+  SIZE32 m_opened = 0U;
+  SIZE32 m_busy = 0U;
+  for(FTL_INDEX m_lbi = 0U; M_PINNED && (m_lbi < TEST_FULL_COUNT); m_lbi++)
+  {
+    FTL_VIEW_OPEN(m_lbi, &g_views[m_lbi], &m_rc);
+    m_opened += (NO_ERROR == m_rc);
+    m_busy += (DEVICE_BUSY == m_rc);
+    if(NO_ERROR != m_rc)
+    {
+      g_views[m_lbi] = (const U8 *)(0);
+    }
+  }
+  TEST_CHECK(!M_PINNED || ((0U < m_opened) && (0U < m_busy)));
+  TEST_CHECK(0U == TEST_WRITE(TEST_FULL_COUNT, TEST_ROUNDS + 2U));
+  TEST_CHECK(0U == TEST_VERIFY(TEST_FULL_COUNT, TEST_ROUNDS + 2U));
+  m_wrong = 0U;
+  for(FTL_INDEX m_lbi = 0U; m_lbi < TEST_FULL_COUNT; m_lbi++)
+  {
+    U8 m_model[TEST_DATA_SIZE];
+    TEST_BLOCK(m_lbi, TEST_ROUNDS + 1U, m_model);
+    m_wrong += ((const U8 *)(0) != g_views[m_lbi])
+      && (0 != memcmp(g_views[m_lbi], m_model, TEST_DATA_SIZE));
+  }
+  TEST_CHECK(0U == m_wrong);
+  TEST_CHECK(0U == TEST_CLOSE_ALL(TEST_FULL_COUNT));
+
+  /* 6. Данные сохраняются после переподключения */
+  TEST_FTL_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_FTL_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_CHECK(0U == TEST_VERIFY(TEST_FULL_COUNT, TEST_ROUNDS + 2U));
+  TEST_FTL_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+
+  return TEST_END("test_view");
+}
@@ -0,0 +1,384 @@
+/*
+ * НЕСКОЛЬКО ТОМОВ:
+ * у каждого тома свой образ; файл с одним именем в двух томах хранит
+ * разные данные. Дескриптор содержит номер тома: в другом томе он
+ * отклоняется, даже если там открыта та же ячейка того же поколения.
+ * Асинхронные очереди у томов свои: потоки томов одновременно пишут
+ * и читают файлы через запросы, завершения не смешиваются. Все
+ * FS_VOLUMES_COUNT томов одновременно подключаются, пишутся
+ * и переподключаются в своих потоках
+ */
+#include <pthread.h>
+
+#include "test.h"
+#include "fs_lock.h"
+#include "fs_async.h"
+
+#define TEST_VOLUMES 2U
+#define TEST_CHUNK_SIZE 500U
+#define TEST_CHUNKS_COUNT 24U
+#define TEST_FILE_SIZE (TEST_CHUNKS_COUNT * TEST_CHUNK_SIZE)
+#define TEST_PARALLEL_FILES 8U
+#define TEST_PARALLEL_FIRST 10U
+#define TEST_PARALLEL_SIZE 1500U
+
+/*
+ * ПОТОК ТОМА:
+ *   volume: Том
+ *   id: Дескриптор файла тома
+ *   data: Записываемые данные
+ *   read: Прочитанные данные
+ *   failed: Количество ошибочных завершений
+ */
+typedef struct
+{
+  VOLUME_ID volume;
+  FILE_ID id;
+  U8 data[TEST_FILE_SIZE];
+  U8 read[TEST_FILE_SIZE];
+  SIZE32 failed;
+} TEST_VOLUME_TYPE;
+
+static TEST_VOLUME_TYPE g_volumes[TEST_VOLUMES];
+
+/*
+ * Ошибки потоков параллельного подключения всех томов
+ */
+static SIZE32 g_parallel_failed[FS_VOLUMES_COUNT];
+
+/*
+ * ОБРАЗ ТОМА:
+ *   VOLUME: Том (0 - образ теста)
+ *   image: Имя файла образа
+ */
+static void TEST_IMAGE(
+/* IN  */ const VOLUME_ID VOLUME,
+/* OUT */ CHAR * image)
+{
+  if(0U == VOLUME)
+  {
+    snprintf(image, 256U, "%s", g_test_image);
+    return;
+  }
+  snprintf(image, 256U, "%s.%u", g_test_image, VOLUME);
+}
+
+/*
+ * ПОДКЛЮЧЕНИЕ ТОМА (том остается выбранным):
+ *   VOLUME: Том
+ *   return_code: Статус FS_INIT
+ */
+static void TEST_VOLUME_MOUNT(
+/* IN  */ const VOLUME_ID VOLUME,
+/* OUT */ RETURN_CODE * return_code)
+{
+  CHAR m_image[256];
+  TEST_IMAGE(VOLUME, m_image);
+  if(0U != VOLUME)
+  {
+    remove(m_image);
+  }
+  FS_VOLUME_SELECT(VOLUME, return_code);
+  if(NO_ERROR != *return_code)
+  {
+    return;
+  }
+  EMULATOR_INIT(m_image, return_code);
+  if(NO_ERROR != *return_code)
+  {
+    return;
+  }
+  FS_INIT(return_code);
+}
+
+/*
+ * ЗАПИСЬ И ЧТЕНИЕ ФАЙЛА ТОМА ЧЕРЕЗ ОЧЕРЕДИ:
+ *   volume: Поток тома (TEST_VOLUME_TYPE)
+ */
+static VOID_PTR TEST_VOLUME_WORKER(
+/* INOUT */ VOID_PTR volume)
+{
+  TEST_VOLUME_TYPE * m_volume = (TEST_VOLUME_TYPE *)volume;
+  RETURN_CODE m_rc = NO_ERROR;
+  FS_VOLUME_SELECT(m_volume->volume, &m_rc);
+  FS_ASYNC_INIT(&m_rc);
+  m_volume->failed += (NO_ERROR != m_rc);
+
+  /* Запросы записи, синхронизация, затем запросы чтения с начала */
+  U32 m_submitted = 0U;
+  U32 m_reaped = 0U;
+  for(SIZE32 c = 0U; c < 2U * TEST_CHUNKS_COUNT + 1U; c++)
+  {
+    FS_ASYNC_REQUEST_TYPE m_request =
+    {
+      .op = FS_ASYNC_OP_SYNC,
+      .id = m_volume->id,
+      .length = TEST_CHUNK_SIZE,
+      .buffer = (VOID_PTR)(0),
+      .user_data = (VOID_PTR)(size_t)m_submitted
+    };
+    if(c < TEST_CHUNKS_COUNT)
+    {
+      m_request.op = FS_ASYNC_OP_WRITE;
+      m_request.buffer = &m_volume->data[c * TEST_CHUNK_SIZE];
+    }
+    else if(c > TEST_CHUNKS_COUNT)
+    {
+      m_request.op = FS_ASYNC_OP_READ;
+      m_request.buffer
+        = &m_volume->read[(c - TEST_CHUNKS_COUNT - 1U) * TEST_CHUNK_SIZE];
+    }
+
+    /* Чтение начинается после завершения всех записей и синхронизации */
+    while((c > TEST_CHUNKS_COUNT) && (m_reaped <= TEST_CHUNKS_COUNT))
+    {
+      FS_ASYNC_COMPLETION_TYPE m_completion;
+      FS_ASYNC_REAP(1U, &m_completion, &m_rc);
+      m_volume->failed += (NO_ERROR != m_rc)
+        || ((VOID_PTR)(size_t)m_reaped++ != m_completion.user_data)
+        || (NO_ERROR != m_completion.return_code);
+    }
+    if(TEST_CHUNKS_COUNT + 1U == c)
+    {
+      FILE_POSITION m_position;
+      FILE_ERROR m_fe = 0;
+      FS_FILE_SEEK(
+        m_volume->id, (FILE_POSITION)0, FILE_SEEK_SET, &m_position, &m_rc, &m_fe
+      );
+      m_volume->failed += (NO_ERROR != m_rc);
+    }
+
+    FS_ASYNC_SUBMIT(&m_request, &m_rc);
+    while(NO_ACTION == m_rc)
+    {
+      FS_ASYNC_COMPLETION_TYPE m_completion;
+      FS_ASYNC_REAP(1U, &m_completion, &m_rc);
+      m_volume->failed += (NO_ERROR != m_rc)
+        || ((VOID_PTR)(size_t)m_reaped++ != m_completion.user_data)
+        || (NO_ERROR != m_completion.return_code);
+      FS_ASYNC_SUBMIT(&m_request, &m_rc);
+    }
+    m_volume->failed += (NO_ERROR != m_rc);
+    m_submitted++;
+  }
+  while(m_reaped < m_submitted)
+  {
+    FS_ASYNC_COMPLETION_TYPE m_completion;
+    FS_ASYNC_REAP(1U, &m_completion, &m_rc);
+    m_volume->failed += (NO_ERROR != m_rc)
+      || ((VOID_PTR)(size_t)m_reaped++ != m_completion.user_data)
+      || (NO_ERROR != m_completion.return_code);
+  }
+
+  FS_ASYNC_FREE(&m_rc);
+  m_volume->failed += (NO_ERROR != m_rc);
+  return (VOID_PTR)(0);
+}
+
+/*
+ * ДАННЫЕ ФАЙЛА ТОМА (свои у каждого тома и файла):
+ *   VOLUME: Том
+ *   INDEX: Номер файла
+ *   data: Данные
+ */
+static void TEST_PARALLEL_DATA(
+/* IN  */ const VOLUME_ID VOLUME,
+/* IN  */ const SIZE32 INDEX,
+/* OUT */ U8 * data)
+{
+  U32 m_seed = 0x165667B1U + VOLUME * 0x100U + INDEX;
+  for(SIZE32 i = 0U; i < TEST_PARALLEL_SIZE; i++)
+  {
+    data[i] = (U8)TEST_RANDOM(&m_seed);
+  }
+}
+
+/*
+ * ПОДКЛЮЧЕНИЕ, ЗАПИСЬ И СВЕРКА ТОМА ПОСЛЕ ПЕРЕПОДКЛЮЧЕНИЯ:
+ *   volume: Том
+ */
+static VOID_PTR TEST_PARALLEL_WORKER(
+/* IN  */ VOID_PTR volume)
+{
+  const VOLUME_ID M_VOLUME = (VOLUME_ID)(size_t)volume;
+  SIZE32 * m_failed = &g_parallel_failed[M_VOLUME];
+  RETURN_CODE m_rc = NO_ERROR;
+  FILE_ERROR m_fe = 0;
+  TEST_VOLUME_MOUNT(M_VOLUME, &m_rc);
+  *m_failed += (NO_ERROR != m_rc);
+  for(SIZE32 f = 0U; f < TEST_PARALLEL_FILES; f++)
+  {
+    U8 m_data[TEST_PARALLEL_SIZE];
+    TEST_PARALLEL_DATA(M_VOLUME, f, m_data);
+    FILE_NAME m_name;
+    TEST_NAME(TEST_PARALLEL_FIRST + f, m_name);
+    FS_FILE_CREATE(m_name, &m_rc, &m_fe);
+    *m_failed += (NO_ERROR != m_rc);
+    FILE_ID m_id;
+    FS_FILE_OPEN(m_name, FILE_MODE_READ_WRITE, &m_id, &m_rc, &m_fe);
+    *m_failed += (NO_ERROR != m_rc);
+    FS_FILE_WRITE(m_id, TEST_PARALLEL_SIZE, m_data, &m_rc, &m_fe);
+    *m_failed += (NO_ERROR != m_rc);
+    FS_FILE_CLOSE(m_id, &m_rc, &m_fe);
+    *m_failed += (NO_ERROR != m_rc);
+  }
+  TEST_UNMOUNT(&m_rc);
+  *m_failed += (NO_ERROR != m_rc);
+
+  CHAR m_image[256];
+  TEST_IMAGE(M_VOLUME, m_image);
+  EMULATOR_INIT(m_image, &m_rc);
+  *m_failed += (NO_ERROR != m_rc);
+  FS_INIT(&m_rc);
+  *m_failed += (NO_ERROR != m_rc);
+  for(SIZE32 f = 0U; f < TEST_PARALLEL_FILES; f++)
+  {
+    U8 m_data[TEST_PARALLEL_SIZE];
+    U8 m_read[TEST_PARALLEL_SIZE + 1U];
+    TEST_PARALLEL_DATA(M_VOLUME, f, m_data);
+    FILE_NAME m_name;
+    TEST_NAME(TEST_PARALLEL_FIRST + f, m_name);
+    FILE_ID m_id;
+    FS_FILE_OPEN(m_name, FILE_MODE_READ_ONLY, &m_id, &m_rc, &m_fe);
+    *m_failed += (NO_ERROR != m_rc);
+    SIZE32 m_length = 0U;
+    FS_FILE_READ(m_id, sizeof(m_read), &m_length, m_read, &m_rc, &m_fe);
+    *m_failed += (TEST_PARALLEL_SIZE != m_length)
+      || (0 != memcmp(m_read, m_data, TEST_PARALLEL_SIZE));
+    FS_FILE_CLOSE(m_id, &m_rc, &m_fe);
+    *m_failed += (NO_ERROR != m_rc);
+  }
+  TEST_UNMOUNT(&m_rc);
+  *m_failed += (NO_ERROR != m_rc);
+  if(0U != M_VOLUME)
+  {
+    remove(m_image);
+  }
+  return (VOID_PTR)(0);
+}
+
+int main(int argc, char ** argv)
+{
+  TEST_BEGIN(argc, argv);
+  RETURN_CODE m_rc = NO_ERROR;
+  FILE_ERROR m_fe = 0;
+  FILE_NAME m_name;
+  TEST_NAME(0U, m_name);
+
+  /* 1. Тома подключаются к своим образам, файл с одним именем в каждом */
+  for(VOLUME_ID v = 0U; v < TEST_VOLUMES; v++)
+  {
+    g_volumes[v].volume = v;
+    U32 m_seed = 0x9E3779B9U + v;
+    for(SIZE32 i = 0U; i < TEST_FILE_SIZE; i++)
+    {
+      g_volumes[v].data[i] = (U8)TEST_RANDOM(&m_seed);
+    }
+    TEST_VOLUME_MOUNT(v, &m_rc);
+    TEST_CHECK(NO_ERROR == m_rc);
+    FS_FILE_CREATE(m_name, &m_rc, &m_fe);
+    TEST_CHECK(NO_ERROR == m_rc);
+    FS_FILE_OPEN(
+      m_name, FILE_MODE_READ_WRITE, &g_volumes[v].id, &m_rc, &m_fe
+    );
+    TEST_CHECK(NO_ERROR == m_rc);
+  }
+  FS_VOLUME_SELECT(FS_VOLUMES_COUNT, &m_rc);
+  TEST_CHECK(INVALID_PARAM == m_rc);
+
+  /* 2. Та же ячейка того же поколения в другом томе - другой дескриптор,
+   * чужой дескриптор отклоняется */
+  TEST_CHECK(g_volumes[0U].id != g_volumes[1U].id);
+  for(VOLUME_ID v = 0U; v < TEST_VOLUMES; v++)
+  {
+    FS_VOLUME_SELECT(v, &m_rc);
+    const FILE_ID M_FOREIGN = g_volumes[(v + 1U) % TEST_VOLUMES].id;
+    U8 m_byte = 0U;
+    FS_FILE_WRITE(M_FOREIGN, 1U, &m_byte, &m_rc, &m_fe);
+    TEST_CHECK(INVALID_PARAM == m_rc);
+    FS_FILE_CLOSE(M_FOREIGN, &m_rc, &m_fe);
+    TEST_CHECK(INVALID_PARAM == m_rc);
+  }
+
+  /* 3. Потоки томов одновременно работают со своими очередями (без
+   * FS_THREAD_SAFE выбор тома общий для потоков - тома по очереди) */
+#if FS_THREAD_SAFE
+  pthread_t m_threads[TEST_VOLUMES];
+  for(VOLUME_ID v = 0U; v < TEST_VOLUMES; v++)
+  {
+    TEST_CHECK(0 == pthread_create(
+      &m_threads[v], (VOID_PTR)(0), TEST_VOLUME_WORKER, &g_volumes[v]));
+  }
+#endif
+  for(VOLUME_ID v = 0U; v < TEST_VOLUMES; v++)
+  {
+#if FS_THREAD_SAFE
+    pthread_join(m_threads[v], (VOID_PTR *)(0));
+#else
+    TEST_VOLUME_WORKER(&g_volumes[v]);
+#endif
+    TEST_CHECK(0U == g_volumes[v].failed);
+    TEST_CHECK(0 == memcmp(
+      g_volumes[v].read, g_volumes[v].data, TEST_FILE_SIZE));
+  }
+
+  /* 4. После переподключения в каждом томе - свои данные */
+  for(VOLUME_ID v = 0U; v < TEST_VOLUMES; v++)
+  {
+    FS_VOLUME_SELECT(v, &m_rc);
+    FS_FILE_CLOSE(g_volumes[v].id, &m_rc, &m_fe);
+    TEST_CHECK(NO_ERROR == m_rc);
+    TEST_UNMOUNT(&m_rc);
+    TEST_CHECK(NO_ERROR == m_rc);
+  }
+  for(VOLUME_ID v = 0U; v < TEST_VOLUMES; v++)
+  {
+    CHAR m_image[256];
+    TEST_IMAGE(v, m_image);
+    FS_VOLUME_SELECT(v, &m_rc);
+    EMULATOR_INIT(m_image, &m_rc);
+    TEST_CHECK(NO_ERROR == m_rc);
+    FS_INIT(&m_rc);
+    TEST_CHECK(NO_ERROR == m_rc);
+    FILE_ID m_id;
+    FS_FILE_OPEN(m_name, FILE_MODE_READ_ONLY, &m_id, &m_rc, &m_fe);
+    TEST_CHECK(NO_ERROR == m_rc);
+    SIZE32 m_length = 0U;
+    FS_FILE_READ(m_id, TEST_FILE_SIZE, &m_length, g_volumes[v].read,
+      &m_rc, &m_fe);
+    TEST_CHECK(TEST_FILE_SIZE == m_length);
+    TEST_CHECK(0 == memcmp(
+      g_volumes[v].read, g_volumes[v].data, TEST_FILE_SIZE));
+    FS_FILE_CLOSE(m_id, &m_rc, &m_fe);
+    TEST_CHECK(NO_ERROR == m_rc);
+    TEST_UNMOUNT(&m_rc);
+    TEST_CHECK(NO_ERROR == m_rc);
+    if(0U != v)
+    {
+      remove(m_image);
+    }
+  }
+
+  /* 5. Все тома одновременно подключаются, пишутся и переподключаются
+   * в своих потоках */
+#if FS_THREAD_SAFE
+  pthread_t m_parallel[FS_VOLUMES_COUNT];
+  for(VOLUME_ID v = 0U; v < FS_VOLUMES_COUNT; v++)
+  {
+    TEST_CHECK(0 == pthread_create(&m_parallel[v], (VOID_PTR)(0),
+      TEST_PARALLEL_WORKER, (VOID_PTR)(size_t)v));
+  }
+#endif
+  for(VOLUME_ID v = 0U; v < FS_VOLUMES_COUNT; v++)
+  {
+#if FS_THREAD_SAFE
+    pthread_join(m_parallel[v], (VOID_PTR *)(0));
+#else
+    TEST_PARALLEL_WORKER((VOID_PTR)(size_t)v);
+#endif
+    TEST_CHECK(0U == g_parallel_failed[v]);
+  }
+
+  FS_VOLUME_SELECT(0U, &m_rc);
+  return TEST_END("test_volume");
+}
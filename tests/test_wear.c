@@ -0,0 +1,133 @@
+/*
+ * ВЫРАВНИВАНИЕ ИЗНОСА:
+ * большая часть flash занята холодными данными, перезаписывается
+ * небольшой набор горячих блоков. Сектора с холодными данными не
+ * остаются нестертыми: сборщик мусора переносит их данные, и разброс
+ * счетчиков стираний секторов держится около порога выравнивания.
+ * Холодные данные при переносе не теряются, счетчики стираний
+ * сохраняются после переподключения
+ */
+#include "test.h"
+
+#define TEST_DATA_SIZE 250U
+#define TEST_COLD_COUNT 2000U
+#define TEST_HOT_COUNT 64U
+#define TEST_ROUNDS 1200U
+
+/*
+ * Порог выравнивания износа FTL (FTL_WEAR_THRESHOLD)
+ */
+#define TEST_WEAR_THRESHOLD 16U
+
+/*
+ * ДАННЫЕ ЛОГИЧЕСКОГО БЛОКА (несжимаемые: каждая запись занимает
+ * физический блок):
+ *   LBI: Номер логического блока
+ *   ROUND: Номер перезаписи
+ *   data: Данные
+ */
+static void TEST_BLOCK(
+/* IN  */ const FTL_INDEX LBI,
+/* IN  */ const U32 ROUND,
+/* OUT */ U8 * data)
+{
+  U32 m_seed = LBI * 2654435761U + ROUND * 40503U + 1U;
+  for(SIZE32 i = 0U; i < TEST_DATA_SIZE; i++)
+  {
+    data[i] = (U8)TEST_RANDOM(&m_seed);
+  }
+}
+
+/*
+ * СВЕРКА ХОЛОДНЫХ БЛОКОВ:
+ *   return: Количество несовпадений
+ */
+static SIZE32 TEST_VERIFY_COLD(void)
+{
+  SIZE32 m_mismatches = 0U;
+  for(FTL_INDEX m_lbi = 0U; m_lbi < TEST_COLD_COUNT; m_lbi++)
+  {
+    U8 m_data[TEST_DATA_SIZE] __attribute__((aligned(4)));
+    U8 m_model[TEST_DATA_SIZE];
+    TEST_BLOCK(m_lbi, 0U, m_model);
+    RETURN_CODE m_rc = NO_ERROR;
+    FTL_READ(m_lbi, 1U, m_data, &m_rc);
+    m_mismatches += (NO_ERROR != m_rc)
+      || (0 != memcmp(m_data, m_model, TEST_DATA_SIZE));
+  }
+  return m_mismatches;
+}
+
+int main(int argc, char ** argv)
+{
+  TEST_BEGIN(argc, argv);
+  RETURN_CODE m_rc = NO_ERROR;
+  TEST_FTL_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+
+  /* 1. Холодные данные записываются один раз */
+  U8 m_data[TEST_DATA_SIZE] __attribute__((aligned(4)));
+  for(FTL_INDEX m_lbi = 0U; m_lbi < TEST_COLD_COUNT; m_lbi++)
+  {
+    TEST_BLOCK(m_lbi, 0U, m_data);
+    FTL_WRITE(m_lbi, 1U, m_data, &m_rc);
+    TEST_CHECK(NO_ERROR == m_rc);
+  }
+
+  /* 2. Горячие блоки перезаписываются, пока сектора не износятся
+   * больше порога выравнивания */
+  SIZE32 m_failures = 0U;
+  for(U32 r = 0U; r < TEST_ROUNDS; r++)
+  {
+    for(FTL_INDEX m_lbi = TEST_COLD_COUNT;
+        m_lbi < TEST_COLD_COUNT + TEST_HOT_COUNT; m_lbi++)
+    {
+      TEST_BLOCK(m_lbi, r, m_data);
+      FTL_WRITE(m_lbi, 1U, m_data, &m_rc);
+      m_failures += (NO_ERROR != m_rc);
+    }
+  }
+  TEST_CHECK(0U == m_failures);
+
+  /* 3. Сектора холодных данных тоже стираются, разброс износа
+   * ограничен */
+  FTL_STATS_TYPE m_stats;
+  FTL_STATS(&m_stats, &m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_CHECK(m_stats.wear.max > 2U * TEST_WEAR_THRESHOLD);
+  TEST_CHECK(m_stats.wear.migrations > 0U);
+  TEST_CHECK(m_stats.wear.max - m_stats.wear.min
+    <= 2U * TEST_WEAR_THRESHOLD);
+  for(SIZE32 s = 0U; s < FTL_WEAR_SECTORS; s++)
+  {
+    TEST_CHECK(m_stats.wear.erases[s] >= m_stats.wear.min);
+    TEST_CHECK(m_stats.wear.erases[s] <= m_stats.wear.max);
+  }
+  TEST_CHECK(0U == TEST_VERIFY_COLD());
+
+  /* 4. Данные и счетчики стираний сохраняются после переподключения */
+  TEST_FTL_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  TEST_FTL_MOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+  FTL_STATS_TYPE m_remounted;
+  FTL_STATS(&m_remounted, &m_rc);
+  for(SIZE32 s = 0U; s < FTL_WEAR_SECTORS; s++)
+  {
+    TEST_CHECK(m_remounted.wear.erases[s] >= m_stats.wear.erases[s]);
+  }
+  TEST_CHECK(0U == TEST_VERIFY_COLD());
+  for(FTL_INDEX m_lbi = TEST_COLD_COUNT;
+      m_lbi < TEST_COLD_COUNT + TEST_HOT_COUNT; m_lbi++)
+  {
+    U8 m_model[TEST_DATA_SIZE];
+    TEST_BLOCK(m_lbi, TEST_ROUNDS - 1U, m_model);
+    FTL_READ(m_lbi, 1U, m_data, &m_rc);
+    TEST_CHECK(NO_ERROR == m_rc);
+    TEST_CHECK(0 == memcmp(m_data, m_model, TEST_DATA_SIZE));
+  }
+  TEST_FTL_UNMOUNT(&m_rc);
+  TEST_CHECK(NO_ERROR == m_rc);
+
+  return TEST_END("test_wear");
+}